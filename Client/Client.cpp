@@ -57,9 +57,24 @@ void Render();
 int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nCmdShow )
 {
     UNREFERENCED_PARAMETER( hPrevInstance );
-    UNREFERENCED_PARAMETER( lpCmdLine );
 	
 	GEngine = new Engine;
+
+	// -crowd [count] spawns the animation stress scene, CROWD_STRESS_COUNT instances by default
+	const wchar_t* CrowdArg = wcsstr( lpCmdLine, L"-crowd" );
+	if( CrowdArg )
+	{
+		const int Count = _wtoi( CrowdArg + wcslen( L"-crowd" ) );
+		GEngine->_CrowdCount = Count > 0 ? Count : CROWD_STRESS_COUNT;
+	}
+
+	// -lights [count] scatters point lights through the scene, POINT_LIGHT_STRESS_COUNT by default
+	const wchar_t* LightsArg = wcsstr( lpCmdLine, L"-lights" );
+	if( LightsArg )
+	{
+		const int Count = _wtoi( LightsArg + wcslen( L"-lights" ) );
+		GEngine->_PointLightCount = Count > 0 ? Count : POINT_LIGHT_STRESS_COUNT;
+	}
     
 	if( FAILED( InitWindow( hInstance, nCmdShow ) ) )
         return 0;
@@ -0,0 +1,79 @@
+#include "Common.hlsl"
+Texture2D<float4> texWorldNormal : register( t0 );
+Texture2D<float4> texDepth : register( t1 );
+Buffer<uint2> bufClusters : register( t3 );
+Buffer<uint> bufClusterLightIndices : register( t4 );
+Buffer<float4> bufClusterLights : register( t5 );
+SamplerState samLinear : register( s0 );
+
+cbuffer ConstantBuffer : register( b0 )
+{
+	matrix Projection;
+	float4 ProjectionParams;
+	float4 ViewportParams;
+	float4 ClusterParams;	// slice scale, slice bias
+	float4 ClusterGrid;		// clusters across, down, deep
+}
+
+struct QuadVS_Input
+{
+    float4 Pos : POSITION;
+    float2 Tex : TEXCOORD0;
+};
+
+struct QuadVS_Output
+{
+    float4 Pos : SV_POSITION;
+    float2 Tex : TEXCOORD0;
+};
+
+QuadVS_Output QuadVS( QuadVS_Input Input )
+{
+    QuadVS_Output Output;
+    Output.Pos = Input.Pos;
+    Output.Tex = Input.Tex;
+    return Output;
+}
+
+// every point light of the pixel's cluster, each lit as DeferredPoint.fx does
+float4 PS( QuadVS_Output input ) : SV_Target
+{
+	float3 ViewNormal = texWorldNormal.Sample( samLinear, input.Tex ).xyz;
+
+	float DeviceDepth = texDepth.Sample( samLinear, input.Tex ).x;
+	float LinearDepth =  GetLinearDepth(DeviceDepth, ProjectionParams.x, ProjectionParams.y) * ProjectionParams.z;
+
+	float2 ScreenPosition = input.Pos.xy;
+	ScreenPosition.x /= ViewportParams.x;
+	ScreenPosition.y /= ViewportParams.y;
+	uint2 Tile = (uint2)min(ScreenPosition * ClusterGrid.xy, ClusterGrid.xy - 1);
+	ScreenPosition.xy = ScreenPosition.xy * 2 -1;
+	ScreenPosition.y = -ScreenPosition.y;
+
+	float3 ViewPosition = GetViewPosition(LinearDepth, ScreenPosition, Projection._11, Projection._22);
+
+	uint Slice = (uint)clamp(floor(log(LinearDepth) * ClusterParams.x + ClusterParams.y), 0, ClusterGrid.z - 1);
+	uint Cluster = (Slice * (uint)ClusterGrid.y + Tile.y) * (uint)ClusterGrid.x + Tile.x;
+	uint2 LightRange = bufClusters.Load(Cluster);
+
+	float3 Lit = 0;
+	for(uint i=0;i<LightRange.y;i++)
+	{
+		uint LightIndex = bufClusterLightIndices.Load(LightRange.x + i);
+		float4 LightPosRange = bufClusterLights.Load(LightIndex * 2);
+		float4 LightColor = bufClusterLights.Load(LightIndex * 2 + 1);
+
+		float3 LightDir = LightPosRange.xyz - ViewPosition;
+		float LightDist = length(LightDir);
+		LightDir = normalize(LightDir);
+		float Attenuation = saturate(1-LightDist/LightPosRange.w);
+		Attenuation*=Attenuation;
+
+		float NdotL = dot(LightDir,ViewNormal);
+
+		float3 Specular = CalcBlinPhong(LightDir, ViewNormal, 100);
+
+		Lit += NdotL * LightColor.xyz * Attenuation + Specular.xyz * Attenuation;
+	}
+	return float4(Lit, 1);
+}
@@ -12,6 +12,9 @@ cbuffer ConstantBuffer : register( b0 )
 {
 	matrix ModelView;
 	matrix Projection;
+	float4 PositionScale;
+	float4 PositionBias;
+	uint BoneBase;
 }
 
 
@@ -22,20 +25,20 @@ PS_INPUT VS(  VS_INPUT input )
 {
     PS_INPUT output = (PS_INPUT)0;
 #if GPUSKINNING
-	float4x4 BoneMat = CalcBoneMatrix(input.Bones, input.Weights);
-	output.Pos = float4(input.Pos, 1.f);
-	output.Pos = mul(output.Pos, BoneMat);
+	float3x4 BoneMat = CalcBoneMatrix(input.Bones, input.Weights, BoneBase);
+	output.Pos = float4(GetInputPosition(input, PositionScale, PositionBias), 1.f);
+	output.Pos = SkinPosition(BoneMat, output.Pos);
     output.Pos = mul( output.Pos, ModelView );
     output.Pos = mul( output.Pos, Projection);
 
-	output.Norm = (mul(input.Norm, BoneMat));
+	output.Norm = SkinNormal(BoneMat, GetInputNormal(input));
     output.Norm = normalize(mul( output.Norm, ModelView ).xyz);
 #else
-	output.Pos = float4(input.Pos, 1.f);
+	output.Pos = float4(GetInputPosition(input, PositionScale, PositionBias), 1.f);
     output.Pos = mul( output.Pos, ModelView );
     output.Pos = mul( output.Pos, Projection );
 
-    output.Norm = mul( input.Norm, ModelView ).xyz;
+    output.Norm = mul( GetInputNormal(input), ModelView ).xyz;
 #endif
 #if TEXCOORD
 	output.Tex = input.Tex;
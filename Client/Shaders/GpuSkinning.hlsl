@@ -1,25 +1,73 @@
 
 #if GPUSKINNING
 
+// 3 float4 per bone, the rows of the column form affine transform.
+// the frame's palette arena, every draw's bones start at float4 element BoneBase
 Buffer<float4> BoneMatrices;
 
 #define MAX_BONELINK 4
-float4x4 CalcBoneMatrix(uint4 Bones, float4 Weights)
+#if DUALQUAT_SKINNING
+// 2 float4 per bone, real and dual part. BonePalette::BlendDualQuat is the cpu reference, keep them in step.
+// precise keeps the compiler from fusing or reordering, the reference rounds every step the same way
+float3x4 CalcBoneMatrix(uint4 Bones, float4 Weights, uint BoneBase)
 {
-	float4x4 TotalMat = (float4x4)0;
+	uint iFirst = BoneBase + Bones[0] * 2;
+	float4 Real0 = BoneMatrices.Load( iFirst );
+	precise float4 Real = Real0 * Weights[0];
+	precise float4 Dual = BoneMatrices.Load( iFirst + 1 ) * Weights[0];
+
+	for(int i=1;i<MAX_BONELINK;i++)
+	{
+		uint iBone = BoneBase + Bones[i] * 2;
+		float4 BoneReal = BoneMatrices.Load( iBone );
+		float4 BoneDual = BoneMatrices.Load( iBone + 1 );
+
+		// q and -q are the same rotation, blend along the short way
+		precise float w = dot(Real0, BoneReal) < 0 ? -Weights[i] : Weights[i];
+		Real = Real + BoneReal * w;
+		Dual = Dual + BoneDual * w;
+	}
+
+	precise float InvLength = 1.f / sqrt(dot(Real, Real));
+	Real = Real * InvLength;
+	Dual = Dual * InvLength;
+
+	float x = Real.x, y = Real.y, z = Real.z, w = Real.w;
+	precise float3 t = 2.f * (w * Dual.xyz - Dual.w * Real.xyz + cross(Real.xyz, Dual.xyz));
+
+	precise float3x4 BoneMat = float3x4(
+		1.f - 2.f * (y * y + z * z), 2.f * (x * y - w * z), 2.f * (x * z + w * y), t.x,
+		2.f * (x * y + w * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z - w * x), t.y,
+		2.f * (x * z - w * y), 2.f * (y * z + w * x), 1.f - 2.f * (x * x + y * y), t.z );
+	return BoneMat;
+}
+#else
+float3x4 CalcBoneMatrix(uint4 Bones, float4 Weights, uint BoneBase)
+{
+	float3x4 TotalMat = (float3x4)0;
 
 	for(int i=0;i<MAX_BONELINK;i++)
 	{
-		uint iBone = Bones[i] * 4;
+		uint iBone = BoneBase + Bones[i] * 3;
 		float4 row1 = BoneMatrices.Load( iBone );
 		float4 row2 = BoneMatrices.Load( iBone + 1 );
 		float4 row3 = BoneMatrices.Load( iBone + 2 );
-		float4 row4 = BoneMatrices.Load( iBone + 3 );
-		float4x4 Mat = float4x4( row1, row2, row3, row4 );
+		float3x4 Mat = float3x4( row1, row2, row3 );
 		
 		TotalMat += Mat* Weights[i];
 	}
 
 	return TotalMat;
 }
+#endif
+
+float4 SkinPosition(float3x4 BoneMat, float4 Pos)
+{
+	return float4(mul(BoneMat, Pos), 1.f);
+}
+
+float3 SkinNormal(float3x4 BoneMat, float3 Norm)
+{
+	return mul((float3x3)BoneMat, Norm);
+}
 #endif
\ No newline at end of file
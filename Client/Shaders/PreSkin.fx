@@ -0,0 +1,35 @@
+//--------------------------------------------------------------------------------------
+// skins every vertex of a skeletal mesh once into a stream out buffer, model space float vertices
+// that the g-buffer and shadow passes then draw as static geometry
+//--------------------------------------------------------------------------------------
+#include "GpuSkinning.hlsl"
+#include "VSPSInput.hlsl"
+
+cbuffer ConstantBuffer : register( b0 )
+{
+	float4 PositionScale;
+	float4 PositionBias;
+	uint BoneBase;
+}
+
+// same layout as NormalVertex/NormalTexVertex
+struct PRESKIN_OUTPUT
+{
+	float3 Pos : POSITION;
+	float3 Norm : NORMAL;
+#if TEXCOORD
+	float2 Tex : TEXCOORD0;
+#endif
+};
+
+PRESKIN_OUTPUT VS( VS_INPUT input )
+{
+	PRESKIN_OUTPUT output;
+	float3x4 BoneMat = CalcBoneMatrix(input.Bones, input.Weights, BoneBase);
+	output.Pos = SkinPosition(BoneMat, float4(GetInputPosition(input, PositionScale, PositionBias), 1.f)).xyz;
+	output.Norm = normalize(SkinNormal(BoneMat, GetInputNormal(input)));
+#if TEXCOORD
+	output.Tex = input.Tex;
+#endif
+	return output;
+}
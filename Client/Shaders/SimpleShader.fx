@@ -14,7 +14,9 @@ cbuffer ConstantBuffer : register( b0 )
 	matrix Projection;
 	float4 vLightDir[2];
 	float4 vLightColor[2];
-
+	float4 PositionScale;
+	float4 PositionBias;
+	uint BoneBase;
 }
 
 //--------------------------------------------------------------------------------------
@@ -24,21 +26,21 @@ PS_INPUT VS(  VS_INPUT input )
 {
     PS_INPUT output = (PS_INPUT)0;
 #if GPUSKINNING
-	float4x4 BoneMat = CalcBoneMatrix(input.Bones, input.Weights);
-	output.Pos = float4(input.Pos, 1.f);
+	float3x4 BoneMat = CalcBoneMatrix(input.Bones, input.Weights, BoneBase);
+	output.Pos = float4(GetInputPosition(input, PositionScale, PositionBias), 1.f);
+	output.Pos = SkinPosition(BoneMat, output.Pos);
 	output.Pos = mul( output.Pos, World );
-	output.Pos = mul(output.Pos, BoneMat);
     output.Pos = mul( output.Pos, View );
     output.Pos = mul( output.Pos, Projection);
 
-	output.Norm = mul( input.Norm, World );
-	output.Norm = normalize(mul(output.Norm, BoneMat));
+	output.Norm = SkinNormal(BoneMat, GetInputNormal(input));
+	output.Norm = normalize(mul( output.Norm, (float3x3)World ));
 #else
-	output.Pos = float4(input.Pos, 1.f);
+	output.Pos = float4(GetInputPosition(input, PositionScale, PositionBias), 1.f);
     output.Pos = mul( output.Pos, World );
     output.Pos = mul( output.Pos, View );
     output.Pos = mul( output.Pos, Projection );
-	output.Norm = normalize(mul( input.Norm, World ));
+	output.Norm = normalize(mul( GetInputNormal(input), World ));
 #endif
 #if TEXCOORD
 	output.Tex = input.Tex;
@@ -1,7 +1,12 @@
 struct VS_INPUT
 {
+#if COMPRESSED
+    float4 Pos : POSITION;		// snorm16, relative to the mesh bounds
+    float2 Norm : NORMAL;		// snorm16 octahedral
+#else
     float3 Pos : POSITION;
     float3 Norm : NORMAL;
+#endif
 #if TEXCOORD
 	float2 Tex : TEXCOORD0;
 #endif
@@ -19,4 +24,30 @@ struct PS_INPUT
 	float2 Tex : TEXCOORD0;
 #endif
 
-};
\ No newline at end of file
+};
+
+float3 DecodeOctahedral(float2 Encoded)
+{
+	float3 Norm = float3(Encoded.xy, 1.f - abs(Encoded.x) - abs(Encoded.y));
+	float T = saturate(-Norm.z);
+	Norm.xy += Norm.xy >= 0.f ? -T : T;
+	return normalize(Norm);
+}
+
+float3 GetInputPosition(VS_INPUT input, float4 PositionScale, float4 PositionBias)
+{
+#if COMPRESSED
+	return input.Pos.xyz * PositionScale.xyz + PositionBias.xyz;
+#else
+	return input.Pos;
+#endif
+}
+
+float3 GetInputNormal(VS_INPUT input)
+{
+#if COMPRESSED
+	return DecodeOctahedral(input.Norm);
+#else
+	return input.Norm;
+#endif
+}
@@ -0,0 +1,437 @@
+// Offline asset cooker.
+// Turns source fbx files into .cmesh/.cskel/.canim next to the source, skipping files whose
+// content hash and import settings match the last cook recorded in the manifest.
+//
+//   Cooker [-force] [-stats] [-noanim] [-nocompress] [-noanimcompress] [-lods count] [-manifest path] file.fbx ...
+//   Cooker -benchanim [file.fbx ...]	times the pose samplers on the uncompressed clips of each file and a synthetic rig
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "FbxFileImporter.h"
+#include "StaticMesh.h"
+#include "SkeletalMesh.h"
+#include "AnimationClip.h"
+#include "CookedMesh.h"
+#include "CookedAnimation.h"
+#include "MappedFile.h"
+#include "ParallelFor.h"
+#include "MathUtil.h"
+
+// bump when importer output changes so every asset gets cooked again
+#define COOKER_SETTINGS_VERSION 7
+// bump when the manifest layout changes, older manifests are ignored
+#define COOK_MANIFEST_VERSION 2
+
+// files a cook wrote, recorded so a skip can check they are all still there
+#define COOK_OUTPUT_MESH		0x1
+#define COOK_OUTPUT_SKELETON	0x2
+#define COOK_OUTPUT_ANIM		0x4
+
+struct CookSettings
+{
+	bool bCookAnim;
+	bool bCompressVertices;
+	bool bCompressAnim;
+	int LODCount;
+
+	std::string ToString() const
+	{
+		char Buffer[160];
+		sprintf_s(Buffer, sizeof(Buffer), "cooker=%d mesh=%d skel=%d anim=%d cookanim=%d compress=%d animcompress=%d lods=%d",
+			COOKER_SETTINGS_VERSION, COOKED_MESH_VERSION, COOKED_SKELETON_VERSION, COOKED_ANIM_VERSION, bCookAnim ? 1 : 0, bCompressVertices ? 1 : 0, bCompressAnim ? 1 : 0, LODCount);
+		return Buffer;
+	}
+};
+
+struct CookJob
+{
+	enum EResult
+	{
+		Skipped,
+		Cooked,
+		Failed,
+	};
+
+	std::string SourcePath;
+	uint64_t	Hash;
+	unsigned int Outputs;	// COOK_OUTPUT_ flags
+	EResult		Result;
+	std::string	Message;
+};
+
+struct ManifestEntry
+{
+	uint64_t Hash;
+	unsigned int Outputs;
+};
+
+// FNV-1a 64
+static uint64_t HashBytes(const void* Data, size_t Size, uint64_t Hash = 14695981039346656037ULL)
+{
+	const unsigned char* Bytes = (const unsigned char*)Data;
+	for(size_t i=0;i<Size;i++)
+	{
+		Hash ^= Bytes[i];
+		Hash *= 1099511628211ULL;
+	}
+	return Hash;
+}
+
+static bool HashSourceFile(const std::string& Path, const std::string& Settings, uint64_t& OutHash)
+{
+	MappedFile File;
+	if(!File.Open(Path.c_str()))
+		return false;
+	OutHash = HashBytes(File.GetData(), File.GetSize());
+	OutHash = HashBytes(Settings.c_str(), Settings.size(), OutHash);
+	return true;
+}
+
+static bool FileExists(const std::string& Path)
+{
+	FILE* File = fopen(Path.c_str(), "rb");
+	if(File == NULL)
+		return false;
+	fclose(File);
+	return true;
+}
+
+static bool AreOutputsPresent(const std::string& SourcePath, unsigned int Outputs)
+{
+	if((Outputs & COOK_OUTPUT_MESH) && !FileExists(GetCookedMeshPath(SourcePath)))
+		return false;
+	if((Outputs & COOK_OUTPUT_SKELETON) && !FileExists(GetCookedSkeletonPath(SourcePath)))
+		return false;
+	if((Outputs & COOK_OUTPUT_ANIM) && !FileExists(GetCookedAnimPath(SourcePath)))
+		return false;
+	return Outputs != 0;
+}
+
+// first line "cookmanifest version", then "hash outputs path" per cooked source
+static void LoadManifest(const std::string& Path, std::map<std::string, ManifestEntry>& OutManifest)
+{
+	FILE* File = fopen(Path.c_str(), "rt");
+	if(File == NULL)
+		return;
+
+	char Line[1024];
+	int Version = 0;
+	if(fgets(Line, sizeof(Line), File) == NULL || sscanf_s(Line, "cookmanifest %d", &Version) != 1 || Version != COOK_MANIFEST_VERSION)
+	{
+		fclose(File);
+		return;
+	}
+
+	while(fgets(Line, sizeof(Line), File))
+	{
+		unsigned long long Hash;
+		unsigned int Outputs;
+		char SourcePath[1024];
+		if(sscanf_s(Line, "%llx %x %1023[^\n]", &Hash, &Outputs, SourcePath, (unsigned)sizeof(SourcePath)) == 3)
+		{
+			ManifestEntry& Entry = OutManifest[SourcePath];
+			Entry.Hash = Hash;
+			Entry.Outputs = Outputs;
+		}
+	}
+	fclose(File);
+}
+
+static bool SaveManifest(const std::string& Path, const std::map<std::string, ManifestEntry>& Manifest)
+{
+	char Line[64];
+	sprintf_s(Line, sizeof(Line), "cookmanifest %d\n", COOK_MANIFEST_VERSION);
+	std::string Text = Line;
+	for(std::map<std::string, ManifestEntry>::const_iterator it=Manifest.begin();it!=Manifest.end();it++)
+	{
+		sprintf_s(Line, sizeof(Line), "%016llx %x ", (unsigned long long)it->second.Hash, it->second.Outputs);
+		Text += Line;
+		Text += it->first;
+		Text += "\n";
+	}
+	return WriteWholeFile(Path.c_str(), Text.c_str(), Text.size());
+}
+
+template<class MeshType>
+static bool SaveMeshes(const std::string& Path, std::vector<MeshType*>& MeshArray)
+{
+	CookedMeshWriter Writer;
+	for(unsigned int i=0;i<MeshArray.size();i++)
+	{
+		MeshArray[i]->AddToCookedMesh(Writer);
+		delete MeshArray[i];
+	}
+	MeshArray.clear();
+	return Writer.Save(Path.c_str());
+}
+
+static bool CookAsset(CookJob& Job, const CookSettings& Settings)
+{
+	FbxFileImporter Importer(Job.SourcePath);
+	Importer.CompressVertices = Settings.bCompressVertices;
+	Importer.CompressAnimation = Settings.bCompressAnim;
+	Importer.LODCount = Settings.LODCount;
+	if(!Importer.LoadScene())
+	{
+		Job.Message = "failed to load fbx";
+		return false;
+	}
+
+	std::vector<FbxCluster*> ClusterArray;
+	Importer.FillFbxClusterArray(Importer.mScene->GetRootNode(), ClusterArray);
+	if(ClusterArray.size() == 0)
+	{
+		std::vector<StaticMesh*> MeshArray;
+		Importer.ImportStaticMesh(MeshArray);
+		char Buffer[64];
+		sprintf_s(Buffer, sizeof(Buffer), "%d static meshes", (int)MeshArray.size());
+		Job.Message = Buffer;
+		if(!SaveMeshes(GetCookedMeshPath(Job.SourcePath), MeshArray))
+		{
+			Job.Message = "failed to write cooked mesh";
+			return false;
+		}
+		Job.Outputs = COOK_OUTPUT_MESH;
+		return true;
+	}
+
+	std::vector<SkeletalMesh*> MeshArray;
+	Importer.ImportSkeletalMesh(MeshArray);
+	int NumMesh = MeshArray.size();
+	if(!SaveMeshes(GetCookedMeshPath(Job.SourcePath), MeshArray))
+	{
+		Job.Message = "failed to write cooked mesh";
+		return false;
+	}
+
+	Skeleton* Skel = new Skeleton;
+	SkeletonPose* RefPose = new SkeletonPose;
+	Importer.ImportSkeleton(&Skel, &RefPose);
+	bool bSkeletonSaved = CookedAnimation::SaveSkeleton(GetCookedSkeletonPath(Job.SourcePath).c_str(), Skel, RefPose);
+	int NumJoint = Skel->_JointCount;
+	delete Skel;
+	delete RefPose;
+	if(!bSkeletonSaved)
+	{
+		Job.Message = "failed to write cooked skeleton";
+		return false;
+	}
+	Job.Outputs = COOK_OUTPUT_MESH | COOK_OUTPUT_SKELETON;
+
+	int NumClip = 0;
+	if(Settings.bCookAnim)
+	{
+		std::vector<AnimationClip*> ClipArray;
+		Importer.ImportAnimClip(ClipArray);
+		NumClip = ClipArray.size();
+		bool bAnimSaved = ClipArray.size() == 0 || CookedAnimation::SaveClips(GetCookedAnimPath(Job.SourcePath).c_str(), ClipArray);
+		for(unsigned int i=0;i<ClipArray.size();i++)
+			delete ClipArray[i];
+		if(!bAnimSaved)
+		{
+			Job.Message = "failed to write cooked animation";
+			return false;
+		}
+		if(NumClip > 0)
+			Job.Outputs |= COOK_OUTPUT_ANIM;
+	}
+
+	char Buffer[128];
+	sprintf_s(Buffer, sizeof(Buffer), "%d skeletal meshes, %d joints, %d clips", NumMesh, NumJoint, NumClip);
+	Job.Message = Buffer;
+	return true;
+}
+
+#define BENCH_POSE_COUNT		20000
+#define BENCH_SYNTHETIC_JOINTS	500
+
+static double GetSeconds()
+{
+	LARGE_INTEGER Freq, Counter;
+	QueryPerformanceFrequency(&Freq);
+	QueryPerformanceCounter(&Counter);
+	return (double)Counter.QuadPart / (double)Freq.QuadPart;
+}
+
+// microseconds per pose of the AoS track path, then of every SoA path this build has
+static void BenchAnimClip(const char* Name, AnimationClip* Clip)
+{
+	const int JointCount = Clip->GetJointCount();
+	const float TimeStep = 0.0137f;	// not a multiple of the frame time, so alpha varies
+	SkeletonPose Pose;
+	Pose._LocalPoseArray.resize(JointCount);
+	AnimKeyCursor Cursor;
+
+	double Start = GetSeconds();
+	for(int i=0;i<BENCH_POSE_COUNT;i++)
+		Clip->GetCurrentPose(Pose, fmodf(i * TimeStep, Clip->GetDuration()), &Cursor);
+	const double AoSTime = GetSeconds() - Start;
+
+	if(!Clip->BuildSoaKeys())
+	{
+		printf("%s : %d joints, aos %.2f us, not uniform, no soa keys\n", Name, JointCount, AoSTime * 1e6 / BENCH_POSE_COUNT);
+		return;
+	}
+
+	double SoaTime[ANIM_SIMD_AVX2 + 1] = {0};
+	SoaSkeletonPose SoaPose;
+	for(int Simd=ANIM_SIMD_SCALAR;Simd<=AnimationSampler::GetBestSimd();Simd++)
+	{
+		Start = GetSeconds();
+		for(int i=0;i<BENCH_POSE_COUNT;i++)
+			Clip->GetCurrentPose(SoaPose, fmodf(i * TimeStep, Clip->GetDuration()), (EAnimSimd)Simd);
+		SoaTime[Simd] = GetSeconds() - Start;
+	}
+
+	printf("%s : %d joints, aos %.2f us, soa scalar %.2f us, sse %.2f us, avx2 %.2f us\n", Name, JointCount,
+		AoSTime * 1e6 / BENCH_POSE_COUNT, SoaTime[ANIM_SIMD_SCALAR] * 1e6 / BENCH_POSE_COUNT,
+		SoaTime[ANIM_SIMD_SSE] * 1e6 / BENCH_POSE_COUNT, SoaTime[ANIM_SIMD_AVX2] * 1e6 / BENCH_POSE_COUNT);
+}
+
+static void BenchAnimation(const std::vector<CookJob>& JobArray)
+{
+	for(unsigned int i=0;i<JobArray.size();i++)
+	{
+		FbxFileImporter Importer(JobArray[i].SourcePath);
+		Importer.CompressAnimation = false;
+		if(!Importer.LoadScene())
+		{
+			printf("failed  : %s (failed to load fbx)\n", JobArray[i].SourcePath.c_str());
+			continue;
+		}
+
+		std::vector<AnimationClip*> ClipArray;
+		Importer.ImportAnimClip(ClipArray);
+		for(unsigned int c=0;c<ClipArray.size();c++)
+		{
+			BenchAnimClip(JobArray[i].SourcePath.c_str(), ClipArray[c]);
+			delete ClipArray[c];
+		}
+	}
+
+	AnimationClip* Synthetic = AnimationClip::CreateSynthetic(BENCH_SYNTHETIC_JOINTS, 300, 30.f);
+	BenchAnimClip("synthetic", Synthetic);
+	delete Synthetic;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string ManifestPath = "cook_manifest.txt";
+	bool bForce = false;
+	bool bBenchAnim = false;
+	CookSettings Settings;
+	Settings.bCookAnim = true;
+	Settings.bCompressVertices = true;
+	Settings.bCompressAnim = true;
+	Settings.LODCount = LOD_MAX_COUNT;
+
+	std::vector<CookJob> JobArray;
+	for(int i=1;i<argc;i++)
+	{
+		if(strcmp(argv[i], "-force") == 0)
+			bForce = true;
+		else if(strcmp(argv[i], "-stats") == 0)
+		{
+			StaticMesh::_bLogImportStats = true;
+			SkeletalMesh::_bLogImportStats = true;
+		}
+		else if(strcmp(argv[i], "-benchanim") == 0)
+			bBenchAnim = true;
+		else if(strcmp(argv[i], "-noanim") == 0)
+			Settings.bCookAnim = false;
+		else if(strcmp(argv[i], "-nocompress") == 0)
+			Settings.bCompressVertices = false;
+		else if(strcmp(argv[i], "-noanimcompress") == 0)
+			Settings.bCompressAnim = false;
+		else if(strcmp(argv[i], "-lods") == 0 && i+1 < argc)
+			Settings.LODCount = Math::Clamp(atoi(argv[++i]), 1, LOD_MAX_COUNT);
+		else if(strcmp(argv[i], "-manifest") == 0 && i+1 < argc)
+			ManifestPath = argv[++i];
+		else
+		{
+			CookJob Job;
+			Job.SourcePath = argv[i];
+			Job.Hash = 0;
+			Job.Outputs = 0;
+			Job.Result = CookJob::Failed;
+			JobArray.push_back(Job);
+		}
+	}
+
+	if(bBenchAnim)
+	{
+		BenchAnimation(JobArray);
+		return 0;
+	}
+
+	if(JobArray.size() == 0)
+	{
+		printf("usage : Cooker [-force] [-stats] [-noanim] [-nocompress] [-noanimcompress] [-lods count] [-manifest path] file.fbx ...\n");
+		return 1;
+	}
+
+	std::map<std::string, ManifestEntry> Manifest;
+	LoadManifest(ManifestPath, Manifest);
+	const std::string SettingsString = Settings.ToString();
+
+	// every source file has its own fbx manager and scene, so files cook independently
+	ParallelFor(0, (int)JobArray.size(), [&](int JobIndex)
+	{
+		CookJob& Job = JobArray[JobIndex];
+		if(!HashSourceFile(Job.SourcePath, SettingsString, Job.Hash))
+		{
+			Job.Result = CookJob::Failed;
+			Job.Message = "cannot read source";
+			return;
+		}
+
+		// a deleted .cskel or .canim cooks the asset again, not just a missing .cmesh
+		std::map<std::string, ManifestEntry>::const_iterator it = Manifest.find(Job.SourcePath);
+		if(!bForce && it != Manifest.end() && it->second.Hash == Job.Hash && AreOutputsPresent(Job.SourcePath, it->second.Outputs))
+		{
+			Job.Result = CookJob::Skipped;
+			Job.Message = "up to date";
+			return;
+		}
+
+		Job.Result = CookAsset(Job, Settings) ? CookJob::Cooked : CookJob::Failed;
+	});
+
+	int NumCooked = 0, NumSkipped = 0, NumFailed = 0;
+	for(unsigned int i=0;i<JobArray.size();i++)
+	{
+		CookJob& Job = JobArray[i];
+		switch(Job.Result)
+		{
+		case CookJob::Cooked:
+			NumCooked++;
+			Manifest[Job.SourcePath].Hash = Job.Hash;
+			Manifest[Job.SourcePath].Outputs = Job.Outputs;
+			printf("cooked  : %s (%s)\n", Job.SourcePath.c_str(), Job.Message.c_str());
+			break;
+		case CookJob::Skipped:
+			NumSkipped++;
+			printf("skipped : %s\n", Job.SourcePath.c_str());
+			break;
+		case CookJob::Failed:
+			NumFailed++;
+			Manifest.erase(Job.SourcePath);
+			printf("failed  : %s (%s)\n", Job.SourcePath.c_str(), Job.Message.c_str());
+			break;
+		}
+	}
+
+	if(!SaveManifest(ManifestPath, Manifest))
+		printf("failed to write manifest : %s\n", ManifestPath.c_str());
+
+	printf("%d cooked, %d skipped, %d failed\n", NumCooked, NumSkipped, NumFailed);
+	return NumFailed > 0 ? 1 : 0;
+}
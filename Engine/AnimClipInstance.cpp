@@ -18,7 +18,13 @@ AnimClipInstance::~AnimClipInstance(void)
 
 void AnimClipInstance::GetCurrentPose(SkeletonPose& InPose)
 {
-	_Clip->GetCurrentPose(InPose, _LocalTime);
+	if(_Clip->HasSoaKeys())
+	{
+		_Clip->GetCurrentPose(_SoaPose, _LocalTime, AnimationSampler::GetBestSimd());
+		_SoaPose.ToSkeletonPose(InPose);
+		return;
+	}
+	_Clip->GetCurrentPose(InPose, _LocalTime, &_Cursor);
 }
 
 void AnimClipInstance::Tick()
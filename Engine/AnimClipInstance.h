@@ -11,12 +11,16 @@ class AnimClipInstance :
 	float _LocalTime;
 	int _NumPlay;
 	AnimationClip* _Clip;
+	AnimKeyCursor _Cursor;	// keys found last frame, each instance plays its clip from its own position
+	SoaSkeletonPose _SoaPose;
 public:
 	void Play(int InNumPlay);
 	void Stop();
 	void SetTimeScale(float InScale){_TimeScale = InScale;}
 	void Tick();
 	void GetCurrentPose(SkeletonPose& InPose);
+	float GetLocalTime() const {return _LocalTime;}
+	AnimationClip* GetClip() const {return _Clip;}
 
 	AnimClipInstance(AnimationClip* InClip);
 	virtual ~AnimClipInstance(void);
@@ -1,8 +1,17 @@
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
 #include "AnimationClip.h"
 #include "OutputDebug.h"
+#include "MathUtil.h"
 
 AnimationClip::AnimationClip(void)
 	:_Duration(0.f)
+	,_SampleRate(0.f)
+	,_FrameCount(0)
+	,_SoaJointCount(0)
+	,_SoaPaddedCount(0)
 {
 }
 
@@ -14,72 +23,276 @@ AnimationClip::~AnimationClip(void)
 	_ScaleTrackArray.clear();
 }
 
-void AnimationClip::GetCurrentPose(SkeletonPose& InPose, float CurrentTime)
+// Cursor holds the key used last, playback usually stays on it or moves a few keys forward.
+// anything else falls back to a binary search
+static void FindKeyIndices(const std::vector<float>& TimeArray, float LocalTime, int* Cursor, int& KeyIndex0, int& KeyIndex1, float& Alpha)
 {
-	float NormalizedTime = CurrentTime / _Duration;
-	for(unsigned int i=0;i<_TransTrackArray.size();i++)
+	const int LastKey = TimeArray.size() - 1;
+	if(LastKey <= 0)
+	{
+		KeyIndex0 = KeyIndex1 = 0;
+		Alpha = 0.f;
+		return;
+	}
+
+	int Key = Cursor ? *Cursor : -1;
+	if(Key >= 0 && Key < LastKey && TimeArray[Key] <= LocalTime)
+	{
+		while(Key < LastKey - 1 && TimeArray[Key + 1] <= LocalTime)
+			Key++;
+	}
+	else
+	{
+		Key = std::upper_bound(TimeArray.begin() + 1, TimeArray.begin() + LastKey, LocalTime) - TimeArray.begin() - 1;
+	}
+	if(Cursor)
+		*Cursor = Key;
+
+	KeyIndex0 = Key;
+	KeyIndex1 = Key + 1;
+	Alpha = Math::Clamp<float>((LocalTime - TimeArray[KeyIndex0])/(TimeArray[KeyIndex1] - TimeArray[KeyIndex0]), 0.f, 1.f);
+}
+
+void AnimationClip::GetCurrentPose(SkeletonPose& InPose, float CurrentTime, AnimKeyCursor* Cursor) const
+{
+	const int JointCount = GetJointCount();
+	int* Keys = NULL;
+	if(Cursor)
+	{
+		if((int)Cursor->_KeyArray.size() != JointCount * ANIM_TRACK_TYPE_COUNT)
+			Cursor->_KeyArray.assign(JointCount * ANIM_TRACK_TYPE_COUNT, 0);
+		Keys = JointCount ? &Cursor->_KeyArray[0] : NULL;
+	}
+
+	if(IsCompressed())
+	{
+		const float Frame = Math::Clamp<float>(CurrentTime * _SampleRate, 0.f, (float)(_FrameCount - 1));
+		const unsigned short* KeyFrames = _KeyFrameArray.size() ? &_KeyFrameArray[0] : NULL;
+		const unsigned short* KeyData = _KeyDataArray.size() ? &_KeyDataArray[0] : NULL;
+		for(int i=0;i<JointCount;i++)
+		{
+			JointPose& Joint = InPose._LocalPoseArray[i];
+			const CompressedAnimTrack* Tracks = &_CompressedTrackArray[i*ANIM_TRACK_TYPE_COUNT];
+			int* TrackKeys = Keys ? Keys + i*ANIM_TRACK_TYPE_COUNT : NULL;
+
+			Joint._Rot = SampleAnimTrack(Tracks[ANIM_TRACK_ROTATION], ANIM_TRACK_ROTATION, KeyFrames, KeyData, Frame,
+				TrackKeys ? TrackKeys + ANIM_TRACK_ROTATION : NULL);
+
+			const XMFLOAT4 Trans = SampleAnimTrack(Tracks[ANIM_TRACK_TRANSLATION], ANIM_TRACK_TRANSLATION, KeyFrames, KeyData, Frame,
+				TrackKeys ? TrackKeys + ANIM_TRACK_TRANSLATION : NULL);
+			Joint._Trans = XMFLOAT3(Trans.x, Trans.y, Trans.z);
+
+			const XMFLOAT4 Scale = SampleAnimTrack(Tracks[ANIM_TRACK_SCALE], ANIM_TRACK_SCALE, KeyFrames, KeyData, Frame,
+				TrackKeys ? TrackKeys + ANIM_TRACK_SCALE : NULL);
+			Joint._Scale = XMFLOAT3(Scale.x, Scale.y, Scale.z);
+		}
+		return;
+	}
+
+	if(HasSoaKeys())
+	{
+		int KeyIndex0, KeyIndex1;
+		float Alpha;
+		GetUniformKeys(CurrentTime, KeyIndex0, KeyIndex1, Alpha);
+		const int BlockSize = ANIM_SOA_STREAM_COUNT * _SoaPaddedCount;
+		for(int i=0;i<JointCount;i++)
+			AnimationSampler::InterpolateJoint(&_SoaKeyArray[KeyIndex0 * BlockSize], &_SoaKeyArray[KeyIndex1 * BlockSize], Alpha, _SoaPaddedCount, i, InPose._LocalPoseArray[i]);
+		return;
+	}
+
+	if(IsUniform())
+	{
+		// one key pair for the whole clip, no search at all
+		int KeyIndex0, KeyIndex1;
+		float Alpha;
+		GetUniformKeys(CurrentTime, KeyIndex0, KeyIndex1, Alpha);
+		for(int i=0;i<JointCount;i++)
+		{
+			JointPose& Joint = InPose._LocalPoseArray[i];
+			_ScaleTrackArray[i].GetScale(&Joint._Scale, KeyIndex0, KeyIndex1, Alpha);
+			_RotTrackArray[i].GetRot(&Joint._Rot, KeyIndex0, KeyIndex1, Alpha);
+			_TransTrackArray[i].GetPos(&Joint._Trans, KeyIndex0, KeyIndex1, Alpha);
+		}
+		return;
+	}
+
+	for(int i=0;i<JointCount;i++)
 	{
 		JointPose& Joint = InPose._LocalPoseArray[i];
+		int KeyIndex0, KeyIndex1;
+		float Alpha;
 
-		ScaleTrack& STrack = _ScaleTrackArray[i];
-		STrack.GetScale(&Joint._Scale, NormalizedTime, CurrentTime);
+		FindKeyIndices(_ScaleTrackArray[i]._TimeArray, CurrentTime, Keys ? Keys + i*ANIM_TRACK_TYPE_COUNT + ANIM_TRACK_SCALE : NULL, KeyIndex0, KeyIndex1, Alpha);
+		_ScaleTrackArray[i].GetScale(&Joint._Scale, KeyIndex0, KeyIndex1, Alpha);
 
-		RotationTrack& RTrack = _RotTrackArray[i];
-		RTrack.GetRot(&Joint._Rot, NormalizedTime, CurrentTime);
+		FindKeyIndices(_RotTrackArray[i]._TimeArray, CurrentTime, Keys ? Keys + i*ANIM_TRACK_TYPE_COUNT + ANIM_TRACK_ROTATION : NULL, KeyIndex0, KeyIndex1, Alpha);
+		_RotTrackArray[i].GetRot(&Joint._Rot, KeyIndex0, KeyIndex1, Alpha);
+
+		FindKeyIndices(_TransTrackArray[i]._TimeArray, CurrentTime, Keys ? Keys + i*ANIM_TRACK_TYPE_COUNT + ANIM_TRACK_TRANSLATION : NULL, KeyIndex0, KeyIndex1, Alpha);
+		_TransTrackArray[i].GetPos(&Joint._Trans, KeyIndex0, KeyIndex1, Alpha);
+	}
+}
 
+void AnimationClip::GetCurrentPose( SoaSkeletonPose& OutPose, float CurrentTime, EAnimSimd Simd ) const
+{
+	if(OutPose._JointCount != _SoaJointCount)
+		OutPose.Init(_SoaJointCount);
 
-		TranslationTrack& TTrack = _TransTrackArray[i];
-		TTrack.GetPos(&Joint._Trans, NormalizedTime, CurrentTime);
+	int KeyIndex0, KeyIndex1;
+	float Alpha;
+	GetUniformKeys(CurrentTime, KeyIndex0, KeyIndex1, Alpha);
+	const int BlockSize = ANIM_SOA_STREAM_COUNT * _SoaPaddedCount;
+	AnimationSampler::InterpolatePose(&_SoaKeyArray[KeyIndex0 * BlockSize], &_SoaKeyArray[KeyIndex1 * BlockSize], Alpha, _SoaPaddedCount, &OutPose._Data[0], Simd);
+}
+
+void AnimationClip::GetUniformKeys( float CurrentTime, int& KeyIndex0, int& KeyIndex1, float& Alpha ) const
+{
+	const float Frame = Math::Clamp<float>(CurrentTime * _SampleRate, 0.f, (float)(_FrameCount - 1));
+	KeyIndex0 = Math::Max<int>(Math::Min<int>((int)Frame, _FrameCount - 2), 0);
+	KeyIndex1 = Math::Min<int>(KeyIndex0 + 1, _FrameCount - 1);
+	Alpha = Math::Clamp<float>(Frame - KeyIndex0, 0.f, 1.f);
+}
+
+int AnimationClip::GetJointCount() const
+{
+	if(HasSoaKeys())
+		return _SoaJointCount;
+	if(IsCompressed())
+		return _CompressedTrackArray.size() / ANIM_TRACK_TYPE_COUNT;
+	return _TransTrackArray.size();
+}
+
+bool AnimationClip::BuildSoaKeys()
+{
+	if(HasSoaKeys())
+		return true;
+	if(IsCompressed() || !MakeUniform() || _TransTrackArray.size() == 0)
+		return false;
+
+	SoaSkeletonPose Block;
+	Block.Init(_TransTrackArray.size());
+	const int BlockSize = Block._Data.size();
+	_SoaJointCount = Block._JointCount;
+	_SoaPaddedCount = Block._PaddedCount;
+	_SoaKeyArray.resize(BlockSize * _FrameCount);
+	for(int f=0;f<_FrameCount;f++)
+	{
+		// start every frame from the identity padding
+		float* Keys = &_SoaKeyArray[f * BlockSize];
+		std::copy(Block._Data.begin(), Block._Data.end(), Keys);
+		for(int i=0;i<_SoaJointCount;i++)
+		{
+			JointPose Joint;
+			Joint._Rot = _RotTrackArray[i]._RotArray[f];
+			Joint._Trans = _TransTrackArray[i]._PosArray[f];
+			Joint._Scale = _ScaleTrackArray[i]._ScaleArray[f];
+			AnimationSampler::StoreJoint(Joint, _SoaPaddedCount, i, Keys);
+		}
 	}
+
+	std::vector<TranslationTrack>().swap(_TransTrackArray);
+	std::vector<RotationTrack>().swap(_RotTrackArray);
+	std::vector<ScaleTrack>().swap(_ScaleTrackArray);
+	return true;
 }
 
-void FindKeyIndices(std::vector<float>& TimeArray, float NormalizedTime, float LocalTime, int& KeyIndex0, int& KeyIndex1, float& Alpha)
+bool AnimationClip::MakeUniform()
 {
-	int EstimatedKeyIndex = TimeArray.size() * NormalizedTime;
-	if(EstimatedKeyIndex == 0)
+	if(IsUniform() || IsCompressed() || _RotTrackArray.size() == 0)
+		return IsUniform();
+
+	const std::vector<float>& TimeArray = _RotTrackArray[0]._TimeArray;
+	const int FrameCount = TimeArray.size();
+	if(FrameCount == 0)
+		return false;
+
+	const float FrameTime = FrameCount > 1 ? (TimeArray[FrameCount-1] - TimeArray[0]) / (FrameCount - 1) : 0.f;
+	for(int f=0;f<FrameCount;f++)
 	{
-		KeyIndex1 = 1;//TimeArray.size()-1;
-		KeyIndex0 = 0;//KeyIndex1 - 1;
+		if(fabsf(TimeArray[f] - TimeArray[0] - FrameTime * f) > FrameTime * 0.01f)
+			return false;
 	}
-	else
+	for(unsigned int i=0;i<_RotTrackArray.size();i++)
 	{
-		while(TimeArray[EstimatedKeyIndex] >= LocalTime)
+		if(_RotTrackArray[i]._TimeArray != TimeArray || _TransTrackArray[i]._TimeArray != TimeArray || _ScaleTrackArray[i]._TimeArray != TimeArray
+			|| (int)_RotTrackArray[i]._RotArray.size() != FrameCount
+			|| (int)_TransTrackArray[i]._PosArray.size() != FrameCount
+			|| (int)_ScaleTrackArray[i]._ScaleArray.size() != FrameCount)
+			return false;
+	}
+
+	_SampleRate = FrameTime > 0.f ? 1.f / FrameTime : 0.f;
+	_FrameCount = FrameCount;
+	for(unsigned int i=0;i<_RotTrackArray.size();i++)
+	{
+		std::vector<float>().swap(_RotTrackArray[i]._TimeArray);
+		std::vector<float>().swap(_TransTrackArray[i]._TimeArray);
+		std::vector<float>().swap(_ScaleTrackArray[i]._TimeArray);
+	}
+	return true;
+}
+
+AnimationClip* AnimationClip::CreateSynthetic( int JointCount, int FrameCount, float SampleRate, bool bKeepTimes, float TimeJitter )
+{
+	AnimationClip* Clip = new AnimationClip;
+	Clip->_SampleRate = bKeepTimes ? 0.f : SampleRate;
+	Clip->_FrameCount = bKeepTimes ? 0 : FrameCount;
+	Clip->_Duration = (FrameCount - 1) / SampleRate;
+	Clip->_TransTrackArray.resize(JointCount);
+	Clip->_RotTrackArray.resize(JointCount);
+	Clip->_ScaleTrackArray.resize(JointCount);
+	for(int i=0;i<JointCount;i++)
+	{
+		const XMVECTOR Axis = XMVector3Normalize(XMVectorSet((float)(i % 3), 1.f, (float)(i % 5), 0.f));
+		for(int f=0;f<FrameCount;f++)
 		{
-			EstimatedKeyIndex--;
+			const float Jitter = bKeepTimes && f > 0 && f < FrameCount - 1 ? (rand() / (float)RAND_MAX * 2.f - 1.f) * TimeJitter : 0.f;
+			const float Time = (f + Jitter) / SampleRate;
+			XMFLOAT4 Rot;
+			XMStoreFloat4(&Rot, XMQuaternionRotationAxis(Axis, sinf(Time * 2.f + i) * XM_PI * 0.5f));
+			Clip->_RotTrackArray[i]._RotArray.push_back(Rot);
+			Clip->_TransTrackArray[i]._PosArray.push_back(XMFLOAT3(10.f, 0.f, sinf(Time + i)));
+			Clip->_ScaleTrackArray[i]._ScaleArray.push_back(XMFLOAT3(1.f, 1.f, 1.f));
+			if(bKeepTimes)
+			{
+				Clip->_RotTrackArray[i]._TimeArray.push_back(Time);
+				Clip->_TransTrackArray[i]._TimeArray.push_back(Time);
+				Clip->_ScaleTrackArray[i]._TimeArray.push_back(Time);
+			}
 		}
-	
-		KeyIndex0 = EstimatedKeyIndex;
-		KeyIndex1 = EstimatedKeyIndex + 1;
 	}
+	return Clip;
+}
 
-	Alpha = (LocalTime - TimeArray[KeyIndex0])/(TimeArray[KeyIndex1] - TimeArray[KeyIndex0]);
+template<class T>
+static int GetArrayBytes(const std::vector<T>& Array)
+{
+	return Array.size() * sizeof(T);
 }
 
-void TranslationTrack::GetPos(XMFLOAT3* OutPos, float NormalizedTime, float LocalTime)
+int AnimationClip::GetMemorySize() const
 {
-	int KeyIndex0, KeyIndex1;
-	float Alpha;
-	
-	FindKeyIndices(_TimeArray, NormalizedTime, LocalTime, KeyIndex0, KeyIndex1, Alpha);
-	
-	XMStoreFloat3(OutPos, XMVectorLerp(XMLoadFloat3(&_PosArray[KeyIndex0]), XMLoadFloat3(&_PosArray[KeyIndex1]), Alpha));
+	int Size = GetArrayBytes(_CompressedTrackArray) + GetArrayBytes(_KeyFrameArray) + GetArrayBytes(_KeyDataArray) + GetArrayBytes(_SoaKeyArray);
+	for(unsigned int i=0;i<_TransTrackArray.size();i++)
+	{
+		Size += GetArrayBytes(_TransTrackArray[i]._TimeArray) + GetArrayBytes(_TransTrackArray[i]._PosArray)
+			+ GetArrayBytes(_RotTrackArray[i]._TimeArray) + GetArrayBytes(_RotTrackArray[i]._RotArray)
+			+ GetArrayBytes(_ScaleTrackArray[i]._TimeArray) + GetArrayBytes(_ScaleTrackArray[i]._ScaleArray);
+	}
+	return Size;
 }
 
-void RotationTrack::GetRot(XMFLOAT4* OutRot, float NormalizedTime, float LocalTime)
+void TranslationTrack::GetPos(XMFLOAT3* OutPos, int KeyIndex0, int KeyIndex1, float Alpha) const
 {
-	int KeyIndex0, KeyIndex1;
-	float Alpha;
+	XMStoreFloat3(OutPos, XMVectorLerp(XMLoadFloat3(&_PosArray[KeyIndex0]), XMLoadFloat3(&_PosArray[KeyIndex1]), Alpha));
+}
 
-	FindKeyIndices(_TimeArray, NormalizedTime, LocalTime, KeyIndex0, KeyIndex1, Alpha);
+void RotationTrack::GetRot(XMFLOAT4* OutRot, int KeyIndex0, int KeyIndex1, float Alpha) const
+{
 	XMStoreFloat4(OutRot, XMQuaternionSlerp(XMLoadFloat4(&_RotArray[KeyIndex0]), XMLoadFloat4(&_RotArray[KeyIndex1]), Alpha));
 }
 
-void ScaleTrack::GetScale(XMFLOAT3* OutPos, float NormalizedTime, float LocalTime)
+void ScaleTrack::GetScale(XMFLOAT3* OutPos, int KeyIndex0, int KeyIndex1, float Alpha) const
 {
-	int KeyIndex0, KeyIndex1;
-	float Alpha;
-	
-	FindKeyIndices(_TimeArray, NormalizedTime, LocalTime, KeyIndex0, KeyIndex1, Alpha);
-	
 	XMStoreFloat3(OutPos, XMVectorLerp(XMLoadFloat3(&_ScaleArray[KeyIndex0]), XMLoadFloat3(&_ScaleArray[KeyIndex1]), Alpha));
 }
@@ -1,13 +1,15 @@
 #pragma once
 #include "BaseObject.h"
 #include "Skeleton.h"
+#include "AnimationCompression.h"
+#include "AnimationSampler.h"
 
 struct TranslationTrack
 {
 	std::vector<XMFLOAT3>	_PosArray;
-	std::vector<float>		_TimeArray;
+	std::vector<float>		_TimeArray;	// empty on uniformly sampled clips
 
-	void GetPos(XMFLOAT3* OutPos, float NormalizedTime, float LocalTime);
+	void GetPos(XMFLOAT3* OutPos, int KeyIndex0, int KeyIndex1, float Alpha) const;
 };
 
 struct RotationTrack
@@ -15,7 +17,7 @@ struct RotationTrack
 	std::vector<XMFLOAT4>	_RotArray;
 	std::vector<float>		_TimeArray;
 
-	void GetRot(XMFLOAT4* OutRot, float NormalizedTime, float LocalTime);
+	void GetRot(XMFLOAT4* OutRot, int KeyIndex0, int KeyIndex1, float Alpha) const;
 };
 
 struct ScaleTrack
@@ -23,7 +25,13 @@ struct ScaleTrack
 	std::vector<XMFLOAT3>	_ScaleArray;
 	std::vector<float>		_TimeArray;
 
-	void GetScale(XMFLOAT3* OutPos, float NormalizedTime, float LocalTime);
+	void GetScale(XMFLOAT3* OutPos, int KeyIndex0, int KeyIndex1, float Alpha) const;
+};
+
+// key index each track used last, owned by whoever plays the clip so the next search starts there
+struct AnimKeyCursor
+{
+	std::vector<int> _KeyArray;
 };
 
 class AnimationClip :
@@ -31,14 +39,56 @@ class AnimationClip :
 {
 	friend class FbxFileImporter;
 	friend class AnimClipInstance;
+	friend class CookedAnimation;
+	friend class AnimationCompressor;
 	float _Duration;
 	std::vector<TranslationTrack> _TransTrackArray;
 	std::vector<RotationTrack> _RotTrackArray;
 	std::vector<ScaleTrack> _ScaleTrackArray;
 
+	// uniform sampling, key i of a track is at i / _SampleRate and the time arrays are dropped.
+	// 0 frames for clips sampled at arbitrary times
+	float _SampleRate;
+	int _FrameCount;
+
+	// compressed form, the sampled tracks above are released once it is built. key frames index the uniform frames
+	std::vector<CompressedAnimTrack> _CompressedTrackArray;	// ANIM_TRACK_TYPE_COUNT per joint
+	std::vector<unsigned short> _KeyFrameArray;
+	std::vector<unsigned short> _KeyDataArray;
+
+	// runtime form of uniform uncompressed clips, the sampled tracks above are released once it is built.
+	// one block of ANIM_SOA_STREAM_COUNT streams of _SoaPaddedCount joints per frame
+	std::vector<float> _SoaKeyArray;
+	int _SoaJointCount;
+	int _SoaPaddedCount;
+
+	void GetUniformKeys(float CurrentTime, int& KeyIndex0, int& KeyIndex1, float& Alpha) const;
+
 public:
 
-	void GetCurrentPose(SkeletonPose& InPose, float CurrentTime);
+	// Cursor is optional, it makes the key search on key-reduced and non-uniform tracks follow playback
+	void GetCurrentPose(SkeletonPose& InPose, float CurrentTime, AnimKeyCursor* Cursor = NULL) const;
+
+	// blends whole joint groups per instruction, only for clips with SoA keys
+	void GetCurrentPose(SoaSkeletonPose& OutPose, float CurrentTime, EAnimSimd Simd) const;
+
+	// moves the keys of a uniform uncompressed clip into the SoA layout. the clip can't be compressed or cooked afterwards
+	bool BuildSoaKeys();
+
+	// drops the time arrays when every track has the same uniformly spaced keys, returns IsUniform()
+	bool MakeUniform();
+
+	bool IsUniform() const {return _FrameCount > 0;}
+	bool IsCompressed() const {return _CompressedTrackArray.size() != 0;}
+	bool HasSoaKeys() const {return _SoaKeyArray.size() != 0;}
+	int GetJointCount() const;
+	float GetDuration() const {return _Duration;}
+	// bytes held by the tracks
+	int GetMemorySize() const;
+
+	// uniform clip of a JointCount joint chain swinging on sines, for sampler benchmarks and tests.
+	// bKeepTimes keeps per-track key times like an imported clip, each key but the ends moved by up to TimeJitter frames
+	static AnimationClip* CreateSynthetic(int JointCount, int FrameCount, float SampleRate, bool bKeepTimes = false, float TimeJitter = 0.f);
 
 	AnimationClip(void);
 	virtual ~AnimationClip(void);
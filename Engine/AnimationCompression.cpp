@@ -0,0 +1,544 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "AnimationCompression.h"
+#include "AnimationClip.h"
+#include "MathUtil.h"
+
+// the three smaller components of a unit quaternion stay within +-1/sqrt(2)
+#define SMALLEST_THREE_RANGE	0.70710678f
+
+// quantization may use this part of a track budget, key reduction gets the rest
+#define ANIM_QUANTIZATION_SHARE	0.5f
+
+static unsigned short EncodeSmallestThree(float Value)
+{
+	Value = Math::Clamp<float>(Value / SMALLEST_THREE_RANGE * 0.5f + 0.5f, 0.f, 1.f) * 32767.f;
+	return (unsigned short)(Value + 0.5f);
+}
+
+static float DecodeSmallestThree(unsigned short Value)
+{
+	return ((Value & 0x7fff) / 32767.f * 2.f - 1.f) * SMALLEST_THREE_RANGE;
+}
+
+CompressedQuat EncodeQuat( const XMFLOAT4& Quat )
+{
+	const float Q[4] = {Quat.x, Quat.y, Quat.z, Quat.w};
+	int Largest = 0;
+	for(int i=1;i<4;i++)
+	{
+		if(fabsf(Q[i]) > fabsf(Q[Largest]))
+			Largest = i;
+	}
+
+	// q and -q are the same rotation, flip so the dropped component is positive
+	const float Sign = Q[Largest] < 0.f ? -1.f : 1.f;
+	CompressedQuat Out;
+	for(int i=0, k=0;i<4;i++)
+	{
+		if(i != Largest)
+			Out.Value[k++] = EncodeSmallestThree(Q[i] * Sign);
+	}
+	Out.Value[0] |= (unsigned short)((Largest & 1) << 15);
+	Out.Value[1] |= (unsigned short)((Largest >> 1) << 15);
+	return Out;
+}
+
+XMFLOAT4 DecodeQuat( const CompressedQuat& Quat )
+{
+	const int Largest = (Quat.Value[0] >> 15) | ((Quat.Value[1] >> 15) << 1);
+	float Q[4];
+	float SquaredSum = 0.f;
+	for(int i=0, k=0;i<4;i++)
+	{
+		if(i == Largest)
+			continue;
+		Q[i] = DecodeSmallestThree(Quat.Value[k++]);
+		SquaredSum += Q[i] * Q[i];
+	}
+	Q[Largest] = sqrtf(Math::Max<float>(1.f - SquaredSum, 0.f));
+	return XMFLOAT4(Q[0], Q[1], Q[2], Q[3]);
+}
+
+int GetAnimKeySize( unsigned int Format, unsigned int Type )
+{
+	switch(Format)
+	{
+	case ANIM_TRACK_QUANTIZED:	return 3;
+	case ANIM_TRACK_FLOAT:		return Type == ANIM_TRACK_ROTATION ? 8 : 6;
+	default:					return 0;
+	}
+}
+
+XMFLOAT4 DecodeAnimKey( const CompressedAnimTrack& Track, unsigned int Type, const unsigned short* KeyData, int KeyIndex )
+{
+	if(Track.Format == ANIM_TRACK_CONSTANT)
+		return Track.Value;
+
+	const unsigned short* Key = KeyData + Track.DataOffset + KeyIndex * GetAnimKeySize(Track.Format, Type);
+	XMFLOAT4 Out(0.f, 0.f, 0.f, 0.f);
+	if(Track.Format == ANIM_TRACK_FLOAT)
+	{
+		memcpy(&Out.x, Key, GetAnimKeySize(Track.Format, Type) * sizeof(unsigned short));
+	}
+	else if(Type == ANIM_TRACK_ROTATION)
+	{
+		Out = DecodeQuat(*(const CompressedQuat*)Key);
+	}
+	else
+	{
+		Out.x = Track.Value.x + Key[0] / 65535.f * Track.Extent.x;
+		Out.y = Track.Value.y + Key[1] / 65535.f * Track.Extent.y;
+		Out.z = Track.Value.z + Key[2] / 65535.f * Track.Extent.z;
+	}
+	return Out;
+}
+
+XMFLOAT4 InterpolateAnimKey( unsigned int Type, const XMFLOAT4& A, const XMFLOAT4& B, float Alpha )
+{
+	if(Type != ANIM_TRACK_ROTATION)
+	{
+		return XMFLOAT4(A.x + (B.x - A.x) * Alpha, A.y + (B.y - A.y) * Alpha, A.z + (B.z - A.z) * Alpha, 0.f);
+	}
+
+	// nlerp on the shorter arc, keys are dense enough that the speed difference to slerp stays in the error budget
+	const float Dot = A.x * B.x + A.y * B.y + A.z * B.z + A.w * B.w;
+	const float WeightB = Dot < 0.f ? -Alpha : Alpha;
+	const float WeightA = 1.f - Alpha;
+	XMFLOAT4 Out(A.x * WeightA + B.x * WeightB, A.y * WeightA + B.y * WeightB, A.z * WeightA + B.z * WeightB, A.w * WeightA + B.w * WeightB);
+	const float Length = sqrtf(Out.x * Out.x + Out.y * Out.y + Out.z * Out.z + Out.w * Out.w);
+	const float InvLength = Length > 0.f ? 1.f / Length : 0.f;
+	Out.x *= InvLength;
+	Out.y *= InvLength;
+	Out.z *= InvLength;
+	Out.w *= InvLength;
+	return Out;
+}
+
+XMFLOAT4 SampleAnimTrack( const CompressedAnimTrack& Track, unsigned int Type, const unsigned short* KeyFrames, const unsigned short* KeyData, float Frame, int* Cursor )
+{
+	if(Track.Format == ANIM_TRACK_CONSTANT || Track.KeyCount == 1)
+		return DecodeAnimKey(Track, Type, KeyData, 0);
+
+	// the first and last sampled frames are always keys
+	const unsigned short* First = KeyFrames + Track.KeyOffset;
+	const int LastKey = Track.KeyCount - 1;
+	int Key0 = Cursor ? *Cursor : -1;
+	if(First[LastKey] == LastKey)
+	{
+		// no key was removed, the frame is the key
+		Key0 = Math::Min<int>((int)Frame, LastKey - 1);
+	}
+	else if(Key0 >= 0 && Key0 < LastKey && First[Key0] <= Frame)
+	{
+		// playback moves forward from the key used last
+		while(Key0 < LastKey - 1 && First[Key0 + 1] <= Frame)
+			Key0++;
+	}
+	else
+	{
+		Key0 = std::upper_bound(First + 1, First + LastKey, Frame) - First - 1;
+	}
+	if(Cursor)
+		*Cursor = Key0;
+
+	const int Key1 = Key0 + 1;
+	const float Alpha = Math::Clamp<float>((Frame - First[Key0]) / (float)(First[Key1] - First[Key0]), 0.f, 1.f);
+	return InterpolateAnimKey(Type, DecodeAnimKey(Track, Type, KeyData, Key0), DecodeAnimKey(Track, Type, KeyData, Key1), Alpha);
+}
+
+// Rot * (Scale * p) + Trans as a 3x4 matrix, chained parent * child
+struct AnimMatrix
+{
+	float M[3][4];
+};
+
+static AnimMatrix MakeAnimMatrix(const XMFLOAT4& Rot, const XMFLOAT4& Trans, const XMFLOAT4& Scale)
+{
+	const float X = Rot.x, Y = Rot.y, Z = Rot.z, W = Rot.w;
+	const float R[3][3] =
+	{
+		{1.f - 2.f*(Y*Y + Z*Z),	2.f*(X*Y - Z*W),		2.f*(X*Z + Y*W)},
+		{2.f*(X*Y + Z*W),		1.f - 2.f*(X*X + Z*Z),	2.f*(Y*Z - X*W)},
+		{2.f*(X*Z - Y*W),		2.f*(Y*Z + X*W),		1.f - 2.f*(X*X + Y*Y)},
+	};
+	const float S[3] = {Scale.x, Scale.y, Scale.z};
+	const float T[3] = {Trans.x, Trans.y, Trans.z};
+
+	AnimMatrix Out;
+	for(int r=0;r<3;r++)
+	{
+		for(int c=0;c<3;c++)
+			Out.M[r][c] = R[r][c] * S[c];
+		Out.M[r][3] = T[r];
+	}
+	return Out;
+}
+
+static AnimMatrix MultiplyAnimMatrix(const AnimMatrix& A, const AnimMatrix& B)
+{
+	AnimMatrix Out;
+	for(int r=0;r<3;r++)
+	{
+		for(int c=0;c<4;c++)
+			Out.M[r][c] = A.M[r][0] * B.M[0][c] + A.M[r][1] * B.M[1][c] + A.M[r][2] * B.M[2][c] + (c == 3 ? A.M[r][3] : 0.f);
+	}
+	return Out;
+}
+
+// largest distance between A and B over the joint origin and six virtual vertices at Radius around it
+static float GetShellDistance(const AnimMatrix& A, const AnimMatrix& B, float Radius)
+{
+	float D[3][4];
+	for(int r=0;r<3;r++)
+	{
+		for(int c=0;c<4;c++)
+			D[r][c] = A.M[r][c] - B.M[r][c];
+	}
+
+	float MaxSquared = D[0][3] * D[0][3] + D[1][3] * D[1][3] + D[2][3] * D[2][3];
+	for(int c=0;c<3;c++)
+	{
+		for(float Side = -1.f;Side <= 1.f;Side += 2.f)
+		{
+			const float X = D[0][3] + D[0][c] * Radius * Side;
+			const float Y = D[1][3] + D[1][c] * Radius * Side;
+			const float Z = D[2][3] + D[2][c] * Radius * Side;
+			MaxSquared = Math::Max<float>(MaxSquared, X * X + Y * Y + Z * Z);
+		}
+	}
+	return sqrtf(MaxSquared);
+}
+
+// how far a local channel error moves the virtual vertices of the joint in parent space
+static float GetTrackError(unsigned int Type, const XMFLOAT4& A, const XMFLOAT4& B, float Radius)
+{
+	switch(Type)
+	{
+	case ANIM_TRACK_ROTATION:
+		{
+			// chord of the rotation angle, twice the sine of the half angle is the vector part of conj(A) * B.
+			// taken from the vector part instead of the dot product, which loses small angles to rounding
+			const float X = A.w * B.x - B.w * A.x - (A.y * B.z - A.z * B.y);
+			const float Y = A.w * B.y - B.w * A.y - (A.z * B.x - A.x * B.z);
+			const float Z = A.w * B.z - B.w * A.z - (A.x * B.y - A.y * B.x);
+			return 2.f * Radius * sqrtf(X * X + Y * Y + Z * Z);
+		}
+	case ANIM_TRACK_TRANSLATION:
+		{
+			const float X = A.x - B.x, Y = A.y - B.y, Z = A.z - B.z;
+			return sqrtf(X * X + Y * Y + Z * Z);
+		}
+	default:
+		return Radius * Math::Max<float>(fabsf(A.x - B.x), Math::Max<float>(fabsf(A.y - B.y), fabsf(A.z - B.z)));
+	}
+}
+
+static void EncodeAnimKey(const CompressedAnimTrack& Track, unsigned int Type, const XMFLOAT4& Value, unsigned short* OutKey)
+{
+	if(Track.Format == ANIM_TRACK_FLOAT)
+	{
+		memcpy(OutKey, &Value, GetAnimKeySize(Track.Format, Type) * sizeof(unsigned short));
+	}
+	else if(Type == ANIM_TRACK_ROTATION)
+	{
+		const CompressedQuat Quat = EncodeQuat(Value);
+		memcpy(OutKey, Quat.Value, sizeof(CompressedQuat));
+	}
+	else
+	{
+		const float V[3] = {Value.x, Value.y, Value.z};
+		const float Min[3] = {Track.Value.x, Track.Value.y, Track.Value.z};
+		const float Extent[3] = {Track.Extent.x, Track.Extent.y, Track.Extent.z};
+		for(int i=0;i<3;i++)
+		{
+			const float Normalized = Extent[i] > 0.f ? Math::Clamp<float>((V[i] - Min[i]) / Extent[i], 0.f, 1.f) : 0.f;
+			OutKey[i] = (unsigned short)(Normalized * 65535.f + 0.5f);
+		}
+	}
+}
+
+// value a constant track would hold, OutError is how far the track strays from it.
+// rotations are already in one hemisphere so their normalized average is meaningful
+static XMFLOAT4 GetConstantValue(unsigned int Type, const XMFLOAT4* Source, int FrameCount, float Radius, float& OutError)
+{
+	XMFLOAT4 Average(0.f, 0.f, 0.f, 0.f);
+	for(int f=0;f<FrameCount;f++)
+	{
+		Average.x += Source[f].x;
+		Average.y += Source[f].y;
+		Average.z += Source[f].z;
+		Average.w += Source[f].w;
+	}
+	Average = Type == ANIM_TRACK_ROTATION ? InterpolateAnimKey(Type, Average, Average, 0.f)
+		: XMFLOAT4(Average.x / FrameCount, Average.y / FrameCount, Average.z / FrameCount, 0.f);
+
+	OutError = 0.f;
+	for(int f=0;f<FrameCount;f++)
+		OutError = Math::Max<float>(OutError, GetTrackError(Type, Source[f], Average, Radius));
+	return Average;
+}
+
+static void SetConstantTrack(const XMFLOAT4& Value, int FrameCount, CompressedAnimTrack& OutTrack,
+	const std::vector<unsigned short>& KeyFrameArray, const std::vector<unsigned short>& KeyDataArray, XMFLOAT4* OutDecoded)
+{
+	OutTrack.Format = ANIM_TRACK_CONSTANT;
+	OutTrack.KeyOffset = KeyFrameArray.size();
+	OutTrack.DataOffset = KeyDataArray.size();
+	OutTrack.KeyCount = 0;
+	OutTrack.Value = Value;
+	OutTrack.Extent = XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+	for(int f=0;f<FrameCount;f++)
+		OutDecoded[f] = Value;
+}
+
+// picks the cheaper key format and the fewest keys that keep Source within Budget, OutDecoded gets what the runtime will sample
+static void CompressTrack(unsigned int Type, const XMFLOAT4* Source, int FrameCount, float Budget, float Radius,
+	CompressedAnimTrack& OutTrack, std::vector<unsigned short>& KeyFrameArray, std::vector<unsigned short>& KeyDataArray, XMFLOAT4* OutDecoded)
+{
+	OutTrack.KeyOffset = KeyFrameArray.size();
+	OutTrack.DataOffset = KeyDataArray.size();
+	OutTrack.KeyCount = 0;
+	OutTrack.Extent = XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+
+	// quantized keys when they fit the budget, float keys otherwise
+	OutTrack.Format = ANIM_TRACK_QUANTIZED;
+	OutTrack.Value = Source[0];
+	if(Type != ANIM_TRACK_ROTATION)
+	{
+		XMFLOAT4 Max = Source[0];
+		for(int f=1;f<FrameCount;f++)
+		{
+			OutTrack.Value.x = Math::Min<float>(OutTrack.Value.x, Source[f].x);
+			OutTrack.Value.y = Math::Min<float>(OutTrack.Value.y, Source[f].y);
+			OutTrack.Value.z = Math::Min<float>(OutTrack.Value.z, Source[f].z);
+			Max.x = Math::Max<float>(Max.x, Source[f].x);
+			Max.y = Math::Max<float>(Max.y, Source[f].y);
+			Max.z = Math::Max<float>(Max.z, Source[f].z);
+		}
+		OutTrack.Value.w = 0.f;
+		OutTrack.Extent = XMFLOAT4(Max.x - OutTrack.Value.x, Max.y - OutTrack.Value.y, Max.z - OutTrack.Value.z, 0.f);
+	}
+
+	std::vector<XMFLOAT4> KeyArray(FrameCount);
+	CompressedAnimTrack KeyTrack = OutTrack;
+	KeyTrack.DataOffset = 0;
+	unsigned short Key[8];
+	float QuantizationError = 0.f;
+	for(int f=0;f<FrameCount;f++)
+	{
+		EncodeAnimKey(KeyTrack, Type, Source[f], Key);
+		KeyArray[f] = DecodeAnimKey(KeyTrack, Type, Key, 0);
+		QuantizationError = Math::Max<float>(QuantizationError, GetTrackError(Type, Source[f], KeyArray[f], Radius));
+	}
+	if(QuantizationError > Budget * ANIM_QUANTIZATION_SHARE)
+	{
+		OutTrack.Format = ANIM_TRACK_FLOAT;
+		OutTrack.Value = XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+		OutTrack.Extent = XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+		KeyArray.assign(Source, Source + FrameCount);
+	}
+
+	// top down key reduction, a span gets split at its worst frame until every frame is within the budget
+	std::vector<char> KeepArray(FrameCount, 0);
+	KeepArray[0] = 1;
+	KeepArray[FrameCount-1] = 1;
+	std::vector<std::pair<int, int> > SpanStack;
+	SpanStack.push_back(std::make_pair(0, FrameCount-1));
+	while(SpanStack.size())
+	{
+		const int Begin = SpanStack.back().first;
+		const int End = SpanStack.back().second;
+		SpanStack.pop_back();
+
+		int WorstFrame = -1;
+		float WorstError = Budget;
+		for(int f=Begin+1;f<End;f++)
+		{
+			const XMFLOAT4 Value = InterpolateAnimKey(Type, KeyArray[Begin], KeyArray[End], (f - Begin) / (float)(End - Begin));
+			const float Error = GetTrackError(Type, Source[f], Value, Radius);
+			if(Error > WorstError)
+			{
+				WorstError = Error;
+				WorstFrame = f;
+			}
+		}
+
+		if(WorstFrame >= 0)
+		{
+			KeepArray[WorstFrame] = 1;
+			SpanStack.push_back(std::make_pair(Begin, WorstFrame));
+			SpanStack.push_back(std::make_pair(WorstFrame, End));
+		}
+	}
+
+	const int KeySize = GetAnimKeySize(OutTrack.Format, Type);
+	int PrevKey = 0;
+	for(int f=0;f<FrameCount;f++)
+	{
+		if(!KeepArray[f])
+			continue;
+
+		KeyFrameArray.push_back((unsigned short)f);
+		KeyDataArray.resize(KeyDataArray.size() + KeySize);
+		EncodeAnimKey(OutTrack, Type, Source[f], &KeyDataArray[KeyDataArray.size() - KeySize]);
+		OutTrack.KeyCount++;
+
+		OutDecoded[f] = KeyArray[f];
+		for(int i=PrevKey+1;i<f;i++)
+			OutDecoded[i] = InterpolateAnimKey(Type, KeyArray[PrevKey], KeyArray[f], (i - PrevKey) / (float)(f - PrevKey));
+		PrevKey = f;
+	}
+}
+
+bool AnimationCompressor::Compress( AnimationClip& Clip, const std::vector<int>& ParentArray, float MaxError, AnimCompressionError& OutError )
+{
+	const int JointCount = Clip._RotTrackArray.size();
+	if(JointCount == 0 || (int)ParentArray.size() != JointCount || Clip.IsCompressed())
+		return false;
+
+	// key frame indices are stored in 16 bits
+	if(!Clip.MakeUniform() || Clip._FrameCount > 0x10000)
+		return false;
+	const int FrameCount = Clip._FrameCount;
+
+	for(int j=0;j<JointCount;j++)
+	{
+		if(ParentArray[j] >= j)
+			return false;
+	}
+
+	OutError.RawSize = Clip.GetMemorySize();
+
+	// source keys by channel, joint major. rotations are normalized and kept in the hemisphere of the previous key
+	std::vector<XMFLOAT4> SourceArray[ANIM_TRACK_TYPE_COUNT];
+	for(int t=0;t<ANIM_TRACK_TYPE_COUNT;t++)
+		SourceArray[t].resize(JointCount * FrameCount);
+	for(int j=0;j<JointCount;j++)
+	{
+		for(int f=0;f<FrameCount;f++)
+		{
+			const XMFLOAT4& Rot = Clip._RotTrackArray[j]._RotArray[f];
+			const XMFLOAT3& Trans = Clip._TransTrackArray[j]._PosArray[f];
+			const XMFLOAT3& Scale = Clip._ScaleTrackArray[j]._ScaleArray[f];
+			XMFLOAT4 Prev = f > 0 ? SourceArray[ANIM_TRACK_ROTATION][j*FrameCount + f-1] : Rot;
+			SourceArray[ANIM_TRACK_ROTATION][j*FrameCount + f] = InterpolateAnimKey(ANIM_TRACK_ROTATION, Prev, Rot, 1.f);
+			SourceArray[ANIM_TRACK_TRANSLATION][j*FrameCount + f] = XMFLOAT4(Trans.x, Trans.y, Trans.z, 0.f);
+			SourceArray[ANIM_TRACK_SCALE][j*FrameCount + f] = XMFLOAT4(Scale.x, Scale.y, Scale.z, 0.f);
+		}
+	}
+
+	// virtual vertex radius and chain height below every joint, children come after their parents
+	std::vector<float> RadiusArray(JointCount, ANIM_SHELL_DISTANCE);
+	std::vector<int> HeightArray(JointCount, 0);
+	for(int j=JointCount-1;j>=0;j--)
+	{
+		const int Parent = ParentArray[j];
+		if(Parent < 0)
+			continue;
+
+		float BoneLength = 0.f;
+		for(int f=0;f<FrameCount;f++)
+			BoneLength = Math::Max<float>(BoneLength, GetTrackError(ANIM_TRACK_TRANSLATION, SourceArray[ANIM_TRACK_TRANSLATION][j*FrameCount + f], XMFLOAT4(0.f, 0.f, 0.f, 0.f), 0.f));
+		RadiusArray[Parent] = Math::Max<float>(RadiusArray[Parent], BoneLength + RadiusArray[j]);
+		HeightArray[Parent] = Math::Max<int>(HeightArray[Parent], HeightArray[j] + 1);
+	}
+
+	std::vector<AnimMatrix> SourceModelArray(JointCount * FrameCount);
+	std::vector<AnimMatrix> CompressedModelArray(JointCount * FrameCount);
+	for(int j=0;j<JointCount;j++)
+	{
+		for(int f=0;f<FrameCount;f++)
+		{
+			const int i = j*FrameCount + f;
+			const AnimMatrix Local = MakeAnimMatrix(SourceArray[ANIM_TRACK_ROTATION][i], SourceArray[ANIM_TRACK_TRANSLATION][i], SourceArray[ANIM_TRACK_SCALE][i]);
+			SourceModelArray[i] = ParentArray[j] >= 0 ? MultiplyAnimMatrix(SourceModelArray[ParentArray[j]*FrameCount + f], Local) : Local;
+		}
+	}
+
+	std::vector<CompressedAnimTrack> TrackArray(JointCount * ANIM_TRACK_TYPE_COUNT);
+	std::vector<unsigned short> KeyFrameArray;
+	std::vector<unsigned short> KeyDataArray;
+	std::vector<XMFLOAT4> DecodedArray[ANIM_TRACK_TYPE_COUNT];
+	for(int t=0;t<ANIM_TRACK_TYPE_COUNT;t++)
+		DecodedArray[t].resize(FrameCount);
+
+	for(int j=0;j<JointCount;j++)
+	{
+		const int Parent = ParentArray[j];
+
+		// error the already compressed parents put on this joint
+		float ChainError = 0.f;
+		if(Parent >= 0)
+		{
+			for(int f=0;f<FrameCount;f++)
+			{
+				const int i = j*FrameCount + f;
+				const AnimMatrix Local = MakeAnimMatrix(SourceArray[ANIM_TRACK_ROTATION][i], SourceArray[ANIM_TRACK_TRANSLATION][i], SourceArray[ANIM_TRACK_SCALE][i]);
+				const AnimMatrix Model = MultiplyAnimMatrix(CompressedModelArray[Parent*FrameCount + f], Local);
+				ChainError = Math::Max<float>(ChainError, GetShellDistance(Model, SourceModelArray[i], RadiusArray[j]));
+			}
+		}
+
+		// what is left is shared with the longest chain below
+		const float Budget = Math::Max<float>(MaxError - ChainError, 0.f) / (HeightArray[j] + 1);
+
+		// constant channels first, they usually cost next to nothing and leave the rest to the animated ones
+		XMFLOAT4 ConstantValue[ANIM_TRACK_TYPE_COUNT];
+		bool bConstant[ANIM_TRACK_TYPE_COUNT];
+		float AnimatedBudget = Budget;
+		int AnimatedCount = 0;
+		for(int t=0;t<ANIM_TRACK_TYPE_COUNT;t++)
+		{
+			float ConstantError;
+			ConstantValue[t] = GetConstantValue(t, &SourceArray[t][j*FrameCount], FrameCount, RadiusArray[j], ConstantError);
+			bConstant[t] = ConstantError <= Budget / ANIM_TRACK_TYPE_COUNT;
+			if(bConstant[t])
+				AnimatedBudget -= ConstantError;
+			else
+				AnimatedCount++;
+		}
+
+		for(int t=0;t<ANIM_TRACK_TYPE_COUNT;t++)
+		{
+			CompressedAnimTrack& Track = TrackArray[j*ANIM_TRACK_TYPE_COUNT + t];
+			if(bConstant[t])
+				SetConstantTrack(ConstantValue[t], FrameCount, Track, KeyFrameArray, KeyDataArray, &DecodedArray[t][0]);
+			else
+				CompressTrack(t, &SourceArray[t][j*FrameCount], FrameCount, AnimatedBudget / AnimatedCount, RadiusArray[j], Track, KeyFrameArray, KeyDataArray, &DecodedArray[t][0]);
+		}
+
+		for(int f=0;f<FrameCount;f++)
+		{
+			const AnimMatrix Local = MakeAnimMatrix(DecodedArray[ANIM_TRACK_ROTATION][f], DecodedArray[ANIM_TRACK_TRANSLATION][f], DecodedArray[ANIM_TRACK_SCALE][f]);
+			CompressedModelArray[j*FrameCount + f] = Parent >= 0 ? MultiplyAnimMatrix(CompressedModelArray[Parent*FrameCount + f], Local) : Local;
+		}
+	}
+
+	OutError.MaxError = 0.f;
+	OutError.MaxErrorJoint = 0;
+	for(int j=0;j<JointCount;j++)
+	{
+		for(int f=0;f<FrameCount;f++)
+		{
+			const float Error = GetShellDistance(CompressedModelArray[j*FrameCount + f], SourceModelArray[j*FrameCount + f], RadiusArray[j]);
+			if(Error > OutError.MaxError)
+			{
+				OutError.MaxError = Error;
+				OutError.MaxErrorJoint = j;
+			}
+		}
+	}
+
+	Clip._CompressedTrackArray.swap(TrackArray);
+	Clip._KeyFrameArray.swap(KeyFrameArray);
+	Clip._KeyDataArray.swap(KeyDataArray);
+	std::vector<TranslationTrack>().swap(Clip._TransTrackArray);
+	std::vector<RotationTrack>().swap(Clip._RotTrackArray);
+	std::vector<ScaleTrack>().swap(Clip._ScaleTrackArray);
+
+	OutError.CompressedSize = Clip.GetMemorySize();
+	return true;
+}
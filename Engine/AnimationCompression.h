@@ -0,0 +1,79 @@
+#pragma once
+#include "MathTypes.h"
+#include <vector>
+
+class AnimationClip;
+
+// compressed animation tracks
+//   rotation    : smallest three, 15 bits per component, the dropped component index in the top bits
+//   translation : uint16 xyz inside the track range
+//   scale       : uint16 xyz inside the track range
+// a track that never moves further than its error budget is stored as one constant value,
+// a track whose quantization misses the budget keeps float keys
+
+#define ANIM_MAX_ERROR			0.01f	// model space distance in scene units (cm)
+#define ANIM_SHELL_DISTANCE		3.f		// virtual vertices this far past every joint stand in for the skin
+
+enum EAnimTrackFormat
+{
+	ANIM_TRACK_CONSTANT,
+	ANIM_TRACK_QUANTIZED,
+	ANIM_TRACK_FLOAT,
+};
+
+enum EAnimTrackType
+{
+	ANIM_TRACK_ROTATION,
+	ANIM_TRACK_TRANSLATION,
+	ANIM_TRACK_SCALE,
+	ANIM_TRACK_TYPE_COUNT,
+};
+
+// one channel of one joint, keys index the clip wide key arrays
+struct CompressedAnimTrack
+{
+	unsigned int	Format;
+	unsigned int	KeyOffset;		// into AnimationClip::_KeyFrameArray
+	unsigned int	KeyCount;
+	unsigned int	DataOffset;		// into AnimationClip::_KeyDataArray
+	XMFLOAT4		Value;			// constant value, or the quantization minimum
+	XMFLOAT4		Extent;			// quantization range
+};
+
+struct CompressedQuat
+{
+	unsigned short Value[3];
+};
+
+struct AnimCompressionError
+{
+	float	MaxError;		// measured on the virtual vertices in model space
+	int		MaxErrorJoint;
+	int		RawSize;
+	int		CompressedSize;
+};
+
+CompressedQuat EncodeQuat(const XMFLOAT4& Quat);
+XMFLOAT4 DecodeQuat(const CompressedQuat& Quat);
+
+// key data words used by one key of a track
+int GetAnimKeySize(unsigned int Format, unsigned int Type);
+
+// decodes key KeyIndex of Track, Type selects the channel layout
+XMFLOAT4 DecodeAnimKey(const CompressedAnimTrack& Track, unsigned int Type, const unsigned short* KeyData, int KeyIndex);
+
+// lerp, or nlerp on the shorter arc for rotations. compressor and runtime both interpolate this way
+XMFLOAT4 InterpolateAnimKey(unsigned int Type, const XMFLOAT4& A, const XMFLOAT4& B, float Alpha);
+
+// value of Track at a fractional sampled frame. Cursor is optional, it holds the key used last and
+// turns the key search into a short forward walk while playback moves forward
+XMFLOAT4 SampleAnimTrack(const CompressedAnimTrack& Track, unsigned int Type, const unsigned short* KeyFrames, const unsigned short* KeyData, float Frame, int* Cursor);
+
+class AnimationCompressor
+{
+public:
+	// replaces the sampled tracks of Clip with compressed ones. ParentArray holds the parent joint of every track,
+	// parents before children. every joint stays within MaxError of the source in model space, measured along
+	// the whole joint chain. returns false and leaves the tracks untouched when the clip is not uniformly sampled.
+	static bool Compress(AnimationClip& Clip, const std::vector<int>& ParentArray, float MaxError, AnimCompressionError& OutError);
+};
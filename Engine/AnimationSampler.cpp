@@ -0,0 +1,248 @@
+#include <math.h>
+
+#include "AnimationSampler.h"
+
+#if defined(ANIM_SAMPLER_SSE)
+#include <emmintrin.h>
+#endif
+#if defined(ANIM_SAMPLER_AVX2)
+#include <immintrin.h>
+#endif
+
+void SoaSkeletonPose::Init( int JointCount )
+{
+	_JointCount = JointCount;
+	_PaddedCount = GetSoaPaddedCount(JointCount);
+	_Data.assign(ANIM_SOA_STREAM_COUNT * _PaddedCount, 0.f);
+
+	// padding joints stay identity so normalizing them never divides by zero
+	for(int j=0;j<_PaddedCount;j++)
+	{
+		GetStream(ANIM_SOA_ROT_W)[j] = 1.f;
+		GetStream(ANIM_SOA_SCALE_X)[j] = 1.f;
+		GetStream(ANIM_SOA_SCALE_Y)[j] = 1.f;
+		GetStream(ANIM_SOA_SCALE_Z)[j] = 1.f;
+	}
+}
+
+void SoaSkeletonPose::FromSkeletonPose( const SkeletonPose& InPose )
+{
+	if(_JointCount != (int)InPose._LocalPoseArray.size())
+		Init(InPose._LocalPoseArray.size());
+	for(int j=0;j<_JointCount;j++)
+		AnimationSampler::StoreJoint(InPose._LocalPoseArray[j], _PaddedCount, j, &_Data[0]);
+}
+
+void SoaSkeletonPose::ToSkeletonPose( SkeletonPose& OutPose ) const
+{
+	OutPose._LocalPoseArray.resize(_JointCount);
+	for(int j=0;j<_JointCount;j++)
+	{
+		JointPose& Joint = OutPose._LocalPoseArray[j];
+		Joint._Rot = XMFLOAT4(GetStream(ANIM_SOA_ROT_X)[j], GetStream(ANIM_SOA_ROT_Y)[j], GetStream(ANIM_SOA_ROT_Z)[j], GetStream(ANIM_SOA_ROT_W)[j]);
+		Joint._Trans = XMFLOAT3(GetStream(ANIM_SOA_TRANS_X)[j], GetStream(ANIM_SOA_TRANS_Y)[j], GetStream(ANIM_SOA_TRANS_Z)[j]);
+		Joint._Scale = XMFLOAT3(GetStream(ANIM_SOA_SCALE_X)[j], GetStream(ANIM_SOA_SCALE_Y)[j], GetStream(ANIM_SOA_SCALE_Z)[j]);
+	}
+}
+
+EAnimSimd AnimationSampler::GetBestSimd()
+{
+#if defined(ANIM_SAMPLER_AVX2)
+	return ANIM_SIMD_AVX2;
+#elif defined(ANIM_SAMPLER_SSE)
+	return ANIM_SIMD_SSE;
+#else
+	return ANIM_SIMD_SCALAR;
+#endif
+}
+
+static void InterpolatePoseScalar(const float* Keys0, const float* Keys1, float Alpha, int PaddedCount, float* Out)
+{
+	for(int j=0;j<PaddedCount;j++)
+	{
+		float Rot0[4], Rot1[4];
+		float Dot = 0.f;
+		for(int c=0;c<4;c++)
+		{
+			Rot0[c] = Keys0[(ANIM_SOA_ROT_X + c) * PaddedCount + j];
+			Rot1[c] = Keys1[(ANIM_SOA_ROT_X + c) * PaddedCount + j];
+			Dot += Rot0[c] * Rot1[c];
+		}
+
+		const float Sign = Dot < 0.f ? -1.f : 1.f;
+		float Rot[4];
+		float SquaredLength = 0.f;
+		for(int c=0;c<4;c++)
+		{
+			Rot[c] = Rot0[c] + (Rot1[c] * Sign - Rot0[c]) * Alpha;
+			SquaredLength += Rot[c] * Rot[c];
+		}
+		const float InvLength = 1.f / sqrtf(SquaredLength);
+		for(int c=0;c<4;c++)
+			Out[(ANIM_SOA_ROT_X + c) * PaddedCount + j] = Rot[c] * InvLength;
+
+		for(int s=ANIM_SOA_TRANS_X;s<ANIM_SOA_STREAM_COUNT;s++)
+		{
+			const float Value0 = Keys0[s * PaddedCount + j];
+			Out[s * PaddedCount + j] = Value0 + (Keys1[s * PaddedCount + j] - Value0) * Alpha;
+		}
+	}
+}
+
+#if defined(ANIM_SAMPLER_SSE)
+static void InterpolatePoseSSE(const float* Keys0, const float* Keys1, float Alpha, int PaddedCount, float* Out)
+{
+	const __m128 VAlpha = _mm_set1_ps(Alpha);
+	const __m128 SignMask = _mm_set1_ps(-0.f);
+	const __m128 Half = _mm_set1_ps(0.5f);
+	const __m128 ThreeHalves = _mm_set1_ps(1.5f);
+
+	for(int j=0;j<PaddedCount;j+=4)
+	{
+		__m128 Rot0[4], Rot1[4];
+		for(int c=0;c<4;c++)
+		{
+			Rot0[c] = _mm_loadu_ps(Keys0 + (ANIM_SOA_ROT_X + c) * PaddedCount + j);
+			Rot1[c] = _mm_loadu_ps(Keys1 + (ANIM_SOA_ROT_X + c) * PaddedCount + j);
+		}
+
+		// sign bit of the dot product flips the second key onto the shorter arc
+		__m128 Dot = _mm_mul_ps(Rot0[0], Rot1[0]);
+		Dot = _mm_add_ps(Dot, _mm_mul_ps(Rot0[1], Rot1[1]));
+		Dot = _mm_add_ps(Dot, _mm_mul_ps(Rot0[2], Rot1[2]));
+		Dot = _mm_add_ps(Dot, _mm_mul_ps(Rot0[3], Rot1[3]));
+		const __m128 Sign = _mm_and_ps(Dot, SignMask);
+
+		__m128 Rot[4];
+		__m128 SquaredLength = _mm_setzero_ps();
+		for(int c=0;c<4;c++)
+		{
+			Rot[c] = _mm_add_ps(Rot0[c], _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(Rot1[c], Sign), Rot0[c]), VAlpha));
+			SquaredLength = _mm_add_ps(SquaredLength, _mm_mul_ps(Rot[c], Rot[c]));
+		}
+
+		// rsqrt estimate plus one newton step
+		__m128 InvLength = _mm_rsqrt_ps(SquaredLength);
+		InvLength = _mm_mul_ps(InvLength, _mm_sub_ps(ThreeHalves, _mm_mul_ps(_mm_mul_ps(Half, SquaredLength), _mm_mul_ps(InvLength, InvLength))));
+		for(int c=0;c<4;c++)
+			_mm_storeu_ps(Out + (ANIM_SOA_ROT_X + c) * PaddedCount + j, _mm_mul_ps(Rot[c], InvLength));
+
+		for(int s=ANIM_SOA_TRANS_X;s<ANIM_SOA_STREAM_COUNT;s++)
+		{
+			const __m128 Value0 = _mm_loadu_ps(Keys0 + s * PaddedCount + j);
+			const __m128 Value1 = _mm_loadu_ps(Keys1 + s * PaddedCount + j);
+			_mm_storeu_ps(Out + s * PaddedCount + j, _mm_add_ps(Value0, _mm_mul_ps(_mm_sub_ps(Value1, Value0), VAlpha)));
+		}
+	}
+}
+#endif
+
+#if defined(ANIM_SAMPLER_AVX2)
+static void InterpolatePoseAVX2(const float* Keys0, const float* Keys1, float Alpha, int PaddedCount, float* Out)
+{
+	const __m256 VAlpha = _mm256_set1_ps(Alpha);
+	const __m256 SignMask = _mm256_set1_ps(-0.f);
+	const __m256 Half = _mm256_set1_ps(0.5f);
+	const __m256 ThreeHalves = _mm256_set1_ps(1.5f);
+
+	for(int j=0;j<PaddedCount;j+=8)
+	{
+		__m256 Rot0[4], Rot1[4];
+		for(int c=0;c<4;c++)
+		{
+			Rot0[c] = _mm256_loadu_ps(Keys0 + (ANIM_SOA_ROT_X + c) * PaddedCount + j);
+			Rot1[c] = _mm256_loadu_ps(Keys1 + (ANIM_SOA_ROT_X + c) * PaddedCount + j);
+		}
+
+		__m256 Dot = _mm256_mul_ps(Rot0[0], Rot1[0]);
+		Dot = _mm256_add_ps(Dot, _mm256_mul_ps(Rot0[1], Rot1[1]));
+		Dot = _mm256_add_ps(Dot, _mm256_mul_ps(Rot0[2], Rot1[2]));
+		Dot = _mm256_add_ps(Dot, _mm256_mul_ps(Rot0[3], Rot1[3]));
+		const __m256 Sign = _mm256_and_ps(Dot, SignMask);
+
+		__m256 Rot[4];
+		__m256 SquaredLength = _mm256_setzero_ps();
+		for(int c=0;c<4;c++)
+		{
+			Rot[c] = _mm256_add_ps(Rot0[c], _mm256_mul_ps(_mm256_sub_ps(_mm256_xor_ps(Rot1[c], Sign), Rot0[c]), VAlpha));
+			SquaredLength = _mm256_add_ps(SquaredLength, _mm256_mul_ps(Rot[c], Rot[c]));
+		}
+
+		__m256 InvLength = _mm256_rsqrt_ps(SquaredLength);
+		InvLength = _mm256_mul_ps(InvLength, _mm256_sub_ps(ThreeHalves, _mm256_mul_ps(_mm256_mul_ps(Half, SquaredLength), _mm256_mul_ps(InvLength, InvLength))));
+		for(int c=0;c<4;c++)
+			_mm256_storeu_ps(Out + (ANIM_SOA_ROT_X + c) * PaddedCount + j, _mm256_mul_ps(Rot[c], InvLength));
+
+		for(int s=ANIM_SOA_TRANS_X;s<ANIM_SOA_STREAM_COUNT;s++)
+		{
+			const __m256 Value0 = _mm256_loadu_ps(Keys0 + s * PaddedCount + j);
+			const __m256 Value1 = _mm256_loadu_ps(Keys1 + s * PaddedCount + j);
+			_mm256_storeu_ps(Out + s * PaddedCount + j, _mm256_add_ps(Value0, _mm256_mul_ps(_mm256_sub_ps(Value1, Value0), VAlpha)));
+		}
+	}
+}
+#endif
+
+void AnimationSampler::InterpolatePose( const float* Keys0, const float* Keys1, float Alpha, int PaddedCount, float* Out, EAnimSimd Simd )
+{
+	switch(Simd)
+	{
+#if defined(ANIM_SAMPLER_AVX2)
+	case ANIM_SIMD_AVX2:
+		InterpolatePoseAVX2(Keys0, Keys1, Alpha, PaddedCount, Out);
+		return;
+#endif
+#if defined(ANIM_SAMPLER_SSE)
+	case ANIM_SIMD_SSE:
+		InterpolatePoseSSE(Keys0, Keys1, Alpha, PaddedCount, Out);
+		return;
+#endif
+	default:
+		InterpolatePoseScalar(Keys0, Keys1, Alpha, PaddedCount, Out);
+		return;
+	}
+}
+
+void AnimationSampler::InterpolateJoint( const float* Keys0, const float* Keys1, float Alpha, int PaddedCount, int Joint, JointPose& Out )
+{
+	float Blend[ANIM_SOA_STREAM_COUNT];
+	for(int s=0;s<ANIM_SOA_STREAM_COUNT;s++)
+		Blend[s] = Keys1[s * PaddedCount + Joint];
+
+	float Dot = 0.f;
+	for(int c=0;c<4;c++)
+		Dot += Keys0[(ANIM_SOA_ROT_X + c) * PaddedCount + Joint] * Blend[ANIM_SOA_ROT_X + c];
+	if(Dot < 0.f)
+	{
+		for(int c=0;c<4;c++)
+			Blend[ANIM_SOA_ROT_X + c] = -Blend[ANIM_SOA_ROT_X + c];
+	}
+
+	float SquaredLength = 0.f;
+	for(int s=0;s<ANIM_SOA_STREAM_COUNT;s++)
+	{
+		const float Value0 = Keys0[s * PaddedCount + Joint];
+		Blend[s] = Value0 + (Blend[s] - Value0) * Alpha;
+		if(s <= ANIM_SOA_ROT_W)
+			SquaredLength += Blend[s] * Blend[s];
+	}
+
+	const float InvLength = 1.f / sqrtf(SquaredLength);
+	Out._Rot = XMFLOAT4(Blend[ANIM_SOA_ROT_X] * InvLength, Blend[ANIM_SOA_ROT_Y] * InvLength, Blend[ANIM_SOA_ROT_Z] * InvLength, Blend[ANIM_SOA_ROT_W] * InvLength);
+	Out._Trans = XMFLOAT3(Blend[ANIM_SOA_TRANS_X], Blend[ANIM_SOA_TRANS_Y], Blend[ANIM_SOA_TRANS_Z]);
+	Out._Scale = XMFLOAT3(Blend[ANIM_SOA_SCALE_X], Blend[ANIM_SOA_SCALE_Y], Blend[ANIM_SOA_SCALE_Z]);
+}
+
+void AnimationSampler::StoreJoint( const JointPose& InJoint, int PaddedCount, int Joint, float* Out )
+{
+	Out[ANIM_SOA_ROT_X * PaddedCount + Joint] = InJoint._Rot.x;
+	Out[ANIM_SOA_ROT_Y * PaddedCount + Joint] = InJoint._Rot.y;
+	Out[ANIM_SOA_ROT_Z * PaddedCount + Joint] = InJoint._Rot.z;
+	Out[ANIM_SOA_ROT_W * PaddedCount + Joint] = InJoint._Rot.w;
+	Out[ANIM_SOA_TRANS_X * PaddedCount + Joint] = InJoint._Trans.x;
+	Out[ANIM_SOA_TRANS_Y * PaddedCount + Joint] = InJoint._Trans.y;
+	Out[ANIM_SOA_TRANS_Z * PaddedCount + Joint] = InJoint._Trans.z;
+	Out[ANIM_SOA_SCALE_X * PaddedCount + Joint] = InJoint._Scale.x;
+	Out[ANIM_SOA_SCALE_Y * PaddedCount + Joint] = InJoint._Scale.y;
+	Out[ANIM_SOA_SCALE_Z * PaddedCount + Joint] = InJoint._Scale.z;
+}
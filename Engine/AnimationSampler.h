@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+
+#include "Skeleton.h"
+
+// structure of arrays pose layout. every channel component is its own stream of joints,
+// rotation x of all joints, then rotation y, ... so one vector instruction blends several joints.
+// joint counts are padded to ANIM_SOA_WIDTH with identity joints so every path runs whole vectors
+
+#define ANIM_SOA_WIDTH			8	// joints per avx register, sse handles half of it per instruction
+
+enum EAnimSoaStream
+{
+	ANIM_SOA_ROT_X,
+	ANIM_SOA_ROT_Y,
+	ANIM_SOA_ROT_Z,
+	ANIM_SOA_ROT_W,
+	ANIM_SOA_TRANS_X,
+	ANIM_SOA_TRANS_Y,
+	ANIM_SOA_TRANS_Z,
+	ANIM_SOA_SCALE_X,
+	ANIM_SOA_SCALE_Y,
+	ANIM_SOA_SCALE_Z,
+	ANIM_SOA_STREAM_COUNT,
+};
+
+enum EAnimSimd
+{
+	ANIM_SIMD_SCALAR,
+	ANIM_SIMD_SSE,
+	ANIM_SIMD_AVX2,
+};
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define ANIM_SAMPLER_SSE
+#endif
+// built with /arch:AVX2, the whole binary needs avx2 then
+#if defined(__AVX2__)
+#define ANIM_SAMPLER_AVX2
+#endif
+
+// joint count rounded up to whole ANIM_SOA_WIDTH groups
+inline int GetSoaPaddedCount(int JointCount)
+{
+	return (JointCount + ANIM_SOA_WIDTH - 1) / ANIM_SOA_WIDTH * ANIM_SOA_WIDTH;
+}
+
+class SoaSkeletonPose
+{
+public:
+	int _JointCount;
+	int _PaddedCount;
+	std::vector<float> _Data;	// ANIM_SOA_STREAM_COUNT streams of _PaddedCount floats
+
+	void Init(int JointCount);
+	float* GetStream(int Stream) {return &_Data[Stream * _PaddedCount];}
+	const float* GetStream(int Stream) const {return &_Data[Stream * _PaddedCount];}
+
+	void FromSkeletonPose(const SkeletonPose& InPose);
+	void ToSkeletonPose(SkeletonPose& OutPose) const;
+
+	SoaSkeletonPose()
+		:_JointCount(0)
+		,_PaddedCount(0)
+	{
+	}
+};
+
+class AnimationSampler
+{
+public:
+	// widest path this build supports
+	static EAnimSimd GetBestSimd();
+
+	// Out = nlerp/lerp of two SoA key blocks of PaddedCount joints. rotations take the shorter arc,
+	// the second key is negated where the two keys are in opposite hemispheres
+	static void InterpolatePose(const float* Keys0, const float* Keys1, float Alpha, int PaddedCount, float* Out, EAnimSimd Simd);
+
+	// the same blend for a single joint of two SoA key blocks, written as an AoS joint
+	static void InterpolateJoint(const float* Keys0, const float* Keys1, float Alpha, int PaddedCount, int Joint, JointPose& Out);
+
+	// scatters one AoS joint into a SoA block
+	static void StoreJoint(const JointPose& InJoint, int PaddedCount, int Joint, float* Out);
+};
@@ -0,0 +1,179 @@
+#include <math.h>
+#include <string.h>
+#include "BakedAnimation.h"
+#include "AnimationClip.h"
+#include "AnimationSampler.h"
+#include "Skeleton.h"
+#include "MathUtil.h"
+#include "ParallelFor.h"
+
+BakedAnimation::BakedAnimation()
+	:_Clip(NULL)
+	,_Skeleton(NULL)
+	,_SampleRate(BAKED_ANIM_DEFAULT_RATE)
+	,_FrameCount(0)
+	,_JointCount(0)
+	,_Format(SKIN_LINEAR)
+	,_bHalf(false)
+{
+}
+
+void BakedAnimation::Bake( const AnimationClip* Clip, const Skeleton& Skel, const SkeletonPose& RefPose, float SampleRate, ESkinningMode Format, bool bHalf )
+{
+	_Clip = Clip;
+	_Skeleton = &Skel;
+	_SampleRate = SampleRate;
+	_Format = Format;
+	_bHalf = bHalf;
+	_JointCount = Skel._JointCount;
+	_FrameCount = (int)ceilf(Clip->GetDuration() * SampleRate) + 1;
+
+	const int FrameElements = _JointCount * GetElementsPerBone();
+	_FloatArray.clear();
+	_HalfArray.clear();
+	if(bHalf)
+		_HalfArray.resize(_FrameCount * FrameElements);
+	else
+		_FloatArray.resize(_FrameCount * FrameElements);
+
+	SkeletonPose Pose = RefPose;
+	SoaSkeletonPose SoaPose;
+	std::vector<BoneMatrix3x4> Model(_JointCount);
+	std::vector<BoneMatrix3x4> Skin(_JointCount);
+	std::vector<BoneDualQuat> DualQuat(_JointCount);
+	for(int f=0;f<_FrameCount;f++)
+	{
+		const float Time = Math::Min<float>(f / SampleRate, Clip->GetDuration());
+		if(Clip->HasSoaKeys())
+		{
+			Clip->GetCurrentPose(SoaPose, Time, AnimationSampler::GetBestSimd());
+			SoaPose.ToSkeletonPose(Pose);
+		}
+		else
+		{
+			Clip->GetCurrentPose(Pose, Time);
+		}
+		BonePalette::Build(Skel, Pose, &Model[0], &Skin[0]);
+
+		const XMFLOAT4* Elements = &Skin[0].Row[0];
+		if(Format == SKIN_DUALQUAT)
+		{
+			BonePalette::ToDualQuat(&Skin[0], _JointCount, &DualQuat[0]);
+			Elements = &DualQuat[0].Real;
+		}
+
+		for(int e=0;e<FrameElements;e++)
+		{
+			if(bHalf)
+				XMStoreHalf4(&_HalfArray[f * FrameElements + e], XMLoadFloat4(&Elements[e]));
+			else
+				_FloatArray[f * FrameElements + e] = Elements[e];
+		}
+	}
+}
+
+int BakedAnimation::GetFrameIndex( float LocalTime ) const
+{
+	const int Frame = (int)(LocalTime * _SampleRate + 0.5f);
+	return Math::Clamp<int>(Frame, 0, _FrameCount - 1);
+}
+
+const void* BakedAnimation::GetDirectFrame( int Frame, ESkinningMode Mode ) const
+{
+	if(_bHalf || Mode != _Format)
+		return NULL;
+	return &_FloatArray[Frame * _JointCount * GetElementsPerBone()];
+}
+
+void BakedAnimation::DecodeFrame( int Frame, ESkinningMode Mode, BoneMatrix3x4* OutPalette, BoneDualQuat* OutDualQuat ) const
+{
+	const int FrameElements = _JointCount * GetElementsPerBone();
+
+	// widen into whichever output has the stored layout, then convert if the mode differs
+	XMFLOAT4* Elements = _Format == SKIN_DUALQUAT ? &OutDualQuat[0].Real : &OutPalette[0].Row[0];
+	if(_bHalf)
+	{
+		const XMHALF4* Source = &_HalfArray[Frame * FrameElements];
+		for(int e=0;e<FrameElements;e++)
+			XMStoreFloat4(&Elements[e], XMLoadHalf4(&Source[e]));
+	}
+	else
+	{
+		memcpy(Elements, &_FloatArray[Frame * FrameElements], FrameElements * sizeof(XMFLOAT4));
+	}
+
+	if(_Format == SKIN_LINEAR && Mode == SKIN_DUALQUAT)
+		BonePalette::ToDualQuat(OutPalette, _JointCount, OutDualQuat);
+	else if(_Format == SKIN_DUALQUAT && Mode == SKIN_LINEAR)
+		BonePalette::FromDualQuat(OutDualQuat, _JointCount, OutPalette);
+}
+
+int BakedAnimation::GetMemorySize() const
+{
+	return _FloatArray.size() * sizeof(XMFLOAT4) + _HalfArray.size() * sizeof(XMHALF4);
+}
+
+BakedPaletteCache::BakedPaletteCache()
+	:_EntryCount(0)
+	,_RequestCount(0)
+{
+}
+
+void BakedPaletteCache::BeginFrame()
+{
+	_EntryMap.clear();
+	_EntryCount = 0;
+	_RequestCount = 0;
+}
+
+int BakedPaletteCache::Request( const BakedAnimation* Baked, int Frame, ESkinningMode Mode )
+{
+	_RequestCount++;
+
+	BakedPaletteKey Key;
+	Key.Baked = Baked;
+	Key.Frame = Frame;
+	Key.Mode = Mode;
+	std::map<BakedPaletteKey, int>::iterator it = _EntryMap.find(Key);
+	if(it != _EntryMap.end())
+		return it->second;
+
+	// entries past _EntryCount are last frame's, their arrays are reused
+	if(_EntryCount == (int)_EntryArray.size())
+		_EntryArray.push_back(BakedPaletteEntry());
+	BakedPaletteEntry& Entry = _EntryArray[_EntryCount];
+	Entry.Key = Key;
+	Entry.Direct = Baked->GetDirectFrame(Frame, Mode);
+	_EntryMap[Key] = _EntryCount;
+	return _EntryCount++;
+}
+
+void BakedPaletteCache::Decode()
+{
+	ParallelFor(0, _EntryCount, [&](int i)
+	{
+		BakedPaletteEntry& Entry = _EntryArray[i];
+		if(Entry.Direct)
+			return;
+
+		// both for a mode change, the stored layout is widened into one and converted into the other
+		const BakedAnimation* Baked = Entry.Key.Baked;
+		if(Entry.Palette.size() < (unsigned int)Baked->_JointCount)
+			Entry.Palette.resize(Baked->_JointCount);
+		if(Entry.DualQuat.size() < (unsigned int)Baked->_JointCount)
+			Entry.DualQuat.resize(Baked->_JointCount);
+		Baked->DecodeFrame(Entry.Key.Frame, Entry.Key.Mode, &Entry.Palette[0], &Entry.DualQuat[0]);
+	});
+}
+
+const BoneMatrix3x4* BakedPaletteCache::GetPalette( int Entry ) const
+{
+	const BakedPaletteEntry& E = _EntryArray[Entry];
+	return E.Direct ? (const BoneMatrix3x4*)E.Direct : &E.Palette[0];
+}
+
+const BoneDualQuat* BakedPaletteCache::GetDualQuat( int Entry ) const
+{
+	const BakedPaletteEntry& E = _EntryArray[Entry];
+	return E.Direct ? (const BoneDualQuat*)E.Direct : &E.DualQuat[0];
+}
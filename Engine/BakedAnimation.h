@@ -0,0 +1,88 @@
+#pragma once
+#include "MathTypes.h"
+#include <vector>
+#include <map>
+#include "BonePalette.h"
+
+class Skeleton;
+class SkeletonPose;
+class AnimationClip;
+
+#define BAKED_ANIM_DEFAULT_RATE		30.f
+
+// final skinning palettes of one clip on one skeleton, sampled at a fixed rate. an instance playing the clip
+// only picks the nearest frame, no sampling, no joint hierarchy. frames are stored in the palette layout of
+// _Format, float or half precision
+class BakedAnimation
+{
+public:
+	const AnimationClip*	_Clip;
+	const Skeleton*			_Skeleton;
+	float			_SampleRate;
+	int				_FrameCount;
+	int				_JointCount;
+	ESkinningMode	_Format;
+	bool			_bHalf;
+
+	// _FrameCount blocks of _JointCount * elements per bone, one of the two is filled
+	std::vector<XMFLOAT4> _FloatArray;
+	std::vector<XMHALF4> _HalfArray;
+
+	// RefPose gives the joints the clip doesn't animate. frame i is at i / SampleRate, the last one at the clip's end
+	void Bake(const AnimationClip* Clip, const Skeleton& Skel, const SkeletonPose& RefPose, float SampleRate, ESkinningMode Format, bool bHalf);
+
+	// nearest frame, the caller wraps LocalTime into the clip like AnimClipInstance does
+	int GetFrameIndex(float LocalTime) const;
+	int GetElementsPerBone() const { return _Format == SKIN_DUALQUAT ? BONE_ELEMENTS_DUALQUAT : BONE_ELEMENTS_LINEAR; }
+
+	// the stored frame as is when Mode matches a float bake, NULL when it has to be decoded
+	const void* GetDirectFrame(int Frame, ESkinningMode Mode) const;
+	// the frame widened to float and converted to Mode, into OutPalette for SKIN_LINEAR or OutDualQuat for SKIN_DUALQUAT
+	void DecodeFrame(int Frame, ESkinningMode Mode, BoneMatrix3x4* OutPalette, BoneDualQuat* OutDualQuat) const;
+
+	// bytes held by the baked frames
+	int GetMemorySize() const;
+
+	BakedAnimation();
+};
+
+struct BakedPaletteKey
+{
+	const BakedAnimation* Baked;
+	int Frame;
+	ESkinningMode Mode;
+	bool operator<(const BakedPaletteKey& other) const
+	{
+		if( Baked != other.Baked ) return Baked < other.Baked;
+		if( Frame != other.Frame ) return Frame < other.Frame;
+		return Mode < other.Mode;
+	};
+};
+
+struct BakedPaletteEntry
+{
+	BakedPaletteKey Key;
+	const void* Direct;		// straight into the baked frame, nothing to decode
+	std::vector<BoneMatrix3x4> Palette;
+	std::vector<BoneDualQuat> DualQuat;
+};
+
+// palettes of one frame, shared by every instance that lands on the same baked frame.
+// Request is serial, Decode runs the unique entries on worker threads. entries keep their storage
+// across frames, the pointers stay valid until the next BeginFrame
+class BakedPaletteCache
+{
+public:
+	std::map<BakedPaletteKey, int> _EntryMap;
+	std::vector<BakedPaletteEntry> _EntryArray;
+	int _EntryCount;		// unique palettes this frame
+	int _RequestCount;		// instances that asked
+
+	void BeginFrame();
+	int Request(const BakedAnimation* Baked, int Frame, ESkinningMode Mode);
+	void Decode();
+	const BoneMatrix3x4* GetPalette(int Entry) const;
+	const BoneDualQuat* GetDualQuat(int Entry) const;
+
+	BakedPaletteCache();
+};
@@ -1,8 +1,6 @@
 #pragma once
 #include <string>
-#include <d3d11.h>
-#include <d3dx11.h>
-#include <xnamath.h>
+#include "MathTypes.h"
 
 class BaseObject
 {
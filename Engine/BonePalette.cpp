@@ -0,0 +1,227 @@
+#include <math.h>
+#include "BonePalette.h"
+#include "Skeleton.h"
+
+// BlendDualQuat and SkinVertex round every multiply and add on its own like the shader's precise math,
+// a fused multiply-add would round once and drift from it
+#if defined(_MSC_VER)
+#pragma fp_contract(off)
+#else
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+void BonePalette::FromMatrix( const XMFLOAT4X4& Mat, BoneMatrix3x4& Out )
+{
+	for(int i=0;i<3;i++)
+		Out.Row[i] = XMFLOAT4(Mat.m[0][i], Mat.m[1][i], Mat.m[2][i], Mat.m[3][i]);
+}
+
+void BonePalette::InitSkeleton( Skeleton& Skel )
+{
+	Skel._InvBindArray.resize(Skel._Joints.size());
+	for(unsigned int i=0;i<Skel._Joints.size();i++)
+		FromMatrix(Skel._Joints[i]._InvRefPose, Skel._InvBindArray[i]);
+}
+
+// scale, then rotation, then translation
+static void ComposeJoint(const JointPose& Joint, XMVECTOR* OutRows)
+{
+	const float x = Joint._Rot.x, y = Joint._Rot.y, z = Joint._Rot.z, w = Joint._Rot.w;
+	const float xx = x * x * 2.f, yy = y * y * 2.f, zz = z * z * 2.f;
+	const float xy = x * y * 2.f, xz = x * z * 2.f, yz = y * z * 2.f;
+	const float wx = w * x * 2.f, wy = w * y * 2.f, wz = w * z * 2.f;
+	const XMFLOAT3& S = Joint._Scale;
+	const XMFLOAT3& T = Joint._Trans;
+
+	OutRows[0] = XMVectorSet((1.f - yy - zz) * S.x, (xy - wz) * S.y, (xz + wy) * S.z, T.x);
+	OutRows[1] = XMVectorSet((xy + wz) * S.x, (1.f - xx - zz) * S.y, (yz - wx) * S.z, T.y);
+	OutRows[2] = XMVectorSet((xz - wy) * S.x, (yz + wx) * S.y, (1.f - xx - yy) * S.z, T.z);
+}
+
+// Out = A * B, B applies first. the implicit fourth row is (0, 0, 0, 1)
+static void Multiply3x4(const XMVECTOR* A, const XMVECTOR* B, XMVECTOR* Out)
+{
+	for(int i=0;i<3;i++)
+	{
+		XMVECTOR Row = XMVectorSelect(XMVectorZero(), A[i], g_XMSelect0001);
+		Row = XMVectorMultiplyAdd(XMVectorSplatX(A[i]), B[0], Row);
+		Row = XMVectorMultiplyAdd(XMVectorSplatY(A[i]), B[1], Row);
+		Row = XMVectorMultiplyAdd(XMVectorSplatZ(A[i]), B[2], Row);
+		Out[i] = Row;
+	}
+}
+
+static void Load3x4(const BoneMatrix3x4& In, XMVECTOR* OutRows)
+{
+	for(int i=0;i<3;i++)
+		OutRows[i] = XMLoadFloat4(&In.Row[i]);
+}
+
+static void Store3x4(const XMVECTOR* InRows, BoneMatrix3x4& Out)
+{
+	for(int i=0;i<3;i++)
+		XMStoreFloat4(&Out.Row[i], InRows[i]);
+}
+
+void BonePalette::Build( const Skeleton& Skel, const SkeletonPose& Pose, BoneMatrix3x4* OutModel, BoneMatrix3x4* OutSkin )
+{
+	for(int i=0;i<Skel._JointCount;i++)
+	{
+		XMVECTOR Local[3], Model[3], Skin[3], Other[3];
+		ComposeJoint(Pose._LocalPoseArray[i], Local);
+
+		const int ParentIndex = Skel._Joints[i]._ParentIndex;
+		if(ParentIndex < 0)
+		{
+			Model[0] = Local[0];
+			Model[1] = Local[1];
+			Model[2] = Local[2];
+		}
+		else
+		{
+			// parents come first, their model transform is already written
+			Load3x4(OutModel[ParentIndex], Other);
+			Multiply3x4(Other, Local, Model);
+		}
+		Store3x4(Model, OutModel[i]);
+
+		Load3x4(Skel._InvBindArray[i], Other);
+		Multiply3x4(Model, Other, Skin);
+		Store3x4(Skin, OutSkin[i]);
+	}
+}
+
+void BonePalette::Lerp( const BoneMatrix3x4* A, const BoneMatrix3x4* B, float Alpha, int Count, BoneMatrix3x4* Out )
+{
+	for(int i=0;i<Count;i++)
+	{
+		for(int r=0;r<3;r++)
+			XMStoreFloat4(&Out[i].Row[r], XMVectorLerp(XMLoadFloat4(&A[i].Row[r]), XMLoadFloat4(&B[i].Row[r]), Alpha));
+	}
+}
+
+// rotation of a column form 3x4 with unit columns, Shepperd's method
+static XMFLOAT4 QuatFromRotation(const float R[3][3])
+{
+	XMFLOAT4 Q;
+	const float Trace = R[0][0] + R[1][1] + R[2][2];
+	if(Trace > 0.f)
+	{
+		const float S = sqrtf(Trace + 1.f) * 2.f;
+		Q = XMFLOAT4((R[2][1] - R[1][2]) / S, (R[0][2] - R[2][0]) / S, (R[1][0] - R[0][1]) / S, 0.25f * S);
+	}
+	else if(R[0][0] > R[1][1] && R[0][0] > R[2][2])
+	{
+		const float S = sqrtf(1.f + R[0][0] - R[1][1] - R[2][2]) * 2.f;
+		Q = XMFLOAT4(0.25f * S, (R[0][1] + R[1][0]) / S, (R[0][2] + R[2][0]) / S, (R[2][1] - R[1][2]) / S);
+	}
+	else if(R[1][1] > R[2][2])
+	{
+		const float S = sqrtf(1.f + R[1][1] - R[0][0] - R[2][2]) * 2.f;
+		Q = XMFLOAT4((R[0][1] + R[1][0]) / S, 0.25f * S, (R[1][2] + R[2][1]) / S, (R[0][2] - R[2][0]) / S);
+	}
+	else
+	{
+		const float S = sqrtf(1.f + R[2][2] - R[0][0] - R[1][1]) * 2.f;
+		Q = XMFLOAT4((R[0][2] + R[2][0]) / S, (R[1][2] + R[2][1]) / S, 0.25f * S, (R[1][0] - R[0][1]) / S);
+	}
+
+	const float InvLength = 1.f / sqrtf(Q.x * Q.x + Q.y * Q.y + Q.z * Q.z + Q.w * Q.w);
+	return XMFLOAT4(Q.x * InvLength, Q.y * InvLength, Q.z * InvLength, Q.w * InvLength);
+}
+
+void BonePalette::ToDualQuat( const BoneMatrix3x4* In, int Count, BoneDualQuat* Out )
+{
+	for(int i=0;i<Count;i++)
+	{
+		const XMFLOAT4* Row = In[i].Row;
+		float R[3][3];
+		for(int c=0;c<3;c++)
+		{
+			const float Column[3] = { (&Row[0].x)[c], (&Row[1].x)[c], (&Row[2].x)[c] };
+			const float InvScale = 1.f / sqrtf(Column[0] * Column[0] + Column[1] * Column[1] + Column[2] * Column[2]);
+			for(int r=0;r<3;r++)
+				R[r][c] = Column[r] * InvScale;
+		}
+
+		const XMFLOAT4 Q = QuatFromRotation(R);
+		const float tx = Row[0].w, ty = Row[1].w, tz = Row[2].w;
+
+		// 0.5 * (t, 0) * Q
+		Out[i].Real = Q;
+		Out[i].Dual = XMFLOAT4(
+			0.5f * (tx * Q.w + ty * Q.z - tz * Q.y),
+			0.5f * (ty * Q.w + tz * Q.x - tx * Q.z),
+			0.5f * (tz * Q.w + tx * Q.y - ty * Q.x),
+			-0.5f * (tx * Q.x + ty * Q.y + tz * Q.z));
+	}
+}
+
+// normalized, then back to a 3x4. Real and Dual are scaled in place
+static void NormalizedDualQuatToMatrix(float* Real, float* Dual, BoneMatrix3x4& Out)
+{
+	const float InvLength = 1.f / sqrtf(Real[0] * Real[0] + Real[1] * Real[1] + Real[2] * Real[2] + Real[3] * Real[3]);
+	for(int c=0;c<4;c++)
+	{
+		Real[c] = Real[c] * InvLength;
+		Dual[c] = Dual[c] * InvLength;
+	}
+
+	const float x = Real[0], y = Real[1], z = Real[2], w = Real[3];
+	const float tx = 2.f * (w * Dual[0] - Dual[3] * x + (y * Dual[2] - z * Dual[1]));
+	const float ty = 2.f * (w * Dual[1] - Dual[3] * y + (z * Dual[0] - x * Dual[2]));
+	const float tz = 2.f * (w * Dual[2] - Dual[3] * z + (x * Dual[1] - y * Dual[0]));
+
+	Out.Row[0] = XMFLOAT4(1.f - 2.f * (y * y + z * z), 2.f * (x * y - w * z), 2.f * (x * z + w * y), tx);
+	Out.Row[1] = XMFLOAT4(2.f * (x * y + w * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z - w * x), ty);
+	Out.Row[2] = XMFLOAT4(2.f * (x * z - w * y), 2.f * (y * z + w * x), 1.f - 2.f * (x * x + y * y), tz);
+}
+
+void BonePalette::BlendDualQuat( const BoneDualQuat* Palette, const unsigned char* Bones, const float* Weights, BoneMatrix3x4& Out )
+{
+	const XMFLOAT4& Real0 = Palette[Bones[0]].Real;
+	float Real[4], Dual[4];
+	for(int c=0;c<4;c++)
+	{
+		Real[c] = (&Real0.x)[c] * Weights[0];
+		Dual[c] = (&Palette[Bones[0]].Dual.x)[c] * Weights[0];
+	}
+
+	for(int i=1;i<4;i++)
+	{
+		const float* BoneReal = &Palette[Bones[i]].Real.x;
+		const float* BoneDual = &Palette[Bones[i]].Dual.x;
+		const float Dot = Real0.x * BoneReal[0] + Real0.y * BoneReal[1] + Real0.z * BoneReal[2] + Real0.w * BoneReal[3];
+		const float w = Dot < 0.f ? -Weights[i] : Weights[i];
+		for(int c=0;c<4;c++)
+		{
+			Real[c] = Real[c] + BoneReal[c] * w;
+			Dual[c] = Dual[c] + BoneDual[c] * w;
+		}
+	}
+
+	NormalizedDualQuatToMatrix(Real, Dual, Out);
+}
+
+void BonePalette::FromDualQuat( const BoneDualQuat* In, int Count, BoneMatrix3x4* Out )
+{
+	for(int i=0;i<Count;i++)
+	{
+		float Real[4] = { In[i].Real.x, In[i].Real.y, In[i].Real.z, In[i].Real.w };
+		float Dual[4] = { In[i].Dual.x, In[i].Dual.y, In[i].Dual.z, In[i].Dual.w };
+		NormalizedDualQuatToMatrix(Real, Dual, Out[i]);
+	}
+}
+
+void BonePalette::SkinVertex( const BoneMatrix3x4& BoneMat, const XMFLOAT3& Pos, const XMFLOAT3& Normal, XMFLOAT3& OutPos, XMFLOAT3& OutNormal )
+{
+	const XMFLOAT4* Row = BoneMat.Row;
+	OutPos = XMFLOAT3(
+		Row[0].x * Pos.x + Row[0].y * Pos.y + Row[0].z * Pos.z + Row[0].w,
+		Row[1].x * Pos.x + Row[1].y * Pos.y + Row[1].z * Pos.z + Row[1].w,
+		Row[2].x * Pos.x + Row[2].y * Pos.y + Row[2].z * Pos.z + Row[2].w);
+	OutNormal = XMFLOAT3(
+		Row[0].x * Normal.x + Row[0].y * Normal.y + Row[0].z * Normal.z,
+		Row[1].x * Normal.x + Row[1].y * Normal.y + Row[1].z * Normal.z,
+		Row[2].x * Normal.x + Row[2].y * Normal.y + Row[2].z * Normal.z);
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "MathTypes.h"
+
+class Skeleton;
+class SkeletonPose;
+
+// affine bone transform as the three rows of its column form, p' = (dot(Row[0], p), dot(Row[1], p), dot(Row[2], p)) for p = (x, y, z, 1).
+// this is the palette layout the skinning shaders read, 3 float4 per bone
+struct BoneMatrix3x4
+{
+	XMFLOAT4 Row[3];
+};
+
+// unit dual quaternion of a rigid bone transform, Real is the rotation and Dual = 0.5 * (t, 0) * Real.
+// 2 float4 per bone in the palette. scale and shear don't survive the conversion
+struct BoneDualQuat
+{
+	XMFLOAT4 Real;
+	XMFLOAT4 Dual;
+};
+
+enum ESkinningMode
+{
+	SKIN_LINEAR,		// BoneMatrix3x4 palette, blended matrices
+	SKIN_DUALQUAT,		// BoneDualQuat palette, blended dual quaternions, no candy wrapper on twisted joints
+};
+
+// float4 palette elements per bone
+#define BONE_ELEMENTS_LINEAR	3
+#define BONE_ELEMENTS_DUALQUAT	2
+
+// dual quaternion palettes against exact math : rotation elements, and translations relative to their length
+#define DUALQUAT_BLEND_TOLERANCE	1e-5f
+
+class BonePalette
+{
+public:
+	// 3x4 of a row-vector affine XMFLOAT4X4
+	static void FromMatrix(const XMFLOAT4X4& Mat, BoneMatrix3x4& Out);
+
+	// fills Skel._InvBindArray from the joints' _InvRefPose
+	static void InitSkeleton(Skeleton& Skel);
+
+	// one pass over the parent-sorted joints: local TRS straight to 3x4, parent chain, then inverse bind.
+	// OutModel gets the model space joint transforms, OutSkin the skinning palette indexed by skeleton joint
+	static void Build(const Skeleton& Skel, const SkeletonPose& Pose, BoneMatrix3x4* OutModel, BoneMatrix3x4* OutSkin);
+
+	// per element blend of two palettes. fine between poses a few frames apart, it doesn't keep rotations orthonormal
+	static void Lerp(const BoneMatrix3x4* A, const BoneMatrix3x4* B, float Alpha, int Count, BoneMatrix3x4* Out);
+
+	// rigid part of each skinning matrix as a dual quaternion, column lengths are divided out first
+	static void ToDualQuat(const BoneMatrix3x4* In, int Count, BoneDualQuat* Out);
+	// back to rigid 3x4s, each dual quaternion is normalized first
+	static void FromDualQuat(const BoneDualQuat* In, int Count, BoneMatrix3x4* Out);
+
+	// cpu reference of CalcBoneMatrix in GpuSkinning.hlsl with DUALQUAT_SKINNING, same operations in the same order
+	// with no contraction on either side (precise in the shader, fp_contract off here). the gpu's sqrt, divide and dot
+	// round within the d3d11 tolerances, the result stays within DUALQUAT_BLEND_TOLERANCE of exact math either way.
+	// weighted blend flipped into the first bone's hemisphere, normalized, back to a 3x4 for SkinPosition/SkinNormal
+	static void BlendDualQuat(const BoneDualQuat* Palette, const unsigned char* Bones, const float* Weights, BoneMatrix3x4& Out);
+	static void SkinVertex(const BoneMatrix3x4& BoneMat, const XMFLOAT3& Pos, const XMFLOAT3& Normal, XMFLOAT3& OutPos, XMFLOAT3& OutNormal);
+};
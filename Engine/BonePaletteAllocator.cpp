@@ -0,0 +1,46 @@
+#include "BonePaletteAllocator.h"
+
+BonePaletteAllocator::BonePaletteAllocator(int InitialCapacity, int MaxCapacity)
+	:_Capacity(InitialCapacity < MaxCapacity ? InitialCapacity : MaxCapacity)
+	,_MaxCapacity(MaxCapacity)
+	,_Used(0)
+	,_HighWater(0)
+	,_OverflowCount(0)
+	,_bResized(true)
+{
+}
+
+void BonePaletteAllocator::BeginFrame( int RequiredElements )
+{
+	int Capacity = _Capacity;
+	while(Capacity < RequiredElements && Capacity < _MaxCapacity)
+		Capacity *= 2;
+	if(Capacity > _MaxCapacity)
+		Capacity = _MaxCapacity;
+	if(Capacity != _Capacity)
+	{
+		_Capacity = Capacity;
+		_bResized = true;
+	}
+
+	_Used = 0;
+	_OverflowCount = 0;
+}
+
+int BonePaletteAllocator::Allocate( int NumElement )
+{
+	if(NumElement < 0 || _Used + NumElement > _Capacity)
+	{
+		_OverflowCount++;
+		return BONE_ARENA_INVALID;
+	}
+	const int Base = _Used;
+	_Used += NumElement;
+	return Base;
+}
+
+void BonePaletteAllocator::EndFrame()
+{
+	if(_Used > _HighWater)
+		_HighWater = _Used;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#define BONE_ARENA_INITIAL_ELEMENTS	(4096 * 3)
+#define BONE_ARENA_MAX_ELEMENTS		(1 << 20)	// 16MB of palette
+#define BONE_ARENA_INVALID			-1
+
+// the offsets of BonePaletteArena, runs of float4 elements handed out front to back once per frame.
+// cpu only, the arena adds the buffer the runs live in
+class BonePaletteAllocator
+{
+public:
+	int		_Capacity;		// float4 elements
+	int		_MaxCapacity;
+	int		_Used;
+	int		_HighWater;
+	int		_OverflowCount;	// allocations refused this frame
+	bool	_bResized;		// capacity changed, the gpu buffer has to be recreated
+
+	// starts the frame. RequiredElements is the total the frame will ask for, the capacity grows
+	// in powers of two to fit it, up to _MaxCapacity
+	void BeginFrame(int RequiredElements);
+	// base element of a run of NumElement, BONE_ARENA_INVALID when the arena is full.
+	// draws without a run are skipped for the frame rather than read another mesh's bones
+	int Allocate(int NumElement);
+	void EndFrame();
+
+	BonePaletteAllocator(int InitialCapacity = BONE_ARENA_INITIAL_ELEMENTS, int MaxCapacity = BONE_ARENA_MAX_ELEMENTS);
+};
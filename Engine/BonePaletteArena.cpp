@@ -0,0 +1,73 @@
+#include <cassert>
+#include "BonePaletteArena.h"
+#include "Util.h"
+
+BonePaletteArena::BonePaletteArena(int InitialCapacity, int MaxCapacity)
+	:BonePaletteAllocator(InitialCapacity, MaxCapacity)
+	,_Mapped(NULL)
+	,_Buffer(NULL)
+	,_BufferRV(NULL)
+{
+}
+
+BonePaletteArena::~BonePaletteArena()
+{
+	ReleaseBuffer();
+}
+
+void BonePaletteArena::CreateBuffer( ID3D11Device* Device )
+{
+	ReleaseBuffer();
+
+	HRESULT hr;
+	D3D11_BUFFER_DESC bdc;
+	ZeroMemory( &bdc, sizeof(bdc) );
+	bdc.Usage = D3D11_USAGE_DYNAMIC;
+	bdc.ByteWidth = _Capacity * sizeof(XMFLOAT4);
+	bdc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	bdc.CPUAccessFlags = D3D10_CPU_ACCESS_WRITE;
+	hr = Device->CreateBuffer( &bdc, NULL, &_Buffer );
+	if( FAILED( hr ) )
+		assert(false);
+
+	SetD3DResourceDebugName("BonePaletteArena", _Buffer);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc;
+	ZeroMemory( &SRVDesc, sizeof( SRVDesc ) );
+	SRVDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	SRVDesc.Buffer.ElementOffset = 0;
+	SRVDesc.Buffer.ElementWidth = _Capacity;
+	hr = Device->CreateShaderResourceView( _Buffer, &SRVDesc, &_BufferRV );
+	if( FAILED( hr ) )
+		assert(false);
+
+	SetD3DResourceDebugName("BonePaletteArenaRV", _BufferRV);
+	_bResized = false;
+}
+
+void BonePaletteArena::ReleaseBuffer()
+{
+	if(_BufferRV) _BufferRV->Release();
+	if(_Buffer) _Buffer->Release();
+	_BufferRV = NULL;
+	_Buffer = NULL;
+}
+
+void BonePaletteArena::Map( ID3D11Device* Device, ID3D11DeviceContext* Context )
+{
+	if(_bResized || _Buffer == NULL)
+		CreateBuffer(Device);
+
+	D3D11_MAPPED_SUBRESOURCE MSR;
+	HRESULT hr = Context->Map( _Buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MSR );
+	if( FAILED( hr ) )
+		assert(false);
+	_Mapped = (XMFLOAT4*)MSR.pData;
+}
+
+void BonePaletteArena::Unmap( ID3D11DeviceContext* Context )
+{
+	Context->Unmap( _Buffer, 0 );
+	_Mapped = NULL;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <d3d11.h>
+#include <xnamath.h>
+#include "BonePalette.h"
+#include "BonePaletteAllocator.h"
+
+// one dynamic buffer for every skinned draw of the frame. render datas sub-allocate a run of float4 elements
+// from it, 3 per bone for matrices and 2 for dual quaternions. the whole frame is written under a single
+// Map(WRITE_DISCARD) and each draw reads from its base element.
+class BonePaletteArena :
+	public BonePaletteAllocator
+{
+public:
+	XMFLOAT4* _Mapped;
+
+	ID3D11Buffer*				_Buffer;
+	ID3D11ShaderResourceView*	_BufferRV;
+
+	// immediate context only
+	void Map(ID3D11Device* Device, ID3D11DeviceContext* Context);
+	void Unmap(ID3D11DeviceContext* Context);
+	XMFLOAT4* GetElements(int Base) { return _Mapped + Base; }
+
+	BonePaletteArena(int InitialCapacity = BONE_ARENA_INITIAL_ELEMENTS, int MaxCapacity = BONE_ARENA_MAX_ELEMENTS);
+	~BonePaletteArena();
+
+private:
+	void CreateBuffer(ID3D11Device* Device);
+	void ReleaseBuffer();
+};
@@ -0,0 +1,311 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "CookedAnimation.h"
+#include "CookedMesh.h"
+#include "MappedFile.h"
+#include "Skeleton.h"
+#include "AnimationClip.h"
+
+struct CookedAnimFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t EndianTag;
+	uint32_t Count;
+};
+
+class CookedStreamWriter
+{
+public:
+	std::vector<unsigned char> _Data;
+
+	void Write(const void* Src, size_t Size)
+	{
+		const unsigned char* Bytes = (const unsigned char*)Src;
+		_Data.insert(_Data.end(), Bytes, Bytes + Size);
+	}
+	void WriteUInt(uint32_t Value) { Write(&Value, sizeof(uint32_t)); }
+	template<class T>
+	void WriteArray(const std::vector<T>& Array)
+	{
+		WriteUInt((uint32_t)Array.size());
+		if(Array.size())
+			Write(&Array[0], Array.size() * sizeof(T));
+	}
+};
+
+class CookedStreamReader
+{
+	const unsigned char*	_Data;
+	size_t					_Size;
+	size_t					_Offset;
+public:
+	CookedStreamReader(const unsigned char* Data, size_t Size)
+		: _Data(Data)
+		, _Size(Size)
+		, _Offset(0)
+	{
+	}
+
+	bool Read(void* Dest, size_t Size)
+	{
+		if(Size > _Size - _Offset)
+			return false;
+		memcpy(Dest, _Data + _Offset, Size);
+		_Offset += Size;
+		return true;
+	}
+	bool ReadUInt(uint32_t& Value) { return Read(&Value, sizeof(uint32_t)); }
+	template<class T>
+	bool ReadArray(std::vector<T>& Array)
+	{
+		uint32_t Count;
+		if(!ReadUInt(Count) || Count > (_Size - _Offset) / sizeof(T))
+			return false;
+		Array.resize(Count);
+		return Count == 0 || Read(&Array[0], Count * sizeof(T));
+	}
+};
+
+static void WriteHeader(CookedStreamWriter& Writer, uint32_t Magic, uint32_t Version, uint32_t Count)
+{
+	CookedAnimFileHeader Header;
+	Header.Magic = Magic;
+	Header.Version = Version;
+	Header.EndianTag = COOKED_MESH_ENDIAN_TAG;
+	Header.Count = Count;
+	Writer.Write(&Header, sizeof(CookedAnimFileHeader));
+}
+
+static bool ReadHeader(CookedStreamReader& Reader, uint32_t Magic, uint32_t Version, uint32_t& OutCount)
+{
+	CookedAnimFileHeader Header;
+	if(!Reader.Read(&Header, sizeof(CookedAnimFileHeader)))
+		return false;
+	if(Header.Magic != Magic || Header.Version != Version || Header.EndianTag != COOKED_MESH_ENDIAN_TAG)
+		return false;
+	OutCount = Header.Count;
+	return true;
+}
+
+bool CookedAnimation::SaveSkeleton( const char* Path, const Skeleton* InSkeleton, const SkeletonPose* InRefPose )
+{
+	if(InSkeleton->_Joints.size() != InRefPose->_LocalPoseArray.size())
+		return false;
+
+	CookedStreamWriter Writer;
+	WriteHeader(Writer, COOKED_SKELETON_MAGIC, COOKED_SKELETON_VERSION, (uint32_t)InSkeleton->_Joints.size());
+	for(unsigned int i=0;i<InSkeleton->_Joints.size();i++)
+	{
+		const SkeletonJoint& Joint = InSkeleton->_Joints[i];
+		int32_t ParentIndex = Joint._ParentIndex;
+		Writer.WriteUInt((uint32_t)Joint._Name.size());
+		Writer.Write(Joint._Name.c_str(), Joint._Name.size());
+		Writer.Write(&ParentIndex, sizeof(int32_t));
+		Writer.Write(&Joint._InvRefPose, sizeof(XMFLOAT4X4));
+		Writer.Write(&InRefPose->_LocalPoseArray[i], sizeof(JointPose));
+	}
+	return WriteWholeFile(Path, &Writer._Data[0], Writer._Data.size());
+}
+
+bool CookedAnimation::LoadSkeleton( const char* Path, Skeleton* OutSkeleton, SkeletonPose* OutRefPose )
+{
+	MappedFile File;
+	if(!File.Open(Path))
+		return false;
+
+	CookedStreamReader Reader(File.GetData(), File.GetSize());
+	uint32_t JointCount;
+	if(!ReadHeader(Reader, COOKED_SKELETON_MAGIC, COOKED_SKELETON_VERSION, JointCount))
+		return false;
+
+	std::vector<SkeletonJoint> Joints(JointCount);
+	std::vector<JointPose> RefPose(JointCount);
+	for(unsigned int i=0;i<JointCount;i++)
+	{
+		SkeletonJoint& Joint = Joints[i];
+		uint32_t NameLength;
+		if(!Reader.ReadUInt(NameLength) || NameLength > File.GetSize())
+			return false;
+		Joint._Name.resize(NameLength);
+		int32_t ParentIndex;
+		if((NameLength && !Reader.Read(&Joint._Name[0], NameLength))
+			|| !Reader.Read(&ParentIndex, sizeof(int32_t))
+			|| !Reader.Read(&Joint._InvRefPose, sizeof(XMFLOAT4X4))
+			|| !Reader.Read(&RefPose[i], sizeof(JointPose)))
+			return false;
+		// the bone palette pass needs parents before children
+		if(ParentIndex >= (int32_t)i)
+			return false;
+		Joint._ParentIndex = ParentIndex;
+	}
+
+	OutSkeleton->_Joints = std::move(Joints);
+	OutSkeleton->_JointCount = JointCount;
+	BonePalette::InitSkeleton(*OutSkeleton);
+	OutRefPose->_LocalPoseArray = std::move(RefPose);
+	return true;
+}
+
+bool CookedAnimation::SaveClips( const char* Path, const std::vector<AnimationClip*>& InClipArray )
+{
+	CookedStreamWriter Writer;
+	WriteHeader(Writer, COOKED_ANIM_MAGIC, COOKED_ANIM_VERSION, (uint32_t)InClipArray.size());
+	for(unsigned int ClipIndex=0;ClipIndex<InClipArray.size();ClipIndex++)
+	{
+		const AnimationClip* Clip = InClipArray[ClipIndex];
+		// the SoA runtime layout is never written, cook from the imported clip
+		if(Clip->HasSoaKeys())
+			return false;
+		Writer.Write(&Clip->_Duration, sizeof(float));
+		Writer.WriteUInt(Clip->IsCompressed() ? 1 : 0);
+		Writer.Write(&Clip->_SampleRate, sizeof(float));
+		Writer.WriteUInt((uint32_t)Clip->_FrameCount);
+		if(Clip->IsCompressed())
+		{
+			Writer.WriteArray(Clip->_CompressedTrackArray);
+			Writer.WriteArray(Clip->_KeyFrameArray);
+			Writer.WriteArray(Clip->_KeyDataArray);
+			continue;
+		}
+
+		Writer.WriteUInt((uint32_t)Clip->_TransTrackArray.size());
+		for(unsigned int i=0;i<Clip->_TransTrackArray.size();i++)
+		{
+			Writer.WriteArray(Clip->_TransTrackArray[i]._TimeArray);
+			Writer.WriteArray(Clip->_TransTrackArray[i]._PosArray);
+			Writer.WriteArray(Clip->_RotTrackArray[i]._TimeArray);
+			Writer.WriteArray(Clip->_RotTrackArray[i]._RotArray);
+			Writer.WriteArray(Clip->_ScaleTrackArray[i]._TimeArray);
+			Writer.WriteArray(Clip->_ScaleTrackArray[i]._ScaleArray);
+		}
+	}
+	return WriteWholeFile(Path, &Writer._Data[0], Writer._Data.size());
+}
+
+// every key a track points at has to be inside the loaded arrays
+bool CookedAnimation::ValidateCompressedClip(AnimationClip& Clip, unsigned int FrameCount)
+{
+	if(FrameCount == 0 || FrameCount > 0x10000 || Clip._CompressedTrackArray.size() % ANIM_TRACK_TYPE_COUNT != 0)
+		return false;
+	Clip._FrameCount = FrameCount;
+
+	for(unsigned int i=0;i<Clip._CompressedTrackArray.size();i++)
+	{
+		const CompressedAnimTrack& Track = Clip._CompressedTrackArray[i];
+		const unsigned int Type = i % ANIM_TRACK_TYPE_COUNT;
+		if(Track.Format > ANIM_TRACK_FLOAT)
+			return false;
+		if(Track.Format == ANIM_TRACK_CONSTANT)
+			continue;
+		if(Track.KeyCount == 0
+			|| Track.KeyOffset > Clip._KeyFrameArray.size() || Track.KeyCount > Clip._KeyFrameArray.size() - Track.KeyOffset
+			|| Track.DataOffset > Clip._KeyDataArray.size()
+			|| (uint64_t)Track.KeyCount * GetAnimKeySize(Track.Format, Type) > Clip._KeyDataArray.size() - Track.DataOffset)
+			return false;
+	}
+	return true;
+}
+
+// uniform clips keep one value per frame and no times, the others one time per value
+bool CookedAnimation::ValidateRawClip(const AnimationClip& Clip)
+{
+	for(unsigned int i=0;i<Clip._TransTrackArray.size();i++)
+	{
+		const TranslationTrack& Trans = Clip._TransTrackArray[i];
+		const RotationTrack& Rot = Clip._RotTrackArray[i];
+		const ScaleTrack& Scale = Clip._ScaleTrackArray[i];
+		if(Clip.IsUniform())
+		{
+			if(Trans._PosArray.size() != Clip._FrameCount || Rot._RotArray.size() != Clip._FrameCount || Scale._ScaleArray.size() != Clip._FrameCount
+				|| !Trans._TimeArray.empty() || !Rot._TimeArray.empty() || !Scale._TimeArray.empty())
+				return false;
+		}
+		else if(Trans._PosArray.size() != Trans._TimeArray.size() || Rot._RotArray.size() != Rot._TimeArray.size() || Scale._ScaleArray.size() != Scale._TimeArray.size())
+			return false;
+	}
+	return true;
+}
+
+bool CookedAnimation::LoadClips( const char* Path, std::vector<AnimationClip*>& OutClipArray )
+{
+	MappedFile File;
+	if(!File.Open(Path))
+		return false;
+
+	CookedStreamReader Reader(File.GetData(), File.GetSize());
+	uint32_t ClipCount;
+	if(!ReadHeader(Reader, COOKED_ANIM_MAGIC, COOKED_ANIM_VERSION, ClipCount))
+		return false;
+
+	std::vector<AnimationClip*> ClipArray;
+	bool bSuccess = true;
+	for(unsigned int ClipIndex=0;ClipIndex<ClipCount && bSuccess;ClipIndex++)
+	{
+		AnimationClip* Clip = new AnimationClip;
+		ClipArray.push_back(Clip);
+
+		uint32_t bCompressed, FrameCount;
+		if(!Reader.Read(&Clip->_Duration, sizeof(float)) || !Reader.ReadUInt(bCompressed)
+			|| !Reader.Read(&Clip->_SampleRate, sizeof(float)) || !Reader.ReadUInt(FrameCount) || FrameCount > File.GetSize())
+		{
+			bSuccess = false;
+			break;
+		}
+
+		if(bCompressed)
+		{
+			bSuccess = Reader.ReadArray(Clip->_CompressedTrackArray)
+				&& Reader.ReadArray(Clip->_KeyFrameArray)
+				&& Reader.ReadArray(Clip->_KeyDataArray)
+				&& ValidateCompressedClip(*Clip, FrameCount);
+			continue;
+		}
+
+		uint32_t TrackCount;
+		if(!Reader.ReadUInt(TrackCount) || TrackCount > File.GetSize())
+		{
+			bSuccess = false;
+			break;
+		}
+		Clip->_TransTrackArray.resize(TrackCount);
+		Clip->_RotTrackArray.resize(TrackCount);
+		Clip->_ScaleTrackArray.resize(TrackCount);
+		Clip->_FrameCount = FrameCount;
+		for(unsigned int i=0;i<TrackCount && bSuccess;i++)
+		{
+			bSuccess = Reader.ReadArray(Clip->_TransTrackArray[i]._TimeArray)
+				&& Reader.ReadArray(Clip->_TransTrackArray[i]._PosArray)
+				&& Reader.ReadArray(Clip->_RotTrackArray[i]._TimeArray)
+				&& Reader.ReadArray(Clip->_RotTrackArray[i]._RotArray)
+				&& Reader.ReadArray(Clip->_ScaleTrackArray[i]._TimeArray)
+				&& Reader.ReadArray(Clip->_ScaleTrackArray[i]._ScaleArray);
+		}
+		bSuccess = bSuccess && ValidateRawClip(*Clip);
+
+		// uniform clips play from the SoA layout
+		if(bSuccess && Clip->IsUniform())
+			Clip->BuildSoaKeys();
+	}
+
+	if(!bSuccess)
+	{
+		for(unsigned int i=0;i<ClipArray.size();i++)
+			delete ClipArray[i];
+		return false;
+	}
+
+	OutClipArray.insert(OutClipArray.end(), ClipArray.begin(), ClipArray.end());
+	return true;
+}
+
+std::string GetCookedSkeletonPath(const std::string& SourcePath)
+{
+	return ReplaceFileExtension(SourcePath, ".cskel");
+}
+
+std::string GetCookedAnimPath(const std::string& SourcePath)
+{
+	return ReplaceFileExtension(SourcePath, ".canim");
+}
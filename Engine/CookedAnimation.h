@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#define COOKED_SKELETON_MAGIC		0x4C4B5343	// "CSKL"
+#define COOKED_SKELETON_VERSION		2
+#define COOKED_ANIM_MAGIC			0x4D4E4143	// "CANM"
+#define COOKED_ANIM_VERSION			4
+
+class Skeleton;
+class SkeletonPose;
+class AnimationClip;
+
+// binary save/load of skeleton, reference pose and sampled or compressed clips
+class CookedAnimation
+{
+public:
+	static bool SaveSkeleton(const char* Path, const Skeleton* InSkeleton, const SkeletonPose* InRefPose);
+	static bool LoadSkeleton(const char* Path, Skeleton* OutSkeleton, SkeletonPose* OutRefPose);
+
+	static bool SaveClips(const char* Path, const std::vector<AnimationClip*>& InClipArray);
+	static bool LoadClips(const char* Path, std::vector<AnimationClip*>& OutClipArray);
+
+private:
+	static bool ValidateCompressedClip(AnimationClip& Clip, unsigned int FrameCount);
+	static bool ValidateRawClip(const AnimationClip& Clip);
+};
+
+std::string GetCookedSkeletonPath(const std::string& SourcePath);
+std::string GetCookedAnimPath(const std::string& SourcePath);
@@ -0,0 +1,307 @@
+#include <string.h>
+
+#include "CookedMesh.h"
+
+static uint64_t AlignOffset(uint64_t Offset)
+{
+	return (Offset + COOKED_MESH_ALIGNMENT - 1) & ~(uint64_t)(COOKED_MESH_ALIGNMENT - 1);
+}
+
+static bool IsRangeValid(uint64_t Offset, uint64_t Size, uint64_t FileSize)
+{
+	return Offset <= FileSize && Size <= FileSize - Offset;
+}
+
+static bool IsIndexRangeValid(uint32_t IndexOffset, uint32_t TriangleCount, uint32_t IndexCount)
+{
+	return IsRangeValid(IndexOffset, (uint64_t)TriangleCount * 3, IndexCount);
+}
+
+static bool IsLittleEndianHost()
+{
+	const uint32_t Tag = COOKED_MESH_ENDIAN_TAG;
+	return *(const unsigned char*)&Tag == (COOKED_MESH_ENDIAN_TAG & 0xff);
+}
+
+template<class IndexType>
+static bool AreIndicesValid(const IndexType* Indices, uint32_t IndexCount, uint32_t VertexCount)
+{
+	for(uint32_t i=0;i<IndexCount;i++)
+	{
+		if(Indices[i] >= VertexCount)
+			return false;
+	}
+	return true;
+}
+
+// the ranges and indices inside the blobs, once the blobs are known to be in the file
+static bool IsMeshContentValid(const CookedMeshEntry& Entry, const CookedMeshView& View)
+{
+	if(Entry.LODCount == 0 && Entry.IndexCount % 3 != 0)
+		return false;
+	for(uint32_t i=0;i<Entry.SubMeshCount;i++)
+	{
+		const CookedSubMesh& SubMesh = View.SubMeshes[i];
+		if(!IsIndexRangeValid(SubMesh.IndexOffset, SubMesh.TriangleCount, Entry.IndexCount)
+			|| !IsRangeValid(SubMesh.ClusterOffset, SubMesh.ClusterCount, Entry.ClusterCount))
+			return false;
+	}
+	for(uint32_t i=0;i<Entry.LODCount;i++)
+	{
+		const CookedMeshLOD& LOD = View.LODs[i];
+		if(!IsIndexRangeValid(LOD.IndexOffset, LOD.TriangleCount, Entry.IndexCount) || LOD.VertexCount > Entry.VertexCount)
+			return false;
+	}
+	if(Entry.ClusterCount > 0 && Entry.ClusterStride < sizeof(CookedClusterRange))
+		return false;
+	for(uint32_t i=0;i<Entry.ClusterCount;i++)
+	{
+		const CookedClusterRange& Cluster = *(const CookedClusterRange*)((const unsigned char*)View.Clusters + (uint64_t)i * Entry.ClusterStride);
+		if(!IsIndexRangeValid(Cluster.IndexOffset, Cluster.TriangleCount, Entry.IndexCount))
+			return false;
+	}
+	// joint indices, checked against the skeleton once it is known
+	for(uint32_t i=0;i<Entry.RequiredBoneCount;i++)
+	{
+		if(View.RequiredBones[i] < 0)
+			return false;
+	}
+	// the occluder indexes its own positions
+	if(Entry.OccluderIndexCount % 3 != 0 || !AreIndicesValid(View.OccluderIndices, Entry.OccluderIndexCount, Entry.OccluderVertexCount))
+		return false;
+	if(Entry.IndexStride == sizeof(uint16_t))
+		return AreIndicesValid((const uint16_t*)View.IndexData, Entry.IndexCount, Entry.VertexCount);
+	return AreIndicesValid((const uint32_t*)View.IndexData, Entry.IndexCount, Entry.VertexCount);
+}
+
+CookedMeshFile::CookedMeshFile(void)
+	: _Header(NULL)
+	, _Entries(NULL)
+{
+}
+
+CookedMeshFile::~CookedMeshFile(void)
+{
+	Close();
+}
+
+bool CookedMeshFile::Open(const char* Path)
+{
+	Close();
+	if(!_File.Open(Path))
+		return false;
+
+	const uint64_t FileSize = _File.GetSize();
+	if(FileSize < sizeof(CookedMeshFileHeader))
+	{
+		Close();
+		return false;
+	}
+
+	const CookedMeshFileHeader* Header = (const CookedMeshFileHeader*)_File.GetData();
+	if(Header->Magic != COOKED_MESH_MAGIC || Header->Version != COOKED_MESH_VERSION
+		|| Header->EndianTag != COOKED_MESH_ENDIAN_TAG || Header->FileSize != FileSize
+		|| !IsRangeValid(Header->MeshTableOffset, (uint64_t)Header->MeshCount * sizeof(CookedMeshEntry), FileSize))
+	{
+		Close();
+		return false;
+	}
+
+	_Header = Header;
+	_Entries = (const CookedMeshEntry*)(_File.GetData() + Header->MeshTableOffset);
+	return true;
+}
+
+void CookedMeshFile::Close()
+{
+	_File.Close();
+	_Header = NULL;
+	_Entries = NULL;
+}
+
+bool CookedMeshFile::GetMesh(unsigned int MeshIndex, CookedMeshView& OutView) const
+{
+	if(MeshIndex >= GetMeshCount())
+		return false;
+
+	const CookedMeshEntry& Entry = _Entries[MeshIndex];
+	const uint64_t FileSize = _File.GetSize();
+	if(Entry.IndexStride != sizeof(uint16_t) && Entry.IndexStride != sizeof(uint32_t))
+		return false;
+	if(!IsRangeValid(Entry.VertexDataOffset, (uint64_t)Entry.VertexCount * Entry.VertexStride, FileSize)
+		|| !IsRangeValid(Entry.IndexDataOffset, (uint64_t)Entry.IndexCount * Entry.IndexStride, FileSize)
+		|| !IsRangeValid(Entry.SubMeshOffset, (uint64_t)Entry.SubMeshCount * sizeof(CookedSubMesh), FileSize)
+		|| !IsRangeValid(Entry.SkinInfoOffset, (uint64_t)Entry.SkinInfoCount * Entry.SkinInfoStride, FileSize)
+		|| !IsRangeValid(Entry.RequiredBoneOffset, (uint64_t)Entry.RequiredBoneCount * sizeof(int32_t), FileSize)
+		|| !IsRangeValid(Entry.ClusterOffset, (uint64_t)Entry.ClusterCount * Entry.ClusterStride, FileSize)
+		|| !IsRangeValid(Entry.LODOffset, (uint64_t)Entry.LODCount * sizeof(CookedMeshLOD), FileSize)
+		|| !IsRangeValid(Entry.OccluderVertexOffset, (uint64_t)Entry.OccluderVertexCount * 3 * sizeof(float), FileSize)
+		|| !IsRangeValid(Entry.OccluderIndexOffset, (uint64_t)Entry.OccluderIndexCount * sizeof(uint32_t), FileSize))
+		return false;
+
+	const unsigned char* Base = _File.GetData();
+	OutView.Entry = &Entry;
+	OutView.VertexData = Base + Entry.VertexDataOffset;
+	OutView.IndexData = Base + Entry.IndexDataOffset;
+	OutView.SubMeshes = (const CookedSubMesh*)(Base + Entry.SubMeshOffset);
+	OutView.SkinInfo = Entry.SkinInfoCount > 0 ? Base + Entry.SkinInfoOffset : NULL;
+	OutView.RequiredBones = Entry.RequiredBoneCount > 0 ? (const int32_t*)(Base + Entry.RequiredBoneOffset) : NULL;
+	OutView.Clusters = Entry.ClusterCount > 0 ? Base + Entry.ClusterOffset : NULL;
+	OutView.LODs = Entry.LODCount > 0 ? (const CookedMeshLOD*)(Base + Entry.LODOffset) : NULL;
+	OutView.OccluderVertices = Entry.OccluderVertexCount > 0 ? (const float*)(Base + Entry.OccluderVertexOffset) : NULL;
+	OutView.OccluderIndices = Entry.OccluderIndexCount > 0 ? (const uint32_t*)(Base + Entry.OccluderIndexOffset) : NULL;
+	return IsMeshContentValid(Entry, OutView);
+}
+
+CookedMeshDesc::CookedMeshDesc()
+{
+	memset(this, 0, sizeof(CookedMeshDesc));
+}
+
+void CookedMeshWriter::AddMesh(const CookedMeshDesc& Desc)
+{
+	_MeshArray.push_back(PendingMesh());
+	PendingMesh& Mesh = _MeshArray.back();
+
+	CookedMeshEntry& Entry = Mesh.Entry;
+	memset(&Entry, 0, sizeof(CookedMeshEntry));
+	Entry.MeshType = Desc.MeshType;
+	Entry.VertexStride = Desc.VertexStride;
+	Entry.VertexCount = Desc.VertexCount;
+	Entry.IndexCount = Desc.IndexCount;
+	Entry.IndexStride = Desc.IndexStride;
+	Entry.VertexFlags = Desc.VertexFlags;
+	Entry.NumTexCoord = Desc.NumTexCoord;
+	Entry.SubMeshCount = Desc.SubMeshCount;
+	Entry.SkinInfoStride = Desc.SkinInfoStride;
+	Entry.SkinInfoCount = Desc.SkinInfoCount;
+	Entry.RequiredBoneCount = Desc.RequiredBoneCount;
+	Entry.ClusterStride = Desc.ClusterStride;
+	Entry.ClusterCount = Desc.ClusterCount;
+	Entry.LODCount = Desc.LODCount;
+	Entry.OccluderVertexCount = Desc.OccluderVertexCount;
+	Entry.OccluderIndexCount = Desc.OccluderIndexCount;
+	memcpy(Entry.BoundsMin, Desc.BoundsMin, sizeof(Entry.BoundsMin));
+	memcpy(Entry.BoundsMax, Desc.BoundsMax, sizeof(Entry.BoundsMax));
+
+	const unsigned char* VertexBytes = (const unsigned char*)Desc.VertexData;
+	Mesh.VertexData.assign(VertexBytes, VertexBytes + Desc.VertexCount * Desc.VertexStride);
+	const unsigned char* IndexBytes = (const unsigned char*)Desc.IndexData;
+	Mesh.IndexData.assign(IndexBytes, IndexBytes + Desc.IndexCount * Desc.IndexStride);
+	Mesh.SubMeshes.assign(Desc.SubMeshes, Desc.SubMeshes + Desc.SubMeshCount);
+	if(Desc.SkinInfo)
+	{
+		const unsigned char* SkinBytes = (const unsigned char*)Desc.SkinInfo;
+		Mesh.SkinInfo.assign(SkinBytes, SkinBytes + Desc.SkinInfoCount * Desc.SkinInfoStride);
+	}
+	if(Desc.RequiredBones)
+		Mesh.RequiredBones.assign(Desc.RequiredBones, Desc.RequiredBones + Desc.RequiredBoneCount);
+	if(Desc.Clusters)
+	{
+		const unsigned char* ClusterBytes = (const unsigned char*)Desc.Clusters;
+		Mesh.Clusters.assign(ClusterBytes, ClusterBytes + Desc.ClusterCount * Desc.ClusterStride);
+	}
+	if(Desc.LODs)
+		Mesh.LODs.assign(Desc.LODs, Desc.LODs + Desc.LODCount);
+	if(Desc.OccluderVertices)
+		Mesh.OccluderVertices.assign(Desc.OccluderVertices, Desc.OccluderVertices + Desc.OccluderVertexCount * 3);
+	if(Desc.OccluderIndices)
+		Mesh.OccluderIndices.assign(Desc.OccluderIndices, Desc.OccluderIndices + Desc.OccluderIndexCount);
+}
+
+bool CookedMeshWriter::Save(const char* Path) const
+{
+	if(!IsLittleEndianHost())
+		return false;
+
+	CookedMeshFileHeader Header;
+	memset(&Header, 0, sizeof(CookedMeshFileHeader));
+	Header.Magic = COOKED_MESH_MAGIC;
+	Header.Version = COOKED_MESH_VERSION;
+	Header.EndianTag = COOKED_MESH_ENDIAN_TAG;
+	Header.MeshCount = (uint32_t)_MeshArray.size();
+	Header.MeshTableOffset = AlignOffset(sizeof(CookedMeshFileHeader));
+
+	// lay out blobs after the mesh table
+	std::vector<CookedMeshEntry> EntryArray(_MeshArray.size());
+	uint64_t Offset = Header.MeshTableOffset + EntryArray.size() * sizeof(CookedMeshEntry);
+	for(unsigned int i=0;i<_MeshArray.size();i++)
+	{
+		const PendingMesh& Mesh = _MeshArray[i];
+		CookedMeshEntry& Entry = EntryArray[i];
+		Entry = Mesh.Entry;
+
+		Offset = AlignOffset(Offset);
+		Entry.VertexDataOffset = Offset;
+		Offset += Mesh.VertexData.size();
+
+		Offset = AlignOffset(Offset);
+		Entry.IndexDataOffset = Offset;
+		Offset += Mesh.IndexData.size();
+
+		Offset = AlignOffset(Offset);
+		Entry.SubMeshOffset = Offset;
+		Offset += Mesh.SubMeshes.size() * sizeof(CookedSubMesh);
+
+		Offset = AlignOffset(Offset);
+		Entry.SkinInfoOffset = Offset;
+		Offset += Mesh.SkinInfo.size();
+
+		Offset = AlignOffset(Offset);
+		Entry.RequiredBoneOffset = Offset;
+		Offset += Mesh.RequiredBones.size() * sizeof(int32_t);
+
+		Offset = AlignOffset(Offset);
+		Entry.ClusterOffset = Offset;
+		Offset += Mesh.Clusters.size();
+
+		Offset = AlignOffset(Offset);
+		Entry.LODOffset = Offset;
+		Offset += Mesh.LODs.size() * sizeof(CookedMeshLOD);
+
+		Offset = AlignOffset(Offset);
+		Entry.OccluderVertexOffset = Offset;
+		Offset += Mesh.OccluderVertices.size() * sizeof(float);
+
+		Offset = AlignOffset(Offset);
+		Entry.OccluderIndexOffset = Offset;
+		Offset += Mesh.OccluderIndices.size() * sizeof(uint32_t);
+	}
+	Header.FileSize = Offset;
+
+	std::vector<unsigned char> FileData((size_t)Header.FileSize, 0);
+	memcpy(&FileData[0], &Header, sizeof(CookedMeshFileHeader));
+	if(!EntryArray.empty())
+		memcpy(&FileData[(size_t)Header.MeshTableOffset], &EntryArray[0], EntryArray.size() * sizeof(CookedMeshEntry));
+
+	for(unsigned int i=0;i<_MeshArray.size();i++)
+	{
+		const PendingMesh& Mesh = _MeshArray[i];
+		const CookedMeshEntry& Entry = EntryArray[i];
+		if(!Mesh.VertexData.empty())
+			memcpy(&FileData[(size_t)Entry.VertexDataOffset], &Mesh.VertexData[0], Mesh.VertexData.size());
+		if(!Mesh.IndexData.empty())
+			memcpy(&FileData[(size_t)Entry.IndexDataOffset], &Mesh.IndexData[0], Mesh.IndexData.size());
+		if(!Mesh.SubMeshes.empty())
+			memcpy(&FileData[(size_t)Entry.SubMeshOffset], &Mesh.SubMeshes[0], Mesh.SubMeshes.size() * sizeof(CookedSubMesh));
+		if(!Mesh.SkinInfo.empty())
+			memcpy(&FileData[(size_t)Entry.SkinInfoOffset], &Mesh.SkinInfo[0], Mesh.SkinInfo.size());
+		if(!Mesh.RequiredBones.empty())
+			memcpy(&FileData[(size_t)Entry.RequiredBoneOffset], &Mesh.RequiredBones[0], Mesh.RequiredBones.size() * sizeof(int32_t));
+		if(!Mesh.Clusters.empty())
+			memcpy(&FileData[(size_t)Entry.ClusterOffset], &Mesh.Clusters[0], Mesh.Clusters.size());
+		if(!Mesh.LODs.empty())
+			memcpy(&FileData[(size_t)Entry.LODOffset], &Mesh.LODs[0], Mesh.LODs.size() * sizeof(CookedMeshLOD));
+		if(!Mesh.OccluderVertices.empty())
+			memcpy(&FileData[(size_t)Entry.OccluderVertexOffset], &Mesh.OccluderVertices[0], Mesh.OccluderVertices.size() * sizeof(float));
+		if(!Mesh.OccluderIndices.empty())
+			memcpy(&FileData[(size_t)Entry.OccluderIndexOffset], &Mesh.OccluderIndices[0], Mesh.OccluderIndices.size() * sizeof(uint32_t));
+	}
+
+	return WriteWholeFile(Path, &FileData[0], FileData.size());
+}
+
+std::string GetCookedMeshPath(const std::string& SourcePath)
+{
+	return ReplaceFileExtension(SourcePath, ".cmesh");
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+// cooked mesh file layout (all blobs 16 byte aligned, little endian)
+//   CookedMeshFileHeader
+//   CookedMeshEntry[MeshCount]
+//   per mesh : vertex data, index data, submeshes, skin info, required bones, clusters, lods, occluder
+#define COOKED_MESH_MAGIC		0x48534D43	// "CMSH"
+#define COOKED_MESH_VERSION		8
+#define COOKED_MESH_ENDIAN_TAG	0x01020304
+#define COOKED_MESH_ALIGNMENT	16
+
+// CookedMeshEntry::VertexFlags
+#define COOKED_VERTEX_COMPRESSED	0x1
+
+enum ECookedMeshType
+{
+	CookedMeshStatic = 0,
+	CookedMeshSkeletal = 1,
+};
+
+struct CookedMeshFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t EndianTag;
+	uint32_t MeshCount;
+	uint64_t MeshTableOffset;
+	uint64_t FileSize;
+};
+
+struct CookedSubMesh
+{
+	uint32_t IndexOffset;
+	uint32_t TriangleCount;
+	uint32_t ClusterOffset;
+	uint32_t ClusterCount;
+	float BoundsMin[3];		// the submesh's lod 0 triangles
+	float BoundsMax[3];
+};
+
+// every cluster record starts with its index range, the rest of ClusterStride is the engine's
+struct CookedClusterRange
+{
+	uint32_t IndexOffset;
+	uint32_t TriangleCount;
+};
+
+struct CookedMeshLOD
+{
+	uint32_t IndexOffset;
+	uint32_t TriangleCount;
+	uint32_t VertexCount;
+	float ScreenSize;
+	float Error;
+};
+
+struct CookedMeshEntry
+{
+	uint32_t MeshType;
+	uint32_t VertexStride;
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	uint32_t NumTexCoord;
+	uint32_t SubMeshCount;
+	uint32_t SkinInfoStride;
+	uint32_t SkinInfoCount;
+	uint32_t RequiredBoneCount;
+	uint32_t VertexFlags;
+	uint32_t IndexStride;		// 2 or 4
+	uint32_t ClusterStride;
+	uint32_t ClusterCount;
+	uint32_t LODCount;
+	uint32_t OccluderVertexCount;	// float3 positions
+	uint32_t OccluderIndexCount;	// uint32 indices
+	float BoundsMin[3];
+	float BoundsMax[3];
+	uint64_t VertexDataOffset;
+	uint64_t IndexDataOffset;
+	uint64_t SubMeshOffset;
+	uint64_t SkinInfoOffset;
+	uint64_t RequiredBoneOffset;
+	uint64_t ClusterOffset;
+	uint64_t LODOffset;
+	uint64_t OccluderVertexOffset;
+	uint64_t OccluderIndexOffset;
+};
+
+// zero-copy view into a mapped cooked mesh file
+struct CookedMeshView
+{
+	const CookedMeshEntry*	Entry;
+	const void*				VertexData;
+	const void*				IndexData;
+	const CookedSubMesh*	SubMeshes;
+	const void*				SkinInfo;
+	const int32_t*			RequiredBones;
+	const void*				Clusters;
+	const CookedMeshLOD*	LODs;
+	const float*			OccluderVertices;
+	const uint32_t*			OccluderIndices;
+};
+
+class CookedMeshFile
+{
+	MappedFile						_File;
+	const CookedMeshFileHeader*		_Header;
+	const CookedMeshEntry*			_Entries;
+public:
+	bool Open(const char* Path);
+	void Close();
+	unsigned int GetMeshCount() const {return _Header ? _Header->MeshCount : 0;}
+	// fails on blobs past the end of the file and on ranges or indices past what they index
+	bool GetMesh(unsigned int MeshIndex, CookedMeshView& OutView) const;
+
+	CookedMeshFile(void);
+	~CookedMeshFile(void);
+};
+
+struct CookedMeshDesc
+{
+	ECookedMeshType		MeshType;
+	unsigned int		VertexStride;
+	unsigned int		VertexCount;
+	const void*			VertexData;
+	unsigned int		IndexCount;
+	unsigned int		IndexStride;
+	const void*			IndexData;
+	unsigned int		VertexFlags;
+	unsigned int		NumTexCoord;
+	unsigned int		SubMeshCount;
+	const CookedSubMesh* SubMeshes;
+	unsigned int		SkinInfoStride;
+	unsigned int		SkinInfoCount;
+	const void*			SkinInfo;
+	unsigned int		RequiredBoneCount;
+	const int32_t*		RequiredBones;
+	unsigned int		ClusterStride;
+	unsigned int		ClusterCount;
+	const void*			Clusters;
+	unsigned int		LODCount;
+	const CookedMeshLOD* LODs;
+	unsigned int		OccluderVertexCount;
+	const float*		OccluderVertices;
+	unsigned int		OccluderIndexCount;
+	const uint32_t*		OccluderIndices;
+	float				BoundsMin[3];
+	float				BoundsMax[3];
+
+	CookedMeshDesc();
+};
+
+class CookedMeshWriter
+{
+	struct PendingMesh
+	{
+		CookedMeshEntry					Entry;
+		std::vector<unsigned char>		VertexData;
+		std::vector<unsigned char>		IndexData;
+		std::vector<CookedSubMesh>		SubMeshes;
+		std::vector<unsigned char>		SkinInfo;
+		std::vector<int32_t>			RequiredBones;
+		std::vector<unsigned char>		Clusters;
+		std::vector<CookedMeshLOD>		LODs;
+		std::vector<float>				OccluderVertices;
+		std::vector<uint32_t>			OccluderIndices;
+	};
+	std::vector<PendingMesh> _MeshArray;
+public:
+	void AddMesh(const CookedMeshDesc& Desc);
+	unsigned int GetMeshCount() const {return (unsigned int)_MeshArray.size();}
+	// fails on a big endian host, the format is little endian and blobs are written as they are in memory
+	bool Save(const char* Path) const;
+};
+
+// "dir/name.fbx" -> "dir/name.cmesh"
+std::string GetCookedMeshPath(const std::string& SourcePath);
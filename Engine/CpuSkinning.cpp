@@ -0,0 +1,61 @@
+#include "CpuSkinning.h"
+
+void CpuSkinning::ToColumns( const BoneMatrix3x4& In, XMFLOAT4X4& Out )
+{
+	// row vector form, p' = p.x * r[0] + p.y * r[1] + p.z * r[2] + r[3]
+	for(int c=0;c<4;c++)
+	{
+		Out.m[c][0] = (&In.Row[0].x)[c];
+		Out.m[c][1] = (&In.Row[1].x)[c];
+		Out.m[c][2] = (&In.Row[2].x)[c];
+		Out.m[c][3] = c == 3 ? 1.f : 0.f;
+	}
+}
+
+void CpuSkinning::SkinVertices( const SkinSourceVertex* Source, int Count, const XMFLOAT4X4* Columns, const BoneDualQuat* DualQuats,
+	ESkinningMode Mode, bool bTexCoord, void* OutVertices )
+{
+	const unsigned int Stride = bTexCoord ? sizeof(NormalTexVertex) : sizeof(NormalVertex);
+	unsigned char* Out = (unsigned char*)OutVertices;
+
+	for(int v=0;v<Count;v++, Out += Stride)
+	{
+		const SkinSourceVertex& Vertex = Source[v];
+		XMMATRIX Blended;
+		if(Mode == SKIN_DUALQUAT)
+		{
+			BoneMatrix3x4 BoneMat;
+			BonePalette::BlendDualQuat(DualQuats, Vertex.Bones, Vertex.Weights, BoneMat);
+			XMFLOAT4X4 BoneColumns;
+			ToColumns(BoneMat, BoneColumns);
+			Blended = XMLoadFloat4x4(&BoneColumns);
+		}
+		else
+		{
+			// weighted sum of the 4 influences, 4 columns each
+			const XMMATRIX First = XMLoadFloat4x4(&Columns[Vertex.Bones[0]]);
+			const XMVECTOR W0 = XMVectorReplicate(Vertex.Weights[0]);
+			Blended.r[0] = XMVectorMultiply(First.r[0], W0);
+			Blended.r[1] = XMVectorMultiply(First.r[1], W0);
+			Blended.r[2] = XMVectorMultiply(First.r[2], W0);
+			Blended.r[3] = XMVectorMultiply(First.r[3], W0);
+			for(int k=1;k<MAX_BONELINK;k++)
+			{
+				if(Vertex.Weights[k] == 0.f)
+					continue;
+				const XMMATRIX Bone = XMLoadFloat4x4(&Columns[Vertex.Bones[k]]);
+				const XMVECTOR W = XMVectorReplicate(Vertex.Weights[k]);
+				Blended.r[0] = XMVectorMultiplyAdd(Bone.r[0], W, Blended.r[0]);
+				Blended.r[1] = XMVectorMultiplyAdd(Bone.r[1], W, Blended.r[1]);
+				Blended.r[2] = XMVectorMultiplyAdd(Bone.r[2], W, Blended.r[2]);
+				Blended.r[3] = XMVectorMultiplyAdd(Bone.r[3], W, Blended.r[3]);
+			}
+		}
+
+		NormalVertex& Result = *(NormalVertex*)Out;
+		XMStoreFloat3(&Result.Position, XMVector3Transform(XMLoadFloat3(&Vertex.Position), Blended));
+		XMStoreFloat3(&Result.Normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&Vertex.Normal), Blended)));
+		if(bTexCoord)
+			((NormalTexVertex*)Out)->TexCoord = Vertex.TexCoord;
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "MathTypes.h"
+#include "BonePalette.h"
+
+#define MAX_BONELINK 4
+
+#define PRESKIN_CPU_CHUNK	1024	// vertices per worker task
+
+// float vertices, what static meshes draw and what pre-skinning writes
+struct NormalVertex
+{
+	XMFLOAT3 Position;
+	XMFLOAT3 Normal;
+};
+
+struct NormalTexVertex
+{
+	XMFLOAT3 Position;
+	XMFLOAT3 Normal;
+	XMFLOAT2 TexCoord;
+};
+
+// a vertex as the skinning vertex shader sees it, decoded from the vertex buffer contents (quantized weights,
+// decompressed position/normal). input of the cpu pre-skinning backend, so it matches the gpu one
+struct SkinSourceVertex
+{
+	XMFLOAT3		Position;
+	XMFLOAT3		Normal;
+	XMFLOAT2		TexCoord;
+	float			Weights[MAX_BONELINK];
+	unsigned char	Bones[MAX_BONELINK];
+};
+
+// the cpu backend of PreSkinner, no device needed
+class CpuSkinning
+{
+public:
+	// Columns holds the transposed skinning matrix of every mesh bone, DualQuats the dual quaternions for
+	// SKIN_DUALQUAT. writes Count NormalVertex or NormalTexVertex, any Count, PreSkinner runs it per chunk
+	static void SkinVertices(const SkinSourceVertex* Source, int Count, const XMFLOAT4X4* Columns, const BoneDualQuat* DualQuats,
+		ESkinningMode Mode, bool bTexCoord, void* OutVertices);
+	// palette 3x4 to the row vector 4x4 the kernel loads
+	static void ToColumns(const BoneMatrix3x4& In, XMFLOAT4X4& Out);
+};
@@ -0,0 +1,38 @@
+#include "Engine.h"
+#include "Camera.h"
+#include "DeferredClusteredPixelShader.h"
+#include "LightClusterBuffers.h"
+
+
+DeferredClusteredPixelShader::DeferredClusteredPixelShader(char* szFileName, char* szFuncName, D3D10_SHADER_MACRO* pDefines )
+	:PixelShader(szFileName, szFuncName , pDefines)
+{
+	CreateConstantBuffer<ShaderConstant>();
+}
+
+
+DeferredClusteredPixelShader::~DeferredClusteredPixelShader(void)
+{
+}
+
+void DeferredClusteredPixelShader::SetShaderParameter(LightClusterBuffers* Clusters)
+{
+	ShaderConstant _SC;
+
+	_SC.mProjection = XMMatrixTranspose( XMLoadFloat4x4(&GEngine->_ProjectionMat));
+
+	float Near = GEngine->_CurrentCamera->GetNear();
+	float Far = GEngine->_CurrentCamera->GetFar();
+	_SC.ProjectionParams.x =Far/(Far - Near);
+	_SC.ProjectionParams.y =Near/(Near - Far);
+	_SC.ProjectionParams.z =Far;
+	_SC.ViewportParams.x = (float)GEngine->_Width;
+	_SC.ViewportParams.y = (float)GEngine->_Height;
+	_SC.ClusterParams = XMFLOAT4(Clusters->_SliceScale, Clusters->_SliceBias, 0.f, 0.f);
+	_SC.ClusterGrid = XMFLOAT4((float)LIGHT_CLUSTER_X, (float)LIGHT_CLUSTER_Y, (float)LIGHT_CLUSTER_Z, 0.f);
+	GEngine->_ImmediateContext->UpdateSubresource( _ConstantBuffer, 0, NULL, &_SC, 0, 0 );
+	GEngine->_ImmediateContext->PSSetConstantBuffers( 0, 1, &_ConstantBuffer );
+
+	ID3D11ShaderResourceView* aSRV[3] = {Clusters->_ClusterBufferRV, Clusters->_IndexBufferRV, Clusters->_LightBufferRV};
+	GEngine->_ImmediateContext->PSSetShaderResources( 3, 3, aSRV );
+}
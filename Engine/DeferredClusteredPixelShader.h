@@ -0,0 +1,24 @@
+#pragma once
+#include "pixelshader.h"
+
+class LightClusterBuffers;
+
+// resolve of clustered point lighting, each pixel shades the lights of its cluster
+class DeferredClusteredPixelShader :
+	public PixelShader
+{
+	struct ShaderConstant
+	{
+		XMMATRIX mProjection;
+		XMFLOAT4 ProjectionParams;
+		XMFLOAT4 ViewportParams;
+		XMFLOAT4 ClusterParams;
+		XMFLOAT4 ClusterGrid;
+	};
+public:
+	// constants and the uploaded cluster buffers at t3 - t5
+	void SetShaderParameter(LightClusterBuffers* Clusters);
+
+	DeferredClusteredPixelShader( char* szFileName, char* szFuncName, D3D10_SHADER_MACRO* pDefines = NULL);
+	virtual ~DeferredClusteredPixelShader(void);
+};
@@ -18,11 +18,12 @@ DrawingPolicy::~DrawingPolicy(void)
 }
 
 
-ShaderRes* DrawingPolicy::GetShaderRes( int NumTex, EVertexProcessingType VPType)
+ShaderRes* DrawingPolicy::GetShaderRes( int NumTex, EVertexProcessingType VPType, bool Compressed)
 {
 	ShaderMapKey SKey;
 	SKey.NumTex = NumTex;
 	SKey.VertexProcessingType = VPType;
+	SKey.Compressed = Compressed;
 	std::map<ShaderMapKey, ShaderRes*>::iterator it;
 	it = ShaderMap.find(SKey);
 	if (it != ShaderMap.end())
@@ -36,4 +37,27 @@ ShaderRes* DrawingPolicy::GetShaderRes( int NumTex, EVertexProcessingType VPType
 		ShaderMap.insert(std::pair<ShaderMapKey, ShaderRes*>(SKey, pShaderRes));
 		return pShaderRes;
 	}
-}
\ No newline at end of file
+}
+void DrawingPolicy::DrawVisibleSubMeshes( StaticMesh* pMesh, const unsigned char* SubMeshVisible )
+{
+	const int SubMeshCount = pMesh->_SubMeshArray.size();
+	int s = 0;
+	while(s < SubMeshCount)
+	{
+		if(!SubMeshVisible[s])
+		{
+			s++;
+			continue;
+		}
+
+		// submeshes are back to back in the index buffer
+		const int IndexOffset = pMesh->_SubMeshArray[s]->_IndexOffset;
+		int TriangleCount = 0;
+		while(s < SubMeshCount && SubMeshVisible[s] && pMesh->_SubMeshArray[s]->_IndexOffset == IndexOffset + TriangleCount * 3)
+		{
+			TriangleCount += pMesh->_SubMeshArray[s]->_TriangleCount;
+			s++;
+		}
+		GEngine->_ImmediateContext->DrawIndexed( TriangleCount*3, IndexOffset, 0 );
+	}
+}
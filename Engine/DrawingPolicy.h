@@ -22,10 +22,16 @@ protected:
 	std::string FileName;
 
 public:
-	virtual void DrawStaticMesh(StaticMesh* pMesh, XMMATRIX& ViewMat, XMMATRIX& ProjectionMat) = 0;
+	// SubMeshVisible, one entry per submesh, limits lod 0 to the submeshes that passed culling. NULL draws them all
+	virtual void DrawStaticMesh(StaticMesh* pMesh, XMMATRIX& ViewMat, XMMATRIX& ProjectionMat, const unsigned char* SubMeshVisible = NULL) = 0;
 	virtual void DrawSkeletalMeshData(SkeletalMeshRenderData* pRenderData, XMMATRIX& ViewMat, XMMATRIX& ProjectionMat) = 0;
 
-	ShaderRes* GetShaderRes(int NumTex, EVertexProcessingType VPType);
+	ShaderRes* GetShaderRes(int NumTex, EVertexProcessingType VPType, bool Compressed);
+
+protected:
+	// one draw per run of adjacent visible submeshes of lod 0
+	void DrawVisibleSubMeshes(StaticMesh* pMesh, const unsigned char* SubMeshVisible);
+public:
 
 	DrawingPolicy(void);
 	virtual ~DrawingPolicy(void);
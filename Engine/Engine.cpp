@@ -1,4 +1,5 @@
 #include <cassert>
+#include <algorithm>
 #include "Engine.h"
 #include "SimpleDrawingPolicy.h"
 #include "LineBatcher.h"
@@ -6,6 +7,15 @@
 #include "Texture2D.h"
 #include "TextureDepth2D.h"
 #include "SkeletalMeshComponent.h"
+#include "SkeletalMeshRegistry.h"
+#include "BonePaletteArena.h"
+#include "PreSkinner.h"
+#include "FrustumCuller.h"
+#include "ShadowCasterCuller.h"
+#include "Scene.h"
+#include "OcclusionCuller.h"
+#include "LightClusterBuffers.h"
+#include "MeshSimplifier.h"
 #include "SkeletalMesh.h"
 #include "DirectionalLightComponent.h"
 #include "PointLightComponent.h"
@@ -19,10 +29,14 @@
 #include "DeferredShadowPixelShader.h"
 #include "DeferredPointLightPixelShader.h"
 #include "DeferredDirLightPixelShader.h"
+#include "DeferredClusteredPixelShader.h"
 #include "CombineLitPixelShader.h"
 #include "VisualizeDepthPixelShader.h"
 #include "VisualizeSimplePixelShader.h"
 #include "QuadVertexShader.h"
+#include "CookedMesh.h"
+#include "CookedAnimation.h"
+#include "AnimClipInstance.h"
 
 struct SCREEN_VERTEX
 {
@@ -37,6 +51,68 @@ struct VisDepthPSCBStruct
 	XMFLOAT4 ProjectionParams;
 };
 
+// meshes are loaded from the cooked file next to the fbx when it exists, otherwise imported and cooked
+template<class MeshType>
+bool LoadCookedMeshes(const std::string& CookedPath, std::vector<MeshType*>& OutMeshArray)
+{
+	CookedMeshFile CookedFile;
+	if(!CookedFile.Open(CookedPath.c_str()))
+		return false;
+
+	std::vector<MeshType*> MeshArray;
+	for(unsigned int i=0;i<CookedFile.GetMeshCount();i++)
+	{
+		CookedMeshView View;
+		MeshType* Mesh = new MeshType;
+		if(!CookedFile.GetMesh(i, View) || !Mesh->ImportFromCookedMesh(View))
+		{
+			delete Mesh;
+			for(unsigned int k=0;k<MeshArray.size();k++)
+				delete MeshArray[k];
+			return false;
+		}
+		MeshArray.push_back(Mesh);
+	}
+
+	OutMeshArray.insert(OutMeshArray.end(), MeshArray.begin(), MeshArray.end());
+	return true;
+}
+
+static bool AreRequiredBonesValid(const std::vector<SkeletalMesh*>& MeshArray, int JointCount)
+{
+	for(unsigned int i=0;i<MeshArray.size();i++)
+	{
+		for(unsigned int b=0;b<MeshArray[i]->_RequiredBoneArray.size();b++)
+		{
+			if(MeshArray[i]->_RequiredBoneArray[b] >= JointCount)
+				return false;
+		}
+	}
+	return true;
+}
+
+static bool AreClipsValid(const std::vector<AnimationClip*>& ClipArray, int JointCount)
+{
+	for(unsigned int i=0;i<ClipArray.size();i++)
+	{
+		if(ClipArray[i]->GetJointCount() != JointCount)
+			return false;
+	}
+	return true;
+}
+
+template<class MeshType>
+void SaveCookedMeshes(const std::string& CookedPath, std::vector<MeshType*>& MeshArray)
+{
+	CookedMeshWriter Writer;
+	for(unsigned int i=0;i<MeshArray.size();i++)
+	{
+		MeshArray[i]->AddToCookedMesh(Writer);
+	}
+	if(!Writer.Save(CookedPath.c_str()))
+		cout_debug("failed to save cooked mesh : %s\n", CookedPath.c_str());
+}
+
 Engine* GEngine;
 Engine::Engine(void)
 	:_hWnd(NULL)
@@ -61,12 +137,26 @@ Engine::Engine(void)
 	,_TextureRV(NULL)
 	,_DeferredShadowTexture(NULL)
 	,_StaticMeshComponent(NULL)
+	,_FrustumCuller(NULL)
+	,_ShadowCasterCuller(NULL)
+	,_Scene(NULL)
+	,_OcclusionCuller(NULL)
+	,_bOcclusionCulling(true)
+	,_bLogCullStats(false)
 	,_CurrentCamera(NULL)
 	,_Input(NULL)
 	,_DeferredDirPS(NULL)
 	,_DeferredPointPS(NULL)
 	,_DeferredShadowPS(NULL)
+	,_DeferredClusteredPS(NULL)
+	,_LightClusterBuffers(NULL)
+	,_bClusteredLighting(true)
+	,_PointLightCount(0)
 	,_QuadVS(NULL)
+	,_SkeletalMeshRegistry(NULL)
+	,_BonePaletteArena(NULL)
+	,_PreSkinner(NULL)
+	,_CrowdCount(0)
 	
 {
 	_CrtSetDbgFlag ( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
@@ -90,6 +180,7 @@ Engine::~Engine(void)
 	if(_ScreenQuadVB) _ScreenQuadVB->Release();
 	
 	if(_DeferredShadowPS) delete _DeferredShadowPS;
+	if(_DeferredClusteredPS) delete _DeferredClusteredPS;
 	if(_DeferredPointPS) delete _DeferredPointPS;
 	if(_DeferredDirPS) delete _DeferredDirPS;
 	if(_CombineLitPS) delete _CombineLitPS;
@@ -116,7 +207,19 @@ Engine::~Engine(void)
 	if(_GSkeleton) delete _GSkeleton;
 	if(_GPose) delete _GPose;
 	if(_GSkeletalMeshComponent) delete _GSkeletalMeshComponent;
+	for(unsigned int i=0;i<_CrowdComponentArray.size();i++)
+	{
+		delete _CrowdComponentArray[i];
+	}
+	if(_SkeletalMeshRegistry) delete _SkeletalMeshRegistry;
+	if(_BonePaletteArena) delete _BonePaletteArena;
+	if(_PreSkinner) delete _PreSkinner;
 	if(_StaticMeshComponent) delete _StaticMeshComponent;
+	if(_FrustumCuller) delete _FrustumCuller;
+	if(_ShadowCasterCuller) delete _ShadowCasterCuller;
+	if(_Scene) delete _Scene;
+	if(_OcclusionCuller) delete _OcclusionCuller;
+	if(_LightClusterBuffers) delete _LightClusterBuffers;
 
 	for(unsigned int i=0;i<_StaticMeshArray.size();i++)
 	{
@@ -306,6 +409,7 @@ void Engine::InitDevice()
 	_DeferredDirPS  = new DeferredDirLightPixelShader("DeferredDirectional.fx", "PS");
 	_DeferredPointPS = new DeferredPointLightPixelShader("DeferredPoint.fx", "PS");
 	_DeferredShadowPS = new DeferredShadowPixelShader("DeferredShadow.fx", "PS");
+	_DeferredClusteredPS = new DeferredClusteredPixelShader("DeferredClustered.fx", "PS");
 	_CombineLitPS = new CombineLitPixelShader("CombineShader.fx", "PS");
 
 	/////////////
@@ -321,36 +425,118 @@ void Engine::InitDevice()
 	_GSkeleton = new Skeleton;
 	_GPose = new SkeletonPose;
 
-	FbxFileImporter FbxImporterObj("humanoid.fbx");
-	//FbxFileImporter FbxImporterObj("box_skin.fbx");
-	//FbxImporterObj.ImportStaticMesh(StaticMeshArray);
+	// the fbx is only opened when a cooked file is missing, see Cooker for offline cooking
+	std::string HumanoidPath = "humanoid.fbx";
+	//std::string HumanoidPath = "box_skin.fbx";
+	FbxFileImporter* FbxImporterObj = NULL;
 
-	FbxImporterObj.ImportSkeletalMesh(_SkeletalMeshArray);
+	// cooked meshes index the joints of the skeleton cooked with them, a stale pair is cooked again
+	std::string SkelMeshCookedPath = GetCookedMeshPath(HumanoidPath);
+	std::string SkeletonCookedPath = GetCookedSkeletonPath(HumanoidPath);
+	const bool bCookedSkeleton = CookedAnimation::LoadSkeleton(SkeletonCookedPath.c_str(), _GSkeleton, _GPose);
+	if(!bCookedSkeleton || LoadCookedMeshes(SkelMeshCookedPath, _SkeletalMeshArray) == false || !AreRequiredBonesValid(_SkeletalMeshArray, _GSkeleton->_JointCount))
+	{
+		for(unsigned int i=0;i<_SkeletalMeshArray.size();i++)
+			delete _SkeletalMeshArray[i];
+		_SkeletalMeshArray.clear();
+		FbxImporterObj = new FbxFileImporter(HumanoidPath);
+		FbxImporterObj->ImportSkeletalMesh(_SkeletalMeshArray);
+		for(unsigned int i=0;i<_SkeletalMeshArray.size();i++)
+		{
+			_SkeletalMeshArray[i]->CreateRenderBuffers();
+		}
+		SaveCookedMeshes(SkelMeshCookedPath, _SkeletalMeshArray);
+	}
 
 	for(unsigned int i=0;i<_SkeletalMeshArray.size();i++)
 	{
 		_GSkeletalMeshComponent->AddSkeletalMesh(_SkeletalMeshArray[i]);
 	}
-	FbxImporterObj.ImportSkeleton(&_GSkeleton, &_GPose);
-	//FbxImporterObj.ImportAnimClip(_AnimClipArray);
+
+	if(!bCookedSkeleton)
+	{
+		FbxImporterObj->LoadScene();
+		FbxImporterObj->ImportSkeleton(&_GSkeleton, &_GPose);
+		CookedAnimation::SaveSkeleton(SkeletonCookedPath.c_str(), _GSkeleton, _GPose);
+	}
+
+	// clips are sampled against the joints of the skeleton above, so they are cooked again along with it
+	std::string AnimCookedPath = GetCookedAnimPath(HumanoidPath);
+	if(!bCookedSkeleton || !CookedAnimation::LoadClips(AnimCookedPath.c_str(), _AnimClipArray) || !AreClipsValid(_AnimClipArray, _GSkeleton->_JointCount))
+	{
+		for(unsigned int i=0;i<_AnimClipArray.size();i++)
+			delete _AnimClipArray[i];
+		_AnimClipArray.clear();
+		if(FbxImporterObj == NULL)
+		{
+			FbxImporterObj = new FbxFileImporter(HumanoidPath);
+			FbxImporterObj->LoadScene();
+		}
+		FbxImporterObj->ImportAnimClip(_AnimClipArray);
+		if(_AnimClipArray.size())
+			CookedAnimation::SaveClips(AnimCookedPath.c_str(), _AnimClipArray);
+	}
+	if(FbxImporterObj) delete FbxImporterObj;
 
 	_GSkeletalMeshComponent->SetSkeleton(_GSkeleton);
-	_GSkeletalMeshComponent->SetCurrentPose(_GPose);
+	_GSkeletalMeshComponent->SetCurrentPose(*_GPose);
+
+	_SkeletalMeshRegistry = new SkeletalMeshRegistry;
+	_BonePaletteArena = new BonePaletteArena;
+	_PreSkinner = new PreSkinner;
+	_FrustumCuller = new FrustumCuller;
+	_ShadowCasterCuller = new ShadowCasterCuller;
+	_Scene = new Scene;
+	_OcclusionCuller = new OcclusionCuller;
+	_SkeletalMeshRegistry->Register(_GSkeletalMeshComponent);
+	_Scene->AddSkeletalMeshComponent(_GSkeletalMeshComponent);
+
+	// stress scene, a grid of instances sharing the meshes, skeleton and clips
+	const int CrowdColumns = (int)ceilf(sqrtf((float)_CrowdCount));
+	for(int i=0;i<_CrowdCount;i++)
+	{
+		SkeletalMeshComponent* Component = new SkeletalMeshComponent;
+		for(unsigned int m=0;m<_SkeletalMeshArray.size();m++)
+		{
+			Component->AddSkeletalMesh(_SkeletalMeshArray[m]);
+		}
+		Component->SetSkeleton(_GSkeleton);
+		Component->SetCurrentPose(*_GPose);
+		Component->SetWorld(XMMatrixTranslation((i % CrowdColumns - CrowdColumns * 0.5f) * 100.f, 0.f, (i / CrowdColumns - CrowdColumns * 0.5f) * 100.f));
+		if(_AnimClipArray.size())
+			Component->PlayAnim(_AnimClipArray[i % _AnimClipArray.size()], 0, 0.8f + 0.05f * (i % 9));
+		_CrowdComponentArray.push_back(Component);
+		_SkeletalMeshRegistry->Register(Component);
+		_Scene->AddSkeletalMeshComponent(Component);
+	}
 
-	GEngine->Tick();
+	if(_AnimClipArray.size())
+		_GSkeletalMeshComponent->PlayAnim(_AnimClipArray[0]);
+	cout_debug("humanoid : %d clips, %d crowd instances\n", (int)_AnimClipArray.size(), _CrowdCount);
 
-	
-	//_GSkeletalMeshComponent->PlayAnim(_AnimClipArray[1], 0, 0.2f);
+	GEngine->Tick();
 
-	FbxFileImporter FbxImporterObj2("sponza\\sponza.fbx");
-	//FbxFileImporter FbxImporterObj2("other.fbx");
-	FbxImporterObj2.ImportStaticMesh(_StaticMeshArray);
+	std::string SponzaPath = "sponza\\sponza.fbx";
+	//std::string SponzaPath = "other.fbx";
+	std::string StaticMeshCookedPath = GetCookedMeshPath(SponzaPath);
+	if(LoadCookedMeshes(StaticMeshCookedPath, _StaticMeshArray) == false)
+	{
+		FbxFileImporter FbxImporterObj2(SponzaPath);
+		FbxImporterObj2.ImportStaticMesh(_StaticMeshArray);
+		for(unsigned int i=0;i<_StaticMeshArray.size();i++)
+		{
+			_StaticMeshArray[i]->CreateRenderBuffers();
+		}
+		SaveCookedMeshes(StaticMeshCookedPath, _StaticMeshArray);
+	}
 
 	_StaticMeshComponent = new StaticMeshComponent;
 	for(unsigned int i=0;i<_StaticMeshArray.size();i++)
 	{
 		_StaticMeshComponent->AddStaticMesh(_StaticMeshArray[i]);
 	}
+	_Scene->AddStaticMeshComponent(_StaticMeshComponent);
+	_Scene->Build();
 
 	//cout_debug("staticmesh aabb min: %f %f %f\n", _StaticMeshComponent->_AABBMin.x, _StaticMeshComponent->_AABBMin.y, _StaticMeshComponent->_AABBMin.z);
 	//cout_debug("staticmesh aabb max: %f %f %f\n", _StaticMeshComponent->_AABBMax.x, _StaticMeshComponent->_AABBMax.y, _StaticMeshComponent->_AABBMax.z);
@@ -372,6 +558,24 @@ void Engine::InitDevice()
 	PointLightComponent* PointLight2 = new PointLightComponent(XMFLOAT4(  0.f, 0.f, 1.f, 1.0f), XMFLOAT3( 100.f, 50.f, 0.f ), 200.f);
 	_LightCompArray.push_back(PointLight2);
 
+	// stress scene, point lights scattered through the static meshes' bounds
+	unsigned int Seed = 1;
+	for(int i=0;i<_PointLightCount;i++)
+	{
+		float Random[7];
+		for(int r=0;r<7;r++)
+		{
+			Seed = Seed * 1664525 + 1013904223;
+			Random[r] = (Seed >> 8) / (float)(1 << 24);
+		}
+		const XMFLOAT3 Position(
+			_StaticMeshComponent->_AABBMin.x + (_StaticMeshComponent->_AABBMax.x - _StaticMeshComponent->_AABBMin.x) * Random[0],
+			_StaticMeshComponent->_AABBMin.y + (_StaticMeshComponent->_AABBMax.y - _StaticMeshComponent->_AABBMin.y) * Random[1],
+			_StaticMeshComponent->_AABBMin.z + (_StaticMeshComponent->_AABBMax.z - _StaticMeshComponent->_AABBMin.z) * Random[2]);
+		_LightCompArray.push_back(new PointLightComponent(XMFLOAT4(Random[3], Random[4], Random[5], 1.f), Position, 50.f + 100.f * Random[6]));
+	}
+	_LightClusterBuffers = new LightClusterBuffers;
+
 	_Input = new Input;
 	_Input->Create(_hWnd, (long)_Width, (long)_Height, 0, 0);
 
@@ -502,6 +706,54 @@ void Engine::Tick()
 		}
 	}
 
+	// linear / dual quaternion skinning on every skinned component
+	if(_Input && _SkeletalMeshRegistry && _Input->IsKeyDn(DIK_K))
+	{
+		for(unsigned int i=0;i<_SkeletalMeshRegistry->_ComponentArray.size();i++)
+		{
+			SkeletalMeshComponent* Component = _SkeletalMeshRegistry->_ComponentArray[i];
+			Component->SetSkinningMode(Component->_SkinningMode == SKIN_LINEAR ? SKIN_DUALQUAT : SKIN_LINEAR);
+		}
+	}
+
+	// baked palettes for every playing component, each instance indexes a frame of its clip's bake.
+	// the figures logged are of the frame before the switch, press twice to compare both paths
+	if(_Input && _SkeletalMeshRegistry && _Input->IsKeyDn(DIK_B))
+	{
+		int BakedCount = 0;
+		for(unsigned int i=0;i<_SkeletalMeshRegistry->_ComponentArray.size();i++)
+		{
+			SkeletalMeshComponent* Component = _SkeletalMeshRegistry->_ComponentArray[i];
+			if(Component->_BakedAnim || Component->_CurrentAnim == NULL)
+				Component->SetBakedAnim(NULL);
+			else
+			{
+				Component->SetBakedAnim(_SkeletalMeshRegistry->GetBakedAnimation(Component->_CurrentAnim->GetClip(), _GSkeleton, *_GPose));
+				BakedCount++;
+			}
+		}
+		cout_debug("baked playback : %d of %d components\n", BakedCount, (int)_SkeletalMeshRegistry->_ComponentArray.size());
+		_SkeletalMeshRegistry->LogBakedStats();
+	}
+
+	// pre-skinning backend: stream out, cpu, off
+	if(_Input && _PreSkinner && _Input->IsKeyDn(DIK_P))
+	{
+		_PreSkinner->_Backend = _PreSkinner->_Backend == PRESKIN_STREAMOUT ? PRESKIN_CPU : (_PreSkinner->_Backend == PRESKIN_CPU ? PRESKIN_OFF : PRESKIN_STREAMOUT);
+	}
+
+	// clustered point lights, or a full screen pass per light
+	if(_Input && _Input->IsKeyDn(DIK_L))
+	{
+		_bClusteredLighting = !_bClusteredLighting;
+	}
+
+	// software occlusion culling of the g-buffer pass
+	if(_Input && _Input->IsKeyDn(DIK_O))
+	{
+		_bOcclusionCulling = !_bOcclusionCulling;
+	}
+
 	LARGE_INTEGER CurrentTime;
 
 	QueryPerformanceCounter(&CurrentTime);
@@ -509,13 +761,29 @@ void Engine::Tick()
 	_TimeSeconds =	(float)(CurrentTime.QuadPart)/(float)_Freq.QuadPart;
 	//cout_debug("delta seconds: %f\n", _DeltaSeconds);
 
-	if(_GSkeletalMeshComponent) _GSkeletalMeshComponent->Tick(_DeltaSeconds);
-
 	if(_CurrentCamera) 
 	{
 		_CurrentCamera->Tick(_DeltaSeconds);
 	}
 
+	// after the camera, animation lod picks update rates from this frame's view
+	if(_SkeletalMeshRegistry)
+	{
+		if(_CurrentCamera)
+		{
+			XMMATRIX ViewMatrix, ProjectionMatrix;
+			_CurrentCamera->CalcViewInfo(ViewMatrix, ProjectionMatrix, _Width, _Height);
+			_SkeletalMeshRegistry->TickAnimation(_DeltaSeconds, &ViewMatrix, &ProjectionMatrix);
+		}
+		else
+		{
+			_SkeletalMeshRegistry->TickAnimation(_DeltaSeconds, NULL, NULL);
+		}
+	}
+	// components moved and animated, their bounds into the bvh before rendering queries it
+	if(_Scene) _Scene->Update();
+	if(_GSkeletalMeshComponent) _GSkeletalMeshComponent->DrawDebugBones();
+
 	_PrevTime = CurrentTime;
 }
 
@@ -523,6 +791,11 @@ void Engine::BeginRendering()
 {
 	_LineBatcher->BeginLine();
 
+	// palettes animated in Tick go to the gpu before the first pass that skins
+	_SkeletalMeshRegistry->UploadBoneMatrices(*_BonePaletteArena, _Device, _ImmediateContext);
+	// then skinned once, the g-buffer and the cascades draw the result
+	_PreSkinner->Skin(*_SkeletalMeshRegistry, *_BonePaletteArena);
+
 	// z pre pass?
 
 	RenderShadowMap();
@@ -544,18 +817,65 @@ void Engine::Render()
 	XMStoreFloat4x4(&_ProjectionMat, ProjectionMatrix);
 
 	SET_RASTERIZER_STATE(RS_NORMAL);
-	// draw scene into g-buffer
-	for(unsigned int i=0;i<_StaticMeshComponent->_StaticMeshArray.size();i++)
+	// draw scene into g-buffer, the bvh's objects in the view frustum, then the submeshes of those static meshes
+	const XMMATRIX ViewProjection = XMMatrixMultiply(ViewMatrix, ProjectionMatrix);
+	_FrustumCuller->SetViewProjection(ViewProjection);
+	_FrustumCuller->ResetStats();
+	_VisibleObjectArray.clear();
+	_Scene->QueryFrustum(ViewProjection, _VisibleObjectArray);
+	_SubMeshVisibility.resize(_StaticMeshComponent->_SubMeshBounds._Count + 1);
+
+	// then what the largest occluders in view hide
+	LARGE_INTEGER OcclusionStart, OcclusionEnd;
+	QueryPerformanceCounter(&OcclusionStart);
+	if(_bOcclusionCulling)
+		RasterizeOccluders(ViewMatrix, ProjectionMatrix);
+	QueryPerformanceCounter(&OcclusionEnd);
+
+	int DrawnMeshCount = 0;
+	for(unsigned int v=0;v<_VisibleObjectArray.size();v++)
 	{
-		StaticMesh* Mesh = _StaticMeshComponent->_StaticMeshArray[i];
-		_GBufferDrawer->DrawStaticMesh(Mesh, ViewMatrix, ProjectionMatrix);
-	}
+		const SceneObject& Object = _Scene->_ObjectArray[_VisibleObjectArray[v]];
+		if(_bOcclusionCulling)
+		{
+			const SceneBVHObject& Bounds = _Scene->_BVH._ObjectArray[Object.Proxy];
+			if(!_OcclusionCuller->IsBoxVisible(Bounds.Min, Bounds.Max))
+				continue;
+		}
+		if(Object.Type == SCENE_OBJECT_SKELETAL_MESH)
+		{
+			SkeletalMeshComponent* Component = Object.SkeletalComponent;
+			for(unsigned int i=0;i<Component->_RenderDataArray.size();i++)
+			{
+				_GBufferDrawer->DrawSkeletalMeshData(Component->_RenderDataArray[i], ViewMatrix, ProjectionMatrix);
+			}
+			continue;
+		}
 
-	if(_GSkeletalMeshComponent)
+		StaticMesh* Mesh = Object.StaticComponent->_StaticMeshArray[Object.MeshIndex];
+		const unsigned char* SubMeshVisible = NULL;
+		const int SubMeshCount = Mesh->_SubMeshArray.size();
+		if(SubMeshCount > 1)
+		{
+			const int SubMeshBase = Object.StaticComponent->_SubMeshBase[Object.MeshIndex];
+			if(_FrustumCuller->Cull(Object.StaticComponent->_SubMeshBounds, SubMeshBase, SubMeshCount, &_SubMeshVisibility[SubMeshBase]) == 0)
+				continue;
+			if(_bOcclusionCulling && _OcclusionCuller->Cull(Object.StaticComponent->_SubMeshBounds, SubMeshBase, SubMeshCount, &_SubMeshVisibility[SubMeshBase]) == 0)
+				continue;
+			SubMeshVisible = &_SubMeshVisibility[SubMeshBase];
+		}
+		_GBufferDrawer->DrawStaticMesh(Mesh, ViewMatrix, ProjectionMatrix, SubMeshVisible);
+		DrawnMeshCount++;
+	}
+	if(_bLogCullStats)
 	{
-		for(unsigned int i=0;i<_GSkeletalMeshComponent->_RenderDataArray.size();i++)
+		cout_debug("scene bvh : %d nodes visited, %d / %d objects in the frustum, %d reinserted, %d rotations\n", _Scene->_BVH._Stats.VisitedCount, _Scene->_BVH._Stats.ReturnedCount, (int)_Scene->_ObjectArray.size(), _Scene->_BVH._Stats.ReinsertCount, _Scene->_BVH._Stats.RotationCount);
+		cout_debug("frustum cull : %d submesh boxes tested, %d visible, %d static meshes drawn\n", _FrustumCuller->_Stats.TestedCount, _FrustumCuller->_Stats.VisibleCount, DrawnMeshCount);
+		if(_bOcclusionCulling)
 		{
-			_GBufferDrawer->DrawSkeletalMeshData(_GSkeletalMeshComponent->_RenderDataArray[i], ViewMatrix, ProjectionMatrix);
+			const OcclusionCullStats& Stats = _OcclusionCuller->_Stats;
+			cout_debug("occlusion cull : %d occluders, %d triangles in %d tile bins, %d / %d boxes occluded, %f ms rasterizing\n", Stats.OccluderCount, Stats.TriangleCount, Stats.BinnedCount, Stats.OccludedCount, Stats.TestedCount,
+				(float)(OcclusionEnd.QuadPart - OcclusionStart.QuadPart) * 1000.f / (float)_Freq.QuadPart);
 		}
 	}
 
@@ -574,11 +894,36 @@ void Engine::Render()
 	SET_PS_SAMPLER(0, SS_POINT);
 	SET_PS_SAMPLER(1, SS_POINT);
 
+	// point lights go to their clusters and are shaded together, the rest keep their own pass
+	if(_bClusteredLighting)
+	{
+		_LightClusterBuffers->SetProjection(ProjectionMatrix, _CurrentCamera->GetNear(), _CurrentCamera->GetFar());
+		_LightClusterBuffers->BeginFrame(ViewMatrix);
+	}
 	for(unsigned int i=0;i<_LightCompArray.size();i++)
 	{
 		LightComponent* Light = _LightCompArray[i];
+		if(_bClusteredLighting && Light->AddToLightClusters(_LightClusterBuffers))
+			continue;
 		Light->RenderLightDeferred(_CurrentCamera);
 	}
+	if(_bClusteredLighting)
+	{
+		LARGE_INTEGER ClusterStart, ClusterEnd;
+		QueryPerformanceCounter(&ClusterStart);
+		_LightClusterBuffers->Build();
+		QueryPerformanceCounter(&ClusterEnd);
+		_LightClusterBuffers->Upload(_Device, _ImmediateContext);
+		_DeferredClusteredPS->SetShaderParameter(_LightClusterBuffers);
+		DrawFullScreenQuad11(_DeferredClusteredPS->GetPixelShader(), _Width, _Height);
+
+		if(_bLogCullStats)
+		{
+			const LightClusterStats& Stats = _LightClusterBuffers->_Stats;
+			cout_debug("light clusters : %d lights, %d indices over %d / %d clusters, %d most in one, %d dropped, %d overflowed, %f ms building\n", Stats.LightCount, Stats.IndexCount, Stats.LitClusterCount, LIGHT_CLUSTER_COUNT, Stats.MaxClusterLightCount, Stats.DroppedLightCount, Stats.OverflowCount,
+				(float)(ClusterEnd.QuadPart - ClusterStart.QuadPart) * 1000.f / (float)_Freq.QuadPart);
+		}
+	}
 
 	// combine pass
 	SET_BLEND_STATE(BS_NORMAL);
@@ -753,6 +1098,42 @@ void CreateAABBPoints( XMVECTOR* vAABBPoints, FXMVECTOR vCenter, FXMVECTOR vExte
 
 }
 
+void Engine::RasterizeOccluders( const XMMATRIX& ViewMatrix, const XMMATRIX& ProjectionMatrix )
+{
+	// static meshes in the frustum by screen size, the largest occlude the most
+	_OccluderCandidateArray.clear();
+	for(unsigned int v=0;v<_VisibleObjectArray.size();v++)
+	{
+		const SceneObject& Object = _Scene->_ObjectArray[_VisibleObjectArray[v]];
+		if(Object.Type != SCENE_OBJECT_STATIC_MESH)
+			continue;
+		StaticMesh* Mesh = Object.StaticComponent->_StaticMeshArray[Object.MeshIndex];
+		if(Mesh->_OccluderIndexArray.size() == 0)
+			continue;
+		const XMFLOAT3 Center((Mesh->_AABBMin.x + Mesh->_AABBMax.x) * 0.5f, (Mesh->_AABBMin.y + Mesh->_AABBMax.y) * 0.5f, (Mesh->_AABBMin.z + Mesh->_AABBMax.z) * 0.5f);
+		const XMFLOAT3 Extent(Mesh->_AABBMax.x - Center.x, Mesh->_AABBMax.y - Center.y, Mesh->_AABBMax.z - Center.z);
+		const float Radius = sqrtf(Extent.x * Extent.x + Extent.y * Extent.y + Extent.z * Extent.z);
+		const float ScreenSize = MeshSimplifier::ComputeScreenSize(Center, Radius, ViewMatrix, ProjectionMatrix);
+		if(ScreenSize >= OCCLUSION_MIN_OCCLUDER_SIZE)
+			_OccluderCandidateArray.push_back(std::make_pair(-ScreenSize, _VisibleObjectArray[v]));
+	}
+	std::sort(_OccluderCandidateArray.begin(), _OccluderCandidateArray.end());
+
+	_OcclusionCuller->BeginFrame(XMMatrixMultiply(ViewMatrix, ProjectionMatrix));
+	int TriangleCount = 0;
+	for(unsigned int i=0;i<_OccluderCandidateArray.size() && _OcclusionCuller->_Stats.OccluderCount<OCCLUSION_MAX_OCCLUDERS;i++)
+	{
+		const SceneObject& Object = _Scene->_ObjectArray[_OccluderCandidateArray[i].second];
+		StaticMesh* Mesh = Object.StaticComponent->_StaticMeshArray[Object.MeshIndex];
+		const int IndexCount = Mesh->_OccluderIndexArray.size();
+		if(TriangleCount + IndexCount / 3 > OCCLUSION_MAX_TRIANGLES)
+			continue;
+		TriangleCount += IndexCount / 3;
+		_OcclusionCuller->AddOccluder(&Mesh->_OccluderPositionArray[0], Mesh->_OccluderPositionArray.size(), &Mesh->_OccluderIndexArray[0], IndexCount);
+	}
+	_OcclusionCuller->Rasterize();
+}
+
 void Engine::RenderShadowMap()
 {
 	XMVECTOR Det;
@@ -762,6 +1143,24 @@ void Engine::RenderShadowMap()
 	XMVECTOR Up = XMVectorSet(ViewMatInv._31, ViewMatInv._32, ViewMatInv._33, 1.f);//XMLoadFloat3(&XMFLOAT3(0.f, 1.f, 0.f));
 	XMVECTOR Center = XMVectorSet(0.f, 0.f, 0.f, 0.f);
 
+	// every cascade shares the light view, the casters go to light space once. static meshes first, then skinned components
+	XMMATRIX LightView = XMMatrixLookAtRH( Center - LightDir, Center, Up );
+	_ShadowCasterCuller->BeginFrame(LightView);
+	const int StaticCasterCount = _StaticMeshComponent->_MeshBounds._Count;
+	for(int i=0;i<StaticCasterCount;i++)
+	{
+		const AABBSoaArray& Bounds = _StaticMeshComponent->_MeshBounds;
+		_ShadowCasterCuller->AddCaster(XMFLOAT3(Bounds._MinX[i], Bounds._MinY[i], Bounds._MinZ[i]), XMFLOAT3(Bounds._MaxX[i], Bounds._MaxY[i], Bounds._MaxZ[i]));
+	}
+	for(unsigned int c=0;c<_SkeletalMeshRegistry->_ComponentArray.size();c++)
+	{
+		XMFLOAT3 SphereCenter;
+		float Radius;
+		_SkeletalMeshRegistry->_ComponentArray[c]->GetBoundingSphere(SphereCenter, Radius);
+		_ShadowCasterCuller->AddCaster(XMFLOAT3(SphereCenter.x - Radius, SphereCenter.y - Radius, SphereCenter.z - Radius), XMFLOAT3(SphereCenter.x + Radius, SphereCenter.y + Radius, SphereCenter.z + Radius));
+	}
+	_ShadowCasterDraw.resize(_ShadowCasterCuller->_LightSpaceBounds._Count + 1);
+
 	for(unsigned int i=0;i<_CascadeArray.size();i++)
 	{
 		ShadowCascadeInfo* ShadowInfo = _CascadeArray[i];
@@ -796,8 +1195,6 @@ void Engine::RenderShadowMap()
 		XMMATRIX ProjectionMat = XMLoadFloat4x4(&_ProjectionMat);
 		CreateFrustumPointsFromCascadeInterval( fFrustumIntervalBegin, fFrustumIntervalEnd, ProjectionMat, vFrustumPoints); 
 
-		XMMATRIX LightView = XMMatrixLookAtRH( Center - LightDir, Center, Up );
-
 		XMVECTOR m_vSceneAABBMin = XMLoadFloat3(&_StaticMeshComponent->_AABBMin);
 		XMVECTOR m_vSceneAABBMax = XMLoadFloat3(&_StaticMeshComponent->_AABBMax);
 
@@ -874,13 +1271,27 @@ void Engine::RenderShadowMap()
         vLightCameraOrthographicMax = XMVectorFloor( vLightCameraOrthographicMax );
         vLightCameraOrthographicMax *= vWorldUnitsPerTexel;
 
+		// casters over the cascade's rect. near/far fit to all of them, every cascade shades every pixel
+		// so whatever lies over the rect receives. the scene's range when the rect is empty
+		ShadowCascadeCullStats CullStats;
+		float CasterMinZ, CasterMaxZ;
+		const XMFLOAT2 OrthoMin(XMVectorGetX(vLightCameraOrthographicMin), XMVectorGetY(vLightCameraOrthographicMin));
+		const XMFLOAT2 OrthoMax(XMVectorGetX(vLightCameraOrthographicMax), XMVectorGetY(vLightCameraOrthographicMax));
+		if(!_ShadowCasterCuller->CullCascade(OrthoMin, OrthoMax, ShadowInfo->_bEnabled, &_ShadowCasterDraw[0], CasterMinZ, CasterMaxZ, CullStats))
+		{
+			CasterMinZ = XMVectorGetZ( vLightSpaceSceneAABBminValue );
+			CasterMaxZ = XMVectorGetZ( vLightSpaceSceneAABBmaxValue );
+		}
+		if(_bLogCullStats)
+			cout_debug("shadow cascade %d : %d casters over the rect, %d left to finer cascades, %d drawn\n", i, CullStats.CasterCount, CullStats.SkippedCount, CullStats.DrawnCount);
+
 		XMMATRIX LightProjection = XMMatrixOrthographicOffCenterRH( 
-			XMVectorGetX( vLightCameraOrthographicMin )
-			,  XMVectorGetX( vLightCameraOrthographicMax )
-			, XMVectorGetY(vLightCameraOrthographicMin)
-			, XMVectorGetY(vLightCameraOrthographicMax)
-			, -XMVectorGetZ( vLightSpaceSceneAABBmaxValue )
-			, -XMVectorGetZ( vLightSpaceSceneAABBminValue )
+			OrthoMin.x
+			, OrthoMax.x
+			, OrthoMin.y
+			, OrthoMax.y
+			, -CasterMaxZ
+			, -CasterMinZ
 			);
 
 		XMStoreFloat4x4(&ShadowInfo->_ShadowViewMat, LightView);
@@ -888,16 +1299,20 @@ void Engine::RenderShadowMap()
 
 		SET_RASTERIZER_STATE(RS_SHADOWMAP);
 
-		for(unsigned int i=0;i<_StaticMeshArray.size();i++)
+		for(int m=0;m<StaticCasterCount;m++)
 		{
-			_GBufferDrawer->DrawStaticMesh(_StaticMeshArray[i], LightView, LightProjection);
+			if(_ShadowCasterDraw[m])
+				_GBufferDrawer->DrawStaticMesh(_StaticMeshComponent->_StaticMeshArray[m], LightView, LightProjection);
 		}
 
-		if(_GSkeletalMeshComponent)
+		for(unsigned int c=0;c<_SkeletalMeshRegistry->_ComponentArray.size();c++)
 		{
-			for(unsigned int i=0;i<_GSkeletalMeshComponent->_RenderDataArray.size();i++)
+			if(!_ShadowCasterDraw[StaticCasterCount + c])
+				continue;
+			SkeletalMeshComponent* Component = _SkeletalMeshRegistry->_ComponentArray[c];
+			for(unsigned int m=0;m<Component->_RenderDataArray.size();m++)
 			{
-				_GBufferDrawer->DrawSkeletalMeshData(_GSkeletalMeshComponent->_RenderDataArray[i], LightView, LightProjection);
+				_GBufferDrawer->DrawSkeletalMeshData(Component->_RenderDataArray[m], LightView, LightProjection);
 			}
 		}
 
@@ -20,6 +20,14 @@ class TextureDepth2D;
 class StaticMesh;
 class SkeletalMesh;
 class SkeletalMeshComponent;
+class SkeletalMeshRegistry;
+class BonePaletteArena;
+class PreSkinner;
+class FrustumCuller;
+class ShadowCasterCuller;
+class Scene;
+class OcclusionCuller;
+class LightClusterBuffers;
 class AnimationClip;
 class LightComponent;
 class DirectionalLightComponent;
@@ -27,9 +35,13 @@ class StaticMeshComponent;
 class Camera;
 class Input;
 
+#define CROWD_STRESS_COUNT	1000	// instances of the stress scene when no count is given
+#define POINT_LIGHT_STRESS_COUNT	2000	// point lights of the lighting stress scene when no count is given
+
 class DeferredShadowPixelShader;
 class DeferredPointLightPixelShader;
 class DeferredDirLightPixelShader;
+class DeferredClusteredPixelShader;
 class CombineLitPixelShader;
 class VisualizeDepthPixelShader;
 class VisualizeSimplePixelShader;
@@ -104,20 +116,39 @@ public:
 	DeferredDirLightPixelShader*	_DeferredDirPS;
 	DeferredPointLightPixelShader*	_DeferredPointPS;
 	DeferredShadowPixelShader*		_DeferredShadowPS;
+	DeferredClusteredPixelShader*	_DeferredClusteredPS;
 
 	bool _VisualizeWorldNormal;
 	bool _VisualizeDepth;
 
 	StaticMeshComponent* _StaticMeshComponent;
+	FrustumCuller* _FrustumCuller;	// g-buffer submission, submeshes of the meshes the scene returns
+	std::vector<unsigned char> _SubMeshVisibility;
+	ShadowCasterCuller* _ShadowCasterCuller;	// per cascade casters and depth range
+	std::vector<unsigned char> _ShadowCasterDraw;
+	Scene* _Scene;	// bvh over the static meshes and skeletal components
+	std::vector<int> _VisibleObjectArray;
+	OcclusionCuller* _OcclusionCuller;	// the largest static meshes' occluders, tested before g-buffer submission
+	std::vector<std::pair<float, int> > _OccluderCandidateArray;	// screen size, scene object
+	bool _bOcclusionCulling;
+	bool _bLogCullStats;
 	std::vector<StaticMesh*> _StaticMeshArray;
 	std::vector<SkeletalMesh*> _SkeletalMeshArray;
 	std::vector<AnimationClip*> _AnimClipArray;
 	Skeleton* _GSkeleton;
 	SkeletonPose* _GPose;
 	SkeletalMeshComponent* _GSkeletalMeshComponent;
+	SkeletalMeshRegistry* _SkeletalMeshRegistry;
+	BonePaletteArena* _BonePaletteArena;	// every skinned draw's bones for the frame
+	PreSkinner* _PreSkinner;	// skins once per frame for the g-buffer and every shadow cascade
+	std::vector<SkeletalMeshComponent*> _CrowdComponentArray;
+	int _CrowdCount;	// extra humanoid instances for the animation stress scene, set before InitDevice, the client's -crowd [count]
 	ID3D11ShaderResourceView*           _TextureRV ;
 
 	std::vector<LightComponent*> _LightCompArray;
+	LightClusterBuffers* _LightClusterBuffers;	// point lights to froxels, shaded in one resolve pass
+	bool _bClusteredLighting;
+	int _PointLightCount;	// extra point lights for the lighting stress scene, set before InitDevice, the client's -lights [count]
 
 	DirectionalLightComponent* _SunLight;
 
@@ -132,6 +163,7 @@ public:
 	void EndRendering();
 
 	void RenderShadowMap();
+	void RasterizeOccluders(const XMMATRIX& ViewMatrix, const XMMATRIX& ProjectionMatrix);
 	void RenderDeferredShadow();
 	
 	float _GetTimeSeconds();	
@@ -5,6 +5,8 @@
 #include "FbxFileImporter.h"
 #include "OutputDebug.h"
 #include "AnimationClip.h"
+#include "MeshSource.h"
+#include "ParallelFor.h"
 
 void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene)
 {
@@ -39,7 +41,10 @@ FbxFileImporter::FbxFileImporter( std::string Path)
 	mScene(NULL),
 	mImporter(NULL),
 	FilePath(Path),
-	mStatus(UNLOADED)
+	mStatus(UNLOADED),
+	CompressVertices(true),
+	LODCount(LOD_MAX_COUNT),
+	CompressAnimation(true)
 {
 	InitializeSdkObjects(mSdkManager, mScene);
 
@@ -97,9 +102,8 @@ FbxFileImporter::~FbxFileImporter(void)
     if( mSdkManager ) mSdkManager->Destroy();
 }
 
-void FbxFileImporter::ImportStaticMesh(std::vector<StaticMesh*>& outStaticMeshArray)
+bool FbxFileImporter::LoadScene()
 {
-	bool lResult = false;
 	// Make sure that the scene is ready to load.
 	if (mStatus == MUST_BE_LOADED)
 	{
@@ -129,15 +133,6 @@ void FbxFileImporter::ImportStaticMesh(std::vector<StaticMesh*>& outStaticMeshAr
 				//The unit in this example is centimeter.
 				FbxSystemUnit::cm.ConvertScene( mScene);
 			}
-
-			// Get the list of all the animation stack.
-			mScene->FillAnimStackNameArray(mAnimStackNameArray);
-			
-			//TriangulateRecursive(mScene->GetRootNode());
-			FillFbxMeshArray(mScene->GetRootNode(), outStaticMeshArray);
-			
-
-			lResult = true;
 		}
 		else
 		{
@@ -149,9 +144,36 @@ void FbxFileImporter::ImportStaticMesh(std::vector<StaticMesh*>& outStaticMeshAr
 		mImporter->Destroy();
 		mImporter = NULL;
 	}
+
+	return mStatus != UNLOADED && mStatus != MUST_BE_LOADED;
+}
+
+void FbxFileImporter::ImportStaticMesh(std::vector<StaticMesh*>& outStaticMeshArray)
+{
+	if (LoadScene())
+	{
+		// Get the list of all the animation stack.
+		mScene->FillAnimStackNameArray(mAnimStackNameArray);
+
+		//TriangulateRecursive(mScene->GetRootNode());
+		std::vector<MeshSource*> SourceArray;
+		FillMeshSourceArray(mScene->GetRootNode(), SourceArray);
+
+		const int Offset = outStaticMeshArray.size();
+		outStaticMeshArray.resize(Offset + SourceArray.size());
+		ParallelFor(0, (int)SourceArray.size(), [&](int SourceIndex)
+		{
+			StaticMesh* pStaticMesh = new StaticMesh;
+			pStaticMesh->_CompressedVertex = CompressVertices;
+			pStaticMesh->_MaxLODCount = LODCount;
+			pStaticMesh->ImportFromMeshSource(*SourceArray[SourceIndex]);
+			outStaticMeshArray[Offset + SourceIndex] = pStaticMesh;
+			delete SourceArray[SourceIndex];
+		});
+	}
 }
 
-void FbxFileImporter::FillFbxMeshArray( FbxNode* pNode, std::vector<StaticMesh*>& outStaticMeshArray )
+void FbxFileImporter::FillMeshSourceArray( FbxNode* pNode, std::vector<MeshSource*>& outSourceArray )
 {
 	FbxNodeAttribute* NodeAttribute = pNode->GetNodeAttribute();
 	if ( NodeAttribute )
@@ -161,9 +183,11 @@ void FbxFileImporter::FillFbxMeshArray( FbxNode* pNode, std::vector<StaticMesh*>
 			FbxMesh * pFbxMesh = pNode->GetMesh();
 			if (pFbxMesh)
 			{
-				StaticMesh* pStaticMesh = new StaticMesh;
-				pStaticMesh->ImportFromFbxMesh(pFbxMesh, this);
-				outStaticMeshArray.push_back(pStaticMesh);
+				MeshSource* Source = new MeshSource;
+				if (Source->Extract(pFbxMesh, mScene))
+					outSourceArray.push_back(Source);
+				else
+					delete Source;
 			}
 		}
 	}
@@ -171,7 +195,7 @@ void FbxFileImporter::FillFbxMeshArray( FbxNode* pNode, std::vector<StaticMesh*>
 	const int lChildCount = pNode->GetChildCount();
 	for (int lChildIndex = 0; lChildIndex < lChildCount; ++lChildIndex)
 	{
-		FillFbxMeshArray(pNode->GetChild(lChildIndex), outStaticMeshArray);
+		FillMeshSourceArray(pNode->GetChild(lChildIndex), outSourceArray);
 	}
 }
 
@@ -198,95 +222,28 @@ void FbxFileImporter::TriangulateRecursive(FbxNode* pNode)
 	}
 }
 
-void FillBoneIndexMapRecursive(FbxNode* Node, std::map<std::string, BoneIndexInfo>& BoneIndexMap, int& NumBone)
-{
-	BoneIndexMap.insert(std::pair<std::string, BoneIndexInfo>(Node->GetName(), BoneIndexInfo(Node->GetName(), NumBone)));
-	NumBone++;
-
-	const int lChildCount = Node->GetChildCount();
-	for (int lChildIndex = 0; lChildIndex < lChildCount; ++lChildIndex)
-	{
-		FillBoneIndexMapRecursive(Node->GetChild(lChildIndex), BoneIndexMap, NumBone);
-	}
-}
-
 void FbxFileImporter::ImportSkeletalMesh( std::vector<SkeletalMesh*>& outSkeletalMeshArray )
 {
-	bool lResult = false;
-	// Make sure that the scene is ready to load.
-	if (mStatus == MUST_BE_LOADED)
+	if (LoadScene())
 	{
-		if (mImporter->Import(mScene) == true)
-		{
-			// Set the scene status flag to refresh 
-			// the scene in the first timer callback.
-			mStatus = MUST_BE_REFRESHED;
-
-			// Convert Axis System to what is used in this example, if needed
-			FbxAxisSystem SceneAxisSystem = mScene->GetGlobalSettings().GetAxisSystem();
-			//	FbxAxisSystem OurAxisSystem(FbxAxisSystem::eZAxis, FbxAxisSystem::eYAxis, FbxAxisSystem::eRightHanded);
-
-			FbxAxisSystem::EFrontVector FrontVector = (FbxAxisSystem::EFrontVector)-FbxAxisSystem::eParityOdd;
-			const FbxAxisSystem OurAxisSystem(FbxAxisSystem::eYAxis, FrontVector, FbxAxisSystem::eLeftHanded);
-
-			if( SceneAxisSystem != OurAxisSystem )
-			{
-				FbxRootNodeUtility::RemoveAllFbxRoots( mScene );
-				//OurAxisSystem.ConvertScene(mScene);
-			}
-
-			// Convert Unit System to what is used in this example, if needed
-			FbxSystemUnit SceneSystemUnit = mScene->GetGlobalSettings().GetSystemUnit();
-			if( SceneSystemUnit.GetScaleFactor() != 1.0 )
-			{
-				//The unit in this example is centimeter.
-				FbxSystemUnit::cm.ConvertScene( mScene);
-			}
-
-			// Get the list of all the animation stack.
-			
+		BuildJointArray();
 
-			int NumBone = 0;
-			FillBoneIndexMapRecursive(mScene->GetRootNode(), BoneIndexMap, NumBone);
+		//TriangulateRecursive(mScene->GetRootNode());
+		std::vector<MeshSource*> SourceArray;
+		FillMeshSourceArray(mScene->GetRootNode(), SourceArray);
 
-			//TriangulateRecursive(mScene->GetRootNode());
-			FillFbxSkelMeshArray(mScene->GetRootNode(), outSkeletalMeshArray);
-
-			lResult = true;
-		}
-		else
+		// BoneIndexMap is only read from here on, each mesh remaps bones on its own copy
+		const int Offset = outSkeletalMeshArray.size();
+		outSkeletalMeshArray.resize(Offset + SourceArray.size());
+		ParallelFor(0, (int)SourceArray.size(), [&](int SourceIndex)
 		{
-			// Import failed, set the scene status flag accordingly.
-			mStatus = UNLOADED;
-		}
-
-		// Destroy the importer to release the file.
-		mImporter->Destroy();
-		mImporter = NULL;
-	}
-}
-
-void FbxFileImporter::FillFbxSkelMeshArray( FbxNode* pNode, std::vector<SkeletalMesh*>& outSkeletalMeshArray )
-{
-	FbxNodeAttribute* NodeAttribute = pNode->GetNodeAttribute();
-	if ( NodeAttribute )
-	{
-		if (NodeAttribute->GetAttributeType() == FbxNodeAttribute::eMesh)
-		{
-			FbxMesh * pFbxMesh = pNode->GetMesh();
-			if (pFbxMesh)
-			{
-				SkeletalMesh* Mesh = new SkeletalMesh;
-				Mesh->ImportFromFbxMesh(pFbxMesh, this);
-				outSkeletalMeshArray.push_back(Mesh);
-			}
-		}
-	}
-
-	const int lChildCount = pNode->GetChildCount();
-	for (int lChildIndex = 0; lChildIndex < lChildCount; ++lChildIndex)
-	{
-		FillFbxSkelMeshArray(pNode->GetChild(lChildIndex), outSkeletalMeshArray);
+			SkeletalMesh* Mesh = new SkeletalMesh;
+			Mesh->_CompressedVertex = CompressVertices;
+			Mesh->_MaxLODCount = LODCount;
+			Mesh->ImportFromMeshSource(*SourceArray[SourceIndex], BoneIndexMap);
+			outSkeletalMeshArray[Offset + SourceIndex] = Mesh;
+			delete SourceArray[SourceIndex];
+		});
 	}
 }
 
@@ -334,190 +291,205 @@ void FbxFileImporter::FillFbxClusterArray(FbxNode* pNode, std::vector<FbxCluster
 }
 
 
-void FbxFileImporter::ImportSkeleton(Skeleton** OutSkeleton, SkeletonPose** OutRefPose)
+void FbxFileImporter::BuildJointArray()
 {
+	if(NodeJointRemap.size() != 0)
+		return;
+
 	std::vector<FbxNode*> NodeArray;
 	std::vector<FbxCluster*> ClusterArray;
-	std::vector<FbxAMatrix> GlobalMatArray;
-
 	FillFbxNodeArray(mScene->GetRootNode(), NodeArray);
 	FillFbxClusterArray(mScene->GetRootNode(), ClusterArray);
 
-	
-	std::vector<SkeletonJoint> Joints;
-	Joints.resize(NodeArray.size());
-	std::vector<JointPose> RefPose;
-	RefPose.resize(NodeArray.size());
-
-	GlobalMatArray.resize(NodeArray.size());
-	for(unsigned int NodeIndex=0;NodeIndex<NodeArray.size();NodeIndex++)
+	for(unsigned int ClusterIndex=0;ClusterIndex<ClusterArray.size();ClusterIndex++)
 	{
-		FbxNode* Node = NodeArray[NodeIndex];
-
-		GlobalMatArray[NodeIndex] = Node->EvaluateGlobalTransform();
+		JointClusterMap[ClusterArray[ClusterIndex]->GetLink()] = ClusterArray[ClusterIndex];
 	}
 
-	for(unsigned int NodeIndex=0;NodeIndex<NodeArray.size();NodeIndex++)
+	// linked nodes pull in their ancestors, the scene root is always identity and is left out
+	std::unordered_map<FbxNode*, int> RequiredNodeMap;
+	std::unordered_map<FbxNode*, FbxCluster*>::const_iterator it;
+	for(it=JointClusterMap.begin();it!=JointClusterMap.end();it++)
 	{
-		FbxNode* Node = NodeArray[NodeIndex];
-		SkeletonJoint& Joint = Joints[NodeIndex];
-		Joint._Name = Node->GetName();
-		// finding parent index
-		for(unsigned int OtherNodeIndex=0;OtherNodeIndex<NodeArray.size();OtherNodeIndex++)
+		for(FbxNode* Node = it->first;Node && Node->GetParent();Node = Node->GetParent())
 		{
-			FbxNode* OtherNode = NodeArray[OtherNodeIndex];
-			if(Node->GetParent() )
-			{
-				
-			}
-
-			if(Node->GetParent() == OtherNode)
-			{
-				Joint._ParentIndex = OtherNodeIndex;
-			}
+			if(!RequiredNodeMap.insert(std::make_pair(Node, 0)).second)
+				break;
 		}
 	}
 
+	BoneIndexMap.clear();
+	JointNodeArray.reserve(RequiredNodeMap.size());
+	NodeJointRemap.assign(NodeArray.size(), -1);
 	for(unsigned int NodeIndex=0;NodeIndex<NodeArray.size();NodeIndex++)
 	{
 		FbxNode* Node = NodeArray[NodeIndex];
-		SkeletonJoint& Joint = Joints[NodeIndex];
+		if(RequiredNodeMap.find(Node) == RequiredNodeMap.end())
+			continue;
+
+		const int JointIndex = JointNodeArray.size();
+		NodeJointRemap[NodeIndex] = JointIndex;
+		JointIndexMap[Node] = JointIndex;
+		JointNodeArray.push_back(Node);
+		BoneIndexMap.insert(std::pair<std::string, BoneIndexInfo>(Node->GetName(), BoneIndexInfo(Node->GetName(), JointIndex)));
+	}
+
+	cout_debug("skeleton joints : %d of %d scene nodes\n", (int)JointNodeArray.size(), (int)NodeArray.size());
+}
+
+void FbxFileImporter::ImportSkeleton(Skeleton** OutSkeleton, SkeletonPose** OutRefPose)
+{
+	BuildJointArray();
+
+	const int JointCount = JointNodeArray.size();
+	std::vector<SkeletonJoint> Joints;
+	Joints.resize(JointCount);
+	std::vector<JointPose> RefPose;
+	RefPose.resize(JointCount);
+
+	std::vector<FbxAMatrix> GlobalMatArray;
+	GlobalMatArray.resize(JointCount);
+	for(int JointIndex=0;JointIndex<JointCount;JointIndex++)
+	{
+		GlobalMatArray[JointIndex] = JointNodeArray[JointIndex]->EvaluateGlobalTransform();
+	}
+
+	for(int JointIndex=0;JointIndex<JointCount;JointIndex++)
+	{
+		FbxNode* Node = JointNodeArray[JointIndex];
+		SkeletonJoint& Joint = Joints[JointIndex];
 		Joint._Name = Node->GetName();
-		JointPose& RefPosJoint = RefPose[NodeIndex];
-		
-		bool IsBoneCluser = false;
-		for(unsigned int ClusterIndex=0;ClusterIndex<ClusterArray.size();ClusterIndex++)
-		{
-			FbxCluster* Cluster = ClusterArray[ClusterIndex];
+		JointPose& RefPosJoint = RefPose[JointIndex];
 
-			if(Node == Cluster->GetLink())
-			{
-				// this node has cluster, so it has bind pose
-				FbxAMatrix BoneGlobalBind, ClusterMatrix;
-				Cluster->GetTransformLinkMatrix(BoneGlobalBind);
-				Cluster->GetTransformMatrix(ClusterMatrix);
-				BoneGlobalBind = ClusterMatrix.Inverse() * BoneGlobalBind;
-
-				FbxAMatrix BoneGlobalBindInv = BoneGlobalBind.Inverse();
-				// ref inverse
-				FbxVector4 S = BoneGlobalBindInv.GetS();
-				FbxVector4 T = BoneGlobalBindInv.GetT();
-				FbxQuaternion Q = BoneGlobalBindInv.GetQ();
-
-				XMFLOAT4 QQ;
-				QQ.x = (float)Q[0];
-				QQ.y = (float)Q[1];
-				QQ.z = (float)Q[2];
-				QQ.w = (float)Q[3];
-				XMVECTOR Quat = XMLoadFloat4((XMFLOAT4*)&QQ);
-				
-				XMMATRIX MatRot = XMMatrixRotationQuaternion(Quat);
-				XMMATRIX MatTrans = XMMatrixTranslation((float)T[0], (float)T[1], (float)T[2]);
-				XMMATRIX MatScale = XMMatrixScaling((float)S[0], (float)S[1], (float)S[2]);
-
-				XMMATRIX RefWorldInv = XMMatrixIdentity();
-				RefWorldInv = XMMatrixMultiply(MatScale, MatRot);
-				RefWorldInv = XMMatrixMultiply(RefWorldInv, MatTrans);
-
-				XMStoreFloat4x4(&Joint._InvRefPose, RefWorldInv);
-			
-				// pose
+		// every ancestor is a joint, so the direct parent is enough
+		std::unordered_map<FbxNode*, int>::const_iterator ParentIt = JointIndexMap.find(Node->GetParent());
+		if(ParentIt != JointIndexMap.end())
+			Joint._ParentIndex = ParentIt->second;
 
-				FbxAMatrix ParentGlobalPose;
-				FbxAMatrix GlobalPose;
-				if(Joint._ParentIndex >= 0)
-					ParentGlobalPose = GlobalMatArray[Joint._ParentIndex] ;
-				else
-					ParentGlobalPose.SetIdentity();
+		std::unordered_map<FbxNode*, FbxCluster*>::const_iterator ClusterIt = JointClusterMap.find(Node);
+		if(ClusterIt != JointClusterMap.end())
+		{
+			FbxCluster* Cluster = ClusterIt->second;
+
+			// this node has cluster, so it has bind pose
+			FbxAMatrix BoneGlobalBind, ClusterMatrix;
+			Cluster->GetTransformLinkMatrix(BoneGlobalBind);
+			Cluster->GetTransformMatrix(ClusterMatrix);
+			BoneGlobalBind = ClusterMatrix.Inverse() * BoneGlobalBind;
+
+			FbxAMatrix BoneGlobalBindInv = BoneGlobalBind.Inverse();
+			// ref inverse
+			FbxVector4 S = BoneGlobalBindInv.GetS();
+			FbxVector4 T = BoneGlobalBindInv.GetT();
+			FbxQuaternion Q = BoneGlobalBindInv.GetQ();
+
+			XMFLOAT4 QQ;
+			QQ.x = (float)Q[0];
+			QQ.y = (float)Q[1];
+			QQ.z = (float)Q[2];
+			QQ.w = (float)Q[3];
+			XMVECTOR Quat = XMLoadFloat4((XMFLOAT4*)&QQ);
+			
+			XMMATRIX MatRot = XMMatrixRotationQuaternion(Quat);
+			XMMATRIX MatTrans = XMMatrixTranslation((float)T[0], (float)T[1], (float)T[2]);
+			XMMATRIX MatScale = XMMatrixScaling((float)S[0], (float)S[1], (float)S[2]);
 
-				GlobalPose = Cluster->GetLink()->EvaluateGlobalTransform();;
+			XMMATRIX RefWorldInv = XMMatrixIdentity();
+			RefWorldInv = XMMatrixMultiply(MatScale, MatRot);
+			RefWorldInv = XMMatrixMultiply(RefWorldInv, MatTrans);
 
-				FbxAMatrix BoneMatLocalPose = ParentGlobalPose.Inverse() * GlobalPose;
+			XMStoreFloat4x4(&Joint._InvRefPose, RefWorldInv);
+			
+			// pose
 
+			FbxAMatrix ParentGlobalPose;
+			FbxAMatrix GlobalPose;
+			if(Joint._ParentIndex >= 0)
+				ParentGlobalPose = GlobalMatArray[Joint._ParentIndex] ;
+			else
+				ParentGlobalPose.SetIdentity();
 
-				FbxVector4 LocalT = BoneMatLocalPose.GetT();
-				FbxQuaternion LocalQ = BoneMatLocalPose.GetQ();
-				FbxVector4 LocalS = BoneMatLocalPose.GetS();
+			GlobalPose = GlobalMatArray[JointIndex];
 
-				RefPosJoint._Rot.x = (float)LocalQ[0];
-				RefPosJoint._Rot.y = (float)LocalQ[1];
-				RefPosJoint._Rot.z = (float)LocalQ[2];
-				RefPosJoint._Rot.w = (float)LocalQ[3];
+			FbxAMatrix BoneMatLocalPose = ParentGlobalPose.Inverse() * GlobalPose;
 
-				RefPosJoint._Trans.x = (float)LocalT[0];
-				RefPosJoint._Trans.y = (float)LocalT[1];
-				RefPosJoint._Trans.z = (float)LocalT[2];
-				
-				RefPosJoint._Scale.x = (float)LocalS[0];
-				RefPosJoint._Scale.y = (float)LocalS[1];
-				RefPosJoint._Scale.z = (float)LocalS[2];
 
-				FbxVector4 GlobalT = ParentGlobalPose.GetT();
+			FbxVector4 LocalT = BoneMatLocalPose.GetT();
+			FbxQuaternion LocalQ = BoneMatLocalPose.GetQ();
+			FbxVector4 LocalS = BoneMatLocalPose.GetS();
 
+			RefPosJoint._Rot.x = (float)LocalQ[0];
+			RefPosJoint._Rot.y = (float)LocalQ[1];
+			RefPosJoint._Rot.z = (float)LocalQ[2];
+			RefPosJoint._Rot.w = (float)LocalQ[3];
 
-				IsBoneCluser = true;
-			}
+			RefPosJoint._Trans.x = (float)LocalT[0];
+			RefPosJoint._Trans.y = (float)LocalT[1];
+			RefPosJoint._Trans.z = (float)LocalT[2];
+			
+			RefPosJoint._Scale.x = (float)LocalS[0];
+			RefPosJoint._Scale.y = (float)LocalS[1];
+			RefPosJoint._Scale.z = (float)LocalS[2];
 		}
-		if( IsBoneCluser == false)
+		else
 		{
-				FbxAMatrix BoneGlobalBind;
-				BoneGlobalBind = GlobalMatArray[NodeIndex];
-				
-
-				// ref inverse
-				FbxVector4 S = BoneGlobalBind.GetS();
-				FbxVector4 T = BoneGlobalBind.GetT();
-				FbxQuaternion Q = BoneGlobalBind.GetQ();
-				XMFLOAT4 QQ;
-				QQ.x = (float)Q[0];
-				QQ.y = (float)Q[1];
-				QQ.z = (float)Q[2];
-				QQ.w = (float)Q[3];
-				XMVECTOR Quat = XMLoadFloat4((XMFLOAT4*)&QQ);
-				
-				XMMATRIX MatRot = XMMatrixRotationQuaternion(Quat);
-				XMMATRIX MatTrans = XMMatrixTranslation((float)T[0], (float)T[1], (float)T[2]);
-				XMMATRIX MatScale = XMMatrixScaling((float)S[0], (float)S[1], (float)S[2]);
-
-				//XMMATRIX RefWorldInv = MatScale * MatRot * MatTrans;//XMMatrixMultiply(MatRot, MatTrans);
-				XMMATRIX RefWorldInv =XMMatrixMultiply(XMMatrixMultiply( MatScale , MatRot), MatTrans);//XMMatrixMultiply(MatRot, MatTrans);
-
-				XMVECTOR Det;
-				RefWorldInv = XMMatrixInverse(&Det, RefWorldInv);
-
-				XMStoreFloat4x4(&Joint._InvRefPose, RefWorldInv);
+			FbxAMatrix BoneGlobalBind;
+			BoneGlobalBind = GlobalMatArray[JointIndex];
 			
-				// pose
-				FbxAMatrix ParentGlobalPose;
-				if(Joint._ParentIndex >= 0)
-					ParentGlobalPose = GlobalMatArray[Joint._ParentIndex] ;
-				else
-					ParentGlobalPose.SetIdentity();
-				FbxAMatrix BoneMatLocal = ParentGlobalPose.Inverse() * BoneGlobalBind;
-
-				FbxVector4 LocalT = BoneMatLocal.GetT();
-				FbxQuaternion LocalQ = BoneMatLocal.GetQ();
-				FbxVector4 LocalS = BoneMatLocal.GetS();
-
-				RefPosJoint._Rot.x = (float)LocalQ[0];
-				RefPosJoint._Rot.y = (float)LocalQ[1];
-				RefPosJoint._Rot.z = (float)LocalQ[2];
-				RefPosJoint._Rot.w = (float)LocalQ[3];
-
-				RefPosJoint._Trans.x = (float)LocalT[0];
-				RefPosJoint._Trans.y = (float)LocalT[1];
-				RefPosJoint._Trans.z = (float)LocalT[2];
-				
-				RefPosJoint._Scale.x = (float)LocalS[0];
-				RefPosJoint._Scale.y = (float)LocalS[1];
-				RefPosJoint._Scale.z = (float)LocalS[2];
-
-				//cout_debug("scale : %f %f %f\n", LocalS[0], LocalS[1], LocalS[2]);
+
+			// ref inverse
+			FbxVector4 S = BoneGlobalBind.GetS();
+			FbxVector4 T = BoneGlobalBind.GetT();
+			FbxQuaternion Q = BoneGlobalBind.GetQ();
+			XMFLOAT4 QQ;
+			QQ.x = (float)Q[0];
+			QQ.y = (float)Q[1];
+			QQ.z = (float)Q[2];
+			QQ.w = (float)Q[3];
+			XMVECTOR Quat = XMLoadFloat4((XMFLOAT4*)&QQ);
+			
+			XMMATRIX MatRot = XMMatrixRotationQuaternion(Quat);
+			XMMATRIX MatTrans = XMMatrixTranslation((float)T[0], (float)T[1], (float)T[2]);
+			XMMATRIX MatScale = XMMatrixScaling((float)S[0], (float)S[1], (float)S[2]);
+
+			//XMMATRIX RefWorldInv = MatScale * MatRot * MatTrans;//XMMatrixMultiply(MatRot, MatTrans);
+			XMMATRIX RefWorldInv =XMMatrixMultiply(XMMatrixMultiply( MatScale , MatRot), MatTrans);//XMMatrixMultiply(MatRot, MatTrans);
+
+			XMVECTOR Det;
+			RefWorldInv = XMMatrixInverse(&Det, RefWorldInv);
+
+			XMStoreFloat4x4(&Joint._InvRefPose, RefWorldInv);
+			
+			// pose
+			FbxAMatrix ParentGlobalPose;
+			if(Joint._ParentIndex >= 0)
+				ParentGlobalPose = GlobalMatArray[Joint._ParentIndex] ;
+			else
+				ParentGlobalPose.SetIdentity();
+			FbxAMatrix BoneMatLocal = ParentGlobalPose.Inverse() * BoneGlobalBind;
+
+			FbxVector4 LocalT = BoneMatLocal.GetT();
+			FbxQuaternion LocalQ = BoneMatLocal.GetQ();
+			FbxVector4 LocalS = BoneMatLocal.GetS();
+
+			RefPosJoint._Rot.x = (float)LocalQ[0];
+			RefPosJoint._Rot.y = (float)LocalQ[1];
+			RefPosJoint._Rot.z = (float)LocalQ[2];
+			RefPosJoint._Rot.w = (float)LocalQ[3];
+
+			RefPosJoint._Trans.x = (float)LocalT[0];
+			RefPosJoint._Trans.y = (float)LocalT[1];
+			RefPosJoint._Trans.z = (float)LocalT[2];
+			
+			RefPosJoint._Scale.x = (float)LocalS[0];
+			RefPosJoint._Scale.y = (float)LocalS[1];
+			RefPosJoint._Scale.z = (float)LocalS[2];
 		}
 	}
 
 	(*OutSkeleton)->_Joints = std::move(Joints);
-	(*OutSkeleton)->_JointCount = NodeArray.size();
+	(*OutSkeleton)->_JointCount = JointCount;
+	BonePalette::InitSkeleton(**OutSkeleton);
 
 	(*OutRefPose)->_LocalPoseArray = std::move(RefPose);
 
@@ -562,117 +534,140 @@ void FbxFileImporter::ImportAnimClip(std::vector<AnimationClip*>& outAnimclipArr
 {
 	mFrameTime.SetTime(0, 0, 0, 1, 0, mScene->GetGlobalSettings().GetTimeMode());
 
+	// clips only carry tracks for skeleton joints
+	BuildJointArray();
+
+	std::vector<int> ParentArray(JointNodeArray.size(), -1);
+	for(unsigned int JointIndex=0;JointIndex<JointNodeArray.size();JointIndex++)
+	{
+		std::unordered_map<FbxNode*, int>::const_iterator it = JointIndexMap.find(JointNodeArray[JointIndex]->GetParent());
+		if(it != JointIndexMap.end())
+			ParentArray[JointIndex] = it->second;
+	}
+
 	mScene->FillAnimStackNameArray(mAnimStackNameArray);
 
+	// the sdk is not thread safe and every evaluator reads the one scene, so stacks bake on this thread.
+	// the baked clips share nothing, only their compression runs in parallel
+	std::vector<FbxAnimStack*> StackArray;
+	std::vector<AnimationClip*> ClipArray;
+	std::vector<int> RawSizeArray;
 	for(int i=0;i<mAnimStackNameArray.Size();i++)
 	{
 		cout_debug("current anim stack name : %s\n", mAnimStackNameArray[i]->Buffer());
 		FbxAnimStack * lCurrentAnimationStack = mScene->FindMember<FbxAnimStack>(mAnimStackNameArray[i]->Buffer());
 		if (lCurrentAnimationStack == NULL)
 		{
-			return;
+			break;
 		}
 
-		//FbxAnimLayer* mCurrentAnimLayer = lCurrentAnimationStack->GetMember<FbxAnimLayer>();
-		mScene->GetEvaluator()->SetContext(lCurrentAnimationStack);
+		FbxAnimEvaluator* Evaluator = FbxAnimEvalClassic::Create(mScene, "");
+		Evaluator->SetContext(lCurrentAnimationStack);
 
-		
+		FbxTimeSpan TimeSpan;
 		FbxTakeInfo* lCurrentTakeInfo = mScene->GetTakeInfo(*(mAnimStackNameArray[i]));
 		if (lCurrentTakeInfo)
 		{
-			mStart = lCurrentTakeInfo->mLocalTimeSpan.GetStart();
-			mStop = lCurrentTakeInfo->mLocalTimeSpan.GetStop();
+			TimeSpan = lCurrentTakeInfo->mLocalTimeSpan;
 		}
 		else
 		{
 			// Take the time line value
-			FbxTimeSpan lTimeLineTimeSpan;
-			mScene->GetGlobalSettings().GetTimelineDefaultTimeSpan(lTimeLineTimeSpan);
-
-			mStart = lTimeLineTimeSpan.GetStart();
-			mStop  = lTimeLineTimeSpan.GetStop();
+			mScene->GetGlobalSettings().GetTimelineDefaultTimeSpan(TimeSpan);
 		}
 
 		AnimationClip* Clip = new AnimationClip;
+		BakeAnimStack(Evaluator, ParentArray, TimeSpan, Clip);
+		Evaluator->Destroy();
 
-		Clip->_Duration = (float)(mStop.GetMilliSeconds() - mStart.GetMilliSeconds())*0.001f;
+		StackArray.push_back(lCurrentAnimationStack);
+		ClipArray.push_back(Clip);
+		RawSizeArray.push_back(Clip->GetMemorySize());
+	}
 
-		FillAnimTrackRecursive(mScene->GetRootNode(), Clip);
-		// sample keys
-		for(mCurrentTime = mStart;mCurrentTime<=mStop;mCurrentTime += mFrameTime)
+	std::vector<AnimCompressionError> ErrorArray(ClipArray.size());
+	if(CompressAnimation)
+	{
+		ParallelFor(0, (int)ClipArray.size(), [&](int ClipIndex)
 		{
-			int NodeIndex = 0;
-			SampleCurrentRecursive(mScene->GetRootNode(), Clip, NodeIndex);
-			cout_debug("num sampled node : %d\n", NodeIndex);
-		}
-
-		outAnimclipArray.push_back(Clip);
-
-		lCurrentAnimationStack->Destroy();
+			AnimationCompressor::Compress(*ClipArray[ClipIndex], ParentArray, ANIM_MAX_ERROR, ErrorArray[ClipIndex]);
+		});
 	}
-}
-
-void FbxFileImporter::FillAnimTrackRecursive( FbxNode* pNode, AnimationClip* Clip )
-{
-	Clip->_ScaleTrackArray.push_back(ScaleTrack());
-	Clip->_RotTrackArray.push_back(RotationTrack());
-	Clip->_TransTrackArray.push_back(TranslationTrack());
 
-	const int lChildCount = pNode->GetChildCount();
-	for (int lChildIndex = 0; lChildIndex < lChildCount; ++lChildIndex)
+	for(unsigned int i=0;i<ClipArray.size();i++)
 	{
-		FillAnimTrackRecursive(pNode->GetChild(lChildIndex), Clip);
+		const AnimationClip* Clip = ClipArray[i];
+		cout_debug("baked anim stack %s : %d joints, %d bytes\n", StackArray[i]->GetName(), (int)JointNodeArray.size(), RawSizeArray[i]);
+		if(Clip->IsCompressed())
+			cout_debug("  compressed to %d bytes, max error %f at joint %d\n", Clip->GetMemorySize(), ErrorArray[i].MaxError, ErrorArray[i].MaxErrorJoint);
+		StackArray[i]->Destroy();
+		outAnimclipArray.push_back(ClipArray[i]);
 	}
 }
 
-void FbxFileImporter::SampleCurrentRecursive( FbxNode* pNode, AnimationClip* Clip, int& NodeIndex )
+void FbxFileImporter::BakeAnimStack( FbxAnimEvaluator* Evaluator, const std::vector<int>& ParentArray, const FbxTimeSpan& TimeSpan, AnimationClip* Clip ) const
 {
-	FbxAMatrix CurrentLocalTM = pNode->EvaluateGlobalTransform(mCurrentTime);
-	if(pNode->GetParent() != NULL)
+	const FbxTime Start = TimeSpan.GetStart();
+	const FbxTime Stop = TimeSpan.GetStop();
+	Clip->_Duration = (float)(Stop.GetMilliSeconds() - Start.GetMilliSeconds())*0.001f;
+
+	const int JointCount = JointNodeArray.size();
+	const int KeyCount = mFrameTime.Get() > 0 && Stop >= Start ? (int)((Stop - Start).Get() / mFrameTime.Get()) + 1 : 0;
+	Clip->_ScaleTrackArray.resize(JointCount);
+	Clip->_RotTrackArray.resize(JointCount);
+	Clip->_TransTrackArray.resize(JointCount);
+	for(int JointIndex=0;JointIndex<JointCount;JointIndex++)
 	{
-		CurrentLocalTM = pNode->GetParent()->EvaluateGlobalTransform(mCurrentTime).Inverse() * CurrentLocalTM;
+		Clip->_ScaleTrackArray[JointIndex]._ScaleArray.reserve(KeyCount);
+		Clip->_RotTrackArray[JointIndex]._RotArray.reserve(KeyCount);
+		Clip->_TransTrackArray[JointIndex]._PosArray.reserve(KeyCount);
 	}
 
+	// parents come first, so each global transform is evaluated once per key and reused by the children
+	std::vector<FbxAMatrix> GlobalArray(JointCount);
+	// keys are one mFrameTime apart, so the clip is uniform and needs no time arrays
+	int FrameCount = 0;
+	for(FbxTime CurrentTime = Start;CurrentTime<=Stop;CurrentTime += mFrameTime, FrameCount++)
+	{
+		for(int JointIndex=0;JointIndex<JointCount;JointIndex++)
+		{
+			GlobalArray[JointIndex] = Evaluator->GetNodeGlobalTransform(JointNodeArray[JointIndex], CurrentTime);
 
-	FbxVector4 LocalT = CurrentLocalTM.GetT();
-	FbxQuaternion LocalQ = CurrentLocalTM.GetQ();
-	FbxVector4 LocalS = CurrentLocalTM.GetS();
-
-	XMFLOAT4 RotKey;
-	RotKey.x = (float)LocalQ[0];
-	RotKey.y = (float)LocalQ[1];
-	RotKey.z = (float)LocalQ[2];
-	RotKey.w = (float)LocalQ[3];
-
-	XMFLOAT3 TransKey;
-	TransKey.x = (float)LocalT[0];
-	TransKey.y = (float)LocalT[1];
-	TransKey.z = (float)LocalT[2];
+			// the scene root above the top joints is identity
+			const int ParentIndex = ParentArray[JointIndex];
+			FbxAMatrix CurrentLocalTM = ParentIndex >= 0 ? GlobalArray[ParentIndex].Inverse() * GlobalArray[JointIndex] : GlobalArray[JointIndex];
 
-	XMFLOAT3 ScaleKey;
-	ScaleKey.x = (float)LocalS[0];
-	ScaleKey.y = (float)LocalS[1];
-	ScaleKey.z = (float)LocalS[2];
+			FbxVector4 LocalT = CurrentLocalTM.GetT();
+			FbxQuaternion LocalQ = CurrentLocalTM.GetQ();
+			FbxVector4 LocalS = CurrentLocalTM.GetS();
 
-	float Seconds = static_cast<float>(mCurrentTime.GetMilliSeconds()) *0.001f;
+			XMFLOAT4 RotKey;
+			RotKey.x = (float)LocalQ[0];
+			RotKey.y = (float)LocalQ[1];
+			RotKey.z = (float)LocalQ[2];
+			RotKey.w = (float)LocalQ[3];
 
-	ScaleTrack& STrack = Clip->_ScaleTrackArray[NodeIndex];
-	STrack._TimeArray.push_back(Seconds);
-	STrack._ScaleArray.push_back(ScaleKey);
+			XMFLOAT3 TransKey;
+			TransKey.x = (float)LocalT[0];
+			TransKey.y = (float)LocalT[1];
+			TransKey.z = (float)LocalT[2];
 
-	RotationTrack& RTrack = Clip->_RotTrackArray[NodeIndex];
-	RTrack._TimeArray.push_back(Seconds);
-	RTrack._RotArray.push_back(RotKey);
+			XMFLOAT3 ScaleKey;
+			ScaleKey.x = (float)LocalS[0];
+			ScaleKey.y = (float)LocalS[1];
+			ScaleKey.z = (float)LocalS[2];
 
-	TranslationTrack& TTrack = Clip->_TransTrackArray[NodeIndex];
-	TTrack._TimeArray.push_back(Seconds);
-	TTrack._PosArray.push_back(TransKey);
+			ScaleTrack& STrack = Clip->_ScaleTrackArray[JointIndex];
+			STrack._ScaleArray.push_back(ScaleKey);
 
-	NodeIndex += 1;
+			RotationTrack& RTrack = Clip->_RotTrackArray[JointIndex];
+			RTrack._RotArray.push_back(RotKey);
 
-	const int lChildCount = pNode->GetChildCount();
-	for (int lChildIndex = 0; lChildIndex < lChildCount; ++lChildIndex)
-	{
-		SampleCurrentRecursive(pNode->GetChild(lChildIndex), Clip, NodeIndex);
+			TranslationTrack& TTrack = Clip->_TransTrackArray[JointIndex];
+			TTrack._PosArray.push_back(TransKey);
+		}
 	}
+
+	Clip->_FrameCount = FrameCount;
+	Clip->_SampleRate = mFrameTime.GetSecondDouble() > 0.0 ? (float)(1.0 / mFrameTime.GetSecondDouble()) : 0.f;
 }
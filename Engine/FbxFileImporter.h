@@ -3,10 +3,12 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include "Skeleton.h"
 class StaticMesh;
 class SkeletalMesh;
 class AnimationClip;
+class MeshSource;
 
 
 struct BoneIndexInfo
@@ -51,22 +53,37 @@ public:
 	FbxArray<FbxPose*> mPoseArray;
 	FbxArray<FbxNode*> FbxMeshArray;
 	
+	// bone name -> joint index, filled by BuildJointArray
 	std::map<std::string, BoneIndexInfo> BoneIndexMap;
-	std::vector<BoneIndexInfo> BoneArray;
+	// skin-linked nodes and their ancestors in depth first order, so parents come before children
+	std::vector<FbxNode*> JointNodeArray;
+	// scene node index in FillFbxNodeArray order -> joint index, -1 for nodes that are not joints
+	std::vector<int> NodeJointRemap;
+	std::unordered_map<FbxNode*, int> JointIndexMap;
+	std::unordered_map<FbxNode*, FbxCluster*> JointClusterMap;
 	mutable Status mStatus;
 	std::string FilePath;
 
+	// imported meshes use the quantized vertex formats when they stay within the error bounds
+	bool CompressVertices;
+	// levels of detail generated per mesh, 1 keeps only the source mesh
+	int LODCount;
+	// imported clips are compressed within ANIM_MAX_ERROR
+	bool CompressAnimation;
+
 	FbxTime mFrameTime;
-	FbxTime mStart;
-	FbxTime mStop;
-	FbxTime mCurrentTime;
 public:
+	// imports the file into mScene and converts axis/unit, once
+	bool LoadScene();
+
 	void TriangulateRecursive(FbxNode* pNode);
-	void FillFbxMeshArray(FbxNode* pNode, std::vector<StaticMesh*>& outStaticMeshArray);
-	void FillFbxSkelMeshArray(FbxNode* pNode, std::vector<SkeletalMesh*>& outSkeletalMeshArray);
+	// serial pass, copies every mesh out of the scene so they can be built in parallel
+	void FillMeshSourceArray(FbxNode* pNode, std::vector<MeshSource*>& outSourceArray);
 	void FillFbxNodeArray(FbxNode* pNode, std::vector<FbxNode*>& outNodeArray);
 	void FillFbxClusterArray(FbxNode* pNode, std::vector<FbxCluster*>& outClusterArray);
 
+	// collects the joints once, meshes, skeleton and clips all index them the same way
+	void BuildJointArray();
 	void ImportSkeleton(Skeleton** OutSkeleton, SkeletonPose** OutRefPose);
 	void FillSkeletonJointRecursive(FbxNode* pNode, std::vector<SkeletonJoint>& outJounts);
 
@@ -74,8 +91,8 @@ public:
 	void ImportSkeletalMesh(std::vector<SkeletalMesh*>& outSkeletalMeshArray);
 
 	void ImportAnimClip(std::vector<AnimationClip*>& outAnimclipArray);
-	void FillAnimTrackRecursive(FbxNode* pNode, AnimationClip* Clip);
-	void SampleCurrentRecursive(FbxNode* pNode, AnimationClip* Clip, int& NodeIndex);
+	// samples every joint of one stack at mFrameTime steps through the sdk, on the importing thread only
+	void BakeAnimStack(FbxAnimEvaluator* Evaluator, const std::vector<int>& ParentArray, const FbxTimeSpan& TimeSpan, AnimationClip* Clip) const;
 
 	FbxFileImporter( std::string Path);
 	~FbxFileImporter(void);
@@ -0,0 +1,225 @@
+#include <math.h>
+
+#include "FrustumCuller.h"
+
+#if defined(FRUSTUM_CULL_SSE)
+#include <emmintrin.h>
+#endif
+#if defined(FRUSTUM_CULL_AVX)
+#include <immintrin.h>
+#endif
+
+AABBSoaArray::AABBSoaArray()
+	:_Count(0)
+{
+}
+
+void AABBSoaArray::Clear()
+{
+	_MinX.clear(); _MinY.clear(); _MinZ.clear();
+	_MaxX.clear(); _MaxY.clear(); _MaxZ.clear();
+	_Count = 0;
+}
+
+int AABBSoaArray::Add( const XMFLOAT3& Min, const XMFLOAT3& Max )
+{
+	_MinX.push_back(Min.x); _MinY.push_back(Min.y); _MinZ.push_back(Min.z);
+	_MaxX.push_back(Max.x); _MaxY.push_back(Max.y); _MaxZ.push_back(Max.z);
+	return _Count++;
+}
+
+FrustumCuller::FrustumCuller()
+{
+	for(int p=0;p<6;p++)
+		_Planes[p] = XMFLOAT4(0.f, 0.f, 0.f, 1.f);
+	ResetStats();
+}
+
+void FrustumCuller::ExtractPlanes( const XMMATRIX& ViewProjection, XMFLOAT4* OutPlanes )
+{
+	XMFLOAT4X4 M;
+	XMStoreFloat4x4(&M, ViewProjection);
+	for(int p=0;p<6;p++)
+	{
+		const float Sign = p < 4 ? (p % 2 ? -1.f : 1.f) : -1.f;
+		const int Axis = p < 4 ? p / 2 : 2;
+		float* Plane = &OutPlanes[p].x;
+		for(int r=0;r<4;r++)
+		{
+			// near plane is z >= 0, d3d clip space
+			Plane[r] = p == 4 ? M.m[r][2] : M.m[r][3] + Sign * M.m[r][Axis];
+		}
+		const float InvLength = 1.f / sqrtf(Plane[0]*Plane[0] + Plane[1]*Plane[1] + Plane[2]*Plane[2]);
+		for(int r=0;r<4;r++)
+			Plane[r] *= InvLength;
+	}
+}
+
+EFrustumCullSimd FrustumCuller::GetBestSimd()
+{
+#if defined(FRUSTUM_CULL_AVX)
+	return FRUSTUM_CULL_AVX8;
+#elif defined(FRUSTUM_CULL_SSE)
+	return FRUSTUM_CULL_SSE4;
+#else
+	return FRUSTUM_CULL_SCALAR;
+#endif
+}
+
+void FrustumCuller::SetViewProjection( const XMMATRIX& ViewProjection )
+{
+	ExtractPlanes(ViewProjection, _Planes);
+}
+
+void FrustumCuller::SetPlanes( const XMFLOAT4* Planes )
+{
+	for(int p=0;p<6;p++)
+		_Planes[p] = Planes[p];
+}
+
+void FrustumCuller::ResetStats()
+{
+	_Stats.TestedCount = 0;
+	_Stats.VisibleCount = 0;
+}
+
+bool FrustumCuller::IsBoxVisible( const XMFLOAT3& Min, const XMFLOAT3& Max ) const
+{
+	// the corner furthest along each plane normal decides
+	for(int p=0;p<6;p++)
+	{
+		const XMFLOAT4& Plane = _Planes[p];
+		const float x = Plane.x > 0.f ? Max.x : Min.x;
+		const float y = Plane.y > 0.f ? Max.y : Min.y;
+		const float z = Plane.z > 0.f ? Max.z : Min.z;
+		if(Plane.x * x + Plane.y * y + Plane.z * z + Plane.w < 0.f)
+			return false;
+	}
+	return true;
+}
+
+// the sign of a plane normal is the same for every box, so the furthest corner is a choice of stream per plane,
+// not a per box select
+static void SelectStreams(const XMFLOAT4& Plane, const AABBSoaArray& Bounds, const float** OutStreams)
+{
+	OutStreams[0] = Plane.x > 0.f ? &Bounds._MaxX[0] : &Bounds._MinX[0];
+	OutStreams[1] = Plane.y > 0.f ? &Bounds._MaxY[0] : &Bounds._MinY[0];
+	OutStreams[2] = Plane.z > 0.f ? &Bounds._MaxZ[0] : &Bounds._MinZ[0];
+}
+
+#if defined(FRUSTUM_CULL_SSE)
+static int CullSse(const XMFLOAT4* Planes, const AABBSoaArray& Bounds, int Begin, int End, unsigned char* OutVisible)
+{
+	const float* Streams[6][3];
+	__m128 PlaneVec[6][4];
+	for(int p=0;p<6;p++)
+	{
+		SelectStreams(Planes[p], Bounds, Streams[p]);
+		PlaneVec[p][0] = _mm_set1_ps(Planes[p].x);
+		PlaneVec[p][1] = _mm_set1_ps(Planes[p].y);
+		PlaneVec[p][2] = _mm_set1_ps(Planes[p].z);
+		PlaneVec[p][3] = _mm_set1_ps(Planes[p].w);
+	}
+
+	const __m128 Zero = _mm_setzero_ps();
+	int VisibleCount = 0;
+	int i = Begin;
+	for(;i+4<=End;i+=4)
+	{
+		// a lane goes negative as soon as one plane has the box entirely behind it
+		__m128 Outside = Zero;
+		for(int p=0;p<6;p++)
+		{
+			__m128 Distance = _mm_add_ps(_mm_mul_ps(PlaneVec[p][0], _mm_loadu_ps(Streams[p][0] + i)), PlaneVec[p][3]);
+			Distance = _mm_add_ps(Distance, _mm_mul_ps(PlaneVec[p][1], _mm_loadu_ps(Streams[p][1] + i)));
+			Distance = _mm_add_ps(Distance, _mm_mul_ps(PlaneVec[p][2], _mm_loadu_ps(Streams[p][2] + i)));
+			Outside = _mm_or_ps(Outside, _mm_cmplt_ps(Distance, Zero));
+		}
+
+		const int Mask = _mm_movemask_ps(Outside);
+		for(int k=0;k<4;k++)
+		{
+			const unsigned char Visible = (Mask >> k) & 1 ? 0 : 1;
+			OutVisible[i - Begin + k] = Visible;
+			VisibleCount += Visible;
+		}
+	}
+	return VisibleCount;
+}
+#endif
+
+#if defined(FRUSTUM_CULL_AVX)
+static int CullAvx(const XMFLOAT4* Planes, const AABBSoaArray& Bounds, int Begin, int End, unsigned char* OutVisible)
+{
+	const float* Streams[6][3];
+	__m256 PlaneVec[6][4];
+	for(int p=0;p<6;p++)
+	{
+		SelectStreams(Planes[p], Bounds, Streams[p]);
+		PlaneVec[p][0] = _mm256_set1_ps(Planes[p].x);
+		PlaneVec[p][1] = _mm256_set1_ps(Planes[p].y);
+		PlaneVec[p][2] = _mm256_set1_ps(Planes[p].z);
+		PlaneVec[p][3] = _mm256_set1_ps(Planes[p].w);
+	}
+
+	const __m256 Zero = _mm256_setzero_ps();
+	int VisibleCount = 0;
+	int i = Begin;
+	for(;i+8<=End;i+=8)
+	{
+		__m256 Outside = Zero;
+		for(int p=0;p<6;p++)
+		{
+			__m256 Distance = _mm256_add_ps(_mm256_mul_ps(PlaneVec[p][0], _mm256_loadu_ps(Streams[p][0] + i)), PlaneVec[p][3]);
+			Distance = _mm256_add_ps(Distance, _mm256_mul_ps(PlaneVec[p][1], _mm256_loadu_ps(Streams[p][1] + i)));
+			Distance = _mm256_add_ps(Distance, _mm256_mul_ps(PlaneVec[p][2], _mm256_loadu_ps(Streams[p][2] + i)));
+			Outside = _mm256_or_ps(Outside, _mm256_cmp_ps(Distance, Zero, _CMP_LT_OQ));
+		}
+
+		const int Mask = _mm256_movemask_ps(Outside);
+		for(int k=0;k<8;k++)
+		{
+			const unsigned char Visible = (Mask >> k) & 1 ? 0 : 1;
+			OutVisible[i - Begin + k] = Visible;
+			VisibleCount += Visible;
+		}
+	}
+	return VisibleCount;
+}
+#endif
+
+int FrustumCuller::Cull( const AABBSoaArray& Bounds, int Begin, int Count, unsigned char* OutVisible, EFrustumCullSimd Simd )
+{
+	if(Count <= 0)
+		return 0;
+
+	const int End = Begin + Count;
+	int VisibleCount = 0;
+	int VectorEnd = Begin;
+#if defined(FRUSTUM_CULL_AVX)
+	if(Simd == FRUSTUM_CULL_AVX8)
+	{
+		VisibleCount += CullAvx(_Planes, Bounds, Begin, End, OutVisible);
+		VectorEnd = Begin + Count / 8 * 8;
+	}
+#endif
+#if defined(FRUSTUM_CULL_SSE)
+	// sse takes what's left of the avx pass as well
+	if(Simd != FRUSTUM_CULL_SCALAR)
+	{
+		VisibleCount += CullSse(_Planes, Bounds, VectorEnd, End, OutVisible + (VectorEnd - Begin));
+		VectorEnd += (End - VectorEnd) / 4 * 4;
+	}
+#endif
+
+	for(int i=VectorEnd;i<End;i++)
+	{
+		const bool bVisible = IsBoxVisible(XMFLOAT3(Bounds._MinX[i], Bounds._MinY[i], Bounds._MinZ[i]), XMFLOAT3(Bounds._MaxX[i], Bounds._MaxY[i], Bounds._MaxZ[i]));
+		OutVisible[i - Begin] = bVisible ? 1 : 0;
+		VisibleCount += bVisible ? 1 : 0;
+	}
+
+	_Stats.TestedCount += Count;
+	_Stats.VisibleCount += VisibleCount;
+	return VisibleCount;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "MathTypes.h"
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define FRUSTUM_CULL_SSE
+#endif
+#if defined(__AVX__)
+#define FRUSTUM_CULL_AVX
+#endif
+
+enum EFrustumCullSimd
+{
+	FRUSTUM_CULL_SCALAR,
+	FRUSTUM_CULL_SSE4,		// 4 boxes per step
+	FRUSTUM_CULL_AVX8,		// 8 boxes per step
+};
+
+// axis aligned boxes as six streams of floats, min x of every box, then min y, ...
+class AABBSoaArray
+{
+public:
+	std::vector<float> _MinX, _MinY, _MinZ;
+	std::vector<float> _MaxX, _MaxY, _MaxZ;
+	int _Count;
+
+	void Clear();
+	// index of the new box
+	int Add(const XMFLOAT3& Min, const XMFLOAT3& Max);
+
+	AABBSoaArray();
+};
+
+struct FrustumCullStats
+{
+	int TestedCount;
+	int VisibleCount;
+};
+
+// conservative box against frustum test, no device needed. a box is culled when it is entirely
+// behind one plane, boxes straddling a corner outside the frustum are kept
+class FrustumCuller
+{
+public:
+	XMFLOAT4 _Planes[6];	// inside is dot(Plane, p) >= 0
+	FrustumCullStats _Stats;	// since the last ResetStats
+
+	// clip space planes of a row-vector view projection, left, right, bottom, top, near, far
+	static void ExtractPlanes(const XMMATRIX& ViewProjection, XMFLOAT4* OutPlanes);
+	static EFrustumCullSimd GetBestSimd();
+
+	void SetViewProjection(const XMMATRIX& ViewProjection);
+	void SetPlanes(const XMFLOAT4* Planes);
+	void ResetStats();
+
+	// boxes [Begin, Begin + Count) of Bounds, OutVisible[i] is 1 when box Begin + i may be visible and 0 when it is culled.
+	// whole vectors of boxes first, the remainder one by one. returns the visible count
+	int Cull(const AABBSoaArray& Bounds, int Begin, int Count, unsigned char* OutVisible, EFrustumCullSimd Simd);
+	int Cull(const AABBSoaArray& Bounds, int Begin, int Count, unsigned char* OutVisible) { return Cull(Bounds, Begin, Count, OutVisible, GetBestSimd()); }
+	bool IsBoxVisible(const XMFLOAT3& Min, const XMFLOAT3& Max) const;
+
+	FrustumCuller();
+};
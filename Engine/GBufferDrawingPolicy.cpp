@@ -1,11 +1,17 @@
 #include "GBufferDrawingPolicy.h"
 #include "StateManager.h"
+#include "SkeletalMeshComponent.h"
+#include "BonePaletteArena.h"
 
 
 struct ConstantBufferStruct
 {
 	XMMATRIX mModelView;
 	XMMATRIX mProjection;
+	XMFLOAT4 PositionScale;
+	XMFLOAT4 PositionBias;
+	UINT BoneBase;		// first float4 of the draw's bones in the palette arena
+	UINT BonePad[3];
 };
 
 GBufferDrawingPolicy::GBufferDrawingPolicy(void)
@@ -39,7 +45,7 @@ GBufferDrawingPolicy::~GBufferDrawingPolicy(void)
 	if(_VertexShader) delete _VertexShader;
 }
 
-void GBufferDrawingPolicy::DrawStaticMesh( StaticMesh* pMesh, XMMATRIX& ViewMat, XMMATRIX& ProjectionMat )
+void GBufferDrawingPolicy::DrawStaticMesh( StaticMesh* pMesh, XMMATRIX& ViewMat, XMMATRIX& ProjectionMat, const unsigned char* SubMeshVisible )
 {
 	XMMATRIX World;
 
@@ -47,18 +53,20 @@ void GBufferDrawingPolicy::DrawStaticMesh( StaticMesh* pMesh, XMMATRIX& ViewMat,
 	cb.mModelView = XMMatrixTranspose( ViewMat );
 	cb.mProjection = XMMatrixTranspose( ProjectionMat);
 
+	pMesh->GetPositionScaleBias(cb.PositionScale, cb.PositionBias);
+	cb.BoneBase = 0;
 	GEngine->_ImmediateContext->UpdateSubresource( ConstantBuffer, 0, NULL, &cb, 0, 0 );
 
-	ShaderRes* pShaderRes = GetShaderRes(pMesh->_NumTexCoord, StaticVertex);
+	ShaderRes* pShaderRes = GetShaderRes(pMesh->_NumTexCoord, StaticVertex, pMesh->_CompressedVertex);
 
 
 	pShaderRes->SetShaderRes();
 
-	_VertexShader->SetShader(Static, pMesh->_NumTexCoord);
+	_VertexShader->SetShader(Static, pMesh->_NumTexCoord, pMesh->_CompressedVertex);
 
 	UINT offset = 0;
 	GEngine->_ImmediateContext->IASetVertexBuffers( 0, 1, &pMesh->_VertexBuffer, &pMesh->_VertexStride, &offset );
-	GEngine->_ImmediateContext->IASetIndexBuffer( pMesh->_IndexBuffer, DXGI_FORMAT_R32_UINT, 0 );
+	GEngine->_ImmediateContext->IASetIndexBuffer( pMesh->_IndexBuffer, pMesh->GetIndexFormat(), 0 );
 
 	GEngine->_ImmediateContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
 
@@ -69,29 +77,68 @@ void GBufferDrawingPolicy::DrawStaticMesh( StaticMesh* pMesh, XMMATRIX& ViewMat,
 	SET_PS_SAMPLER(0, SS_LINEAR);
 
 
-	GEngine->_ImmediateContext->DrawIndexed( pMesh->_NumTriangle*3, 0, 0 );        // 36 vertices needed for 12 triangles in a triangle list
+	// shadow cascades come through here as well, their orthographic projection picks the lod from the shadow map size
+	const int LODIndex = pMesh->SelectLOD(ViewMat, ProjectionMat);
+	// coarser lods aren't split by submesh, they draw whole
+	if(SubMeshVisible && LODIndex == 0)
+	{
+		DrawVisibleSubMeshes(pMesh, SubMeshVisible);
+		return;
+	}
+	const MeshLOD& LOD = pMesh->_LODArray[LODIndex];
+	GEngine->_ImmediateContext->DrawIndexed( LOD.TriangleCount*3, LOD.IndexOffset, 0 );
 }
 
 
 void GBufferDrawingPolicy::DrawSkeletalMeshData( SkeletalMeshRenderData* pRenderData, XMMATRIX& ViewMat, XMMATRIX& ProjectionMat )
 {
-	XMMATRIX World;
+	// the arena was full this frame, no bones to skin with
+	const bool bPreSkinned = pRenderData->_bPreSkinned;
+	if(!bPreSkinned && pRenderData->_BoneBase == BONE_ARENA_INVALID)
+		return;
+
+	// the palette is in model space, the component places it
+	XMMATRIX ModelView = XMMatrixMultiply(XMLoadFloat4x4(&pRenderData->_SkeletalMeshComponent->_World), ViewMat);
 
 	ConstantBufferStruct cb;
 	
-	cb.mModelView = XMMatrixTranspose( ViewMat );
+	cb.mModelView = XMMatrixTranspose( ModelView );
 	cb.mProjection = XMMatrixTranspose( ProjectionMat);
 
+	if(bPreSkinned)
+	{
+		// already skinned this frame, float vertices
+		cb.PositionScale = XMFLOAT4(1.f, 1.f, 1.f, 1.f);
+		cb.PositionBias = XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+		cb.BoneBase = 0;
+	}
+	else
+	{
+		pRenderData->_SkeletalMesh->GetPositionScaleBias(cb.PositionScale, cb.PositionBias);
+		cb.BoneBase = pRenderData->_BoneBase;
+	}
 	GEngine->_ImmediateContext->UpdateSubresource( ConstantBuffer, 0, NULL, &cb, 0, 0 );
 
-	ShaderRes* pShaderRes = GetShaderRes(pRenderData->_SkeletalMesh->_NumTexCoord, GpuSkinVertex);
+	ShaderRes* pShaderRes;
+	if(bPreSkinned)
+	{
+		pShaderRes = GetShaderRes(pRenderData->_SkeletalMesh->_NumTexCoord, StaticVertex, false);
+	}
+	else
+	{
+		const EVertexProcessingType SkinType = pRenderData->_SkeletalMeshComponent->_SkinningMode == SKIN_DUALQUAT ? GpuSkinDualQuatVertex : GpuSkinVertex;
+		pShaderRes = GetShaderRes(pRenderData->_SkeletalMesh->_NumTexCoord, SkinType, pRenderData->_SkeletalMesh->_CompressedVertex);
+	}
 
 
 	pShaderRes->SetShaderRes();
 
 	UINT offset = 0;
-	GEngine->_ImmediateContext->IASetVertexBuffers( 0, 1, &pRenderData->_SkeletalMesh->_VertexBuffer, &pRenderData->_SkeletalMesh->_VertexStride, &offset );
-	GEngine->_ImmediateContext->IASetIndexBuffer( pRenderData->_SkeletalMesh->_IndexBuffer, DXGI_FORMAT_R32_UINT, 0 );
+	if(bPreSkinned)
+		GEngine->_ImmediateContext->IASetVertexBuffers( 0, 1, &pRenderData->_PreSkinnedBuffer, &pRenderData->_PreSkinnedStride, &offset );
+	else
+		GEngine->_ImmediateContext->IASetVertexBuffers( 0, 1, &pRenderData->_SkeletalMesh->_VertexBuffer, &pRenderData->_SkeletalMesh->_VertexStride, &offset );
+	GEngine->_ImmediateContext->IASetIndexBuffer( pRenderData->_SkeletalMesh->_IndexBuffer, pRenderData->_SkeletalMesh->GetIndexFormat(), 0 );
 
 	GEngine->_ImmediateContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
 
@@ -99,9 +146,11 @@ void GBufferDrawingPolicy::DrawSkeletalMeshData( SkeletalMeshRenderData* pRender
 	GEngine->_ImmediateContext->VSSetConstantBuffers( 0, 1, &ConstantBuffer );
 	GEngine->_ImmediateContext->PSSetConstantBuffers( 0, 1, &ConstantBuffer );
 
-	GEngine->_ImmediateContext->VSSetShaderResources( 0, 1, &pRenderData->_BoneMatricesBufferRV );
+	if(!bPreSkinned)
+		GEngine->_ImmediateContext->VSSetShaderResources( 0, 1, &GEngine->_BonePaletteArena->_BufferRV );
 
 	SET_PS_SAMPLER(0, SS_LINEAR);
 
-	GEngine->_ImmediateContext->DrawIndexed( pRenderData->_SkeletalMesh->_NumTriangle*3, 0, 0 );        // 36 vertices needed for 12 triangles in a triangle list
+	const MeshLOD& LOD = pRenderData->_SkeletalMesh->_LODArray[pRenderData->_SkeletalMesh->SelectLOD(ModelView, ProjectionMat)];
+	GEngine->_ImmediateContext->DrawIndexed( LOD.TriangleCount*3, LOD.IndexOffset, 0 );
 }
\ No newline at end of file
@@ -20,7 +20,7 @@ class GBufferDrawingPolicy :
 	ID3D11Buffer*           ConstantBuffer;
 	GBufferVertexShader* _VertexShader;
 public:
-	virtual void DrawStaticMesh(StaticMesh* pMesh, XMMATRIX& ViewMat, XMMATRIX& ProjectionMat);
+	virtual void DrawStaticMesh(StaticMesh* pMesh, XMMATRIX& ViewMat, XMMATRIX& ProjectionMat, const unsigned char* SubMeshVisible = NULL);
 	virtual void DrawSkeletalMeshData(SkeletalMeshRenderData* pRenderData, XMMATRIX& ViewMat, XMMATRIX& ProjectionMat);
 	
 	GBufferDrawingPolicy(void);
@@ -0,0 +1,125 @@
+#include <cassert>
+#include <string.h>
+
+#include "LightClusterBuffers.h"
+#include "Util.h"
+
+LightClusterBuffers::LightClusterBuffers()
+	:_ClusterBuffer(NULL)
+	,_ClusterBufferRV(NULL)
+	,_IndexBuffer(NULL)
+	,_IndexBufferRV(NULL)
+	,_IndexCapacity(0)
+	,_LightBuffer(NULL)
+	,_LightBufferRV(NULL)
+	,_LightCapacity(0)
+{
+}
+
+LightClusterBuffers::~LightClusterBuffers()
+{
+	ReleaseBuffers();
+}
+
+void LightClusterBuffers::CreateBuffers( ID3D11Device* Device, int IndexCapacity, int LightCapacity )
+{
+	ReleaseBuffers();
+
+	HRESULT hr;
+	D3D11_BUFFER_DESC bdc;
+	ZeroMemory( &bdc, sizeof(bdc) );
+	bdc.Usage = D3D11_USAGE_DYNAMIC;
+	bdc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	bdc.CPUAccessFlags = D3D10_CPU_ACCESS_WRITE;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc;
+	ZeroMemory( &SRVDesc, sizeof( SRVDesc ) );
+	SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	SRVDesc.Buffer.ElementOffset = 0;
+
+	// offset and count per cluster
+	bdc.ByteWidth = LIGHT_CLUSTER_COUNT * 2 * sizeof(unsigned int);
+	hr = Device->CreateBuffer( &bdc, NULL, &_ClusterBuffer );
+	if( FAILED( hr ) )
+		assert(false);
+	SetD3DResourceDebugName("LightClusters", _ClusterBuffer);
+	SRVDesc.Format = DXGI_FORMAT_R32G32_UINT;
+	SRVDesc.Buffer.ElementWidth = LIGHT_CLUSTER_COUNT;
+	hr = Device->CreateShaderResourceView( _ClusterBuffer, &SRVDesc, &_ClusterBufferRV );
+	if( FAILED( hr ) )
+		assert(false);
+	SetD3DResourceDebugName("LightClustersRV", _ClusterBufferRV);
+
+	bdc.ByteWidth = IndexCapacity * sizeof(unsigned int);
+	hr = Device->CreateBuffer( &bdc, NULL, &_IndexBuffer );
+	if( FAILED( hr ) )
+		assert(false);
+	SetD3DResourceDebugName("LightClusterIndices", _IndexBuffer);
+	SRVDesc.Format = DXGI_FORMAT_R32_UINT;
+	SRVDesc.Buffer.ElementWidth = IndexCapacity;
+	hr = Device->CreateShaderResourceView( _IndexBuffer, &SRVDesc, &_IndexBufferRV );
+	if( FAILED( hr ) )
+		assert(false);
+	SetD3DResourceDebugName("LightClusterIndicesRV", _IndexBufferRV);
+
+	bdc.ByteWidth = LightCapacity * sizeof(ClusterLight);
+	hr = Device->CreateBuffer( &bdc, NULL, &_LightBuffer );
+	if( FAILED( hr ) )
+		assert(false);
+	SetD3DResourceDebugName("ClusterLights", _LightBuffer);
+	SRVDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	SRVDesc.Buffer.ElementWidth = LightCapacity * 2;
+	hr = Device->CreateShaderResourceView( _LightBuffer, &SRVDesc, &_LightBufferRV );
+	if( FAILED( hr ) )
+		assert(false);
+	SetD3DResourceDebugName("ClusterLightsRV", _LightBufferRV);
+
+	_IndexCapacity = IndexCapacity;
+	_LightCapacity = LightCapacity;
+}
+
+void LightClusterBuffers::ReleaseBuffers()
+{
+	if(_ClusterBufferRV) _ClusterBufferRV->Release();
+	if(_ClusterBuffer) _ClusterBuffer->Release();
+	if(_IndexBufferRV) _IndexBufferRV->Release();
+	if(_IndexBuffer) _IndexBuffer->Release();
+	if(_LightBufferRV) _LightBufferRV->Release();
+	if(_LightBuffer) _LightBuffer->Release();
+	_ClusterBufferRV = NULL;
+	_ClusterBuffer = NULL;
+	_IndexBufferRV = NULL;
+	_IndexBuffer = NULL;
+	_LightBufferRV = NULL;
+	_LightBuffer = NULL;
+	_IndexCapacity = 0;
+	_LightCapacity = 0;
+}
+
+static void UploadBuffer(ID3D11DeviceContext* Context, ID3D11Buffer* Buffer, const void* Data, int Size)
+{
+	D3D11_MAPPED_SUBRESOURCE MSR;
+	HRESULT hr = Context->Map( Buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MSR );
+	if( FAILED( hr ) )
+		assert(false);
+	if(Size > 0)
+		memcpy(MSR.pData, Data, Size);
+	Context->Unmap( Buffer, 0 );
+}
+
+void LightClusterBuffers::Upload( ID3D11Device* Device, ID3D11DeviceContext* Context )
+{
+	// capacities grow in powers of two and are kept
+	int IndexCapacity = _IndexCapacity > 0 ? _IndexCapacity : LIGHT_CLUSTER_INITIAL_INDICES;
+	while(IndexCapacity < (int)_IndexArray.size())
+		IndexCapacity *= 2;
+	int LightCapacity = _LightCapacity > 0 ? _LightCapacity : 64;
+	while(LightCapacity < (int)_LightArray.size())
+		LightCapacity *= 2;
+	if(_ClusterBuffer == NULL || IndexCapacity != _IndexCapacity || LightCapacity != _LightCapacity)
+		CreateBuffers(Device, IndexCapacity, LightCapacity);
+
+	UploadBuffer(Context, _ClusterBuffer, &_ClusterArray[0], _ClusterArray.size() * sizeof(unsigned int));
+	UploadBuffer(Context, _IndexBuffer, _IndexArray.empty() ? NULL : &_IndexArray[0], _IndexArray.size() * sizeof(unsigned int));
+	UploadBuffer(Context, _LightBuffer, _LightArray.empty() ? NULL : &_LightArray[0], _LightArray.size() * sizeof(ClusterLight));
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <d3d11.h>
+#include <xnamath.h>
+#include "LightClusterBuilder.h"
+
+// gpu copies of the built clusters for the resolve pass: (offset, count) per cluster at t3, the light indices at t4
+// and two float4 per light at t5. dynamic buffers rewritten under Map(WRITE_DISCARD) every frame
+class LightClusterBuffers :
+	public LightClusterBuilder
+{
+public:
+	ID3D11Buffer*				_ClusterBuffer;
+	ID3D11ShaderResourceView*	_ClusterBufferRV;
+	ID3D11Buffer*				_IndexBuffer;
+	ID3D11ShaderResourceView*	_IndexBufferRV;
+	int							_IndexCapacity;
+	ID3D11Buffer*				_LightBuffer;
+	ID3D11ShaderResourceView*	_LightBufferRV;
+	int							_LightCapacity;
+
+	// after Build, immediate context only
+	void Upload(ID3D11Device* Device, ID3D11DeviceContext* Context);
+
+	LightClusterBuffers();
+	~LightClusterBuffers();
+
+private:
+	void CreateBuffers(ID3D11Device* Device, int IndexCapacity, int LightCapacity);
+	void ReleaseBuffers();
+};
@@ -0,0 +1,234 @@
+#include <math.h>
+#include <string.h>
+
+#include "LightClusterBuilder.h"
+#include "MathUtil.h"
+#include "ParallelFor.h"
+
+#if defined(LIGHT_CLUSTER_SSE)
+#include <emmintrin.h>
+#endif
+#if defined(LIGHT_CLUSTER_AVX)
+#include <immintrin.h>
+#endif
+
+LightClusterBuilder::LightClusterBuilder()
+	:_Proj11(0.f)
+	,_Proj22(0.f)
+	,_Near(0.f)
+	,_Far(0.f)
+	,_SliceScale(0.f)
+	,_SliceBias(0.f)
+{
+	_SliceLightArray.resize(LIGHT_CLUSTER_Z);
+	_ClusterLightArray.resize(LIGHT_CLUSTER_COUNT);
+	_ClusterArray.resize(LIGHT_CLUSTER_COUNT * 2, 0);
+	memset(&_Stats, 0, sizeof(_Stats));
+}
+
+ELightClusterSimd LightClusterBuilder::GetBestSimd()
+{
+#if defined(LIGHT_CLUSTER_AVX)
+	return LIGHT_CLUSTER_AVX8;
+#elif defined(LIGHT_CLUSTER_SSE)
+	return LIGHT_CLUSTER_SSE4;
+#else
+	return LIGHT_CLUSTER_SCALAR;
+#endif
+}
+
+void LightClusterBuilder::SetProjection( const XMMATRIX& ProjectionMat, float Near, float Far )
+{
+	XMFLOAT4X4 P;
+	XMStoreFloat4x4(&P, ProjectionMat);
+	if(P._11 == _Proj11 && P._22 == _Proj22 && Near == _Near && Far == _Far)
+		return;
+	_Proj11 = P._11;
+	_Proj22 = P._22;
+	_Near = Near;
+	_Far = Far;
+	_SliceScale = LIGHT_CLUSTER_Z / logf(Far / Near);
+	_SliceBias = -logf(Near) * _SliceScale;
+
+	// view space x is ndc x * depth / _Proj11, so a froxel's extremes are at its near and far depth
+	_ClusterBounds.Clear();
+	_RowBounds.Clear();
+	for(int s=0;s<LIGHT_CLUSTER_Z;s++)
+	{
+		const float Depth0 = Near * powf(Far / Near, (float)s / LIGHT_CLUSTER_Z);
+		const float Depth1 = Near * powf(Far / Near, (float)(s + 1) / LIGHT_CLUSTER_Z);
+		for(int y=0;y<LIGHT_CLUSTER_Y;y++)
+		{
+			const float Top = 1.f - 2.f * y / LIGHT_CLUSTER_Y;
+			const float Bottom = 1.f - 2.f * (y + 1) / LIGHT_CLUSTER_Y;
+			const float MinY = Math::Min<float>(Bottom * Depth0, Bottom * Depth1) / _Proj22;
+			const float MaxY = Math::Max<float>(Top * Depth0, Top * Depth1) / _Proj22;
+			for(int x=0;x<LIGHT_CLUSTER_X;x++)
+			{
+				const float Left = -1.f + 2.f * x / LIGHT_CLUSTER_X;
+				const float Right = -1.f + 2.f * (x + 1) / LIGHT_CLUSTER_X;
+				_ClusterBounds.Add(
+					XMFLOAT3(Math::Min<float>(Left * Depth0, Left * Depth1) / _Proj11, MinY, -Depth1),
+					XMFLOAT3(Math::Max<float>(Right * Depth0, Right * Depth1) / _Proj11, MaxY, -Depth0));
+			}
+			_RowBounds.Add(XMFLOAT3(-Depth1 / _Proj11, MinY, -Depth1), XMFLOAT3(Depth1 / _Proj11, MaxY, -Depth0));
+		}
+	}
+}
+
+void LightClusterBuilder::BeginFrame( const XMMATRIX& ViewMat )
+{
+	XMStoreFloat4x4(&_ViewMat, ViewMat);
+	_LightArray.clear();
+	memset(&_Stats, 0, sizeof(_Stats));
+}
+
+int LightClusterBuilder::AddPointLight( const XMFLOAT3& Position, float Range, const XMFLOAT4& Color )
+{
+	if((int)_LightArray.size() >= LIGHT_CLUSTER_MAX_LIGHTS)
+	{
+		_Stats.DroppedLightCount++;
+		return -1;
+	}
+
+	ClusterLight Light;
+	XMStoreFloat4(&Light.PositionRange, XMVector3TransformCoord(XMLoadFloat3(&Position), XMLoadFloat4x4(&_ViewMat)));
+	Light.PositionRange.w = Range;
+	Light.Color = Color;
+	_LightArray.push_back(Light);
+	return _LightArray.size() - 1;
+}
+
+int LightClusterBuilder::GetSlice( float LinearDepth ) const
+{
+	if(LinearDepth <= _Near)
+		return 0;
+	const int Slice = (int)(logf(LinearDepth) * _SliceScale + _SliceBias);
+	return Slice < LIGHT_CLUSTER_Z ? Slice : LIGHT_CLUSTER_Z - 1;
+}
+
+static inline float BoxDistanceSq(const AABBSoaArray& Bounds, int Box, const XMFLOAT4& Sphere)
+{
+	const float DX = Math::Max<float>(Bounds._MinX[Box] - Sphere.x, 0.f) + Math::Max<float>(Sphere.x - Bounds._MaxX[Box], 0.f);
+	const float DY = Math::Max<float>(Bounds._MinY[Box] - Sphere.y, 0.f) + Math::Max<float>(Sphere.y - Bounds._MaxY[Box], 0.f);
+	const float DZ = Math::Max<float>(Bounds._MinZ[Box] - Sphere.z, 0.f) + Math::Max<float>(Sphere.z - Bounds._MaxZ[Box], 0.f);
+	return DX * DX + DY * DY + DZ * DZ;
+}
+
+void LightClusterBuilder::BuildSlice( int Slice, ELightClusterSimd Simd )
+{
+	const std::vector<int>& SliceLights = _SliceLightArray[Slice];
+	for(unsigned int i=0;i<SliceLights.size();i++)
+	{
+		const int LightIndex = SliceLights[i];
+		const XMFLOAT4& Sphere = _LightArray[LightIndex].PositionRange;
+		const float RangeSq = Sphere.w * Sphere.w;
+		for(int y=0;y<LIGHT_CLUSTER_Y;y++)
+		{
+			if(BoxDistanceSq(_RowBounds, Slice * LIGHT_CLUSTER_Y + y, Sphere) > RangeSq)
+				continue;
+
+			const int Base = GetClusterIndex(0, y, Slice);
+			int x = 0;
+#if defined(LIGHT_CLUSTER_AVX)
+			if(Simd == LIGHT_CLUSTER_AVX8)
+			{
+				const __m256 Zero = _mm256_setzero_ps();
+				const __m256 CX = _mm256_set1_ps(Sphere.x), CY = _mm256_set1_ps(Sphere.y), CZ = _mm256_set1_ps(Sphere.z);
+				const __m256 R2 = _mm256_set1_ps(RangeSq);
+				for(;x<LIGHT_CLUSTER_X;x+=8)
+				{
+					const int Box = Base + x;
+					const __m256 DX = _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(&_ClusterBounds._MinX[Box]), CX), Zero), _mm256_max_ps(_mm256_sub_ps(CX, _mm256_loadu_ps(&_ClusterBounds._MaxX[Box])), Zero));
+					const __m256 DY = _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(&_ClusterBounds._MinY[Box]), CY), Zero), _mm256_max_ps(_mm256_sub_ps(CY, _mm256_loadu_ps(&_ClusterBounds._MaxY[Box])), Zero));
+					const __m256 DZ = _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(&_ClusterBounds._MinZ[Box]), CZ), Zero), _mm256_max_ps(_mm256_sub_ps(CZ, _mm256_loadu_ps(&_ClusterBounds._MaxZ[Box])), Zero));
+					const __m256 DistanceSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(DX, DX), _mm256_mul_ps(DY, DY)), _mm256_mul_ps(DZ, DZ));
+					int Mask = _mm256_movemask_ps(_mm256_cmp_ps(DistanceSq, R2, _CMP_LE_OQ));
+					for(int k=0;Mask;k++, Mask>>=1)
+					{
+						if(Mask & 1)
+							_ClusterLightArray[Box + k].push_back(LightIndex);
+					}
+				}
+			}
+#endif
+#if defined(LIGHT_CLUSTER_SSE)
+			if(Simd == LIGHT_CLUSTER_SSE4)
+			{
+				const __m128 Zero = _mm_setzero_ps();
+				const __m128 CX = _mm_set1_ps(Sphere.x), CY = _mm_set1_ps(Sphere.y), CZ = _mm_set1_ps(Sphere.z);
+				const __m128 R2 = _mm_set1_ps(RangeSq);
+				for(;x<LIGHT_CLUSTER_X;x+=4)
+				{
+					const int Box = Base + x;
+					const __m128 DX = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&_ClusterBounds._MinX[Box]), CX), Zero), _mm_max_ps(_mm_sub_ps(CX, _mm_loadu_ps(&_ClusterBounds._MaxX[Box])), Zero));
+					const __m128 DY = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&_ClusterBounds._MinY[Box]), CY), Zero), _mm_max_ps(_mm_sub_ps(CY, _mm_loadu_ps(&_ClusterBounds._MaxY[Box])), Zero));
+					const __m128 DZ = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&_ClusterBounds._MinZ[Box]), CZ), Zero), _mm_max_ps(_mm_sub_ps(CZ, _mm_loadu_ps(&_ClusterBounds._MaxZ[Box])), Zero));
+					const __m128 DistanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(DX, DX), _mm_mul_ps(DY, DY)), _mm_mul_ps(DZ, DZ));
+					int Mask = _mm_movemask_ps(_mm_cmple_ps(DistanceSq, R2));
+					for(int k=0;Mask;k++, Mask>>=1)
+					{
+						if(Mask & 1)
+							_ClusterLightArray[Box + k].push_back(LightIndex);
+					}
+				}
+			}
+#endif
+			for(;x<LIGHT_CLUSTER_X;x++)
+			{
+				if(BoxDistanceSq(_ClusterBounds, Base + x, Sphere) <= RangeSq)
+					_ClusterLightArray[Base + x].push_back(LightIndex);
+			}
+		}
+	}
+}
+
+void LightClusterBuilder::Build( ELightClusterSimd Simd )
+{
+	_Stats.LightCount = _LightArray.size();
+	_Stats.IndexCount = 0;
+	_Stats.LitClusterCount = 0;
+	_Stats.MaxClusterLightCount = 0;
+	_Stats.OverflowCount = 0;
+
+	// lights to the slices their depth range reaches, ascending so every cluster's list comes out sorted
+	for(int s=0;s<LIGHT_CLUSTER_Z;s++)
+		_SliceLightArray[s].clear();
+	for(unsigned int l=0;l<_LightArray.size();l++)
+	{
+		const XMFLOAT4& Sphere = _LightArray[l].PositionRange;
+		const float Depth = -Sphere.z;
+		if(Depth + Sphere.w < _Near || Depth - Sphere.w > _Far)
+			continue;
+		const int LastSlice = GetSlice(Depth + Sphere.w);
+		for(int s=GetSlice(Depth - Sphere.w);s<=LastSlice;s++)
+			_SliceLightArray[s].push_back(l);
+	}
+
+	// a slice's clusters belong to its task only
+	for(int c=0;c<LIGHT_CLUSTER_COUNT;c++)
+		_ClusterLightArray[c].clear();
+	ParallelFor(0, LIGHT_CLUSTER_Z, [&](int Slice)
+	{
+		BuildSlice(Slice, Simd);
+	});
+
+	_IndexArray.clear();
+	for(int c=0;c<LIGHT_CLUSTER_COUNT;c++)
+	{
+		const std::vector<unsigned int>& ClusterLights = _ClusterLightArray[c];
+		int Count = ClusterLights.size();
+		if((int)_IndexArray.size() + Count > LIGHT_CLUSTER_MAX_INDICES)
+		{
+			_Stats.OverflowCount += (int)_IndexArray.size() + Count - LIGHT_CLUSTER_MAX_INDICES;
+			Count = LIGHT_CLUSTER_MAX_INDICES - _IndexArray.size();
+		}
+		_ClusterArray[c * 2] = _IndexArray.size();
+		_ClusterArray[c * 2 + 1] = Count;
+		_IndexArray.insert(_IndexArray.end(), ClusterLights.begin(), ClusterLights.begin() + Count);
+
+		_Stats.LitClusterCount += Count > 0 ? 1 : 0;
+		_Stats.MaxClusterLightCount = Math::Max<int>(_Stats.MaxClusterLightCount, Count);
+	}
+	_Stats.IndexCount = _IndexArray.size();
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "MathTypes.h"
+#include <vector>
+
+#include "FrustumCuller.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define LIGHT_CLUSTER_SSE
+#endif
+#if defined(__AVX__)
+#define LIGHT_CLUSTER_AVX
+#endif
+
+#define LIGHT_CLUSTER_X					16		// screen tiles across, multiple of 8
+#define LIGHT_CLUSTER_Y					8
+#define LIGHT_CLUSTER_Z					24		// depth slices, exponential from the near to the far plane
+#define LIGHT_CLUSTER_COUNT				(LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z)
+#define LIGHT_CLUSTER_MAX_LIGHTS		16384	// point lights per frame, the rest is left to their own passes
+#define LIGHT_CLUSTER_INITIAL_INDICES	16384
+#define LIGHT_CLUSTER_MAX_INDICES		(1 << 22)	// light indices over all clusters, 16MB
+
+enum ELightClusterSimd
+{
+	LIGHT_CLUSTER_SCALAR,
+	LIGHT_CLUSTER_SSE4,		// 4 clusters of a row per step
+	LIGHT_CLUSTER_AVX8,		// 8 clusters of a row per step
+};
+
+// what the resolve pass reads per light, two float4 elements
+struct ClusterLight
+{
+	XMFLOAT4 PositionRange;		// view space position, range in w
+	XMFLOAT4 Color;
+};
+
+struct LightClusterStats
+{
+	int LightCount;
+	int DroppedLightCount;		// over LIGHT_CLUSTER_MAX_LIGHTS
+	int IndexCount;
+	int LitClusterCount;		// clusters with at least one light
+	int MaxClusterLightCount;
+	int OverflowCount;			// indices past LIGHT_CLUSTER_MAX_INDICES, those lights are missing from their clusters
+};
+
+// clustered shading, the view frustum split into froxels and every point light listed in the ones its sphere touches.
+// one task per depth slice tests the slice's lights against its clusters a row at a time, then the lists are packed
+// back to back: per cluster (offset, count) into _IndexArray, whose entries index _LightArray.
+// cpu only, LightClusterBuffers uploads the result
+class LightClusterBuilder
+{
+public:
+	// view space box of every cluster, x fastest, then y from the top of the screen, then the depth slice
+	AABBSoaArray _ClusterBounds;
+	AABBSoaArray _RowBounds;	// a row of a slice as one box, rows no light reaches are skipped whole
+	float _Proj11, _Proj22, _Near, _Far;
+	float _SliceScale, _SliceBias;	// slice = log(depth) * _SliceScale + _SliceBias
+
+	XMFLOAT4X4 _ViewMat;
+	std::vector<ClusterLight> _LightArray;
+	std::vector<std::vector<int> > _SliceLightArray;	// lights whose depth range reaches each slice
+	std::vector<std::vector<unsigned int> > _ClusterLightArray;	// build scratch, each cluster's lights
+	std::vector<unsigned int> _ClusterArray;	// offset and count per cluster
+	std::vector<unsigned int> _IndexArray;
+	LightClusterStats _Stats;
+
+	static ELightClusterSimd GetBestSimd();
+
+	// froxels of a symmetric perspective projection, rebuilt only when it changed
+	void SetProjection(const XMMATRIX& ProjectionMat, float Near, float Far);
+	void BeginFrame(const XMMATRIX& ViewMat);
+	// world space light, returns its index or -1 when the frame is full
+	int AddPointLight(const XMFLOAT3& Position, float Range, const XMFLOAT4& Color);
+	void Build(ELightClusterSimd Simd);
+	void Build() { Build(GetBestSimd()); }
+
+	int GetSlice(float LinearDepth) const;
+	int GetClusterIndex(int X, int Y, int Slice) const { return (Slice * LIGHT_CLUSTER_Y + Y) * LIGHT_CLUSTER_X + X; }
+	int GetClusterLightCount(int Cluster) const { return _ClusterArray[Cluster * 2 + 1]; }
+	const unsigned int* GetClusterLights(int Cluster) const { return _IndexArray.empty() ? NULL : &_IndexArray[0] + _ClusterArray[Cluster * 2]; }
+
+	LightClusterBuilder();
+
+private:
+	void BuildSlice(int Slice, ELightClusterSimd Simd);
+};
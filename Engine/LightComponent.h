@@ -2,6 +2,7 @@
 #include "basecomponent.h"
 
 class Camera;
+class LightClusterBuilder;
 class LightComponent :
 	public BaseComponent
 {
@@ -9,6 +10,8 @@ public:
 	XMFLOAT4 _LightColor;
 public:
 	virtual void RenderLightDeferred(Camera* Camera){Camera;}
+	// true when the clustered resolve shades this light and its own pass is skipped
+	virtual bool AddToLightClusters(LightClusterBuilder* Builder){Builder; return false;}
 
 	LightComponent(XMFLOAT4 LightColor);
 	virtual ~LightComponent(void);
@@ -0,0 +1,125 @@
+#include <stdio.h>
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile(void)
+	: _Data(NULL)
+	, _Size(0)
+#ifdef _WIN32
+	, _FileHandle(INVALID_HANDLE_VALUE)
+	, _MappingHandle(NULL)
+#else
+	, _FileDesc(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile(void)
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* Path)
+{
+	Close();
+#ifdef _WIN32
+	_FileHandle = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(_FileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER FileSize;
+	if(!GetFileSizeEx(_FileHandle, &FileSize) || FileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	_MappingHandle = CreateFileMappingA(_FileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(_MappingHandle == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	_Data = (const unsigned char*)MapViewOfFile(_MappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if(_Data == NULL)
+	{
+		Close();
+		return false;
+	}
+	_Size = (size_t)FileSize.QuadPart;
+#else
+	_FileDesc = open(Path, O_RDONLY);
+	if(_FileDesc < 0)
+		return false;
+
+	struct stat FileStat;
+	if(fstat(_FileDesc, &FileStat) != 0 || FileStat.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+
+	void* Mapped = mmap(NULL, (size_t)FileStat.st_size, PROT_READ, MAP_PRIVATE, _FileDesc, 0);
+	if(Mapped == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	_Data = (const unsigned char*)Mapped;
+	_Size = (size_t)FileStat.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if(_Data) UnmapViewOfFile(_Data);
+	if(_MappingHandle) CloseHandle(_MappingHandle);
+	if(_FileHandle != INVALID_HANDLE_VALUE) CloseHandle(_FileHandle);
+	_MappingHandle = NULL;
+	_FileHandle = INVALID_HANDLE_VALUE;
+#else
+	if(_Data) munmap((void*)_Data, _Size);
+	if(_FileDesc >= 0) close(_FileDesc);
+	_FileDesc = -1;
+#endif
+	_Data = NULL;
+	_Size = 0;
+}
+
+bool WriteWholeFile(const char* Path, const void* Data, size_t Size)
+{
+	std::string TempPath = std::string(Path) + ".tmp";
+	FILE* File = fopen(TempPath.c_str(), "wb");
+	if(File == NULL)
+		return false;
+	bool bWritten = fwrite(Data, 1, Size, File) == Size;
+	bWritten = (fclose(File) == 0) && bWritten;
+	if(!bWritten)
+	{
+		remove(TempPath.c_str());
+		return false;
+	}
+	remove(Path);
+	return rename(TempPath.c_str(), Path) == 0;
+}
+
+std::string ReplaceFileExtension(const std::string& Path, const char* NewExtension)
+{
+	size_t DotPos = Path.find_last_of('.');
+	size_t SlashPos = Path.find_last_of("\\/");
+	if(DotPos == std::string::npos || (SlashPos != std::string::npos && DotPos < SlashPos))
+		return Path + NewExtension;
+	return Path.substr(0, DotPos) + NewExtension;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <stddef.h>
+#include <string>
+
+// read-only view of a whole file, backed by the OS file mapping
+class MappedFile
+{
+	const unsigned char*	_Data;
+	size_t					_Size;
+#ifdef _WIN32
+	void*					_FileHandle;
+	void*					_MappingHandle;
+#else
+	int						_FileDesc;
+#endif
+public:
+	bool Open(const char* Path);
+	void Close();
+
+	bool IsOpen() const {return _Data != NULL;}
+	const unsigned char* GetData() const {return _Data;}
+	size_t GetSize() const {return _Size;}
+
+	MappedFile(void);
+	~MappedFile(void);
+};
+
+// writes through a temp file so a partial write never leaves a valid looking file behind
+bool WriteWholeFile(const char* Path, const void* Data, size_t Size);
+
+// "dir/name.fbx" + ".cmesh" -> "dir/name.cmesh"
+std::string ReplaceFileExtension(const std::string& Path, const char* NewExtension);
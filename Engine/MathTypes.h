@@ -0,0 +1,333 @@
+#pragma once
+// xnamath types for code that needs no device.
+// the engine builds against xnamath, elsewhere (the headless tests) a scalar subset stands in for it
+// with the same names and the same row vector convention.
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#include <xnamath.h>
+#else
+#include <math.h>
+#include <string.h>
+
+typedef unsigned short HALF;
+
+#define XM_PI	3.141592654f
+
+struct XMFLOAT2
+{
+	float x, y;
+	XMFLOAT2() {}
+	XMFLOAT2(float _x, float _y) : x(_x), y(_y) {}
+};
+
+struct XMFLOAT3
+{
+	float x, y, z;
+	XMFLOAT3() {}
+	XMFLOAT3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+};
+
+struct XMFLOAT4
+{
+	float x, y, z, w;
+	XMFLOAT4() {}
+	XMFLOAT4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+};
+
+struct XMFLOAT4X4
+{
+	union
+	{
+		struct
+		{
+			float _11, _12, _13, _14;
+			float _21, _22, _23, _24;
+			float _31, _32, _33, _34;
+			float _41, _42, _43, _44;
+		};
+		float m[4][4];
+	};
+};
+
+struct XMVECTOR
+{
+	float v[4];
+};
+
+struct XMMATRIX
+{
+	XMVECTOR r[4];
+};
+
+// lane masks, converted to XMVECTOR for XMVectorSelect
+struct XMVECTORU32
+{
+	union
+	{
+		unsigned int u[4];
+		XMVECTOR v;
+	};
+	operator XMVECTOR() const { return v; }
+};
+
+static const XMVECTORU32 g_XMSelect0001 = {{{0x00000000U, 0x00000000U, 0x00000000U, 0xFFFFFFFFU}}};
+
+inline XMVECTOR XMVectorSet(float x, float y, float z, float w)
+{
+	XMVECTOR V = {{x, y, z, w}};
+	return V;
+}
+
+// round to nearest even, saturating past the largest half, as xnamath does
+inline HALF XMConvertFloatToHalf(float Value)
+{
+	unsigned int IValue;
+	memcpy(&IValue, &Value, sizeof(IValue));
+	const unsigned int Sign = (IValue & 0x80000000U) >> 16U;
+	IValue &= 0x7FFFFFFFU;
+	unsigned int Result;
+	if(IValue > 0x47FFEFFFU)
+		Result = 0x7FFFU;
+	else
+	{
+		if(IValue < 0x38800000U)
+		{
+			// too small for a normalized half, denormalize
+			const unsigned int Shift = 113U - (IValue >> 23U);
+			IValue = Shift < 32U ? (0x800000U | (IValue & 0x7FFFFFU)) >> Shift : 0U;
+		}
+		else
+			IValue += 0xC8000000U;
+		Result = ((IValue + 0x0FFFU + ((IValue >> 13U) & 1U)) >> 13U) & 0x7FFFU;
+	}
+	return (HALF)(Result | Sign);
+}
+
+inline float XMConvertHalfToFloat(HALF Value)
+{
+	unsigned int Mantissa = Value & 0x03FFU;
+	unsigned int Exponent;
+	if((Value & 0x7C00U) != 0)
+		Exponent = (Value >> 10U) & 0x1FU;
+	else if(Mantissa != 0)
+	{
+		// denormal, normalize it
+		Exponent = 1;
+		do
+		{
+			Exponent--;
+			Mantissa <<= 1;
+		} while((Mantissa & 0x0400U) == 0);
+		Mantissa &= 0x03FFU;
+	}
+	else
+		Exponent = (unsigned int)-112;
+	const unsigned int Result = ((Value & 0x8000U) << 16U) | ((Exponent + 112U) << 23U) | (Mantissa << 13U);
+	float Out;
+	memcpy(&Out, &Result, sizeof(Out));
+	return Out;
+}
+
+struct XMHALF4
+{
+	HALF x, y, z, w;
+	XMHALF4() {}
+	XMHALF4(HALF _x, HALF _y, HALF _z, HALF _w) : x(_x), y(_y), z(_z), w(_w) {}
+};
+
+inline XMVECTOR XMVectorZero() { return XMVectorSet(0.f, 0.f, 0.f, 0.f); }
+inline float XMVectorGetX(const XMVECTOR& V) { return V.v[0]; }
+inline float XMVectorGetY(const XMVECTOR& V) { return V.v[1]; }
+inline float XMVectorGetZ(const XMVECTOR& V) { return V.v[2]; }
+inline float XMVectorGetW(const XMVECTOR& V) { return V.v[3]; }
+inline XMVECTOR XMVectorSetW(XMVECTOR V, float w) { V.v[3] = w; return V; }
+
+inline XMVECTOR XMVectorReplicate(float Value) { return XMVectorSet(Value, Value, Value, Value); }
+inline XMVECTOR XMVectorSplatX(const XMVECTOR& V) { return XMVectorSet(V.v[0], V.v[0], V.v[0], V.v[0]); }
+inline XMVECTOR XMVectorSplatY(const XMVECTOR& V) { return XMVectorSet(V.v[1], V.v[1], V.v[1], V.v[1]); }
+inline XMVECTOR XMVectorSplatZ(const XMVECTOR& V) { return XMVectorSet(V.v[2], V.v[2], V.v[2], V.v[2]); }
+
+// V2 where the control bits are set, V1 elsewhere
+inline XMVECTOR XMVectorSelect(const XMVECTOR& V1, const XMVECTOR& V2, const XMVECTOR& Control)
+{
+	XMVECTOR Result;
+	for(int i=0;i<4;i++)
+	{
+		unsigned int A, B, C;
+		memcpy(&A, &V1.v[i], sizeof(A));
+		memcpy(&B, &V2.v[i], sizeof(B));
+		memcpy(&C, &Control.v[i], sizeof(C));
+		const unsigned int Bits = (A & ~C) | (B & C);
+		memcpy(&Result.v[i], &Bits, sizeof(Bits));
+	}
+	return Result;
+}
+
+inline XMVECTOR XMVectorAdd(const XMVECTOR& A, const XMVECTOR& B)
+{
+	return XMVectorSet(A.v[0] + B.v[0], A.v[1] + B.v[1], A.v[2] + B.v[2], A.v[3] + B.v[3]);
+}
+
+inline XMVECTOR XMVectorMultiply(const XMVECTOR& A, const XMVECTOR& B)
+{
+	return XMVectorSet(A.v[0] * B.v[0], A.v[1] * B.v[1], A.v[2] * B.v[2], A.v[3] * B.v[3]);
+}
+
+// A * B + C, rounded twice like xnamath's sse path
+inline XMVECTOR XMVectorMultiplyAdd(const XMVECTOR& A, const XMVECTOR& B, const XMVECTOR& C)
+{
+	return XMVectorSet(A.v[0] * B.v[0] + C.v[0], A.v[1] * B.v[1] + C.v[1], A.v[2] * B.v[2] + C.v[2], A.v[3] * B.v[3] + C.v[3]);
+}
+
+inline XMVECTOR XMVectorLerp(const XMVECTOR& V0, const XMVECTOR& V1, float t)
+{
+	return XMVectorSet(V0.v[0] + (V1.v[0] - V0.v[0]) * t, V0.v[1] + (V1.v[1] - V0.v[1]) * t, V0.v[2] + (V1.v[2] - V0.v[2]) * t, V0.v[3] + (V1.v[3] - V0.v[3]) * t);
+}
+
+inline XMVECTOR XMVectorSubtract(const XMVECTOR& A, const XMVECTOR& B)
+{
+	return XMVectorSet(A.v[0] - B.v[0], A.v[1] - B.v[1], A.v[2] - B.v[2], A.v[3] - B.v[3]);
+}
+
+inline XMVECTOR XMLoadFloat3(const XMFLOAT3* Src) { return XMVectorSet(Src->x, Src->y, Src->z, 0.f); }
+inline XMVECTOR XMLoadFloat4(const XMFLOAT4* Src) { return XMVectorSet(Src->x, Src->y, Src->z, Src->w); }
+inline void XMStoreFloat3(XMFLOAT3* Dst, const XMVECTOR& V) { *Dst = XMFLOAT3(V.v[0], V.v[1], V.v[2]); }
+inline void XMStoreFloat4(XMFLOAT4* Dst, const XMVECTOR& V) { *Dst = XMFLOAT4(V.v[0], V.v[1], V.v[2], V.v[3]); }
+
+inline XMVECTOR XMLoadHalf4(const XMHALF4* Src)
+{
+	return XMVectorSet(XMConvertHalfToFloat(Src->x), XMConvertHalfToFloat(Src->y), XMConvertHalfToFloat(Src->z), XMConvertHalfToFloat(Src->w));
+}
+
+inline void XMStoreHalf4(XMHALF4* Dst, const XMVECTOR& V)
+{
+	*Dst = XMHALF4(XMConvertFloatToHalf(V.v[0]), XMConvertFloatToHalf(V.v[1]), XMConvertFloatToHalf(V.v[2]), XMConvertFloatToHalf(V.v[3]));
+}
+
+inline XMMATRIX XMLoadFloat4x4(const XMFLOAT4X4* Src)
+{
+	XMMATRIX M;
+	for(int i=0;i<4;i++)
+		M.r[i] = XMVectorSet(Src->m[i][0], Src->m[i][1], Src->m[i][2], Src->m[i][3]);
+	return M;
+}
+
+inline void XMStoreFloat4x4(XMFLOAT4X4* Dst, const XMMATRIX& M)
+{
+	for(int i=0;i<4;i++)
+		for(int j=0;j<4;j++)
+			Dst->m[i][j] = M.r[i].v[j];
+}
+
+inline XMVECTOR XMVector3Dot(const XMVECTOR& A, const XMVECTOR& B)
+{
+	const float Dot = A.v[0] * B.v[0] + A.v[1] * B.v[1] + A.v[2] * B.v[2];
+	return XMVectorSet(Dot, Dot, Dot, Dot);
+}
+
+inline XMVECTOR XMVector3Length(const XMVECTOR& V)
+{
+	const float Length = sqrtf(XMVectorGetX(XMVector3Dot(V, V)));
+	return XMVectorSet(Length, Length, Length, Length);
+}
+
+inline XMVECTOR XMVector3Normalize(const XMVECTOR& V)
+{
+	const float Length = sqrtf(XMVectorGetX(XMVector3Dot(V, V)));
+	if(Length <= 0.f)
+		return V;
+	return XMVectorSet(V.v[0] / Length, V.v[1] / Length, V.v[2] / Length, V.v[3] / Length);
+}
+
+inline XMVECTOR XMVector3Cross(const XMVECTOR& A, const XMVECTOR& B)
+{
+	return XMVectorSet(A.v[1] * B.v[2] - A.v[2] * B.v[1], A.v[2] * B.v[0] - A.v[0] * B.v[2], A.v[0] * B.v[1] - A.v[1] * B.v[0], 0.f);
+}
+
+// row vector times matrix
+inline XMVECTOR XMVector4Transform(const XMVECTOR& V, const XMMATRIX& M)
+{
+	XMVECTOR Result;
+	for(int j=0;j<4;j++)
+		Result.v[j] = V.v[0] * M.r[0].v[j] + V.v[1] * M.r[1].v[j] + V.v[2] * M.r[2].v[j] + V.v[3] * M.r[3].v[j];
+	return Result;
+}
+
+inline XMVECTOR XMVector3Transform(const XMVECTOR& V, const XMMATRIX& M) { return XMVector4Transform(XMVectorSetW(V, 1.f), M); }
+inline XMVECTOR XMVector3TransformNormal(const XMVECTOR& V, const XMMATRIX& M) { return XMVector4Transform(XMVectorSetW(V, 0.f), M); }
+
+inline XMVECTOR XMVector3TransformCoord(const XMVECTOR& V, const XMMATRIX& M)
+{
+	XMVECTOR Result = XMVector3Transform(V, M);
+	const float InvW = 1.f / Result.v[3];
+	return XMVectorSet(Result.v[0] * InvW, Result.v[1] * InvW, Result.v[2] * InvW, 1.f);
+}
+
+// rotation of Angle radians around Axis, as x y z w
+inline XMVECTOR XMQuaternionRotationAxis(const XMVECTOR& Axis, float Angle)
+{
+	const XMVECTOR N = XMVector3Normalize(Axis);
+	const float S = sinf(Angle * 0.5f), C = cosf(Angle * 0.5f);
+	return XMVectorSet(N.v[0] * S, N.v[1] * S, N.v[2] * S, C);
+}
+
+// shorter arc, linear once the two are close enough for sin to lose precision
+inline XMVECTOR XMQuaternionSlerp(const XMVECTOR& Q0, const XMVECTOR& Q1, float t)
+{
+	float CosOmega = Q0.v[0] * Q1.v[0] + Q0.v[1] * Q1.v[1] + Q0.v[2] * Q1.v[2] + Q0.v[3] * Q1.v[3];
+	const float Sign = CosOmega < 0.f ? -1.f : 1.f;
+	CosOmega *= Sign;
+	float S0 = 1.f - t, S1 = t;
+	if(CosOmega < 1.f - 0.00001f)
+	{
+		const float Omega = acosf(CosOmega);
+		const float SinOmega = sinf(Omega);
+		S0 = sinf((1.f - t) * Omega) / SinOmega;
+		S1 = sinf(t * Omega) / SinOmega;
+	}
+	S1 *= Sign;
+	return XMVectorSet(Q0.v[0] * S0 + Q1.v[0] * S1, Q0.v[1] * S0 + Q1.v[1] * S1, Q0.v[2] * S0 + Q1.v[2] * S1, Q0.v[3] * S0 + Q1.v[3] * S1);
+}
+
+inline XMMATRIX XMMatrixSet(float m00, float m01, float m02, float m03, float m10, float m11, float m12, float m13,
+	float m20, float m21, float m22, float m23, float m30, float m31, float m32, float m33)
+{
+	XMMATRIX M;
+	M.r[0] = XMVectorSet(m00, m01, m02, m03);
+	M.r[1] = XMVectorSet(m10, m11, m12, m13);
+	M.r[2] = XMVectorSet(m20, m21, m22, m23);
+	M.r[3] = XMVectorSet(m30, m31, m32, m33);
+	return M;
+}
+
+inline XMMATRIX XMMatrixIdentity() { return XMMatrixSet(1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1); }
+inline XMMATRIX XMMatrixTranslation(float x, float y, float z) { return XMMatrixSet(1,0,0,0, 0,1,0,0, 0,0,1,0, x,y,z,1); }
+
+inline XMMATRIX XMMatrixMultiply(const XMMATRIX& A, const XMMATRIX& B)
+{
+	XMMATRIX M;
+	for(int i=0;i<4;i++)
+		M.r[i] = XMVector4Transform(A.r[i], B);
+	return M;
+}
+
+inline XMMATRIX XMMatrixLookAtLH(const XMVECTOR& Eye, const XMVECTOR& At, const XMVECTOR& Up)
+{
+	const XMVECTOR Z = XMVector3Normalize(XMVectorSubtract(At, Eye));
+	const XMVECTOR X = XMVector3Normalize(XMVector3Cross(Up, Z));
+	const XMVECTOR Y = XMVector3Cross(Z, X);
+	return XMMatrixSet(X.v[0], Y.v[0], Z.v[0], 0.f,
+		X.v[1], Y.v[1], Z.v[1], 0.f,
+		X.v[2], Y.v[2], Z.v[2], 0.f,
+		-XMVectorGetX(XMVector3Dot(X, Eye)), -XMVectorGetX(XMVector3Dot(Y, Eye)), -XMVectorGetX(XMVector3Dot(Z, Eye)), 1.f);
+}
+
+inline XMMATRIX XMMatrixPerspectiveFovLH(float FovY, float Aspect, float Near, float Far)
+{
+	const float H = 1.f / tanf(FovY * 0.5f);
+	const float W = H / Aspect;
+	const float Q = Far / (Far - Near);
+	return XMMatrixSet(W,0,0,0, 0,H,0,0, 0,0,Q,1, 0,0,-Q * Near,0);
+}
+#endif
@@ -2,12 +2,6 @@
 #define FLOAT_MAX  3.40282e+038
 namespace Math
 {
-	template<class T>
-	T Clamp(T v, T a, T b)
-	{
-		return max(a, min(v, b));
-	}
-
 	template<class T>
 	T Max(T a, T b)
 	{
@@ -25,5 +19,11 @@ namespace Math
 		else
 			return b;
 	}
+
+	template<class T>
+	T Clamp(T v, T a, T b)
+	{
+		return Max(a, Min(v, b));
+	}
 }
 
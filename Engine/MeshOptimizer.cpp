@@ -0,0 +1,378 @@
+#include <string.h>
+#include <stdint.h>
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+
+#include "MeshOptimizer.h"
+
+static uint32_t HashVertex(const unsigned char* Bytes, int Size)
+{
+	// FNV-1a, vertices are small so this is cheap enough
+	uint32_t Hash = 2166136261u;
+	for(int i=0;i<Size;i++)
+	{
+		Hash ^= Bytes[i];
+		Hash *= 16777619u;
+	}
+	return Hash;
+}
+
+int MeshOptimizer::WeldVertices( const void* VertexData, int VertexStride, int VertexCount, std::vector<unsigned int>& OutRemap )
+{
+	OutRemap.resize(VertexCount);
+	if(VertexCount == 0)
+		return 0;
+
+	const unsigned char* Vertices = (const unsigned char*)VertexData;
+
+	// open addressing table holding the original index of each unique vertex, kept under half full
+	unsigned int TableSize = 1;
+	while(TableSize < (unsigned int)VertexCount * 2)
+		TableSize <<= 1;
+	const unsigned int EmptySlot = 0xffffffff;
+	std::vector<unsigned int> Table(TableSize, EmptySlot);
+
+	int UniqueCount = 0;
+	for(int i=0;i<VertexCount;i++)
+	{
+		const unsigned char* Vertex = Vertices + (size_t)i * VertexStride;
+		unsigned int Slot = HashVertex(Vertex, VertexStride) & (TableSize - 1);
+		for(;;)
+		{
+			const unsigned int Found = Table[Slot];
+			if(Found == EmptySlot)
+			{
+				Table[Slot] = i;
+				OutRemap[i] = UniqueCount++;
+				break;
+			}
+			if(memcmp(Vertices + (size_t)Found * VertexStride, Vertex, VertexStride) == 0)
+			{
+				OutRemap[i] = OutRemap[Found];
+				break;
+			}
+			Slot = (Slot + 1) & (TableSize - 1);
+		}
+	}
+	return UniqueCount;
+}
+
+static float ForsythVertexScore(int CachePosition, int RemainingValence)
+{
+	// no triangle left to draw with it
+	if(RemainingValence == 0)
+		return -1.f;
+
+	float Score = 0.f;
+	if(CachePosition >= 0)
+	{
+		// the three vertices of the last triangle get a fixed score so the next one doesn't share an edge with it too eagerly
+		if(CachePosition < 3)
+			Score = 0.75f;
+		else
+			Score = powf(1.f - (float)(CachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+	}
+
+	// boost vertices with few triangles left so they get finished off instead of left behind
+	Score += 2.f * powf((float)RemainingValence, -0.5f);
+	return Score;
+}
+
+void MeshOptimizer::OptimizeVertexCache( unsigned int* Indices, int IndexCount, int VertexCount )
+{
+	const int TriangleCount = IndexCount / 3;
+	if(TriangleCount == 0)
+		return;
+
+	// vertex -> triangle adjacency
+	std::vector<int> Remaining(VertexCount, 0);
+	for(int i=0;i<TriangleCount*3;i++)
+		Remaining[Indices[i]]++;
+
+	std::vector<int> AdjOffset(VertexCount + 1, 0);
+	for(int v=0;v<VertexCount;v++)
+		AdjOffset[v+1] = AdjOffset[v] + Remaining[v];
+
+	std::vector<int> AdjTriangles(TriangleCount * 3);
+	std::vector<int> AdjFill(AdjOffset.begin(), AdjOffset.end() - 1);
+	for(int t=0;t<TriangleCount;t++)
+	{
+		for(int k=0;k<3;k++)
+			AdjTriangles[AdjFill[Indices[t*3+k]]++] = t;
+	}
+
+	std::vector<int> CachePosition(VertexCount, -1);
+	std::vector<float> VertexScore(VertexCount);
+	for(int v=0;v<VertexCount;v++)
+		VertexScore[v] = ForsythVertexScore(-1, Remaining[v]);
+
+	std::vector<float> TriangleScore(TriangleCount);
+	int Best = -1;
+	float BestScore = -FLT_MAX;
+	for(int t=0;t<TriangleCount;t++)
+	{
+		TriangleScore[t] = VertexScore[Indices[t*3]] + VertexScore[Indices[t*3+1]] + VertexScore[Indices[t*3+2]];
+		if(TriangleScore[t] > BestScore)
+		{
+			BestScore = TriangleScore[t];
+			Best = t;
+		}
+	}
+
+	std::vector<char> Emitted(TriangleCount, 0);
+	std::vector<unsigned int> Output(TriangleCount * 3);
+
+	int Cache[FORSYTH_CACHE_SIZE + 3];
+	int CacheCount = 0;
+	int Cursor = 0;
+
+	for(int OutTriangle=0;OutTriangle<TriangleCount;OutTriangle++)
+	{
+		// nothing in the cache has triangles left, continue in input order
+		if(Best < 0)
+		{
+			while(Emitted[Cursor])
+				Cursor++;
+			Best = Cursor;
+		}
+
+		const unsigned int Tri[3] = {Indices[Best*3], Indices[Best*3+1], Indices[Best*3+2]};
+		Output[OutTriangle*3] = Tri[0];
+		Output[OutTriangle*3+1] = Tri[1];
+		Output[OutTriangle*3+2] = Tri[2];
+		Emitted[Best] = 1;
+
+		for(int k=0;k<3;k++)
+		{
+			int* Adj = &AdjTriangles[AdjOffset[Tri[k]]];
+			const int Count = Remaining[Tri[k]];
+			for(int j=0;j<Count;j++)
+			{
+				if(Adj[j] == Best)
+				{
+					Adj[j] = Adj[Count-1];
+					break;
+				}
+			}
+			Remaining[Tri[k]]--;
+		}
+
+		// emitted triangle goes to the front of the lru cache
+		int NewCache[FORSYTH_CACHE_SIZE + 3];
+		int NewCount = 0;
+		for(int k=0;k<3;k++)
+		{
+			if(std::find(NewCache, NewCache + NewCount, (int)Tri[k]) == NewCache + NewCount)
+				NewCache[NewCount++] = Tri[k];
+		}
+		for(int i=0;i<CacheCount;i++)
+		{
+			if(Cache[i] != (int)Tri[0] && Cache[i] != (int)Tri[1] && Cache[i] != (int)Tri[2])
+				NewCache[NewCount++] = Cache[i];
+		}
+
+		CacheCount = NewCount < FORSYTH_CACHE_SIZE ? NewCount : FORSYTH_CACHE_SIZE;
+		for(int i=0;i<NewCount;i++)
+		{
+			const int Vertex = NewCache[i];
+			if(i < CacheCount)
+			{
+				Cache[i] = Vertex;
+				CachePosition[Vertex] = i;
+			}
+			else
+				CachePosition[Vertex] = -1;
+			VertexScore[Vertex] = ForsythVertexScore(CachePosition[Vertex], Remaining[Vertex]);
+		}
+
+		// only triangles touching the changed vertices need new scores
+		Best = -1;
+		BestScore = -FLT_MAX;
+		for(int i=0;i<NewCount;i++)
+		{
+			const int Vertex = NewCache[i];
+			const int* Adj = &AdjTriangles[AdjOffset[Vertex]];
+			for(int j=0;j<Remaining[Vertex];j++)
+			{
+				const int t = Adj[j];
+				TriangleScore[t] = VertexScore[Indices[t*3]] + VertexScore[Indices[t*3+1]] + VertexScore[Indices[t*3+2]];
+				if(i < CacheCount && TriangleScore[t] > BestScore)
+				{
+					BestScore = TriangleScore[t];
+					Best = t;
+				}
+			}
+		}
+	}
+
+	std::copy(Output.begin(), Output.end(), Indices);
+}
+
+struct OverdrawCluster
+{
+	int		FirstTriangle;
+	int		TriangleCount;
+	float	SortKey;
+
+	bool operator<(const OverdrawCluster& other) const
+	{
+		return SortKey > other.SortKey;
+	}
+};
+
+void MeshOptimizer::OptimizeOverdraw( unsigned int* Indices, int IndexCount, const float* Positions, int PositionStride, int VertexCount )
+{
+	const int TriangleCount = IndexCount / 3;
+	if(TriangleCount == 0)
+		return;
+
+	#define OVERDRAW_POSITION(v) ((const float*)((const unsigned char*)Positions + (size_t)(v) * PositionStride))
+
+	// a triangle missing the cache on all three vertices starts over, so moving
+	// the run in front of it somewhere else costs almost nothing in cache reuse
+	std::vector<OverdrawCluster> ClusterArray;
+	std::vector<unsigned int> CacheTime(VertexCount, 0);
+	unsigned int Time = ANALYZE_CACHE_SIZE + 1;
+	for(int t=0;t<TriangleCount;t++)
+	{
+		int Misses = 0;
+		for(int k=0;k<3;k++)
+		{
+			const unsigned int Vertex = Indices[t*3+k];
+			if(Time - CacheTime[Vertex] > ANALYZE_CACHE_SIZE)
+			{
+				CacheTime[Vertex] = Time++;
+				Misses++;
+			}
+		}
+
+		if(t == 0 || Misses == 3)
+		{
+			OverdrawCluster Cluster;
+			Cluster.FirstTriangle = t;
+			Cluster.TriangleCount = 0;
+			Cluster.SortKey = 0.f;
+			ClusterArray.push_back(Cluster);
+		}
+		ClusterArray.back().TriangleCount++;
+	}
+
+	if(ClusterArray.size() < 2)
+		return;
+
+	float MeshCenter[3] = {0.f, 0.f, 0.f};
+	float MeshArea = 0.f;
+	std::vector<float> ClusterData(ClusterArray.size() * 7);
+	for(unsigned int c=0;c<ClusterArray.size();c++)
+	{
+		// area weighted centroid and normal of the cluster
+		float* Data = &ClusterData[c * 7];
+		memset(Data, 0, sizeof(float) * 7);
+		const OverdrawCluster& Cluster = ClusterArray[c];
+		for(int t=Cluster.FirstTriangle;t<Cluster.FirstTriangle+Cluster.TriangleCount;t++)
+		{
+			const float* P0 = OVERDRAW_POSITION(Indices[t*3]);
+			const float* P1 = OVERDRAW_POSITION(Indices[t*3+1]);
+			const float* P2 = OVERDRAW_POSITION(Indices[t*3+2]);
+			const float E1[3] = {P1[0]-P0[0], P1[1]-P0[1], P1[2]-P0[2]};
+			const float E2[3] = {P2[0]-P0[0], P2[1]-P0[1], P2[2]-P0[2]};
+			const float N[3] = {E1[1]*E2[2]-E1[2]*E2[1], E1[2]*E2[0]-E1[0]*E2[2], E1[0]*E2[1]-E1[1]*E2[0]};
+			const float Area = sqrtf(N[0]*N[0] + N[1]*N[1] + N[2]*N[2]);
+			for(int i=0;i<3;i++)
+			{
+				Data[i] += (P0[i] + P1[i] + P2[i]) * (Area / 3.f);
+				Data[3+i] += N[i];
+			}
+			Data[6] += Area;
+		}
+		for(int i=0;i<3;i++)
+			MeshCenter[i] += Data[i];
+		MeshArea += Data[6];
+	}
+
+	if(MeshArea <= 0.f)
+		return;
+	for(int i=0;i<3;i++)
+		MeshCenter[i] /= MeshArea;
+
+	// clusters facing away from the mesh center are likely to occlude the rest
+	for(unsigned int c=0;c<ClusterArray.size();c++)
+	{
+		const float* Data = &ClusterData[c * 7];
+		if(Data[6] <= 0.f)
+			continue;
+		const float NormalLength = sqrtf(Data[3]*Data[3] + Data[4]*Data[4] + Data[5]*Data[5]);
+		if(NormalLength <= 0.f)
+			continue;
+		float SortKey = 0.f;
+		for(int i=0;i<3;i++)
+			SortKey += (Data[i] / Data[6] - MeshCenter[i]) * (Data[3+i] / NormalLength);
+		ClusterArray[c].SortKey = SortKey;
+	}
+
+	#undef OVERDRAW_POSITION
+
+	std::stable_sort(ClusterArray.begin(), ClusterArray.end());
+
+	std::vector<unsigned int> Output;
+	Output.reserve(TriangleCount * 3);
+	for(unsigned int c=0;c<ClusterArray.size();c++)
+	{
+		const OverdrawCluster& Cluster = ClusterArray[c];
+		Output.insert(Output.end(), Indices + Cluster.FirstTriangle * 3, Indices + (Cluster.FirstTriangle + Cluster.TriangleCount) * 3);
+	}
+	std::copy(Output.begin(), Output.end(), Indices);
+}
+
+void MeshOptimizer::OptimizeVertexFetch( unsigned int* Indices, int IndexCount, int VertexCount, std::vector<unsigned int>& OutRemap )
+{
+	const unsigned int Unused = 0xffffffff;
+	OutRemap.assign(VertexCount, Unused);
+
+	unsigned int NextVertex = 0;
+	for(int i=0;i<IndexCount;i++)
+	{
+		unsigned int& NewIndex = OutRemap[Indices[i]];
+		if(NewIndex == Unused)
+			NewIndex = NextVertex++;
+		Indices[i] = NewIndex;
+	}
+
+	for(int v=0;v<VertexCount;v++)
+	{
+		if(OutRemap[v] == Unused)
+			OutRemap[v] = NextVertex++;
+	}
+}
+
+void MeshOptimizer::AnalyzeVertexCache( const unsigned int* Indices, int IndexCount, int VertexCount, int CacheSize, float& OutACMR, float& OutATVR )
+{
+	OutACMR = 0.f;
+	OutATVR = 0.f;
+	if(IndexCount < 3)
+		return;
+
+	std::vector<unsigned int> CacheTime(VertexCount, 0);
+	std::vector<char> Referenced(VertexCount, 0);
+	unsigned int Time = CacheSize + 1;
+	int Misses = 0;
+	int ReferencedCount = 0;
+	for(int i=0;i<IndexCount;i++)
+	{
+		const unsigned int Vertex = Indices[i];
+		if(Time - CacheTime[Vertex] > (unsigned int)CacheSize)
+		{
+			CacheTime[Vertex] = Time++;
+			Misses++;
+		}
+		if(!Referenced[Vertex])
+		{
+			Referenced[Vertex] = 1;
+			ReferencedCount++;
+		}
+	}
+
+	OutACMR = (float)Misses / (IndexCount / 3);
+	OutATVR = (float)Misses / ReferencedCount;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+
+#define FORSYTH_CACHE_SIZE		32
+#define ANALYZE_CACHE_SIZE		16
+
+// cpu side mesh processing run at import/cook time, works on raw vertex and index arrays
+class MeshOptimizer
+{
+public:
+	// merges vertices whose VertexStride bytes are identical.
+	// OutRemap[old vertex] = new vertex, returns unique vertex count.
+	// unique vertices keep the order of their first occurrence.
+	static int WeldVertices(const void* VertexData, int VertexStride, int VertexCount, std::vector<unsigned int>& OutRemap);
+
+	// reorders triangles for post-transform cache reuse (Forsyth, lru cache of FORSYTH_CACHE_SIZE)
+	static void OptimizeVertexCache(unsigned int* Indices, int IndexCount, int VertexCount);
+
+	// splits cache optimized triangles into clusters at cache restarts and sorts the clusters
+	// so outward facing ones draw first. Positions points at the first x, PositionStride in bytes.
+	static void OptimizeOverdraw(unsigned int* Indices, int IndexCount, const float* Positions, int PositionStride, int VertexCount);
+
+	// renumbers vertices in first use order, rewrites Indices in place and fills OutRemap
+	// for reordering the vertex arrays. unreferenced vertices go to the end.
+	static void OptimizeVertexFetch(unsigned int* Indices, int IndexCount, int VertexCount, std::vector<unsigned int>& OutRemap);
+
+	// average cache miss per triangle and per referenced vertex with a fifo of CacheSize entries
+	static void AnalyzeVertexCache(const unsigned int* Indices, int IndexCount, int VertexCount, int CacheSize, float& OutACMR, float& OutATVR);
+
+	template<class T>
+	static void RemapVertexArray(std::vector<T>& Array, const std::vector<unsigned int>& Remap, int NewVertexCount)
+	{
+		if(Array.size() == 0)
+			return;
+		std::vector<T> NewArray(NewVertexCount);
+		for(unsigned int i=0;i<Remap.size();i++)
+			NewArray[Remap[i]] = Array[i];
+		Array.swap(NewArray);
+	}
+
+	template<class IndexType>
+	static void RemapIndexArray(std::vector<IndexType>& Indices, const std::vector<unsigned int>& Remap)
+	{
+		for(unsigned int i=0;i<Indices.size();i++)
+			Indices[i] = (IndexType)Remap[Indices[i]];
+	}
+};
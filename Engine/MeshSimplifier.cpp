@@ -0,0 +1,572 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "MathUtil.h"
+
+#define INVALID_VERTEX	0xffffffff
+#define BORDER_WEIGHT	10.f
+
+enum EVertexKind
+{
+	VertexManifold,		// single set of attributes, no open edges
+	VertexBorder,		// on an open edge loop
+	VertexSeam,			// two sets of attributes meeting along a seam
+	VertexLocked,		// anything else, never collapsed
+	VertexKindCount,
+};
+
+// [from kind][to kind]
+static const bool CanCollapse[VertexKindCount][VertexKindCount] =
+{
+	{true, true, true, true},
+	{false, true, false, false},
+	{false, false, true, false},
+	{false, false, false, false},
+};
+
+// edges that show up once in each direction, only one of the two is kept
+static const bool HasOpposite[VertexKindCount][VertexKindCount] =
+{
+	{true, true, true, false},
+	{true, false, true, false},
+	{true, true, true, false},
+	{false, false, false, false},
+};
+
+struct Quadric
+{
+	float a00, a11, a22;
+	float a10, a20, a21;
+	float b0, b1, b2;
+	float c;
+	float w;
+};
+
+struct EdgeCollapse
+{
+	unsigned int	V0;
+	unsigned int	V1;
+	bool			Bidirectional;
+	float			Error;
+};
+
+// outgoing half edges of every vertex
+struct EdgeAdjacency
+{
+	std::vector<unsigned int> Offsets;
+	std::vector<unsigned int> Next;
+	std::vector<unsigned int> Prev;
+};
+
+static XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+static XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return XMFLOAT3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+}
+
+static float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+static float Normalize(XMFLOAT3& v)
+{
+	const float Length = sqrtf(Dot(v, v));
+	if(Length > 0.f)
+	{
+		v.x /= Length; v.y /= Length; v.z /= Length;
+	}
+	return Length;
+}
+
+static void QuadricFromPlane(Quadric& Q, const XMFLOAT3& n, float d, float w)
+{
+	Q.a00 = n.x * n.x * w;
+	Q.a11 = n.y * n.y * w;
+	Q.a22 = n.z * n.z * w;
+	Q.a10 = n.y * n.x * w;
+	Q.a20 = n.z * n.x * w;
+	Q.a21 = n.z * n.y * w;
+	Q.b0 = n.x * d * w;
+	Q.b1 = n.y * d * w;
+	Q.b2 = n.z * d * w;
+	Q.c = d * d * w;
+	Q.w = w;
+}
+
+static void QuadricAdd(Quadric& Q, const Quadric& R)
+{
+	Q.a00 += R.a00; Q.a11 += R.a11; Q.a22 += R.a22;
+	Q.a10 += R.a10; Q.a20 += R.a20; Q.a21 += R.a21;
+	Q.b0 += R.b0; Q.b1 += R.b1; Q.b2 += R.b2;
+	Q.c += R.c;
+	Q.w += R.w;
+}
+
+// weighted mean of the squared distances to the accumulated planes
+static float QuadricError(const Quadric& Q, const XMFLOAT3& v)
+{
+	const float rx = Q.a00 * v.x + Q.a10 * v.y + Q.a20 * v.z + Q.b0 * 2.f;
+	const float ry = Q.a10 * v.x + Q.a11 * v.y + Q.a21 * v.z + Q.b1 * 2.f;
+	const float rz = Q.a20 * v.x + Q.a21 * v.y + Q.a22 * v.z + Q.b2 * 2.f;
+	const float r = rx * v.x + ry * v.y + rz * v.z + Q.c;
+	return Q.w > 0.f ? fabsf(r) / Q.w : 0.f;
+}
+
+static void QuadricFromTriangle(Quadric& Q, const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+{
+	XMFLOAT3 n = Cross(Sub(p1, p0), Sub(p2, p0));
+	const float Area = Normalize(n);
+	QuadricFromPlane(Q, n, -Dot(n, p0), Area);
+}
+
+// plane through the edge p0-p1, perpendicular to the triangle, keeps open borders in place
+static void QuadricFromTriangleEdge(Quadric& Q, const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2, float Weight)
+{
+	XMFLOAT3 p10 = Sub(p1, p0);
+	const float Length = Normalize(p10);
+	XMFLOAT3 p20 = Sub(p2, p0);
+	const float Along = Dot(p20, p10);
+	XMFLOAT3 n(p20.x - p10.x * Along, p20.y - p10.y * Along, p20.z - p10.z * Along);
+	Normalize(n);
+	QuadricFromPlane(Q, n, -Dot(n, p0), Length * Length * Weight);
+}
+
+static void BuildAdjacency(EdgeAdjacency& Adjacency, const unsigned int* Indices, int IndexCount, int VertexCount, const unsigned int* Remap)
+{
+	Adjacency.Offsets.assign(VertexCount + 1, 0);
+	Adjacency.Next.resize(IndexCount);
+	Adjacency.Prev.resize(IndexCount);
+
+	for(int i=0;i<IndexCount;i++)
+		Adjacency.Offsets[(Remap ? Remap[Indices[i]] : Indices[i]) + 1]++;
+	for(int v=0;v<VertexCount;v++)
+		Adjacency.Offsets[v + 1] += Adjacency.Offsets[v];
+
+	std::vector<unsigned int> Fill(Adjacency.Offsets.begin(), Adjacency.Offsets.end() - 1);
+	for(int i=0;i<IndexCount;i+=3)
+	{
+		unsigned int Tri[3];
+		for(int k=0;k<3;k++)
+			Tri[k] = Remap ? Remap[Indices[i + k]] : Indices[i + k];
+
+		for(int k=0;k<3;k++)
+		{
+			const unsigned int Slot = Fill[Tri[k]]++;
+			Adjacency.Next[Slot] = Tri[(k + 1) % 3];
+			Adjacency.Prev[Slot] = Tri[(k + 2) % 3];
+		}
+	}
+}
+
+static bool HasEdge(const EdgeAdjacency& Adjacency, unsigned int a, unsigned int b)
+{
+	for(unsigned int i=Adjacency.Offsets[a];i<Adjacency.Offsets[a + 1];i++)
+	{
+		if(Adjacency.Next[i] == b)
+			return true;
+	}
+	return false;
+}
+
+// moving r0 onto r1 must not turn any of the remaining triangles around.
+// neighbours may already have collapsed earlier in the pass, so they are looked up through CollapseRemap.
+static bool HasTriangleFlips(const EdgeAdjacency& Adjacency, const std::vector<XMFLOAT3>& Positions,
+	const std::vector<unsigned int>& Remap, const std::vector<unsigned int>& CollapseRemap, unsigned int r0, unsigned int r1)
+{
+	const XMFLOAT3& p0 = Positions[r0];
+	const XMFLOAT3& p1 = Positions[r1];
+	for(unsigned int i=Adjacency.Offsets[r0];i<Adjacency.Offsets[r0 + 1];i++)
+	{
+		const unsigned int a = Remap[CollapseRemap[Adjacency.Next[i]]];
+		const unsigned int b = Remap[CollapseRemap[Adjacency.Prev[i]]];
+		if(a == r1 || b == r1 || a == b)
+			continue;
+
+		const XMFLOAT3 Before = Cross(Sub(Positions[a], p0), Sub(Positions[b], p0));
+		const XMFLOAT3 After = Cross(Sub(Positions[a], p1), Sub(Positions[b], p1));
+		// slivers can swing far without a sign change, so large rotations count as flips too
+		if(Dot(Before, After) <= 0.25f * sqrtf(Dot(Before, Before) * Dot(After, After)))
+			return true;
+	}
+	return false;
+}
+
+static float AttributeDistance(const float* Attributes, int AttributeCount, unsigned int v0, unsigned int v1)
+{
+	float Distance = 0.f;
+	for(int k=0;k<AttributeCount;k++)
+	{
+		const float d = Attributes[v0 * AttributeCount + k] - Attributes[v1 * AttributeCount + k];
+		Distance += d * d;
+	}
+	return Distance;
+}
+
+int MeshSimplifier::Simplify( unsigned int* OutIndices, const unsigned int* Indices, int IndexCount,
+	const XMFLOAT3* Positions, int VertexCount, const float* Attributes, int AttributeCount, float AttributeWeight,
+	const unsigned int* CollapseGroups, int TargetIndexCount, float TargetError, float& OutError )
+{
+	OutError = 0.f;
+	if(IndexCount == 0)
+		return 0;
+	memcpy(OutIndices, Indices, IndexCount * sizeof(unsigned int));
+	if(IndexCount <= TargetIndexCount || VertexCount == 0)
+		return IndexCount;
+
+	// work in the unit box so errors are relative to the mesh extent
+	XMFLOAT3 Min(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX);
+	XMFLOAT3 Max(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX);
+	for(int v=0;v<VertexCount;v++)
+	{
+		Min.x = Math::Min<float>(Min.x, Positions[v].x); Max.x = Math::Max<float>(Max.x, Positions[v].x);
+		Min.y = Math::Min<float>(Min.y, Positions[v].y); Max.y = Math::Max<float>(Max.y, Positions[v].y);
+		Min.z = Math::Min<float>(Min.z, Positions[v].z); Max.z = Math::Max<float>(Max.z, Positions[v].z);
+	}
+	const float Extent = Math::Max<float>(Max.x - Min.x, Math::Max<float>(Max.y - Min.y, Max.z - Min.z));
+	const float Scale = Extent > 0.f ? 1.f / Extent : 0.f;
+
+	std::vector<XMFLOAT3> UnitPositions(VertexCount);
+	for(int v=0;v<VertexCount;v++)
+		UnitPositions[v] = XMFLOAT3((Positions[v].x - Min.x) * Scale, (Positions[v].y - Min.y) * Scale, (Positions[v].z - Min.z) * Scale);
+
+	// Remap[v] is the first vertex at the same position, Wedge links all vertices sharing it in a ring
+	std::vector<unsigned int> WeldRemap;
+	const int PositionCount = MeshOptimizer::WeldVertices(Positions, sizeof(XMFLOAT3), VertexCount, WeldRemap);
+	std::vector<unsigned int> FirstVertex(PositionCount, INVALID_VERTEX);
+	std::vector<unsigned int> Remap(VertexCount);
+	std::vector<unsigned int> Wedge(VertexCount);
+	for(int v=0;v<VertexCount;v++)
+	{
+		unsigned int& First = FirstVertex[WeldRemap[v]];
+		if(First == INVALID_VERTEX)
+			First = v;
+		Remap[v] = First;
+		Wedge[v] = v;
+		if(First != (unsigned int)v)
+		{
+			Wedge[v] = Wedge[First];
+			Wedge[First] = v;
+		}
+	}
+
+	// open half edges, Loop[v] follows the border or seam out of v and LoopBack comes into it.
+	// a vertex with more than one open edge points at itself.
+	EdgeAdjacency Adjacency;
+	BuildAdjacency(Adjacency, OutIndices, IndexCount, VertexCount, NULL);
+	std::vector<unsigned int> Loop(VertexCount, INVALID_VERTEX);
+	std::vector<unsigned int> LoopBack(VertexCount, INVALID_VERTEX);
+	for(int v=0;v<VertexCount;v++)
+	{
+		for(unsigned int i=Adjacency.Offsets[v];i<Adjacency.Offsets[v + 1];i++)
+		{
+			const unsigned int Target = Adjacency.Next[i];
+			if(HasEdge(Adjacency, Target, v))
+				continue;
+			Loop[v] = Loop[v] == INVALID_VERTEX ? Target : v;
+			LoopBack[Target] = LoopBack[Target] == INVALID_VERTEX ? v : Target;
+		}
+	}
+
+	std::vector<unsigned char> Kind(VertexCount, VertexLocked);
+	for(int v=0;v<VertexCount;v++)
+	{
+		if(Remap[v] != (unsigned int)v)
+			continue;
+
+		if(Wedge[v] == (unsigned int)v)
+		{
+			const unsigned int In = LoopBack[v], Out = Loop[v];
+			if(In == INVALID_VERTEX && Out == INVALID_VERTEX)
+				Kind[v] = VertexManifold;
+			// an open edge that comes back to the same position is the end of a seam, not a border
+			else if(In != INVALID_VERTEX && Out != INVALID_VERTEX && In != v && Out != v && Remap[In] != Remap[Out])
+				Kind[v] = VertexBorder;
+		}
+		else if(Wedge[Wedge[v]] == (unsigned int)v)
+		{
+			const unsigned int w = Wedge[v];
+			const unsigned int InV = LoopBack[v], OutV = Loop[v];
+			const unsigned int InW = LoopBack[w], OutW = Loop[w];
+			if(InV != INVALID_VERTEX && InV != v && OutV != INVALID_VERTEX && OutV != v
+				&& InW != INVALID_VERTEX && InW != w && OutW != INVALID_VERTEX && OutW != w
+				&& Remap[InV] == Remap[OutW] && Remap[OutV] == Remap[InW] && Remap[InV] != Remap[OutV])
+				Kind[v] = VertexSeam;
+		}
+	}
+	for(int v=0;v<VertexCount;v++)
+		Kind[v] = Kind[Remap[v]];
+
+	// plane quadrics of the triangles plus edge quadrics that hold borders and seams
+	std::vector<Quadric> Quadrics(VertexCount);
+	memset(&Quadrics[0], 0, VertexCount * sizeof(Quadric));
+	for(int i=0;i<IndexCount;i+=3)
+	{
+		const unsigned int i0 = OutIndices[i], i1 = OutIndices[i + 1], i2 = OutIndices[i + 2];
+		Quadric Q;
+		QuadricFromTriangle(Q, UnitPositions[i0], UnitPositions[i1], UnitPositions[i2]);
+		QuadricAdd(Quadrics[Remap[i0]], Q);
+		QuadricAdd(Quadrics[Remap[i1]], Q);
+		QuadricAdd(Quadrics[Remap[i2]], Q);
+
+		for(int e=0;e<3;e++)
+		{
+			const unsigned int v0 = OutIndices[i + e];
+			const unsigned int v1 = OutIndices[i + (e + 1) % 3];
+			const unsigned char k0 = Kind[v0], k1 = Kind[v1];
+			const bool bOpen0 = k0 == VertexBorder || k0 == VertexSeam;
+			const bool bOpen1 = k1 == VertexBorder || k1 == VertexSeam;
+			if(!bOpen0 && !bOpen1)
+				continue;
+			if((bOpen0 && Loop[v0] != v1) || (bOpen1 && LoopBack[v1] != v0))
+				continue;
+			if(HasOpposite[k0][k1] && Remap[v1] > Remap[v0])
+				continue;
+
+			const float Weight = (k0 == VertexBorder || k1 == VertexBorder) ? BORDER_WEIGHT : 1.f;
+			QuadricFromTriangleEdge(Q, UnitPositions[v0], UnitPositions[v1], UnitPositions[OutIndices[i + (e + 2) % 3]], Weight);
+			QuadricAdd(Quadrics[Remap[v0]], Q);
+			QuadricAdd(Quadrics[Remap[v1]], Q);
+		}
+	}
+
+	const float ErrorLimit = TargetError * TargetError;
+	float ResultError = 0.f;
+	int ResultCount = IndexCount;
+
+	std::vector<EdgeCollapse> Collapses;
+	std::vector<unsigned int> CollapseOrder;
+	std::vector<unsigned int> CollapseRemap(VertexCount);
+	std::vector<unsigned char> CollapseLocked(VertexCount);
+
+	while(ResultCount > TargetIndexCount)
+	{
+		// flips are checked in position space so triangles on both sides of a seam count
+		BuildAdjacency(Adjacency, OutIndices, ResultCount, VertexCount, &Remap[0]);
+
+		Collapses.clear();
+		for(int i=0;i<ResultCount;i+=3)
+		{
+			for(int e=0;e<3;e++)
+			{
+				const unsigned int v0 = OutIndices[i + e];
+				const unsigned int v1 = OutIndices[i + (e + 1) % 3];
+				if(Remap[v0] == Remap[v1])
+					continue;
+
+				const unsigned char k0 = Kind[v0], k1 = Kind[v1];
+				if(!CanCollapse[k0][k1] && !CanCollapse[k1][k0])
+					continue;
+				if(HasOpposite[k0][k1] && Remap[v1] > Remap[v0])
+					continue;
+				// two border or seam vertices without an open edge between them belong to different loops
+				if(k0 == k1 && (k0 == VertexBorder || k0 == VertexSeam) && Loop[v0] != v1)
+					continue;
+				if(CollapseGroups && CollapseGroups[v0] != CollapseGroups[v1])
+					continue;
+
+				EdgeCollapse Collapse;
+				Collapse.Bidirectional = CanCollapse[k0][k1] && CanCollapse[k1][k0];
+				Collapse.V0 = CanCollapse[k0][k1] ? v0 : v1;
+				Collapse.V1 = CanCollapse[k0][k1] ? v1 : v0;
+				Collapse.Error = 0.f;
+				Collapses.push_back(Collapse);
+			}
+		}
+		if(Collapses.size() == 0)
+			break;
+
+		// cost of each direction, the cheaper one wins
+		for(unsigned int c=0;c<Collapses.size();c++)
+		{
+			EdgeCollapse& Collapse = Collapses[c];
+			const int DirectionCount = Collapse.Bidirectional ? 2 : 1;
+			float BestError = FLOAT_MAX;
+			for(int d=0;d<DirectionCount;d++)
+			{
+				const unsigned int v0 = d == 0 ? Collapse.V0 : Collapse.V1;
+				const unsigned int v1 = d == 0 ? Collapse.V1 : Collapse.V0;
+				float Error = QuadricError(Quadrics[Remap[v0]], UnitPositions[v1]);
+				if(Attributes)
+				{
+					float Distance = AttributeDistance(Attributes, AttributeCount, v0, v1);
+					if(Kind[v0] == VertexSeam)
+					{
+						const unsigned int s0 = Wedge[v0];
+						const unsigned int s1 = Loop[v0] == v1 ? LoopBack[s0] : Loop[s0];
+						if(s1 != INVALID_VERTEX)
+							Distance += AttributeDistance(Attributes, AttributeCount, s0, s1);
+					}
+					Error += Distance * AttributeWeight;
+				}
+				if(Error < BestError)
+				{
+					BestError = Error;
+					Collapse.V0 = v0;
+					Collapse.V1 = v1;
+				}
+			}
+			Collapse.Error = BestError;
+		}
+
+		CollapseOrder.resize(Collapses.size());
+		for(unsigned int c=0;c<Collapses.size();c++)
+			CollapseOrder[c] = c;
+		std::sort(CollapseOrder.begin(), CollapseOrder.end(), [&](unsigned int a, unsigned int b)
+		{
+			return Collapses[a].Error < Collapses[b].Error;
+		});
+
+		for(int v=0;v<VertexCount;v++)
+			CollapseRemap[v] = v;
+		std::fill(CollapseLocked.begin(), CollapseLocked.end(), 0);
+
+		// each manifold or seam collapse removes two triangles, a border collapse one
+		const int TriangleGoal = (ResultCount - TargetIndexCount) / 3;
+		int TrianglesCollapsed = 0;
+		int CollapseCount = 0;
+		for(unsigned int c=0;c<CollapseOrder.size() && TrianglesCollapsed < TriangleGoal;c++)
+		{
+			const EdgeCollapse& Collapse = Collapses[CollapseOrder[c]];
+			if(Collapse.Error > ErrorLimit)
+				break;
+
+			const unsigned int v0 = Collapse.V0, v1 = Collapse.V1;
+			const unsigned int r0 = Remap[v0], r1 = Remap[v1];
+			// one collapse per vertex and pass, the quadrics and adjacency would go stale otherwise
+			if(CollapseLocked[r0] || CollapseLocked[r1])
+				continue;
+			if(HasTriangleFlips(Adjacency, UnitPositions, Remap, CollapseRemap, r0, r1))
+				continue;
+
+			if(Kind[v0] == VertexSeam)
+			{
+				// the other side of the seam moves along with it
+				const unsigned int s0 = Wedge[v0];
+				const unsigned int s1 = Loop[v0] == v1 ? LoopBack[s0] : Loop[s0];
+				if(s0 == v0 || s1 == INVALID_VERTEX || Remap[s1] != r1)
+					continue;
+				CollapseRemap[v0] = v1;
+				CollapseRemap[s0] = s1;
+			}
+			else
+			{
+				CollapseRemap[v0] = v1;
+			}
+
+			QuadricAdd(Quadrics[r1], Quadrics[r0]);
+			CollapseLocked[r0] = 1;
+			CollapseLocked[r1] = 1;
+			TrianglesCollapsed += Kind[v0] == VertexBorder ? 1 : 2;
+			CollapseCount++;
+			ResultError = Math::Max<float>(ResultError, Collapse.Error);
+		}
+		if(CollapseCount == 0)
+			break;
+
+		// keep the open edge loops pointing at live vertices
+		for(int v=0;v<VertexCount;v++)
+		{
+			if(Loop[v] != INVALID_VERTEX)
+			{
+				const unsigned int l = Loop[v];
+				const unsigned int r = CollapseRemap[l];
+				Loop[v] = r == (unsigned int)v ? (Loop[l] != INVALID_VERTEX ? CollapseRemap[Loop[l]] : INVALID_VERTEX) : r;
+			}
+			if(LoopBack[v] != INVALID_VERTEX)
+			{
+				const unsigned int l = LoopBack[v];
+				const unsigned int r = CollapseRemap[l];
+				LoopBack[v] = r == (unsigned int)v ? (LoopBack[l] != INVALID_VERTEX ? CollapseRemap[LoopBack[l]] : INVALID_VERTEX) : r;
+			}
+		}
+
+		int WriteCount = 0;
+		for(int i=0;i<ResultCount;i+=3)
+		{
+			const unsigned int i0 = CollapseRemap[OutIndices[i]];
+			const unsigned int i1 = CollapseRemap[OutIndices[i + 1]];
+			const unsigned int i2 = CollapseRemap[OutIndices[i + 2]];
+			if(Remap[i0] == Remap[i1] || Remap[i1] == Remap[i2] || Remap[i2] == Remap[i0])
+				continue;
+			OutIndices[WriteCount++] = i0;
+			OutIndices[WriteCount++] = i1;
+			OutIndices[WriteCount++] = i2;
+		}
+		ResultCount = WriteCount;
+	}
+
+	OutError = sqrtf(ResultError);
+	return ResultCount;
+}
+
+void MeshSimplifier::SortVerticesByLOD( const std::vector<const unsigned int*>& LODIndices, const std::vector<int>& LODIndexCount,
+	int VertexCount, std::vector<unsigned int>& OutRemap, std::vector<unsigned int>& OutVertexCount )
+{
+	const int LODCount = LODIndices.size();
+	std::vector<int> CoarsestLOD(VertexCount, -1);
+	for(int LODIndex=0;LODIndex<LODCount;LODIndex++)
+	{
+		for(int i=0;i<LODIndexCount[LODIndex];i++)
+			CoarsestLOD[LODIndices[LODIndex][i]] = LODIndex;
+	}
+
+	OutRemap.resize(VertexCount);
+	OutVertexCount.assign(LODCount, 0);
+	unsigned int NextVertex = 0;
+	for(int LODIndex=LODCount-1;LODIndex>=0;LODIndex--)
+	{
+		for(int v=0;v<VertexCount;v++)
+		{
+			if(CoarsestLOD[v] == LODIndex)
+				OutRemap[v] = NextVertex++;
+		}
+		OutVertexCount[LODIndex] = NextVertex;
+	}
+
+	// vertices no lod references stay at the end
+	for(int v=0;v<VertexCount;v++)
+	{
+		if(CoarsestLOD[v] < 0)
+			OutRemap[v] = NextVertex++;
+	}
+}
+
+float MeshSimplifier::ComputeLODScreenSize( float Error, float Radius )
+{
+	if(Error <= 0.f)
+		return FLOAT_MAX;
+	return 2.f * Radius * LOD_PIXEL_ERROR / (Error * LOD_REFERENCE_HEIGHT);
+}
+
+float MeshSimplifier::ComputeScreenSize( const XMFLOAT3& Center, float Radius, const XMMATRIX& ViewMat, const XMMATRIX& ProjectionMat )
+{
+	XMVECTOR ViewCenter = XMVector3Transform(XMLoadFloat3(&Center), ViewMat);
+	XMVECTOR ClipCenter = XMVector4Transform(XMVectorSetW(ViewCenter, 1.f), ProjectionMat);
+
+	// the camera is inside the sphere, always full detail
+	const bool bPerspective = ProjectionMat._34 != 0.f;
+	if(bPerspective && XMVectorGetX(XMVector3Length(ViewCenter)) <= Radius)
+		return FLOAT_MAX;
+
+	// clip w is the view depth for a perspective projection and 1 for an orthographic one
+	const float W = fabsf(XMVectorGetW(ClipCenter));
+	if(W <= 0.f)
+		return FLOAT_MAX;
+	return Radius * ProjectionMat._22 / W;
+}
+
+int MeshSimplifier::SelectLOD( const std::vector<MeshLOD>& LODArray, float ScreenSize )
+{
+	int LODIndex = 0;
+	while(LODIndex + 1 < (int)LODArray.size() && ScreenSize <= LODArray[LODIndex + 1].ScreenSize)
+		LODIndex++;
+	return LODIndex;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <d3d11.h>
+#include <xnamath.h>
+#include <vector>
+
+#define LOD_MAX_COUNT			4
+#define LOD_TRIANGLE_RATIO		0.5f	// each lod targets this fraction of the previous one
+#define LOD_MIN_REDUCTION		0.85f	// stop the chain once a lod keeps more than this of the previous one
+#define LOD_MAX_ERROR			0.05f	// relative to the mesh extent
+#define LOD_ATTRIBUTE_WEIGHT	0.001f	// squared normal/uv difference against squared relative distance
+#define LOD_PIXEL_ERROR			1.f		// a lod is used once its error projects under this many pixels
+#define LOD_REFERENCE_HEIGHT	1080.f	// at this view height
+
+// one level of detail. every lod shares the mesh vertex buffer and owns a range of the index buffer
+struct MeshLOD
+{
+	unsigned int	IndexOffset;
+	unsigned int	TriangleCount;
+	unsigned int	VertexCount;	// vertices are sorted coarse lod first, so a lod only reads [0, VertexCount)
+	float			ScreenSize;		// drawn while the bounding sphere covers at most this fraction of the view height
+	float			Error;			// simplification error in mesh units
+};
+
+// quadric error edge collapse, cpu only so the cooker can run it
+class MeshSimplifier
+{
+public:
+	// collapses edges of an indexed triangle list until TargetIndexCount is reached or the next collapse
+	// would exceed TargetError (relative to the extent of Positions). vertices never move, a collapse
+	// moves one vertex onto its neighbour, so the result indexes the same vertex arrays.
+	// vertices split on a normal or uv seam collapse in pairs along the seam, open borders only along the border.
+	// Attributes holds AttributeCount floats per vertex, their squared difference scaled by AttributeWeight
+	// is added to the cost. CollapseGroups is optional, vertices of different groups never merge.
+	// OutIndices needs IndexCount entries, returns the new index count. OutError is relative like TargetError.
+	static int Simplify(unsigned int* OutIndices, const unsigned int* Indices, int IndexCount,
+		const XMFLOAT3* Positions, int VertexCount, const float* Attributes, int AttributeCount, float AttributeWeight,
+		const unsigned int* CollapseGroups, int TargetIndexCount, float TargetError, float& OutError);
+
+	// renumbers vertices so the ones used by coarser lods come first, keeping the order inside each band.
+	// LODIndices[i] is the index range of lod i, OutVertexCount[i] the vertex prefix it needs.
+	static void SortVerticesByLOD(const std::vector<const unsigned int*>& LODIndices, const std::vector<int>& LODIndexCount,
+		int VertexCount, std::vector<unsigned int>& OutRemap, std::vector<unsigned int>& OutVertexCount);
+
+	// largest screen size where Error stays under LOD_PIXEL_ERROR pixels for a sphere of Radius
+	static float ComputeLODScreenSize(float Error, float Radius);
+
+	// projected diameter of the sphere over the view height, works for perspective and orthographic projections
+	static float ComputeScreenSize(const XMFLOAT3& Center, float Radius, const XMMATRIX& ViewMat, const XMMATRIX& ProjectionMat);
+
+	// coarsest lod whose ScreenSize still covers ScreenSize
+	static int SelectLOD(const std::vector<MeshLOD>& LODArray, float ScreenSize);
+};
@@ -0,0 +1,130 @@
+#include <algorithm>
+
+#include "MeshSource.h"
+
+template<class T>
+static void CopyLayerArray(const FbxLayerElementArrayTemplate<T>& Array, std::vector<T>& OutArray)
+{
+	const int Count = Array.GetCount();
+	OutArray.resize(Count);
+	if(Count == 0)
+		return;
+
+	FbxLayerElementArrayReadLock<T> Lock(const_cast<FbxLayerElementArrayTemplate<T>&>(Array));
+	if(Lock.GetData())
+		std::copy(Lock.GetData(), Lock.GetData() + Count, OutArray.begin());
+	else
+	{
+		for(int i=0;i<Count;i++)
+			OutArray[i] = Array.GetAt(i);
+	}
+}
+
+template<class T, class ElementType>
+static void CopyLayerElement(const ElementType* Element, MeshSourceElement<T>& OutElement)
+{
+	OutElement.Mapping = Element->GetMappingMode();
+	OutElement.Reference = Element->GetReferenceMode();
+	CopyLayerArray(Element->GetDirectArray(), OutElement.DirectArray);
+	if(OutElement.Reference != FbxGeometryElement::eDirect)
+		CopyLayerArray(Element->GetIndexArray(), OutElement.IndexArray);
+}
+
+MeshSource::MeshSource(void)
+	: _HasVertexCache(false)
+	, _HasLinearSkin(false)
+{
+}
+
+bool MeshSource::Extract( FbxMesh* Mesh, FbxScene* Scene )
+{
+	FbxNode* Node = Mesh->GetNode();
+	if (!Node)
+		return false;
+
+	_Name = Node->GetName();
+
+	//For Single Matrix situation, obtain transfrom matrix from eDESTINATION_SET, which include pivot offsets and pre/post rotations.
+	_GlobalTransform = Scene->GetEvaluator()->GetNodeGlobalTransform(Node);
+
+	if (!Mesh->IsTriangleMesh())
+	{
+		FbxGeometryConverter lConverter(Node->GetFbxManager());
+		bool bSuccess;
+		Mesh = lConverter.TriangulateMeshAdvance(Mesh, bSuccess);
+		if (!Mesh)
+			return false;
+	}
+
+	const int PolygonCount = Mesh->GetPolygonCount();
+	const int ControlPointCount = Mesh->GetControlPointsCount();
+	_ControlPoints.assign(Mesh->GetControlPoints(), Mesh->GetControlPoints() + ControlPointCount);
+
+	if (Mesh->GetPolygonVertexCount() == PolygonCount * 3)
+	{
+		const int* PolygonVertices = Mesh->GetPolygonVertices();
+		_PolygonVertices.assign(PolygonVertices, PolygonVertices + PolygonCount * 3);
+	}
+	else
+	{
+		_PolygonVertices.resize(PolygonCount * 3);
+		for (int PolygonIndex = 0; PolygonIndex < PolygonCount; ++PolygonIndex)
+		{
+			for (int VertexIndex = 0; VertexIndex < 3; ++VertexIndex)
+				_PolygonVertices[PolygonIndex * 3 + VertexIndex] = Mesh->GetPolygonVertex(PolygonIndex, VertexIndex);
+		}
+	}
+
+	FbxGeometryElementMaterial* ElementMaterial = Mesh->GetElementMaterial();
+	if (ElementMaterial && ElementMaterial->GetMappingMode() == FbxGeometryElement::eByPolygon)
+	{
+		std::vector<int> MaterialIndices;
+		CopyLayerArray(ElementMaterial->GetIndexArray(), MaterialIndices);
+		FBX_ASSERT((int)MaterialIndices.size() == PolygonCount);
+		if ((int)MaterialIndices.size() == PolygonCount)
+			_MaterialIndices.swap(MaterialIndices);
+	}
+
+	if (Mesh->GetElementNormalCount() > 0)
+		CopyLayerElement(Mesh->GetElementNormal(0), _Normals);
+
+	FbxStringList UVNames;
+	Mesh->GetUVSetNames(UVNames);
+	if (Mesh->GetElementUVCount() > 0 && UVNames.GetCount())
+		CopyLayerElement(Mesh->GetElementUV(UVNames[0]), _UVs);
+
+	_HasVertexCache = Mesh->GetDeformerCount(FbxDeformer::eVertexCache) &&
+		(static_cast<FbxVertexCacheDeformer*>(Mesh->GetDeformer(0, FbxDeformer::eVertexCache)))->IsActive();
+
+	const int SkinCount = Mesh->GetDeformerCount(FbxDeformer::eSkin);
+	if (SkinCount > 0)
+	{
+		FbxSkin::EType SkinningType = ((FbxSkin*)Mesh->GetDeformer(0, FbxDeformer::eSkin))->GetSkinningType();
+		_HasLinearSkin = SkinningType == FbxSkin::eLinear || SkinningType == FbxSkin::eRigid;
+	}
+
+	for (int SkinIndex = 0; SkinIndex < SkinCount; ++SkinIndex)
+	{
+		FbxSkin* SkinDeformer = (FbxSkin*)Mesh->GetDeformer(SkinIndex, FbxDeformer::eSkin);
+		const int ClusterCount = SkinDeformer->GetClusterCount();
+		for (int ClusterIndex = 0; ClusterIndex < ClusterCount; ++ClusterIndex)
+		{
+			FbxCluster* Cluster = SkinDeformer->GetCluster(ClusterIndex);
+			if (!Cluster->GetLink())
+				continue;
+
+			_Clusters.push_back(MeshSourceCluster());
+			MeshSourceCluster& SourceCluster = _Clusters.back();
+			SourceCluster.BoneName = Cluster->GetLink()->GetName();
+
+			const int IndexCount = Cluster->GetControlPointIndicesCount();
+			if (IndexCount > 0)
+			{
+				SourceCluster.ControlPointIndices.assign(Cluster->GetControlPointIndices(), Cluster->GetControlPointIndices() + IndexCount);
+				SourceCluster.Weights.assign(Cluster->GetControlPointWeights(), Cluster->GetControlPointWeights() + IndexCount);
+			}
+		}
+	}
+
+	return true;
+}
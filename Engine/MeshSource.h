@@ -0,0 +1,75 @@
+#pragma once
+#include <fbxsdk.h>
+#include <string>
+#include <vector>
+
+// layer element copied out of the fbx scene, readable from worker threads
+template<class T>
+struct MeshSourceElement
+{
+	FbxGeometryElement::EMappingMode	Mapping;
+	FbxGeometryElement::EReferenceMode	Reference;
+	std::vector<T>						DirectArray;
+	std::vector<int>					IndexArray;
+
+	MeshSourceElement()
+		: Mapping(FbxGeometryElement::eNone)
+		, Reference(FbxGeometryElement::eDirect)
+	{
+	}
+
+	bool IsValid() const
+	{
+		return Mapping != FbxGeometryElement::eNone && DirectArray.size() != 0;
+	}
+
+	const T& GetAt(int ElementIndex) const
+	{
+		if(Reference != FbxGeometryElement::eDirect)
+			ElementIndex = IndexArray[ElementIndex];
+		return DirectArray[ElementIndex];
+	}
+
+	// same lookup as FbxMesh::GetPolygonVertexNormal/GetPolygonVertexUV
+	const T& GetCorner(int ControlPointIndex, int PolygonIndex, int CornerIndex) const
+	{
+		switch(Mapping)
+		{
+		case FbxGeometryElement::eByControlPoint:	return GetAt(ControlPointIndex);
+		case FbxGeometryElement::eByPolygon:		return GetAt(PolygonIndex);
+		case FbxGeometryElement::eAllSame:			return GetAt(0);
+		default:									return GetAt(CornerIndex);
+		}
+	}
+};
+
+struct MeshSourceCluster
+{
+	std::string			BoneName;
+	std::vector<int>	ControlPointIndices;
+	std::vector<double>	Weights;
+};
+
+// raw triangulated mesh data bulk-copied from the fbx scene in a serial pass.
+// the sdk is not thread-safe, so everything after extraction reads only this.
+class MeshSource
+{
+public:
+	std::string						_Name;
+	FbxAMatrix						_GlobalTransform;
+	std::vector<FbxVector4>			_ControlPoints;
+	std::vector<int>				_PolygonVertices;	// 3 control point indices per triangle
+	std::vector<int>				_MaterialIndices;	// per triangle, empty when one material covers the mesh
+	MeshSourceElement<FbxVector4>	_Normals;
+	MeshSourceElement<FbxVector2>	_UVs;
+
+	bool							_HasVertexCache;
+	bool							_HasLinearSkin;
+	std::vector<MeshSourceCluster>	_Clusters;
+
+	int GetPolygonCount() const {return (int)_PolygonVertices.size() / 3;}
+
+	bool Extract(FbxMesh* Mesh, FbxScene* Scene);
+
+	MeshSource(void);
+};
@@ -1,4 +1,5 @@
 #include "MeshVertexShader.h"
+#include "ShaderRes.h"
 
 
 MeshVertexShader::MeshVertexShader( char* szFileName, char* szFuncName)
@@ -18,11 +19,12 @@ MeshVertexShader::~MeshVertexShader(void)
 	}
 }
 
-void MeshVertexShader::SetShader(EMeshType MeshType, int NumTexcoord )
+void MeshVertexShader::SetShader(EMeshType MeshType, int NumTexcoord, bool Compressed )
 {
 	VertexShaderKey Key;
 	Key.MeshType = MeshType;
 	Key.NumTexcoord = NumTexcoord;
+	Key.Compressed = Compressed;
 
 	VertexShaderRes* pShaderRes = GetShaderRes(Key);
 	pShaderRes->SetShader();
@@ -69,6 +71,17 @@ VertexShaderRes::VertexShaderRes( const char* FileName, const char* FuncName, Ve
 		Defines.push_back(Define);
 	}
 
+	if(SKey.Compressed)
+	{
+		D3D10_SHADER_MACRO Define = {"COMPRESSED", "1"};
+		Defines.push_back(Define);
+	}
+	else
+	{
+		D3D10_SHADER_MACRO Define = {"COMPRESSED", "0"};
+		Defines.push_back(Define);
+	}
+
 	D3D10_SHADER_MACRO Define;
 	memset(&Define, 0, sizeof(D3D10_SHADER_MACRO));
 	Defines.push_back(Define);
@@ -98,71 +111,12 @@ VertexShaderRes::VertexShaderRes( const char* FileName, const char* FuncName, Ve
 		assert(false);
 	}
 
-	if(SKey.NumTexcoord == 0)
-	{
-		if(SKey.MeshType == Static)
-		{
-			D3D11_INPUT_ELEMENT_DESC layout[] =
-			{
-				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			};
-			UINT numElements = ARRAYSIZE( layout );
-
-			// Create the input layout
-			hr = GEngine->_Device->CreateInputLayout( layout, numElements, pVSBlob->GetBufferPointer(),
-				pVSBlob->GetBufferSize(), &_VertexLayout );
-		}
-		else if(SKey.MeshType == GpuSkin)
-		{
-			D3D11_INPUT_ELEMENT_DESC layout[] =
-			{
-				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "WEIGHTS", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "BONES", 0, DXGI_FORMAT_R8G8B8A8_UINT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			};
-			UINT numElements = ARRAYSIZE( layout );
-
-			// Create the input layout
-			hr = GEngine->_Device->CreateInputLayout( layout, numElements, pVSBlob->GetBufferPointer(),
-				pVSBlob->GetBufferSize(), &_VertexLayout );
-		}
-	}
-	else if(SKey.NumTexcoord == 1)
-	{
-		if(SKey.MeshType == Static)
-		{
-			D3D11_INPUT_ELEMENT_DESC layout[] =
-			{
-				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			};
-			UINT numElements = ARRAYSIZE( layout );
-
-			// Create the input layout
-			hr = GEngine->_Device->CreateInputLayout( layout, numElements, pVSBlob->GetBufferPointer(),
-				pVSBlob->GetBufferSize(), &_VertexLayout );
-		}
-		else if(SKey.MeshType == GpuSkin)
-		{
-			D3D11_INPUT_ELEMENT_DESC layout[] =
-			{
-				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "WEIGHTS", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "BONES", 0, DXGI_FORMAT_R8G8B8A8_UINT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			};
-			UINT numElements = ARRAYSIZE( layout );
-
-			// Create the input layout
-			hr = GEngine->_Device->CreateInputLayout( layout, numElements, pVSBlob->GetBufferPointer(),
-				pVSBlob->GetBufferSize(), &_VertexLayout );
-		}
-	}
+	std::vector<D3D11_INPUT_ELEMENT_DESC> Layout;
+	GetMeshInputLayout(SKey.NumTexcoord, SKey.MeshType == GpuSkin, SKey.Compressed, Layout);
 
+	// Create the input layout
+	hr = GEngine->_Device->CreateInputLayout( &Layout[0], Layout.size(), pVSBlob->GetBufferPointer(),
+		pVSBlob->GetBufferSize(), &_VertexLayout );
 
 	pVSBlob->Release();
 	if( FAILED( hr ) )
@@ -14,6 +14,7 @@ struct VertexShaderKey
 {
 	EMeshType MeshType;
 	int NumTexcoord;
+	bool Compressed;
 	bool operator<(const VertexShaderKey& other) const        
 	{             
 		if( NumTexcoord < other.NumTexcoord ) return true;
@@ -22,6 +23,9 @@ struct VertexShaderKey
 		if( MeshType < other.MeshType ) return true;
 		if( MeshType > other.MeshType ) return false;
 
+		if( Compressed < other.Compressed ) return true;
+		if( Compressed > other.Compressed ) return false;
+
 		return false;
 	};
 };
@@ -44,7 +48,7 @@ class MeshVertexShader :
 	std::map<VertexShaderKey, VertexShaderRes*> _ShaderMap;
 public:
 	VertexShaderRes* GetShaderRes(VertexShaderKey& Key);
-	void SetShader(EMeshType MeshType, int NumTexcoord);
+	void SetShader(EMeshType MeshType, int NumTexcoord, bool Compressed);
 	void SetShaderParameter();
 
 	MeshVertexShader( char* szFileName, char* szFuncName);
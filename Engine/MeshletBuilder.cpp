@@ -0,0 +1,169 @@
+#include <math.h>
+
+#include "MeshletBuilder.h"
+#include "MathUtil.h"
+
+void MeshletBuilder::BuildClusters( const unsigned int* Indices, unsigned int IndexOffset, unsigned int TriangleCount,
+	const XMFLOAT3* Positions, unsigned int VertexCount, std::vector<MeshCluster>& OutClusterArray )
+{
+	if(TriangleCount == 0)
+		return;
+
+	// stamp of the cluster that last used each vertex, avoids clearing a set per cluster
+	std::vector<unsigned int> VertexStamp(VertexCount, 0);
+	unsigned int Stamp = 1;
+	unsigned int ClusterVertexCount = 0;
+
+	MeshCluster Cluster;
+	Cluster.IndexOffset = IndexOffset;
+	Cluster.TriangleCount = 0;
+
+	for(unsigned int t=0;t<TriangleCount;t++)
+	{
+		const unsigned int* Tri = Indices + IndexOffset + t * 3;
+		unsigned int NewVertices = 0;
+		for(int k=0;k<3;k++)
+		{
+			if(VertexStamp[Tri[k]] != Stamp && (k < 1 || Tri[k] != Tri[0]) && (k < 2 || Tri[k] != Tri[1]))
+				NewVertices++;
+		}
+
+		if(ClusterVertexCount + NewVertices > MESHLET_MAX_VERTICES || Cluster.TriangleCount == MESHLET_MAX_TRIANGLES)
+		{
+			ComputeClusterBounds(Indices, Positions, Cluster);
+			OutClusterArray.push_back(Cluster);
+
+			Cluster.IndexOffset += Cluster.TriangleCount * 3;
+			Cluster.TriangleCount = 0;
+			ClusterVertexCount = 0;
+			Stamp++;
+		}
+
+		for(int k=0;k<3;k++)
+		{
+			if(VertexStamp[Tri[k]] != Stamp)
+			{
+				VertexStamp[Tri[k]] = Stamp;
+				ClusterVertexCount++;
+			}
+		}
+		Cluster.TriangleCount++;
+	}
+
+	ComputeClusterBounds(Indices, Positions, Cluster);
+	OutClusterArray.push_back(Cluster);
+}
+
+void MeshletBuilder::ComputeClusterBounds( const unsigned int* Indices, const XMFLOAT3* Positions, MeshCluster& Cluster )
+{
+	const unsigned int* ClusterIndices = Indices + Cluster.IndexOffset;
+	const unsigned int IndexCount = Cluster.TriangleCount * 3;
+
+	Cluster.AABBMin = XMFLOAT3(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX);
+	Cluster.AABBMax = XMFLOAT3(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX);
+	for(unsigned int i=0;i<IndexCount;i++)
+	{
+		const XMFLOAT3& Pos = Positions[ClusterIndices[i]];
+		Cluster.AABBMin.x = Math::Min<float>(Cluster.AABBMin.x, Pos.x);
+		Cluster.AABBMin.y = Math::Min<float>(Cluster.AABBMin.y, Pos.y);
+		Cluster.AABBMin.z = Math::Min<float>(Cluster.AABBMin.z, Pos.z);
+		Cluster.AABBMax.x = Math::Max<float>(Cluster.AABBMax.x, Pos.x);
+		Cluster.AABBMax.y = Math::Max<float>(Cluster.AABBMax.y, Pos.y);
+		Cluster.AABBMax.z = Math::Max<float>(Cluster.AABBMax.z, Pos.z);
+	}
+
+	const XMFLOAT3 Center((Cluster.AABBMin.x + Cluster.AABBMax.x) * 0.5f,
+		(Cluster.AABBMin.y + Cluster.AABBMax.y) * 0.5f,
+		(Cluster.AABBMin.z + Cluster.AABBMax.z) * 0.5f);
+	float RadiusSq = 0.f;
+	for(unsigned int i=0;i<IndexCount;i++)
+	{
+		const XMFLOAT3& Pos = Positions[ClusterIndices[i]];
+		const float dx = Pos.x - Center.x, dy = Pos.y - Center.y, dz = Pos.z - Center.z;
+		RadiusSq = Math::Max<float>(RadiusSq, dx*dx + dy*dy + dz*dz);
+	}
+	Cluster.SphereCenter = Center;
+	Cluster.SphereRadius = sqrtf(RadiusSq);
+
+	// normal cone from the average of the triangle normals
+	std::vector<XMFLOAT3> NormalArray;
+	NormalArray.reserve(Cluster.TriangleCount);
+	XMFLOAT3 Axis(0.f, 0.f, 0.f);
+	for(unsigned int t=0;t<Cluster.TriangleCount;t++)
+	{
+		const XMFLOAT3& P0 = Positions[ClusterIndices[t*3]];
+		const XMFLOAT3& P1 = Positions[ClusterIndices[t*3+1]];
+		const XMFLOAT3& P2 = Positions[ClusterIndices[t*3+2]];
+		const XMFLOAT3 E1(P1.x - P0.x, P1.y - P0.y, P1.z - P0.z);
+		const XMFLOAT3 E2(P2.x - P0.x, P2.y - P0.y, P2.z - P0.z);
+		XMFLOAT3 N(E1.y*E2.z - E1.z*E2.y, E1.z*E2.x - E1.x*E2.z, E1.x*E2.y - E1.y*E2.x);
+		const float Length = sqrtf(N.x*N.x + N.y*N.y + N.z*N.z);
+		if(Length <= 0.f)
+		{
+			// degenerate triangles are never visible, they don't constrain the cone
+			NormalArray.push_back(XMFLOAT3(0.f, 0.f, 0.f));
+			continue;
+		}
+		N.x /= Length; N.y /= Length; N.z /= Length;
+		NormalArray.push_back(N);
+		Axis.x += N.x; Axis.y += N.y; Axis.z += N.z;
+	}
+
+	Cluster.ConeApex = Center;
+	Cluster.ConeAxis = XMFLOAT3(0.f, 0.f, 0.f);
+	Cluster.ConeCutoff = 1.f;
+
+	const float AxisLength = sqrtf(Axis.x*Axis.x + Axis.y*Axis.y + Axis.z*Axis.z);
+	if(AxisLength <= 0.f)
+		return;
+	Axis.x /= AxisLength; Axis.y /= AxisLength; Axis.z /= AxisLength;
+
+	float MinDot = 1.f;
+	for(unsigned int t=0;t<Cluster.TriangleCount;t++)
+	{
+		const XMFLOAT3& N = NormalArray[t];
+		if(N.x == 0.f && N.y == 0.f && N.z == 0.f)
+			continue;
+		MinDot = Math::Min<float>(MinDot, N.x*Axis.x + N.y*Axis.y + N.z*Axis.z);
+	}
+
+	// close to a hemisphere of normals, the cone test would never pass
+	if(MinDot <= 0.1f)
+		return;
+
+	// move the apex back along the axis until every triangle plane is in front of it
+	float MaxT = 0.f;
+	for(unsigned int t=0;t<Cluster.TriangleCount;t++)
+	{
+		const XMFLOAT3& N = NormalArray[t];
+		const float AxisDot = N.x*Axis.x + N.y*Axis.y + N.z*Axis.z;
+		if(AxisDot <= 0.f)
+			continue;
+		const XMFLOAT3& P0 = Positions[ClusterIndices[t*3]];
+		const float PlaneDist = (Center.x - P0.x)*N.x + (Center.y - P0.y)*N.y + (Center.z - P0.z)*N.z;
+		MaxT = Math::Max<float>(MaxT, PlaneDist / AxisDot);
+	}
+
+	Cluster.ConeApex = XMFLOAT3(Center.x - Axis.x * MaxT, Center.y - Axis.y * MaxT, Center.z - Axis.z * MaxT);
+	Cluster.ConeAxis = Axis;
+	Cluster.ConeCutoff = sqrtf(1.f - MinDot * MinDot);
+}
+
+bool MeshletBuilder::IsBackfacing( const MeshCluster& Cluster, const XMFLOAT3& CameraPosition )
+{
+	const XMFLOAT3 Dir(Cluster.ConeApex.x - CameraPosition.x, Cluster.ConeApex.y - CameraPosition.y, Cluster.ConeApex.z - CameraPosition.z);
+	const float Length = sqrtf(Dir.x*Dir.x + Dir.y*Dir.y + Dir.z*Dir.z);
+	const float Dot = Dir.x*Cluster.ConeAxis.x + Dir.y*Cluster.ConeAxis.y + Dir.z*Cluster.ConeAxis.z;
+	return Dot >= Cluster.ConeCutoff * Length && Length > 0.f;
+}
+
+bool MeshletBuilder::IsOutsidePlanes( const MeshCluster& Cluster, const XMFLOAT4* Planes, int NumPlanes )
+{
+	const XMFLOAT3& C = Cluster.SphereCenter;
+	for(int i=0;i<NumPlanes;i++)
+	{
+		if(Planes[i].x * C.x + Planes[i].y * C.y + Planes[i].z * C.z + Planes[i].w < -Cluster.SphereRadius)
+			return true;
+	}
+	return false;
+}
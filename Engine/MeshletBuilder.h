@@ -0,0 +1,42 @@
+#pragma once
+#include "MathTypes.h"
+#include <vector>
+
+#define MESHLET_MAX_VERTICES	64
+#define MESHLET_MAX_TRIANGLES	124
+
+// a contiguous run of triangles in the mesh index buffer with its own bounds
+struct MeshCluster
+{
+	unsigned int	IndexOffset;
+	unsigned int	TriangleCount;
+	XMFLOAT3		AABBMin;
+	XMFLOAT3		AABBMax;
+	XMFLOAT3		SphereCenter;
+	float			SphereRadius;
+
+	// every triangle faces away from a viewer inside the cone at ConeApex.
+	// ConeCutoff of 1 means the normals spread too much to ever cull.
+	XMFLOAT3		ConeApex;
+	XMFLOAT3		ConeAxis;
+	float			ConeCutoff;
+};
+
+// cpu only, so clusters can be built by the cooker and tested without a device
+class MeshletBuilder
+{
+public:
+	// splits the triangles of one submesh into clusters of at most MESHLET_MAX_VERTICES unique vertices
+	// and MESHLET_MAX_TRIANGLES triangles. triangles are taken in index order, so run this after the
+	// vertex cache optimization to get compact clusters without undoing it.
+	static void BuildClusters(const unsigned int* Indices, unsigned int IndexOffset, unsigned int TriangleCount,
+		const XMFLOAT3* Positions, unsigned int VertexCount, std::vector<MeshCluster>& OutClusterArray);
+
+	static void ComputeClusterBounds(const unsigned int* Indices, const XMFLOAT3* Positions, MeshCluster& Cluster);
+
+	// true when no triangle of the cluster can face CameraPosition
+	static bool IsBackfacing(const MeshCluster& Cluster, const XMFLOAT3& CameraPosition);
+
+	// planes are (normal, d) with the inside at dot(normal, p) + d >= 0
+	static bool IsOutsidePlanes(const MeshCluster& Cluster, const XMFLOAT4* Planes, int NumPlanes);
+};
@@ -0,0 +1,652 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "OcclusionCuller.h"
+#include "MathUtil.h"
+#include "ParallelFor.h"
+
+#if defined(OCCLUSION_SSE)
+#include <emmintrin.h>
+#endif
+#if defined(OCCLUSION_AVX)
+#include <immintrin.h>
+#endif
+
+#define OCCLUSION_TILE_COLUMNS	(OCCLUSION_BUFFER_WIDTH / OCCLUSION_TILE_WIDTH)
+#define OCCLUSION_TILE_ROWS		(OCCLUSION_BUFFER_HEIGHT / OCCLUSION_TILE_HEIGHT)
+
+OcclusionCuller::OcclusionCuller()
+	:_LevelCount(0)
+{
+	int Size = 0;
+	for(int l=0;l<OCCLUSION_MAX_LEVELS;l++)
+	{
+		_LevelOffset[l] = Size;
+		Size += GetLevelWidth(l) * GetLevelHeight(l);
+		_LevelCount++;
+		if(GetLevelWidth(l) == 1 && GetLevelHeight(l) == 1)
+			break;
+	}
+	_DepthArray.resize(Size, 1.f);
+	_BinArray.resize(OCCLUSION_TILE_COLUMNS * OCCLUSION_TILE_ROWS);
+	XMStoreFloat4x4(&_ViewProjection, XMMatrixIdentity());
+	memset(&_Stats, 0, sizeof(_Stats));
+}
+
+EOcclusionSimd OcclusionCuller::GetBestSimd()
+{
+#if defined(OCCLUSION_AVX)
+	return OCCLUSION_AVX8;
+#elif defined(OCCLUSION_SSE)
+	return OCCLUSION_SSE4;
+#else
+	return OCCLUSION_SCALAR;
+#endif
+}
+
+static bool IsPositionLess(const XMFLOAT3* Positions, unsigned int A, unsigned int B)
+{
+	const XMFLOAT3& PA = Positions[A];
+	const XMFLOAT3& PB = Positions[B];
+	if(PA.x != PB.x) return PA.x < PB.x;
+	if(PA.y != PB.y) return PA.y < PB.y;
+	return PA.z < PB.z;
+}
+
+static XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+static XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return XMFLOAT3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+}
+
+static float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return a.x*b.x + a.y*b.y + a.z*b.z;
+}
+
+// the triangles around V each turned to (V, From[i], To[i]), and the vertices around V in winding order.
+// false unless they make a single fan, closed inside the mesh or open on a border
+static bool GetVertexRing(const std::vector<unsigned int>& Triangles, const unsigned int* Incident, int IncidentCount, unsigned int V,
+	std::vector<unsigned int>& OutFrom, std::vector<unsigned int>& OutTo, std::vector<unsigned int>& OutRing, bool& bOutBorder)
+{
+	OutFrom.resize(IncidentCount);
+	OutTo.resize(IncidentCount);
+	for(int i=0;i<IncidentCount;i++)
+	{
+		const unsigned int* Tri = &Triangles[Incident[i] * 3];
+		const int k = Tri[0] == V ? 0 : (Tri[1] == V ? 1 : 2);
+		OutFrom[i] = Tri[(k + 1) % 3];
+		OutTo[i] = Tri[(k + 2) % 3];
+	}
+
+	// a border fan starts at the one edge nothing comes into
+	int Start = 0;
+	int StartCount = 0;
+	for(int i=0;i<IncidentCount;i++)
+	{
+		bool bHasIn = false;
+		for(int j=0;j<IncidentCount;j++)
+		{
+			if(i != j && OutFrom[i] == OutFrom[j])
+				return false;
+			bHasIn = bHasIn || OutTo[j] == OutFrom[i];
+		}
+		if(!bHasIn)
+		{
+			Start = i;
+			StartCount++;
+		}
+	}
+	if(StartCount > 1)
+		return false;
+	bOutBorder = StartCount == 1;
+
+	OutRing.clear();
+	unsigned int Current = OutFrom[Start];
+	for(int Step=0;Step<IncidentCount;Step++)
+	{
+		OutRing.push_back(Current);
+		int Next = -1;
+		for(int i=0;i<IncidentCount && Next == -1;i++)
+		{
+			if(OutFrom[i] == Current)
+				Next = i;
+		}
+		if(Next == -1)
+			return false;
+		Current = OutTo[Next];
+	}
+	if(bOutBorder)
+		OutRing.push_back(Current);
+	else if(Current != OutRing[0])
+		return false;
+	return true;
+}
+
+void OcclusionCuller::BuildOccluder( const unsigned int* Indices, int IndexCount, const XMFLOAT3* Positions, int VertexCount,
+	std::vector<XMFLOAT3>& OutPositions, std::vector<unsigned int>& OutIndices )
+{
+	OutPositions.clear();
+	OutIndices.clear();
+	if(IndexCount < 3 || VertexCount == 0)
+		return;
+
+	// vertices split on normal or uv seams are one for depth
+	std::vector<unsigned int> Sorted(VertexCount);
+	for(int i=0;i<VertexCount;i++)
+		Sorted[i] = i;
+	std::sort(Sorted.begin(), Sorted.end(), [&](unsigned int A, unsigned int B) { return IsPositionLess(Positions, A, B); });
+	std::vector<unsigned int> Weld(VertexCount);
+	std::vector<XMFLOAT3> WeldedPositions;
+	for(int i=0;i<VertexCount;i++)
+	{
+		if(i == 0 || IsPositionLess(Positions, Sorted[i - 1], Sorted[i]))
+			WeldedPositions.push_back(Positions[Sorted[i]]);
+		Weld[Sorted[i]] = WeldedPositions.size() - 1;
+	}
+
+	std::vector<unsigned int> Welded;
+	for(int i=0;i+2<IndexCount;i+=3)
+	{
+		const unsigned int A = Weld[Indices[i]];
+		const unsigned int B = Weld[Indices[i + 1]];
+		const unsigned int C = Weld[Indices[i + 2]];
+		if(A == B || B == C || C == A)
+			continue;
+		Welded.push_back(A);
+		Welded.push_back(B);
+		Welded.push_back(C);
+	}
+	if(Welded.empty())
+		return;
+
+	XMFLOAT3 Min(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX);
+	XMFLOAT3 Max(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX);
+	for(unsigned int v=0;v<WeldedPositions.size();v++)
+	{
+		Min.x = Math::Min<float>(Min.x, WeldedPositions[v].x); Max.x = Math::Max<float>(Max.x, WeldedPositions[v].x);
+		Min.y = Math::Min<float>(Min.y, WeldedPositions[v].y); Max.y = Math::Max<float>(Max.y, WeldedPositions[v].y);
+		Min.z = Math::Min<float>(Min.z, WeldedPositions[v].z); Max.z = Math::Max<float>(Max.z, WeldedPositions[v].z);
+	}
+	const float Tolerance = OCCLUDER_PLANE_TOLERANCE * Math::Max<float>(Max.x - Min.x, Math::Max<float>(Max.y - Min.y, Max.z - Min.z));
+
+	// a vertex whose fan is flat (and whose border edges are straight) moves onto a neighbour when every triangle
+	// left around it still faces the same way. the new fan then tiles the same polygon, the surface stays where it was.
+	// one collapse per neighbourhood and pass, the adjacency is rebuilt between passes
+	const int VertexCountWelded = WeldedPositions.size();
+	const XMFLOAT3* P = &WeldedPositions[0];
+	std::vector<unsigned int> Offsets;
+	std::vector<unsigned int> Incident;
+	std::vector<unsigned char> Locked;
+	std::vector<unsigned char> Removed;
+	std::vector<unsigned int> From, To, Ring, Candidates;
+	while(Welded.size() > OCCLUDER_MAX_TRIANGLES * 3)
+	{
+		const int TriangleCount = Welded.size() / 3;
+		Offsets.assign(VertexCountWelded + 1, 0);
+		for(unsigned int i=0;i<Welded.size();i++)
+			Offsets[Welded[i] + 1]++;
+		for(int v=0;v<VertexCountWelded;v++)
+			Offsets[v + 1] += Offsets[v];
+		Incident.resize(Welded.size());
+		std::vector<unsigned int> Fill(Offsets.begin(), Offsets.end() - 1);
+		for(unsigned int i=0;i<Welded.size();i++)
+			Incident[Fill[Welded[i]]++] = i / 3;
+
+		Locked.assign(VertexCountWelded, 0);
+		Removed.assign(TriangleCount, 0);
+		int LeftCount = TriangleCount;
+		int CollapseCount = 0;
+		for(int v=0;v<VertexCountWelded && LeftCount > OCCLUDER_MAX_TRIANGLES;v++)
+		{
+			const int FanCount = Offsets[v + 1] - Offsets[v];
+			if(Locked[v] || FanCount == 0)
+				continue;
+			bool bBorder;
+			if(!GetVertexRing(Welded, &Incident[Offsets[v]], FanCount, v, From, To, Ring, bBorder))
+				continue;
+			bool bRingLocked = false;
+			for(unsigned int r=0;r<Ring.size();r++)
+				bRingLocked = bRingLocked || Locked[Ring[r]];
+			if(bRingLocked)
+				continue;
+
+			XMFLOAT3 Normal(0.f, 0.f, 0.f);
+			for(int i=0;i<FanCount;i++)
+			{
+				const XMFLOAT3 N = Cross(Sub(P[From[i]], P[v]), Sub(P[To[i]], P[v]));
+				Normal.x += N.x; Normal.y += N.y; Normal.z += N.z;
+			}
+			const float Length = sqrtf(Dot(Normal, Normal));
+			if(Length <= 0.f)
+				continue;
+			Normal = XMFLOAT3(Normal.x / Length, Normal.y / Length, Normal.z / Length);
+
+			bool bFlat = true;
+			for(int i=0;i<FanCount && bFlat;i++)
+				bFlat = Dot(Cross(Sub(P[From[i]], P[v]), Sub(P[To[i]], P[v])), Normal) > 0.f;
+			for(unsigned int r=0;r<Ring.size() && bFlat;r++)
+				bFlat = fabsf(Dot(Sub(P[Ring[r]], P[v]), Normal)) <= Tolerance;
+			if(!bFlat)
+				continue;
+
+			Candidates.clear();
+			if(bBorder)
+			{
+				// only between its two border neighbours on a straight line, anywhere else the outline would change
+				const XMFLOAT3 ToFirst = Sub(P[Ring.front()], P[v]);
+				const XMFLOAT3 ToLast = Sub(P[Ring.back()], P[v]);
+				const XMFLOAT3 Line = Sub(P[Ring.back()], P[Ring.front()]);
+				const XMFLOAT3 Off = Cross(ToFirst, Line);
+				if(Dot(ToFirst, ToLast) >= 0.f || Dot(Off, Off) > Tolerance * Tolerance * Dot(Line, Line))
+					continue;
+				Candidates.push_back(Ring.front());
+				Candidates.push_back(Ring.back());
+			}
+			else
+			{
+				Candidates = Ring;
+			}
+
+			int Target = -1;
+			for(unsigned int c=0;c<Candidates.size() && Target == -1;c++)
+			{
+				const unsigned int u = Candidates[c];
+				bool bValid = true;
+				for(int i=0;i<FanCount && bValid;i++)
+				{
+					if(From[i] != u && To[i] != u)
+						bValid = Dot(Cross(Sub(P[From[i]], P[u]), Sub(P[To[i]], P[u])), Normal) > 0.f;
+				}
+				if(bValid)
+					Target = u;
+			}
+			if(Target == -1)
+				continue;
+
+			for(int i=0;i<FanCount;i++)
+			{
+				const unsigned int t = Incident[Offsets[v] + i];
+				if(From[i] == (unsigned int)Target || To[i] == (unsigned int)Target)
+				{
+					Removed[t] = 1;
+					LeftCount--;
+					continue;
+				}
+				for(int k=0;k<3;k++)
+				{
+					if(Welded[t * 3 + k] == (unsigned int)v)
+						Welded[t * 3 + k] = Target;
+				}
+			}
+			Locked[v] = 1;
+			for(unsigned int r=0;r<Ring.size();r++)
+				Locked[Ring[r]] = 1;
+			CollapseCount++;
+		}
+		if(CollapseCount == 0)
+			break;
+
+		int WriteCount = 0;
+		for(int t=0;t<TriangleCount;t++)
+		{
+			if(Removed[t])
+				continue;
+			Welded[WriteCount++] = Welded[t * 3];
+			Welded[WriteCount++] = Welded[t * 3 + 1];
+			Welded[WriteCount++] = Welded[t * 3 + 2];
+		}
+		Welded.resize(WriteCount);
+	}
+	// could never fit the frame budget
+	if(Welded.size() > OCCLUSION_MAX_TRIANGLES * 3)
+		return;
+
+	// only the vertices left in use
+	std::vector<int> Remap(WeldedPositions.size(), -1);
+	OutIndices.resize(Welded.size());
+	for(unsigned int i=0;i<Welded.size();i++)
+	{
+		const unsigned int Vertex = Welded[i];
+		if(Remap[Vertex] == -1)
+		{
+			Remap[Vertex] = OutPositions.size();
+			OutPositions.push_back(WeldedPositions[Vertex]);
+		}
+		OutIndices[i] = Remap[Vertex];
+	}
+}
+
+void OcclusionCuller::BeginFrame( const XMMATRIX& ViewProjection )
+{
+	XMStoreFloat4x4(&_ViewProjection, ViewProjection);
+	_TriangleArray.clear();
+	for(unsigned int i=0;i<_BinArray.size();i++)
+		_BinArray[i].clear();
+	memset(&_Stats, 0, sizeof(_Stats));
+}
+
+void OcclusionCuller::AddOccluder( const XMFLOAT3* Positions, int VertexCount, const unsigned int* Indices, int IndexCount )
+{
+	_Stats.OccluderCount++;
+
+	const XMMATRIX ViewProjection = XMLoadFloat4x4(&_ViewProjection);
+	_ClipArray.resize(VertexCount);
+	for(int i=0;i<VertexCount;i++)
+		XMStoreFloat4(&_ClipArray[i], XMVector3Transform(XMLoadFloat3(&Positions[i]), ViewProjection));
+
+	for(int i=0;i+2<IndexCount;i+=3)
+	{
+		const XMFLOAT4* Clip[3] = { &_ClipArray[Indices[i]], &_ClipArray[Indices[i + 1]], &_ClipArray[Indices[i + 2]] };
+		float X[3], Y[3], Z[3];
+		bool bNearClipped = false;
+		for(int v=0;v<3;v++)
+		{
+			// clipping would only add occlusion, the triangle is dropped instead
+			if(Clip[v]->z < 0.f || Clip[v]->w <= 0.f)
+			{
+				bNearClipped = true;
+				break;
+			}
+			const float InvW = 1.f / Clip[v]->w;
+			X[v] = (Clip[v]->x * InvW * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH;
+			Y[v] = (0.5f - Clip[v]->y * InvW * 0.5f) * OCCLUSION_BUFFER_HEIGHT;
+			Z[v] = Clip[v]->z * InvW;
+		}
+		if(bNearClipped)
+			continue;
+
+		// pixel centers inside the bounds
+		const int MinX = Math::Max<int>((int)ceilf(Math::Min<float>(X[0], Math::Min<float>(X[1], X[2])) - 0.5f), 0);
+		const int MinY = Math::Max<int>((int)ceilf(Math::Min<float>(Y[0], Math::Min<float>(Y[1], Y[2])) - 0.5f), 0);
+		const int MaxX = Math::Min<int>((int)floorf(Math::Max<float>(X[0], Math::Max<float>(X[1], X[2])) - 0.5f), OCCLUSION_BUFFER_WIDTH - 1);
+		const int MaxY = Math::Min<int>((int)floorf(Math::Max<float>(Y[0], Math::Max<float>(Y[1], Y[2])) - 0.5f), OCCLUSION_BUFFER_HEIGHT - 1);
+		if(MinX > MaxX || MinY > MaxY)
+			continue;
+
+		// both windings, edges turned so the inside is positive
+		const float Area = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+		if(fabsf(Area) < 1e-6f)
+			continue;
+		const float Sign = Area > 0.f ? 1.f : -1.f;
+
+		OcclusionTriangle Tri;
+		for(int e=0;e<3;e++)
+		{
+			const int a = e;
+			const int b = (e + 1) % 3;
+			// evaluated at pixel centers, x + 0.5 folded into C
+			Tri.EdgeA[e] = -(Y[b] - Y[a]) * Sign;
+			Tri.EdgeB[e] = (X[b] - X[a]) * Sign;
+			Tri.EdgeC[e] = ((Y[b] - Y[a]) * X[a] - (X[b] - X[a]) * Y[a]) * Sign + (Tri.EdgeA[e] + Tri.EdgeB[e]) * 0.5f;
+		}
+
+		// the depth plane, pushed back by its change over half a pixel so a center stands for the whole pixel.
+		// ZMax keeps the push inside the triangle's depth range
+		Tri.ZX = ((Z[1] - Z[0]) * (Y[2] - Y[0]) - (Z[2] - Z[0]) * (Y[1] - Y[0])) / Area;
+		Tri.ZY = ((Z[2] - Z[0]) * (X[1] - X[0]) - (Z[1] - Z[0]) * (X[2] - X[0])) / Area;
+		Tri.Z0 = Z[0] - Tri.ZX * X[0] - Tri.ZY * Y[0] + (Tri.ZX + Tri.ZY) * 0.5f + (fabsf(Tri.ZX) + fabsf(Tri.ZY)) * 0.5f;
+		Tri.ZMax = Math::Max<float>(Z[0], Math::Max<float>(Z[1], Z[2]));
+		Tri.MinX = MinX;
+		Tri.MinY = MinY;
+		Tri.MaxX = MaxX;
+		Tri.MaxY = MaxY;
+
+		const int Index = _TriangleArray.size();
+		_TriangleArray.push_back(Tri);
+		_Stats.TriangleCount++;
+		for(int ty=MinY/OCCLUSION_TILE_HEIGHT;ty<=MaxY/OCCLUSION_TILE_HEIGHT;ty++)
+		{
+			for(int tx=MinX/OCCLUSION_TILE_WIDTH;tx<=MaxX/OCCLUSION_TILE_WIDTH;tx++)
+			{
+				_BinArray[ty * OCCLUSION_TILE_COLUMNS + tx].push_back(Index);
+				_Stats.BinnedCount++;
+			}
+		}
+	}
+}
+
+// every path evaluates A * x + (B * y + C) per pixel in the same order, so they write the same depth to the bit
+static void RasterizeRowsScalar(const OcclusionTriangle& Tri, int X0, int Y0, int X1, int Y1, float* Depth)
+{
+	for(int y=Y0;y<=Y1;y++)
+	{
+		float* Row = Depth + y * OCCLUSION_BUFFER_WIDTH;
+		float RowEdge[3];
+		for(int e=0;e<3;e++)
+			RowEdge[e] = Tri.EdgeB[e] * y + Tri.EdgeC[e];
+		const float RowZ = Tri.ZY * y + Tri.Z0;
+		for(int x=X0;x<=X1;x++)
+		{
+			bool bInside = true;
+			for(int e=0;e<3;e++)
+				bInside = bInside && Tri.EdgeA[e] * x + RowEdge[e] >= 0.f;
+			if(bInside)
+				Row[x] = Math::Min<float>(Row[x], Math::Min<float>(Tri.ZX * x + RowZ, Tri.ZMax));
+		}
+	}
+}
+
+#if defined(OCCLUSION_SSE)
+// X0 is a multiple of 4 inside the tile, lanes past the triangle's bounds fail the edge test
+static void RasterizeRowsSse(const OcclusionTriangle& Tri, int X0, int Y0, int X1, int Y1, float* Depth)
+{
+	const __m128 Lane = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+	const __m128 Zero = _mm_setzero_ps();
+	const __m128 Four = _mm_set1_ps(4.f);
+	__m128 EdgeA[3];
+	for(int e=0;e<3;e++)
+		EdgeA[e] = _mm_set1_ps(Tri.EdgeA[e]);
+	const __m128 ZX = _mm_set1_ps(Tri.ZX);
+	const __m128 ZMax = _mm_set1_ps(Tri.ZMax);
+
+	for(int y=Y0;y<=Y1;y++)
+	{
+		float* Row = Depth + y * OCCLUSION_BUFFER_WIDTH;
+		__m128 RowEdge[3];
+		for(int e=0;e<3;e++)
+			RowEdge[e] = _mm_set1_ps(Tri.EdgeB[e] * y + Tri.EdgeC[e]);
+		const __m128 RowZ = _mm_set1_ps(Tri.ZY * y + Tri.Z0);
+
+		__m128 X = _mm_add_ps(_mm_set1_ps((float)X0), Lane);
+		for(int x=X0;x<=X1;x+=4)
+		{
+			const __m128 Inside = _mm_and_ps(_mm_and_ps(
+				_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(EdgeA[0], X), RowEdge[0]), Zero),
+				_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(EdgeA[1], X), RowEdge[1]), Zero)),
+				_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(EdgeA[2], X), RowEdge[2]), Zero));
+			if(_mm_movemask_ps(Inside))
+			{
+				const __m128 Z = _mm_add_ps(_mm_mul_ps(ZX, X), RowZ);
+				const __m128 Old = _mm_loadu_ps(Row + x);
+				const __m128 New = _mm_min_ps(Old, _mm_min_ps(Z, ZMax));
+				_mm_storeu_ps(Row + x, _mm_or_ps(_mm_and_ps(Inside, New), _mm_andnot_ps(Inside, Old)));
+			}
+			X = _mm_add_ps(X, Four);
+		}
+	}
+}
+#endif
+
+#if defined(OCCLUSION_AVX)
+// X0 is a multiple of 8 inside the tile
+static void RasterizeRowsAvx(const OcclusionTriangle& Tri, int X0, int Y0, int X1, int Y1, float* Depth)
+{
+	const __m256 Lane = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+	const __m256 Zero = _mm256_setzero_ps();
+	const __m256 Eight = _mm256_set1_ps(8.f);
+	__m256 EdgeA[3];
+	for(int e=0;e<3;e++)
+		EdgeA[e] = _mm256_set1_ps(Tri.EdgeA[e]);
+	const __m256 ZX = _mm256_set1_ps(Tri.ZX);
+	const __m256 ZMax = _mm256_set1_ps(Tri.ZMax);
+
+	for(int y=Y0;y<=Y1;y++)
+	{
+		float* Row = Depth + y * OCCLUSION_BUFFER_WIDTH;
+		__m256 RowEdge[3];
+		for(int e=0;e<3;e++)
+			RowEdge[e] = _mm256_set1_ps(Tri.EdgeB[e] * y + Tri.EdgeC[e]);
+		const __m256 RowZ = _mm256_set1_ps(Tri.ZY * y + Tri.Z0);
+
+		__m256 X = _mm256_add_ps(_mm256_set1_ps((float)X0), Lane);
+		for(int x=X0;x<=X1;x+=8)
+		{
+			const __m256 Inside = _mm256_and_ps(_mm256_and_ps(
+				_mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(EdgeA[0], X), RowEdge[0]), Zero, _CMP_GE_OQ),
+				_mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(EdgeA[1], X), RowEdge[1]), Zero, _CMP_GE_OQ)),
+				_mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(EdgeA[2], X), RowEdge[2]), Zero, _CMP_GE_OQ));
+			if(_mm256_movemask_ps(Inside))
+			{
+				const __m256 Z = _mm256_add_ps(_mm256_mul_ps(ZX, X), RowZ);
+				const __m256 Old = _mm256_loadu_ps(Row + x);
+				const __m256 New = _mm256_min_ps(Old, _mm256_min_ps(Z, ZMax));
+				_mm256_storeu_ps(Row + x, _mm256_blendv_ps(Old, New, Inside));
+			}
+			X = _mm256_add_ps(X, Eight);
+		}
+	}
+}
+#endif
+
+void OcclusionCuller::RasterizeTile( int Tile, EOcclusionSimd Simd )
+{
+	const int TileX0 = (Tile % OCCLUSION_TILE_COLUMNS) * OCCLUSION_TILE_WIDTH;
+	const int TileY0 = (Tile / OCCLUSION_TILE_COLUMNS) * OCCLUSION_TILE_HEIGHT;
+	const int TileX1 = TileX0 + OCCLUSION_TILE_WIDTH - 1;
+	const int TileY1 = TileY0 + OCCLUSION_TILE_HEIGHT - 1;
+	float* Depth = &_DepthArray[0];
+	for(int y=TileY0;y<=TileY1;y++)
+	{
+		for(int x=TileX0;x<=TileX1;x++)
+			Depth[y * OCCLUSION_BUFFER_WIDTH + x] = 1.f;
+	}
+
+	const std::vector<int>& Bin = _BinArray[Tile];
+	for(unsigned int i=0;i<Bin.size();i++)
+	{
+		const OcclusionTriangle& Tri = _TriangleArray[Bin[i]];
+		const int X0 = Math::Max<int>(Tri.MinX, TileX0);
+		const int Y0 = Math::Max<int>(Tri.MinY, TileY0);
+		const int X1 = Math::Min<int>(Tri.MaxX, TileX1);
+		const int Y1 = Math::Min<int>(Tri.MaxY, TileY1);
+#if defined(OCCLUSION_AVX)
+		if(Simd == OCCLUSION_AVX8)
+		{
+			RasterizeRowsAvx(Tri, X0 & ~7, Y0, X1, Y1, Depth);
+			continue;
+		}
+#endif
+#if defined(OCCLUSION_SSE)
+		if(Simd != OCCLUSION_SCALAR)
+		{
+			RasterizeRowsSse(Tri, X0 & ~3, Y0, X1, Y1, Depth);
+			continue;
+		}
+#endif
+		RasterizeRowsScalar(Tri, X0, Y0, X1, Y1, Depth);
+	}
+}
+
+void OcclusionCuller::BuildHierarchy()
+{
+	for(int l=1;l<_LevelCount;l++)
+	{
+		const int Width = GetLevelWidth(l);
+		const int Height = GetLevelHeight(l);
+		const int SourceWidth = GetLevelWidth(l - 1);
+		const int SourceHeight = GetLevelHeight(l - 1);
+		const float* Source = &_DepthArray[_LevelOffset[l - 1]];
+		float* Dest = &_DepthArray[_LevelOffset[l]];
+		for(int y=0;y<Height;y++)
+		{
+			const int SY0 = Math::Min<int>(y * 2, SourceHeight - 1);
+			const int SY1 = Math::Min<int>(y * 2 + 1, SourceHeight - 1);
+			for(int x=0;x<Width;x++)
+			{
+				const int SX0 = Math::Min<int>(x * 2, SourceWidth - 1);
+				const int SX1 = Math::Min<int>(x * 2 + 1, SourceWidth - 1);
+				Dest[y * Width + x] = Math::Max<float>(Math::Max<float>(Source[SY0 * SourceWidth + SX0], Source[SY0 * SourceWidth + SX1]),
+					Math::Max<float>(Source[SY1 * SourceWidth + SX0], Source[SY1 * SourceWidth + SX1]));
+			}
+		}
+	}
+}
+
+void OcclusionCuller::Rasterize( EOcclusionSimd Simd )
+{
+	ParallelFor(0, OCCLUSION_TILE_COLUMNS * OCCLUSION_TILE_ROWS, [&](int Tile)
+	{
+		RasterizeTile(Tile, Simd);
+	});
+	BuildHierarchy();
+}
+
+bool OcclusionCuller::IsBoxVisible( const XMFLOAT3& Min, const XMFLOAT3& Max )
+{
+	_Stats.TestedCount++;
+
+	const XMMATRIX ViewProjection = XMLoadFloat4x4(&_ViewProjection);
+	float RectMinX = FLOAT_MAX, RectMinY = FLOAT_MAX, RectMaxX = -FLOAT_MAX, RectMaxY = -FLOAT_MAX;
+	float NearestZ = FLOAT_MAX;
+	for(int c=0;c<8;c++)
+	{
+		const XMVECTOR Corner = XMVectorSet(c & 1 ? Max.x : Min.x, c & 2 ? Max.y : Min.y, c & 4 ? Max.z : Min.z, 1.f);
+		XMFLOAT4 Clip;
+		XMStoreFloat4(&Clip, XMVector3Transform(Corner, ViewProjection));
+		if(Clip.z < 0.f || Clip.w <= 0.f)
+			return true;
+
+		const float InvW = 1.f / Clip.w;
+		const float X = (Clip.x * InvW * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH;
+		const float Y = (0.5f - Clip.y * InvW * 0.5f) * OCCLUSION_BUFFER_HEIGHT;
+		RectMinX = Math::Min<float>(RectMinX, X);
+		RectMinY = Math::Min<float>(RectMinY, Y);
+		RectMaxX = Math::Max<float>(RectMaxX, X);
+		RectMaxY = Math::Max<float>(RectMaxY, Y);
+		NearestZ = Math::Min<float>(NearestZ, Clip.z * InvW);
+	}
+
+	// every pixel the rect touches and one more around it, coverage was only sampled at pixel centers
+	const int X0 = Math::Max<int>((int)floorf(RectMinX) - 1, 0);
+	const int Y0 = Math::Max<int>((int)floorf(RectMinY) - 1, 0);
+	const int X1 = Math::Min<int>((int)floorf(RectMaxX) + 1, OCCLUSION_BUFFER_WIDTH - 1);
+	const int Y1 = Math::Min<int>((int)floorf(RectMaxY) + 1, OCCLUSION_BUFFER_HEIGHT - 1);
+	if(X0 > X1 || Y0 > Y1)
+		return true;
+
+	// the level where the rect spans at most 4x4 texels
+	int Level = 0;
+	while(Level + 1 < _LevelCount && ((X1 >> Level) - (X0 >> Level) > 3 || (Y1 >> Level) - (Y0 >> Level) > 3))
+		Level++;
+
+	for(int y=Y0>>Level;y<=Y1>>Level;y++)
+	{
+		for(int x=X0>>Level;x<=X1>>Level;x++)
+		{
+			if(GetDepth(x, y, Level) >= NearestZ)
+				return true;
+		}
+	}
+	_Stats.OccludedCount++;
+	return false;
+}
+
+int OcclusionCuller::Cull( const AABBSoaArray& Bounds, int Begin, int Count, unsigned char* InOutVisible )
+{
+	int VisibleCount = 0;
+	for(int i=0;i<Count;i++)
+	{
+		if(!InOutVisible[i])
+			continue;
+		const int Box = Begin + i;
+		InOutVisible[i] = IsBoxVisible(XMFLOAT3(Bounds._MinX[Box], Bounds._MinY[Box], Bounds._MinZ[Box]), XMFLOAT3(Bounds._MaxX[Box], Bounds._MaxY[Box], Bounds._MaxZ[Box])) ? 1 : 0;
+		VisibleCount += InOutVisible[i];
+	}
+	return VisibleCount;
+}
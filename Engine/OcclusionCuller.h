@@ -0,0 +1,103 @@
+#pragma once
+#include "MathTypes.h"
+#include <vector>
+
+#include "FrustumCuller.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define OCCLUSION_SSE
+#endif
+#if defined(__AVX__)
+#define OCCLUSION_AVX
+#endif
+
+#define OCCLUSION_BUFFER_WIDTH		256
+#define OCCLUSION_BUFFER_HEIGHT		128
+#define OCCLUSION_TILE_WIDTH		64		// multiple of 8, a tile is one task
+#define OCCLUSION_TILE_HEIGHT		32
+#define OCCLUSION_MAX_LEVELS		16
+
+#define OCCLUDER_MAX_TRIANGLES		256		// reduction target of the occluder built at import
+#define OCCLUDER_PLANE_TOLERANCE	1e-5f	// relative to the mesh extent, how far from flat a region still counts as flat
+
+#define OCCLUSION_MIN_OCCLUDER_SIZE	0.1f	// screen size a mesh needs to occlude
+#define OCCLUSION_MAX_OCCLUDERS		64		// largest on screen first
+#define OCCLUSION_MAX_TRIANGLES		16384	// occluder triangles per frame
+
+enum EOcclusionSimd
+{
+	OCCLUSION_SCALAR,
+	OCCLUSION_SSE4,		// 4 pixels of a row per step
+	OCCLUSION_AVX8,		// 8 pixels of a row per step
+};
+
+// a screen space triangle ready to rasterize. pixel centers (x + 0.5, y + 0.5) are inside where
+// every Edge is >= 0, their depth is min(ZX * x + ZY * y + Z0, ZMax) at the same point
+struct OcclusionTriangle
+{
+	float EdgeA[3];
+	float EdgeB[3];
+	float EdgeC[3];
+	float ZX, ZY, Z0, ZMax;
+	int MinX, MinY, MaxX, MaxY;		// inclusive pixel bounds
+};
+
+struct OcclusionCullStats
+{
+	int OccluderCount;
+	int TriangleCount;		// set up, behind the near plane and off screen ones dropped
+	int BinnedCount;		// triangle tile pairs
+	int TestedCount;
+	int OccludedCount;
+};
+
+// software occlusion on the cpu, no device needed. occluder triangles are rasterized into a small depth buffer
+// keeping the nearest depth, tile by tile over threads. a max hierarchy over it answers box queries: a box is
+// occluded when its nearest point lies behind the farthest occluder depth over its screen rect.
+// d3d depth, 0 at the near plane
+class OcclusionCuller
+{
+public:
+	// level 0 is the full buffer, each level above holds the max of 2x2 below it. 1 where no occluder is
+	std::vector<float> _DepthArray;
+	int _LevelOffset[OCCLUSION_MAX_LEVELS];
+	int _LevelCount;
+
+	XMFLOAT4X4 _ViewProjection;
+	std::vector<OcclusionTriangle> _TriangleArray;
+	std::vector<std::vector<int> > _BinArray;	// triangles of each tile, row major
+	std::vector<XMFLOAT4> _ClipArray;	// scratch of AddOccluder
+	OcclusionCullStats _Stats;
+
+	static EOcclusionSimd GetBestSimd();
+
+	// an occluder for an indexed triangle list: positions welded, then reduced toward OCCLUDER_MAX_TRIANGLES by removing
+	// vertices inside flat regions and along straight borders only. the occluder covers exactly the surface of the mesh,
+	// so it never writes depth where the mesh has none. curved parts keep every triangle, a mesh left over
+	// OCCLUSION_MAX_TRIANGLES gets no occluder. OutIndices index OutPositions, which only holds the vertices they use
+	static void BuildOccluder(const unsigned int* Indices, int IndexCount, const XMFLOAT3* Positions, int VertexCount,
+		std::vector<XMFLOAT3>& OutPositions, std::vector<unsigned int>& OutIndices);
+
+	void BeginFrame(const XMMATRIX& ViewProjection);
+	// world space triangles, both windings occlude. triangles crossing the near plane are dropped
+	void AddOccluder(const XMFLOAT3* Positions, int VertexCount, const unsigned int* Indices, int IndexCount);
+	// every tile cleared and its triangles drawn as one task, then the hierarchy
+	void Rasterize(EOcclusionSimd Simd);
+	void Rasterize() { Rasterize(GetBestSimd()); }
+
+	// world space box, boxes crossing the near plane or off the buffer are visible
+	bool IsBoxVisible(const XMFLOAT3& Min, const XMFLOAT3& Max);
+	// boxes [Begin, Begin + Count) of Bounds whose InOutVisible is set, cleared for the occluded ones.
+	// returns how many are left visible
+	int Cull(const AABBSoaArray& Bounds, int Begin, int Count, unsigned char* InOutVisible);
+
+	float GetDepth(int X, int Y, int Level) const { return _DepthArray[_LevelOffset[Level] + Y * GetLevelWidth(Level) + X]; }
+	int GetLevelWidth(int Level) const { return OCCLUSION_BUFFER_WIDTH >> Level > 1 ? OCCLUSION_BUFFER_WIDTH >> Level : 1; }
+	int GetLevelHeight(int Level) const { return OCCLUSION_BUFFER_HEIGHT >> Level > 1 ? OCCLUSION_BUFFER_HEIGHT >> Level : 1; }
+
+	OcclusionCuller();
+
+private:
+	void RasterizeTile(int Tile, EOcclusionSimd Simd);
+	void BuildHierarchy();
+};
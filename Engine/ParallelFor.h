@@ -0,0 +1,41 @@
+#pragma once
+
+#if defined(_MSC_VER)
+#include <ppl.h>
+#else
+#include <thread>
+#include <vector>
+#include <atomic>
+#endif
+
+// runs Func(i) for every i in [Begin, End) spread over all cores, returns when all are done
+template<class FuncType>
+void ParallelFor(int Begin, int End, const FuncType& Func)
+{
+	if(End <= Begin)
+		return;
+#if defined(_MSC_VER)
+	Concurrency::parallel_for(Begin, End, Func);
+#else
+	unsigned int NumThread = std::thread::hardware_concurrency();
+	if(NumThread <= 1 || End - Begin == 1)
+	{
+		for(int i=Begin;i<End;i++)
+			Func(i);
+		return;
+	}
+
+	std::atomic<int> NextIndex(Begin);
+	std::vector<std::thread> Threads;
+	for(unsigned int t=0;t<NumThread;t++)
+	{
+		Threads.push_back(std::thread([&]()
+		{
+			for(int i = NextIndex++;i<End;i = NextIndex++)
+				Func(i);
+		}));
+	}
+	for(unsigned int t=0;t<Threads.size();t++)
+		Threads[t].join();
+#endif
+}
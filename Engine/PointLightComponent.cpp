@@ -2,6 +2,7 @@
 #include "Engine.h"
 #include "Camera.h"
 #include "DeferredPointLightPixelShader.h"
+#include "LightClusterBuilder.h"
 
 
 PointLightComponent::PointLightComponent(XMFLOAT4 LightColor, XMFLOAT3 LightPos, float LightRange)
@@ -20,4 +21,9 @@ void PointLightComponent::RenderLightDeferred(Camera* Camera)
 {
 	GEngine->_DeferredPointPS->SetShaderParameter(this);
 	GEngine->DrawFullScreenQuad11(GEngine->_DeferredPointPS->GetPixelShader(), GEngine->_Width, GEngine->_Height);
+}
+
+bool PointLightComponent::AddToLightClusters(LightClusterBuilder* Builder)
+{
+	return Builder->AddPointLight(_LightPos, _LightRange, _LightColor) >= 0;
 }
\ No newline at end of file
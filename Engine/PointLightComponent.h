@@ -10,6 +10,7 @@ public:
 	float _LightRange;
 public:
 	virtual void RenderLightDeferred(Camera* Camera);
+	virtual bool AddToLightClusters(LightClusterBuilder* Builder);
 
 	PointLightComponent(XMFLOAT4 LightColor, XMFLOAT3 LightPos, float LightRange);
 	virtual ~PointLightComponent(void);
@@ -0,0 +1,280 @@
+#include <cassert>
+#include <math.h>
+#include "PreSkinner.h"
+#include "CpuSkinning.h"
+#include "Engine.h"
+#include "SkeletalMesh.h"
+#include "StaticMesh.h"
+#include "SkeletalMeshComponent.h"
+#include "SkeletalMeshRenderData.h"
+#include "SkeletalMeshRegistry.h"
+#include "BonePaletteArena.h"
+#include "ParallelFor.h"
+
+struct PreSkinConstantBuffer
+{
+	XMFLOAT4 PositionScale;
+	XMFLOAT4 PositionBias;
+	UINT BoneBase;
+	UINT BonePad[3];
+};
+
+PreSkinner::PreSkinner()
+	:_Backend(PRESKIN_STREAMOUT)
+	,_ConstantBuffer(NULL)
+{
+	D3D11_BUFFER_DESC bdc;
+	ZeroMemory( &bdc, sizeof(bdc) );
+	bdc.Usage = D3D11_USAGE_DEFAULT;
+	bdc.ByteWidth = sizeof(PreSkinConstantBuffer);
+	bdc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bdc.CPUAccessFlags = 0;
+	HRESULT hr = GEngine->_Device->CreateBuffer( &bdc, NULL, &_ConstantBuffer );
+	if( FAILED( hr ) )
+		assert(false);
+
+	SetD3DResourceDebugName("PreSkinnerConstantBuffer", _ConstantBuffer);
+}
+
+PreSkinner::~PreSkinner()
+{
+	if(_ConstantBuffer) _ConstantBuffer->Release();
+
+	std::map<PreSkinShaderKey, PreSkinShaderRes>::iterator it;
+	for(it=_ShaderMap.begin();it!=_ShaderMap.end();it++)
+	{
+		if(it->second.VertexLayout) it->second.VertexLayout->Release();
+		if(it->second.VertexShader) it->second.VertexShader->Release();
+		if(it->second.StreamOutShader) it->second.StreamOutShader->Release();
+	}
+}
+
+PreSkinShaderRes& PreSkinner::GetShaderRes( const PreSkinShaderKey& Key )
+{
+	std::map<PreSkinShaderKey, PreSkinShaderRes>::iterator it = _ShaderMap.find(Key);
+	if(it != _ShaderMap.end())
+		return it->second;
+
+	D3D10_SHADER_MACRO Defines[] =
+	{
+		{"GPUSKINNING", "1"},
+		{"TEXCOORD", Key.NumTex == 1 ? "1" : "0"},
+		{"COMPRESSED", Key.Compressed ? "1" : "0"},
+		{"DUALQUAT_SKINNING", Key.DualQuat ? "1" : "0"},
+		{0, 0}
+	};
+
+	WCHAR FileName[] = L"PreSkin.fx";
+	HRESULT hr;
+	ID3DBlob* pVSBlob = NULL;
+	hr = GEngine->CompileShaderFromFile( FileName, Defines, "VS", "vs_4_0", &pVSBlob );
+	if( FAILED( hr ) )
+	{
+		MessageBox( NULL,
+			L"The FX file cannot be compiled.  Please run this executable from the directory that contains the FX file.", L"Error", MB_OK );
+		assert(false);
+	}
+
+	PreSkinShaderRes Res;
+	hr = GEngine->_Device->CreateVertexShader( pVSBlob->GetBufferPointer(), pVSBlob->GetBufferSize(), NULL, &Res.VertexShader );
+	if( FAILED( hr ) )
+		assert(false);
+
+	// the vertex shader output goes straight to the buffer, nothing is rasterized
+	D3D11_SO_DECLARATION_ENTRY SODecl[] =
+	{
+		{ 0, "POSITION", 0, 0, 3, 0 },
+		{ 0, "NORMAL", 0, 0, 3, 0 },
+		{ 0, "TEXCOORD", 0, 0, 2, 0 },
+	};
+	const UINT NumEntry = Key.NumTex == 1 ? 3 : 2;
+	UINT Stride = Key.NumTex == 1 ? sizeof(NormalTexVertex) : sizeof(NormalVertex);
+	hr = GEngine->_Device->CreateGeometryShaderWithStreamOutput( pVSBlob->GetBufferPointer(), pVSBlob->GetBufferSize(),
+		SODecl, NumEntry, &Stride, 1, D3D11_SO_NO_RASTERIZED_STREAM, NULL, &Res.StreamOutShader );
+	if( FAILED( hr ) )
+		assert(false);
+
+	std::vector<D3D11_INPUT_ELEMENT_DESC> Layout;
+	GetMeshInputLayout(Key.NumTex, true, Key.Compressed, Layout);
+	hr = GEngine->_Device->CreateInputLayout( &Layout[0], Layout.size(), pVSBlob->GetBufferPointer(),
+		pVSBlob->GetBufferSize(), &Res.VertexLayout );
+	pVSBlob->Release();
+	if( FAILED( hr ) )
+		assert(false);
+
+	return _ShaderMap.insert(std::pair<PreSkinShaderKey, PreSkinShaderRes>(Key, Res)).first->second;
+}
+
+void PreSkinner::CreateOutputBuffer( SkeletalMeshRenderData* RenderData )
+{
+	if(RenderData->_PreSkinnedBuffer && RenderData->_PreSkinnedBackend == _Backend)
+		return;
+	if(RenderData->_PreSkinnedBuffer)
+		RenderData->_PreSkinnedBuffer->Release();
+
+	const SkeletalMesh* Mesh = RenderData->_SkeletalMesh;
+	RenderData->_PreSkinnedStride = Mesh->_NumTexCoord == 1 ? sizeof(NormalTexVertex) : sizeof(NormalVertex);
+
+	// stream out writes from the gpu, the cpu backend maps with discard every frame
+	D3D11_BUFFER_DESC bd;
+	ZeroMemory( &bd, sizeof(bd) );
+	bd.ByteWidth = RenderData->_PreSkinnedStride * Mesh->_NumVertex;
+	if(_Backend == PRESKIN_STREAMOUT)
+	{
+		bd.Usage = D3D11_USAGE_DEFAULT;
+		bd.BindFlags = D3D11_BIND_VERTEX_BUFFER | D3D11_BIND_STREAM_OUTPUT;
+		bd.CPUAccessFlags = 0;
+	}
+	else
+	{
+		bd.Usage = D3D11_USAGE_DYNAMIC;
+		bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bd.CPUAccessFlags = D3D10_CPU_ACCESS_WRITE;
+	}
+	HRESULT hr = GEngine->_Device->CreateBuffer( &bd, NULL, &RenderData->_PreSkinnedBuffer );
+	if( FAILED( hr ) )
+		assert(false);
+
+	SetD3DResourceDebugName("PreSkinnedBuffer", RenderData->_PreSkinnedBuffer);
+	RenderData->_PreSkinnedBackend = _Backend;
+}
+
+void PreSkinner::Skin( SkeletalMeshRegistry& Registry, BonePaletteArena& Arena )
+{
+	std::vector<SkeletalMeshRenderData*> RenderDataArray;
+	for(unsigned int c=0;c<Registry._ComponentArray.size();c++)
+	{
+		SkeletalMeshComponent* Component = Registry._ComponentArray[c];
+		for(unsigned int i=0;i<Component->_RenderDataArray.size();i++)
+		{
+			SkeletalMeshRenderData* RenderData = Component->_RenderDataArray[i];
+			RenderData->_bPreSkinned = false;
+			if(_Backend != PRESKIN_OFF && RenderData->_SkeletalMesh->_NumVertex > 0)
+				RenderDataArray.push_back(RenderData);
+		}
+	}
+	if(RenderDataArray.size() == 0)
+		return;
+
+	for(unsigned int i=0;i<RenderDataArray.size();i++)
+		CreateOutputBuffer(RenderDataArray[i]);
+
+	if(_Backend == PRESKIN_STREAMOUT)
+		SkinStreamOut(RenderDataArray, Arena);
+	else
+		SkinCpu(RenderDataArray);
+}
+
+void PreSkinner::SkinStreamOut( std::vector<SkeletalMeshRenderData*>& RenderDataArray, BonePaletteArena& Arena )
+{
+	ID3D11DeviceContext* Context = GEngine->_ImmediateContext;
+
+	Context->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_POINTLIST );
+	Context->VSSetConstantBuffers( 0, 1, &_ConstantBuffer );
+	Context->VSSetShaderResources( 0, 1, &Arena._BufferRV );
+	Context->PSSetShader( NULL, NULL, 0 );
+
+	for(unsigned int i=0;i<RenderDataArray.size();i++)
+	{
+		SkeletalMeshRenderData* RenderData = RenderDataArray[i];
+		SkeletalMesh* Mesh = RenderData->_SkeletalMesh;
+		if(RenderData->_BoneBase == BONE_ARENA_INVALID)
+			continue;
+
+		PreSkinConstantBuffer cb;
+		Mesh->GetPositionScaleBias(cb.PositionScale, cb.PositionBias);
+		cb.BoneBase = RenderData->_BoneBase;
+		Context->UpdateSubresource( _ConstantBuffer, 0, NULL, &cb, 0, 0 );
+
+		PreSkinShaderKey Key;
+		Key.NumTex = Mesh->_NumTexCoord;
+		Key.Compressed = Mesh->_CompressedVertex;
+		Key.DualQuat = RenderData->_SkeletalMeshComponent->_SkinningMode == SKIN_DUALQUAT;
+		PreSkinShaderRes& Res = GetShaderRes(Key);
+
+		Context->IASetInputLayout( Res.VertexLayout );
+		Context->VSSetShader( Res.VertexShader, NULL, 0 );
+		Context->GSSetShader( Res.StreamOutShader, NULL, 0 );
+
+		UINT Offset = 0;
+		Context->IASetVertexBuffers( 0, 1, &Mesh->_VertexBuffer, &Mesh->_VertexStride, &Offset );
+		Context->SOSetTargets( 1, &RenderData->_PreSkinnedBuffer, &Offset );
+
+		// one point per vertex, the index buffer is for the passes that draw the result
+		Context->Draw( Mesh->_NumVertex, 0 );
+		RenderData->_bPreSkinned = true;
+	}
+
+	// the outputs are vertex buffers from here on
+	ID3D11Buffer* NullBuffer = NULL;
+	UINT Offset = 0;
+	Context->SOSetTargets( 1, &NullBuffer, &Offset );
+	Context->GSSetShader( NULL, NULL, 0 );
+}
+
+void PreSkinner::SkinCpu( std::vector<SkeletalMeshRenderData*>& RenderDataArray )
+{
+	// per render data palettes in mesh bone order, and the vertex chunks the workers pick up
+	struct SkinTask
+	{
+		SkeletalMeshRenderData* RenderData;
+		int PaletteOffset;
+		int FirstVertex;
+		int Count;
+		unsigned char* Output;
+	};
+	std::vector<SkinTask> Tasks;
+	std::vector<D3D11_MAPPED_SUBRESOURCE> Mapped(RenderDataArray.size());
+
+	int PaletteSize = 0;
+	for(unsigned int i=0;i<RenderDataArray.size();i++)
+		PaletteSize += RenderDataArray[i]->_SkeletalMesh->_NumBone;
+	_ColumnPalette.resize(PaletteSize);
+	_DualQuatPalette.resize(PaletteSize);
+
+	int PaletteOffset = 0;
+	for(unsigned int i=0;i<RenderDataArray.size();i++)
+	{
+		SkeletalMeshRenderData* RenderData = RenderDataArray[i];
+		const SkeletalMesh* Mesh = RenderData->_SkeletalMesh;
+		const SkeletalMeshComponent* Component = RenderData->_SkeletalMeshComponent;
+		const BoneMatrix3x4* SkinPalette = Component->GetSkinPalette();
+		const BoneDualQuat* SkinDualQuat = Component->GetSkinDualQuat();
+		for(int b=0;b<Mesh->_NumBone;b++)
+		{
+			const int Joint = Mesh->_RequiredBoneArray[b];
+			CpuSkinning::ToColumns(SkinPalette[Joint], _ColumnPalette[PaletteOffset + b]);
+			_DualQuatPalette[PaletteOffset + b] = SkinDualQuat[Joint];
+		}
+
+		HRESULT hr = GEngine->_ImmediateContext->Map( RenderData->_PreSkinnedBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &Mapped[i] );
+		if( FAILED( hr ) )
+			assert(false);
+
+		for(int v=0;v<Mesh->_NumVertex;v+=PRESKIN_CPU_CHUNK)
+		{
+			SkinTask Task;
+			Task.RenderData = RenderData;
+			Task.PaletteOffset = PaletteOffset;
+			Task.FirstVertex = v;
+			Task.Count = Mesh->_NumVertex - v < PRESKIN_CPU_CHUNK ? Mesh->_NumVertex - v : PRESKIN_CPU_CHUNK;
+			Task.Output = (unsigned char*)Mapped[i].pData + v * RenderData->_PreSkinnedStride;
+			Tasks.push_back(Task);
+		}
+		PaletteOffset += Mesh->_NumBone;
+	}
+
+	ParallelFor(0, (int)Tasks.size(), [&](int t)
+	{
+		const SkinTask& Task = Tasks[t];
+		const SkeletalMesh* Mesh = Task.RenderData->_SkeletalMesh;
+		CpuSkinning::SkinVertices(&Mesh->_SkinSourceArray[Task.FirstVertex], Task.Count, &_ColumnPalette[Task.PaletteOffset], &_DualQuatPalette[Task.PaletteOffset],
+			Task.RenderData->_SkeletalMeshComponent->_SkinningMode, Mesh->_NumTexCoord == 1, Task.Output);
+	});
+
+	for(unsigned int i=0;i<RenderDataArray.size();i++)
+	{
+		GEngine->_ImmediateContext->Unmap( RenderDataArray[i]->_PreSkinnedBuffer, 0 );
+		RenderDataArray[i]->_bPreSkinned = true;
+	}
+}
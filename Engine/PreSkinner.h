@@ -0,0 +1,65 @@
+#pragma once
+#include <d3d11.h>
+#include <xnamath.h>
+#include <vector>
+#include <map>
+#include "BonePalette.h"
+
+class SkeletalMeshRegistry;
+class SkeletalMeshRenderData;
+class BonePaletteArena;
+
+enum EPreSkinBackend
+{
+	PRESKIN_OFF,		// every pass skins in its vertex shader
+	PRESKIN_STREAMOUT,	// PreSkin.fx through stream out, once per frame
+	PRESKIN_CPU,		// worker threads into a dynamic buffer, same output as the stream out
+};
+
+// vertex shader variant of PreSkin.fx with its stream out stage
+struct PreSkinShaderKey
+{
+	int NumTex;
+	bool Compressed;
+	bool DualQuat;
+	bool operator<(const PreSkinShaderKey& other) const
+	{
+		if( NumTex != other.NumTex ) return NumTex < other.NumTex;
+		if( Compressed != other.Compressed ) return Compressed < other.Compressed;
+		return DualQuat < other.DualQuat;
+	};
+};
+
+struct PreSkinShaderRes
+{
+	ID3D11InputLayout*		VertexLayout;
+	ID3D11VertexShader*		VertexShader;
+	ID3D11GeometryShader*	StreamOutShader;
+};
+
+// skins every registered skeletal mesh once per frame into a model space float vertex buffer per render data.
+// the g-buffer and all shadow cascades draw that buffer with the static vertex shaders instead of skinning 4 times
+class PreSkinner
+{
+public:
+	EPreSkinBackend _Backend;
+
+	std::map<PreSkinShaderKey, PreSkinShaderRes> _ShaderMap;
+	ID3D11Buffer* _ConstantBuffer;
+
+	// scratch of the cpu backend, mesh bone palettes of every render data back to back
+	std::vector<XMFLOAT4X4> _ColumnPalette;
+	std::vector<BoneDualQuat> _DualQuatPalette;
+
+	// after the bone upload, before the first pass that draws skinned meshes
+	void Skin(SkeletalMeshRegistry& Registry, BonePaletteArena& Arena);
+
+	PreSkinner();
+	~PreSkinner();
+
+private:
+	void SkinStreamOut(std::vector<SkeletalMeshRenderData*>& RenderDataArray, BonePaletteArena& Arena);
+	void SkinCpu(std::vector<SkeletalMeshRenderData*>& RenderDataArray);
+	void CreateOutputBuffer(SkeletalMeshRenderData* RenderData);
+	PreSkinShaderRes& GetShaderRes(const PreSkinShaderKey& Key);
+};
@@ -0,0 +1,108 @@
+#include "Scene.h"
+#include "StaticMeshComponent.h"
+#include "SkeletalMeshComponent.h"
+#include "FrustumCuller.h"
+#include "OutputDebug.h"
+
+Scene::Scene()
+	:_bLogStats(false)
+{
+}
+
+void Scene::AddStaticMeshComponent( StaticMeshComponent* Component )
+{
+	const AABBSoaArray& Bounds = Component->_MeshBounds;
+	for(int i=0;i<Bounds._Count;i++)
+	{
+		SceneObject Object;
+		Object.Type = SCENE_OBJECT_STATIC_MESH;
+		Object.StaticComponent = Component;
+		Object.MeshIndex = i;
+		Object.SkeletalComponent = NULL;
+		Object.Proxy = _BVH.CreateProxy(XMFLOAT3(Bounds._MinX[i], Bounds._MinY[i], Bounds._MinZ[i]), XMFLOAT3(Bounds._MaxX[i], Bounds._MaxY[i], Bounds._MaxZ[i]), _ObjectArray.size(), true);
+		_ObjectArray.push_back(Object);
+	}
+}
+
+void Scene::GetSkeletalBounds( SkeletalMeshComponent* Component, XMFLOAT3& OutMin, XMFLOAT3& OutMax )
+{
+	XMFLOAT3 Center;
+	float Radius;
+	Component->GetBoundingSphere(Center, Radius);
+	OutMin = XMFLOAT3(Center.x - Radius, Center.y - Radius, Center.z - Radius);
+	OutMax = XMFLOAT3(Center.x + Radius, Center.y + Radius, Center.z + Radius);
+}
+
+void Scene::AddSkeletalMeshComponent( SkeletalMeshComponent* Component )
+{
+	XMFLOAT3 Min, Max;
+	GetSkeletalBounds(Component, Min, Max);
+
+	SceneObject Object;
+	Object.Type = SCENE_OBJECT_SKELETAL_MESH;
+	Object.StaticComponent = NULL;
+	Object.MeshIndex = 0;
+	Object.SkeletalComponent = Component;
+	Object.Proxy = _BVH.CreateProxy(Min, Max, _ObjectArray.size(), false);
+	_ObjectArray.push_back(Object);
+}
+
+void Scene::RemoveSkeletalMeshComponent( SkeletalMeshComponent* Component )
+{
+	for(unsigned int i=0;i<_ObjectArray.size();i++)
+	{
+		if(_ObjectArray[i].SkeletalComponent != Component)
+			continue;
+
+		// the last object takes the slot, its proxy follows
+		_BVH.DestroyProxy(_ObjectArray[i].Proxy);
+		_ObjectArray[i] = _ObjectArray.back();
+		_ObjectArray.pop_back();
+		if(i < _ObjectArray.size())
+			_BVH.SetUserData(_ObjectArray[i].Proxy, i);
+		return;
+	}
+}
+
+void Scene::Build()
+{
+	_BVH.Build();
+	if(_bLogStats)
+		cout_debug("scene bvh : %d objects, height %d, sah cost %f\n", _BVH.GetProxyCount(), _BVH.GetHeight(), _BVH.GetSAHCost());
+}
+
+void Scene::Update()
+{
+	// stats cover a frame, this update's moves and the queries after it
+	_BVH.ResetStats();
+	for(unsigned int i=0;i<_ObjectArray.size();i++)
+	{
+		if(_ObjectArray[i].Type != SCENE_OBJECT_SKELETAL_MESH)
+			continue;
+		XMFLOAT3 Min, Max;
+		GetSkeletalBounds(_ObjectArray[i].SkeletalComponent, Min, Max);
+		_BVH.MoveProxy(_ObjectArray[i].Proxy, Min, Max);
+	}
+	_BVH.Refit();
+}
+
+void Scene::QueryFrustum( const XMMATRIX& ViewProjection, std::vector<int>& Out )
+{
+	FrustumCuller::ExtractPlanes(ViewProjection, _FrustumPlanes);
+	_BVH.QueryFrustum(_FrustumPlanes, Out);
+}
+
+void Scene::QuerySphere( const XMFLOAT3& Center, float Radius, std::vector<int>& Out )
+{
+	_BVH.QuerySphere(Center, Radius, Out);
+}
+
+void Scene::QueryAABB( const XMFLOAT3& Min, const XMFLOAT3& Max, std::vector<int>& Out )
+{
+	_BVH.QueryAABB(Min, Max, Out);
+}
+
+void Scene::QueryRay( const XMFLOAT3& Origin, const XMFLOAT3& Dir, float MaxT, std::vector<int>& Out )
+{
+	_BVH.QueryRay(Origin, Dir, MaxT, Out);
+}
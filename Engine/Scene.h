@@ -0,0 +1,55 @@
+#pragma once
+#include <d3d11.h>
+#include <xnamath.h>
+#include <vector>
+
+#include "SceneBVH.h"
+
+class StaticMeshComponent;
+class SkeletalMeshComponent;
+
+enum ESceneObjectType
+{
+	SCENE_OBJECT_STATIC_MESH,		// one mesh of a static mesh component
+	SCENE_OBJECT_SKELETAL_MESH,		// a whole skeletal mesh component
+};
+
+struct SceneObject
+{
+	ESceneObjectType Type;
+	StaticMeshComponent* StaticComponent;
+	int MeshIndex;		// into the static component's _StaticMeshArray
+	SkeletalMeshComponent* SkeletalComponent;
+	int Proxy;
+};
+
+// the drawable objects of the world under one bvh. static meshes go in once, skeletal components
+// follow their bounds in Update. queries return indices into _ObjectArray. the scene doesn't own the components
+class Scene
+{
+public:
+	std::vector<SceneObject> _ObjectArray;	// index is the proxy's user data
+	SceneBVH _BVH;
+	bool _bLogStats;
+
+	void AddStaticMeshComponent(StaticMeshComponent* Component);
+	void AddSkeletalMeshComponent(SkeletalMeshComponent* Component);
+	void RemoveSkeletalMeshComponent(SkeletalMeshComponent* Component);
+
+	// sah build over everything added so far, after loading
+	void Build();
+	// skeletal components' new bounds into the bvh, then the refit. before the frame's queries
+	void Update();
+
+	void QueryFrustum(const XMMATRIX& ViewProjection, std::vector<int>& Out);
+	void QuerySphere(const XMFLOAT3& Center, float Radius, std::vector<int>& Out);
+	void QueryAABB(const XMFLOAT3& Min, const XMFLOAT3& Max, std::vector<int>& Out);
+	void QueryRay(const XMFLOAT3& Origin, const XMFLOAT3& Dir, float MaxT, std::vector<int>& Out);
+
+	Scene();
+
+private:
+	XMFLOAT4 _FrustumPlanes[6];
+
+	static void GetSkeletalBounds(SkeletalMeshComponent* Component, XMFLOAT3& OutMin, XMFLOAT3& OutMax);
+};
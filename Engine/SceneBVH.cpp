@@ -0,0 +1,722 @@
+#include <algorithm>
+
+#include "SceneBVH.h"
+#include "MathUtil.h"
+
+// half the surface area, only ever compared
+static float BoxArea(const XMFLOAT3& Min, const XMFLOAT3& Max)
+{
+	const float X = Max.x - Min.x;
+	const float Y = Max.y - Min.y;
+	const float Z = Max.z - Min.z;
+	return X * Y + Y * Z + Z * X;
+}
+
+static void BoxUnion(const XMFLOAT3& MinA, const XMFLOAT3& MaxA, const XMFLOAT3& MinB, const XMFLOAT3& MaxB, XMFLOAT3& OutMin, XMFLOAT3& OutMax)
+{
+	OutMin = XMFLOAT3(Math::Min<float>(MinA.x, MinB.x), Math::Min<float>(MinA.y, MinB.y), Math::Min<float>(MinA.z, MinB.z));
+	OutMax = XMFLOAT3(Math::Max<float>(MaxA.x, MaxB.x), Math::Max<float>(MaxA.y, MaxB.y), Math::Max<float>(MaxA.z, MaxB.z));
+}
+
+static float UnionArea(const XMFLOAT3& MinA, const XMFLOAT3& MaxA, const XMFLOAT3& MinB, const XMFLOAT3& MaxB)
+{
+	XMFLOAT3 Min, Max;
+	BoxUnion(MinA, MaxA, MinB, MaxB, Min, Max);
+	return BoxArea(Min, Max);
+}
+
+static bool BoxOverlaps(const XMFLOAT3& MinA, const XMFLOAT3& MaxA, const XMFLOAT3& MinB, const XMFLOAT3& MaxB)
+{
+	return MinA.x <= MaxB.x && MaxA.x >= MinB.x && MinA.y <= MaxB.y && MaxA.y >= MinB.y && MinA.z <= MaxB.z && MaxA.z >= MinB.z;
+}
+
+static bool BoxContains(const XMFLOAT3& OuterMin, const XMFLOAT3& OuterMax, const XMFLOAT3& Min, const XMFLOAT3& Max)
+{
+	return Min.x >= OuterMin.x && Min.y >= OuterMin.y && Min.z >= OuterMin.z && Max.x <= OuterMax.x && Max.y <= OuterMax.y && Max.z <= OuterMax.z;
+}
+
+// false when the box is behind one of the planes in Mask. planes the box is entirely in front of leave the mask,
+// the subtree below doesn't test them again
+static bool FrustumTestBox(const XMFLOAT4* Planes, const XMFLOAT3& Min, const XMFLOAT3& Max, int& Mask)
+{
+	for(int p=0;p<6;p++)
+	{
+		if(!(Mask & (1 << p)))
+			continue;
+		const XMFLOAT4& Plane = Planes[p];
+		const float FarDistance = Plane.x * (Plane.x > 0.f ? Max.x : Min.x) + Plane.y * (Plane.y > 0.f ? Max.y : Min.y) + Plane.z * (Plane.z > 0.f ? Max.z : Min.z) + Plane.w;
+		if(FarDistance < 0.f)
+			return false;
+		const float NearDistance = Plane.x * (Plane.x > 0.f ? Min.x : Max.x) + Plane.y * (Plane.y > 0.f ? Min.y : Max.y) + Plane.z * (Plane.z > 0.f ? Min.z : Max.z) + Plane.w;
+		if(NearDistance >= 0.f)
+			Mask &= ~(1 << p);
+	}
+	return true;
+}
+
+static bool SphereTestBox(const XMFLOAT3& Center, float Radius, const XMFLOAT3& Min, const XMFLOAT3& Max)
+{
+	const float X = Center.x - Math::Clamp<float>(Center.x, Min.x, Max.x);
+	const float Y = Center.y - Math::Clamp<float>(Center.y, Min.y, Max.y);
+	const float Z = Center.z - Math::Clamp<float>(Center.z, Min.z, Max.z);
+	return X * X + Y * Y + Z * Z <= Radius * Radius;
+}
+
+// slab test, the entry distance or -1 when the segment misses
+static float RayTestBox(const XMFLOAT3& Origin, const XMFLOAT3& InvDir, float MaxT, const XMFLOAT3& Min, const XMFLOAT3& Max)
+{
+	float Enter = 0.f;
+	float Exit = MaxT;
+	const float* O = &Origin.x;
+	const float* D = &InvDir.x;
+	const float* BoxMin = &Min.x;
+	const float* BoxMax = &Max.x;
+	for(int a=0;a<3;a++)
+	{
+		float Near = (BoxMin[a] - O[a]) * D[a];
+		float Far = (BoxMax[a] - O[a]) * D[a];
+		if(Near > Far)
+			std::swap(Near, Far);
+		Enter = Math::Max<float>(Enter, Near);
+		Exit = Math::Min<float>(Exit, Far);
+		if(Enter > Exit)
+			return -1.f;
+	}
+	return Enter;
+}
+
+SceneBVH::SceneBVH()
+	:_Root(-1)
+	,_FreeNode(-1)
+	,_RefitStamp(0)
+{
+	ResetStats();
+}
+
+int SceneBVH::AllocNode()
+{
+	int Node = _FreeNode;
+	if(Node != -1)
+	{
+		_FreeNode = _NodeArray[Node].Parent;
+	}
+	else
+	{
+		Node = _NodeArray.size();
+		_NodeArray.push_back(SceneBVHNode());
+	}
+	SceneBVHNode& N = _NodeArray[Node];
+	N.Parent = -1;
+	N.Child[0] = N.Child[1] = -1;
+	N.Object = -1;
+	N.RefitStamp = 0;
+	return Node;
+}
+
+void SceneBVH::FreeNode( int Node )
+{
+	SceneBVHNode& N = _NodeArray[Node];
+	N.Parent = _FreeNode;
+	N.Child[0] = N.Child[1] = -1;
+	N.Object = -1;
+	_FreeNode = Node;
+}
+
+void SceneBVH::FattenBox( const SceneBVHObject& Object, XMFLOAT3& OutMin, XMFLOAT3& OutMax ) const
+{
+	float Margin = 0.f;
+	if(!Object.bStatic)
+	{
+		Margin = Math::Max<float>(Object.Max.x - Object.Min.x, Math::Max<float>(Object.Max.y - Object.Min.y, Object.Max.z - Object.Min.z)) * SCENE_BVH_FAT_SCALE;
+	}
+	OutMin = XMFLOAT3(Object.Min.x - Margin, Object.Min.y - Margin, Object.Min.z - Margin);
+	OutMax = XMFLOAT3(Object.Max.x + Margin, Object.Max.y + Margin, Object.Max.z + Margin);
+}
+
+int SceneBVH::CreateProxy( const XMFLOAT3& Min, const XMFLOAT3& Max, int UserData, bool bStatic )
+{
+	int Proxy;
+	if(_FreeObjectArray.size())
+	{
+		Proxy = _FreeObjectArray.back();
+		_FreeObjectArray.pop_back();
+	}
+	else
+	{
+		Proxy = _ObjectArray.size();
+		_ObjectArray.push_back(SceneBVHObject());
+	}
+
+	SceneBVHObject& Object = _ObjectArray[Proxy];
+	Object.Min = Min;
+	Object.Max = Max;
+	Object.UserData = UserData;
+	Object.bStatic = bStatic;
+
+	const int Leaf = AllocNode();
+	Object.Leaf = Leaf;
+	_NodeArray[Leaf].Object = Proxy;
+	FattenBox(Object, _NodeArray[Leaf].Min, _NodeArray[Leaf].Max);
+	InsertLeaf(Leaf);
+	return Proxy;
+}
+
+void SceneBVH::DestroyProxy( int Proxy )
+{
+	SceneBVHObject& Object = _ObjectArray[Proxy];
+	if(Object.Leaf == -1)
+		return;
+	RemoveLeaf(Object.Leaf);
+	FreeNode(Object.Leaf);
+	Object.Leaf = -1;
+	_FreeObjectArray.push_back(Proxy);
+}
+
+bool SceneBVH::MoveProxy( int Proxy, const XMFLOAT3& Min, const XMFLOAT3& Max )
+{
+	SceneBVHObject& Object = _ObjectArray[Proxy];
+	Object.Min = Min;
+	Object.Max = Max;
+
+	const int Leaf = Object.Leaf;
+	if(BoxContains(_NodeArray[Leaf].Min, _NodeArray[Leaf].Max, Min, Max))
+		return false;
+
+	// clear of its old box the object is somewhere else in the scene, refitting would stretch every ancestor across
+	// the gap. a new place down the sah path instead
+	if(!BoxOverlaps(_NodeArray[Leaf].Min, _NodeArray[Leaf].Max, Min, Max))
+	{
+		RemoveLeaf(Leaf);
+		FattenBox(Object, _NodeArray[Leaf].Min, _NodeArray[Leaf].Max);
+		InsertLeaf(Leaf);
+		_Stats.ReinsertCount++;
+		return true;
+	}
+
+	FattenBox(Object, _NodeArray[Leaf].Min, _NodeArray[Leaf].Max);
+	_DirtyArray.push_back(Leaf);
+	return true;
+}
+
+void SceneBVH::InsertLeaf( int Leaf )
+{
+	if(_Root == -1)
+	{
+		_Root = Leaf;
+		_NodeArray[Leaf].Parent = -1;
+		return;
+	}
+
+	// down the tree while pushing the leaf into a child costs less than pairing it with the node here.
+	// every ancestor grows by the leaf either way, that part is inherited by the children's costs
+	const XMFLOAT3 LeafMin = _NodeArray[Leaf].Min;
+	const XMFLOAT3 LeafMax = _NodeArray[Leaf].Max;
+	int Sibling = _Root;
+	while(_NodeArray[Sibling].Child[0] != -1)
+	{
+		const SceneBVHNode& Node = _NodeArray[Sibling];
+		const float CombinedArea = UnionArea(Node.Min, Node.Max, LeafMin, LeafMax);
+		const float Cost = CombinedArea;
+		const float Inheritance = CombinedArea - BoxArea(Node.Min, Node.Max);
+
+		float ChildCost[2];
+		for(int c=0;c<2;c++)
+		{
+			const SceneBVHNode& Child = _NodeArray[Node.Child[c]];
+			ChildCost[c] = UnionArea(Child.Min, Child.Max, LeafMin, LeafMax) + Inheritance;
+			if(Child.Child[0] != -1)
+				ChildCost[c] -= BoxArea(Child.Min, Child.Max);
+		}
+
+		if(Cost < ChildCost[0] && Cost < ChildCost[1])
+			break;
+		Sibling = ChildCost[0] < ChildCost[1] ? Node.Child[0] : Node.Child[1];
+	}
+
+	const int OldParent = _NodeArray[Sibling].Parent;
+	const int NewParent = AllocNode();
+	SceneBVHNode& Parent = _NodeArray[NewParent];
+	Parent.Parent = OldParent;
+	Parent.Child[0] = Sibling;
+	Parent.Child[1] = Leaf;
+	BoxUnion(_NodeArray[Sibling].Min, _NodeArray[Sibling].Max, LeafMin, LeafMax, Parent.Min, Parent.Max);
+	_NodeArray[Sibling].Parent = NewParent;
+	_NodeArray[Leaf].Parent = NewParent;
+
+	if(OldParent == -1)
+		_Root = NewParent;
+	else
+		_NodeArray[OldParent].Child[_NodeArray[OldParent].Child[0] == Sibling ? 0 : 1] = NewParent;
+
+	RefitUpward(NewParent);
+}
+
+void SceneBVH::RemoveLeaf( int Leaf )
+{
+	if(Leaf == _Root)
+	{
+		_Root = -1;
+		return;
+	}
+
+	// the sibling takes the parent's place
+	const int Parent = _NodeArray[Leaf].Parent;
+	const int GrandParent = _NodeArray[Parent].Parent;
+	const int Sibling = _NodeArray[Parent].Child[_NodeArray[Parent].Child[0] == Leaf ? 1 : 0];
+	_NodeArray[Sibling].Parent = GrandParent;
+	FreeNode(Parent);
+	_NodeArray[Leaf].Parent = -1;
+
+	if(GrandParent == -1)
+	{
+		_Root = Sibling;
+		return;
+	}
+	_NodeArray[GrandParent].Child[_NodeArray[GrandParent].Child[0] == Parent ? 0 : 1] = Sibling;
+	RefitUpward(GrandParent);
+}
+
+void SceneBVH::RefitNode( int Node )
+{
+	SceneBVHNode& N = _NodeArray[Node];
+	const SceneBVHNode& A = _NodeArray[N.Child[0]];
+	const SceneBVHNode& B = _NodeArray[N.Child[1]];
+	BoxUnion(A.Min, A.Max, B.Min, B.Max, N.Min, N.Max);
+}
+
+void SceneBVH::RefitUpward( int Node )
+{
+	while(Node != -1)
+	{
+		RefitNode(Node);
+		Rotate(Node);
+		Node = _NodeArray[Node].Parent;
+	}
+}
+
+void SceneBVH::Rotate( int Node )
+{
+	// swapping a child with one of its sibling's children changes the area of that sibling only,
+	// the node's own box keeps the same leaves. take the swap that shrinks it the most
+	const SceneBVHNode& N = _NodeArray[Node];
+	int BestChild = -1;
+	int BestGrandChild = -1;
+	float BestGain = 0.f;
+	for(int c=0;c<2;c++)
+	{
+		const SceneBVHNode& Moved = _NodeArray[N.Child[c]];
+		const SceneBVHNode& Other = _NodeArray[N.Child[1 - c]];
+		if(Other.Child[0] == -1)
+			continue;
+
+		const float OtherArea = BoxArea(Other.Min, Other.Max);
+		for(int g=0;g<2;g++)
+		{
+			const SceneBVHNode& Kept = _NodeArray[Other.Child[1 - g]];
+			const float Gain = OtherArea - UnionArea(Moved.Min, Moved.Max, Kept.Min, Kept.Max);
+			if(Gain > BestGain)
+			{
+				BestGain = Gain;
+				BestChild = c;
+				BestGrandChild = g;
+			}
+		}
+	}
+	if(BestChild == -1)
+		return;
+
+	const int Moved = N.Child[BestChild];
+	const int Other = N.Child[1 - BestChild];
+	const int GrandChild = _NodeArray[Other].Child[BestGrandChild];
+	_NodeArray[Node].Child[BestChild] = GrandChild;
+	_NodeArray[GrandChild].Parent = Node;
+	_NodeArray[Other].Child[BestGrandChild] = Moved;
+	_NodeArray[Moved].Parent = Other;
+	RefitNode(Other);
+	_Stats.RotationCount++;
+}
+
+void SceneBVH::Refit()
+{
+	if(_DirtyArray.empty())
+		return;
+
+	// mark the paths from the grown leaves to the root, each node once
+	_RefitStamp++;
+	for(unsigned int i=0;i<_DirtyArray.size();i++)
+	{
+		const int Leaf = _DirtyArray[i];
+		// destroyed since, or its node reused for an inner node
+		if(_NodeArray[Leaf].Object == -1)
+			continue;
+		int Node = _NodeArray[Leaf].Parent;
+		while(Node != -1 && _NodeArray[Node].RefitStamp != _RefitStamp)
+		{
+			_NodeArray[Node].RefitStamp = _RefitStamp;
+			Node = _NodeArray[Node].Parent;
+		}
+	}
+	_DirtyArray.clear();
+	if(_Root == -1 || _NodeArray[_Root].RefitStamp != _RefitStamp)
+		return;
+
+	// post order over the marked nodes, ~Node on the stack once its children are pushed
+	_Stack.clear();
+	_Stack.push_back(_Root);
+	while(_Stack.size())
+	{
+		const int Entry = _Stack.back();
+		_Stack.pop_back();
+		if(Entry < 0)
+		{
+			RefitNode(~Entry);
+			Rotate(~Entry);
+			continue;
+		}
+
+		_Stack.push_back(~Entry);
+		for(int c=0;c<2;c++)
+		{
+			const int Child = _NodeArray[Entry].Child[c];
+			if(_NodeArray[Child].Child[0] != -1 && _NodeArray[Child].RefitStamp == _RefitStamp)
+				_Stack.push_back(Child);
+		}
+	}
+}
+
+void SceneBVH::Build()
+{
+	std::vector<int> LeafArray;
+	for(unsigned int i=0;i<_ObjectArray.size();i++)
+	{
+		if(_ObjectArray[i].Leaf != -1)
+			LeafArray.push_back(i);
+	}
+
+	_NodeArray.clear();
+	_FreeNode = -1;
+	_Root = -1;
+	_DirtyArray.clear();
+	if(LeafArray.empty())
+		return;
+
+	std::vector<XMFLOAT3> CentroidArray(LeafArray.size());	// by leaf node, the leaves are the first nodes
+	for(unsigned int i=0;i<LeafArray.size();i++)
+	{
+		SceneBVHObject& Object = _ObjectArray[LeafArray[i]];
+		const int Leaf = AllocNode();
+		Object.Leaf = Leaf;
+		_NodeArray[Leaf].Object = LeafArray[i];
+		FattenBox(Object, _NodeArray[Leaf].Min, _NodeArray[Leaf].Max);
+		CentroidArray[Leaf] = XMFLOAT3((_NodeArray[Leaf].Min.x + _NodeArray[Leaf].Max.x) * 0.5f, (_NodeArray[Leaf].Min.y + _NodeArray[Leaf].Max.y) * 0.5f, (_NodeArray[Leaf].Min.z + _NodeArray[Leaf].Max.z) * 0.5f);
+		LeafArray[i] = Leaf;
+	}
+
+	// ranges of LeafArray still to split, with the slot they hang from. a stack rather than recursion,
+	// lopsided splits of large scenes would run deep
+	struct BuildRange
+	{
+		int Begin;
+		int Count;
+		int Parent;
+		int Slot;
+	};
+	std::vector<BuildRange> RangeStack;
+	BuildRange First = { 0, (int)LeafArray.size(), -1, 0 };
+	RangeStack.push_back(First);
+	while(RangeStack.size())
+	{
+		const BuildRange Range = RangeStack.back();
+		RangeStack.pop_back();
+
+		int Node;
+		if(Range.Count == 1)
+		{
+			Node = LeafArray[Range.Begin];
+		}
+		else
+		{
+			Node = AllocNode();
+			XMFLOAT3 CentroidMin(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX);
+			XMFLOAT3 CentroidMax(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX);
+			XMFLOAT3 BoundsMin = CentroidMin;
+			XMFLOAT3 BoundsMax = CentroidMax;
+			for(int i=Range.Begin;i<Range.Begin+Range.Count;i++)
+			{
+				const SceneBVHNode& Leaf = _NodeArray[LeafArray[i]];
+				BoxUnion(BoundsMin, BoundsMax, Leaf.Min, Leaf.Max, BoundsMin, BoundsMax);
+				BoxUnion(CentroidMin, CentroidMax, CentroidArray[LeafArray[i]], CentroidArray[LeafArray[i]], CentroidMin, CentroidMax);
+			}
+			_NodeArray[Node].Min = BoundsMin;
+			_NodeArray[Node].Max = BoundsMax;
+
+			// binned along the widest axis of the centroids
+			const float Extent[3] = { CentroidMax.x - CentroidMin.x, CentroidMax.y - CentroidMin.y, CentroidMax.z - CentroidMin.z };
+			const int Axis = Extent[0] > Extent[1] ? (Extent[0] > Extent[2] ? 0 : 2) : (Extent[1] > Extent[2] ? 1 : 2);
+			const float AxisMin = (&CentroidMin.x)[Axis];
+			const float BinScale = Extent[Axis] > 0.f ? SCENE_BVH_SAH_BINS / Extent[Axis] : 0.f;
+			auto GetBin = [&](int Leaf) -> int
+			{
+				return Math::Min<int>((int)(((&CentroidArray[Leaf].x)[Axis] - AxisMin) * BinScale), SCENE_BVH_SAH_BINS - 1);
+			};
+
+			int Mid = Range.Begin + Range.Count / 2;
+			if(BinScale > 0.f)
+			{
+				int BinCount[SCENE_BVH_SAH_BINS] = { 0 };
+				XMFLOAT3 BinMin[SCENE_BVH_SAH_BINS];
+				XMFLOAT3 BinMax[SCENE_BVH_SAH_BINS];
+				for(int b=0;b<SCENE_BVH_SAH_BINS;b++)
+				{
+					BinMin[b] = XMFLOAT3(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX);
+					BinMax[b] = XMFLOAT3(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX);
+				}
+				for(int i=Range.Begin;i<Range.Begin+Range.Count;i++)
+				{
+					const int b = GetBin(LeafArray[i]);
+					BinCount[b]++;
+					BoxUnion(BinMin[b], BinMax[b], _NodeArray[LeafArray[i]].Min, _NodeArray[LeafArray[i]].Max, BinMin[b], BinMax[b]);
+				}
+
+				// cost of splitting after bin b is count * area on both sides, right sides swept first
+				float RightCost[SCENE_BVH_SAH_BINS];
+				XMFLOAT3 SideMin(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX);
+				XMFLOAT3 SideMax(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX);
+				int SideCount = 0;
+				for(int b=SCENE_BVH_SAH_BINS-1;b>0;b--)
+				{
+					BoxUnion(SideMin, SideMax, BinMin[b], BinMax[b], SideMin, SideMax);
+					SideCount += BinCount[b];
+					RightCost[b - 1] = SideCount ? SideCount * BoxArea(SideMin, SideMax) : 0.f;
+				}
+
+				SideMin = XMFLOAT3(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX);
+				SideMax = XMFLOAT3(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX);
+				SideCount = 0;
+				int BestSplit = -1;
+				float BestCost = FLOAT_MAX;
+				for(int b=0;b<SCENE_BVH_SAH_BINS-1;b++)
+				{
+					BoxUnion(SideMin, SideMax, BinMin[b], BinMax[b], SideMin, SideMax);
+					SideCount += BinCount[b];
+					if(SideCount == 0 || SideCount == Range.Count)
+						continue;
+					const float Cost = SideCount * BoxArea(SideMin, SideMax) + RightCost[b];
+					if(Cost < BestCost)
+					{
+						BestCost = Cost;
+						BestSplit = b;
+					}
+				}
+
+				if(BestSplit != -1)
+				{
+					Mid = std::partition(LeafArray.begin() + Range.Begin, LeafArray.begin() + Range.Begin + Range.Count,
+						[&](int Leaf) { return GetBin(Leaf) <= BestSplit; }) - LeafArray.begin();
+				}
+			}
+
+			BuildRange Left = { Range.Begin, Mid - Range.Begin, Node, 0 };
+			BuildRange Right = { Mid, Range.Begin + Range.Count - Mid, Node, 1 };
+			RangeStack.push_back(Left);
+			RangeStack.push_back(Right);
+		}
+
+		_NodeArray[Node].Parent = Range.Parent;
+		if(Range.Parent == -1)
+			_Root = Node;
+		else
+			_NodeArray[Range.Parent].Child[Range.Slot] = Node;
+	}
+}
+
+void SceneBVH::QueryFrustum( const XMFLOAT4* Planes, std::vector<int>& Out )
+{
+	if(_Root == -1)
+		return;
+
+	_Stack.clear();
+	_MaskStack.clear();
+	_Stack.push_back(_Root);
+	_MaskStack.push_back(0x3f);
+	while(_Stack.size())
+	{
+		const SceneBVHNode& Node = _NodeArray[_Stack.back()];
+		int Mask = _MaskStack.back();
+		_Stack.pop_back();
+		_MaskStack.pop_back();
+		_Stats.VisitedCount++;
+
+		// below a node inside every plane nothing is tested again
+		if(Node.Child[0] == -1)
+		{
+			const SceneBVHObject& Object = _ObjectArray[Node.Object];
+			if(Mask && !FrustumTestBox(Planes, Object.Min, Object.Max, Mask))
+				continue;
+			Out.push_back(Object.UserData);
+			_Stats.ReturnedCount++;
+			continue;
+		}
+
+		if(Mask && !FrustumTestBox(Planes, Node.Min, Node.Max, Mask))
+			continue;
+		for(int c=0;c<2;c++)
+		{
+			_Stack.push_back(Node.Child[c]);
+			_MaskStack.push_back(Mask);
+		}
+	}
+}
+
+void SceneBVH::QuerySphere( const XMFLOAT3& Center, float Radius, std::vector<int>& Out )
+{
+	if(_Root == -1)
+		return;
+
+	_Stack.clear();
+	_Stack.push_back(_Root);
+	while(_Stack.size())
+	{
+		const SceneBVHNode& Node = _NodeArray[_Stack.back()];
+		_Stack.pop_back();
+		_Stats.VisitedCount++;
+
+		if(Node.Child[0] == -1)
+		{
+			const SceneBVHObject& Object = _ObjectArray[Node.Object];
+			if(SphereTestBox(Center, Radius, Object.Min, Object.Max))
+			{
+				Out.push_back(Object.UserData);
+				_Stats.ReturnedCount++;
+			}
+			continue;
+		}
+
+		if(!SphereTestBox(Center, Radius, Node.Min, Node.Max))
+			continue;
+		_Stack.push_back(Node.Child[0]);
+		_Stack.push_back(Node.Child[1]);
+	}
+}
+
+void SceneBVH::QueryAABB( const XMFLOAT3& Min, const XMFLOAT3& Max, std::vector<int>& Out )
+{
+	if(_Root == -1)
+		return;
+
+	_Stack.clear();
+	_Stack.push_back(_Root);
+	while(_Stack.size())
+	{
+		const SceneBVHNode& Node = _NodeArray[_Stack.back()];
+		_Stack.pop_back();
+		_Stats.VisitedCount++;
+
+		if(Node.Child[0] == -1)
+		{
+			const SceneBVHObject& Object = _ObjectArray[Node.Object];
+			if(BoxOverlaps(Min, Max, Object.Min, Object.Max))
+			{
+				Out.push_back(Object.UserData);
+				_Stats.ReturnedCount++;
+			}
+			continue;
+		}
+
+		if(!BoxOverlaps(Min, Max, Node.Min, Node.Max))
+			continue;
+		_Stack.push_back(Node.Child[0]);
+		_Stack.push_back(Node.Child[1]);
+	}
+}
+
+void SceneBVH::QueryRay( const XMFLOAT3& Origin, const XMFLOAT3& Dir, float MaxT, std::vector<int>& Out )
+{
+	const XMFLOAT3 InvDir(1.f / Dir.x, 1.f / Dir.y, 1.f / Dir.z);
+	if(_Root == -1 || RayTestBox(Origin, InvDir, MaxT, _NodeArray[_Root].Min, _NodeArray[_Root].Max) < 0.f)
+		return;
+
+	// a node is on the stack once the segment is known to enter its box
+	_Stack.clear();
+	_Stack.push_back(_Root);
+	while(_Stack.size())
+	{
+		const SceneBVHNode& Node = _NodeArray[_Stack.back()];
+		_Stack.pop_back();
+		_Stats.VisitedCount++;
+
+		if(Node.Child[0] == -1)
+		{
+			const SceneBVHObject& Object = _ObjectArray[Node.Object];
+			if(RayTestBox(Origin, InvDir, MaxT, Object.Min, Object.Max) >= 0.f)
+			{
+				Out.push_back(Object.UserData);
+				_Stats.ReturnedCount++;
+			}
+			continue;
+		}
+
+		// the farther child goes on the stack first
+		const float Enter0 = RayTestBox(Origin, InvDir, MaxT, _NodeArray[Node.Child[0]].Min, _NodeArray[Node.Child[0]].Max);
+		const float Enter1 = RayTestBox(Origin, InvDir, MaxT, _NodeArray[Node.Child[1]].Min, _NodeArray[Node.Child[1]].Max);
+		const int Near = Enter1 >= 0.f && (Enter0 < 0.f || Enter1 < Enter0) ? 1 : 0;
+		const float NearEnter = Near ? Enter1 : Enter0;
+		const float FarEnter = Near ? Enter0 : Enter1;
+		if(FarEnter >= 0.f)
+			_Stack.push_back(Node.Child[1 - Near]);
+		if(NearEnter >= 0.f)
+			_Stack.push_back(Node.Child[Near]);
+	}
+}
+
+void SceneBVH::ResetStats()
+{
+	_Stats.VisitedCount = 0;
+	_Stats.ReturnedCount = 0;
+	_Stats.ReinsertCount = 0;
+	_Stats.RotationCount = 0;
+}
+
+int SceneBVH::GetHeight() const
+{
+	if(_Root == -1)
+		return 0;
+
+	int Height = 0;
+	std::vector<std::pair<int, int> > Stack;
+	Stack.push_back(std::make_pair(_Root, 1));
+	while(Stack.size())
+	{
+		const std::pair<int, int> Entry = Stack.back();
+		Stack.pop_back();
+		Height = Math::Max<int>(Height, Entry.second);
+		const SceneBVHNode& Node = _NodeArray[Entry.first];
+		if(Node.Child[0] == -1)
+			continue;
+		Stack.push_back(std::make_pair(Node.Child[0], Entry.second + 1));
+		Stack.push_back(std::make_pair(Node.Child[1], Entry.second + 1));
+	}
+	return Height;
+}
+
+float SceneBVH::GetSAHCost() const
+{
+	if(_Root == -1 || _NodeArray[_Root].Child[0] == -1)
+		return 0.f;
+
+	float InnerArea = 0.f;
+	std::vector<int> Stack;
+	Stack.push_back(_Root);
+	while(Stack.size())
+	{
+		const SceneBVHNode& Node = _NodeArray[Stack.back()];
+		Stack.pop_back();
+		if(Node.Child[0] == -1)
+			continue;
+		InnerArea += BoxArea(Node.Min, Node.Max);
+		Stack.push_back(Node.Child[0]);
+		Stack.push_back(Node.Child[1]);
+	}
+	const float RootArea = BoxArea(_NodeArray[_Root].Min, _NodeArray[_Root].Max);
+	return RootArea > 0.f ? InnerArea / RootArea : 0.f;
+}
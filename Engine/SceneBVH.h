@@ -0,0 +1,93 @@
+#pragma once
+#include "MathTypes.h"
+#include <vector>
+
+#define SCENE_BVH_SAH_BINS		16
+#define SCENE_BVH_FAT_SCALE		0.1f	// moving objects' leaf boxes grow by this much of their size on each side
+
+// leaves hold one object each, Child[0] is -1 at a leaf
+struct SceneBVHNode
+{
+	XMFLOAT3 Min;
+	XMFLOAT3 Max;
+	int Parent;		// next free node while on the free list
+	int Child[2];
+	int Object;		// -1 for inner nodes
+	unsigned int RefitStamp;
+};
+
+struct SceneBVHObject
+{
+	XMFLOAT3 Min;	// tight box, the leaf's box is this one fattened
+	XMFLOAT3 Max;
+	int Leaf;		// -1 while the proxy is free
+	int UserData;
+	bool bStatic;	// no fattening
+};
+
+struct SceneBVHStats
+{
+	int VisitedCount;	// nodes touched by the queries since the last ResetStats
+	int ReturnedCount;
+	int ReinsertCount;	// moves that left their leaf box by more than a refit can absorb
+	int RotationCount;
+};
+
+// dynamic aabb tree over the scene's objects. a binned sah build for bulk loads, then incremental:
+// insertion down the cheapest sah path, moves absorbed by fattened leaf boxes and refit bottom up,
+// tree rotations on the refit path keeping the sah cost from drifting as objects move.
+// queries test the tight boxes at the leaves and append the objects' user data. no device needed
+class SceneBVH
+{
+public:
+	std::vector<SceneBVHNode> _NodeArray;
+	std::vector<SceneBVHObject> _ObjectArray;	// indexed by proxy
+	int _Root;
+	int _FreeNode;
+	std::vector<int> _FreeObjectArray;
+	std::vector<int> _DirtyArray;	// leaves grown since the last Refit
+	unsigned int _RefitStamp;
+	SceneBVHStats _Stats;
+
+	// returns the proxy of the object
+	int CreateProxy(const XMFLOAT3& Min, const XMFLOAT3& Max, int UserData, bool bStatic);
+	void DestroyProxy(int Proxy);
+	// new tight box of a moving object. cheap while it stays in its leaf box, otherwise the leaf grows
+	// and waits for Refit, or is reinserted when it jumped clear of it. returns whether the tree changed
+	bool MoveProxy(int Proxy, const XMFLOAT3& Min, const XMFLOAT3& Max);
+	void SetUserData(int Proxy, int UserData) { _ObjectArray[Proxy].UserData = UserData; }
+	int GetUserData(int Proxy) const { return _ObjectArray[Proxy].UserData; }
+
+	// binned sah build over every live proxy, replaces the tree
+	void Build();
+	// brings the inner boxes over the moves since the last call, call before querying
+	void Refit();
+
+	// Planes as FrustumCuller::ExtractPlanes, inside is dot(Plane, p) >= 0
+	void QueryFrustum(const XMFLOAT4* Planes, std::vector<int>& Out);
+	void QuerySphere(const XMFLOAT3& Center, float Radius, std::vector<int>& Out);
+	void QueryAABB(const XMFLOAT3& Min, const XMFLOAT3& Max, std::vector<int>& Out);
+	// objects whose box the segment Origin + t * Dir, t in [0, MaxT] passes through, nearer subtrees first
+	void QueryRay(const XMFLOAT3& Origin, const XMFLOAT3& Dir, float MaxT, std::vector<int>& Out);
+
+	void ResetStats();
+	int GetHeight() const;
+	// sum of the inner nodes' surface areas over the root's
+	float GetSAHCost() const;
+	int GetProxyCount() const { return _ObjectArray.size() - _FreeObjectArray.size(); }
+
+	SceneBVH();
+
+private:
+	std::vector<int> _Stack;	// query scratch
+	std::vector<int> _MaskStack;	// planes still to test, per frustum stack entry
+
+	int AllocNode();
+	void FreeNode(int Node);
+	void InsertLeaf(int Leaf);
+	void RemoveLeaf(int Leaf);
+	void RefitUpward(int Node);
+	void RefitNode(int Node);
+	void Rotate(int Node);
+	void FattenBox(const SceneBVHObject& Object, XMFLOAT3& OutMin, XMFLOAT3& OutMax) const;
+};
@@ -3,6 +3,34 @@
 #include "ShaderRes.h"
 #include "Engine.h"
 
+void GetMeshInputLayout( int NumTex, bool GpuSkin, bool Compressed, std::vector<D3D11_INPUT_ELEMENT_DESC>& OutLayout )
+{
+	// same element order as the vertex structs in StaticMesh.h/SkeletalMesh.h
+	D3D11_INPUT_ELEMENT_DESC Position = { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+	D3D11_INPUT_ELEMENT_DESC Normal = { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+	D3D11_INPUT_ELEMENT_DESC TexCoord = { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+	D3D11_INPUT_ELEMENT_DESC Weights = { "WEIGHTS", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+	D3D11_INPUT_ELEMENT_DESC Bones = { "BONES", 0, DXGI_FORMAT_R8G8B8A8_UINT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+
+	if(Compressed)
+	{
+		Position.Format = DXGI_FORMAT_R16G16B16A16_SNORM;
+		Normal.Format = DXGI_FORMAT_R16G16_SNORM;
+		TexCoord.Format = DXGI_FORMAT_R16G16_FLOAT;
+	}
+
+	OutLayout.clear();
+	OutLayout.push_back(Position);
+	OutLayout.push_back(Normal);
+	if(NumTex == 1)
+		OutLayout.push_back(TexCoord);
+	if(GpuSkin)
+	{
+		OutLayout.push_back(Weights);
+		OutLayout.push_back(Bones);
+	}
+}
+
 ShaderRes::ShaderRes(void)
 	:VertexLayout(NULL),
 	VertexShader(NULL),
@@ -37,12 +65,30 @@ void ShaderRes::CreateShader(const char* FileName, ShaderMapKey& SKey)
 		D3D10_SHADER_MACRO Define = {"GPUSKINNING", "1"};
 		Defines.push_back(Define);
 	}
+	else if(SKey.VertexProcessingType == GpuSkinDualQuatVertex)
+	{
+		D3D10_SHADER_MACRO Define = {"GPUSKINNING", "1"};
+		Defines.push_back(Define);
+		D3D10_SHADER_MACRO DualQuatDefine = {"DUALQUAT_SKINNING", "1"};
+		Defines.push_back(DualQuatDefine);
+	}
 	else if(SKey.VertexProcessingType == StaticVertex)
 	{
 		D3D10_SHADER_MACRO Define = {"GPUSKINNING", "0"};
 		Defines.push_back(Define);
 	}
 
+	if(SKey.Compressed)
+	{
+		D3D10_SHADER_MACRO Define = {"COMPRESSED", "1"};
+		Defines.push_back(Define);
+	}
+	else
+	{
+		D3D10_SHADER_MACRO Define = {"COMPRESSED", "0"};
+		Defines.push_back(Define);
+	}
+
 	D3D10_SHADER_MACRO Define;
 	memset(&Define, 0, sizeof(D3D10_SHADER_MACRO));
 	Defines.push_back(Define);
@@ -72,71 +118,12 @@ void ShaderRes::CreateShader(const char* FileName, ShaderMapKey& SKey)
 		assert(false);
 	}
 
-	if(SKey.NumTex == 0)
-	{
-		if(SKey.VertexProcessingType == StaticVertex)
-		{
-			D3D11_INPUT_ELEMENT_DESC layout[] =
-			{
-				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			};
-			UINT numElements = ARRAYSIZE( layout );
-
-			// Create the input layout
-			hr = GEngine->_Device->CreateInputLayout( layout, numElements, pVSBlob->GetBufferPointer(),
-				pVSBlob->GetBufferSize(), &VertexLayout );
-		}
-		else if(SKey.VertexProcessingType == GpuSkinVertex)
-		{
-			D3D11_INPUT_ELEMENT_DESC layout[] =
-			{
-				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "WEIGHTS", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "BONES", 0, DXGI_FORMAT_R8G8B8A8_UINT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			};
-			UINT numElements = ARRAYSIZE( layout );
-
-			// Create the input layout
-			hr = GEngine->_Device->CreateInputLayout( layout, numElements, pVSBlob->GetBufferPointer(),
-				pVSBlob->GetBufferSize(), &VertexLayout );
-		}
-	}
-	else if(SKey.NumTex == 1)
-	{
-		if(SKey.VertexProcessingType == StaticVertex)
-		{
-			D3D11_INPUT_ELEMENT_DESC layout[] =
-			{
-				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			};
-			UINT numElements = ARRAYSIZE( layout );
-
-			// Create the input layout
-			hr = GEngine->_Device->CreateInputLayout( layout, numElements, pVSBlob->GetBufferPointer(),
-				pVSBlob->GetBufferSize(), &VertexLayout );
-		}
-		else if(SKey.VertexProcessingType == GpuSkinVertex)
-		{
-			D3D11_INPUT_ELEMENT_DESC layout[] =
-			{
-				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "WEIGHTS", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "BONES", 0, DXGI_FORMAT_R8G8B8A8_UINT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			};
-			UINT numElements = ARRAYSIZE( layout );
-
-			// Create the input layout
-			hr = GEngine->_Device->CreateInputLayout( layout, numElements, pVSBlob->GetBufferPointer(),
-				pVSBlob->GetBufferSize(), &VertexLayout );
-		}
-	}
-	
+	std::vector<D3D11_INPUT_ELEMENT_DESC> Layout;
+	GetMeshInputLayout(SKey.NumTex, SKey.VertexProcessingType != StaticVertex, SKey.Compressed, Layout);
+
+	// Create the input layout
+	hr = GEngine->_Device->CreateInputLayout( &Layout[0], Layout.size(), pVSBlob->GetBufferPointer(),
+		pVSBlob->GetBufferSize(), &VertexLayout );
 
 	pVSBlob->Release();
 	if( FAILED( hr ) )
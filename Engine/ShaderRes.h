@@ -1,11 +1,13 @@
 #pragma once
 
 #include <d3d11.h>
+#include <vector>
 
 enum EVertexProcessingType
 {
 	StaticVertex,
-	GpuSkinVertex
+	GpuSkinVertex,
+	GpuSkinDualQuatVertex
 };
 
 
@@ -14,6 +16,7 @@ struct ShaderMapKey
 {
 	int NumTex;
 	EVertexProcessingType VertexProcessingType;
+	bool Compressed;
 	bool operator<(const ShaderMapKey& other) const        
 	{             
 		if( NumTex < other.NumTex ) return true;
@@ -22,10 +25,16 @@ struct ShaderMapKey
 		if( VertexProcessingType < other.VertexProcessingType ) return true;
 		if( VertexProcessingType > other.VertexProcessingType ) return false;
 
+		if( Compressed < other.Compressed ) return true;
+		if( Compressed > other.Compressed ) return false;
+
 		return false;
 	};
 };
 
+// mesh vertex input layout, shared by every shader that draws StaticMesh/SkeletalMesh
+void GetMeshInputLayout(int NumTex, bool GpuSkin, bool Compressed, std::vector<D3D11_INPUT_ELEMENT_DESC>& OutLayout);
+
 class ShaderRes
 {
 public:
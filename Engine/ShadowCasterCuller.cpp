@@ -0,0 +1,86 @@
+#include <math.h>
+
+#include "ShadowCasterCuller.h"
+#include "MathUtil.h"
+
+void ShadowCasterCuller::BeginFrame( const XMMATRIX& LightView )
+{
+	XMStoreFloat4x4(&_LightView, LightView);
+	_LightSpaceBounds.Clear();
+	_FinerRectArray.clear();
+}
+
+int ShadowCasterCuller::AddCaster( const XMFLOAT3& Min, const XMFLOAT3& Max )
+{
+	// center goes through the matrix, extents through its absolute value
+	const float Center[3] = { (Min.x + Max.x) * 0.5f, (Min.y + Max.y) * 0.5f, (Min.z + Max.z) * 0.5f };
+	const float Extent[3] = { (Max.x - Min.x) * 0.5f, (Max.y - Min.y) * 0.5f, (Max.z - Min.z) * 0.5f };
+	float LightCenter[3], LightExtent[3];
+	for(int c=0;c<3;c++)
+	{
+		LightCenter[c] = _LightView.m[3][c];
+		LightExtent[c] = 0.f;
+		for(int r=0;r<3;r++)
+		{
+			LightCenter[c] += Center[r] * _LightView.m[r][c];
+			LightExtent[c] += Extent[r] * fabsf(_LightView.m[r][c]);
+		}
+	}
+	return _LightSpaceBounds.Add(
+		XMFLOAT3(LightCenter[0] - LightExtent[0], LightCenter[1] - LightExtent[1], LightCenter[2] - LightExtent[2]),
+		XMFLOAT3(LightCenter[0] + LightExtent[0], LightCenter[1] + LightExtent[1], LightCenter[2] + LightExtent[2]));
+}
+
+bool ShadowCasterCuller::CullCascade( const XMFLOAT2& OrthoMin, const XMFLOAT2& OrthoMax, bool bRecordRect,
+	unsigned char* OutDraw, float& OutMinZ, float& OutMaxZ, ShadowCascadeCullStats& OutStats )
+{
+	const int Count = _LightSpaceBounds._Count;
+
+	// the rect's four sides as planes in light space, depth is left open
+	XMFLOAT4 Planes[6] =
+	{
+		XMFLOAT4(1.f, 0.f, 0.f, -OrthoMin.x),
+		XMFLOAT4(-1.f, 0.f, 0.f, OrthoMax.x),
+		XMFLOAT4(0.f, 1.f, 0.f, -OrthoMin.y),
+		XMFLOAT4(0.f, -1.f, 0.f, OrthoMax.y),
+		XMFLOAT4(0.f, 0.f, 0.f, 1.f),
+		XMFLOAT4(0.f, 0.f, 0.f, 1.f),
+	};
+	_Culler.SetPlanes(Planes);
+	_Overlap.resize(Count + 1);
+	OutStats.CasterCount = _Culler.Cull(_LightSpaceBounds, 0, Count, &_Overlap[0]);
+	OutStats.SkippedCount = 0;
+	OutStats.DrawnCount = 0;
+
+	OutMinZ = FLOAT_MAX;
+	OutMaxZ = -FLOAT_MAX;
+	for(int i=0;i<Count;i++)
+	{
+		OutDraw[i] = 0;
+		if(!_Overlap[i])
+			continue;
+
+		OutMinZ = Math::Min<float>(OutMinZ, _LightSpaceBounds._MinZ[i]);
+		OutMaxZ = Math::Max<float>(OutMaxZ, _LightSpaceBounds._MaxZ[i]);
+
+		// the finer cascade shadows everything this caster can reach, shadows of all cascades multiply
+		bool bInFiner = false;
+		for(unsigned int f=0;f<_FinerRectArray.size() && !bInFiner;f++)
+		{
+			const XMFLOAT4& Rect = _FinerRectArray[f];
+			bInFiner = _LightSpaceBounds._MinX[i] >= Rect.x && _LightSpaceBounds._MinY[i] >= Rect.y
+				&& _LightSpaceBounds._MaxX[i] <= Rect.z && _LightSpaceBounds._MaxY[i] <= Rect.w;
+		}
+		if(bInFiner)
+		{
+			OutStats.SkippedCount++;
+			continue;
+		}
+		OutDraw[i] = 1;
+		OutStats.DrawnCount++;
+	}
+
+	if(bRecordRect)
+		_FinerRectArray.push_back(XMFLOAT4(OrthoMin.x, OrthoMin.y, OrthoMax.x, OrthoMax.y));
+	return OutStats.CasterCount > 0;
+}
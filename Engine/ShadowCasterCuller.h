@@ -0,0 +1,40 @@
+#pragma once
+#include <d3d11.h>
+#include <xnamath.h>
+#include <vector>
+
+#include "FrustumCuller.h"
+
+struct ShadowCascadeCullStats
+{
+	int CasterCount;	// overlapping the cascade's ortho rect
+	int SkippedCount;	// of those, left to a finer cascade
+	int DrawnCount;
+};
+
+// picks the shadow casters of each cascade of a directional light. every cascade shares the light view,
+// the casters' bounds go to light space once and each cascade tests them against its ortho rect, unbounded
+// in depth toward and away from the light. no device needed
+class ShadowCasterCuller
+{
+public:
+	AABBSoaArray _LightSpaceBounds;
+	FrustumCuller _Culler;
+	std::vector<unsigned char> _Overlap;	// scratch of the current cascade
+
+	// finer cascades' ortho rects so far this frame, a caster inside one of them is left to it
+	std::vector<XMFLOAT4> _FinerRectArray;	// min x, min y, max x, max y
+
+	void BeginFrame(const XMMATRIX& LightView);
+	// world space box, returns the caster index
+	int AddCaster(const XMFLOAT3& Min, const XMFLOAT3& Max);
+
+	// OutDraw[i] is 1 for the casters the cascade has to draw. OutMinZ/OutMaxZ are the light space depth range
+	// of every caster over the rect, skipped ones included since they still receive. false when nothing overlaps.
+	// bRecordRect makes casters inside this rect skippable in the cascades culled after it
+	bool CullCascade(const XMFLOAT2& OrthoMin, const XMFLOAT2& OrthoMax, bool bRecordRect,
+		unsigned char* OutDraw, float& OutMinZ, float& OutMaxZ, ShadowCascadeCullStats& OutStats);
+
+private:
+	XMFLOAT4X4 _LightView;
+};
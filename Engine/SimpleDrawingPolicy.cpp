@@ -2,6 +2,8 @@
 
 #include "SimpleDrawingPolicy.h"
 #include "StateManager.h"
+#include "SkeletalMeshComponent.h"
+#include "BonePaletteArena.h"
 
 struct ConstantBufferStruct
 {
@@ -10,6 +12,10 @@ struct ConstantBufferStruct
 	XMMATRIX mProjection;
 	XMFLOAT4 vLightDir[2];
 	XMFLOAT4 vLightColor[2];
+	XMFLOAT4 PositionScale;
+	XMFLOAT4 PositionBias;
+	UINT BoneBase;		// first float4 of the draw's bones in the palette arena
+	UINT BonePad[3];
 };
 
 SimpleDrawingPolicy::SimpleDrawingPolicy(void)
@@ -38,7 +44,7 @@ SimpleDrawingPolicy::~SimpleDrawingPolicy(void)
 	if(ConstantBuffer) ConstantBuffer->Release();
 }
 
-void SimpleDrawingPolicy::DrawStaticMesh( StaticMesh* pMesh, XMMATRIX& ViewMat, XMMATRIX& ProjectionMat )
+void SimpleDrawingPolicy::DrawStaticMesh( StaticMesh* pMesh, XMMATRIX& ViewMat, XMMATRIX& ProjectionMat, const unsigned char* SubMeshVisible )
 {
 	XMMATRIX World;
 
@@ -51,16 +57,18 @@ void SimpleDrawingPolicy::DrawStaticMesh( StaticMesh* pMesh, XMMATRIX& ViewMat,
 	cb.vLightDir[1] = vLightDirs[1];
 	cb.vLightColor[0] = vLightColors[0];
 	cb.vLightColor[1] = vLightColors[1];
+	pMesh->GetPositionScaleBias(cb.PositionScale, cb.PositionBias);
+	cb.BoneBase = 0;
 	GEngine->_ImmediateContext->UpdateSubresource( ConstantBuffer, 0, NULL, &cb, 0, 0 );
 
-	ShaderRes* pShaderRes = GetShaderRes(pMesh->_NumTexCoord, StaticVertex);
+	ShaderRes* pShaderRes = GetShaderRes(pMesh->_NumTexCoord, StaticVertex, pMesh->_CompressedVertex);
 
 
 	pShaderRes->SetShaderRes();
 
 	UINT offset = 0;
 	GEngine->_ImmediateContext->IASetVertexBuffers( 0, 1, &pMesh->_VertexBuffer, &pMesh->_VertexStride, &offset );
-	GEngine->_ImmediateContext->IASetIndexBuffer( pMesh->_IndexBuffer, DXGI_FORMAT_R32_UINT, 0 );
+	GEngine->_ImmediateContext->IASetIndexBuffer( pMesh->_IndexBuffer, pMesh->GetIndexFormat(), 0 );
 
 	GEngine->_ImmediateContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
 
@@ -70,14 +78,22 @@ void SimpleDrawingPolicy::DrawStaticMesh( StaticMesh* pMesh, XMMATRIX& ViewMat,
 
 	SET_PS_SAMPLER(0, SS_LINEAR);
 
+	if(SubMeshVisible)
+	{
+		DrawVisibleSubMeshes(pMesh, SubMeshVisible);
+		return;
+	}
 	GEngine->_ImmediateContext->DrawIndexed( pMesh->_NumTriangle*3, 0, 0 );        // 36 vertices needed for 12 triangles in a triangle list
 }
 
 void SimpleDrawingPolicy::DrawSkeletalMeshData( SkeletalMeshRenderData* pRenderData, XMMATRIX& ViewMat, XMMATRIX& ProjectionMat )
 {
-	XMMATRIX World;
+	// the arena was full this frame, no bones to skin with
+	const bool bPreSkinned = pRenderData->_bPreSkinned;
+	if(!bPreSkinned && pRenderData->_BoneBase == BONE_ARENA_INVALID)
+		return;
 
-	World = XMMatrixIdentity();
+	XMMATRIX World = XMLoadFloat4x4(&pRenderData->_SkeletalMeshComponent->_World);
 	ConstantBufferStruct cb;
 	cb.mWorld = XMMatrixTranspose( World );
 	cb.mView = XMMatrixTranspose(  ViewMat );
@@ -86,16 +102,40 @@ void SimpleDrawingPolicy::DrawSkeletalMeshData( SkeletalMeshRenderData* pRenderD
 	cb.vLightDir[1] = vLightDirs[1];
 	cb.vLightColor[0] = vLightColors[0];
 	cb.vLightColor[1] = vLightColors[1];
+	if(bPreSkinned)
+	{
+		// already skinned this frame, float vertices
+		cb.PositionScale = XMFLOAT4(1.f, 1.f, 1.f, 1.f);
+		cb.PositionBias = XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+		cb.BoneBase = 0;
+	}
+	else
+	{
+		pRenderData->_SkeletalMesh->GetPositionScaleBias(cb.PositionScale, cb.PositionBias);
+		cb.BoneBase = pRenderData->_BoneBase;
+	}
 	GEngine->_ImmediateContext->UpdateSubresource( ConstantBuffer, 0, NULL, &cb, 0, 0 );
 
-	ShaderRes* pShaderRes = GetShaderRes(pRenderData->_SkeletalMesh->_NumTexCoord, GpuSkinVertex);
+	ShaderRes* pShaderRes;
+	if(bPreSkinned)
+	{
+		pShaderRes = GetShaderRes(pRenderData->_SkeletalMesh->_NumTexCoord, StaticVertex, false);
+	}
+	else
+	{
+		const EVertexProcessingType SkinType = pRenderData->_SkeletalMeshComponent->_SkinningMode == SKIN_DUALQUAT ? GpuSkinDualQuatVertex : GpuSkinVertex;
+		pShaderRes = GetShaderRes(pRenderData->_SkeletalMesh->_NumTexCoord, SkinType, pRenderData->_SkeletalMesh->_CompressedVertex);
+	}
 
 
 	pShaderRes->SetShaderRes();
 
 	UINT offset = 0;
-	GEngine->_ImmediateContext->IASetVertexBuffers( 0, 1, &pRenderData->_SkeletalMesh->_VertexBuffer, &pRenderData->_SkeletalMesh->_VertexStride, &offset );
-	GEngine->_ImmediateContext->IASetIndexBuffer( pRenderData->_SkeletalMesh->_IndexBuffer, DXGI_FORMAT_R32_UINT, 0 );
+	if(bPreSkinned)
+		GEngine->_ImmediateContext->IASetVertexBuffers( 0, 1, &pRenderData->_PreSkinnedBuffer, &pRenderData->_PreSkinnedStride, &offset );
+	else
+		GEngine->_ImmediateContext->IASetVertexBuffers( 0, 1, &pRenderData->_SkeletalMesh->_VertexBuffer, &pRenderData->_SkeletalMesh->_VertexStride, &offset );
+	GEngine->_ImmediateContext->IASetIndexBuffer( pRenderData->_SkeletalMesh->_IndexBuffer, pRenderData->_SkeletalMesh->GetIndexFormat(), 0 );
 
 	GEngine->_ImmediateContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
 
@@ -103,7 +143,8 @@ void SimpleDrawingPolicy::DrawSkeletalMeshData( SkeletalMeshRenderData* pRenderD
 	GEngine->_ImmediateContext->VSSetConstantBuffers( 0, 1, &ConstantBuffer );
 	GEngine->_ImmediateContext->PSSetConstantBuffers( 0, 1, &ConstantBuffer );
 
-	GEngine->_ImmediateContext->VSSetShaderResources( 0, 1, &pRenderData->_BoneMatricesBufferRV );
+	if(!bPreSkinned)
+		GEngine->_ImmediateContext->VSSetShaderResources( 0, 1, &GEngine->_BonePaletteArena->_BufferRV );
 
 	SET_PS_SAMPLER(0, SS_LINEAR);
 
@@ -5,12 +5,16 @@
 #include "SkeletalMesh.h"
 #include "Engine.h"
 #include "LineBatcher.h"
+#include "MathUtil.h"
+#include "MeshOptimizer.h"
 
 const int TRIANGLE_VERTEX_COUNT = 3;
 const int VERTEX_STRIDE = 4;
 const int NORMAL_STRIDE = 3;
 const int UV_STRIDE = 2;
 
+bool SkeletalMesh::_bLogImportStats = false;
+
 SkeletalMesh::SkeletalMesh(void)
 	:_VertexBuffer(NULL),
 	_IndexBuffer(NULL),
@@ -20,6 +24,12 @@ SkeletalMesh::SkeletalMesh(void)
 	_NumTexCoord(0),
 	_NumTriangle(0),
 	_NumVertex(0),
+	_NumBone(0),
+	_CompressedVertex(false),
+	_IndexStride(sizeof(DWORD)),
+	_MaxLODCount(1),
+	_AABBMin(XMFLOAT3(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX)),
+	_AABBMax(XMFLOAT3(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX)),
 	_Skeleton(NULL),
 	_Pose(NULL)
 {
@@ -61,93 +71,48 @@ struct VertexSkinInfo
 
 };
 
-bool SkeletalMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
+bool SkeletalMesh::ImportFromMeshSource( const MeshSource& Source, const std::map<std::string, BoneIndexInfo>& InBoneIndexMap )
 {
-	if (!Mesh->GetNode())
-		return false;
+	const int PolygonCount = Source.GetPolygonCount();
+	const bool bHasMaterialIndice = Source._MaterialIndices.size() != 0;
 
-	FbxNode* pNode = Mesh->GetNode();
-	FbxAMatrix Geometry;
-	FbxVector4 Translation, Rotation, Scaling;
-	Translation = pNode->GetGeometricTranslation(FbxNode::eSourcePivot);
-	Rotation = pNode->GetGeometricRotation(FbxNode::eSourcePivot);
-	Scaling = pNode->GetGeometricScaling(FbxNode::eSourcePivot);
-	Geometry.SetT(Translation);
-	Geometry.SetR(Rotation);
-	Geometry.SetS(Scaling);
-
-	//For Single Matrix situation, obtain transfrom matrix from eDESTINATION_SET, which include pivot offsets and pre/post rotations.
-	FbxAMatrix& GlobalTransform = Importer->mScene->GetEvaluator()->GetNodeGlobalTransform(pNode);
-
-	FbxAMatrix TotalMatrix;
-	TotalMatrix = GlobalTransform * Geometry;
-
-	FbxAMatrix TotalMatrixForNormal;
-	TotalMatrixForNormal = TotalMatrix.Inverse();
-	TotalMatrixForNormal = TotalMatrixForNormal.Transpose();
-	
-	if (!Mesh->IsTriangleMesh())
+	if (bHasMaterialIndice)
 	{
-		FbxGeometryConverter lConverter(Mesh->GetNode()->GetFbxManager());
-		bool bSuccess;
-		Mesh = lConverter.TriangulateMeshAdvance(Mesh, bSuccess);
-	}
-	
-	const int PolygonCount = Mesh->GetPolygonCount();
-
-	FbxLayerElementArrayTemplate<int>* MaterialIndice = NULL;
-	FbxGeometryElement::EMappingMode MaterialMappingMode = FbxGeometryElement::eNone;
-
-
-	FbxGeometryElementMaterial * ElementMaterial = Mesh->GetElementMaterial();
-	if (ElementMaterial)
-	{
-		MaterialIndice = &ElementMaterial->GetIndexArray();
-		MaterialMappingMode = ElementMaterial->GetMappingMode();
-		if (MaterialIndice && MaterialMappingMode == FbxGeometryElement::eByPolygon)
+		// Count the faces of each material
+		for (int PolygonIndex = 0; PolygonIndex < PolygonCount; ++PolygonIndex)
 		{
-			FBX_ASSERT(MaterialIndice->GetCount() == PolygonCount);
-			if (MaterialIndice->GetCount() == PolygonCount)
+			const int lMaterialIndex = Source._MaterialIndices[PolygonIndex];
+			if ((int)_SubMeshArray.size() < lMaterialIndex + 1)
 			{
-				// Count the faces of each material
-				for (int PolygonIndex = 0; PolygonIndex < PolygonCount; ++PolygonIndex)
-				{
-					const int lMaterialIndex = MaterialIndice->GetAt(PolygonIndex);
-					if ((int)_SubMeshArray.size() < lMaterialIndex + 1)
-					{
-						_SubMeshArray.resize(lMaterialIndex + 1);
-					}
-					if (_SubMeshArray[lMaterialIndex] == NULL)
-					{
-						_SubMeshArray[lMaterialIndex] = new SubMesh;
-					}
-					_SubMeshArray[lMaterialIndex]->_TriangleCount += 1;
-				}
-
-				// Make sure we have no "holes" (NULL) in the mSubMeshes table. This can happen
-				// if, in the loop above, we resized the mSubMeshes by more than one slot.
-				for (int i = 0; i < (int)_SubMeshArray.size(); i++)
-				{
-					if (_SubMeshArray[i] == NULL)
-						_SubMeshArray[i] = new SubMesh;
+				_SubMeshArray.resize(lMaterialIndex + 1);
+			}
+			if (_SubMeshArray[lMaterialIndex] == NULL)
+			{
+				_SubMeshArray[lMaterialIndex] = new SubMesh;
+			}
+			_SubMeshArray[lMaterialIndex]->_TriangleCount += 1;
+		}
 
-				}
+		// Make sure we have no "holes" (NULL) in the mSubMeshes table. This can happen
+		// if, in the loop above, we resized the mSubMeshes by more than one slot.
+		for (int i = 0; i < (int)_SubMeshArray.size(); i++)
+		{
+			if (_SubMeshArray[i] == NULL)
+				_SubMeshArray[i] = new SubMesh;
 
-				// Record the offset (how many vertex)
-				const int lMaterialCount = _SubMeshArray.size();
-				int lOffset = 0;
-				for (int lIndex = 0; lIndex < lMaterialCount; ++lIndex)
-				{
-					_SubMeshArray[lIndex]->_IndexOffset = lOffset;
-					lOffset += _SubMeshArray[lIndex]->_TriangleCount * 3;
-					// This will be used as counter in the following procedures, reset to zero
-					_SubMeshArray[lIndex]->_TriangleCount = 0;
-				}
-				FBX_ASSERT(lOffset == PolygonCount * 3);
-			}
 		}
 
-		
+		// Record the offset (how many vertex)
+		const int lMaterialCount = _SubMeshArray.size();
+		int lOffset = 0;
+		for (int lIndex = 0; lIndex < lMaterialCount; ++lIndex)
+		{
+			_SubMeshArray[lIndex]->_IndexOffset = lOffset;
+			lOffset += _SubMeshArray[lIndex]->_TriangleCount * 3;
+			// This will be used as counter in the following procedures, reset to zero
+			_SubMeshArray[lIndex]->_TriangleCount = 0;
+		}
+		FBX_ASSERT(lOffset == PolygonCount * 3);
 	}
 
 	// All faces will use the same material.
@@ -159,86 +124,43 @@ bool SkeletalMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 
 	// Congregate all the data of a mesh to be cached in VBOs.
 	// If normal or UV is by polygon vertex, record all vertex attributes by polygon vertex.
-	bool mHasNormal = Mesh->GetElementNormalCount() > 0;
-	bool mHasUV = Mesh->GetElementUVCount() > 0;
+	bool mHasNormal = Source._Normals.IsValid();
+	bool mHasUV = Source._UVs.IsValid();
 	bool mAllByControlPoint = true;
-	FbxGeometryElement::EMappingMode lNormalMappingMode = FbxGeometryElement::eNone;
-	FbxGeometryElement::EMappingMode lUVMappingMode = FbxGeometryElement::eNone;
-	if (mHasNormal)
+	if (mHasNormal && Source._Normals.Mapping != FbxGeometryElement::eByControlPoint)
 	{
-		lNormalMappingMode = Mesh->GetElementNormal(0)->GetMappingMode();
-		if (lNormalMappingMode == FbxGeometryElement::eNone)
-		{
-			mHasNormal = false;
-		}
-		if (mHasNormal && lNormalMappingMode != FbxGeometryElement::eByControlPoint)
-		{
-			//mAllByControlPoint = false;
-		}
+		mAllByControlPoint = false;
 	}
-	if (mHasUV)
+	if (mHasUV && Source._UVs.Mapping != FbxGeometryElement::eByControlPoint)
 	{
-		lUVMappingMode = Mesh->GetElementUV(0)->GetMappingMode();
-		if (lUVMappingMode == FbxGeometryElement::eNone)
-		{
-			mHasUV = false;
-		}
-		if (mHasUV && lUVMappingMode != FbxGeometryElement::eByControlPoint)
-		{
-			//mAllByControlPoint = false;
-		}
+		mAllByControlPoint = false;
 	}
 
-
 	// Allocate the array memory, by control point or by polygon vertex.
-	int lPolygonVertexCount = Mesh->GetControlPointsCount();
+	int lPolygonVertexCount = Source._ControlPoints.size();
 	if (!mAllByControlPoint)
 	{
 		lPolygonVertexCount = PolygonCount * TRIANGLE_VERTEX_COUNT;
 	}
-	//_PositionArray = new XMFLOAT3[lPolygonVertexCount];
 	_PositionArray.resize(lPolygonVertexCount);
-	//_IndiceArray = new WORD[PolygonCount * TRIANGLE_VERTEX_COUNT];
 	_IndiceArray.resize(PolygonCount * TRIANGLE_VERTEX_COUNT);
 
 	if (mHasNormal)
 	{
-		//_NormalArray = new XMFLOAT3[lPolygonVertexCount];
 		_NormalArray.resize(lPolygonVertexCount);
 	}
-	FbxStringList lUVNames;
-	Mesh->GetUVSetNames(lUVNames);
-	const char * lUVName = NULL;
-	if (mHasUV && lUVNames.GetCount())
+	if (mHasUV)
 	{
-		//_TexCoordArray = new XMFLOAT2[lPolygonVertexCount];
 		_TexCoordArray.resize(lPolygonVertexCount);
-		lUVName = lUVNames[0];
 	}
 
 	// Populate the array with vertex attribute, if by control point.
-	const FbxVector4 * lControlPoints = Mesh->GetControlPoints();
-	FbxVector4 lCurrentVertex;
-	FbxVector4 lCurrentNormal;
-	FbxVector2 lCurrentUV;
 	if (mAllByControlPoint)
 	{
-		const FbxGeometryElementNormal * lNormalElement = NULL;
-		const FbxGeometryElementUV * lUVElement = NULL;
-		if (mHasNormal)
-		{
-			lNormalElement = Mesh->GetElementNormal(0);
-		}
-		if (mHasUV)
-		{
-			lUVElement = Mesh->GetElementUV(0);
-		}
 		for (int lIndex = 0; lIndex < lPolygonVertexCount; ++lIndex)
 		{
 			// Save the vertex position.
-			lCurrentVertex = lControlPoints[lIndex];
-			FbxVector4 FinalPosition = lCurrentVertex;//TotalMatrix.MultT(lCurrentVertex);
-
+			const FbxVector4& FinalPosition = Source._ControlPoints[lIndex];
 
 			_PositionArray[lIndex].x = static_cast<float>(FinalPosition[0]);
 			_PositionArray[lIndex].y = static_cast<float>(FinalPosition[1]);
@@ -247,30 +169,17 @@ bool SkeletalMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 			// Save the normal.
 			if (mHasNormal)
 			{
-				int lNormalIndex = lIndex;
-				if (lNormalElement->GetReferenceMode() == FbxLayerElement::eIndexToDirect)
-				{
-					lNormalIndex = lNormalElement->GetIndexArray().GetAt(lIndex);
-				}
-				lCurrentNormal = lNormalElement->GetDirectArray().GetAt(lNormalIndex);
-
-				FbxVector4 FinalNormal = lCurrentNormal;//TotalMatrixForNormal.MultT(lCurrentNormal);
-				//FbxVector4 FinalNormal = TotalMatrixForNormal.MultT(lCurrentNormal);
+				FbxVector4 FinalNormal = Source._Normals.GetAt(lIndex);
 				FinalNormal.Normalize();
 				_NormalArray[lIndex].x = static_cast<float>(FinalNormal[0]);
 				_NormalArray[lIndex].y = static_cast<float>(FinalNormal[1]);
-				_NormalArray[lIndex].z = static_cast<float>(lCurrentNormal[2]);
+				_NormalArray[lIndex].z = static_cast<float>(FinalNormal[2]);
 			}
 
 			// Save the UV.
 			if (mHasUV)
 			{
-				int lUVIndex = lIndex;
-				if (lUVElement->GetReferenceMode() == FbxLayerElement::eIndexToDirect)
-				{
-					lUVIndex = lUVElement->GetIndexArray().GetAt(lIndex);
-				}
-				lCurrentUV = lUVElement->GetDirectArray().GetAt(lUVIndex);
+				const FbxVector2& lCurrentUV = Source._UVs.GetAt(lIndex);
 				_TexCoordArray[lIndex].x = static_cast<float>(lCurrentUV[0]);
 				_TexCoordArray[lIndex].y = static_cast<float>(lCurrentUV[1]);
 			}
@@ -283,9 +192,9 @@ bool SkeletalMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 	{
 		// The material for current face.
 		int lMaterialIndex = 0;
-		if (MaterialIndice && MaterialMappingMode == FbxGeometryElement::eByPolygon)
+		if (bHasMaterialIndice)
 		{
-			lMaterialIndex = MaterialIndice->GetAt(lPolygonIndex);
+			lMaterialIndex = Source._MaterialIndices[lPolygonIndex];
 		}
 
 		// Where should I save the vertex attribute index, according to the material
@@ -293,7 +202,8 @@ bool SkeletalMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 			_SubMeshArray[lMaterialIndex]->_TriangleCount * 3;
 		for (int lVerticeIndex = 0; lVerticeIndex < TRIANGLE_VERTEX_COUNT; ++lVerticeIndex)
 		{
-			const int lControlPointIndex = Mesh->GetPolygonVertex(lPolygonIndex, lVerticeIndex);
+			const int lCornerIndex = lPolygonIndex * TRIANGLE_VERTEX_COUNT + lVerticeIndex;
+			const int lControlPointIndex = Source._PolygonVertices[lCornerIndex];
 
 			if (mAllByControlPoint)
 			{
@@ -305,20 +215,15 @@ bool SkeletalMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 			{
 				_IndiceArray[lIndexOffset + lVerticeIndex] = static_cast<DWORD>(lVertexCount);
 
-
-				lCurrentVertex = lControlPoints[lControlPointIndex];
-				FbxVector4 FinalPosition = lCurrentVertex;//TotalMatrix.MultT(lCurrentVertex);
+				const FbxVector4& FinalPosition = Source._ControlPoints[lControlPointIndex];
 
 				_PositionArray[lVertexCount].x =  static_cast<float>(FinalPosition[0]);
 				_PositionArray[lVertexCount].y =  static_cast<float>(FinalPosition[1]);
 				_PositionArray[lVertexCount].z =  static_cast<float>(FinalPosition[2]);
 
-
-
 				if (mHasNormal)
 				{
-					Mesh->GetPolygonVertexNormal(lPolygonIndex, lVerticeIndex, lCurrentNormal);
-					FbxVector4 FinalNormal =lCurrentNormal;// TotalMatrixForNormal.MultT(lCurrentNormal);
+					FbxVector4 FinalNormal = Source._Normals.GetCorner(lControlPointIndex, lPolygonIndex, lCornerIndex);
 					FinalNormal.Normalize();
 					_NormalArray[lVertexCount].x = static_cast<float>(FinalNormal[0]);
 					_NormalArray[lVertexCount].y = static_cast<float>(FinalNormal[1]);
@@ -328,7 +233,7 @@ bool SkeletalMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 
 				if (mHasUV)
 				{
-					Mesh->GetPolygonVertexUV(lPolygonIndex, lVerticeIndex, lUVName, lCurrentUV);
+					const FbxVector2& lCurrentUV = Source._UVs.GetCorner(lControlPointIndex, lPolygonIndex, lCornerIndex);
 
 					_TexCoordArray[lVertexCount].x = static_cast<float>(lCurrentUV[0]);
 					_TexCoordArray[lVertexCount].y = static_cast<float>(lCurrentUV[1]);
@@ -339,316 +244,553 @@ bool SkeletalMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 		_SubMeshArray[lMaterialIndex]->_TriangleCount += 1;
 	}
 
-	// If it has some defomer connection, update the vertices position
-	const bool lHasVertexCache = Mesh->GetDeformerCount(FbxDeformer::eVertexCache) &&
-		(static_cast<FbxVertexCacheDeformer*>(Mesh->GetDeformer(0, FbxDeformer::eVertexCache)))->IsActive();
-	const bool lHasShape = Mesh->GetShapeCount() > 0;
-	const bool lHasSkin = Mesh->GetDeformerCount(FbxDeformer::eSkin) > 0;
-	const bool lHasDeformation = lHasVertexCache || lHasShape || lHasSkin;
-	
-	const int lVertexCount1 = Mesh->GetControlPointsCount();
-	FbxPose * lPose = NULL;
-	lPose = Importer->mScene->GetPose(0);
-	FbxAMatrix pGlobalPosition;
-	FbxTimeSpan lTimeLineTimeSpan;
-	Importer->mScene->GetGlobalSettings().GetTimelineDefaultTimeSpan(lTimeLineTimeSpan);
-	FbxVector4* lVertexArray = NULL;
-	if (lHasDeformation)
-	{
-		lVertexArray = new FbxVector4[lVertexCount1];
-		memcpy(lVertexArray, Mesh->GetControlPoints(), lVertexCount1 * sizeof(FbxVector4));
-	}
-	if (lHasDeformation)
-	{
-		// Active vertex cache deformer will overwrite any other deformer
-		if (lHasVertexCache)
+	// Active vertex cache deformer will overwrite any other deformer
+	if (Source._Clusters.size() > 0 && !Source._HasVertexCache && Source._HasLinearSkin)
+	{
+		int lVertexCount = Source._ControlPoints.size();
+		VertexSkinInfo* SkinInfoArray = new VertexSkinInfo[lVertexCount];
+
+		for (unsigned int lClusterIndex = 0; lClusterIndex < Source._Clusters.size(); ++lClusterIndex)
 		{
+			const MeshSourceCluster& lCluster = Source._Clusters[lClusterIndex];
+
+			int lVertexIndexCount = lCluster.ControlPointIndices.size();
+			for (int k = 0; k < lVertexIndexCount; ++k) 
+			{            
+				int lIndex = lCluster.ControlPointIndices[k];
+
+				// Sometimes, the mesh can have less points than at the time of the skinning
+				// because a smooth operator was active when skinning but has been deactivated during export.
+				if (lIndex >= lVertexCount)
+					continue;
+
+				BoneInf Inf;
+				Inf.BoneName = lCluster.BoneName;
+				Inf.Weight = (float)lCluster.Weights[k];
+				SkinInfoArray[lIndex].BoneLink.push_back(Inf);
+			}//For each vertex
 		}
-		else
+
+		int numOverLink = 0;
+		for(int i=0;i<lVertexCount;i++)
 		{
-			//we need to get the number of clusters
-			const int lSkinCount = Mesh->GetDeformerCount(FbxDeformer::eSkin);
-			int lClusterCount = 0;
-			for (int lSkinIndex = 0; lSkinIndex < lSkinCount; ++lSkinIndex)
+			VertexSkinInfo& SkinInfo = SkinInfoArray[i];
+			if(SkinInfo.BoneLink.size() > 4)
 			{
-				lClusterCount += ((FbxSkin *)(Mesh->GetDeformer(lSkinIndex, FbxDeformer::eSkin)))->GetClusterCount();
+				numOverLink++;
+				std::sort (SkinInfo.BoneLink.begin(), SkinInfo.BoneLink.end());
+				for(unsigned int OverIndex=4;OverIndex<SkinInfo.BoneLink.size();OverIndex++)
+				{
+					for(int k=0;k<4;k++)
+					{
+						SkinInfo.BoneLink[k].Weight += SkinInfo.BoneLink[OverIndex].Weight/4.f;
+					}
+				}
+				int NumErase = SkinInfo.BoneLink.size() - 4;
+				SkinInfo.BoneLink.erase(SkinInfo.BoneLink.end()-NumErase, SkinInfo.BoneLink.end());
 			}
-			if (lClusterCount)
+			float WeightTotal = 0.f;
+			for(unsigned int k=0;k<SkinInfo.BoneLink.size();k++)
 			{
-				// Deform the vertex array with the skin deformer.
-				FbxSkin * lSkinDeformer = (FbxSkin *)Mesh->GetDeformer(0, FbxDeformer::eSkin);
-				FbxSkin::EType lSkinningType = lSkinDeformer->GetSkinningType();
+				WeightTotal += SkinInfo.BoneLink[k].Weight;
+			}
 
-				if(lSkinningType == FbxSkin::eLinear || lSkinningType == FbxSkin::eRigid)
+			assert(WeightTotal >= 0.999f);
+		}
+
+		// every mesh works on its own copy, so meshes can be imported in parallel
+		std::map<std::string, BoneIndexInfo> BoneIndexMap = InBoneIndexMap;
+		for(int i=0;i<lVertexCount;i++)
+		{
+			VertexSkinInfo& SkinInfo = SkinInfoArray[i];
+			for(unsigned int k=0;k<SkinInfo.BoneLink.size();k++)
+			{
+				std::string& LinkedBoneName = SkinInfo.BoneLink[k].BoneName;
+				std::map<std::string, BoneIndexInfo>::iterator it;
+				it = BoneIndexMap.find(LinkedBoneName);
+				if(it != BoneIndexMap.end())
 				{
-					//ComputeLinearDeformation(pGlobalPosition, pMesh, pTime, pVertexArray, pPose);
-					// All the links must have the same link mode.
-					FbxCluster::ELinkMode lClusterMode = ((FbxSkin*)Mesh->GetDeformer(0, FbxDeformer::eSkin))->GetCluster(0)->GetLinkMode();
+					BoneIndexInfo& LinkInfo = it->second;
+					LinkInfo.IsUsedLink = true;
+				}
+			}
+		}
 
-					int lVertexCount = Mesh->GetControlPointsCount();
-					VertexSkinInfo* SkinInfoArray = new VertexSkinInfo[lVertexCount];
+		std::map<std::string, BoneIndexInfo>::iterator it;
+		for(it=BoneIndexMap.begin();it!=BoneIndexMap.end();)
+		{
+			BoneIndexInfo& LinkInfo = it->second;
+			if(LinkInfo.IsUsedLink == false)
+			{
+				it = BoneIndexMap.erase(it);
+			}
+			else
+				it++;
+		}
 
-					if (lClusterMode == FbxCluster::eAdditive)
-					{
-						for (int i = 0; i < lVertexCount; ++i)
-						{
-							//lClusterDeformation[i].SetIdentity();
-						}
-					}
+		std::vector<BoneIndexInfo> BoneLinkArray;
 
-					int lSkinCount = Mesh->GetDeformerCount(FbxDeformer::eSkin);
-					for ( int lSkinIndex=0; lSkinIndex<lSkinCount; ++lSkinIndex)
-					{
-						FbxSkin * lSkinDeformer = (FbxSkin *)Mesh->GetDeformer(lSkinIndex, FbxDeformer::eSkin);
-
-						int lClusterCount = lSkinDeformer->GetClusterCount();
-						for ( int lClusterIndex=0; lClusterIndex<lClusterCount; ++lClusterIndex)
-						{
-							FbxCluster* lCluster = lSkinDeformer->GetCluster(lClusterIndex);
-							if (!lCluster->GetLink())
-								continue;
-
-							FbxNode* Bone = lCluster->GetLink();
-
-
-							FbxAMatrix lVertexTransformMatrix;
-							//ComputeClusterDeformation(pGlobalPosition, pMesh, lCluster, lVertexTransformMatrix, pTime, pPose);
-
-							int lVertexIndexCount = lCluster->GetControlPointIndicesCount();
-							for (int k = 0; k < lVertexIndexCount; ++k) 
-							{            
-								int lIndex = lCluster->GetControlPointIndices()[k];
-								
-								double lWeight = lCluster->GetControlPointWeights()[k];
-								
-								BoneInf Inf;
-								Inf.BoneName = Bone->GetName();
-								Inf.Weight = (float)lWeight;
-								SkinInfoArray[lIndex].BoneLink.push_back(Inf);
-								// Sometimes, the mesh can have less points than at the time of the skinning
-								// because a smooth operator was active when skinning but has been deactivated during export.
-								if (lIndex >= lVertexCount)
-									continue;
-
-
-								if (lWeight == 0.0)
-								{
-									continue;
-								}
-							
-							}//For each vertex			
-						}//lClusterCount
-					}
+		for(it=BoneIndexMap.begin();it!=BoneIndexMap.end();it++)
+		{
+			BoneIndexInfo& LinkInfo = it->second;
+			BoneLinkArray.push_back(LinkInfo);
+		}
 
-					int numOverLink = 0;
-					for(int i=0;i<lVertexCount;i++)
-					{
-						VertexSkinInfo& SkinInfo = SkinInfoArray[i];
-						if(SkinInfo.BoneLink.size() > 4)
-						{
-							numOverLink++;
-							std::sort (SkinInfo.BoneLink.begin(), SkinInfo.BoneLink.end());
-							for(unsigned int OverIndex=4;OverIndex<SkinInfo.BoneLink.size();OverIndex++)
-							{
-								for(int k=0;k<4;k++)
-								{
-									SkinInfo.BoneLink[k].Weight += SkinInfo.BoneLink[OverIndex].Weight/4.f;
-								}
-							}
-							int NumErase = SkinInfo.BoneLink.size() - 4;
-							SkinInfo.BoneLink.erase(SkinInfo.BoneLink.end()-NumErase, SkinInfo.BoneLink.end());
-						}
-						float WeightTotal = 0.f;
-						for(unsigned int k=0;k<SkinInfo.BoneLink.size();k++)
-						{
-							WeightTotal += SkinInfo.BoneLink[k].Weight;
-						}
-
-						assert(WeightTotal >= 0.999f);
-					}
+		std::sort(BoneLinkArray.begin(),BoneLinkArray.end());
 
-					std::map<std::string, BoneIndexInfo>& BoneIndexMap = Importer->BoneIndexMap;
-					for(int i=0;i<lVertexCount;i++)
-					{
-						VertexSkinInfo& SkinInfo = SkinInfoArray[i];
-						for(unsigned int k=0;k<SkinInfo.BoneLink.size();k++)
-						{
-							std::string& LinkedBoneName = SkinInfo.BoneLink[k].BoneName;
-							std::map<std::string, BoneIndexInfo>::iterator it;
-							it = BoneIndexMap.find(LinkedBoneName);
-							if(it != BoneIndexMap.end())
-							{
-								BoneIndexInfo& LinkInfo = it->second;
-								LinkInfo.IsUsedLink = true;
-							}
-						}
-					}
+		for(unsigned int BoneIndex=0;BoneIndex<BoneLinkArray.size();BoneIndex++)
+		{
+			BoneIndexInfo& LinkInfo = BoneLinkArray[BoneIndex];
 
-					std::map<std::string, BoneIndexInfo>::iterator it;
-					for(it=BoneIndexMap.begin();it!=BoneIndexMap.end();)
-					{
-						BoneIndexInfo& LinkInfo = it->second;
-						if(LinkInfo.IsUsedLink == false)
-						{
-							it = BoneIndexMap.erase(it);
-						}
-						else
-							it++;
-					}
+			std::map<std::string, BoneIndexInfo>::iterator it;
+			it = BoneIndexMap.find(LinkInfo.BoneName);
+			if(it != BoneIndexMap.end())
+			{
+				BoneIndexInfo& LinkInfoMap = it->second;
+				LinkInfoMap.Index = BoneIndex;
+			}
+		}
 
-					std::vector<BoneIndexInfo>& BoneLinkArray = Importer->BoneArray;
+		_SkinInfoArray.resize(lVertexCount);
+		for(int Vert=0;Vert<lVertexCount;Vert++)
+		{
+			VertexSkinInfo& SkinInfo = SkinInfoArray[Vert];
+			for(unsigned int BIdx=0;BIdx<SkinInfo.BoneLink.size();BIdx++)
+			{
+				_SkinInfoArray[Vert].Weights[BIdx] = SkinInfo.BoneLink[BIdx].Weight;
 
-					for(it=BoneIndexMap.begin();it!=BoneIndexMap.end();it++)
-					{
-						BoneIndexInfo& LinkInfo = it->second;
-						BoneLinkArray.push_back(LinkInfo);
-					}
+				// find real bone index
+				std::map<std::string, BoneIndexInfo>::iterator it;
+				it = BoneIndexMap.find(SkinInfo.BoneLink[BIdx].BoneName);
+				if(it != BoneIndexMap.end())
+				{
+					BoneIndexInfo& LinkInfoMap = it->second;
+					_SkinInfoArray[Vert].Bones[BIdx] = LinkInfoMap.Index;
+				}
+			}
+			int Remain = 4-SkinInfo.BoneLink.size();
+			for(int r=0;r<Remain;r++)
+			{
+				int RIndex = 3-r;
+				_SkinInfoArray[Vert].Weights[RIndex] = 0.f;
+				_SkinInfoArray[Vert].Bones[RIndex] = 0;
+			}
+		}
 
-					std::sort(BoneLinkArray.begin(),BoneLinkArray.end());
+		// per-corner vertices take the skin of their control point
+		if (!mAllByControlPoint)
+		{
+			std::vector<SkinInfo> ControlPointSkinArray;
+			ControlPointSkinArray.swap(_SkinInfoArray);
+			_SkinInfoArray.resize(lPolygonVertexCount);
+			for(int Vert=0;Vert<lPolygonVertexCount;Vert++)
+			{
+				_SkinInfoArray[Vert] = ControlPointSkinArray[Source._PolygonVertices[Vert]];
+			}
+		}
 
-					for(unsigned int BoneIndex=0;BoneIndex<BoneLinkArray.size();BoneIndex++)
-					{
-						BoneIndexInfo& LinkInfo = BoneLinkArray[BoneIndex];
-
-						std::map<std::string, BoneIndexInfo>::iterator it;
-						it = BoneIndexMap.find(LinkInfo.BoneName);
-						if(it != BoneIndexMap.end())
-						{
-							BoneIndexInfo& LinkInfoMap = it->second;
-							LinkInfoMap.Index = BoneIndex;
-						}
-					}
+		// fill ref pose matrices
+		_NumBone = BoneLinkArray.size();
 
-					//_SkinInfoArray = new SkinInfo[lVertexCount];
-					_SkinInfoArray.resize(lVertexCount);
-					for(int Vert=0;Vert<lVertexCount;Vert++)
-					{
-						VertexSkinInfo& SkinInfo = SkinInfoArray[Vert];
-						for(unsigned int BIdx=0;BIdx<SkinInfo.BoneLink.size();BIdx++)
-						{
-							_SkinInfoArray[Vert].Weights[BIdx] = SkinInfo.BoneLink[BIdx].Weight;
-
-							// find real bone index
-							std::map<std::string, BoneIndexInfo>::iterator it;
-							it = BoneIndexMap.find(SkinInfo.BoneLink[BIdx].BoneName);
-							if(it != BoneIndexMap.end())
-							{
-								BoneIndexInfo& LinkInfoMap = it->second;
-								_SkinInfoArray[Vert].Bones[BIdx] = LinkInfoMap.Index;
-							}
-						}
-						int Remain = 4-SkinInfo.BoneLink.size();
-						for(int r=0;r<Remain;r++)
-						{
-							int RIndex = 3-r;
-							_SkinInfoArray[Vert].Weights[RIndex] = 0.f;
-							_SkinInfoArray[Vert].Bones[RIndex] = 0;
-
-						
-						}
-					}
+		_RequiredBoneArray.resize(_NumBone);
+		for(int i=0;i<_NumBone;i++)
+		{
+			_RequiredBoneArray[i] = BoneLinkArray[i].SkeletonIndex;
+		}
+		delete[] SkinInfoArray;
+	}
 
-					// fill ref pose matrices
-					_NumBone = BoneLinkArray.size();
+	_NumTriangle = PolygonCount;
+	_NumVertex = lPolygonVertexCount;
 
-					
-					_RequiredBoneArray.resize(_NumBone);
-					for(int i=0;i<_NumBone;i++)
-					{
-						_RequiredBoneArray[i] = BoneLinkArray[i].SkeletonIndex;
-					}
-					delete[] SkinInfoArray;
-				}
-			}
-		}
+	if(_NormalArray.size() != 0 && _TexCoordArray.size() == 0)
+	{
+		_VertexStride = sizeof(NormalVertexGpuSkin);
+		_NumTexCoord = 0;
 	}
+	if(_NormalArray.size() != 0L && _TexCoordArray.size() != 0)
 
-	delete [] lVertexArray;
+	{
+		_VertexStride = sizeof(NormalTexVertexGpuSkin);
+		_NumTexCoord = 1;
+	}
 
-	//
-	HRESULT hr;
-	D3D11_BUFFER_DESC bd;
-	ZeroMemory( &bd, sizeof(bd) );
-	bd.Usage = D3D11_USAGE_DEFAULT;
-	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	bd.CPUAccessFlags = 0;
-	D3D11_SUBRESOURCE_DATA InitData;
-	ZeroMemory( &InitData, sizeof(InitData) );
-	if(mHasNormal == true && mHasUV == false)
+	// bounds first, compressed positions are stored relative to them
+	CalcBounds();
+	SelectVertexFormat();
+
+	if (!mAllByControlPoint)
 	{
-		bd.ByteWidth = sizeof( NormalVertexGpuSkin ) * lPolygonVertexCount;
-		NormalVertexGpuSkin* Vertices = new NormalVertexGpuSkin[lPolygonVertexCount];
-		for(int i = 0;i<lPolygonVertexCount;i++)
+		WeldVertices();
+	}
+	OptimizeIndices();
+	BuildLODs();
+
+	_IndexStride = _NumVertex <= 0x10000 ? sizeof(unsigned short) : sizeof(DWORD);
+
+	return true;
+}
+
+void SkeletalMesh::SelectVertexFormat()
+{
+	if(!_CompressedVertex || _VertexStride == 0)
+	{
+		_CompressedVertex = false;
+		return;
+	}
+
+	VertexCompressionError Error;
+	if(!ValidateVertexCompression(_PositionArray, _NormalArray, _TexCoordArray, _AABBMin, _AABBMax, Error))
+	{
+		cout_debug("SkeletalMesh : compression error too large (position %f, normal %f, texcoord %f), keeping float vertices\n",
+			Error.Position, Error.Normal, Error.TexCoord);
+		_CompressedVertex = false;
+		return;
+	}
+
+	_VertexStride = _NumTexCoord == 0 ? sizeof(CompressedNormalVertexGpuSkin) : sizeof(CompressedNormalTexVertexGpuSkin);
+}
+
+void SkeletalMesh::GetPositionScaleBias( XMFLOAT4& OutScale, XMFLOAT4& OutBias ) const
+{
+	if(_CompressedVertex)
+	{
+		::GetPositionScaleBias(_AABBMin, _AABBMax, OutScale, OutBias);
+	}
+	else
+	{
+		OutScale = XMFLOAT4(1.f, 1.f, 1.f, 1.f);
+		OutBias = XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+	}
+}
+
+void SkeletalMesh::WeldVertices()
+{
+	if((int)_SkinInfoArray.size() != _NumVertex)
+		return;
+
+	// weld on the final vertex layout, so only vertices that render identically are merged
+	std::vector<unsigned char> VertexData;
+	BuildVertexData(VertexData);
+	if(VertexData.size() == 0)
+		return;
+
+	std::vector<unsigned int> Remap;
+	const int UniqueCount = MeshOptimizer::WeldVertices(&VertexData[0], _VertexStride, _NumVertex, Remap);
+
+	MeshOptimizer::RemapVertexArray(_PositionArray, Remap, UniqueCount);
+	MeshOptimizer::RemapVertexArray(_NormalArray, Remap, UniqueCount);
+	MeshOptimizer::RemapVertexArray(_TexCoordArray, Remap, UniqueCount);
+	MeshOptimizer::RemapVertexArray(_SkinInfoArray, Remap, UniqueCount);
+	MeshOptimizer::RemapIndexArray(_IndiceArray, Remap);
+	_NumVertex = UniqueCount;
+}
+
+void SkeletalMesh::OptimizeIndices()
+{
+	if(_IndiceArray.size() == 0 || _NumVertex == 0)
+		return;
+
+	unsigned int* Indices = (unsigned int*)&_IndiceArray[0];
+	const int IndexCount = _IndiceArray.size();
+
+	float ACMRBefore, ATVRBefore;
+	MeshOptimizer::AnalyzeVertexCache(Indices, IndexCount, _NumVertex, ANALYZE_CACHE_SIZE, ACMRBefore, ATVRBefore);
+
+	// triangles never move across submeshes, each one is a separate draw
+	for(unsigned int i=0;i<_SubMeshArray.size();i++)
+	{
+		unsigned int* SubMeshIndices = Indices + _SubMeshArray[i]->_IndexOffset;
+		const int SubMeshIndexCount = _SubMeshArray[i]->_TriangleCount * TRIANGLE_VERTEX_COUNT;
+		MeshOptimizer::OptimizeVertexCache(SubMeshIndices, SubMeshIndexCount, _NumVertex);
+		MeshOptimizer::OptimizeOverdraw(SubMeshIndices, SubMeshIndexCount, &_PositionArray[0].x, sizeof(XMFLOAT3), _NumVertex);
+	}
+
+	std::vector<unsigned int> Remap;
+	MeshOptimizer::OptimizeVertexFetch(Indices, IndexCount, _NumVertex, Remap);
+	MeshOptimizer::RemapVertexArray(_PositionArray, Remap, _NumVertex);
+	MeshOptimizer::RemapVertexArray(_NormalArray, Remap, _NumVertex);
+	MeshOptimizer::RemapVertexArray(_TexCoordArray, Remap, _NumVertex);
+	if((int)_SkinInfoArray.size() == _NumVertex)
+		MeshOptimizer::RemapVertexArray(_SkinInfoArray, Remap, _NumVertex);
+
+	float ACMRAfter, ATVRAfter;
+	MeshOptimizer::AnalyzeVertexCache(Indices, IndexCount, _NumVertex, ANALYZE_CACHE_SIZE, ACMRAfter, ATVRAfter);
+	if(_bLogImportStats)
+		cout_debug("SkeletalMesh : %d triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", _NumTriangle, ACMRBefore, ACMRAfter, ATVRBefore, ATVRAfter);
+}
+
+void SkeletalMesh::BuildLODs()
+{
+	_LODArray.clear();
+	if(_IndiceArray.size() == 0 || _NumVertex == 0)
+		return;
+
+	MeshLOD BaseLOD;
+	BaseLOD.IndexOffset = 0;
+	BaseLOD.TriangleCount = _NumTriangle;
+	BaseLOD.VertexCount = _NumVertex;
+	BaseLOD.ScreenSize = FLOAT_MAX;
+	BaseLOD.Error = 0.f;
+	_LODArray.push_back(BaseLOD);
+
+	// normals and uvs add to the cost where a collapse merges two different ones
+	const int AttributeCount = (_NormalArray.size() ? 3 : 0) + (_TexCoordArray.size() ? 2 : 0);
+	std::vector<float> Attributes(AttributeCount * _NumVertex);
+	for(int i=0;i<_NumVertex && AttributeCount > 0;i++)
+	{
+		float* Attribute = &Attributes[i * AttributeCount];
+		if(_NormalArray.size())
 		{
-			Vertices[i].Position = _PositionArray[i];
-			Vertices[i].Normal = _NormalArray[i];
-			
-			Vertices[i].Weights = 0x00000000;
-			Vertices[i].Bones = 0x00000000;
+			*Attribute++ = _NormalArray[i].x;
+			*Attribute++ = _NormalArray[i].y;
+			*Attribute++ = _NormalArray[i].z;
+		}
+		if(_TexCoordArray.size())
+		{
+			*Attribute++ = _TexCoordArray[i].x;
+			*Attribute++ = _TexCoordArray[i].y;
+		}
+	}
 
-			for(int k=0;k<MAX_BONELINK;k++)
-			{
-				Vertices[i].Weights |=  (unsigned int)(_SkinInfoArray[i].Weights[k] * 255.f) << k*8;
-			}
-			for(int k=0;k<MAX_BONELINK;k++)
+	// a vertex only collapses onto one driven by the same dominant bone, so joints keep their weight blend
+	const bool bHasSkin = (int)_SkinInfoArray.size() == _NumVertex;
+	std::vector<unsigned int> DominantBone(bHasSkin ? _NumVertex : 0);
+	for(unsigned int i=0;i<DominantBone.size();i++)
+		DominantBone[i] = _SkinInfoArray[i].Bones[0];
+
+	const XMFLOAT3 Size(_AABBMax.x - _AABBMin.x, _AABBMax.y - _AABBMin.y, _AABBMax.z - _AABBMin.z);
+	const float Extent = Math::Max<float>(Size.x, Math::Max<float>(Size.y, Size.z));
+	const float Radius = 0.5f * sqrtf(Size.x*Size.x + Size.y*Size.y + Size.z*Size.z);
+
+	// every lod simplifies the previous one submesh by submesh, so materials never mix
+	std::vector<int> SourceOffset(_SubMeshArray.size()), SourceCount(_SubMeshArray.size());
+	for(unsigned int i=0;i<_SubMeshArray.size();i++)
+	{
+		SourceOffset[i] = _SubMeshArray[i]->_IndexOffset;
+		SourceCount[i] = _SubMeshArray[i]->_TriangleCount * TRIANGLE_VERTEX_COUNT;
+	}
+
+	std::vector<unsigned int> Simplified;
+	for(int LODIndex=1;LODIndex<_MaxLODCount;LODIndex++)
+	{
+		const MeshLOD& PrevLOD = _LODArray.back();
+		MeshLOD LOD;
+		LOD.IndexOffset = _IndiceArray.size();
+		LOD.VertexCount = _NumVertex;
+		float Error = 0.f;
+
+		for(unsigned int i=0;i<_SubMeshArray.size();i++)
+		{
+			const int Offset = _IndiceArray.size();
+			if(SourceCount[i] > 0)
 			{
-				Vertices[i].Bones |= (unsigned int)_SkinInfoArray[i].Bones[k] << k*8;
+				const int TargetCount = (int)(SourceCount[i] / TRIANGLE_VERTEX_COUNT * LOD_TRIANGLE_RATIO) * TRIANGLE_VERTEX_COUNT;
+				float SubMeshError;
+				Simplified.resize(SourceCount[i]);
+				const int Count = MeshSimplifier::Simplify(&Simplified[0], (const unsigned int*)&_IndiceArray[SourceOffset[i]], SourceCount[i],
+					&_PositionArray[0], _NumVertex, AttributeCount ? &Attributes[0] : NULL, AttributeCount, LOD_ATTRIBUTE_WEIGHT,
+					bHasSkin ? &DominantBone[0] : NULL, TargetCount, LOD_MAX_ERROR, SubMeshError);
+				MeshOptimizer::OptimizeVertexCache(&Simplified[0], Count, _NumVertex);
+				_IndiceArray.insert(_IndiceArray.end(), Simplified.begin(), Simplified.begin() + Count);
+				Error = Math::Max<float>(Error, SubMeshError);
 			}
+			SourceOffset[i] = Offset;
+			SourceCount[i] = _IndiceArray.size() - Offset;
 		}
-		InitData.pSysMem = Vertices;
-		hr = GEngine->_Device->CreateBuffer( &bd, &InitData, &_VertexBuffer );
-		if( FAILED( hr ) )
+
+		LOD.TriangleCount = (_IndiceArray.size() - LOD.IndexOffset) / TRIANGLE_VERTEX_COUNT;
+		if(LOD.TriangleCount == 0 || LOD.TriangleCount > PrevLOD.TriangleCount * LOD_MIN_REDUCTION)
 		{
-			assert(false);
-			return false;
+			_IndiceArray.resize(LOD.IndexOffset);
+			break;
 		}
 
-		SetD3DResourceDebugName("SkeletalMesh_VertexBuffer", _VertexBuffer);
+		// each lod starts from the previous one, so the errors add up along the chain
+		LOD.Error = PrevLOD.Error + Error * Extent;
+		LOD.ScreenSize = Math::Min<float>(MeshSimplifier::ComputeLODScreenSize(LOD.Error, Radius), PrevLOD.ScreenSize);
+		_LODArray.push_back(LOD);
+	}
 
+	if(_LODArray.size() > 1)
+	{
+		std::vector<const unsigned int*> LODIndices;
+		std::vector<int> LODIndexCount;
+		for(unsigned int i=0;i<_LODArray.size();i++)
+		{
+			LODIndices.push_back((const unsigned int*)&_IndiceArray[_LODArray[i].IndexOffset]);
+			LODIndexCount.push_back(_LODArray[i].TriangleCount * TRIANGLE_VERTEX_COUNT);
+		}
 
-		delete[] Vertices;
+		std::vector<unsigned int> Remap, VertexCount;
+		MeshSimplifier::SortVerticesByLOD(LODIndices, LODIndexCount, _NumVertex, Remap, VertexCount);
+		MeshOptimizer::RemapVertexArray(_PositionArray, Remap, _NumVertex);
+		MeshOptimizer::RemapVertexArray(_NormalArray, Remap, _NumVertex);
+		MeshOptimizer::RemapVertexArray(_TexCoordArray, Remap, _NumVertex);
+		if(bHasSkin)
+			MeshOptimizer::RemapVertexArray(_SkinInfoArray, Remap, _NumVertex);
+		MeshOptimizer::RemapIndexArray(_IndiceArray, Remap);
+		for(unsigned int i=0;i<_LODArray.size();i++)
+			_LODArray[i].VertexCount = VertexCount[i];
 	}
-	else if(mHasNormal == true && mHasUV == true)
+
+	for(unsigned int i=0;i<_LODArray.size() && _bLogImportStats;i++)
 	{
-		bd.ByteWidth = sizeof( NormalTexVertexGpuSkin ) * lPolygonVertexCount;
-		NormalTexVertexGpuSkin* Vertices = new NormalTexVertexGpuSkin[lPolygonVertexCount];
-		for(int i = 0;i<lPolygonVertexCount;i++)
+		cout_debug("SkeletalMesh : lod %d, %d triangles, %d vertices, error %f, screen size %f\n",
+			i, _LODArray[i].TriangleCount, _LODArray[i].VertexCount, _LODArray[i].Error, _LODArray[i].ScreenSize);
+	}
+}
+
+int SkeletalMesh::SelectLOD( const XMMATRIX& ViewMat, const XMMATRIX& ProjectionMat ) const
+{
+	if(_LODArray.size() <= 1)
+		return 0;
+
+	// reference pose bounds, the animated pose stays close enough to pick a lod
+	const XMFLOAT3 Center((_AABBMin.x + _AABBMax.x) * 0.5f, (_AABBMin.y + _AABBMax.y) * 0.5f, (_AABBMin.z + _AABBMax.z) * 0.5f);
+	const XMFLOAT3 Size(_AABBMax.x - _AABBMin.x, _AABBMax.y - _AABBMin.y, _AABBMax.z - _AABBMin.z);
+	const float Radius = 0.5f * sqrtf(Size.x*Size.x + Size.y*Size.y + Size.z*Size.z);
+	return MeshSimplifier::SelectLOD(_LODArray, MeshSimplifier::ComputeScreenSize(Center, Radius, ViewMat, ProjectionMat));
+}
+
+void SkeletalMesh::CalcBounds()
+{
+	_AABBMin = XMFLOAT3(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX);
+	_AABBMax = XMFLOAT3(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX);
+	for(unsigned int i=0;i<_PositionArray.size();i++)
+	{
+		XMFLOAT3& Pos = _PositionArray[i];
+		_AABBMax.x = Math::Max<float>(_AABBMax.x, Pos.x);
+		_AABBMax.y = Math::Max<float>(_AABBMax.y, Pos.y);
+		_AABBMax.z = Math::Max<float>(_AABBMax.z, Pos.z);
+
+		_AABBMin.x = Math::Min<float>(_AABBMin.x, Pos.x);
+		_AABBMin.y = Math::Min<float>(_AABBMin.y, Pos.y);
+		_AABBMin.z = Math::Min<float>(_AABBMin.z, Pos.z);
+	}
+}
+
+static void PackSkinInfo(const SkinInfo& Info, unsigned int& OutWeights, unsigned int& OutBones)
+{
+	OutWeights = 0x00000000;
+	OutBones = 0x00000000;
+	for(int k=0;k<MAX_BONELINK;k++)
+	{
+		OutWeights |=  (unsigned int)(Info.Weights[k] * 255.f) << k*8;
+	}
+	for(int k=0;k<MAX_BONELINK;k++)
+	{
+		OutBones |= (unsigned int)Info.Bones[k] << k*8;
+	}
+}
+
+void SkeletalMesh::BuildVertexData( std::vector<unsigned char>& OutVertexData )
+{
+	OutVertexData.resize(_VertexStride * _NumVertex);
+	if(OutVertexData.size() == 0)
+		return;
+
+	if(_CompressedVertex)
+	{
+		XMFLOAT4 Scale, Bias;
+		GetPositionScaleBias(Scale, Bias);
+		if(_NumTexCoord == 0)
 		{
-			Vertices[i].Position = _PositionArray[i];
-			Vertices[i].Normal = _NormalArray[i];
-			Vertices[i].TexCoord = _TexCoordArray[i];
-			
-			Vertices[i].Weights = 0x00000000;
-			Vertices[i].Bones = 0x00000000;
-			
-			for(int k=0;k<MAX_BONELINK;k++)
+			CompressedNormalVertexGpuSkin* Vertices = (CompressedNormalVertexGpuSkin*)&OutVertexData[0];
+			for(int i = 0;i<_NumVertex;i++)
 			{
-				Vertices[i].Weights |=  (unsigned int)(_SkinInfoArray[i].Weights[k] * 255.f) << k*8;
+				Vertices[i].Position = EncodePosition(_PositionArray[i], Scale, Bias);
+				Vertices[i].Normal = EncodeNormal(_NormalArray[i]);
+				PackSkinInfo(_SkinInfoArray[i], Vertices[i].Weights, Vertices[i].Bones);
 			}
-			for(int k=0;k<MAX_BONELINK;k++)
+		}
+		else
+		{
+			CompressedNormalTexVertexGpuSkin* Vertices = (CompressedNormalTexVertexGpuSkin*)&OutVertexData[0];
+			for(int i = 0;i<_NumVertex;i++)
 			{
-				Vertices[i].Bones |= (unsigned int)_SkinInfoArray[i].Bones[k] << k*8;
-				
+				Vertices[i].Position = EncodePosition(_PositionArray[i], Scale, Bias);
+				Vertices[i].Normal = EncodeNormal(_NormalArray[i]);
+				Vertices[i].TexCoord = EncodeTexCoord(_TexCoordArray[i]);
+				PackSkinInfo(_SkinInfoArray[i], Vertices[i].Weights, Vertices[i].Bones);
 			}
 		}
-		InitData.pSysMem = Vertices;
-		hr = GEngine->_Device->CreateBuffer( &bd, &InitData, &_VertexBuffer );
-		if( FAILED( hr ) )
+	}
+	else if(_VertexStride == sizeof(NormalVertexGpuSkin))
+	{
+		NormalVertexGpuSkin* Vertices = (NormalVertexGpuSkin*)&OutVertexData[0];
+		for(int i = 0;i<_NumVertex;i++)
 		{
-			assert(false);
-			return false;
+			Vertices[i].Position = _PositionArray[i];
+			Vertices[i].Normal = _NormalArray[i];
+			PackSkinInfo(_SkinInfoArray[i], Vertices[i].Weights, Vertices[i].Bones);
 		}
-		SetD3DResourceDebugName("SkeletalMesh_VertexBuffer", _VertexBuffer);
+	}
+	else if(_VertexStride == sizeof(NormalTexVertexGpuSkin))
+	{
+		NormalTexVertexGpuSkin* Vertices = (NormalTexVertexGpuSkin*)&OutVertexData[0];
+		for(int i = 0;i<_NumVertex;i++)
+		{
+			Vertices[i].Position = _PositionArray[i];
+			Vertices[i].Normal = _NormalArray[i];
+			Vertices[i].TexCoord = _TexCoordArray[i];
+			PackSkinInfo(_SkinInfoArray[i], Vertices[i].Weights, Vertices[i].Bones);
+		}
+	}
+}
+
+void SkeletalMesh::BuildIndexData( std::vector<unsigned char>& OutIndexData )
+{
+	OutIndexData.resize(_IndexStride * _IndiceArray.size());
+	if(OutIndexData.size() == 0)
+		return;
 
-		delete[] Vertices;
+	if(_IndexStride == sizeof(unsigned short))
+	{
+		unsigned short* Indices = (unsigned short*)&OutIndexData[0];
+		for(unsigned int i=0;i<_IndiceArray.size();i++)
+			Indices[i] = (unsigned short)_IndiceArray[i];
 	}
-	
+	else
+	{
+		memcpy(&OutIndexData[0], &_IndiceArray[0], OutIndexData.size());
+	}
+}
 
-	bd.Usage = D3D11_USAGE_DEFAULT;
-	bd.ByteWidth = sizeof( DWORD ) * PolygonCount * TRIANGLE_VERTEX_COUNT;        // 36 vertices needed for 12 triangles in a triangle list
-	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+bool SkeletalMesh::CreateBuffers( const void* VertexData, const void* IndexData, unsigned int IndexCount )
+{
+	BuildSkinSource(VertexData);
+
+	if(_VertexBuffer) _VertexBuffer->Release();
+	if(_IndexBuffer) _IndexBuffer->Release();
+	_VertexBuffer = NULL;
+	_IndexBuffer = NULL;
+
+	if(VertexData == NULL || IndexData == NULL)
+		return false;
+
+	HRESULT hr;
+	D3D11_BUFFER_DESC bd;
+	ZeroMemory( &bd, sizeof(bd) );
+	bd.Usage = D3D11_USAGE_IMMUTABLE;
+	bd.ByteWidth = _VertexStride * _NumVertex;
+	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	bd.CPUAccessFlags = 0;
-	InitData.pSysMem = &_IndiceArray[0];
+	D3D11_SUBRESOURCE_DATA InitData;
+	ZeroMemory( &InitData, sizeof(InitData) );
+	InitData.pSysMem = VertexData;
+	hr = GEngine->_Device->CreateBuffer( &bd, &InitData, &_VertexBuffer );
+	if( FAILED( hr ) )
+	{
+		assert(false);
+		return false;
+	}
+
+	SetD3DResourceDebugName("SkeletalMesh_VertexBuffer", _VertexBuffer);
+
+	bd.ByteWidth = _IndexStride * IndexCount;
+	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	InitData.pSysMem = IndexData;
 	hr = GEngine->_Device->CreateBuffer( &bd, &InitData, &_IndexBuffer );
 	if( FAILED( hr ) )
 	{
@@ -658,21 +800,203 @@ bool SkeletalMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 
 	SetD3DResourceDebugName("SkeletalMesh_IndexBuffer", _IndexBuffer);
 
+	return true;
+}
 
-	_NumTriangle = PolygonCount;
-	_NumVertex = lPolygonVertexCount;
+template<class VertexType>
+static void DecodeSkinVertex(const VertexType& Vertex, SkinSourceVertex& Out)
+{
+	// unorm8 weights and uint8 bones, the same conversion the input assembler does
+	for(int k=0;k<MAX_BONELINK;k++)
+	{
+		Out.Weights[k] = (float)((Vertex.Weights >> k*8) & 0xff) / 255.f;
+		Out.Bones[k] = (unsigned char)((Vertex.Bones >> k*8) & 0xff);
+	}
+}
 
-	if(_NormalArray.size() != 0 && _TexCoordArray.size() == 0)
+void SkeletalMesh::BuildSkinSource( const void* VertexData )
+{
+	_SkinSourceArray.resize(_NumVertex);
+	XMFLOAT4 Scale, Bias;
+	GetPositionScaleBias(Scale, Bias);
+	for(int i=0;i<_NumVertex;i++)
 	{
-		_VertexStride = sizeof(NormalVertexGpuSkin);
-		_NumTexCoord = 0;
+		const unsigned char* Vertex = (const unsigned char*)VertexData + i * _VertexStride;
+		SkinSourceVertex& Out = _SkinSourceArray[i];
+		Out.TexCoord = XMFLOAT2(0.f, 0.f);
+		if(_CompressedVertex && _NumTexCoord == 0)
+		{
+			const CompressedNormalVertexGpuSkin& In = *(const CompressedNormalVertexGpuSkin*)Vertex;
+			Out.Position = DecodePosition(In.Position, Scale, Bias);
+			Out.Normal = DecodeNormal(In.Normal);
+			DecodeSkinVertex(In, Out);
+		}
+		else if(_CompressedVertex)
+		{
+			const CompressedNormalTexVertexGpuSkin& In = *(const CompressedNormalTexVertexGpuSkin*)Vertex;
+			Out.Position = DecodePosition(In.Position, Scale, Bias);
+			Out.Normal = DecodeNormal(In.Normal);
+			Out.TexCoord = DecodeTexCoord(In.TexCoord);
+			DecodeSkinVertex(In, Out);
+		}
+		else if(_NumTexCoord == 0)
+		{
+			const NormalVertexGpuSkin& In = *(const NormalVertexGpuSkin*)Vertex;
+			Out.Position = In.Position;
+			Out.Normal = In.Normal;
+			DecodeSkinVertex(In, Out);
+		}
+		else
+		{
+			const NormalTexVertexGpuSkin& In = *(const NormalTexVertexGpuSkin*)Vertex;
+			Out.Position = In.Position;
+			Out.Normal = In.Normal;
+			Out.TexCoord = In.TexCoord;
+			DecodeSkinVertex(In, Out);
+		}
 	}
-	if(_NormalArray.size() != 0L && _TexCoordArray.size() != 0)
+}
 
+bool SkeletalMesh::CreateRenderBuffers()
+{
+	if(_NumVertex == 0 || _IndiceArray.size() == 0 || _SkinInfoArray.size() < (unsigned int)_NumVertex)
+		return false;
+
+	std::vector<unsigned char> VertexData;
+	BuildVertexData(VertexData);
+	std::vector<unsigned char> IndexData;
+	BuildIndexData(IndexData);
+	return CreateBuffers(&VertexData[0], &IndexData[0], _IndiceArray.size());
+}
+
+bool SkeletalMesh::ImportFromCookedMesh( const CookedMeshView& View )
+{
+	const CookedMeshEntry& Entry = *View.Entry;
+	if(Entry.MeshType != CookedMeshSkeletal || Entry.VertexCount == 0 || Entry.IndexCount == 0)
+		return false;
+	if(Entry.SkinInfoCount > 0 && Entry.SkinInfoStride != sizeof(SkinInfo))
+		return false;
+	// skin info bones index the required bones
+	const SkinInfo* SkinInfoData = (const SkinInfo*)View.SkinInfo;
+	for(unsigned int i=0;i<Entry.SkinInfoCount;i++)
 	{
-		_VertexStride = sizeof(NormalTexVertexGpuSkin);
-		_NumTexCoord = 1;
+		for(int b=0;b<MAX_BONELINK;b++)
+		{
+			if(SkinInfoData[i].Bones[b] >= Entry.RequiredBoneCount)
+				return false;
+		}
 	}
 
+	_VertexStride = Entry.VertexStride;
+	_NumVertex = Entry.VertexCount;
+	_NumTriangle = Entry.LODCount > 0 ? View.LODs[0].TriangleCount : Entry.IndexCount / TRIANGLE_VERTEX_COUNT;
+	_NumTexCoord = Entry.NumTexCoord;
+	_CompressedVertex = (Entry.VertexFlags & COOKED_VERTEX_COMPRESSED) != 0;
+	_IndexStride = Entry.IndexStride;
+	_AABBMin = XMFLOAT3(Entry.BoundsMin[0], Entry.BoundsMin[1], Entry.BoundsMin[2]);
+	_AABBMax = XMFLOAT3(Entry.BoundsMax[0], Entry.BoundsMax[1], Entry.BoundsMax[2]);
+
+	for(unsigned int i=0;i<Entry.SubMeshCount;i++)
+	{
+		SubMesh* NewSubMesh = new SubMesh;
+		NewSubMesh->_IndexOffset = View.SubMeshes[i].IndexOffset;
+		NewSubMesh->_TriangleCount = View.SubMeshes[i].TriangleCount;
+		_SubMeshArray.push_back(NewSubMesh);
+	}
+
+	if(View.SkinInfo)
+	{
+		_SkinInfoArray.assign(SkinInfoData, SkinInfoData + Entry.SkinInfoCount);
+	}
+
+	_NumBone = Entry.RequiredBoneCount;
+	if(View.RequiredBones)
+		_RequiredBoneArray.assign(View.RequiredBones, View.RequiredBones + Entry.RequiredBoneCount);
+
+	for(unsigned int i=0;i<Entry.LODCount;i++)
+	{
+		MeshLOD LOD;
+		LOD.IndexOffset = View.LODs[i].IndexOffset;
+		LOD.TriangleCount = View.LODs[i].TriangleCount;
+		LOD.VertexCount = View.LODs[i].VertexCount;
+		LOD.ScreenSize = View.LODs[i].ScreenSize;
+		LOD.Error = View.LODs[i].Error;
+		_LODArray.push_back(LOD);
+	}
+	if(_LODArray.size() == 0)
+	{
+		MeshLOD LOD;
+		LOD.IndexOffset = 0;
+		LOD.TriangleCount = _NumTriangle;
+		LOD.VertexCount = _NumVertex;
+		LOD.ScreenSize = FLOAT_MAX;
+		LOD.Error = 0.f;
+		_LODArray.push_back(LOD);
+	}
+
+	// vertex and index data go straight from the mapped file to the device
+	if(!CreateBuffers(View.VertexData, View.IndexData, Entry.IndexCount))
+		return false;
+
+	// the bones packed in the vertices index the palette on the cpu skinning path too, unweighted ones included
+	for(unsigned int i=0;i<_SkinSourceArray.size();i++)
+	{
+		for(int b=0;b<MAX_BONELINK;b++)
+		{
+			if(_SkinSourceArray[i].Bones[b] >= _NumBone)
+				return false;
+		}
+	}
 	return true;
 }
+
+void SkeletalMesh::AddToCookedMesh( CookedMeshWriter& Writer )
+{
+	std::vector<unsigned char> VertexData;
+	BuildVertexData(VertexData);
+	std::vector<unsigned char> IndexData;
+	BuildIndexData(IndexData);
+
+	std::vector<CookedSubMesh> SubMeshes(_SubMeshArray.size());
+	for(unsigned int i=0;i<_SubMeshArray.size();i++)
+	{
+		SubMeshes[i].IndexOffset = _SubMeshArray[i]->_IndexOffset;
+		SubMeshes[i].TriangleCount = _SubMeshArray[i]->_TriangleCount;
+		// skinned submeshes are culled by the component, the mesh bounds stand in
+		SubMeshes[i].BoundsMin[0] = _AABBMin.x; SubMeshes[i].BoundsMin[1] = _AABBMin.y; SubMeshes[i].BoundsMin[2] = _AABBMin.z;
+		SubMeshes[i].BoundsMax[0] = _AABBMax.x; SubMeshes[i].BoundsMax[1] = _AABBMax.y; SubMeshes[i].BoundsMax[2] = _AABBMax.z;
+	}
+
+	std::vector<CookedMeshLOD> LODs(_LODArray.size());
+	for(unsigned int i=0;i<_LODArray.size();i++)
+	{
+		LODs[i].IndexOffset = _LODArray[i].IndexOffset;
+		LODs[i].TriangleCount = _LODArray[i].TriangleCount;
+		LODs[i].VertexCount = _LODArray[i].VertexCount;
+		LODs[i].ScreenSize = _LODArray[i].ScreenSize;
+		LODs[i].Error = _LODArray[i].Error;
+	}
+
+	CookedMeshDesc Desc;
+	Desc.MeshType = CookedMeshSkeletal;
+	Desc.VertexStride = _VertexStride;
+	Desc.VertexCount = _NumVertex;
+	Desc.VertexData = VertexData.size() ? &VertexData[0] : NULL;
+	Desc.IndexCount = _IndiceArray.size();
+	Desc.IndexStride = _IndexStride;
+	Desc.IndexData = IndexData.size() ? &IndexData[0] : NULL;
+	Desc.VertexFlags = _CompressedVertex ? COOKED_VERTEX_COMPRESSED : 0;
+	Desc.NumTexCoord = _NumTexCoord;
+	Desc.SubMeshCount = SubMeshes.size();
+	Desc.SubMeshes = SubMeshes.size() ? &SubMeshes[0] : NULL;
+	Desc.SkinInfoStride = sizeof(SkinInfo);
+	Desc.SkinInfoCount = _SkinInfoArray.size();
+	Desc.SkinInfo = _SkinInfoArray.size() ? &_SkinInfoArray[0] : NULL;
+	Desc.RequiredBoneCount = _RequiredBoneArray.size();
+	Desc.RequiredBones = _RequiredBoneArray.size() ? (const int32_t*)&_RequiredBoneArray[0] : NULL;
+	Desc.LODCount = LODs.size();
+	Desc.LODs = LODs.size() ? &LODs[0] : NULL;
+	Desc.BoundsMin[0] = _AABBMin.x; Desc.BoundsMin[1] = _AABBMin.y; Desc.BoundsMin[2] = _AABBMin.z;
+	Desc.BoundsMax[0] = _AABBMax.x; Desc.BoundsMax[1] = _AABBMax.y; Desc.BoundsMax[2] = _AABBMax.z;
+	Writer.AddMesh(Desc);
+}
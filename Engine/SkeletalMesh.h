@@ -9,10 +9,14 @@
 #include "ShaderRes.h"
 #include "FbxFileImporter.h"
 #include "Skeleton.h"
+#include "CookedMesh.h"
+#include "MeshSource.h"
+#include "VertexCompression.h"
+#include "CpuSkinning.h"
+#include "MeshSimplifier.h"
 
 #include "baseobject.h"
 
-#define MAX_BONELINK 4
 struct NormalVertexGpuSkin
 {
 	XMFLOAT3 Position;
@@ -30,6 +34,23 @@ struct NormalTexVertexGpuSkin
 	unsigned int Bones;
 };
 
+struct CompressedNormalVertexGpuSkin
+{
+	CompressedPosition Position;
+	CompressedNormal Normal;
+	unsigned int Weights;
+	unsigned int Bones;
+};
+
+struct CompressedNormalTexVertexGpuSkin
+{
+	CompressedPosition Position;
+	CompressedNormal Normal;
+	CompressedTexCoord TexCoord;
+	unsigned int Weights;
+	unsigned int Bones;
+};
+
 struct SkinInfo
 {
 	float			Weights[MAX_BONELINK];
@@ -49,6 +70,7 @@ public:
 	std::vector<DWORD> _IndiceArray;
 
 	std::vector<SkinInfo> _SkinInfoArray;
+	std::vector<SkinSourceVertex> _SkinSourceArray;
 
 	int _NumTexCoord;
 	int _NumTriangle;
@@ -59,16 +81,31 @@ public:
 	ID3D11Buffer*				_BoneMatricesBuffer;
 	ID3D11ShaderResourceView*	_BoneMatricesBufferRV;
 	unsigned int _VertexStride;
+	bool _CompressedVertex;		// request before import, cleared when the mesh exceeds the error bounds
+	unsigned int _IndexStride;		// 2 when every index fits in 16 bits
+	int _MaxLODCount;				// request before import, 1 keeps only the source mesh
+	static bool _bLogImportStats;	// vertex cache and lod figures of every import, off by default
+
+	XMFLOAT3 _AABBMin;
+	XMFLOAT3 _AABBMax;
 
 	class SubMesh
 	{
 	public:
 		int _TriangleCount;
 		int _IndexOffset;
+		SubMesh()
+		{
+			_TriangleCount = 0;
+			_IndexOffset = 0;
+		}
 	};
 
 	std::vector<SubMesh*> _SubMeshArray;
 
+	// lod 0 is the source mesh and covers [0, _NumTriangle*3) of the index buffer, coarser lods follow it
+	std::vector<MeshLOD> _LODArray;
+
 	int _NumBone;
 
 	std::vector<int> _RequiredBoneArray;
@@ -76,7 +113,32 @@ public:
 	Skeleton*	_Skeleton;
 	SkeletonPose* _Pose;
 public:
-	bool ImportFromFbxMesh(FbxMesh* Mesh, FbxFileImporter* Importer);
+	bool ImportFromMeshSource(const MeshSource& Source, const std::map<std::string, BoneIndexInfo>& InBoneIndexMap);
+	bool ImportFromCookedMesh(const CookedMeshView& View);
+	void AddToCookedMesh(CookedMeshWriter& Writer);
+
+	// creates device buffers from the imported cpu arrays
+	bool CreateRenderBuffers();
+
+	DXGI_FORMAT GetIndexFormat() const {return _IndexStride == sizeof(unsigned short) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;}
+	// position decode for the vertex shader, identity for float vertices
+	void GetPositionScaleBias(XMFLOAT4& OutScale, XMFLOAT4& OutBias) const;
+	// lod for the projected size of the bounds
+	int SelectLOD(const XMMATRIX& ViewMat, const XMMATRIX& ProjectionMat) const;
+private:
+	void CalcBounds();
+	void SelectVertexFormat();
+	// merges identical per-corner vertices and rewrites the index buffer
+	void WeldVertices();
+	// per submesh vertex cache and overdraw ordering, then vertex fetch order
+	void OptimizeIndices();
+	// simplified index ranges appended after lod 0, vertices sorted so every lod reads a prefix
+	void BuildLODs();
+	void BuildVertexData(std::vector<unsigned char>& OutVertexData);
+	void BuildIndexData(std::vector<unsigned char>& OutIndexData);
+	bool CreateBuffers(const void* VertexData, const void* IndexData, unsigned int IndexCount);
+	void BuildSkinSource(const void* VertexData);
+public:
 
 	SkeletalMesh(void);
 	virtual ~SkeletalMesh(void);
@@ -1,23 +1,42 @@
 #include <cassert>
+#include <string.h>
 #include "SkeletalMeshComponent.h"
 #include "Engine.h"
 #include "LineBatcher.h"
 #include "SkeletalMeshRenderData.h"
 #include "AnimClipInstance.h"
+#include "SkeletalMeshRegistry.h"
+#include "BakedAnimation.h"
+#include "MathUtil.h"
 
 
 SkeletalMeshComponent::SkeletalMeshComponent(void)
-	:_BoneWorld(NULL)
+	:_BoneModel(NULL)
+	,_SkinPalette(NULL)
+	,_SkinDualQuat(NULL)
+	,_SkinningMode(SKIN_LINEAR)
 	,_Skeleton(NULL)
-	,_Pose(NULL)
 	,_CurrentAnim(NULL)
+	,_bKeyPaletteValid(false)
+	,_AnimLODBand(0)
+	,_UpdatePhase(0)
+	,_BakedAnim(NULL)
+	,_BakedFrame(0)
+	,_BakedPalette(NULL)
+	,_BakedDualQuat(NULL)
 {
+	_KeyPalette[0] = _KeyPalette[1] = NULL;
+	XMStoreFloat4x4(&_World, XMMatrixIdentity());
 }
 
 
 SkeletalMeshComponent::~SkeletalMeshComponent(void)
 {
-	if(_BoneWorld) delete[] _BoneWorld;
+	if(_BoneModel) delete[] _BoneModel;
+	if(_SkinPalette) delete[] _SkinPalette;
+	if(_SkinDualQuat) delete[] _SkinDualQuat;
+	if(_KeyPalette[0]) delete[] _KeyPalette[0];
+	if(_KeyPalette[1]) delete[] _KeyPalette[1];
 
 	for(unsigned int i=0;i<_RenderDataArray.size();i++)
 	{
@@ -33,17 +52,75 @@ void SkeletalMeshComponent::SetSkeleton(Skeleton* Skeleton)
 {
 	_Skeleton = Skeleton;
 
-	if( _BoneWorld)
-		delete _BoneWorld;
-	_BoneWorld = new XMFLOAT4X4[_Skeleton->_JointCount];
+	if(_BoneModel)
+		delete[] _BoneModel;
+	if(_SkinPalette)
+		delete[] _SkinPalette;
+	if(_SkinDualQuat)
+		delete[] _SkinDualQuat;
+	for(int i=0;i<2;i++)
+	{
+		if(_KeyPalette[i])
+			delete[] _KeyPalette[i];
+		_KeyPalette[i] = new BoneMatrix3x4[_Skeleton->_JointCount];
+	}
+	_BoneModel = new BoneMatrix3x4[_Skeleton->_JointCount];
+	_SkinPalette = new BoneMatrix3x4[_Skeleton->_JointCount];
+	_SkinDualQuat = new BoneDualQuat[_Skeleton->_JointCount];
+	_bKeyPaletteValid = false;
+
+	// bind pose until the first tick, a component that starts out of view still uploads something sane
+	for(int i=0;i<_Skeleton->_JointCount;i++)
+	{
+		_SkinPalette[i].Row[0] = XMFLOAT4(1.f, 0.f, 0.f, 0.f);
+		_SkinPalette[i].Row[1] = XMFLOAT4(0.f, 1.f, 0.f, 0.f);
+		_SkinPalette[i].Row[2] = XMFLOAT4(0.f, 0.f, 1.f, 0.f);
+	}
+	BonePalette::ToDualQuat(_SkinPalette, _Skeleton->_JointCount, _SkinDualQuat);
 }
 
-void SkeletalMeshComponent::SetCurrentPose(SkeletonPose* Pose)
+void SkeletalMeshComponent::SetCurrentPose(const SkeletonPose& Pose)
 {
 	_Pose = Pose;
 }
 
-void SkeletalMeshComponent::UpdateBoneMatrices()
+void SkeletalMeshComponent::SetSkinningMode(ESkinningMode Mode)
+{
+	// converted right away, a frozen component isn't ticked again until it's back in view
+	_SkinningMode = Mode;
+	if(_SkinningMode == SKIN_DUALQUAT && _Skeleton)
+		BonePalette::ToDualQuat(_SkinPalette, _Skeleton->_JointCount, _SkinDualQuat);
+}
+
+void SkeletalMeshComponent::SetBakedAnim(BakedAnimation* InBaked)
+{
+	// the cache entries are reused next frame, keep the frame on screen in the component's own palette
+	if(_BakedPalette)
+	{
+		memcpy(_SkinPalette, _BakedPalette, _Skeleton->_JointCount * sizeof(BoneMatrix3x4));
+	}
+	if(_BakedDualQuat)
+	{
+		memcpy(_SkinDualQuat, _BakedDualQuat, _Skeleton->_JointCount * sizeof(BoneDualQuat));
+		BonePalette::FromDualQuat(_SkinDualQuat, _Skeleton->_JointCount, _SkinPalette);
+	}
+	_BakedAnim = InBaked;
+	_BakedPalette = NULL;
+	_BakedDualQuat = NULL;
+	_bKeyPaletteValid = false;
+}
+
+bool SkeletalMeshComponent::IsBakedPlayback() const
+{
+	return _BakedAnim && _CurrentAnim && _CurrentAnim->GetClip() == _BakedAnim->_Clip && _Skeleton == _BakedAnim->_Skeleton;
+}
+
+void SkeletalMeshComponent::SetWorld(const XMMATRIX& World)
+{
+	XMStoreFloat4x4(&_World, World);
+}
+
+void SkeletalMeshComponent::DrawDebugBones()
 {
 	// debug draw ref pose line
 	/*for(int i=0;i<_Skeleton->_JointCount;i++)
@@ -66,58 +143,23 @@ void SkeletalMeshComponent::UpdateBoneMatrices()
 			GEngine->_LineBatcher->AddLine(XMFLOAT3(RefMat._41, RefMat._42, RefMat._43), XMFLOAT3(RefMatParent._41, RefMatParent._42, RefMatParent._43), XMFLOAT3(0, 1, 0), XMFLOAT3(0, 0, 1));
 	}
 */
-	// calc world bone
-	for(int i=0;i<_Skeleton->_JointCount;i++)
-	{
-		SkeletonJoint& RefPose = _Skeleton->_Joints[i];
-		JointPose& LocalPose = _Pose->_LocalPoseArray[i];
-		XMMATRIX MatScale = XMMatrixScaling(LocalPose._Scale.x, LocalPose._Scale.y, LocalPose._Scale.z);
-		XMVECTOR QuatVec = XMLoadFloat4(&LocalPose._Rot);
-		XMMATRIX MatRot = XMMatrixRotationQuaternion(QuatVec);
-		XMMATRIX MatTrans = XMMatrixTranslation(LocalPose._Trans.x, LocalPose._Trans.y, LocalPose._Trans.z);
-
-		
-		XMMATRIX MatBone;
-		if(RefPose._ParentIndex < 0) // root
-		{
-			MatBone = XMMatrixMultiply(MatScale, MatRot);
-			MatBone = XMMatrixMultiply(MatBone, MatTrans);
-
-			XMStoreFloat4x4(&_BoneWorld[i], MatBone);
-		}
-		else
-		{
-			XMMATRIX MatParent;
-			MatParent = XMLoadFloat4x4(&_BoneWorld[RefPose._ParentIndex]);
-
-			MatBone = XMMatrixMultiply(MatScale, MatRot);
-			MatBone = XMMatrixMultiply(MatBone, MatTrans);
-			MatBone = XMMatrixMultiply(MatBone, MatParent);
-
-			GEngine->_LineBatcher->AddLine(XMFLOAT3(MatParent._41, MatParent._42, MatParent._43), XMFLOAT3(MatBone._41, MatBone._42, MatBone._43), XMFLOAT3(1, 0, 0), XMFLOAT3(1, 0, 0));
-
-			XMStoreFloat4x4(&_BoneWorld[i], MatBone);
-		}
-	}
-
-	// ref inverse * bone world
 	for(int i=0;i<_Skeleton->_JointCount;i++)
 	{
-		XMMATRIX RefInv;
-		XMFLOAT4X4& RefInvF = _Skeleton->_Joints[i]._InvRefPose;
-		RefInv = XMLoadFloat4x4(&RefInvF);
-
-		XMMATRIX MatBone;
-		MatBone = XMLoadFloat4x4(&_BoneWorld[i]);
-		
-		MatBone = XMMatrixMultiply(RefInv, MatBone);
-		XMStoreFloat4x4(&_BoneWorld[i], MatBone);
+		const int ParentIndex = _Skeleton->_Joints[i]._ParentIndex;
+		if(ParentIndex < 0)
+			continue;
+		const BoneMatrix3x4& Bone = _BoneModel[i];
+		const BoneMatrix3x4& Parent = _BoneModel[ParentIndex];
+		GEngine->_LineBatcher->AddLine(XMFLOAT3(Parent.Row[0].w, Parent.Row[1].w, Parent.Row[2].w), XMFLOAT3(Bone.Row[0].w, Bone.Row[1].w, Bone.Row[2].w), XMFLOAT3(1, 0, 0), XMFLOAT3(1, 0, 0));
 	}
+}
 
+void SkeletalMeshComponent::UploadBoneMatrices(BonePaletteArena& Arena)
+{
 	for(unsigned int i=0;i<_RenderDataArray.size();i++)
 	{
 		SkeletalMeshRenderData* RenderData = _RenderDataArray[i];
-		RenderData->UpdateBoneMatrices();
+		RenderData->UpdateBoneMatrices(Arena);
 	}
 }
 
@@ -129,19 +171,75 @@ void SkeletalMeshComponent::AddSkeletalMesh(SkeletalMesh* InSkeletalMesh)
 	_RenderDataArray.push_back(RenderData);
 }
 
-void SkeletalMeshComponent::Tick( float DeltaSeconds )
+void SkeletalMeshComponent::TickAnimation( float DeltaSeconds )
 {
 	DeltaSeconds;
 	if(_CurrentAnim)
 	{
 		_CurrentAnim->Tick();
-		_CurrentAnim->GetCurrentPose(*_Pose);
+		_CurrentAnim->GetCurrentPose(_Pose);
 	}
-	UpdateBoneMatrices();
+	BonePalette::Build(*_Skeleton, _Pose, _BoneModel, _SkinPalette);
+	if(_SkinningMode == SKIN_DUALQUAT)
+		BonePalette::ToDualQuat(_SkinPalette, _Skeleton->_JointCount, _SkinDualQuat);
+	_bKeyPaletteValid = false;
+}
+
+void SkeletalMeshComponent::TickBakedFrame()
+{
+	_CurrentAnim->Tick();
+	_BakedFrame = _BakedAnim->GetFrameIndex(_CurrentAnim->GetLocalTime());
+}
+
+void SkeletalMeshComponent::TickAnimationReduced( float DeltaSeconds, bool bEvaluate, float Alpha )
+{
+	DeltaSeconds;
+	if(bEvaluate || !_bKeyPaletteValid)
+	{
+		if(_CurrentAnim)
+		{
+			_CurrentAnim->Tick();
+			_CurrentAnim->GetCurrentPose(_Pose);
+		}
+
+		BoneMatrix3x4* Previous = _KeyPalette[0];
+		_KeyPalette[0] = _KeyPalette[1];
+		_KeyPalette[1] = Previous;
+		BonePalette::Build(*_Skeleton, _Pose, _BoneModel, _KeyPalette[1]);
+
+		// nothing to blend from yet
+		if(!_bKeyPaletteValid)
+			memcpy(_KeyPalette[0], _KeyPalette[1], _Skeleton->_JointCount * sizeof(BoneMatrix3x4));
+		_bKeyPaletteValid = true;
+	}
+
+	// one interval behind the newest key, so the blend never has to guess
+	BonePalette::Lerp(_KeyPalette[0], _KeyPalette[1], Alpha, _Skeleton->_JointCount, _SkinPalette);
+	if(_SkinningMode == SKIN_DUALQUAT)
+		BonePalette::ToDualQuat(_SkinPalette, _Skeleton->_JointCount, _SkinDualQuat);
+}
+
+void SkeletalMeshComponent::GetBoundingSphere( XMFLOAT3& OutCenter, float& OutRadius ) const
+{
+	XMVECTOR AABBMin = XMVectorReplicate(FLOAT_MAX);
+	XMVECTOR AABBMax = XMVectorReplicate(-FLOAT_MAX);
+	for(unsigned int i=0;i<_SkeletalMeshArray.size();i++)
+	{
+		AABBMin = XMVectorMin(AABBMin, XMLoadFloat3(&_SkeletalMeshArray[i]->_AABBMin));
+		AABBMax = XMVectorMax(AABBMax, XMLoadFloat3(&_SkeletalMeshArray[i]->_AABBMax));
+	}
+
+	// reference pose bounds, padded since the animated pose reaches further
+	const XMMATRIX World = XMLoadFloat4x4(&_World);
+	XMStoreFloat3(&OutCenter, XMVector3Transform(XMVectorScale(XMVectorAdd(AABBMin, AABBMax), 0.5f), World));
+	const float WorldScale = XMVectorGetX(XMVector3Length(World.r[0]));
+	OutRadius = XMVectorGetX(XMVector3Length(XMVectorSubtract(AABBMax, AABBMin))) * 0.5f * WorldScale * ANIM_LOD_BOUNDS_SCALE;
 }
 
 void SkeletalMeshComponent::PlayAnim(AnimationClip* InClip, int InNumPlay, float InRate)
 {
+	if(_CurrentAnim)
+		delete _CurrentAnim;
 	_CurrentAnim = new AnimClipInstance(InClip);
 	_CurrentAnim->Play(InNumPlay);
 	_CurrentAnim->SetTimeScale(InRate);
@@ -5,12 +5,15 @@
 
 #include "basecomponent.h"
 #include "SkeletalMesh.h"
+#include "BonePalette.h"
 class SkeletalMesh;
 class Skeleton;
 class AnimationClip;
 class AnimClipInstance;
 
 class SkeletalMeshRenderData;
+class BonePaletteArena;
+class BakedAnimation;
 
 class SkeletalMeshComponent :
 	public BaseComponent
@@ -22,21 +25,57 @@ public:
 
 	std::vector<SkeletalMesh*> _SkeletalMeshArray;
 
-	XMFLOAT4X4* _BoneWorld;
+	BoneMatrix3x4* _BoneModel;		// model space joint transforms
+	BoneMatrix3x4* _SkinPalette;	// model space * inverse bind, per skeleton joint
+	BoneDualQuat* _SkinDualQuat;	// _SkinPalette as dual quaternions, SKIN_DUALQUAT only
+	ESkinningMode _SkinningMode;
+
+	// animation lod state, driven by SkeletalMeshRegistry
+	BoneMatrix3x4* _KeyPalette[2];	// last two evaluated palettes of a reduced rate band
+	bool	_bKeyPaletteValid;
+	int		_AnimLODBand;
+	int		_UpdatePhase;			// staggers reduced rate updates across frames
+
+	// baked playback, the clip instance only picks a frame of _BakedAnim. the registry points
+	// the palette of the current skinning mode into its shared cache, NULL while sampling
+	BakedAnimation* _BakedAnim;
+	int		_BakedFrame;
+	const BoneMatrix3x4* _BakedPalette;
+	const BoneDualQuat* _BakedDualQuat;
 
 	Skeleton*	_Skeleton;
-	SkeletonPose* _Pose;
+	SkeletonPose _Pose;		// own copy, every instance of a crowd poses independently
+	XMFLOAT4X4	_World;
 
 	AnimClipInstance* _CurrentAnim;
 public:
 	void PlayAnim(AnimationClip* InClip, int InNumPlay = 0, float InRate = 1.f);
-	void Tick(float DeltaSeconds);
-	void UpdateBoneMatrices();
+
+	// sample, local to model, palette. touches only this component, so components animate in parallel
+	void TickAnimation(float DeltaSeconds);
+	// reduced rate: bEvaluate builds a new key palette, every frame blends the last two keys by Alpha
+	void TickAnimationReduced(float DeltaSeconds, bool bEvaluate, float Alpha);
+	// baked: advances the clip time and picks the nearest baked frame, nothing else
+	void TickBakedFrame();
+	// baked and still playing the clip it was baked from
+	bool IsBakedPlayback() const;
+	void GetBoundingSphere(XMFLOAT3& OutCenter, float& OutRadius) const;
+	// palette into the mapped arena, one run per mesh
+	void UploadBoneMatrices(BonePaletteArena& Arena);
+	void DrawDebugBones();
 
 	void AddSkeletalMesh(SkeletalMesh* InSkeletalMesh);
 	void SetSkeleton(Skeleton* Skeleton);
-	void SetCurrentPose(SkeletonPose* Pose);
+	void SetCurrentPose(const SkeletonPose& Pose);
+	void SetWorld(const XMMATRIX& World);
 	void SetCurrentAnim(AnimationClip* InClip);
+	void SetSkinningMode(ESkinningMode Mode);
+	// NULL goes back to sampling, from the last baked frame
+	void SetBakedAnim(BakedAnimation* InBaked);
+	// what gets uploaded and pre-skinned, the shared baked palette or the component's own
+	const BoneMatrix3x4* GetSkinPalette() const { return _BakedPalette ? _BakedPalette : _SkinPalette; }
+	const BoneDualQuat* GetSkinDualQuat() const { return _BakedDualQuat ? _BakedDualQuat : _SkinDualQuat; }
+	int GetPaletteElementsPerBone() const { return _SkinningMode == SKIN_DUALQUAT ? BONE_ELEMENTS_DUALQUAT : BONE_ELEMENTS_LINEAR; }
 
 	SkeletalMeshComponent(void);
 	virtual ~SkeletalMeshComponent(void);
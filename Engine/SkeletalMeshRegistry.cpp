@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <math.h>
+
+#include "SkeletalMeshRegistry.h"
+#include "SkeletalMeshComponent.h"
+#include "SkeletalMeshRenderData.h"
+#include "BonePaletteArena.h"
+#include "MeshSimplifier.h"
+#include "FrustumCuller.h"
+#include "AnimationClip.h"
+#include "ParallelFor.h"
+#include "OutputDebug.h"
+
+SkeletalMeshRegistry::SkeletalMeshRegistry()
+	:_bLogStats(false)
+	,_FrameIndex(0)
+	,_BakedSampleRate(BAKED_ANIM_DEFAULT_RATE)
+	,_BakedFormat(SKIN_LINEAR)
+	,_bBakedHalf(false)
+{
+	AnimLODBand Bands[] =
+	{
+		{0.25f, 1},
+		{0.08f, 2},
+		{0.f, 4},
+	};
+	_BandArray.assign(Bands, Bands + sizeof(Bands) / sizeof(Bands[0]));
+	_Stats.UploadCount = 0;
+	_Stats.BakedCount = 0;
+	_Stats.BakedPaletteCount = 0;
+	_Stats.BakedMicroseconds = 0.f;
+	_Stats.SampledMicroseconds = 0.f;
+}
+
+SkeletalMeshRegistry::~SkeletalMeshRegistry()
+{
+	for(unsigned int i=0;i<_BakedArray.size();i++)
+	{
+		delete _BakedArray[i];
+	}
+}
+
+void SkeletalMeshRegistry::Register( SkeletalMeshComponent* Component )
+{
+	if(std::find(_ComponentArray.begin(), _ComponentArray.end(), Component) != _ComponentArray.end())
+		return;
+	Component->_UpdatePhase = _ComponentArray.size();
+	_ComponentArray.push_back(Component);
+}
+
+void SkeletalMeshRegistry::Unregister( SkeletalMeshComponent* Component )
+{
+	std::vector<SkeletalMeshComponent*>::iterator it = std::find(_ComponentArray.begin(), _ComponentArray.end(), Component);
+	if(it != _ComponentArray.end())
+		_ComponentArray.erase(it);
+}
+
+BakedAnimation* SkeletalMeshRegistry::GetBakedAnimation( AnimationClip* Clip, Skeleton* Skel, const SkeletonPose& RefPose )
+{
+	for(unsigned int i=0;i<_BakedArray.size();i++)
+	{
+		if(_BakedArray[i]->_Clip == Clip && _BakedArray[i]->_Skeleton == Skel)
+			return _BakedArray[i];
+	}
+
+	BakedAnimation* Baked = new BakedAnimation;
+	Baked->Bake(Clip, *Skel, RefPose, _BakedSampleRate, _BakedFormat, _bBakedHalf);
+	_BakedArray.push_back(Baked);
+	cout_debug("baked clip : %d frames of %d joints at %.0f hz, %d bytes baked, %d bytes of keys\n",
+		Baked->_FrameCount, Baked->_JointCount, Baked->_SampleRate, Baked->GetMemorySize(), Clip->GetMemorySize());
+	return Baked;
+}
+
+void SkeletalMeshRegistry::LogBakedStats() const
+{
+	int BakedBytes = 0, KeyBytes = 0;
+	for(unsigned int i=0;i<_BakedArray.size();i++)
+	{
+		BakedBytes += _BakedArray[i]->GetMemorySize();
+		KeyBytes += _BakedArray[i]->_Clip->GetMemorySize();
+	}
+	cout_debug("baked clips : %d bakes, %d bytes baked, %d bytes of keys\n", (int)_BakedArray.size(), BakedBytes, KeyBytes);
+	cout_debug("anim last frame : %d baked instances on %d palettes, %.2f us per baked instance, %.2f us per sampled instance\n",
+		_Stats.BakedCount, _Stats.BakedPaletteCount, _Stats.BakedMicroseconds, _Stats.SampledMicroseconds);
+}
+
+static double GetSeconds()
+{
+	LARGE_INTEGER Counter, Frequency;
+	QueryPerformanceCounter(&Counter);
+	QueryPerformanceFrequency(&Frequency);
+	return (double)Counter.QuadPart / (double)Frequency.QuadPart;
+}
+
+static bool IsSphereInFrustum(const XMFLOAT4* Planes, const XMFLOAT3& Center, float Radius)
+{
+	for(int p=0;p<6;p++)
+	{
+		if(Planes[p].x * Center.x + Planes[p].y * Center.y + Planes[p].z * Center.z + Planes[p].w < -Radius)
+			return false;
+	}
+	return true;
+}
+
+void SkeletalMeshRegistry::TickAnimation( float DeltaSeconds, const XMMATRIX* ViewMat, const XMMATRIX* ProjectionMat )
+{
+	const int BandCount = _BandArray.size();
+	const int FrozenBand = BandCount;
+	_Stats.ComponentCount.assign(BandCount + 1, 0);
+	_Stats.EvaluatedCount.assign(BandCount + 1, 0);
+
+	XMFLOAT4 Planes[6];
+	const bool bHasView = ViewMat && ProjectionMat;
+	if(bHasView)
+		FrustumCuller::ExtractPlanes(XMMatrixMultiply(*ViewMat, *ProjectionMat), Planes);
+
+	// bands first, serially, so the stats need no locking
+	for(unsigned int i=0;i<_ComponentArray.size();i++)
+	{
+		SkeletalMeshComponent* Component = _ComponentArray[i];
+		int Band = 0;
+		if(bHasView)
+		{
+			XMFLOAT3 Center;
+			float Radius;
+			Component->GetBoundingSphere(Center, Radius);
+			if(!IsSphereInFrustum(Planes, Center, Radius))
+			{
+				Band = FrozenBand;
+			}
+			else
+			{
+				const float ScreenSize = MeshSimplifier::ComputeScreenSize(Center, Radius, *ViewMat, *ProjectionMat);
+				while(Band + 1 < BandCount && ScreenSize < _BandArray[Band].MinScreenSize)
+					Band++;
+			}
+		}
+
+		// a component coming back into view has a stale palette, evaluate it right away
+		if(Component->_AnimLODBand == FrozenBand && Band != FrozenBand)
+			Component->_bKeyPaletteValid = false;
+		Component->_AnimLODBand = Band;
+
+		_Stats.ComponentCount[Band]++;
+		if(Band != FrozenBand && !Component->IsBakedPlayback())
+		{
+			const int Interval = _BandArray[Band].UpdateInterval;
+			if(Interval <= 1 || !Component->_bKeyPaletteValid || (_FrameIndex + Component->_UpdatePhase) % Interval == 0)
+				_Stats.EvaluatedCount[Band]++;
+		}
+	}
+
+	// baked components serially, one palette per bake, frame and skinning mode shared by every instance on it
+	const double BakedStart = GetSeconds();
+	int SampledCount = 0;
+	_BakedCache.BeginFrame();
+	_BakedEntryArray.assign(_ComponentArray.size(), -1);
+	for(unsigned int i=0;i<_ComponentArray.size();i++)
+	{
+		SkeletalMeshComponent* Component = _ComponentArray[i];
+		if(!Component->IsBakedPlayback())
+		{
+			// dropped out of baked playback, by SetBakedAnim or another clip
+			if(Component->_BakedPalette || Component->_BakedDualQuat)
+				Component->SetBakedAnim(Component->_BakedAnim);
+			if(Component->_AnimLODBand != FrozenBand)
+				SampledCount++;
+			continue;
+		}
+
+		// a frozen instance keeps its frame, but the entry it points at has to exist this frame too
+		if(Component->_AnimLODBand != FrozenBand)
+			Component->TickBakedFrame();
+		_BakedEntryArray[i] = _BakedCache.Request(Component->_BakedAnim, Component->_BakedFrame, Component->_SkinningMode);
+	}
+	_BakedCache.Decode();
+	for(unsigned int i=0;i<_ComponentArray.size();i++)
+	{
+		const int Entry = _BakedEntryArray[i];
+		if(Entry < 0)
+			continue;
+		SkeletalMeshComponent* Component = _ComponentArray[i];
+		const bool bDualQuat = Component->_SkinningMode == SKIN_DUALQUAT;
+		Component->_BakedPalette = bDualQuat ? NULL : _BakedCache.GetPalette(Entry);
+		Component->_BakedDualQuat = bDualQuat ? _BakedCache.GetDualQuat(Entry) : NULL;
+	}
+	const double SampledStart = GetSeconds();
+
+	ParallelFor(0, (int)_ComponentArray.size(), [&](int i)
+	{
+		SkeletalMeshComponent* Component = _ComponentArray[i];
+		if(Component->_AnimLODBand == FrozenBand || _BakedEntryArray[i] >= 0)
+			return;
+
+		const int Interval = _BandArray[Component->_AnimLODBand].UpdateInterval;
+		if(Interval <= 1)
+		{
+			Component->TickAnimation(DeltaSeconds);
+			return;
+		}
+
+		// updates of one band spread over Interval frames by phase, so the cost per frame stays flat
+		const int Step = (_FrameIndex + Component->_UpdatePhase) % Interval;
+		Component->TickAnimationReduced(DeltaSeconds, Step == 0, (Step + 1) / (float)Interval);
+	});
+
+	const double SampledEnd = GetSeconds();
+	_Stats.BakedCount = _BakedCache._RequestCount;
+	_Stats.BakedPaletteCount = _BakedCache._EntryCount;
+	_Stats.BakedMicroseconds = _Stats.BakedCount ? (float)((SampledStart - BakedStart) * 1000000.0 / _Stats.BakedCount) : 0.f;
+	_Stats.SampledMicroseconds = SampledCount ? (float)((SampledEnd - SampledStart) * 1000000.0 / SampledCount) : 0.f;
+
+	if(_bLogStats)
+	{
+		for(int b=0;b<=BandCount;b++)
+		{
+			if(b < BandCount)
+				cout_debug("anim lod %d (every %d) : %d components, %d evaluated\n", b, _BandArray[b].UpdateInterval, _Stats.ComponentCount[b], _Stats.EvaluatedCount[b]);
+			else
+				cout_debug("anim lod frozen : %d components\n", _Stats.ComponentCount[b]);
+		}
+		cout_debug("anim baked : %d instances on %d palettes, %.2f us per instance, sampled %.2f us per instance\n",
+			_Stats.BakedCount, _Stats.BakedPaletteCount, _Stats.BakedMicroseconds, _Stats.SampledMicroseconds);
+	}
+	_FrameIndex++;
+}
+
+void SkeletalMeshRegistry::UploadBoneMatrices( BonePaletteArena& Arena, ID3D11Device* Device, ID3D11DeviceContext* Context )
+{
+	// size the frame up front so the arena grows before the map instead of refusing draws
+	int RequiredElements = 0;
+	for(unsigned int i=0;i<_ComponentArray.size();i++)
+	{
+		SkeletalMeshComponent* Component = _ComponentArray[i];
+		for(unsigned int m=0;m<Component->_RenderDataArray.size();m++)
+			RequiredElements += Component->_RenderDataArray[m]->_SkeletalMesh->_NumBone * Component->GetPaletteElementsPerBone();
+	}
+
+	Arena.BeginFrame(RequiredElements);
+	Arena.Map(Device, Context);
+	for(unsigned int i=0;i<_ComponentArray.size();i++)
+		_ComponentArray[i]->UploadBoneMatrices(Arena);
+	Arena.Unmap(Context);
+	Arena.EndFrame();
+
+	_Stats.UploadCount = _ComponentArray.size();
+	if(_bLogStats)
+		cout_debug("bone arena : %d / %d float4, %d overflowed\n", Arena._Used, Arena._Capacity, Arena._OverflowCount);
+}
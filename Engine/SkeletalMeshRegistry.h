@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include "MathTypes.h"
+#include "BakedAnimation.h"
+
+class SkeletalMeshComponent;
+class BonePaletteArena;
+class AnimationClip;
+class Skeleton;
+class SkeletonPose;
+struct ID3D11Device;
+struct ID3D11DeviceContext;
+
+#define ANIM_LOD_BOUNDS_SCALE	1.5f	// reference pose bounds grow by this for culling and screen size
+
+// animation update rate for components covering at least MinScreenSize of the view height.
+// UpdateInterval 1 evaluates every frame, N evaluates every Nth frame and blends the palette in between
+struct AnimLODBand
+{
+	float	MinScreenSize;
+	int		UpdateInterval;
+};
+
+// per frame counts, index _BandArray.size() is the frozen band of components outside the view
+struct AnimLODStats
+{
+	std::vector<int> ComponentCount;
+	std::vector<int> EvaluatedCount;	// sampled and rebuilt this frame, the rest of the band only blended
+	int UploadCount;	// components written to the bone arena
+
+	// baked playback: instances, unique palettes they shared, and wall time per instance of both paths
+	int BakedCount;
+	int BakedPaletteCount;
+	float BakedMicroseconds;
+	float SampledMicroseconds;
+};
+
+// every skinned component the engine animates and draws. the registry doesn't own them.
+// animation runs as one task per component on worker threads, the palette upload stays on the render side
+class SkeletalMeshRegistry
+{
+public:
+	std::vector<SkeletalMeshComponent*> _ComponentArray;
+
+	std::vector<AnimLODBand> _BandArray;	// largest MinScreenSize first
+	AnimLODStats	_Stats;
+	bool			_bLogStats;
+	unsigned int	_FrameIndex;
+
+	// bakes by clip and skeleton, owned by the registry. new bakes use the settings below
+	std::vector<BakedAnimation*> _BakedArray;
+	BakedPaletteCache _BakedCache;
+	std::vector<int> _BakedEntryArray;	// cache entry of each component this frame, -1 when sampled
+	float			_BakedSampleRate;
+	ESkinningMode	_BakedFormat;
+	bool			_bBakedHalf;
+
+	void Register(SkeletalMeshComponent* Component);
+	void Unregister(SkeletalMeshComponent* Component);
+
+	// the bake of Clip on Skel, baked on first use. RefPose fills the joints the clip doesn't animate
+	BakedAnimation* GetBakedAnimation(AnimationClip* Clip, Skeleton* Skel, const SkeletonPose& RefPose);
+	// memory of every bake against its clip's keys, and the last frame's cost per instance of both paths
+	void LogBakedStats() const;
+
+	// picks every component's band from the view, then sample -> pose -> local to model -> palette
+	// in parallel for the ones due this frame. without a view every component runs at full rate.
+	// baked components skip the bands' reduced rates, picking a frame costs less than the blend
+	void TickAnimation(float DeltaSeconds, const XMMATRIX* ViewMat, const XMMATRIX* ProjectionMat);
+	// serial, every component's palette into the arena under one map
+	void UploadBoneMatrices(BonePaletteArena& Arena, ID3D11Device* Device, ID3D11DeviceContext* Context);
+
+	SkeletalMeshRegistry();
+	~SkeletalMeshRegistry();
+};
@@ -3,16 +3,22 @@
 #include <d3d11.h>
 #include <d3dx11.h>
 #include <xnamath.h>
+#include "PreSkinner.h"
 
 class SkeletalMesh;
 class SkeletalMeshComponent;
+class BonePaletteArena;
 class SkeletalMeshRenderData
 {
 public:
 
-	ID3D11Buffer*				_BoneMatricesBuffer;
-	ID3D11ShaderResourceView*	_BoneMatricesBufferRV;
-	XMFLOAT4X4* _BoneMatrices;
+	int		_BoneBase;	// first element of this frame's run in the palette arena, BONE_ARENA_INVALID when it didn't fit
+
+	// model space skinned vertices, drawn as static geometry by every pass while _bPreSkinned
+	ID3D11Buffer*	_PreSkinnedBuffer;
+	EPreSkinBackend	_PreSkinnedBackend;		// backend _PreSkinnedBuffer was created for
+	unsigned int	_PreSkinnedStride;
+	bool			_bPreSkinned;
 
 	SkeletalMesh* _SkeletalMesh;
 	SkeletalMeshComponent* _SkeletalMeshComponent;
@@ -21,5 +27,6 @@ public:
 	SkeletalMeshRenderData(SkeletalMesh* InSkeletalMesh, SkeletalMeshComponent* InSkeletalMeshComponent );
 	~SkeletalMeshRenderData();
 
-	void UpdateBoneMatrices();
+	// allocates this frame's run and writes the mesh bones into the mapped arena
+	void UpdateBoneMatrices(BonePaletteArena& Arena);
 };
\ No newline at end of file
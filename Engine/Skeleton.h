@@ -1,12 +1,11 @@
-#pragma once;
+#pragma once
 
-#include <d3d11.h>
-#include <d3dx11.h>
-#include <xnamath.h>
-#include <fbxsdk.h>
+#include "MathTypes.h"
 #include <string>
 #include <vector>
 
+#include "BonePalette.h"
+
 struct SkeletonJoint
 {
 	std::string _Name;
@@ -24,7 +23,8 @@ class Skeleton
 {
 public:
 	int				_JointCount;
-	std::vector<SkeletonJoint> _Joints;
+	std::vector<SkeletonJoint> _Joints;	// parents before children
+	std::vector<BoneMatrix3x4> _InvBindArray;	// _InvRefPose of every joint in palette layout, see BonePalette::InitSkeleton
 	Skeleton()
 		:_JointCount(0)
 	{
@@ -1,5 +1,8 @@
 #include "StaticMesh.h"
 #include "Engine.h"
+#include "MathUtil.h"
+#include "MeshOptimizer.h"
+#include "OutputDebug.h"
 #include <cassert>
 
 const int TRIANGLE_VERTEX_COUNT = 3;
@@ -7,7 +10,7 @@ const int VERTEX_STRIDE = 4;
 const int NORMAL_STRIDE = 3;
 const int UV_STRIDE = 2;
 
-
+bool StaticMesh::_bLogImportStats = false;
 
 StaticMesh::StaticMesh(void)
 	:
@@ -16,7 +19,12 @@ StaticMesh::StaticMesh(void)
 	_VertexStride(0),
 	_NumTexCoord(0),
 	_NumTriangle(0),
-	_NumVertex(0)
+	_NumVertex(0),
+	_CompressedVertex(false),
+	_IndexStride(sizeof(DWORD)),
+	_MaxLODCount(1),
+	_AABBMin(XMFLOAT3(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX)),
+	_AABBMax(XMFLOAT3(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX))
 {
 }
 
@@ -32,94 +40,55 @@ StaticMesh::~StaticMesh(void)
 	}
 }
 
-bool StaticMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
+bool StaticMesh::ImportFromMeshSource( const MeshSource& Source )
 {
-	if (!Mesh->GetNode())
-		return false;
-
-	FbxNode* pNode = Mesh->GetNode();
-	FbxAMatrix Geometry;
-	FbxVector4 Translation, Rotation, Scaling;
-	Translation = pNode->GetGeometricTranslation(FbxNode::eSourcePivot);
-	Rotation = pNode->GetGeometricRotation(FbxNode::eSourcePivot);
-	Scaling = pNode->GetGeometricScaling(FbxNode::eSourcePivot);
-	Geometry.SetT(Translation);
-	Geometry.SetR(Rotation);
-	Geometry.SetS(Scaling);
-
-	//For Single Matrix situation, obtain transfrom matrix from eDESTINATION_SET, which include pivot offsets and pre/post rotations.
-	FbxAMatrix& GlobalTransform = Importer->mScene->GetEvaluator()->GetNodeGlobalTransform(pNode);
-
 	FbxAMatrix TotalMatrix;
-	//TotalMatrix = GlobalTransform * Geometry;
-	TotalMatrix = GlobalTransform;
+	TotalMatrix = Source._GlobalTransform;
 
 	FbxAMatrix TotalMatrixForNormal;
 	TotalMatrixForNormal = TotalMatrix.Inverse();
 	TotalMatrixForNormal = TotalMatrixForNormal.Transpose();
 
-	if (!Mesh->IsTriangleMesh())
-	{
-		FbxGeometryConverter lConverter(Mesh->GetNode()->GetFbxManager());
-		bool bSuccess;
-		Mesh = lConverter.TriangulateMeshAdvance(Mesh, bSuccess);
-	}
-	
-	const int PolygonCount = Mesh->GetPolygonCount();
-
-	FbxLayerElementArrayTemplate<int>* MaterialIndice = NULL;
-	FbxGeometryElement::EMappingMode MaterialMappingMode = FbxGeometryElement::eNone;
+	const int PolygonCount = Source.GetPolygonCount();
+	const bool bHasMaterialIndice = Source._MaterialIndices.size() != 0;
 
-
-	FbxGeometryElementMaterial * ElementMaterial = Mesh->GetElementMaterial();
-	if (ElementMaterial)
+	if (bHasMaterialIndice)
 	{
-		MaterialIndice = &ElementMaterial->GetIndexArray();
-		MaterialMappingMode = ElementMaterial->GetMappingMode();
-		if (MaterialIndice && MaterialMappingMode == FbxGeometryElement::eByPolygon)
+		// Count the faces of each material
+		for (int PolygonIndex = 0; PolygonIndex < PolygonCount; ++PolygonIndex)
 		{
-			FBX_ASSERT(MaterialIndice->GetCount() == PolygonCount);
-			if (MaterialIndice->GetCount() == PolygonCount)
+			const int lMaterialIndex = Source._MaterialIndices[PolygonIndex];
+			if ((int)_SubMeshArray.size() < lMaterialIndex + 1)
 			{
-				// Count the faces of each material
-				for (int PolygonIndex = 0; PolygonIndex < PolygonCount; ++PolygonIndex)
-				{
-					const int lMaterialIndex = MaterialIndice->GetAt(PolygonIndex);
-					if ((int)_SubMeshArray.size() < lMaterialIndex + 1)
-					{
-						_SubMeshArray.resize(lMaterialIndex + 1);
-					}
-					if (_SubMeshArray[lMaterialIndex] == NULL)
-					{
-						_SubMeshArray[lMaterialIndex] = new SubMesh;
-					}
-					_SubMeshArray[lMaterialIndex]->_TriangleCount += 1;
-				}
-
-				// Make sure we have no "holes" (NULL) in the mSubMeshes table. This can happen
-				// if, in the loop above, we resized the mSubMeshes by more than one slot.
-				for (int i = 0; i < (int)_SubMeshArray.size(); i++)
-				{
-					if (_SubMeshArray[i] == NULL)
-						_SubMeshArray[i] = new SubMesh;
+				_SubMeshArray.resize(lMaterialIndex + 1);
+			}
+			if (_SubMeshArray[lMaterialIndex] == NULL)
+			{
+				_SubMeshArray[lMaterialIndex] = new SubMesh;
+			}
+			_SubMeshArray[lMaterialIndex]->_TriangleCount += 1;
+		}
 
-				}
+		// Make sure we have no "holes" (NULL) in the mSubMeshes table. This can happen
+		// if, in the loop above, we resized the mSubMeshes by more than one slot.
+		for (int i = 0; i < (int)_SubMeshArray.size(); i++)
+		{
+			if (_SubMeshArray[i] == NULL)
+				_SubMeshArray[i] = new SubMesh;
 
-				// Record the offset (how many vertex)
-				const int lMaterialCount = _SubMeshArray.size();
-				int lOffset = 0;
-				for (int lIndex = 0; lIndex < lMaterialCount; ++lIndex)
-				{
-					_SubMeshArray[lIndex]->_IndexOffset = lOffset;
-					lOffset += _SubMeshArray[lIndex]->_TriangleCount * 3;
-					// This will be used as counter in the following procedures, reset to zero
-					_SubMeshArray[lIndex]->_TriangleCount = 0;
-				}
-				FBX_ASSERT(lOffset == PolygonCount * 3);
-			}
 		}
 
-		
+		// Record the offset (how many vertex)
+		const int lMaterialCount = _SubMeshArray.size();
+		int lOffset = 0;
+		for (int lIndex = 0; lIndex < lMaterialCount; ++lIndex)
+		{
+			_SubMeshArray[lIndex]->_IndexOffset = lOffset;
+			lOffset += _SubMeshArray[lIndex]->_TriangleCount * 3;
+			// This will be used as counter in the following procedures, reset to zero
+			_SubMeshArray[lIndex]->_TriangleCount = 0;
+		}
+		FBX_ASSERT(lOffset == PolygonCount * 3);
 	}
 
 	// All faces will use the same material.
@@ -131,38 +100,20 @@ bool StaticMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 
 	// Congregate all the data of a mesh to be cached in VBOs.
 	// If normal or UV is by polygon vertex, record all vertex attributes by polygon vertex.
-	bool mHasNormal = Mesh->GetElementNormalCount() > 0;
-	bool mHasUV = Mesh->GetElementUVCount() > 0;
+	bool mHasNormal = Source._Normals.IsValid();
+	bool mHasUV = Source._UVs.IsValid();
 	bool mAllByControlPoint = true;
-	FbxGeometryElement::EMappingMode lNormalMappingMode = FbxGeometryElement::eNone;
-	FbxGeometryElement::EMappingMode lUVMappingMode = FbxGeometryElement::eNone;
-	if (mHasNormal)
+	if (mHasNormal && Source._Normals.Mapping != FbxGeometryElement::eByControlPoint)
 	{
-		lNormalMappingMode = Mesh->GetElementNormal(0)->GetMappingMode();
-		if (lNormalMappingMode == FbxGeometryElement::eNone)
-		{
-			mHasNormal = false;
-		}
-		if (mHasNormal && lNormalMappingMode != FbxGeometryElement::eByControlPoint)
-		{
-			mAllByControlPoint = false;
-		}
+		mAllByControlPoint = false;
 	}
-	if (mHasUV)
+	if (mHasUV && Source._UVs.Mapping != FbxGeometryElement::eByControlPoint)
 	{
-		lUVMappingMode = Mesh->GetElementUV(0)->GetMappingMode();
-		if (lUVMappingMode == FbxGeometryElement::eNone)
-		{
-			mHasUV = false;
-		}
-		if (mHasUV && lUVMappingMode != FbxGeometryElement::eByControlPoint)
-		{
-			mAllByControlPoint = false;
-		}
+		mAllByControlPoint = false;
 	}
 
 	// Allocate the array memory, by control point or by polygon vertex.
-	int lPolygonVertexCount = Mesh->GetControlPointsCount();
+	int lPolygonVertexCount = Source._ControlPoints.size();
 	if (!mAllByControlPoint)
 	{
 		lPolygonVertexCount = PolygonCount * TRIANGLE_VERTEX_COUNT;
@@ -170,43 +121,22 @@ bool StaticMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 
 	_PositionArray.resize(lPolygonVertexCount);
 	_IndiceArray.resize(PolygonCount * TRIANGLE_VERTEX_COUNT);
-	//float * lNormals = NULL;
 	if (mHasNormal)
 	{
 		_NormalArray.resize(lPolygonVertexCount);
 	}
-	//float * lUVs = NULL;
-	FbxStringList lUVNames;
-	Mesh->GetUVSetNames(lUVNames);
-	const char * lUVName = NULL;
-	if (mHasUV && lUVNames.GetCount())
+	if (mHasUV)
 	{
 		_TexCoordArray.resize(lPolygonVertexCount);
-		lUVName = lUVNames[0];
 	}
 
 	// Populate the array with vertex attribute, if by control point.
-	const FbxVector4 * lControlPoints = Mesh->GetControlPoints();
-	FbxVector4 lCurrentVertex;
-	FbxVector4 lCurrentNormal;
-	FbxVector2 lCurrentUV;
 	if (mAllByControlPoint)
 	{
-		const FbxGeometryElementNormal * lNormalElement = NULL;
-		const FbxGeometryElementUV * lUVElement = NULL;
-		if (mHasNormal)
-		{
-			lNormalElement = Mesh->GetElementNormal(0);
-		}
-		if (mHasUV)
-		{
-			lUVElement = Mesh->GetElementUV(0);
-		}
 		for (int lIndex = 0; lIndex < lPolygonVertexCount; ++lIndex)
 		{
 			// Save the vertex position.
-			lCurrentVertex = lControlPoints[lIndex];
-			FbxVector4 FinalPosition = TotalMatrix.MultT(lCurrentVertex);
+			FbxVector4 FinalPosition = TotalMatrix.MultT(Source._ControlPoints[lIndex]);
 
 			_PositionArray[lIndex].x = static_cast<float>(FinalPosition[0]);
 			_PositionArray[lIndex].y = static_cast<float>(FinalPosition[1]);
@@ -215,29 +145,18 @@ bool StaticMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 			// Save the normal.
 			if (mHasNormal)
 			{
-				int lNormalIndex = lIndex;
-				if (lNormalElement->GetReferenceMode() == FbxLayerElement::eIndexToDirect)
-				{
-					lNormalIndex = lNormalElement->GetIndexArray().GetAt(lIndex);
-				}
-				lCurrentNormal = lNormalElement->GetDirectArray().GetAt(lNormalIndex);
-				FbxVector4 FinalNormal = TotalMatrixForNormal.MultT(lCurrentNormal);
+				FbxVector4 FinalNormal = TotalMatrixForNormal.MultT(Source._Normals.GetAt(lIndex));
 				FinalNormal.Normalize();
 
 				_NormalArray[lIndex].x = static_cast<float>(FinalNormal[0]);
 				_NormalArray[lIndex].y = static_cast<float>(FinalNormal[1]);
-				_NormalArray[lIndex].z = static_cast<float>(lCurrentNormal[2]);
+				_NormalArray[lIndex].z = static_cast<float>(FinalNormal[2]);
 			}
 
 			// Save the UV.
 			if (mHasUV)
 			{
-				int lUVIndex = lIndex;
-				if (lUVElement->GetReferenceMode() == FbxLayerElement::eIndexToDirect)
-				{
-					lUVIndex = lUVElement->GetIndexArray().GetAt(lIndex);
-				}
-				lCurrentUV = lUVElement->GetDirectArray().GetAt(lUVIndex);
+				const FbxVector2& lCurrentUV = Source._UVs.GetAt(lIndex);
 				_TexCoordArray[lIndex].x = static_cast<float>(lCurrentUV[0]);
 				_TexCoordArray[lIndex].y = static_cast<float>(lCurrentUV[1]);
 			}
@@ -249,16 +168,17 @@ bool StaticMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 	for (int lPolygonIndex = 0; lPolygonIndex < PolygonCount; ++lPolygonIndex)
 	{
 		int lMaterialIndex = 0;
-		if (MaterialIndice && MaterialMappingMode == FbxGeometryElement::eByPolygon)
+		if (bHasMaterialIndice)
 		{
-			lMaterialIndex = MaterialIndice->GetAt(lPolygonIndex);
+			lMaterialIndex = Source._MaterialIndices[lPolygonIndex];
 		}
 
 		const int lIndexOffset = _SubMeshArray[lMaterialIndex]->_IndexOffset +
 			_SubMeshArray[lMaterialIndex]->_TriangleCount * 3;
 		for (int lVerticeIndex = 0; lVerticeIndex < TRIANGLE_VERTEX_COUNT; ++lVerticeIndex)
 		{
-			const int lControlPointIndex = Mesh->GetPolygonVertex(lPolygonIndex, lVerticeIndex);
+			const int lCornerIndex = lPolygonIndex * TRIANGLE_VERTEX_COUNT + lVerticeIndex;
+			const int lControlPointIndex = Source._PolygonVertices[lCornerIndex];
 
 			if (mAllByControlPoint)
 			{
@@ -268,20 +188,15 @@ bool StaticMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 			{
 				_IndiceArray[lIndexOffset + lVerticeIndex] = static_cast<DWORD>(lVertexCount);
 
-
-				lCurrentVertex = lControlPoints[lControlPointIndex];
-				FbxVector4 FinalPosition = TotalMatrix.MultT(lCurrentVertex);
+				FbxVector4 FinalPosition = TotalMatrix.MultT(Source._ControlPoints[lControlPointIndex]);
 
 				_PositionArray[lVertexCount].x =  static_cast<float>(FinalPosition[0]);
 				_PositionArray[lVertexCount].y =  static_cast<float>(FinalPosition[1]);
 				_PositionArray[lVertexCount].z =  static_cast<float>(FinalPosition[2]);
 
-
-
 				if (mHasNormal)
 				{
-					Mesh->GetPolygonVertexNormal(lPolygonIndex, lVerticeIndex, lCurrentNormal);
-					FbxVector4 FinalNormal = TotalMatrixForNormal.MultT(lCurrentNormal);
+					FbxVector4 FinalNormal = TotalMatrixForNormal.MultT(Source._Normals.GetCorner(lControlPointIndex, lPolygonIndex, lCornerIndex));
 					FinalNormal.Normalize();
 					_NormalArray[lVertexCount].x = static_cast<float>(FinalNormal[0]);
 					_NormalArray[lVertexCount].y = static_cast<float>(FinalNormal[1]);
@@ -291,7 +206,7 @@ bool StaticMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 
 				if (mHasUV)
 				{
-					Mesh->GetPolygonVertexUV(lPolygonIndex, lVerticeIndex, lUVName, lCurrentUV);
+					const FbxVector2& lCurrentUV = Source._UVs.GetCorner(lControlPointIndex, lPolygonIndex, lCornerIndex);
 
 					_TexCoordArray[lVertexCount].x = static_cast<float>(lCurrentUV[0]);
 					_TexCoordArray[lVertexCount].y = static_cast<float>(lCurrentUV[1]);
@@ -302,90 +217,565 @@ bool StaticMesh::ImportFromFbxMesh( FbxMesh* Mesh, FbxFileImporter* Importer )
 		_SubMeshArray[lMaterialIndex]->_TriangleCount += 1;
 	}
 
-	
+	_NumTriangle = PolygonCount;
+	_NumVertex = lPolygonVertexCount;
 
+	if(_NormalArray.size() != 0 && _TexCoordArray.size() == 0)
 
-	HRESULT hr;
-	D3D11_BUFFER_DESC bd;
-	ZeroMemory( &bd, sizeof(bd) );
-	bd.Usage = D3D11_USAGE_DEFAULT;
-	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	bd.CPUAccessFlags = 0;
-	D3D11_SUBRESOURCE_DATA InitData;
-	ZeroMemory( &InitData, sizeof(InitData) );
-	if(mHasNormal == true && mHasUV == false)
 	{
-		bd.ByteWidth = sizeof( NormalVertex ) * lPolygonVertexCount;
-		NormalVertex* Vertices = new NormalVertex[lPolygonVertexCount];
-		for(int i = 0;i<lPolygonVertexCount;i++)
+		_VertexStride = sizeof(NormalVertex);
+		_NumTexCoord = 0;
+	}
+	else if(_NormalArray.size() != 0 && _TexCoordArray.size() != 0)
+	{
+		_VertexStride = sizeof(NormalTexVertex);
+		_NumTexCoord = 1;
+	}
+
+	// bounds first, compressed positions are stored relative to them
+	CalcBounds();
+	SelectVertexFormat();
+
+	if (!mAllByControlPoint)
+	{
+		WeldVertices();
+	}
+	OptimizeIndices();
+	BuildLODs();
+	BuildClusters();
+	CalcSubMeshBounds();
+	BuildOccluder();
+
+	_IndexStride = _NumVertex <= 0x10000 ? sizeof(unsigned short) : sizeof(DWORD);
+
+	return true;
+}
+
+void StaticMesh::SelectVertexFormat()
+{
+	if(!_CompressedVertex || _VertexStride == 0)
+	{
+		_CompressedVertex = false;
+		return;
+	}
+
+	VertexCompressionError Error;
+	if(!ValidateVertexCompression(_PositionArray, _NormalArray, _TexCoordArray, _AABBMin, _AABBMax, Error))
+	{
+		cout_debug("StaticMesh : compression error too large (position %f, normal %f, texcoord %f), keeping float vertices\n",
+			Error.Position, Error.Normal, Error.TexCoord);
+		_CompressedVertex = false;
+		return;
+	}
+
+	_VertexStride = _NumTexCoord == 0 ? sizeof(CompressedNormalVertex) : sizeof(CompressedNormalTexVertex);
+}
+
+void StaticMesh::GetPositionScaleBias( XMFLOAT4& OutScale, XMFLOAT4& OutBias ) const
+{
+	if(_CompressedVertex)
+	{
+		::GetPositionScaleBias(_AABBMin, _AABBMax, OutScale, OutBias);
+	}
+	else
+	{
+		OutScale = XMFLOAT4(1.f, 1.f, 1.f, 1.f);
+		OutBias = XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+	}
+}
+
+void StaticMesh::WeldVertices()
+{
+	// weld on the final vertex layout, so only vertices that render identically are merged
+	std::vector<unsigned char> VertexData;
+	BuildVertexData(VertexData);
+	if(VertexData.size() == 0)
+		return;
+
+	std::vector<unsigned int> Remap;
+	const int UniqueCount = MeshOptimizer::WeldVertices(&VertexData[0], _VertexStride, _NumVertex, Remap);
+
+	MeshOptimizer::RemapVertexArray(_PositionArray, Remap, UniqueCount);
+	MeshOptimizer::RemapVertexArray(_NormalArray, Remap, UniqueCount);
+	MeshOptimizer::RemapVertexArray(_TexCoordArray, Remap, UniqueCount);
+	MeshOptimizer::RemapIndexArray(_IndiceArray, Remap);
+	_NumVertex = UniqueCount;
+}
+
+void StaticMesh::OptimizeIndices()
+{
+	if(_IndiceArray.size() == 0 || _NumVertex == 0)
+		return;
+
+	unsigned int* Indices = (unsigned int*)&_IndiceArray[0];
+	const int IndexCount = _IndiceArray.size();
+
+	float ACMRBefore, ATVRBefore;
+	MeshOptimizer::AnalyzeVertexCache(Indices, IndexCount, _NumVertex, ANALYZE_CACHE_SIZE, ACMRBefore, ATVRBefore);
+
+	// triangles never move across submeshes, each one is a separate draw
+	for(unsigned int i=0;i<_SubMeshArray.size();i++)
+	{
+		unsigned int* SubMeshIndices = Indices + _SubMeshArray[i]->_IndexOffset;
+		const int SubMeshIndexCount = _SubMeshArray[i]->_TriangleCount * TRIANGLE_VERTEX_COUNT;
+		MeshOptimizer::OptimizeVertexCache(SubMeshIndices, SubMeshIndexCount, _NumVertex);
+		MeshOptimizer::OptimizeOverdraw(SubMeshIndices, SubMeshIndexCount, &_PositionArray[0].x, sizeof(XMFLOAT3), _NumVertex);
+	}
+
+	std::vector<unsigned int> Remap;
+	MeshOptimizer::OptimizeVertexFetch(Indices, IndexCount, _NumVertex, Remap);
+	MeshOptimizer::RemapVertexArray(_PositionArray, Remap, _NumVertex);
+	MeshOptimizer::RemapVertexArray(_NormalArray, Remap, _NumVertex);
+	MeshOptimizer::RemapVertexArray(_TexCoordArray, Remap, _NumVertex);
+
+	float ACMRAfter, ATVRAfter;
+	MeshOptimizer::AnalyzeVertexCache(Indices, IndexCount, _NumVertex, ANALYZE_CACHE_SIZE, ACMRAfter, ATVRAfter);
+	if(_bLogImportStats)
+		cout_debug("StaticMesh : %d triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", _NumTriangle, ACMRBefore, ACMRAfter, ATVRBefore, ATVRAfter);
+}
+
+void StaticMesh::BuildLODs()
+{
+	_LODArray.clear();
+	if(_IndiceArray.size() == 0 || _NumVertex == 0)
+		return;
+
+	MeshLOD BaseLOD;
+	BaseLOD.IndexOffset = 0;
+	BaseLOD.TriangleCount = _NumTriangle;
+	BaseLOD.VertexCount = _NumVertex;
+	BaseLOD.ScreenSize = FLOAT_MAX;
+	BaseLOD.Error = 0.f;
+	_LODArray.push_back(BaseLOD);
+
+	// normals and uvs add to the cost where a collapse merges two different ones
+	const int AttributeCount = (_NormalArray.size() ? 3 : 0) + (_TexCoordArray.size() ? 2 : 0);
+	std::vector<float> Attributes(AttributeCount * _NumVertex);
+	for(int i=0;i<_NumVertex && AttributeCount > 0;i++)
+	{
+		float* Attribute = &Attributes[i * AttributeCount];
+		if(_NormalArray.size())
 		{
-			Vertices[i].Position = _PositionArray[i];
-			Vertices[i].Normal = _NormalArray[i];
+			*Attribute++ = _NormalArray[i].x;
+			*Attribute++ = _NormalArray[i].y;
+			*Attribute++ = _NormalArray[i].z;
 		}
-		InitData.pSysMem = Vertices;
-		hr = GEngine->_Device->CreateBuffer( &bd, &InitData, &_VertexBuffer );
-		if( FAILED( hr ) )
+		if(_TexCoordArray.size())
 		{
-			assert(false);
-			return false;
+			*Attribute++ = _TexCoordArray[i].x;
+			*Attribute++ = _TexCoordArray[i].y;
 		}
+	}
 
-		SetD3DResourceDebugName("StaticMesh_VertexBuffer", _VertexBuffer);
+	const XMFLOAT3 Size(_AABBMax.x - _AABBMin.x, _AABBMax.y - _AABBMin.y, _AABBMax.z - _AABBMin.z);
+	const float Extent = Math::Max<float>(Size.x, Math::Max<float>(Size.y, Size.z));
+	const float Radius = 0.5f * sqrtf(Size.x*Size.x + Size.y*Size.y + Size.z*Size.z);
 
-		delete[] Vertices;
+	// every lod simplifies the previous one submesh by submesh, so materials never mix
+	std::vector<int> SourceOffset(_SubMeshArray.size()), SourceCount(_SubMeshArray.size());
+	for(unsigned int i=0;i<_SubMeshArray.size();i++)
+	{
+		SourceOffset[i] = _SubMeshArray[i]->_IndexOffset;
+		SourceCount[i] = _SubMeshArray[i]->_TriangleCount * TRIANGLE_VERTEX_COUNT;
 	}
-	else if(mHasNormal == true && mHasUV == true)
+
+	std::vector<unsigned int> Simplified;
+	for(int LODIndex=1;LODIndex<_MaxLODCount;LODIndex++)
 	{
-		bd.ByteWidth = sizeof( NormalTexVertex ) * lPolygonVertexCount;
-		NormalTexVertex* Vertices = new NormalTexVertex[lPolygonVertexCount];
-		for(int i = 0;i<lPolygonVertexCount;i++)
+		const MeshLOD& PrevLOD = _LODArray.back();
+		MeshLOD LOD;
+		LOD.IndexOffset = _IndiceArray.size();
+		LOD.VertexCount = _NumVertex;
+		float Error = 0.f;
+
+		for(unsigned int i=0;i<_SubMeshArray.size();i++)
+		{
+			const int Offset = _IndiceArray.size();
+			if(SourceCount[i] > 0)
+			{
+				const int TargetCount = (int)(SourceCount[i] / TRIANGLE_VERTEX_COUNT * LOD_TRIANGLE_RATIO) * TRIANGLE_VERTEX_COUNT;
+				float SubMeshError;
+				Simplified.resize(SourceCount[i]);
+				const int Count = MeshSimplifier::Simplify(&Simplified[0], (const unsigned int*)&_IndiceArray[SourceOffset[i]], SourceCount[i],
+					&_PositionArray[0], _NumVertex, AttributeCount ? &Attributes[0] : NULL, AttributeCount, LOD_ATTRIBUTE_WEIGHT,
+					NULL, TargetCount, LOD_MAX_ERROR, SubMeshError);
+				MeshOptimizer::OptimizeVertexCache(&Simplified[0], Count, _NumVertex);
+				_IndiceArray.insert(_IndiceArray.end(), Simplified.begin(), Simplified.begin() + Count);
+				Error = Math::Max<float>(Error, SubMeshError);
+			}
+			SourceOffset[i] = Offset;
+			SourceCount[i] = _IndiceArray.size() - Offset;
+		}
+
+		LOD.TriangleCount = (_IndiceArray.size() - LOD.IndexOffset) / TRIANGLE_VERTEX_COUNT;
+		if(LOD.TriangleCount == 0 || LOD.TriangleCount > PrevLOD.TriangleCount * LOD_MIN_REDUCTION)
+		{
+			_IndiceArray.resize(LOD.IndexOffset);
+			break;
+		}
+
+		// each lod starts from the previous one, so the errors add up along the chain
+		LOD.Error = PrevLOD.Error + Error * Extent;
+		LOD.ScreenSize = Math::Min<float>(MeshSimplifier::ComputeLODScreenSize(LOD.Error, Radius), PrevLOD.ScreenSize);
+		_LODArray.push_back(LOD);
+	}
+
+	if(_LODArray.size() > 1)
+	{
+		std::vector<const unsigned int*> LODIndices;
+		std::vector<int> LODIndexCount;
+		for(unsigned int i=0;i<_LODArray.size();i++)
+		{
+			LODIndices.push_back((const unsigned int*)&_IndiceArray[_LODArray[i].IndexOffset]);
+			LODIndexCount.push_back(_LODArray[i].TriangleCount * TRIANGLE_VERTEX_COUNT);
+		}
+
+		std::vector<unsigned int> Remap, VertexCount;
+		MeshSimplifier::SortVerticesByLOD(LODIndices, LODIndexCount, _NumVertex, Remap, VertexCount);
+		MeshOptimizer::RemapVertexArray(_PositionArray, Remap, _NumVertex);
+		MeshOptimizer::RemapVertexArray(_NormalArray, Remap, _NumVertex);
+		MeshOptimizer::RemapVertexArray(_TexCoordArray, Remap, _NumVertex);
+		MeshOptimizer::RemapIndexArray(_IndiceArray, Remap);
+		for(unsigned int i=0;i<_LODArray.size();i++)
+			_LODArray[i].VertexCount = VertexCount[i];
+	}
+
+	for(unsigned int i=0;i<_LODArray.size() && _bLogImportStats;i++)
+	{
+		cout_debug("StaticMesh : lod %d, %d triangles, %d vertices, error %f, screen size %f\n",
+			i, _LODArray[i].TriangleCount, _LODArray[i].VertexCount, _LODArray[i].Error, _LODArray[i].ScreenSize);
+	}
+}
+
+int StaticMesh::SelectLOD( const XMMATRIX& ViewMat, const XMMATRIX& ProjectionMat ) const
+{
+	if(_LODArray.size() <= 1)
+		return 0;
+
+	const XMFLOAT3 Center((_AABBMin.x + _AABBMax.x) * 0.5f, (_AABBMin.y + _AABBMax.y) * 0.5f, (_AABBMin.z + _AABBMax.z) * 0.5f);
+	const XMFLOAT3 Size(_AABBMax.x - _AABBMin.x, _AABBMax.y - _AABBMin.y, _AABBMax.z - _AABBMin.z);
+	const float Radius = 0.5f * sqrtf(Size.x*Size.x + Size.y*Size.y + Size.z*Size.z);
+	return MeshSimplifier::SelectLOD(_LODArray, MeshSimplifier::ComputeScreenSize(Center, Radius, ViewMat, ProjectionMat));
+}
+
+void StaticMesh::BuildClusters()
+{
+	_ClusterArray.clear();
+	if(_IndiceArray.size() == 0 || _NumVertex == 0)
+		return;
+
+	const unsigned int* Indices = (const unsigned int*)&_IndiceArray[0];
+	for(unsigned int i=0;i<_SubMeshArray.size();i++)
+	{
+		SubMesh* Sub = _SubMeshArray[i];
+		Sub->_ClusterOffset = _ClusterArray.size();
+		MeshletBuilder::BuildClusters(Indices, Sub->_IndexOffset, Sub->_TriangleCount, &_PositionArray[0], _NumVertex, _ClusterArray);
+		Sub->_ClusterCount = _ClusterArray.size() - Sub->_ClusterOffset;
+	}
+}
+
+void StaticMesh::BuildOccluder()
+{
+	_OccluderPositionArray.clear();
+	_OccluderIndexArray.clear();
+	if(_NumTriangle == 0 || _NumVertex == 0)
+		return;
+
+	OcclusionCuller::BuildOccluder((const unsigned int*)&_IndiceArray[0], _NumTriangle * TRIANGLE_VERTEX_COUNT, &_PositionArray[0], _NumVertex,
+		_OccluderPositionArray, _OccluderIndexArray);
+	if(_bLogImportStats)
+		cout_debug("StaticMesh : occluder of %d triangles, %d vertices\n", (int)_OccluderIndexArray.size() / TRIANGLE_VERTEX_COUNT, (int)_OccluderPositionArray.size());
+}
+
+void StaticMesh::CalcBounds()
+{
+	_AABBMin = XMFLOAT3(FLOAT_MAX, FLOAT_MAX, FLOAT_MAX);
+	_AABBMax = XMFLOAT3(-FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX);
+	for(unsigned int i=0;i<_PositionArray.size();i++)
+	{
+		XMFLOAT3& Pos = _PositionArray[i];
+		_AABBMax.x = Math::Max<float>(_AABBMax.x, Pos.x);
+		_AABBMax.y = Math::Max<float>(_AABBMax.y, Pos.y);
+		_AABBMax.z = Math::Max<float>(_AABBMax.z, Pos.z);
+
+		_AABBMin.x = Math::Min<float>(_AABBMin.x, Pos.x);
+		_AABBMin.y = Math::Min<float>(_AABBMin.y, Pos.y);
+		_AABBMin.z = Math::Min<float>(_AABBMin.z, Pos.z);
+	}
+}
+
+void StaticMesh::CalcSubMeshBounds()
+{
+	for(unsigned int s=0;s<_SubMeshArray.size();s++)
+	{
+		SubMesh* Sub = _SubMeshArray[s];
+		XMVECTOR Min = XMVectorReplicate(FLOAT_MAX);
+		XMVECTOR Max = XMVectorReplicate(-FLOAT_MAX);
+		const int IndexEnd = Sub->_IndexOffset + Sub->_TriangleCount * 3;
+		for(int i=Sub->_IndexOffset;i<IndexEnd;i++)
+		{
+			const XMVECTOR Pos = XMLoadFloat3(&_PositionArray[_IndiceArray[i]]);
+			Min = XMVectorMin(Min, Pos);
+			Max = XMVectorMax(Max, Pos);
+		}
+		// empty submeshes draw nothing, a point at the mesh center
+		if(Sub->_TriangleCount == 0)
+			Min = Max = XMVectorScale(XMVectorAdd(XMLoadFloat3(&_AABBMin), XMLoadFloat3(&_AABBMax)), 0.5f);
+		XMStoreFloat3(&Sub->_AABBMin, Min);
+		XMStoreFloat3(&Sub->_AABBMax, Max);
+	}
+}
+
+void StaticMesh::BuildVertexData( std::vector<unsigned char>& OutVertexData )
+{
+	OutVertexData.resize(_VertexStride * _NumVertex);
+	if(OutVertexData.size() == 0)
+		return;
+
+	if(_CompressedVertex)
+	{
+		XMFLOAT4 Scale, Bias;
+		GetPositionScaleBias(Scale, Bias);
+		if(_NumTexCoord == 0)
+		{
+			CompressedNormalVertex* Vertices = (CompressedNormalVertex*)&OutVertexData[0];
+			for(int i = 0;i<_NumVertex;i++)
+			{
+				Vertices[i].Position = EncodePosition(_PositionArray[i], Scale, Bias);
+				Vertices[i].Normal = EncodeNormal(_NormalArray[i]);
+			}
+		}
+		else
+		{
+			CompressedNormalTexVertex* Vertices = (CompressedNormalTexVertex*)&OutVertexData[0];
+			for(int i = 0;i<_NumVertex;i++)
+			{
+				Vertices[i].Position = EncodePosition(_PositionArray[i], Scale, Bias);
+				Vertices[i].Normal = EncodeNormal(_NormalArray[i]);
+				Vertices[i].TexCoord = EncodeTexCoord(_TexCoordArray[i]);
+			}
+		}
+	}
+	else if(_VertexStride == sizeof(NormalVertex))
+	{
+		NormalVertex* Vertices = (NormalVertex*)&OutVertexData[0];
+		for(int i = 0;i<_NumVertex;i++)
 		{
 			Vertices[i].Position = _PositionArray[i];
 			Vertices[i].Normal = _NormalArray[i];
-			Vertices[i].TexCoord = _TexCoordArray[i];
 		}
-		InitData.pSysMem = Vertices;
-		hr = GEngine->_Device->CreateBuffer( &bd, &InitData, &_VertexBuffer );
-		if( FAILED( hr ) )
+	}
+	else if(_VertexStride == sizeof(NormalTexVertex))
+	{
+		NormalTexVertex* Vertices = (NormalTexVertex*)&OutVertexData[0];
+		for(int i = 0;i<_NumVertex;i++)
 		{
-			assert(false);
-			return false;
+			Vertices[i].Position = _PositionArray[i];
+			Vertices[i].Normal = _NormalArray[i];
+			Vertices[i].TexCoord = _TexCoordArray[i];
 		}
+	}
+}
 
-		SetD3DResourceDebugName("StaticMesh_VertexBuffer", _VertexBuffer);
+void StaticMesh::BuildIndexData( std::vector<unsigned char>& OutIndexData )
+{
+	OutIndexData.resize(_IndexStride * _IndiceArray.size());
+	if(OutIndexData.size() == 0)
+		return;
 
-		delete[] Vertices;
+	if(_IndexStride == sizeof(unsigned short))
+	{
+		unsigned short* Indices = (unsigned short*)&OutIndexData[0];
+		for(unsigned int i=0;i<_IndiceArray.size();i++)
+			Indices[i] = (unsigned short)_IndiceArray[i];
+	}
+	else
+	{
+		memcpy(&OutIndexData[0], &_IndiceArray[0], OutIndexData.size());
 	}
-	
+}
 
-	bd.Usage = D3D11_USAGE_DEFAULT;
-	bd.ByteWidth = sizeof( DWORD ) * PolygonCount * TRIANGLE_VERTEX_COUNT;        // 36 vertices needed for 12 triangles in a triangle list
-	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+bool StaticMesh::CreateBuffers( const void* VertexData, const void* IndexData, unsigned int IndexCount )
+{
+	if(_VertexBuffer) _VertexBuffer->Release();
+	if(_IndexBuffer) _IndexBuffer->Release();
+	_VertexBuffer = NULL;
+	_IndexBuffer = NULL;
+
+	if(VertexData == NULL || IndexData == NULL)
+		return false;
+
+	HRESULT hr;
+	D3D11_BUFFER_DESC bd;
+	ZeroMemory( &bd, sizeof(bd) );
+	bd.Usage = D3D11_USAGE_IMMUTABLE;
+	bd.ByteWidth = _VertexStride * _NumVertex;
+	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	bd.CPUAccessFlags = 0;
-	InitData.pSysMem = &_IndiceArray[0];
+	D3D11_SUBRESOURCE_DATA InitData;
+	ZeroMemory( &InitData, sizeof(InitData) );
+	InitData.pSysMem = VertexData;
+	hr = GEngine->_Device->CreateBuffer( &bd, &InitData, &_VertexBuffer );
+	if( FAILED( hr ) )
+	{
+		assert(false);
+		return false;
+	}
+
+	SetD3DResourceDebugName("StaticMesh_VertexBuffer", _VertexBuffer);
+
+	bd.ByteWidth = _IndexStride * IndexCount;
+	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	InitData.pSysMem = IndexData;
 	hr = GEngine->_Device->CreateBuffer( &bd, &InitData, &_IndexBuffer );
 	if( FAILED( hr ) )
 	{
 		assert(false);
 		return false;
 	}
-	
+
 	SetD3DResourceDebugName("StaticMesh_IndexBuffer", _IndexBuffer);
 
-	_NumTriangle = PolygonCount;
-	_NumVertex = lPolygonVertexCount;
+	return true;
+}
 
-	if(_NormalArray.size() != 0 && _TexCoordArray.size() == 0)
+bool StaticMesh::CreateRenderBuffers()
+{
+	if(_NumVertex == 0 || _IndiceArray.size() == 0)
+		return false;
+
+	std::vector<unsigned char> VertexData;
+	BuildVertexData(VertexData);
+	std::vector<unsigned char> IndexData;
+	BuildIndexData(IndexData);
+	return CreateBuffers(&VertexData[0], &IndexData[0], _IndiceArray.size());
+}
 
+bool StaticMesh::ImportFromCookedMesh( const CookedMeshView& View )
+{
+	const CookedMeshEntry& Entry = *View.Entry;
+	if(Entry.MeshType != CookedMeshStatic || Entry.VertexCount == 0 || Entry.IndexCount == 0)
+		return false;
+	if(Entry.ClusterCount > 0 && Entry.ClusterStride != sizeof(MeshCluster))
+		return false;
+	// AddOccluder reads the occluder positions through these without a check
+	if(View.OccluderIndices && Entry.OccluderIndexCount % TRIANGLE_VERTEX_COUNT != 0)
+		return false;
+	for(unsigned int i=0;View.OccluderIndices && i<Entry.OccluderIndexCount;i++)
 	{
-		_VertexStride = sizeof(NormalVertex);
-		_NumTexCoord = 0;
+		if(View.OccluderIndices[i] >= Entry.OccluderVertexCount)
+			return false;
 	}
-	else if(_NormalArray.size() != 0 && _TexCoordArray.size() != 0)
+
+	_VertexStride = Entry.VertexStride;
+	_NumVertex = Entry.VertexCount;
+	_NumTriangle = Entry.LODCount > 0 ? View.LODs[0].TriangleCount : Entry.IndexCount / TRIANGLE_VERTEX_COUNT;
+	_NumTexCoord = Entry.NumTexCoord;
+	_CompressedVertex = (Entry.VertexFlags & COOKED_VERTEX_COMPRESSED) != 0;
+	_IndexStride = Entry.IndexStride;
+	_AABBMin = XMFLOAT3(Entry.BoundsMin[0], Entry.BoundsMin[1], Entry.BoundsMin[2]);
+	_AABBMax = XMFLOAT3(Entry.BoundsMax[0], Entry.BoundsMax[1], Entry.BoundsMax[2]);
+
+	for(unsigned int i=0;i<Entry.SubMeshCount;i++)
 	{
-		_VertexStride = sizeof(NormalTexVertex);
-		_NumTexCoord = 1;
+		SubMesh* NewSubMesh = new SubMesh;
+		NewSubMesh->_IndexOffset = View.SubMeshes[i].IndexOffset;
+		NewSubMesh->_TriangleCount = View.SubMeshes[i].TriangleCount;
+		NewSubMesh->_ClusterOffset = View.SubMeshes[i].ClusterOffset;
+		NewSubMesh->_ClusterCount = View.SubMeshes[i].ClusterCount;
+		NewSubMesh->_AABBMin = XMFLOAT3(View.SubMeshes[i].BoundsMin[0], View.SubMeshes[i].BoundsMin[1], View.SubMeshes[i].BoundsMin[2]);
+		NewSubMesh->_AABBMax = XMFLOAT3(View.SubMeshes[i].BoundsMax[0], View.SubMeshes[i].BoundsMax[1], View.SubMeshes[i].BoundsMax[2]);
+		_SubMeshArray.push_back(NewSubMesh);
 	}
 
-	return true;
+	if(View.OccluderVertices && View.OccluderIndices)
+	{
+		const XMFLOAT3* OccluderVertices = (const XMFLOAT3*)View.OccluderVertices;
+		_OccluderPositionArray.assign(OccluderVertices, OccluderVertices + Entry.OccluderVertexCount);
+		_OccluderIndexArray.assign(View.OccluderIndices, View.OccluderIndices + Entry.OccluderIndexCount);
+	}
+
+	if(View.Clusters)
+	{
+		const MeshCluster* Clusters = (const MeshCluster*)View.Clusters;
+		_ClusterArray.assign(Clusters, Clusters + Entry.ClusterCount);
+	}
+
+	for(unsigned int i=0;i<Entry.LODCount;i++)
+	{
+		MeshLOD LOD;
+		LOD.IndexOffset = View.LODs[i].IndexOffset;
+		LOD.TriangleCount = View.LODs[i].TriangleCount;
+		LOD.VertexCount = View.LODs[i].VertexCount;
+		LOD.ScreenSize = View.LODs[i].ScreenSize;
+		LOD.Error = View.LODs[i].Error;
+		_LODArray.push_back(LOD);
+	}
+	if(_LODArray.size() == 0)
+	{
+		MeshLOD LOD;
+		LOD.IndexOffset = 0;
+		LOD.TriangleCount = _NumTriangle;
+		LOD.VertexCount = _NumVertex;
+		LOD.ScreenSize = FLOAT_MAX;
+		LOD.Error = 0.f;
+		_LODArray.push_back(LOD);
+	}
+
+	// vertex and index data go straight from the mapped file to the device
+	return CreateBuffers(View.VertexData, View.IndexData, Entry.IndexCount);
+}
+
+void StaticMesh::AddToCookedMesh( CookedMeshWriter& Writer )
+{
+	std::vector<unsigned char> VertexData;
+	BuildVertexData(VertexData);
+	std::vector<unsigned char> IndexData;
+	BuildIndexData(IndexData);
+
+	std::vector<CookedSubMesh> SubMeshes(_SubMeshArray.size());
+	for(unsigned int i=0;i<_SubMeshArray.size();i++)
+	{
+		SubMeshes[i].IndexOffset = _SubMeshArray[i]->_IndexOffset;
+		SubMeshes[i].TriangleCount = _SubMeshArray[i]->_TriangleCount;
+		SubMeshes[i].ClusterOffset = _SubMeshArray[i]->_ClusterOffset;
+		SubMeshes[i].ClusterCount = _SubMeshArray[i]->_ClusterCount;
+		SubMeshes[i].BoundsMin[0] = _SubMeshArray[i]->_AABBMin.x; SubMeshes[i].BoundsMin[1] = _SubMeshArray[i]->_AABBMin.y; SubMeshes[i].BoundsMin[2] = _SubMeshArray[i]->_AABBMin.z;
+		SubMeshes[i].BoundsMax[0] = _SubMeshArray[i]->_AABBMax.x; SubMeshes[i].BoundsMax[1] = _SubMeshArray[i]->_AABBMax.y; SubMeshes[i].BoundsMax[2] = _SubMeshArray[i]->_AABBMax.z;
+	}
+
+	std::vector<CookedMeshLOD> LODs(_LODArray.size());
+	for(unsigned int i=0;i<_LODArray.size();i++)
+	{
+		LODs[i].IndexOffset = _LODArray[i].IndexOffset;
+		LODs[i].TriangleCount = _LODArray[i].TriangleCount;
+		LODs[i].VertexCount = _LODArray[i].VertexCount;
+		LODs[i].ScreenSize = _LODArray[i].ScreenSize;
+		LODs[i].Error = _LODArray[i].Error;
+	}
+
+	CookedMeshDesc Desc;
+	Desc.MeshType = CookedMeshStatic;
+	Desc.VertexStride = _VertexStride;
+	Desc.VertexCount = _NumVertex;
+	Desc.VertexData = VertexData.size() ? &VertexData[0] : NULL;
+	Desc.IndexCount = _IndiceArray.size();
+	Desc.IndexStride = _IndexStride;
+	Desc.IndexData = IndexData.size() ? &IndexData[0] : NULL;
+	Desc.VertexFlags = _CompressedVertex ? COOKED_VERTEX_COMPRESSED : 0;
+	Desc.NumTexCoord = _NumTexCoord;
+	Desc.SubMeshCount = SubMeshes.size();
+	Desc.SubMeshes = SubMeshes.size() ? &SubMeshes[0] : NULL;
+	Desc.ClusterStride = sizeof(MeshCluster);
+	Desc.ClusterCount = _ClusterArray.size();
+	Desc.Clusters = _ClusterArray.size() ? &_ClusterArray[0] : NULL;
+	Desc.LODCount = LODs.size();
+	Desc.LODs = LODs.size() ? &LODs[0] : NULL;
+	Desc.OccluderVertexCount = _OccluderPositionArray.size();
+	Desc.OccluderVertices = _OccluderPositionArray.size() ? &_OccluderPositionArray[0].x : NULL;
+	Desc.OccluderIndexCount = _OccluderIndexArray.size();
+	Desc.OccluderIndices = _OccluderIndexArray.size() ? (const uint32_t*)&_OccluderIndexArray[0] : NULL;
+	Desc.BoundsMin[0] = _AABBMin.x; Desc.BoundsMin[1] = _AABBMin.y; Desc.BoundsMin[2] = _AABBMin.z;
+	Desc.BoundsMax[0] = _AABBMax.x; Desc.BoundsMax[1] = _AABBMax.y; Desc.BoundsMax[2] = _AABBMax.z;
+	Writer.AddMesh(Desc);
 }
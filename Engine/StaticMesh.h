@@ -9,18 +9,25 @@
 #include "ShaderRes.h"
 #include "baseobject.h"
 #include "FbxFileImporter.h"
+#include "CookedMesh.h"
+#include "MeshSource.h"
+#include "VertexCompression.h"
+#include "CpuSkinning.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "OcclusionCuller.h"
 
-struct NormalVertex
+struct CompressedNormalVertex
 {
-	XMFLOAT3 Position;
-	XMFLOAT3 Normal;
+	CompressedPosition Position;
+	CompressedNormal Normal;
 };
 
-struct NormalTexVertex
+struct CompressedNormalTexVertex
 {
-	XMFLOAT3 Position;
-	XMFLOAT3 Normal;
-	XMFLOAT2 TexCoord;
+	CompressedPosition Position;
+	CompressedNormal Normal;
+	CompressedTexCoord TexCoord;
 };
 
 class StaticMesh :
@@ -39,24 +46,75 @@ public:
 	ID3D11Buffer*           _VertexBuffer;
 	ID3D11Buffer*           _IndexBuffer;
 	unsigned int _VertexStride;
+	bool _CompressedVertex;		// request before import, cleared when the mesh exceeds the error bounds
+	unsigned int _IndexStride;		// 2 when every index fits in 16 bits
+	int _MaxLODCount;				// request before import, 1 keeps only the source mesh
+	static bool _bLogImportStats;	// vertex cache and lod figures of every import, off by default
+
+	XMFLOAT3 _AABBMin;
+	XMFLOAT3 _AABBMax;
 
 	class SubMesh
 	{
 	public:
 		int _TriangleCount;
 		int _IndexOffset;
+		int _ClusterOffset;
+		int _ClusterCount;
+		XMFLOAT3 _AABBMin;	// lod 0 triangles of the submesh
+		XMFLOAT3 _AABBMax;
 		SubMesh()
 		{
 			_TriangleCount = 0;
 			_IndexOffset = 0;
+			_ClusterOffset = 0;
+			_ClusterCount = 0;
+			_AABBMin = XMFLOAT3(0.f, 0.f, 0.f);
+			_AABBMax = XMFLOAT3(0.f, 0.f, 0.f);
 		}
 	};
 
 	std::vector<SubMesh*> _SubMeshArray;
+
+	// lod 0 is the source mesh and covers [0, _NumTriangle*3) of the index buffer, coarser lods follow it
+	std::vector<MeshLOD> _LODArray;
+
+	// index ranges of every submesh split into clusters, in submesh order
+	std::vector<MeshCluster> _ClusterArray;
+
+	// simplified lod 0 for the software occlusion culler, its own welded vertices
+	std::vector<XMFLOAT3> _OccluderPositionArray;
+	std::vector<unsigned int> _OccluderIndexArray;
 public:
 
-	bool ImportFromFbxMesh(FbxMesh* Mesh, FbxFileImporter* Importer);
+	bool ImportFromMeshSource(const MeshSource& Source);
+	bool ImportFromCookedMesh(const CookedMeshView& View);
+	void AddToCookedMesh(CookedMeshWriter& Writer);
+
+	// creates device buffers from the imported cpu arrays
+	bool CreateRenderBuffers();
 
+	DXGI_FORMAT GetIndexFormat() const {return _IndexStride == sizeof(unsigned short) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;}
+	// position decode for the vertex shader, identity for float vertices
+	void GetPositionScaleBias(XMFLOAT4& OutScale, XMFLOAT4& OutBias) const;
+	// lod for the projected size of the bounds
+	int SelectLOD(const XMMATRIX& ViewMat, const XMMATRIX& ProjectionMat) const;
+private:
+	void CalcBounds();
+	void CalcSubMeshBounds();
+	void SelectVertexFormat();
+	// merges identical per-corner vertices and rewrites the index buffer
+	void WeldVertices();
+	// per submesh vertex cache and overdraw ordering, then vertex fetch order
+	void OptimizeIndices();
+	// simplified index ranges appended after lod 0, vertices sorted so every lod reads a prefix
+	void BuildLODs();
+	void BuildClusters();
+	void BuildOccluder();
+	void BuildVertexData(std::vector<unsigned char>& OutVertexData);
+	void BuildIndexData(std::vector<unsigned char>& OutIndexData);
+	bool CreateBuffers(const void* VertexData, const void* IndexData, unsigned int IndexCount);
+public:
 
 	StaticMesh(void);
 	virtual ~StaticMesh(void);
@@ -17,17 +17,18 @@ void StaticMeshComponent::AddStaticMesh( StaticMesh* Mesh )
 {
 	_StaticMeshArray.push_back(Mesh);
 
-
-	for(UINT i=0;i<Mesh->_PositionArray.size();i++)
+	_MeshBounds.Add(Mesh->_AABBMin, Mesh->_AABBMax);
+	_SubMeshBase.push_back(_SubMeshBounds._Count);
+	for(unsigned int i=0;i<Mesh->_SubMeshArray.size();i++)
 	{
-		XMFLOAT3& Pos = Mesh->_PositionArray[i];
-		_AABBMax.x = Math::Max<float>(_AABBMax.x, Pos.x);
-		_AABBMax.y = Math::Max<float>(_AABBMax.y, Pos.y);
-		_AABBMax.z = Math::Max<float>(_AABBMax.z, Pos.z);
-
-		_AABBMin.x = Math::Min<float>(_AABBMin.x, Pos.x);
-		_AABBMin.y = Math::Min<float>(_AABBMin.y, Pos.y);
-		_AABBMin.z = Math::Min<float>(_AABBMin.z, Pos.z);
+		_SubMeshBounds.Add(Mesh->_SubMeshArray[i]->_AABBMin, Mesh->_SubMeshArray[i]->_AABBMax);
 	}
-}
 
+	_AABBMax.x = Math::Max<float>(_AABBMax.x, Mesh->_AABBMax.x);
+	_AABBMax.y = Math::Max<float>(_AABBMax.y, Mesh->_AABBMax.y);
+	_AABBMax.z = Math::Max<float>(_AABBMax.z, Mesh->_AABBMax.z);
+
+	_AABBMin.x = Math::Min<float>(_AABBMin.x, Mesh->_AABBMin.x);
+	_AABBMin.y = Math::Min<float>(_AABBMin.y, Mesh->_AABBMin.y);
+	_AABBMin.z = Math::Min<float>(_AABBMin.z, Mesh->_AABBMin.z);
+}
\ No newline at end of file
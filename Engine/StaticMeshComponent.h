@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "basecomponent.h"
+#include "FrustumCuller.h"
 
 class StaticMesh;
 
@@ -18,6 +19,11 @@ public:
 
 	std::vector<StaticMesh*> _StaticMeshArray;
 
+	// culling bounds in the component's space, one box per mesh and every mesh's submeshes back to back
+	AABBSoaArray _MeshBounds;
+	AABBSoaArray _SubMeshBounds;
+	std::vector<int> _SubMeshBase;	// first box of each mesh in _SubMeshBounds
+
 public:
 	void AddStaticMesh(StaticMesh* Mesh);
 
@@ -0,0 +1,141 @@
+#include <math.h>
+
+#include "VertexCompression.h"
+#include "MathUtil.h"
+
+static short EncodeSnorm16(float Value)
+{
+	Value = Math::Clamp<float>(Value, -1.f, 1.f) * 32767.f;
+	return (short)(Value >= 0.f ? Value + 0.5f : Value - 0.5f);
+}
+
+static float DecodeSnorm16(short Value)
+{
+	// -32768 and -32767 both map to -1
+	return Math::Max<float>(Value / 32767.f, -1.f);
+}
+
+void GetPositionScaleBias( const XMFLOAT3& AABBMin, const XMFLOAT3& AABBMax, XMFLOAT4& OutScale, XMFLOAT4& OutBias )
+{
+	// keep a tiny extent on flat axes so the encode never divides by zero
+	const float MinExtent = 1e-6f;
+	OutScale = XMFLOAT4(
+		Math::Max<float>((AABBMax.x - AABBMin.x) * 0.5f, MinExtent),
+		Math::Max<float>((AABBMax.y - AABBMin.y) * 0.5f, MinExtent),
+		Math::Max<float>((AABBMax.z - AABBMin.z) * 0.5f, MinExtent),
+		1.f);
+	OutBias = XMFLOAT4(
+		(AABBMax.x + AABBMin.x) * 0.5f,
+		(AABBMax.y + AABBMin.y) * 0.5f,
+		(AABBMax.z + AABBMin.z) * 0.5f,
+		0.f);
+}
+
+CompressedPosition EncodePosition( const XMFLOAT3& Position, const XMFLOAT4& Scale, const XMFLOAT4& Bias )
+{
+	CompressedPosition Out;
+	Out.Value[0] = EncodeSnorm16((Position.x - Bias.x) / Scale.x);
+	Out.Value[1] = EncodeSnorm16((Position.y - Bias.y) / Scale.y);
+	Out.Value[2] = EncodeSnorm16((Position.z - Bias.z) / Scale.z);
+	Out.Value[3] = 32767;
+	return Out;
+}
+
+XMFLOAT3 DecodePosition( const CompressedPosition& Position, const XMFLOAT4& Scale, const XMFLOAT4& Bias )
+{
+	return XMFLOAT3(
+		DecodeSnorm16(Position.Value[0]) * Scale.x + Bias.x,
+		DecodeSnorm16(Position.Value[1]) * Scale.y + Bias.y,
+		DecodeSnorm16(Position.Value[2]) * Scale.z + Bias.z);
+}
+
+CompressedNormal EncodeNormal( const XMFLOAT3& Normal )
+{
+	// project on the octahedron, fold the lower half over the diagonals
+	const float L1 = fabsf(Normal.x) + fabsf(Normal.y) + fabsf(Normal.z);
+	float X = L1 > 0.f ? Normal.x / L1 : 0.f;
+	float Y = L1 > 0.f ? Normal.y / L1 : 0.f;
+	if(Normal.z < 0.f)
+	{
+		const float FoldX = (1.f - fabsf(Y)) * (X >= 0.f ? 1.f : -1.f);
+		const float FoldY = (1.f - fabsf(X)) * (Y >= 0.f ? 1.f : -1.f);
+		X = FoldX;
+		Y = FoldY;
+	}
+
+	CompressedNormal Out;
+	Out.Value[0] = EncodeSnorm16(X);
+	Out.Value[1] = EncodeSnorm16(Y);
+	return Out;
+}
+
+XMFLOAT3 DecodeNormal( const CompressedNormal& Normal )
+{
+	float X = DecodeSnorm16(Normal.Value[0]);
+	float Y = DecodeSnorm16(Normal.Value[1]);
+	const float Z = 1.f - fabsf(X) - fabsf(Y);
+	const float T = Math::Max<float>(-Z, 0.f);
+	X += X >= 0.f ? -T : T;
+	Y += Y >= 0.f ? -T : T;
+
+	const float Length = sqrtf(X*X + Y*Y + Z*Z);
+	return XMFLOAT3(X / Length, Y / Length, Z / Length);
+}
+
+CompressedTexCoord EncodeTexCoord( const XMFLOAT2& TexCoord )
+{
+	CompressedTexCoord Out;
+	Out.Value[0] = XMConvertFloatToHalf(TexCoord.x);
+	Out.Value[1] = XMConvertFloatToHalf(TexCoord.y);
+	return Out;
+}
+
+XMFLOAT2 DecodeTexCoord( const CompressedTexCoord& TexCoord )
+{
+	return XMFLOAT2(XMConvertHalfToFloat(TexCoord.Value[0]), XMConvertHalfToFloat(TexCoord.Value[1]));
+}
+
+bool ValidateVertexCompression( const std::vector<XMFLOAT3>& PositionArray, const std::vector<XMFLOAT3>& NormalArray,
+	const std::vector<XMFLOAT2>& TexCoordArray, const XMFLOAT3& AABBMin, const XMFLOAT3& AABBMax, VertexCompressionError& OutError )
+{
+	OutError.Position = 0.f;
+	OutError.Normal = 0.f;
+	OutError.TexCoord = 0.f;
+
+	XMFLOAT4 Scale, Bias;
+	GetPositionScaleBias(AABBMin, AABBMax, Scale, Bias);
+	for(unsigned int i=0;i<PositionArray.size();i++)
+	{
+		const XMFLOAT3& Position = PositionArray[i];
+		const XMFLOAT3 Decoded = DecodePosition(EncodePosition(Position, Scale, Bias), Scale, Bias);
+		OutError.Position = Math::Max<float>(OutError.Position, fabsf(Decoded.x - Position.x) / Scale.x);
+		OutError.Position = Math::Max<float>(OutError.Position, fabsf(Decoded.y - Position.y) / Scale.y);
+		OutError.Position = Math::Max<float>(OutError.Position, fabsf(Decoded.z - Position.z) / Scale.z);
+	}
+
+	for(unsigned int i=0;i<NormalArray.size();i++)
+	{
+		const XMFLOAT3& Normal = NormalArray[i];
+		const XMFLOAT3 Decoded = DecodeNormal(EncodeNormal(Normal));
+		// atan2 of |cross| and dot keeps precision at small angles where acos does not
+		const float Dot = Decoded.x * Normal.x + Decoded.y * Normal.y + Decoded.z * Normal.z;
+		const float CrossX = Decoded.y * Normal.z - Decoded.z * Normal.y;
+		const float CrossY = Decoded.z * Normal.x - Decoded.x * Normal.z;
+		const float CrossZ = Decoded.x * Normal.y - Decoded.y * Normal.x;
+		const float Angle = atan2f(sqrtf(CrossX * CrossX + CrossY * CrossY + CrossZ * CrossZ), Dot);
+		OutError.Normal = Math::Max<float>(OutError.Normal, Angle);
+	}
+
+	for(unsigned int i=0;i<TexCoordArray.size();i++)
+	{
+		const XMFLOAT2& TexCoord = TexCoordArray[i];
+		const XMFLOAT2 Decoded = DecodeTexCoord(EncodeTexCoord(TexCoord));
+		OutError.TexCoord = Math::Max<float>(OutError.TexCoord, fabsf(Decoded.x - TexCoord.x));
+		OutError.TexCoord = Math::Max<float>(OutError.TexCoord, fabsf(Decoded.y - TexCoord.y));
+	}
+
+	// half a quantization step is the best possible, one step leaves room for float rounding
+	return OutError.Position <= COMPRESSED_POSITION_MAX_ERROR
+		&& OutError.Normal <= COMPRESSED_NORMAL_MAX_ERROR
+		&& OutError.TexCoord <= COMPRESSED_TEXCOORD_MAX_ERROR;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "MathTypes.h"
+#include <vector>
+
+// compressed vertex attributes
+//   position : snorm16 xyz relative to the mesh bounds, w unused (DXGI_FORMAT_R16G16B16A16_SNORM)
+//   normal   : snorm16 octahedral (DXGI_FORMAT_R16G16_SNORM)
+//   texcoord : half float (DXGI_FORMAT_R16G16_FLOAT)
+
+// a mesh falls back to the float format when decoding misses one of these
+#define COMPRESSED_POSITION_MAX_ERROR	(1.f / 32767.f)	// relative to the half extent of the bounds
+#define COMPRESSED_NORMAL_MAX_ERROR		0.001f			// radians
+#define COMPRESSED_TEXCOORD_MAX_ERROR	(1.f / 2048.f)	// half a texel at 1024
+
+struct CompressedPosition
+{
+	short Value[4];
+};
+
+struct CompressedNormal
+{
+	short Value[2];
+};
+
+struct CompressedTexCoord
+{
+	HALF Value[2];
+};
+
+struct VertexCompressionError
+{
+	float Position;
+	float Normal;
+	float TexCoord;
+};
+
+// decode is Position * Scale + Bias, same as the vertex shader
+void GetPositionScaleBias(const XMFLOAT3& AABBMin, const XMFLOAT3& AABBMax, XMFLOAT4& OutScale, XMFLOAT4& OutBias);
+
+CompressedPosition EncodePosition(const XMFLOAT3& Position, const XMFLOAT4& Scale, const XMFLOAT4& Bias);
+XMFLOAT3 DecodePosition(const CompressedPosition& Position, const XMFLOAT4& Scale, const XMFLOAT4& Bias);
+
+CompressedNormal EncodeNormal(const XMFLOAT3& Normal);
+XMFLOAT3 DecodeNormal(const CompressedNormal& Normal);
+
+CompressedTexCoord EncodeTexCoord(const XMFLOAT2& TexCoord);
+XMFLOAT2 DecodeTexCoord(const CompressedTexCoord& TexCoord);
+
+// round trips every vertex, returns false when an error bound is exceeded
+bool ValidateVertexCompression(const std::vector<XMFLOAT3>& PositionArray, const std::vector<XMFLOAT3>& NormalArray,
+	const std::vector<XMFLOAT2>& TexCoordArray, const XMFLOAT3& AABBMin, const XMFLOAT3& AABBMax, VertexCompressionError& OutError);
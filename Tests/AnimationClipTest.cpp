@@ -0,0 +1,159 @@
+// AnimationClip : the O(1) key pair of uniform clips samples the same poses as the key search over time arrays,
+// MakeUniform only drops times that are really uniform, and a key cursor never changes a pose, forward, looping
+// or jumping around, on searched and on key-reduced compressed clips. also times the three lookups.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "TestUtil.h"
+#include "AnimationClip.h"
+#include "MathUtil.h"
+
+static float GetPoseDifference(const SkeletonPose& A, const SkeletonPose& B)
+{
+	float Difference = 0.f;
+	for(unsigned int j=0;j<A._LocalPoseArray.size();j++)
+	{
+		const JointPose& JA = A._LocalPoseArray[j];
+		const JointPose& JB = B._LocalPoseArray[j];
+		// q and -q are the same rotation
+		const float Sign = JA._Rot.x * JB._Rot.x + JA._Rot.y * JB._Rot.y + JA._Rot.z * JB._Rot.z + JA._Rot.w * JB._Rot.w < 0.f ? -1.f : 1.f;
+		Difference = Math::Max<float>(Difference, fabsf(JA._Rot.x - JB._Rot.x * Sign));
+		Difference = Math::Max<float>(Difference, fabsf(JA._Rot.y - JB._Rot.y * Sign));
+		Difference = Math::Max<float>(Difference, fabsf(JA._Rot.z - JB._Rot.z * Sign));
+		Difference = Math::Max<float>(Difference, fabsf(JA._Rot.w - JB._Rot.w * Sign));
+		Difference = Math::Max<float>(Difference, fabsf(JA._Trans.x - JB._Trans.x));
+		Difference = Math::Max<float>(Difference, fabsf(JA._Trans.y - JB._Trans.y));
+		Difference = Math::Max<float>(Difference, fabsf(JA._Trans.z - JB._Trans.z));
+		Difference = Math::Max<float>(Difference, fabsf(JA._Scale.x - JB._Scale.x));
+		Difference = Math::Max<float>(Difference, fabsf(JA._Scale.y - JB._Scale.y));
+		Difference = Math::Max<float>(Difference, fabsf(JA._Scale.z - JB._Scale.z));
+	}
+	return Difference;
+}
+
+static bool IsPoseEqual(const SkeletonPose& A, const SkeletonPose& B)
+{
+	return A._LocalPoseArray.size() == B._LocalPoseArray.size()
+		&& memcmp(&A._LocalPoseArray[0], &B._LocalPoseArray[0], A._LocalPoseArray.size() * sizeof(JointPose)) == 0;
+}
+
+// playback times an instance would ask for: forward steps that loop, then jumps anywhere, before and past the clip too
+static void BuildPlayback(float Duration, std::vector<float>& OutTimes)
+{
+	float Time = 0.f;
+	for(int i=0;i<3000;i++)
+	{
+		Time = fmodf(Time + RandomFloat(0.f, 0.05f), Duration);
+		OutTimes.push_back(Time);
+	}
+	for(int i=0;i<1000;i++)
+		OutTimes.push_back(RandomFloat(-0.5f, Duration + 0.5f));
+}
+
+// each sampled time played with and without a cursor gives the very same pose
+static int CountCursorMismatches(const AnimationClip* Clip, const std::vector<float>& Times)
+{
+	const int JointCount = Clip->GetJointCount();
+	SkeletonPose Searched, Cursored;
+	Searched._LocalPoseArray.resize(JointCount);
+	Cursored._LocalPoseArray.resize(JointCount);
+	AnimKeyCursor Cursor;
+	int Mismatches = 0;
+	for(unsigned int i=0;i<Times.size();i++)
+	{
+		Clip->GetCurrentPose(Searched, Times[i]);
+		Clip->GetCurrentPose(Cursored, Times[i], &Cursor);
+		if(!IsPoseEqual(Searched, Cursored))
+			Mismatches++;
+	}
+	return Mismatches;
+}
+
+static double TimePlayback(const AnimationClip* Clip, const std::vector<float>& Times, AnimKeyCursor* Cursor)
+{
+	SkeletonPose Pose;
+	Pose._LocalPoseArray.resize(Clip->GetJointCount());
+	const double Start = GetMilliseconds();
+	for(int Run=0;Run<10;Run++)
+		for(int i=0;i<3000;i++)
+			Clip->GetCurrentPose(Pose, Times[i], Cursor);
+	return (GetMilliseconds() - Start) * 1e6 / (10 * 3000 * Clip->GetJointCount());
+}
+
+int main()
+{
+	srand(12);
+
+	const int JointCount = 60, FrameCount = 241;
+	const float SampleRate = 30.f;
+	AnimationClip* Uniform = AnimationClip::CreateSynthetic(JointCount, FrameCount, SampleRate);
+	AnimationClip* Timed = AnimationClip::CreateSynthetic(JointCount, FrameCount, SampleRate, true);
+	AnimationClip* Jittered = AnimationClip::CreateSynthetic(JointCount, FrameCount, SampleRate, true, 0.4f);
+	TEST_CHECK(Uniform->IsUniform() && !Timed->IsUniform() && !Jittered->IsUniform());
+	TEST_CHECK(Timed->GetDuration() == Uniform->GetDuration() && Jittered->GetDuration() == Uniform->GetDuration());
+
+	std::vector<float> Playback;
+	BuildPlayback(Uniform->GetDuration(), Playback);
+
+	// the uniform key pair and the search over regular times find the same keys and nearly the same alpha
+	{
+		SkeletonPose UniformPose, TimedPose;
+		UniformPose._LocalPoseArray.resize(JointCount);
+		TimedPose._LocalPoseArray.resize(JointCount);
+		float MaxDifference = 0.f;
+		for(unsigned int i=0;i<Playback.size();i++)
+		{
+			Uniform->GetCurrentPose(UniformPose, Playback[i]);
+			Timed->GetCurrentPose(TimedPose, Playback[i]);
+			MaxDifference = Math::Max<float>(MaxDifference, GetPoseDifference(UniformPose, TimedPose));
+		}
+		printf("AnimationClip : uniform against searched keys, max difference %.3g\n", MaxDifference);
+		TEST_CHECK(MaxDifference < 1e-4f);
+	}
+
+	// the timing is taken before MakeUniform drops the time arrays
+	AnimKeyCursor Cursor;
+	const double SearchTime = TimePlayback(Jittered, Playback, NULL);
+	const double CursorTime = TimePlayback(Jittered, Playback, &Cursor);
+	const double UniformTime = TimePlayback(Uniform, Playback, NULL);
+	printf("AnimationClip : ns per joint, binary search %.1f, cursor %.1f, uniform %.1f\n", SearchTime, CursorTime, UniformTime);
+
+	// cursors on the key search
+	TEST_CHECK(CountCursorMismatches(Timed, Playback) == 0);
+	TEST_CHECK(CountCursorMismatches(Jittered, Playback) == 0);
+
+	// regular times become uniform and sample exactly like a clip that never had them, irregular ones stay
+	{
+		TEST_CHECK(Timed->MakeUniform() && Timed->IsUniform());
+		TEST_CHECK(!Jittered->MakeUniform() && !Jittered->IsUniform());
+		SkeletonPose UniformPose, TimedPose;
+		UniformPose._LocalPoseArray.resize(JointCount);
+		TimedPose._LocalPoseArray.resize(JointCount);
+		int Mismatches = 0;
+		for(unsigned int i=0;i<Playback.size();i++)
+		{
+			Uniform->GetCurrentPose(UniformPose, Playback[i]);
+			Timed->GetCurrentPose(TimedPose, Playback[i]);
+			if(GetPoseDifference(UniformPose, TimedPose) > 1e-6f)
+				Mismatches++;
+		}
+		TEST_CHECK(Mismatches == 0);
+	}
+
+	// cursors on key-reduced compressed tracks
+	{
+		std::vector<int> ParentArray;
+		for(int j=0;j<JointCount;j++)
+			ParentArray.push_back(j - 1);
+		AnimCompressionError Error;
+		TEST_CHECK(AnimationCompressor::Compress(*Uniform, ParentArray, ANIM_MAX_ERROR, Error));
+		TEST_CHECK(CountCursorMismatches(Uniform, Playback) == 0);
+	}
+
+	delete Jittered;
+	delete Timed;
+	delete Uniform;
+	return TEST_RESULT("AnimationClipTest");
+}
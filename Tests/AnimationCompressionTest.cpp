@@ -0,0 +1,157 @@
+// AnimationCompression : every joint of a compressed clip stays within the requested error of the source in
+// model space, measured at the joint and at the virtual vertices around it on chains and trees, the reported
+// error is honest, and clips the compressor can't take are left as they are.
+
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "TestUtil.h"
+#include "AnimationClip.h"
+#include "MathUtil.h"
+
+// row major 3x4 in double, so the measurement adds no error of its own
+struct TestMatrix
+{
+	double M[3][4];
+};
+
+static TestMatrix ComposeJoint(const JointPose& Joint)
+{
+	const double X = Joint._Rot.x, Y = Joint._Rot.y, Z = Joint._Rot.z, W = Joint._Rot.w;
+	const double R[3][3] =
+	{
+		{1 - 2*(Y*Y + Z*Z),	2*(X*Y - Z*W),		2*(X*Z + Y*W)},
+		{2*(X*Y + Z*W),		1 - 2*(X*X + Z*Z),	2*(Y*Z - X*W)},
+		{2*(X*Z - Y*W),		2*(Y*Z + X*W),		1 - 2*(X*X + Y*Y)},
+	};
+	const double S[3] = {Joint._Scale.x, Joint._Scale.y, Joint._Scale.z};
+	const double T[3] = {Joint._Trans.x, Joint._Trans.y, Joint._Trans.z};
+	TestMatrix Out;
+	for(int r=0;r<3;r++)
+	{
+		for(int c=0;c<3;c++)
+			Out.M[r][c] = R[r][c] * S[c];
+		Out.M[r][3] = T[r];
+	}
+	return Out;
+}
+
+static TestMatrix Multiply(const TestMatrix& A, const TestMatrix& B)
+{
+	TestMatrix Out;
+	for(int r=0;r<3;r++)
+		for(int c=0;c<4;c++)
+			Out.M[r][c] = A.M[r][0] * B.M[0][c] + A.M[r][1] * B.M[1][c] + A.M[r][2] * B.M[2][c] + (c == 3 ? A.M[r][3] : 0.);
+	return Out;
+}
+
+static void GetModelSpace(const SkeletonPose& Pose, const std::vector<int>& ParentArray, std::vector<TestMatrix>& OutModel)
+{
+	OutModel.resize(ParentArray.size());
+	for(unsigned int j=0;j<ParentArray.size();j++)
+	{
+		const TestMatrix Local = ComposeJoint(Pose._LocalPoseArray[j]);
+		OutModel[j] = ParentArray[j] >= 0 ? Multiply(OutModel[ParentArray[j]], Local) : Local;
+	}
+}
+
+// distance between the two transforms of the joint origin and of six virtual vertices at Radius around it
+static double GetShellDistance(const TestMatrix& A, const TestMatrix& B, double Radius)
+{
+	double MaxDistance = 0.;
+	for(int p=0;p<7;p++)
+	{
+		double Point[3] = {0., 0., 0.};
+		if(p > 0)
+			Point[(p - 1) / 2] = p & 1 ? Radius : -Radius;
+		double DistanceSq = 0.;
+		for(int r=0;r<3;r++)
+		{
+			const double D = (A.M[r][0] - B.M[r][0]) * Point[0] + (A.M[r][1] - B.M[r][1]) * Point[1] + (A.M[r][2] - B.M[r][2]) * Point[2] + A.M[r][3] - B.M[r][3];
+			DistanceSq += D * D;
+		}
+		MaxDistance = Math::Max<double>(MaxDistance, sqrt(DistanceSq));
+	}
+	return MaxDistance;
+}
+
+int main()
+{
+	srand(11);
+
+	const int JointCount = 40, FrameCount = 121;
+	const float SampleRate = 30.f;
+
+	// a single chain, where error adds up along 40 parents, and a binary tree
+	std::vector<int> Hierarchies[2];
+	for(int j=0;j<JointCount;j++)
+	{
+		Hierarchies[0].push_back(j - 1);
+		Hierarchies[1].push_back(j > 0 ? (j - 1) / 2 : -1);
+	}
+
+	const float MaxErrors[] = { 0.1f, ANIM_MAX_ERROR, 0.001f };
+	for(int h=0;h<2;h++)
+	{
+		for(int e=0;e<3;e++)
+		{
+			const std::vector<int>& ParentArray = Hierarchies[h];
+			AnimationClip* Source = AnimationClip::CreateSynthetic(JointCount, FrameCount, SampleRate);
+			AnimationClip* Compressed = new AnimationClip(*Source);
+
+			AnimCompressionError Error;
+			const double Start = GetMilliseconds();
+			TEST_CHECK(AnimationCompressor::Compress(*Compressed, ParentArray, MaxErrors[e], Error));
+			const double Elapsed = GetMilliseconds() - Start;
+			TEST_CHECK(Compressed->IsCompressed() && Compressed->GetJointCount() == JointCount);
+			TEST_CHECK(Error.MaxError <= MaxErrors[e]);
+			TEST_CHECK(Error.CompressedSize < Error.RawSize && Error.CompressedSize == Compressed->GetMemorySize());
+
+			// measured independently at every sampled frame through the runtime path
+			SkeletonPose SourcePose, CompressedPose;
+			SourcePose._LocalPoseArray.resize(JointCount);
+			CompressedPose._LocalPoseArray.resize(JointCount);
+			std::vector<TestMatrix> SourceModel, CompressedModel;
+			double MaxDistance = 0.;
+			for(int f=0;f<FrameCount;f++)
+			{
+				Source->GetCurrentPose(SourcePose, f / SampleRate);
+				Compressed->GetCurrentPose(CompressedPose, f / SampleRate);
+				GetModelSpace(SourcePose, ParentArray, SourceModel);
+				GetModelSpace(CompressedPose, ParentArray, CompressedModel);
+				for(int j=0;j<JointCount;j++)
+					MaxDistance = Math::Max<double>(MaxDistance, GetShellDistance(SourceModel[j], CompressedModel[j], ANIM_SHELL_DISTANCE));
+			}
+			printf("AnimationCompression : %s, budget %g, %d -> %d bytes, reported %.3g, measured %.3g in %.1f ms\n",
+				h == 0 ? "chain" : "tree", MaxErrors[e], Error.RawSize, Error.CompressedSize, Error.MaxError, MaxDistance, Elapsed);
+			TEST_CHECK(MaxDistance <= MaxErrors[e]);
+
+			delete Compressed;
+			delete Source;
+		}
+	}
+
+	// parents after their children and mismatched hierarchies leave the clip alone
+	{
+		AnimationClip* Clip = AnimationClip::CreateSynthetic(4, 10, SampleRate);
+		const int RawSize = Clip->GetMemorySize();
+		AnimCompressionError Error;
+		std::vector<int> ParentArray;
+		ParentArray.push_back(-1);
+		ParentArray.push_back(2);
+		ParentArray.push_back(0);
+		ParentArray.push_back(1);
+		TEST_CHECK(!AnimationCompressor::Compress(*Clip, ParentArray, ANIM_MAX_ERROR, Error));
+		ParentArray.pop_back();
+		TEST_CHECK(!AnimationCompressor::Compress(*Clip, ParentArray, ANIM_MAX_ERROR, Error));
+		TEST_CHECK(!Clip->IsCompressed() && Clip->GetMemorySize() == RawSize);
+
+		ParentArray[1] = 0;
+		ParentArray.push_back(2);
+		TEST_CHECK(AnimationCompressor::Compress(*Clip, ParentArray, ANIM_MAX_ERROR, Error));
+		TEST_CHECK(!AnimationCompressor::Compress(*Clip, ParentArray, ANIM_MAX_ERROR, Error));
+		delete Clip;
+	}
+
+	return TEST_RESULT("AnimationCompressionTest");
+}
@@ -0,0 +1,149 @@
+// AnimationSampler : the sse and avx2 SoA blends match the scalar one, translations and scales exactly and
+// rotations within the rsqrt refinement, padding joints stay identity, single joints blend like whole poses,
+// and a SoA clip stays close to the AoS slerp path. also times the AoS path against every SoA path.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "TestUtil.h"
+#include "AnimationClip.h"
+#include "MathUtil.h"
+
+// rsqrt estimate and one newton step against the scalar 1 / sqrt
+#define SOA_ROTATION_TOLERANCE	1e-6f
+
+// independent random rotations, so about half the key pairs sit in opposite hemispheres and take the flip
+static JointPose RandomJoint()
+{
+	JointPose Joint;
+	XMFLOAT4 Q(RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f));
+	const float InvLength = 1.f / sqrtf(Q.x * Q.x + Q.y * Q.y + Q.z * Q.z + Q.w * Q.w);
+	Joint._Rot = XMFLOAT4(Q.x * InvLength, Q.y * InvLength, Q.z * InvLength, Q.w * InvLength);
+	Joint._Trans = XMFLOAT3(RandomFloat(-50.f, 50.f), RandomFloat(-50.f, 50.f), RandomFloat(-50.f, 50.f));
+	Joint._Scale = XMFLOAT3(RandomFloat(0.5f, 2.f), RandomFloat(0.5f, 2.f), RandomFloat(0.5f, 2.f));
+	return Joint;
+}
+
+static float GetRotationDifference(const XMFLOAT4& A, const XMFLOAT4& B)
+{
+	return Math::Max<float>(Math::Max<float>(fabsf(A.x - B.x), fabsf(A.y - B.y)), Math::Max<float>(fabsf(A.z - B.z), fabsf(A.w - B.w)));
+}
+
+int main()
+{
+	srand(13);
+
+	// whole poses, joint counts around the vector widths
+	const int JointCounts[] = { 1, 3, 4, 7, 8, 9, 63, 500 };
+	for(int c=0;c<(int)(sizeof(JointCounts) / sizeof(JointCounts[0]));c++)
+	{
+		SkeletonPose Pose0, Pose1;
+		for(int j=0;j<JointCounts[c];j++)
+		{
+			Pose0._LocalPoseArray.push_back(RandomJoint());
+			Pose1._LocalPoseArray.push_back(RandomJoint());
+		}
+		SoaSkeletonPose Keys0, Keys1;
+		Keys0.FromSkeletonPose(Pose0);
+		Keys1.FromSkeletonPose(Pose1);
+		TEST_CHECK(Keys0._PaddedCount % ANIM_SOA_WIDTH == 0 && Keys0._PaddedCount >= JointCounts[c]);
+
+		SkeletonPose Back;
+		Keys0.ToSkeletonPose(Back);
+		TEST_CHECK(memcmp(&Back._LocalPoseArray[0], &Pose0._LocalPoseArray[0], JointCounts[c] * sizeof(JointPose)) == 0);
+
+		for(int a=0;a<=8;a++)
+		{
+			const float Alpha = a / 8.f;
+			SoaSkeletonPose Reference;
+			Reference.Init(JointCounts[c]);
+			AnimationSampler::InterpolatePose(&Keys0._Data[0], &Keys1._Data[0], Alpha, Keys0._PaddedCount, &Reference._Data[0], ANIM_SIMD_SCALAR);
+
+			// one joint at a time blends the same
+			for(int j=0;j<JointCounts[c];j++)
+			{
+				JointPose Joint;
+				AnimationSampler::InterpolateJoint(&Keys0._Data[0], &Keys1._Data[0], Alpha, Keys0._PaddedCount, j, Joint);
+				JointPose Stored;
+				Stored._Rot = XMFLOAT4(Reference.GetStream(ANIM_SOA_ROT_X)[j], Reference.GetStream(ANIM_SOA_ROT_Y)[j], Reference.GetStream(ANIM_SOA_ROT_Z)[j], Reference.GetStream(ANIM_SOA_ROT_W)[j]);
+				Stored._Trans = XMFLOAT3(Reference.GetStream(ANIM_SOA_TRANS_X)[j], Reference.GetStream(ANIM_SOA_TRANS_Y)[j], Reference.GetStream(ANIM_SOA_TRANS_Z)[j]);
+				Stored._Scale = XMFLOAT3(Reference.GetStream(ANIM_SOA_SCALE_X)[j], Reference.GetStream(ANIM_SOA_SCALE_Y)[j], Reference.GetStream(ANIM_SOA_SCALE_Z)[j]);
+				TEST_CHECK(memcmp(&Joint, &Stored, sizeof(JointPose)) == 0);
+			}
+
+			for(int Simd=ANIM_SIMD_SSE;Simd<=AnimationSampler::GetBestSimd();Simd++)
+			{
+				SoaSkeletonPose Out;
+				Out.Init(JointCounts[c]);
+				AnimationSampler::InterpolatePose(&Keys0._Data[0], &Keys1._Data[0], Alpha, Keys0._PaddedCount, &Out._Data[0], (EAnimSimd)Simd);
+
+				float MaxDifference = 0.f;
+				for(int s=ANIM_SOA_ROT_X;s<=ANIM_SOA_ROT_W;s++)
+					for(int j=0;j<Out._PaddedCount;j++)
+						MaxDifference = Math::Max<float>(MaxDifference, fabsf(Out.GetStream(s)[j] - Reference.GetStream(s)[j]));
+				TEST_CHECK(MaxDifference <= SOA_ROTATION_TOLERANCE);
+				TEST_CHECK(memcmp(Out.GetStream(ANIM_SOA_TRANS_X), Reference.GetStream(ANIM_SOA_TRANS_X), (ANIM_SOA_STREAM_COUNT - ANIM_SOA_TRANS_X) * Out._PaddedCount * sizeof(float)) == 0);
+
+				// padding joints stay identity
+				for(int j=JointCounts[c];j<Out._PaddedCount;j++)
+				{
+					TEST_CHECK(fabsf(Out.GetStream(ANIM_SOA_ROT_W)[j] - 1.f) <= SOA_ROTATION_TOLERANCE && Out.GetStream(ANIM_SOA_ROT_X)[j] == 0.f);
+					TEST_CHECK(Out.GetStream(ANIM_SOA_SCALE_X)[j] == 1.f && Out.GetStream(ANIM_SOA_TRANS_X)[j] == 0.f);
+				}
+			}
+		}
+	}
+
+	// a SoA clip against its own AoS slerp path, and the cost of both on a humanoid and on a 500 joint rig
+	const int RigJointCounts[] = { 60, 500 };
+	for(int r=0;r<2;r++)
+	{
+		const int JointCount = RigJointCounts[r], FrameCount = 300;
+		const float SampleRate = 30.f, TimeStep = 0.0137f;
+		AnimationClip* AoS = AnimationClip::CreateSynthetic(JointCount, FrameCount, SampleRate);
+		AnimationClip* SoA = AnimationClip::CreateSynthetic(JointCount, FrameCount, SampleRate);
+		TEST_CHECK(SoA->BuildSoaKeys() && SoA->HasSoaKeys() && SoA->GetJointCount() == JointCount);
+
+		SkeletonPose AoSPose, SoAPose;
+		AoSPose._LocalPoseArray.resize(JointCount);
+		SoaSkeletonPose SoaPose;
+		float MaxDifference = 0.f;
+		for(int i=0;i<1000;i++)
+		{
+			const float Time = fmodf(i * TimeStep, AoS->GetDuration());
+			AoS->GetCurrentPose(AoSPose, Time);
+			SoA->GetCurrentPose(SoaPose, Time, AnimationSampler::GetBestSimd());
+			SoaPose.ToSkeletonPose(SoAPose);
+			for(int j=0;j<JointCount;j++)
+			{
+				MaxDifference = Math::Max<float>(MaxDifference, GetRotationDifference(AoSPose._LocalPoseArray[j]._Rot, SoAPose._LocalPoseArray[j]._Rot));
+				MaxDifference = Math::Max<float>(MaxDifference, fabsf(AoSPose._LocalPoseArray[j]._Trans.z - SoAPose._LocalPoseArray[j]._Trans.z));
+			}
+		}
+		// nlerp and slerp part by well under a thousandth between keys a frame apart
+		printf("AnimationSampler : %d joints, SoA nlerp against AoS slerp, max difference %.3g\n", JointCount, MaxDifference);
+		TEST_CHECK(MaxDifference < 1e-3f);
+
+		const int PoseCount = 2000;
+		double Start = GetMilliseconds();
+		for(int i=0;i<PoseCount;i++)
+			AoS->GetCurrentPose(AoSPose, fmodf(i * TimeStep, AoS->GetDuration()));
+		const double AoSTime = GetMilliseconds() - Start;
+		double SoaTime[ANIM_SIMD_AVX2 + 1] = {0};
+		for(int Simd=ANIM_SIMD_SCALAR;Simd<=AnimationSampler::GetBestSimd();Simd++)
+		{
+			Start = GetMilliseconds();
+			for(int i=0;i<PoseCount;i++)
+				SoA->GetCurrentPose(SoaPose, fmodf(i * TimeStep, SoA->GetDuration()), (EAnimSimd)Simd);
+			SoaTime[Simd] = GetMilliseconds() - Start;
+		}
+		printf("AnimationSampler : %d joints, aos %.2f us, soa scalar %.2f us, sse %.2f us, avx2 %.2f us\n", JointCount,
+			AoSTime * 1e3 / PoseCount, SoaTime[ANIM_SIMD_SCALAR] * 1e3 / PoseCount, SoaTime[ANIM_SIMD_SSE] * 1e3 / PoseCount, SoaTime[ANIM_SIMD_AVX2] * 1e3 / PoseCount);
+
+		delete SoA;
+		delete AoS;
+	}
+
+	return TEST_RESULT("AnimationSamplerTest");
+}
@@ -0,0 +1,242 @@
+// BakedAnimation : every baked frame is the palette the sampled path builds at that frame's time, float bakes
+// exactly, half bakes within half rounding and SoA sampled clips within the nlerp error, in both palette formats
+// and decoded into the other one. BakedPaletteCache hands instances on the same frame one shared palette.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "TestUtil.h"
+#include "BakedAnimation.h"
+#include "AnimationClip.h"
+#include "Skeleton.h"
+#include "MathUtil.h"
+
+// nlerp against slerp, carried down the joint chain and out along the bone translations
+#define SOA_PALETTE_TOLERANCE	1e-3f
+
+// a binary tree of JointCount joints, bound where every joint sits at its parent plus (10, 0, 0)
+static void BuildSkeleton(int JointCount, Skeleton& Skel, SkeletonPose& RefPose)
+{
+	Skel._JointCount = JointCount;
+	Skel._Joints.resize(JointCount);
+	std::vector<float> Depth(JointCount, 0.f);
+	for(int j=0;j<JointCount;j++)
+	{
+		SkeletonJoint& Joint = Skel._Joints[j];
+		Joint._ParentIndex = j > 0 ? (j - 1) / 2 : -1;
+		Depth[j] = j > 0 ? Depth[Joint._ParentIndex] + 1.f : 0.f;
+		memset(&Joint._InvRefPose, 0, sizeof(XMFLOAT4X4));
+		Joint._InvRefPose._11 = Joint._InvRefPose._22 = Joint._InvRefPose._33 = Joint._InvRefPose._44 = 1.f;
+		Joint._InvRefPose._41 = -10.f * Depth[j];
+	}
+	BonePalette::InitSkeleton(Skel);
+
+	RefPose._LocalPoseArray.resize(JointCount);
+	for(int j=0;j<JointCount;j++)
+	{
+		RefPose._LocalPoseArray[j]._Rot = XMFLOAT4(0.f, 0.f, 0.f, 1.f);
+		RefPose._LocalPoseArray[j]._Trans = XMFLOAT3(j > 0 ? 10.f : 0.f, 0.f, 0.f);
+		RefPose._LocalPoseArray[j]._Scale = XMFLOAT3(1.f, 1.f, 1.f);
+	}
+}
+
+// the palette the sampled path builds at a bake frame, in the stored layout of Format
+static void BuildReference(const AnimationClip* Clip, const Skeleton& Skel, const SkeletonPose& RefPose, float SampleRate, int Frame,
+	ESkinningMode Format, std::vector<XMFLOAT4>& OutElements)
+{
+	SkeletonPose Pose = RefPose;
+	Clip->GetCurrentPose(Pose, Math::Min<float>(Frame / SampleRate, Clip->GetDuration()));
+	std::vector<BoneMatrix3x4> Model(Skel._JointCount), Skin(Skel._JointCount);
+	BonePalette::Build(Skel, Pose, &Model[0], &Skin[0]);
+	if(Format == SKIN_DUALQUAT)
+	{
+		std::vector<BoneDualQuat> DualQuat(Skel._JointCount);
+		BonePalette::ToDualQuat(&Skin[0], Skel._JointCount, &DualQuat[0]);
+		OutElements.assign(&DualQuat[0].Real, &DualQuat[0].Real + Skel._JointCount * BONE_ELEMENTS_DUALQUAT);
+	}
+	else
+	{
+		OutElements.assign(&Skin[0].Row[0], &Skin[0].Row[0] + Skel._JointCount * BONE_ELEMENTS_LINEAR);
+	}
+}
+
+// the frame decoded into Mode, as float4 elements in that mode's layout
+static void DecodeElements(const BakedAnimation& Baked, int Frame, ESkinningMode Mode, std::vector<XMFLOAT4>& OutElements)
+{
+	std::vector<BoneMatrix3x4> Palette(Baked._JointCount);
+	std::vector<BoneDualQuat> DualQuat(Baked._JointCount);
+	Baked.DecodeFrame(Frame, Mode, &Palette[0], &DualQuat[0]);
+	if(Mode == SKIN_DUALQUAT)
+		OutElements.assign(&DualQuat[0].Real, &DualQuat[0].Real + Baked._JointCount * BONE_ELEMENTS_DUALQUAT);
+	else
+		OutElements.assign(&Palette[0].Row[0], &Palette[0].Row[0] + Baked._JointCount * BONE_ELEMENTS_LINEAR);
+}
+
+// dual quaternion palettes compare q against q or -q, whichever is nearer, both are the same transform
+static float GetMaxDifference(const XMFLOAT4* A, const XMFLOAT4* B, int Count, ESkinningMode Mode)
+{
+	const int ElementsPerBone = Mode == SKIN_DUALQUAT ? BONE_ELEMENTS_DUALQUAT : BONE_ELEMENTS_LINEAR;
+	float Difference = 0.f;
+	for(int e=0;e<Count;e++)
+	{
+		const XMFLOAT4& Real = A[e - e % ElementsPerBone];
+		const XMFLOAT4& OtherReal = B[e - e % ElementsPerBone];
+		const float Sign = Mode == SKIN_DUALQUAT && Real.x * OtherReal.x + Real.y * OtherReal.y + Real.z * OtherReal.z + Real.w * OtherReal.w < 0.f ? -1.f : 1.f;
+		Difference = Math::Max<float>(Difference, Math::Max<float>(fabsf(A[e].x - B[e].x * Sign), fabsf(A[e].y - B[e].y * Sign)));
+		Difference = Math::Max<float>(Difference, Math::Max<float>(fabsf(A[e].z - B[e].z * Sign), fabsf(A[e].w - B[e].w * Sign)));
+	}
+	return Difference;
+}
+
+// elements that aren't the nearest half of the reference
+static int CountHalfMismatches(const XMFLOAT4* Decoded, const XMFLOAT4* Reference, int Count)
+{
+	int Mismatches = 0;
+	for(int e=0;e<Count;e++)
+	{
+		const float* D = &Decoded[e].x;
+		const float* R = &Reference[e].x;
+		for(int c=0;c<4;c++)
+			if(D[c] != XMConvertHalfToFloat(XMConvertFloatToHalf(R[c])))
+				Mismatches++;
+	}
+	return Mismatches;
+}
+
+int main()
+{
+	srand(16);
+
+	const int JointCount = 60, FrameCount = 61;
+	const float ClipRate = 30.f;
+	Skeleton Skel;
+	SkeletonPose RefPose;
+	BuildSkeleton(JointCount, Skel, RefPose);
+	AnimationClip* Clip = AnimationClip::CreateSynthetic(JointCount, FrameCount, ClipRate);
+
+	// on the clip's keys and between them, with a last frame that falls past the clip's end
+	const float SampleRates[] = { 30.f, 24.f, 70.f };
+	for(int r=0;r<3;r++)
+	{
+		for(int m=0;m<2;m++)
+		{
+			const ESkinningMode Format = m == 0 ? SKIN_LINEAR : SKIN_DUALQUAT;
+			const ESkinningMode Other = m == 0 ? SKIN_DUALQUAT : SKIN_LINEAR;
+			BakedAnimation Float, Half;
+			Float.Bake(Clip, Skel, RefPose, SampleRates[r], Format, false);
+			Half.Bake(Clip, Skel, RefPose, SampleRates[r], Format, true);
+			TEST_CHECK(Float._FrameCount == (int)ceilf(Clip->GetDuration() * SampleRates[r]) + 1 && Half._FrameCount == Float._FrameCount);
+			TEST_CHECK(Half.GetMemorySize() * 2 == Float.GetMemorySize());
+			TEST_CHECK(Float.GetFrameIndex(-1.f) == 0 && Float.GetFrameIndex(Clip->GetDuration() + 1.f) == Float._FrameCount - 1);
+			TEST_CHECK(Float.GetFrameIndex(2.4f / SampleRates[r]) == 2 && Float.GetFrameIndex(2.6f / SampleRates[r]) == 3);
+
+			const int FrameElements = JointCount * Float.GetElementsPerBone();
+			int FloatMismatches = 0, HalfMismatches = 0, OtherMismatches = 0;
+			float HalfOtherDifference = 0.f;
+			std::vector<XMFLOAT4> Reference, OtherReference, Decoded;
+			for(int f=0;f<Float._FrameCount;f++)
+			{
+				BuildReference(Clip, Skel, RefPose, SampleRates[r], f, Format, Reference);
+				BuildReference(Clip, Skel, RefPose, SampleRates[r], f, Other, OtherReference);
+
+				// float frames are used in place and hold the sampled palette bit for bit
+				const XMFLOAT4* Direct = (const XMFLOAT4*)Float.GetDirectFrame(f, Format);
+				TEST_CHECK(Direct != NULL && Float.GetDirectFrame(f, Other) == NULL && Half.GetDirectFrame(f, Format) == NULL);
+				if(memcmp(Direct, &Reference[0], FrameElements * sizeof(XMFLOAT4)) != 0)
+					FloatMismatches++;
+				DecodeElements(Float, f, Format, Decoded);
+				if(memcmp(&Decoded[0], &Reference[0], FrameElements * sizeof(XMFLOAT4)) != 0)
+					FloatMismatches++;
+
+				// a mode change converts the sampled palette the way the sampled path would
+				DecodeElements(Float, f, Other, Decoded);
+				if(Format == SKIN_LINEAR && memcmp(&Decoded[0], &OtherReference[0], Decoded.size() * sizeof(XMFLOAT4)) != 0)
+					OtherMismatches++;
+				// dual quaternions back to matrices drop the scale the synthetic clip doesn't have
+				if(Format == SKIN_DUALQUAT && GetMaxDifference(&Decoded[0], &OtherReference[0], Decoded.size(), Other) > 1e-4f)
+					OtherMismatches++;
+
+				// half frames widen to the nearest half of every sampled element
+				DecodeElements(Half, f, Format, Decoded);
+				HalfMismatches += CountHalfMismatches(&Decoded[0], &Reference[0], FrameElements);
+				DecodeElements(Half, f, Other, Decoded);
+				HalfOtherDifference = Math::Max<float>(HalfOtherDifference, GetMaxDifference(&Decoded[0], &OtherReference[0], Decoded.size(), Other));
+			}
+			printf("BakedAnimation : %s at %g Hz, %d frames, float %d bytes, half %d bytes, half decoded to %s max difference %.3g\n",
+				Format == SKIN_LINEAR ? "linear" : "dual quaternion", SampleRates[r], Float._FrameCount, Float.GetMemorySize(), Half.GetMemorySize(),
+				Other == SKIN_LINEAR ? "linear" : "dual quaternion", HalfOtherDifference);
+			TEST_CHECK(FloatMismatches == 0 && OtherMismatches == 0 && HalfMismatches == 0);
+			// half rounding of translations out to 60 units, converted
+			TEST_CHECK(HalfOtherDifference < 0.05f);
+		}
+	}
+
+	// clips with SoA keys bake through the simd sampler, close to the AoS palettes
+	{
+		AnimationClip* SoaClip = AnimationClip::CreateSynthetic(JointCount, FrameCount, ClipRate);
+		TEST_CHECK(SoaClip->BuildSoaKeys());
+		for(int m=0;m<2;m++)
+		{
+			const ESkinningMode Format = m == 0 ? SKIN_LINEAR : SKIN_DUALQUAT;
+			BakedAnimation Baked;
+			Baked.Bake(SoaClip, Skel, RefPose, 24.f, Format, false);
+			float MaxDifference = 0.f;
+			std::vector<XMFLOAT4> Reference;
+			for(int f=0;f<Baked._FrameCount;f++)
+			{
+				BuildReference(Clip, Skel, RefPose, 24.f, f, Format, Reference);
+				MaxDifference = Math::Max<float>(MaxDifference, GetMaxDifference((const XMFLOAT4*)Baked.GetDirectFrame(f, Format), &Reference[0], Reference.size(), Format));
+			}
+			printf("BakedAnimation : SoA bake against the AoS palettes, max difference %.3g\n", MaxDifference);
+			TEST_CHECK(MaxDifference < SOA_PALETTE_TOLERANCE);
+		}
+		delete SoaClip;
+	}
+
+	// instances on the same bake, frame and mode share one entry, decoded once, pointing into the bake when they can
+	{
+		BakedAnimation Float, Half;
+		Float.Bake(Clip, Skel, RefPose, BAKED_ANIM_DEFAULT_RATE, SKIN_LINEAR, false);
+		Half.Bake(Clip, Skel, RefPose, BAKED_ANIM_DEFAULT_RATE, SKIN_DUALQUAT, true);
+		BakedPaletteCache Cache;
+		for(int Run=0;Run<2;Run++)
+		{
+			Cache.BeginFrame();
+			const int InstanceCount = 1000;
+			std::vector<int> Entries;
+			std::vector<BakedPaletteKey> Keys;
+			for(int i=0;i<InstanceCount;i++)
+			{
+				BakedPaletteKey Key;
+				Key.Baked = i & 1 ? &Half : &Float;
+				Key.Frame = (i / 2 * 7 + Run) % 10;
+				Key.Mode = i % 3 == 0 ? SKIN_DUALQUAT : SKIN_LINEAR;
+				Keys.push_back(Key);
+				Entries.push_back(Cache.Request(Key.Baked, Key.Frame, Key.Mode));
+			}
+			// 2 bakes x 10 frames x 2 modes
+			TEST_CHECK(Cache._RequestCount == InstanceCount && Cache._EntryCount == 40);
+			Cache.Decode();
+
+			int Mismatches = 0;
+			std::vector<XMFLOAT4> Decoded;
+			for(int i=0;i<InstanceCount;i++)
+			{
+				const BakedPaletteKey& Key = Keys[i];
+				if(Entries[i] != Cache.Request(Key.Baked, Key.Frame, Key.Mode))
+					Mismatches++;
+				DecodeElements(*Key.Baked, Key.Frame, Key.Mode, Decoded);
+				const XMFLOAT4* Cached = Key.Mode == SKIN_DUALQUAT ? &Cache.GetDualQuat(Entries[i])->Real : &Cache.GetPalette(Entries[i])->Row[0];
+				if(memcmp(Cached, &Decoded[0], Decoded.size() * sizeof(XMFLOAT4)) != 0)
+					Mismatches++;
+				if(Key.Baked == &Float && Key.Mode == SKIN_LINEAR && (const void*)Cached != Float.GetDirectFrame(Key.Frame, SKIN_LINEAR))
+					Mismatches++;
+			}
+			TEST_CHECK(Mismatches == 0);
+		}
+	}
+
+	delete Clip;
+	return TEST_RESULT("BakedAnimationTest");
+}
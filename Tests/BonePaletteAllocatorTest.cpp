@@ -0,0 +1,66 @@
+// BonePaletteAllocator : runs are handed out back to back, the capacity grows in powers of two up to
+// the maximum, and allocations past it are refused and counted instead of overlapping.
+
+#include "TestUtil.h"
+#include "BonePaletteAllocator.h"
+
+int main()
+{
+	BonePaletteAllocator Allocator(64, 1024);
+	TEST_CHECK(Allocator._Capacity == 64);
+	TEST_CHECK(Allocator._bResized);
+
+	// fits, runs are contiguous
+	Allocator._bResized = false;
+	Allocator.BeginFrame(60);
+	TEST_CHECK(Allocator._Capacity == 64 && !Allocator._bResized);
+	TEST_CHECK(Allocator.Allocate(30) == 0);
+	TEST_CHECK(Allocator.Allocate(30) == 30);
+	TEST_CHECK(Allocator.Allocate(0) == 60);
+	TEST_CHECK(Allocator.Allocate(5) == BONE_ARENA_INVALID);
+	TEST_CHECK(Allocator.Allocate(4) == 60);
+	TEST_CHECK(Allocator._OverflowCount == 1);
+	Allocator.EndFrame();
+	TEST_CHECK(Allocator._HighWater == 64);
+
+	// grows to the next power of two that holds the frame, the counters start over
+	Allocator.BeginFrame(300);
+	TEST_CHECK(Allocator._Capacity == 512 && Allocator._bResized);
+	TEST_CHECK(Allocator._Used == 0 && Allocator._OverflowCount == 0);
+	for(int i=0;i<100;i++)
+		TEST_CHECK(Allocator.Allocate(3) == i * 3);
+	Allocator.EndFrame();
+	TEST_CHECK(Allocator._HighWater == 300);
+
+	// a smaller frame keeps the capacity, the high water mark stays
+	Allocator._bResized = false;
+	Allocator.BeginFrame(10);
+	TEST_CHECK(Allocator._Capacity == 512 && !Allocator._bResized);
+	Allocator.EndFrame();
+	TEST_CHECK(Allocator._HighWater == 300);
+
+	// past the maximum the capacity stops, later runs are refused whole and earlier runs are untouched
+	Allocator.BeginFrame(5000);
+	TEST_CHECK(Allocator._Capacity == 1024);
+	int Base = 0, Refused = 0;
+	for(int i=0;i<2000;i++)
+	{
+		const int Run = Allocator.Allocate(3);
+		if(Run == BONE_ARENA_INVALID)
+		{
+			Refused++;
+			continue;
+		}
+		TEST_CHECK(Run == Base);
+		Base += 3;
+	}
+	TEST_CHECK(Base <= 1024 && Base + 3 > 1024);
+	TEST_CHECK(Refused == Allocator._OverflowCount && Refused == 2000 - 1024 / 3);
+	TEST_CHECK(Allocator.Allocate(-1) == BONE_ARENA_INVALID);
+
+	// an initial capacity over the maximum is clamped
+	BonePaletteAllocator Small(4096, 100);
+	TEST_CHECK(Small._Capacity == 100);
+
+	return TEST_RESULT("BonePaletteAllocatorTest");
+}
@@ -0,0 +1,263 @@
+// BonePalette : rigid palettes survive the trip through dual quaternions, a negated bone quaternion blends the
+// same, a 170 degree twist keeps the skin's volume where the linear blend collapses it, and BlendDualQuat
+// matches a transcription of CalcBoneMatrix in GpuSkinning.hlsl, in float and in double precision.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "TestUtil.h"
+#include "BonePalette.h"
+#include "MathUtil.h"
+
+// the transcription rounds every step on its own like the shader's precise math and BlendDualQuat
+#pragma STDC FP_CONTRACT OFF
+
+static XMFLOAT4 RandomQuat()
+{
+	XMFLOAT4 Q(RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f));
+	const float InvLength = 1.f / sqrtf(Q.x * Q.x + Q.y * Q.y + Q.z * Q.z + Q.w * Q.w);
+	return XMFLOAT4(Q.x * InvLength, Q.y * InvLength, Q.z * InvLength, Q.w * InvLength);
+}
+
+static BoneMatrix3x4 RigidMatrix(const XMFLOAT4& Q, const XMFLOAT3& T)
+{
+	const float x = Q.x, y = Q.y, z = Q.z, w = Q.w;
+	BoneMatrix3x4 M;
+	M.Row[0] = XMFLOAT4(1.f - 2.f * (y * y + z * z), 2.f * (x * y - w * z), 2.f * (x * z + w * y), T.x);
+	M.Row[1] = XMFLOAT4(2.f * (x * y + w * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z - w * x), T.y);
+	M.Row[2] = XMFLOAT4(2.f * (x * z - w * y), 2.f * (y * z + w * x), 1.f - 2.f * (x * x + y * y), T.z);
+	return M;
+}
+
+// largest difference of the rotation parts, and of the translations relative to their length
+static float GetMatrixError(const BoneMatrix3x4& A, const BoneMatrix3x4& B)
+{
+	const float Length = sqrtf(A.Row[0].w * A.Row[0].w + A.Row[1].w * A.Row[1].w + A.Row[2].w * A.Row[2].w);
+	float Error = 0.f;
+	for(int r=0;r<3;r++)
+	{
+		Error = Math::Max<float>(Error, fabsf(A.Row[r].x - B.Row[r].x));
+		Error = Math::Max<float>(Error, fabsf(A.Row[r].y - B.Row[r].y));
+		Error = Math::Max<float>(Error, fabsf(A.Row[r].z - B.Row[r].z));
+		Error = Math::Max<float>(Error, fabsf(A.Row[r].w - B.Row[r].w) / Math::Max<float>(Length, 1.f));
+	}
+	return Error;
+}
+
+// CalcBoneMatrix with DUALQUAT_SKINNING, line by line. Real is float or double
+template<typename Real>
+static void CalcBoneMatrix(const BoneDualQuat* Palette, const unsigned char* Bones, const float* Weights, Real OutMat[3][4])
+{
+	const Real Real0[4] = { Palette[Bones[0]].Real.x, Palette[Bones[0]].Real.y, Palette[Bones[0]].Real.z, Palette[Bones[0]].Real.w };
+	Real Q[4], D[4];
+	const float* FirstDual = &Palette[Bones[0]].Dual.x;
+	for(int c=0;c<4;c++)
+	{
+		Q[c] = Real0[c] * (Real)Weights[0];
+		D[c] = (Real)FirstDual[c] * (Real)Weights[0];
+	}
+
+	for(int i=1;i<4;i++)
+	{
+		const float* BoneReal = &Palette[Bones[i]].Real.x;
+		const float* BoneDual = &Palette[Bones[i]].Dual.x;
+		const Real Dot = Real0[0] * BoneReal[0] + Real0[1] * BoneReal[1] + Real0[2] * BoneReal[2] + Real0[3] * BoneReal[3];
+		const Real w = Dot < 0 ? -(Real)Weights[i] : (Real)Weights[i];
+		for(int c=0;c<4;c++)
+		{
+			Q[c] = Q[c] + (Real)BoneReal[c] * w;
+			D[c] = D[c] + (Real)BoneDual[c] * w;
+		}
+	}
+
+	const Real InvLength = (Real)1 / sqrt(Q[0] * Q[0] + Q[1] * Q[1] + Q[2] * Q[2] + Q[3] * Q[3]);
+	for(int c=0;c<4;c++)
+	{
+		Q[c] = Q[c] * InvLength;
+		D[c] = D[c] * InvLength;
+	}
+
+	const Real x = Q[0], y = Q[1], z = Q[2], w = Q[3];
+	const Real Cross[3] = { y * D[2] - z * D[1], z * D[0] - x * D[2], x * D[1] - y * D[0] };
+	Real t[3];
+	for(int c=0;c<3;c++)
+		t[c] = 2 * (w * D[c] - D[3] * Q[c] + Cross[c]);
+
+	const Real Mat[3][4] = {
+		{ 1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y), t[0] },
+		{ 2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x), t[1] },
+		{ 2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y), t[2] } };
+	memcpy(OutMat, Mat, sizeof(Mat));
+}
+
+// area of a ring of points around the x axis, projected on the yz plane
+static float GetRingArea(const std::vector<XMFLOAT3>& Ring)
+{
+	float Area = 0.f;
+	for(unsigned int i=0;i<Ring.size();i++)
+	{
+		const XMFLOAT3& A = Ring[i];
+		const XMFLOAT3& B = Ring[(i + 1) % Ring.size()];
+		Area += A.y * B.z - B.y * A.z;
+	}
+	return fabsf(Area) * 0.5f;
+}
+
+int main()
+{
+	srand(18);
+
+	const int BoneCount = 64;
+	std::vector<BoneMatrix3x4> Rigid(BoneCount);
+	std::vector<BoneDualQuat> DualQuat(BoneCount);
+	for(int i=0;i<BoneCount;i++)
+		Rigid[i] = RigidMatrix(RandomQuat(), XMFLOAT3(RandomFloat(-200.f, 200.f), RandomFloat(-200.f, 200.f), RandomFloat(-200.f, 200.f)));
+	BonePalette::ToDualQuat(&Rigid[0], BoneCount, &DualQuat[0]);
+
+	// rigid matrices come back, scaled ones come back without their scale
+	{
+		std::vector<BoneMatrix3x4> Back(BoneCount);
+		BonePalette::FromDualQuat(&DualQuat[0], BoneCount, &Back[0]);
+		float MaxError = 0.f;
+		for(int i=0;i<BoneCount;i++)
+			MaxError = Math::Max<float>(MaxError, GetMatrixError(Rigid[i], Back[i]));
+		printf("BonePalette : dual quaternion round trip error %.3g\n", MaxError);
+		TEST_CHECK(MaxError <= DUALQUAT_BLEND_TOLERANCE);
+
+		std::vector<BoneMatrix3x4> Scaled = Rigid;
+		for(int i=0;i<BoneCount;i++)
+		{
+			const float Scale[3] = { RandomFloat(0.5f, 2.f), RandomFloat(0.5f, 2.f), RandomFloat(0.5f, 2.f) };
+			for(int r=0;r<3;r++)
+			{
+				Scaled[i].Row[r].x *= Scale[0];
+				Scaled[i].Row[r].y *= Scale[1];
+				Scaled[i].Row[r].z *= Scale[2];
+			}
+		}
+		std::vector<BoneDualQuat> ScaledQuat(BoneCount);
+		BonePalette::ToDualQuat(&Scaled[0], BoneCount, &ScaledQuat[0]);
+		BonePalette::FromDualQuat(&ScaledQuat[0], BoneCount, &Back[0]);
+		MaxError = 0.f;
+		for(int i=0;i<BoneCount;i++)
+			MaxError = Math::Max<float>(MaxError, GetMatrixError(Rigid[i], Back[i]));
+		TEST_CHECK(MaxError <= DUALQUAT_BLEND_TOLERANCE);
+	}
+
+	// q and -q are the same rotation, the blend doesn't care which one a bone holds
+	{
+		int Mismatches = 0;
+		for(int v=0;v<10000;v++)
+		{
+			unsigned char Bones[4];
+			float Weights[4], WeightSum = 0.f;
+			for(int i=0;i<4;i++)
+			{
+				Bones[i] = (unsigned char)(rand() % BoneCount);
+				Weights[i] = RandomFloat(0.f, 1.f);
+				WeightSum += Weights[i];
+			}
+			for(int i=0;i<4;i++)
+				Weights[i] /= WeightSum;
+
+			BoneMatrix3x4 Reference, Negated;
+			BonePalette::BlendDualQuat(&DualQuat[0], Bones, Weights, Reference);
+			std::vector<BoneDualQuat> Flipped = DualQuat;
+			BoneDualQuat& Bone = Flipped[Bones[rand() % 4]];
+			Bone.Real = XMFLOAT4(-Bone.Real.x, -Bone.Real.y, -Bone.Real.z, -Bone.Real.w);
+			Bone.Dual = XMFLOAT4(-Bone.Dual.x, -Bone.Dual.y, -Bone.Dual.z, -Bone.Dual.w);
+			BonePalette::BlendDualQuat(&Flipped[0], Bones, Weights, Negated);
+			// negation is exact, so is the result
+			if(memcmp(&Reference, &Negated, sizeof(BoneMatrix3x4)) != 0)
+				Mismatches++;
+		}
+		TEST_CHECK(Mismatches == 0);
+	}
+
+	// a cylinder along x twisted 170 degrees between its two bones. dual quaternions keep every ring's area,
+	// the linear blend pinches the middle down to the candy wrapper
+	{
+		const float Pi = 3.14159265f, Angle = 170.f * Pi / 180.f;
+		BoneMatrix3x4 TwistPalette[2];
+		TwistPalette[0] = RigidMatrix(XMFLOAT4(0.f, 0.f, 0.f, 1.f), XMFLOAT3(0.f, 0.f, 0.f));
+		TwistPalette[1] = RigidMatrix(XMFLOAT4(sinf(Angle * 0.5f), 0.f, 0.f, cosf(Angle * 0.5f)), XMFLOAT3(0.f, 0.f, 0.f));
+		BoneDualQuat TwistQuat[2];
+		BonePalette::ToDualQuat(TwistPalette, 2, TwistQuat);
+
+		const float Radius = 5.f, RestArea = 0.5f * 64 * Radius * Radius * sinf(2.f * Pi / 64);
+		float MinDualQuatRatio = 1e9f, MaxDualQuatRatio = 0.f, MinLinearRatio = 1e9f;
+		for(int Ring=0;Ring<=10;Ring++)
+		{
+			const float Weight = Ring / 10.f;
+			const unsigned char Bones[4] = { 0, 1, 0, 0 };
+			const float Weights[4] = { 1.f - Weight, Weight, 0.f, 0.f };
+			BoneMatrix3x4 DualQuatMat, LinearMat;
+			BonePalette::BlendDualQuat(TwistQuat, Bones, Weights, DualQuatMat);
+			for(int r=0;r<3;r++)
+			{
+				const XMFLOAT4& A = TwistPalette[0].Row[r];
+				const XMFLOAT4& B = TwistPalette[1].Row[r];
+				LinearMat.Row[r] = XMFLOAT4(A.x * Weights[0] + B.x * Weights[1], A.y * Weights[0] + B.y * Weights[1], A.z * Weights[0] + B.z * Weights[1], A.w * Weights[0] + B.w * Weights[1]);
+			}
+
+			std::vector<XMFLOAT3> DualQuatRing, LinearRing;
+			for(int s=0;s<64;s++)
+			{
+				const XMFLOAT3 Pos(Ring * 2.f, cosf(2.f * Pi * s / 64) * Radius, sinf(2.f * Pi * s / 64) * Radius);
+				XMFLOAT3 OutPos, OutNormal;
+				BonePalette::SkinVertex(DualQuatMat, Pos, XMFLOAT3(0.f, 1.f, 0.f), OutPos, OutNormal);
+				DualQuatRing.push_back(OutPos);
+				BonePalette::SkinVertex(LinearMat, Pos, XMFLOAT3(0.f, 1.f, 0.f), OutPos, OutNormal);
+				LinearRing.push_back(OutPos);
+			}
+			MinDualQuatRatio = Math::Min<float>(MinDualQuatRatio, GetRingArea(DualQuatRing) / RestArea);
+			MaxDualQuatRatio = Math::Max<float>(MaxDualQuatRatio, GetRingArea(DualQuatRing) / RestArea);
+			MinLinearRatio = Math::Min<float>(MinLinearRatio, GetRingArea(LinearRing) / RestArea);
+		}
+		printf("BonePalette : 170 degree twist keeps %.4f - %.4f of the area with dual quaternions, %.4f linear\n", MinDualQuatRatio, MaxDualQuatRatio, MinLinearRatio);
+		TEST_CHECK(MinDualQuatRatio > 0.999f && MaxDualQuatRatio < 1.001f);
+		TEST_CHECK(MinLinearRatio < 0.01f);
+	}
+
+	// against the shader, the float transcription rounds the same way and the double one bounds the
+	// difference any gpu rounding of sqrt, divide and dot can make
+	{
+		int Mismatches = 0;
+		float MaxError = 0.f;
+		for(int v=0;v<100000;v++)
+		{
+			unsigned char Bones[4];
+			float Weights[4], WeightSum = 0.f;
+			const int Influences = 1 + rand() % 4;
+			for(int i=0;i<4;i++)
+			{
+				Bones[i] = (unsigned char)(rand() % BoneCount);
+				Weights[i] = i < Influences ? RandomFloat(0.f, 1.f) : 0.f;
+				WeightSum += Weights[i];
+			}
+			for(int i=0;i<4;i++)
+				Weights[i] = WeightSum > 0.f ? Weights[i] / WeightSum : 0.25f;
+
+			BoneMatrix3x4 Reference;
+			BonePalette::BlendDualQuat(&DualQuat[0], Bones, Weights, Reference);
+
+			float Shader[3][4];
+			CalcBoneMatrix<float>(&DualQuat[0], Bones, Weights, Shader);
+			if(memcmp(Shader, Reference.Row, sizeof(Shader)) != 0)
+				Mismatches++;
+
+			double Exact[3][4];
+			CalcBoneMatrix<double>(&DualQuat[0], Bones, Weights, Exact);
+			BoneMatrix3x4 ExactMat;
+			for(int r=0;r<3;r++)
+				ExactMat.Row[r] = XMFLOAT4((float)Exact[r][0], (float)Exact[r][1], (float)Exact[r][2], (float)Exact[r][3]);
+			MaxError = Math::Max<float>(MaxError, GetMatrixError(ExactMat, Reference));
+		}
+		printf("BonePalette : BlendDualQuat against CalcBoneMatrix, %d float mismatches, %.3g from double precision\n", Mismatches, MaxError);
+		TEST_CHECK(Mismatches == 0);
+		TEST_CHECK(MaxError <= DUALQUAT_BLEND_TOLERANCE);
+	}
+
+	return TEST_RESULT("BonePaletteTest");
+}
@@ -0,0 +1,343 @@
+// CookedMesh : a written file maps back with every blob as it went in, for 16 and 32 bit indices, and
+// truncated or corrupt files are turned down by Open or GetMesh instead of handing out ranges past the
+// mapping or indices past the vertices.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "TestUtil.h"
+#include "CookedMesh.h"
+
+#define TEST_COOKED_MESH_PATH	"CookedMeshTest.cmesh"
+
+// everything one mesh of the file points at
+struct TestMesh
+{
+	std::vector<XMFLOAT3>		Positions;
+	std::vector<uint16_t>		Indices16;
+	std::vector<uint32_t>		Indices32;
+	std::vector<CookedSubMesh>	SubMeshes;
+	std::vector<uint32_t>		SkinInfo;
+	std::vector<int32_t>		RequiredBones;
+	std::vector<uint32_t>		Clusters;	// CookedClusterRange and two more words per cluster
+	std::vector<CookedMeshLOD>	LODs;
+	std::vector<float>			OccluderVertices;
+	std::vector<uint32_t>		OccluderIndices;
+	CookedMeshDesc				Desc;
+};
+
+static void BuildTestMesh(int Rings, int Segments, bool bWideIndices, bool bSkinned, TestMesh& Mesh)
+{
+	std::vector<unsigned int> Indices;
+	BuildSphere(Rings, Segments, 2.f, Mesh.Positions, Indices);
+	const unsigned int TriangleCount = Indices.size() / 3;
+	if(bWideIndices)
+		Mesh.Indices32.assign(Indices.begin(), Indices.end());
+	else
+		Mesh.Indices16.assign(Indices.begin(), Indices.end());
+
+	// two submeshes splitting lod 0, each owning the clusters of its half
+	const unsigned int ClusterTriangles = 16;
+	const unsigned int HalfTriangles = TriangleCount / 2;
+	const unsigned int HalfEnds[] = { HalfTriangles, TriangleCount };
+	unsigned int HalfClusters = 0;
+	for(unsigned int Half=0, t=0;Half<2;Half++)
+	{
+		for(;t<HalfEnds[Half];t+=ClusterTriangles)
+		{
+			Mesh.Clusters.push_back(t * 3);
+			Mesh.Clusters.push_back(t + ClusterTriangles < HalfEnds[Half] ? ClusterTriangles : HalfEnds[Half] - t);
+			Mesh.Clusters.push_back(rand());
+			Mesh.Clusters.push_back(rand());
+		}
+		t = HalfEnds[Half];
+		if(Half == 0)
+			HalfClusters = Mesh.Clusters.size() / 4;
+	}
+	const unsigned int ClusterCount = Mesh.Clusters.size() / 4;
+
+	CookedSubMesh SubMesh;
+	memset(&SubMesh, 0, sizeof(SubMesh));
+	SubMesh.IndexOffset = 0;
+	SubMesh.TriangleCount = HalfTriangles;
+	SubMesh.ClusterOffset = 0;
+	SubMesh.ClusterCount = HalfClusters;
+	Mesh.SubMeshes.push_back(SubMesh);
+	SubMesh.IndexOffset = HalfTriangles * 3;
+	SubMesh.TriangleCount = TriangleCount - HalfTriangles;
+	SubMesh.ClusterOffset = HalfClusters;
+	SubMesh.ClusterCount = ClusterCount - HalfClusters;
+	Mesh.SubMeshes.push_back(SubMesh);
+
+	// lod 1 reuses the first rings, appended after lod 0
+	CookedMeshLOD LOD = { 0, TriangleCount, (uint32_t)Mesh.Positions.size(), 1.f, 0.f };
+	Mesh.LODs.push_back(LOD);
+	const unsigned int LODTriangles = Segments * 2;
+	for(unsigned int i=0;i<LODTriangles * 3;i++)
+	{
+		if(bWideIndices)
+			Mesh.Indices32.push_back(Indices[i]);
+		else
+			Mesh.Indices16.push_back(Indices[i]);
+	}
+	CookedMeshLOD LOD1 = { TriangleCount * 3, LODTriangles, (uint32_t)(Segments + 1) * 2, 0.25f, 0.1f };
+	Mesh.LODs.push_back(LOD1);
+
+	if(bSkinned)
+	{
+		for(unsigned int v=0;v<Mesh.Positions.size() * 2;v++)
+			Mesh.SkinInfo.push_back(rand());
+		for(int b=0;b<12;b++)
+			Mesh.RequiredBones.push_back(b * 3);
+	}
+
+	// a quad through the middle as the occluder
+	const float Quad[] = { -1.f, -1.f, 0.f, 1.f, -1.f, 0.f, 1.f, 1.f, 0.f, -1.f, 1.f, 0.f };
+	const uint32_t QuadIndices[] = { 0, 1, 2, 0, 2, 3 };
+	Mesh.OccluderVertices.assign(Quad, Quad + 12);
+	Mesh.OccluderIndices.assign(QuadIndices, QuadIndices + 6);
+
+	CookedMeshDesc& Desc = Mesh.Desc;
+	Desc.MeshType = bSkinned ? CookedMeshSkeletal : CookedMeshStatic;
+	Desc.VertexStride = sizeof(XMFLOAT3);
+	Desc.VertexCount = Mesh.Positions.size();
+	Desc.VertexData = &Mesh.Positions[0];
+	Desc.IndexStride = bWideIndices ? sizeof(uint32_t) : sizeof(uint16_t);
+	Desc.IndexCount = bWideIndices ? Mesh.Indices32.size() : Mesh.Indices16.size();
+	Desc.IndexData = bWideIndices ? (const void*)&Mesh.Indices32[0] : (const void*)&Mesh.Indices16[0];
+	Desc.NumTexCoord = 0;
+	Desc.SubMeshCount = Mesh.SubMeshes.size();
+	Desc.SubMeshes = &Mesh.SubMeshes[0];
+	if(bSkinned)
+	{
+		Desc.SkinInfoStride = 2 * sizeof(uint32_t);
+		Desc.SkinInfoCount = Mesh.Positions.size();
+		Desc.SkinInfo = &Mesh.SkinInfo[0];
+		Desc.RequiredBoneCount = Mesh.RequiredBones.size();
+		Desc.RequiredBones = &Mesh.RequiredBones[0];
+	}
+	Desc.ClusterStride = 4 * sizeof(uint32_t);
+	Desc.ClusterCount = ClusterCount;
+	Desc.Clusters = &Mesh.Clusters[0];
+	Desc.LODCount = Mesh.LODs.size();
+	Desc.LODs = &Mesh.LODs[0];
+	Desc.OccluderVertexCount = Mesh.OccluderVertices.size() / 3;
+	Desc.OccluderVertices = &Mesh.OccluderVertices[0];
+	Desc.OccluderIndexCount = Mesh.OccluderIndices.size();
+	Desc.OccluderIndices = &Mesh.OccluderIndices[0];
+	for(int i=0;i<3;i++)
+	{
+		Desc.BoundsMin[i] = -2.f;
+		Desc.BoundsMax[i] = 2.f;
+	}
+}
+
+static bool IsBlobEqual(const void* Mapped, const void* Source, size_t Size)
+{
+	if(Size == 0)
+		return true;
+	return Mapped && ((size_t)Mapped & (COOKED_MESH_ALIGNMENT - 1)) == 0 && memcmp(Mapped, Source, Size) == 0;
+}
+
+static void CheckView(const CookedMeshView& View, const CookedMeshDesc& Desc)
+{
+	const CookedMeshEntry& Entry = *View.Entry;
+	TEST_CHECK(Entry.MeshType == (uint32_t)Desc.MeshType);
+	TEST_CHECK(Entry.VertexCount == Desc.VertexCount && Entry.VertexStride == Desc.VertexStride);
+	TEST_CHECK(Entry.IndexCount == Desc.IndexCount && Entry.IndexStride == Desc.IndexStride);
+	TEST_CHECK(Entry.SubMeshCount == Desc.SubMeshCount && Entry.ClusterCount == Desc.ClusterCount && Entry.LODCount == Desc.LODCount);
+	TEST_CHECK(Entry.OccluderVertexCount == Desc.OccluderVertexCount && Entry.OccluderIndexCount == Desc.OccluderIndexCount);
+	TEST_CHECK(memcmp(Entry.BoundsMin, Desc.BoundsMin, sizeof(Entry.BoundsMin)) == 0 && memcmp(Entry.BoundsMax, Desc.BoundsMax, sizeof(Entry.BoundsMax)) == 0);
+	TEST_CHECK(IsBlobEqual(View.VertexData, Desc.VertexData, Desc.VertexCount * Desc.VertexStride));
+	TEST_CHECK(IsBlobEqual(View.IndexData, Desc.IndexData, Desc.IndexCount * Desc.IndexStride));
+	TEST_CHECK(IsBlobEqual(View.SubMeshes, Desc.SubMeshes, Desc.SubMeshCount * sizeof(CookedSubMesh)));
+	TEST_CHECK(IsBlobEqual(View.SkinInfo, Desc.SkinInfo, Desc.SkinInfoCount * Desc.SkinInfoStride));
+	TEST_CHECK(IsBlobEqual(View.RequiredBones, Desc.RequiredBones, Desc.RequiredBoneCount * sizeof(int32_t)));
+	TEST_CHECK(IsBlobEqual(View.Clusters, Desc.Clusters, Desc.ClusterCount * Desc.ClusterStride));
+	TEST_CHECK(IsBlobEqual(View.LODs, Desc.LODs, Desc.LODCount * sizeof(CookedMeshLOD)));
+	TEST_CHECK(IsBlobEqual(View.OccluderVertices, Desc.OccluderVertices, Desc.OccluderVertexCount * 3 * sizeof(float)));
+	TEST_CHECK(IsBlobEqual(View.OccluderIndices, Desc.OccluderIndices, Desc.OccluderIndexCount * sizeof(uint32_t)));
+}
+
+static bool ReadFileBytes(const char* Path, std::vector<unsigned char>& OutBytes)
+{
+	FILE* File = fopen(Path, "rb");
+	if(File == NULL)
+		return false;
+	fseek(File, 0, SEEK_END);
+	OutBytes.resize(ftell(File));
+	fseek(File, 0, SEEK_SET);
+	const bool bRead = fread(&OutBytes[0], 1, OutBytes.size(), File) == OutBytes.size();
+	fclose(File);
+	return bRead;
+}
+
+// true when the bytes fail to open or any mesh of them fails to load
+static bool IsRejected(const std::vector<unsigned char>& Bytes)
+{
+	if(!WriteWholeFile(TEST_COOKED_MESH_PATH, Bytes.empty() ? NULL : &Bytes[0], Bytes.size()))
+		return false;
+	CookedMeshFile File;
+	if(!File.Open(TEST_COOKED_MESH_PATH))
+		return true;
+	for(unsigned int i=0;i<File.GetMeshCount();i++)
+	{
+		CookedMeshView View;
+		if(!File.GetMesh(i, View))
+			return true;
+	}
+	return false;
+}
+
+static CookedMeshFileHeader& GetHeader(std::vector<unsigned char>& Bytes)
+{
+	return *(CookedMeshFileHeader*)&Bytes[0];
+}
+
+static CookedMeshEntry& GetEntry(std::vector<unsigned char>& Bytes, int Mesh)
+{
+	return ((CookedMeshEntry*)&Bytes[GetHeader(Bytes).MeshTableOffset])[Mesh];
+}
+
+int main()
+{
+	srand(1);
+
+	TestMesh Meshes[2];
+	BuildTestMesh(6, 8, false, false, Meshes[0]);
+	BuildTestMesh(260, 260, true, true, Meshes[1]);
+	TEST_CHECK(Meshes[1].Positions.size() > 65535);
+
+	CookedMeshWriter Writer;
+	Writer.AddMesh(Meshes[0].Desc);
+	Writer.AddMesh(Meshes[1].Desc);
+	TEST_CHECK(Writer.GetMeshCount() == 2);
+	TEST_CHECK(Writer.Save(TEST_COOKED_MESH_PATH));
+
+	// every blob maps back aligned and as written
+	{
+		const double Start = GetMilliseconds();
+		CookedMeshFile File;
+		TEST_CHECK(File.Open(TEST_COOKED_MESH_PATH));
+		TEST_CHECK(File.GetMeshCount() == 2);
+		CookedMeshView Views[2];
+		for(int i=0;i<2;i++)
+			TEST_CHECK(File.GetMesh(i, Views[i]));
+		const double Elapsed = GetMilliseconds() - Start;
+		for(int i=0;i<2 && File.GetMeshCount() == 2;i++)
+			CheckView(Views[i], Meshes[i].Desc);
+		CookedMeshView View;
+		TEST_CHECK(!File.GetMesh(2, View));
+		printf("CookedMesh : opened and validated %d + %d vertices in %.3f ms\n", Meshes[0].Desc.VertexCount, Meshes[1].Desc.VertexCount, Elapsed);
+	}
+
+	std::vector<unsigned char> Original;
+	TEST_CHECK(ReadFileBytes(TEST_COOKED_MESH_PATH, Original));
+	TEST_CHECK(Original.size() == GetHeader(Original).FileSize);
+	TEST_CHECK(!IsRejected(Original));
+
+	// truncated files, with and without the header's size following the cut
+	{
+		const size_t Sizes[] = { 0, 1, sizeof(CookedMeshFileHeader) - 1, sizeof(CookedMeshFileHeader), sizeof(CookedMeshFileHeader) + sizeof(CookedMeshEntry), Original.size() / 2, Original.size() - 1 };
+		for(int i=0;i<(int)(sizeof(Sizes) / sizeof(Sizes[0]));i++)
+		{
+			std::vector<unsigned char> Bytes(Original.begin(), Original.begin() + Sizes[i]);
+			TEST_CHECK(IsRejected(Bytes));
+			if(Bytes.size() >= sizeof(CookedMeshFileHeader))
+			{
+				GetHeader(Bytes).FileSize = Bytes.size();
+				TEST_CHECK(IsRejected(Bytes));
+			}
+		}
+	}
+
+	// corrupt headers
+	{
+		std::vector<unsigned char> Bytes = Original;
+		GetHeader(Bytes).Magic ^= 1;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		GetHeader(Bytes).Version = COOKED_MESH_VERSION - 1;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		GetHeader(Bytes).EndianTag = 0x04030201;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		GetHeader(Bytes).FileSize += 16;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		GetHeader(Bytes).MeshCount = 0x10000000;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		GetHeader(Bytes).MeshTableOffset = Original.size() - sizeof(CookedMeshEntry);
+		TEST_CHECK(IsRejected(Bytes));
+	}
+
+	// corrupt entries and blobs, in both meshes
+	for(int m=0;m<2;m++)
+	{
+		std::vector<unsigned char> Bytes = Original;
+		const CookedMeshEntry Entry = GetEntry(Original, m);
+
+		// blobs past the end of the file, or counts that carry them past it
+		GetEntry(Bytes, m).VertexDataOffset = Original.size() - 8;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		GetEntry(Bytes, m).IndexDataOffset = 0xFFFFFFFFFFFFFFF0ull;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		GetEntry(Bytes, m).VertexCount = 0xFFFFFFFF;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		GetEntry(Bytes, m).OccluderVertexCount = 0x7FFFFFFF;
+		TEST_CHECK(IsRejected(Bytes));
+
+		// an index past the vertices
+		Bytes = Original;
+		if(Entry.IndexStride == sizeof(uint16_t))
+			((uint16_t*)&Bytes[Entry.IndexDataOffset])[Entry.IndexCount - 1] = (uint16_t)Entry.VertexCount;
+		else
+			((uint32_t*)&Bytes[Entry.IndexDataOffset])[Entry.IndexCount - 1] = Entry.VertexCount;
+		TEST_CHECK(IsRejected(Bytes));
+
+		// an occluder index past the occluder's own vertices
+		Bytes = Original;
+		((uint32_t*)&Bytes[Entry.OccluderIndexOffset])[2] = Entry.OccluderVertexCount;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		GetEntry(Bytes, m).OccluderIndexCount = Entry.OccluderIndexCount - 1;
+		TEST_CHECK(IsRejected(Bytes));
+
+		// submesh, cluster and lod ranges past what they index
+		Bytes = Original;
+		((CookedSubMesh*)&Bytes[Entry.SubMeshOffset])[1].TriangleCount = Entry.IndexCount / 3;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		((CookedSubMesh*)&Bytes[Entry.SubMeshOffset])[0].ClusterCount = Entry.ClusterCount + 1;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		((CookedClusterRange*)&Bytes[Entry.ClusterOffset + (uint64_t)(Entry.ClusterCount - 1) * Entry.ClusterStride])->TriangleCount = Entry.IndexCount / 3;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		GetEntry(Bytes, m).ClusterStride = sizeof(CookedClusterRange) - 4;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		((CookedMeshLOD*)&Bytes[Entry.LODOffset])[1].IndexOffset = Entry.IndexCount - 3;
+		TEST_CHECK(IsRejected(Bytes));
+		Bytes = Original;
+		((CookedMeshLOD*)&Bytes[Entry.LODOffset])[1].VertexCount = Entry.VertexCount + 1;
+		TEST_CHECK(IsRejected(Bytes));
+
+		// a negative joint
+		if(Entry.RequiredBoneCount > 0)
+		{
+			Bytes = Original;
+			((int32_t*)&Bytes[Entry.RequiredBoneOffset])[0] = -1;
+			TEST_CHECK(IsRejected(Bytes));
+		}
+	}
+
+	remove(TEST_COOKED_MESH_PATH);
+	return TEST_RESULT("CookedMeshTest");
+}
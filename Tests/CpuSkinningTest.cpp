@@ -0,0 +1,235 @@
+// CpuSkinning : the cpu pre-skinning kernel writes what PreSkin.fx writes, checked against a scalar transcription
+// of CalcBoneMatrix, SkinPosition and SkinNormal in GpuSkinning.hlsl for linear and dual quaternion palettes, and
+// the chunks PreSkinner splits a mesh into, the last one partial, skin the same vertices as one call.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "TestUtil.h"
+#include "CpuSkinning.h"
+#include "ParallelFor.h"
+#include "MathUtil.h"
+
+// the shader's math is precise, rounded step by step
+#pragma STDC FP_CONTRACT OFF
+
+// positions within 1.2e-5 at a 50 unit scale, relative to the skinned position's distance from the origin.
+// normals and texcoords match exactly
+#define SKINNING_POSITION_TOLERANCE	(1.2e-5f / 50.f)
+
+static XMFLOAT4 RandomQuat()
+{
+	XMFLOAT4 Q(RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f));
+	const float InvLength = 1.f / sqrtf(Q.x * Q.x + Q.y * Q.y + Q.z * Q.z + Q.w * Q.w);
+	return XMFLOAT4(Q.x * InvLength, Q.y * InvLength, Q.z * InvLength, Q.w * InvLength);
+}
+
+// rotation, per axis scale and translation as a palette 3x4
+static BoneMatrix3x4 RandomBone(float MaxScale)
+{
+	const XMFLOAT4 Q = RandomQuat();
+	const float x = Q.x, y = Q.y, z = Q.z, w = Q.w;
+	const float S[3] = { RandomFloat(1.f, MaxScale), RandomFloat(1.f, MaxScale), RandomFloat(1.f, MaxScale) };
+	const float R[3][3] = {
+		{ 1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y) },
+		{ 2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x) },
+		{ 2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y) } };
+	BoneMatrix3x4 Out;
+	for(int r=0;r<3;r++)
+		Out.Row[r] = XMFLOAT4(R[r][0] * S[0], R[r][1] * S[1], R[r][2] * S[2], RandomFloat(-20.f, 20.f));
+	return Out;
+}
+
+// unorm8 weights the way SkeletalMesh::BuildSkinSource decodes them, one to four influences
+static SkinSourceVertex RandomVertex(int BoneCount)
+{
+	SkinSourceVertex Vertex;
+	Vertex.Position = XMFLOAT3(RandomFloat(-50.f, 50.f), RandomFloat(-50.f, 50.f), RandomFloat(-50.f, 50.f));
+	XMFLOAT3 N(RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f) + 2.f);
+	const float InvLength = 1.f / sqrtf(N.x * N.x + N.y * N.y + N.z * N.z);
+	Vertex.Normal = XMFLOAT3(N.x * InvLength, N.y * InvLength, N.z * InvLength);
+	Vertex.TexCoord = XMFLOAT2(RandomFloat(0.f, 1.f), RandomFloat(0.f, 1.f));
+
+	const int Influences = 1 + rand() % MAX_BONELINK;
+	int Left = 255;
+	for(int k=0;k<MAX_BONELINK;k++)
+	{
+		const int Quantized = k >= Influences ? 0 : k == Influences - 1 ? Left : rand() % (Left + 1);
+		Left -= Quantized;
+		Vertex.Weights[k] = (float)Quantized / 255.f;
+		Vertex.Bones[k] = (unsigned char)(rand() % BoneCount);
+	}
+	return Vertex;
+}
+
+// CalcBoneMatrix of GpuSkinning.hlsl, the two variants
+static void CalcBoneMatrix(const SkinSourceVertex& Vertex, const BoneMatrix3x4* Palette, const BoneDualQuat* DualQuats, ESkinningMode Mode, float OutMat[3][4])
+{
+	if(Mode == SKIN_LINEAR)
+	{
+		for(int r=0;r<3;r++)
+			for(int c=0;c<4;c++)
+				OutMat[r][c] = 0.f;
+		for(int i=0;i<MAX_BONELINK;i++)
+		{
+			const float* Bone = &Palette[Vertex.Bones[i]].Row[0].x;
+			for(int r=0;r<3;r++)
+				for(int c=0;c<4;c++)
+					OutMat[r][c] = OutMat[r][c] + Bone[r * 4 + c] * Vertex.Weights[i];
+		}
+		return;
+	}
+
+	const float* Real0 = &DualQuats[Vertex.Bones[0]].Real.x;
+	float Real[4], Dual[4];
+	for(int c=0;c<4;c++)
+	{
+		Real[c] = Real0[c] * Vertex.Weights[0];
+		Dual[c] = (&DualQuats[Vertex.Bones[0]].Dual.x)[c] * Vertex.Weights[0];
+	}
+	for(int i=1;i<MAX_BONELINK;i++)
+	{
+		const float* BoneReal = &DualQuats[Vertex.Bones[i]].Real.x;
+		const float* BoneDual = &DualQuats[Vertex.Bones[i]].Dual.x;
+		const float Dot = Real0[0] * BoneReal[0] + Real0[1] * BoneReal[1] + Real0[2] * BoneReal[2] + Real0[3] * BoneReal[3];
+		const float w = Dot < 0 ? -Vertex.Weights[i] : Vertex.Weights[i];
+		for(int c=0;c<4;c++)
+		{
+			Real[c] = Real[c] + BoneReal[c] * w;
+			Dual[c] = Dual[c] + BoneDual[c] * w;
+		}
+	}
+	const float InvLength = 1.f / sqrtf(Real[0] * Real[0] + Real[1] * Real[1] + Real[2] * Real[2] + Real[3] * Real[3]);
+	for(int c=0;c<4;c++)
+	{
+		Real[c] = Real[c] * InvLength;
+		Dual[c] = Dual[c] * InvLength;
+	}
+
+	const float x = Real[0], y = Real[1], z = Real[2], w = Real[3];
+	const float Cross[3] = { y * Dual[2] - z * Dual[1], z * Dual[0] - x * Dual[2], x * Dual[1] - y * Dual[0] };
+	float t[3];
+	for(int c=0;c<3;c++)
+		t[c] = 2.f * (w * Dual[c] - Dual[3] * Real[c] + Cross[c]);
+	const float Mat[3][4] = {
+		{ 1.f - 2.f * (y * y + z * z), 2.f * (x * y - w * z), 2.f * (x * z + w * y), t[0] },
+		{ 2.f * (x * y + w * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z - w * x), t[1] },
+		{ 2.f * (x * z - w * y), 2.f * (y * z + w * x), 1.f - 2.f * (x * x + y * y), t[2] } };
+	memcpy(OutMat, Mat, sizeof(Mat));
+}
+
+// the PreSkin.fx vertex shader: SkinPosition, normalize(SkinNormal), texcoord passed through
+static NormalTexVertex SkinReference(const SkinSourceVertex& Vertex, const BoneMatrix3x4* Palette, const BoneDualQuat* DualQuats, ESkinningMode Mode)
+{
+	float M[3][4];
+	CalcBoneMatrix(Vertex, Palette, DualQuats, Mode, M);
+	const XMFLOAT3& P = Vertex.Position;
+	const XMFLOAT3& N = Vertex.Normal;
+	float Pos[3], Norm[3];
+	for(int r=0;r<3;r++)
+	{
+		Pos[r] = M[r][0] * P.x + M[r][1] * P.y + M[r][2] * P.z + M[r][3];
+		Norm[r] = M[r][0] * N.x + M[r][1] * N.y + M[r][2] * N.z;
+	}
+	const float Length = sqrtf(Norm[0] * Norm[0] + Norm[1] * Norm[1] + Norm[2] * Norm[2]);
+	NormalTexVertex Out;
+	Out.Position = XMFLOAT3(Pos[0], Pos[1], Pos[2]);
+	Out.Normal = XMFLOAT3(Norm[0] / Length, Norm[1] / Length, Norm[2] / Length);
+	Out.TexCoord = Vertex.TexCoord;
+	return Out;
+}
+
+static float GetDistance(const XMFLOAT3& A, const XMFLOAT3& B)
+{
+	return sqrtf((A.x - B.x) * (A.x - B.x) + (A.y - B.y) * (A.y - B.y) + (A.z - B.z) * (A.z - B.z));
+}
+
+// the kernel on PRESKIN_CPU_CHUNK sized tasks the way PreSkinner::SkinCpu splits a mesh
+static void SkinChunked(const std::vector<SkinSourceVertex>& Source, const XMFLOAT4X4* Columns, const BoneDualQuat* DualQuats,
+	ESkinningMode Mode, bool bTexCoord, unsigned char* OutVertices)
+{
+	const int Count = (int)Source.size();
+	const int Stride = bTexCoord ? sizeof(NormalTexVertex) : sizeof(NormalVertex);
+	const int ChunkCount = (Count + PRESKIN_CPU_CHUNK - 1) / PRESKIN_CPU_CHUNK;
+	ParallelFor(0, ChunkCount, [&](int c)
+	{
+		const int v = c * PRESKIN_CPU_CHUNK;
+		const int ChunkSize = Count - v < PRESKIN_CPU_CHUNK ? Count - v : PRESKIN_CPU_CHUNK;
+		CpuSkinning::SkinVertices(&Source[v], ChunkSize, Columns, DualQuats, Mode, bTexCoord, OutVertices + v * Stride);
+	});
+}
+
+int main()
+{
+	srand(19);
+
+	const int BoneCount = 20, VertexCount = 5000;
+	for(int m=0;m<2;m++)
+	{
+		const ESkinningMode Mode = m == 0 ? SKIN_LINEAR : SKIN_DUALQUAT;
+		// dual quaternions drop scale, their palettes come from rigid bones like BonePalette::ToDualQuat gives them
+		std::vector<BoneMatrix3x4> Palette(BoneCount);
+		for(int b=0;b<BoneCount;b++)
+			Palette[b] = RandomBone(Mode == SKIN_LINEAR ? 1.5f : 1.f);
+		std::vector<BoneDualQuat> DualQuats(BoneCount);
+		BonePalette::ToDualQuat(&Palette[0], BoneCount, &DualQuats[0]);
+		std::vector<XMFLOAT4X4> Columns(BoneCount);
+		for(int b=0;b<BoneCount;b++)
+			CpuSkinning::ToColumns(Palette[b], Columns[b]);
+
+		std::vector<SkinSourceVertex> Source;
+		for(int v=0;v<VertexCount;v++)
+			Source.push_back(RandomVertex(BoneCount));
+
+		// against the shader, with and without texcoords
+		for(int t=0;t<2;t++)
+		{
+			const bool bTexCoord = t == 1;
+			std::vector<NormalTexVertex> TexOut(VertexCount);
+			std::vector<NormalVertex> Out(VertexCount);
+			CpuSkinning::SkinVertices(&Source[0], VertexCount, &Columns[0], &DualQuats[0], Mode, bTexCoord, bTexCoord ? (void*)&TexOut[0] : (void*)&Out[0]);
+
+			float MaxPositionError = 0.f, MaxNormalError = 0.f;
+			int TexCoordMismatches = 0;
+			for(int v=0;v<VertexCount;v++)
+			{
+				const NormalTexVertex Reference = SkinReference(Source[v], &Palette[0], &DualQuats[0], Mode);
+				const XMFLOAT3& Position = bTexCoord ? TexOut[v].Position : Out[v].Position;
+				const XMFLOAT3& Normal = bTexCoord ? TexOut[v].Normal : Out[v].Normal;
+				const float Scale = Math::Max<float>(1.f, sqrtf(Reference.Position.x * Reference.Position.x + Reference.Position.y * Reference.Position.y + Reference.Position.z * Reference.Position.z));
+				MaxPositionError = Math::Max<float>(MaxPositionError, GetDistance(Position, Reference.Position) / Scale);
+				MaxNormalError = Math::Max<float>(MaxNormalError, GetDistance(Normal, Reference.Normal));
+				if(bTexCoord && memcmp(&TexOut[v].TexCoord, &Reference.TexCoord, sizeof(XMFLOAT2)) != 0)
+					TexCoordMismatches++;
+			}
+			printf("CpuSkinning : %s%s, %d vertices, relative position error %.3g, normal error %.3g\n", Mode == SKIN_LINEAR ? "linear" : "dual quaternion",
+				bTexCoord ? " with texcoords" : "", VertexCount, MaxPositionError, MaxNormalError);
+			TEST_CHECK(MaxPositionError <= SKINNING_POSITION_TOLERANCE);
+			TEST_CHECK(MaxNormalError == 0.f);
+			TEST_CHECK(TexCoordMismatches == 0);
+		}
+
+		// whole and partial chunks skin what one call does, and nothing past the last vertex
+		const int Counts[] = { 1, 7, PRESKIN_CPU_CHUNK - 1, PRESKIN_CPU_CHUNK, PRESKIN_CPU_CHUNK + 1, 3 * PRESKIN_CPU_CHUNK + 17, VertexCount };
+		for(int c=0;c<(int)(sizeof(Counts) / sizeof(Counts[0]));c++)
+		{
+			const std::vector<SkinSourceVertex> Part(Source.begin(), Source.begin() + Counts[c]);
+			for(int t=0;t<2;t++)
+			{
+				const bool bTexCoord = t == 1;
+				const int Size = Counts[c] * (bTexCoord ? sizeof(NormalTexVertex) : sizeof(NormalVertex));
+				std::vector<unsigned char> Whole(Size), Chunked(Size + 64, 0xcd);
+				CpuSkinning::SkinVertices(&Part[0], Counts[c], &Columns[0], &DualQuats[0], Mode, bTexCoord, &Whole[0]);
+				SkinChunked(Part, &Columns[0], &DualQuats[0], Mode, bTexCoord, &Chunked[0]);
+				TEST_CHECK(memcmp(&Whole[0], &Chunked[0], Size) == 0);
+				int Overwritten = 0;
+				for(int i=Size;i<Size + 64;i++)
+					Overwritten += Chunked[i] != 0xcd;
+				TEST_CHECK(Overwritten == 0);
+			}
+		}
+	}
+
+	return TEST_RESULT("CpuSkinningTest");
+}
@@ -0,0 +1,92 @@
+// FrustumCuller : the sse and avx paths give the same answer as the scalar one for every box, at any
+// start and remainder, and a box with a point inside the frustum is never culled.
+
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "TestUtil.h"
+#include "FrustumCuller.h"
+
+static bool IsPointInFrustum(const XMMATRIX& ViewProjection, const XMFLOAT3& P)
+{
+	const XMVECTOR Clip = XMVector3Transform(XMLoadFloat3(&P), ViewProjection);
+	const float x = XMVectorGetX(Clip), y = XMVectorGetY(Clip), z = XMVectorGetZ(Clip), w = XMVectorGetW(Clip);
+	return x >= -w && x <= w && y >= -w && y <= w && z >= 0.f && z <= w;
+}
+
+int main()
+{
+	srand(21);
+
+	for(int Frustum=0;Frustum<8;Frustum++)
+	{
+		const XMVECTOR Eye = XMVectorSet(RandomFloat(-50.f, 50.f), RandomFloat(-50.f, 50.f), RandomFloat(-50.f, 50.f), 1.f);
+		const XMVECTOR At = XMVectorSet(RandomFloat(-50.f, 50.f), RandomFloat(-50.f, 50.f), RandomFloat(-50.f, 50.f), 1.f);
+		const XMMATRIX View = XMMatrixLookAtLH(Eye, At, XMVectorSet(0.f, 1.f, 0.f, 0.f));
+		const XMMATRIX Projection = XMMatrixPerspectiveFovLH(RandomFloat(0.5f, 1.5f), RandomFloat(1.f, 2.f), 1.f, RandomFloat(60.f, 200.f));
+		const XMMATRIX ViewProjection = XMMatrixMultiply(View, Projection);
+
+		FrustumCuller Culler;
+		Culler.SetViewProjection(ViewProjection);
+
+		AABBSoaArray Bounds;
+		for(int i=0;i<1003;i++)
+		{
+			const XMFLOAT3 Center(RandomFloat(-150.f, 150.f), RandomFloat(-150.f, 150.f), RandomFloat(-150.f, 150.f));
+			const XMFLOAT3 Extent(RandomFloat(0.f, 15.f), RandomFloat(0.f, 15.f), RandomFloat(0.f, 15.f));
+			Bounds.Add(XMFLOAT3(Center.x - Extent.x, Center.y - Extent.y, Center.z - Extent.z), XMFLOAT3(Center.x + Extent.x, Center.y + Extent.y, Center.z + Extent.z));
+		}
+
+		// starts and counts that leave every possible remainder for the vector paths
+		for(int Begin=0;Begin<9;Begin++)
+		{
+			const int Count = Bounds._Count - Begin - Frustum;
+			std::vector<unsigned char> Visible[FRUSTUM_CULL_AVX8 + 1];
+			int VisibleCount[FRUSTUM_CULL_AVX8 + 1];
+			for(int Simd=FRUSTUM_CULL_SCALAR;Simd<=FrustumCuller::GetBestSimd();Simd++)
+			{
+				Visible[Simd].assign(Count, 2);
+				VisibleCount[Simd] = Culler.Cull(Bounds, Begin, Count, &Visible[Simd][0], (EFrustumCullSimd)Simd);
+				TEST_CHECK(VisibleCount[Simd] == VisibleCount[FRUSTUM_CULL_SCALAR]);
+				for(int i=0;i<Count;i++)
+					TEST_CHECK(Visible[Simd][i] == Visible[FRUSTUM_CULL_SCALAR][i]);
+			}
+
+			for(int i=0;i<Count;i++)
+			{
+				const int Box = Begin + i;
+				const XMFLOAT3 Min(Bounds._MinX[Box], Bounds._MinY[Box], Bounds._MinZ[Box]);
+				const XMFLOAT3 Max(Bounds._MaxX[Box], Bounds._MaxY[Box], Bounds._MaxZ[Box]);
+				TEST_CHECK(Culler.IsBoxVisible(Min, Max) == (Visible[FRUSTUM_CULL_SCALAR][i] == 1));
+			}
+		}
+
+		// conservative, sample every box and any point inside the frustum keeps it
+		std::vector<unsigned char> Visible(Bounds._Count);
+		Culler.Cull(Bounds, 0, Bounds._Count, &Visible[0]);
+		int InsideCount = 0;
+		for(int Box=0;Box<Bounds._Count;Box++)
+		{
+			for(int s=0;s<64;s++)
+			{
+				const XMFLOAT3 P(RandomFloat(Bounds._MinX[Box], Bounds._MaxX[Box]), RandomFloat(Bounds._MinY[Box], Bounds._MaxY[Box]), RandomFloat(Bounds._MinZ[Box], Bounds._MaxZ[Box]));
+				if(IsPointInFrustum(ViewProjection, P))
+				{
+					InsideCount++;
+					TEST_CHECK(Visible[Box] == 1);
+					break;
+				}
+			}
+		}
+		TEST_CHECK(InsideCount > 0 && InsideCount < Bounds._Count);
+	}
+
+	// a box behind the camera and one past the far plane are culled, one in front is kept
+	FrustumCuller Culler;
+	Culler.SetViewProjection(XMMatrixPerspectiveFovLH(1.57f, 1.f, 1.f, 100.f));
+	TEST_CHECK(Culler.IsBoxVisible(XMFLOAT3(-1.f, -1.f, 10.f), XMFLOAT3(1.f, 1.f, 12.f)));
+	TEST_CHECK(!Culler.IsBoxVisible(XMFLOAT3(-1.f, -1.f, -5.f), XMFLOAT3(1.f, 1.f, -2.f)));
+	TEST_CHECK(!Culler.IsBoxVisible(XMFLOAT3(-1.f, -1.f, 150.f), XMFLOAT3(1.f, 1.f, 160.f)));
+
+	return TEST_RESULT("FrustumCullerTest");
+}
@@ -0,0 +1,119 @@
+// LightClusterBuilder : every cluster lists exactly the lights whose sphere touches its box, the sse and avx
+// paths build the same lists as the scalar one, and a point lit by a light finds it in its cluster the way
+// the resolve shader looks it up. also times every path.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "TestUtil.h"
+#include "LightClusterBuilder.h"
+#include "MathUtil.h"
+
+// the lights of one cluster by testing all of them
+static void GetClusterLightsBruteForce(const LightClusterBuilder& Builder, int Cluster, std::vector<unsigned int>& OutLights)
+{
+	const AABBSoaArray& Bounds = Builder._ClusterBounds;
+	OutLights.clear();
+	for(unsigned int l=0;l<Builder._LightArray.size();l++)
+	{
+		const XMFLOAT4& Sphere = Builder._LightArray[l].PositionRange;
+		const float DX = Math::Max<float>(Math::Max<float>(Bounds._MinX[Cluster] - Sphere.x, 0.f), Sphere.x - Bounds._MaxX[Cluster]);
+		const float DY = Math::Max<float>(Math::Max<float>(Bounds._MinY[Cluster] - Sphere.y, 0.f), Sphere.y - Bounds._MaxY[Cluster]);
+		const float DZ = Math::Max<float>(Math::Max<float>(Bounds._MinZ[Cluster] - Sphere.z, 0.f), Sphere.z - Bounds._MaxZ[Cluster]);
+		if(DX * DX + DY * DY + DZ * DZ <= Sphere.w * Sphere.w)
+			OutLights.push_back(l);
+	}
+}
+
+int main()
+{
+	srand(25);
+
+	// right handed perspective as the camera builds it, view space looks down -z
+	const float Near = 1.f, Far = 10000.f;
+	const float Proj22 = 1.f / tanf(0.785f * 0.5f), Proj11 = Proj22 / 1.6f;
+	XMFLOAT4X4 P;
+	memset(&P, 0, sizeof(P));
+	P._11 = Proj11;
+	P._22 = Proj22;
+	P._33 = Far / (Near - Far);
+	P._34 = -1.f;
+	P._43 = Near * Far / (Near - Far);
+
+	LightClusterBuilder Builder;
+	Builder.SetProjection(XMLoadFloat4x4(&P), Near, Far);
+
+	const int LightCounts[] = { 3, 1000, 4096, LIGHT_CLUSTER_MAX_LIGHTS };
+	for(int c=0;c<4;c++)
+	{
+		Builder.BeginFrame(XMMatrixTranslation(RandomFloat(-50.f, 50.f), RandomFloat(-50.f, 50.f), RandomFloat(-50.f, 50.f)));
+		for(int i=0;i<LightCounts[c];i++)
+		{
+			const XMFLOAT3 Position(RandomFloat(-1500.f, 1500.f), RandomFloat(-750.f, 750.f), RandomFloat(-3800.f, 200.f));
+			TEST_CHECK(Builder.AddPointLight(Position, RandomFloat(20.f, 220.f), XMFLOAT4(1.f, 1.f, 1.f, 1.f)) == i);
+		}
+		TEST_CHECK(Builder.AddPointLight(XMFLOAT3(0.f, 0.f, -10.f), 10.f, XMFLOAT4(1.f, 1.f, 1.f, 1.f)) == (LightCounts[c] < LIGHT_CLUSTER_MAX_LIGHTS ? LightCounts[c] : -1));
+
+		std::vector<unsigned int> ReferenceClusters, ReferenceIndices;
+		for(int Simd=LIGHT_CLUSTER_SCALAR;Simd<=LightClusterBuilder::GetBestSimd();Simd++)
+		{
+			double Best = 1e9;
+			for(int Run=0;Run<5;Run++)
+			{
+				const double Start = GetMilliseconds();
+				Builder.Build((ELightClusterSimd)Simd);
+				Best = Math::Min<double>(Best, GetMilliseconds() - Start);
+			}
+			printf("LightClusterBuilder : simd %d, %d lights to %d indices over %d clusters in %.3f ms\n", Simd, Builder._Stats.LightCount, Builder._Stats.IndexCount, Builder._Stats.LitClusterCount, Best);
+			TEST_CHECK(Builder._Stats.OverflowCount == 0);
+
+			if(Simd == LIGHT_CLUSTER_SCALAR)
+			{
+				ReferenceClusters = Builder._ClusterArray;
+				ReferenceIndices = Builder._IndexArray;
+				continue;
+			}
+			TEST_CHECK(Builder._ClusterArray == ReferenceClusters);
+			TEST_CHECK(Builder._IndexArray == ReferenceIndices);
+		}
+
+		// packed back to back, and each list is the brute force one
+		std::vector<unsigned int> Lights;
+		unsigned int NextOffset = 0;
+		for(int Cluster=0;Cluster<LIGHT_CLUSTER_COUNT;Cluster++)
+		{
+			TEST_CHECK(Builder._ClusterArray[Cluster * 2] == NextOffset);
+			NextOffset += Builder.GetClusterLightCount(Cluster);
+			GetClusterLightsBruteForce(Builder, Cluster, Lights);
+			TEST_CHECK((int)Lights.size() == Builder.GetClusterLightCount(Cluster));
+			if((int)Lights.size() == Builder.GetClusterLightCount(Cluster) && Lights.size() > 0)
+				TEST_CHECK(std::equal(Lights.begin(), Lights.end(), Builder.GetClusterLights(Cluster)));
+		}
+		TEST_CHECK(NextOffset == Builder._IndexArray.size());
+
+		// points of the view found through the shader's tile and slice math keep every light that reaches them
+		const int PointCount = LightCounts[c] > 4096 ? 2000 : 20000;
+		for(int i=0;i<PointCount;i++)
+		{
+			const float SX = RandomFloat(0.f, 1.f), SY = RandomFloat(0.f, 1.f);
+			const float Depth = Near * powf(Far / Near, RandomFloat(0.f, 1.f));
+			const XMFLOAT3 View((SX * 2.f - 1.f) * Depth / Proj11, (1.f - SY * 2.f) * Depth / Proj22, -Depth);
+			const int X = Math::Min<int>((int)(SX * LIGHT_CLUSTER_X), LIGHT_CLUSTER_X - 1);
+			const int Y = Math::Min<int>((int)(SY * LIGHT_CLUSTER_Y), LIGHT_CLUSTER_Y - 1);
+			const int Cluster = Builder.GetClusterIndex(X, Y, Builder.GetSlice(Depth));
+			const unsigned int* ClusterLights = Builder.GetClusterLights(Cluster);
+			const int Count = Builder.GetClusterLightCount(Cluster);
+			for(unsigned int l=0;l<Builder._LightArray.size();l++)
+			{
+				const XMFLOAT4& Sphere = Builder._LightArray[l].PositionRange;
+				const float DistanceSq = (Sphere.x - View.x) * (Sphere.x - View.x) + (Sphere.y - View.y) * (Sphere.y - View.y) + (Sphere.z - View.z) * (Sphere.z - View.z);
+				if(DistanceSq < Sphere.w * Sphere.w * 0.999f)
+					TEST_CHECK(Count > 0 && std::binary_search(ClusterLights, ClusterLights + Count, l));
+			}
+		}
+	}
+
+	return TEST_RESULT("LightClusterBuilderTest");
+}
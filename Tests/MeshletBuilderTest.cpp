@@ -0,0 +1,146 @@
+// MeshletBuilder : every triangle lands in exactly one cluster, clusters stay within the vertex and
+// triangle limits, bounds hold their triangles and the normal cone never culls a front facing triangle.
+
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "TestUtil.h"
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+
+// a Size x Size quad grid in the xy plane, triangles facing +z
+static void BuildGrid(int Size, std::vector<XMFLOAT3>& OutPositions, std::vector<unsigned int>& OutIndices)
+{
+	for(int y=0;y<=Size;y++)
+		for(int x=0;x<=Size;x++)
+			OutPositions.push_back(XMFLOAT3((float)x, (float)y, 0.f));
+
+	for(int y=0;y<Size;y++)
+	{
+		for(int x=0;x<Size;x++)
+		{
+			const unsigned int A = y * (Size + 1) + x, B = A + 1, C = A + Size + 1, D = C + 1;
+			OutIndices.push_back(A); OutIndices.push_back(B); OutIndices.push_back(C);
+			OutIndices.push_back(B); OutIndices.push_back(D); OutIndices.push_back(C);
+		}
+	}
+}
+
+static void CheckClusters(const std::vector<XMFLOAT3>& Positions, const std::vector<unsigned int>& Indices, const std::vector<MeshCluster>& ClusterArray)
+{
+	TEST_CHECK(ClusterArray.size() > 0);
+
+	// clusters are consecutive runs, so together they cover every triangle once
+	unsigned int NextOffset = 0;
+	for(unsigned int c=0;c<ClusterArray.size();c++)
+	{
+		const MeshCluster& Cluster = ClusterArray[c];
+		TEST_CHECK(Cluster.IndexOffset == NextOffset);
+		TEST_CHECK(Cluster.TriangleCount > 0 && Cluster.TriangleCount <= MESHLET_MAX_TRIANGLES);
+		NextOffset += Cluster.TriangleCount * 3;
+
+		std::vector<unsigned int> Unique(Indices.begin() + Cluster.IndexOffset, Indices.begin() + Cluster.IndexOffset + Cluster.TriangleCount * 3);
+		std::sort(Unique.begin(), Unique.end());
+		const int UniqueCount = std::unique(Unique.begin(), Unique.end()) - Unique.begin();
+		TEST_CHECK(UniqueCount <= MESHLET_MAX_VERTICES);
+
+		const float Epsilon = 1e-4f;
+		for(int i=0;i<UniqueCount;i++)
+		{
+			const XMFLOAT3& P = Positions[Unique[i]];
+			TEST_CHECK(P.x >= Cluster.AABBMin.x - Epsilon && P.x <= Cluster.AABBMax.x + Epsilon);
+			TEST_CHECK(P.y >= Cluster.AABBMin.y - Epsilon && P.y <= Cluster.AABBMax.y + Epsilon);
+			TEST_CHECK(P.z >= Cluster.AABBMin.z - Epsilon && P.z <= Cluster.AABBMax.z + Epsilon);
+			const float dx = P.x - Cluster.SphereCenter.x, dy = P.y - Cluster.SphereCenter.y, dz = P.z - Cluster.SphereCenter.z;
+			TEST_CHECK(sqrtf(dx*dx + dy*dy + dz*dz) <= Cluster.SphereRadius + Epsilon);
+		}
+	}
+	TEST_CHECK(NextOffset == Indices.size());
+}
+
+// a cluster the cone calls backfacing must have no triangle facing the camera
+static int CheckConeConservative(const std::vector<XMFLOAT3>& Positions, const std::vector<unsigned int>& Indices, const std::vector<MeshCluster>& ClusterArray)
+{
+	int CulledCount = 0;
+	for(int i=0;i<2000;i++)
+	{
+		const XMFLOAT3 Camera(RandomFloat(-40.f, 40.f), RandomFloat(-40.f, 40.f), RandomFloat(-40.f, 40.f));
+		for(unsigned int c=0;c<ClusterArray.size();c++)
+		{
+			const MeshCluster& Cluster = ClusterArray[c];
+			if(!MeshletBuilder::IsBackfacing(Cluster, Camera))
+				continue;
+			CulledCount++;
+
+			for(unsigned int t=0;t<Cluster.TriangleCount;t++)
+			{
+				const XMFLOAT3& P0 = Positions[Indices[Cluster.IndexOffset + t*3]];
+				const XMFLOAT3& P1 = Positions[Indices[Cluster.IndexOffset + t*3+1]];
+				const XMFLOAT3& P2 = Positions[Indices[Cluster.IndexOffset + t*3+2]];
+				const XMFLOAT3 E1(P1.x - P0.x, P1.y - P0.y, P1.z - P0.z);
+				const XMFLOAT3 E2(P2.x - P0.x, P2.y - P0.y, P2.z - P0.z);
+				const XMFLOAT3 N(E1.y*E2.z - E1.z*E2.y, E1.z*E2.x - E1.x*E2.z, E1.x*E2.y - E1.y*E2.x);
+				const float Facing = N.x * (Camera.x - P0.x) + N.y * (Camera.y - P0.y) + N.z * (Camera.z - P0.z);
+				TEST_CHECK(Facing <= 1e-3f);
+			}
+		}
+	}
+	return CulledCount;
+}
+
+int main()
+{
+	srand(7);
+
+	// flat grid, after the vertex cache optimization as the importer runs it
+	{
+		std::vector<XMFLOAT3> Positions;
+		std::vector<unsigned int> Indices;
+		BuildGrid(60, Positions, Indices);
+		MeshOptimizer::OptimizeVertexCache(&Indices[0], Indices.size(), Positions.size());
+
+		std::vector<MeshCluster> ClusterArray;
+		MeshletBuilder::BuildClusters(&Indices[0], 0, Indices.size() / 3, &Positions[0], Positions.size(), ClusterArray);
+		CheckClusters(Positions, Indices, ClusterArray);
+
+		// every triangle faces +z, so the cone is tight and culls from below but never from above
+		const MeshCluster& Cluster = ClusterArray[0];
+		TEST_CHECK(Cluster.ConeCutoff < 0.01f);
+		TEST_CHECK(Cluster.ConeAxis.z < -0.99f || Cluster.ConeAxis.z > 0.99f);
+		const XMFLOAT3 Below(Cluster.SphereCenter.x, Cluster.SphereCenter.y, -10.f);
+		const XMFLOAT3 Above(Cluster.SphereCenter.x, Cluster.SphereCenter.y, 10.f);
+		TEST_CHECK(MeshletBuilder::IsBackfacing(Cluster, Below) != MeshletBuilder::IsBackfacing(Cluster, Above));
+		TEST_CHECK(CheckConeConservative(Positions, Indices, ClusterArray) > 0);
+
+		// a plane with the whole grid behind it culls every cluster, the opposite plane none
+		const XMFLOAT4 Behind(0.f, 0.f, 1.f, -100.f);
+		const XMFLOAT4 Front(0.f, 0.f, 1.f, 1.f);
+		for(unsigned int c=0;c<ClusterArray.size();c++)
+		{
+			TEST_CHECK(MeshletBuilder::IsOutsidePlanes(ClusterArray[c], &Behind, 1));
+			TEST_CHECK(!MeshletBuilder::IsOutsidePlanes(ClusterArray[c], &Front, 1));
+		}
+	}
+
+	// a sphere and a submesh that starts past the first index
+	{
+		std::vector<XMFLOAT3> Positions;
+		std::vector<unsigned int> Indices;
+		BuildGrid(4, Positions, Indices);
+		const unsigned int SphereOffset = Indices.size();
+		BuildSphere(24, 48, 5.f, Positions, Indices);
+
+		std::vector<MeshCluster> ClusterArray;
+		MeshletBuilder::BuildClusters(&Indices[0], SphereOffset, (Indices.size() - SphereOffset) / 3, &Positions[0], Positions.size(), ClusterArray);
+		TEST_CHECK(ClusterArray.size() > 0 && ClusterArray[0].IndexOffset == SphereOffset);
+
+		std::vector<unsigned int> SphereIndices(Indices.begin() + SphereOffset, Indices.end());
+		for(unsigned int c=0;c<ClusterArray.size();c++)
+			ClusterArray[c].IndexOffset -= SphereOffset;
+		CheckClusters(Positions, SphereIndices, ClusterArray);
+		CheckConeConservative(Positions, SphereIndices, ClusterArray);
+	}
+
+	return TEST_RESULT("MeshletBuilderTest");
+}
@@ -0,0 +1,288 @@
+// OcclusionCuller : occluders built at import stay on the surface of their mesh, the sse and avx rasterizers
+// write the same depth buffer as the scalar one, and a box is only culled when it is really hidden.
+// also times BuildOccluder and every rasterizer path over a frame sized scene.
+
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "TestUtil.h"
+#include "OcclusionCuller.h"
+#include "MathUtil.h"
+
+static XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+static XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x); }
+static float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+
+// a Size x Size grid over [0, Size] in x and y, Height gives z. each face is its own vertices, split like uv seams
+static void BuildHeightGrid(int Size, float (*Height)(float, float), std::vector<XMFLOAT3>& OutPositions, std::vector<unsigned int>& OutIndices)
+{
+	for(int y=0;y<Size;y++)
+	{
+		for(int x=0;x<Size;x++)
+		{
+			const unsigned int Base = OutPositions.size();
+			for(int c=0;c<4;c++)
+			{
+				const float px = (float)(x + (c & 1)), py = (float)(y + (c >> 1));
+				OutPositions.push_back(XMFLOAT3(px, py, Height(px, py)));
+			}
+			OutIndices.push_back(Base); OutIndices.push_back(Base + 1); OutIndices.push_back(Base + 2);
+			OutIndices.push_back(Base + 1); OutIndices.push_back(Base + 3); OutIndices.push_back(Base + 2);
+		}
+	}
+}
+
+static float FlatHeight(float, float) { return 0.f; }
+
+// flat on one half, a wave on the other
+static float HalfWaveHeight(float x, float y)
+{
+	return x <= 10.f ? 0.f : sinf((x - 10.f) * 0.7f) * cosf(y * 0.5f);
+}
+
+// a closed box of Size x Size quads per face, faces split from each other, wound outward
+static void BuildBox(int Size, std::vector<XMFLOAT3>& OutPositions, std::vector<unsigned int>& OutIndices)
+{
+	for(int Face=0;Face<6;Face++)
+	{
+		const int Axis = Face / 2;
+		const float Side = Face & 1 ? 1.f : -1.f;
+		const unsigned int Base = OutPositions.size();
+		for(int v=0;v<=Size;v++)
+		{
+			for(int u=0;u<=Size;u++)
+			{
+				float p[3];
+				p[Axis] = Side;
+				p[(Axis + 1) % 3] = -1.f + 2.f * u / Size;
+				p[(Axis + 2) % 3] = -1.f + 2.f * v / Size;
+				OutPositions.push_back(XMFLOAT3(p[0], p[1], p[2]));
+			}
+		}
+		for(int v=0;v<Size;v++)
+		{
+			for(int u=0;u<Size;u++)
+			{
+				const unsigned int A = Base + v * (Size + 1) + u, B = A + 1, C = A + Size + 1, D = C + 1;
+				if(Side > 0.f)
+				{
+					OutIndices.push_back(A); OutIndices.push_back(B); OutIndices.push_back(C);
+					OutIndices.push_back(B); OutIndices.push_back(D); OutIndices.push_back(C);
+				}
+				else
+				{
+					OutIndices.push_back(A); OutIndices.push_back(C); OutIndices.push_back(B);
+					OutIndices.push_back(B); OutIndices.push_back(C); OutIndices.push_back(D);
+				}
+			}
+		}
+	}
+}
+
+static float GetArea(const std::vector<XMFLOAT3>& Positions, const std::vector<unsigned int>& Indices)
+{
+	float Area = 0.f;
+	for(unsigned int i=0;i<Indices.size();i+=3)
+	{
+		const XMFLOAT3 N = Cross(Sub(Positions[Indices[i + 1]], Positions[Indices[i]]), Sub(Positions[Indices[i + 2]], Positions[Indices[i]]));
+		Area += sqrtf(Dot(N, N)) * 0.5f;
+	}
+	return Area;
+}
+
+// P lies on one of the triangles, within Tolerance of its plane and inside its edges
+static bool IsOnSurface(const XMFLOAT3& P, const std::vector<XMFLOAT3>& Positions, const std::vector<unsigned int>& Indices, float Tolerance)
+{
+	for(unsigned int i=0;i<Indices.size();i+=3)
+	{
+		const XMFLOAT3& A = Positions[Indices[i]];
+		const XMFLOAT3& B = Positions[Indices[i + 1]];
+		const XMFLOAT3& C = Positions[Indices[i + 2]];
+		const XMFLOAT3 N = Cross(Sub(B, A), Sub(C, A));
+		const float LengthSq = Dot(N, N);
+		if(LengthSq <= 0.f || fabsf(Dot(Sub(P, A), N)) > Tolerance * sqrtf(LengthSq))
+			continue;
+		const float U = Dot(Cross(Sub(B, P), Sub(C, P)), N) / LengthSq;
+		const float V = Dot(Cross(Sub(C, P), Sub(A, P)), N) / LengthSq;
+		const float W = 1.f - U - V;
+		if(U >= -1e-4f && V >= -1e-4f && W >= -1e-4f)
+			return true;
+	}
+	return false;
+}
+
+// the occluder must not write depth where the mesh has none, so every point of it is a point of the mesh
+static void CheckOccluderOnSurface(const std::vector<XMFLOAT3>& Positions, const std::vector<unsigned int>& Indices,
+	const std::vector<XMFLOAT3>& OccluderPositions, const std::vector<unsigned int>& OccluderIndices)
+{
+	TEST_CHECK(OccluderIndices.size() % 3 == 0);
+	for(unsigned int i=0;i<OccluderIndices.size();i++)
+		TEST_CHECK(OccluderIndices[i] < OccluderPositions.size());
+	TEST_CHECK(GetArea(OccluderPositions, OccluderIndices) <= GetArea(Positions, Indices) * 1.0001f);
+
+	for(unsigned int i=0;i<OccluderIndices.size();i+=3)
+	{
+		const XMFLOAT3& A = OccluderPositions[OccluderIndices[i]];
+		const XMFLOAT3& B = OccluderPositions[OccluderIndices[i + 1]];
+		const XMFLOAT3& C = OccluderPositions[OccluderIndices[i + 2]];
+		for(int s=0;s<16;s++)
+		{
+			float U = RandomFloat(0.f, 1.f), V = RandomFloat(0.f, 1.f);
+			if(U + V > 1.f)
+			{
+				U = 1.f - U;
+				V = 1.f - V;
+			}
+			const XMFLOAT3 P(A.x + (B.x - A.x) * U + (C.x - A.x) * V, A.y + (B.y - A.y) * U + (C.y - A.y) * V, A.z + (B.z - A.z) * U + (C.z - A.z) * V);
+			TEST_CHECK(IsOnSurface(P, Positions, Indices, 1e-4f));
+		}
+	}
+}
+
+static void BuildAndCheck(const std::vector<XMFLOAT3>& Positions, const std::vector<unsigned int>& Indices,
+	std::vector<XMFLOAT3>& OutPositions, std::vector<unsigned int>& OutIndices)
+{
+	OcclusionCuller::BuildOccluder(&Indices[0], Indices.size(), &Positions[0], Positions.size(), OutPositions, OutIndices);
+	CheckOccluderOnSurface(Positions, Indices, OutPositions, OutIndices);
+}
+
+int main()
+{
+	srand(24);
+
+	// flat and split on every quad, welds and reduces to the budget with the same area
+	{
+		std::vector<XMFLOAT3> Positions, OccluderPositions;
+		std::vector<unsigned int> Indices, OccluderIndices;
+		BuildHeightGrid(40, FlatHeight, Positions, Indices);
+		BuildAndCheck(Positions, Indices, OccluderPositions, OccluderIndices);
+		TEST_CHECK(OccluderIndices.size() > 0 && OccluderIndices.size() <= OCCLUDER_MAX_TRIANGLES * 3);
+		TEST_CHECK(fabsf(GetArea(OccluderPositions, OccluderIndices) - 1600.f) < 0.01f);
+	}
+
+	// a closed box, every crease vertex stays so the faces keep a fan each
+	{
+		std::vector<XMFLOAT3> Positions, OccluderPositions;
+		std::vector<unsigned int> Indices, OccluderIndices;
+		BuildBox(6, Positions, Indices);
+		BuildAndCheck(Positions, Indices, OccluderPositions, OccluderIndices);
+		TEST_CHECK(OccluderIndices.size() > 0 && OccluderIndices.size() <= OCCLUDER_MAX_TRIANGLES * 3);
+		TEST_CHECK(fabsf(GetArea(OccluderPositions, OccluderIndices) - 24.f) < 0.01f);
+	}
+
+	// the flat half reduces, the wave keeps its triangles
+	{
+		std::vector<XMFLOAT3> Positions, OccluderPositions;
+		std::vector<unsigned int> Indices, OccluderIndices;
+		BuildHeightGrid(20, HalfWaveHeight, Positions, Indices);
+		BuildAndCheck(Positions, Indices, OccluderPositions, OccluderIndices);
+		TEST_CHECK(OccluderIndices.size() > 0 && OccluderIndices.size() < Indices.size());
+		TEST_CHECK(OccluderIndices.size() >= Indices.size() / 2);
+	}
+
+	// curved everywhere and past the frame budget, no occluder
+	{
+		std::vector<XMFLOAT3> Positions, OccluderPositions;
+		std::vector<unsigned int> Indices, OccluderIndices;
+		BuildSphere(100, 100, 1.f, Positions, Indices);
+		const double Start = GetMilliseconds();
+		OcclusionCuller::BuildOccluder(&Indices[0], Indices.size(), &Positions[0], Positions.size(), OccluderPositions, OccluderIndices);
+		printf("BuildOccluder : %d triangles in %.3f ms\n", (int)Indices.size() / 3, GetMilliseconds() - Start);
+		TEST_CHECK(OccluderIndices.size() == 0 && OccluderPositions.size() == 0);
+	}
+
+	// a frame of random triangles in front of the camera, some through the near plane
+	const XMMATRIX View = XMMatrixLookAtLH(XMVectorSet(0.f, 0.f, 0.f, 1.f), XMVectorSet(0.f, 0.f, 1.f, 1.f), XMVectorSet(0.f, 1.f, 0.f, 0.f));
+	const XMMATRIX Projection = XMMatrixPerspectiveFovLH(1.f, 2.f, 1.f, 500.f);
+	const XMMATRIX ViewProjection = XMMatrixMultiply(View, Projection);
+	{
+		std::vector<XMFLOAT3> Positions;
+		std::vector<unsigned int> Indices;
+		for(int t=0;t<OCCLUSION_MAX_TRIANGLES;t++)
+		{
+			const XMFLOAT3 Center(RandomFloat(-150.f, 150.f), RandomFloat(-60.f, 60.f), RandomFloat(0.f, 300.f));
+			const float Size = RandomFloat(0.5f, 20.f);
+			for(int v=0;v<3;v++)
+			{
+				Indices.push_back(Positions.size());
+				Positions.push_back(XMFLOAT3(Center.x + RandomFloat(-Size, Size), Center.y + RandomFloat(-Size, Size), Center.z + RandomFloat(-Size, Size)));
+			}
+		}
+
+		OcclusionCuller Culler;
+		std::vector<float> Reference;
+		for(int Simd=OCCLUSION_SCALAR;Simd<=OcclusionCuller::GetBestSimd();Simd++)
+		{
+			double Best = 1e9;
+			for(int Run=0;Run<10;Run++)
+			{
+				const double Start = GetMilliseconds();
+				Culler.BeginFrame(ViewProjection);
+				Culler.AddOccluder(&Positions[0], Positions.size(), &Indices[0], Indices.size());
+				Culler.Rasterize((EOcclusionSimd)Simd);
+				Best = Math::Min<double>(Best, GetMilliseconds() - Start);
+			}
+			printf("OcclusionCuller : simd %d, %d triangles in %d tile bins in %.3f ms\n", Simd, Culler._Stats.TriangleCount, Culler._Stats.BinnedCount, Best);
+
+			if(Simd == OCCLUSION_SCALAR)
+			{
+				Reference = Culler._DepthArray;
+				TEST_CHECK(Culler._Stats.TriangleCount > 0 && Culler._Stats.TriangleCount < OCCLUSION_MAX_TRIANGLES);
+				continue;
+			}
+			int DifferCount = 0;
+			for(unsigned int i=0;i<Reference.size();i++)
+				DifferCount += Reference[i] != Culler._DepthArray[i];
+			TEST_CHECK(DifferCount == 0);
+		}
+
+		// the hierarchy holds the farthest depth below it
+		for(int l=1;l<Culler._LevelCount;l++)
+		{
+			for(int y=0;y<Culler.GetLevelHeight(l - 1);y++)
+				for(int x=0;x<Culler.GetLevelWidth(l - 1);x++)
+					TEST_CHECK(Culler.GetDepth(x >> 1, y >> 1, l) >= Culler.GetDepth(x, y, l - 1));
+		}
+	}
+
+	// a wall over [-2, 2] in x and y at z = 10, a box is hidden only when all of it is behind the wall and inside its outline
+	{
+		std::vector<XMFLOAT3> Positions, OccluderPositions;
+		std::vector<unsigned int> Indices, OccluderIndices;
+		BuildHeightGrid(8, FlatHeight, Positions, Indices);
+		for(unsigned int v=0;v<Positions.size();v++)
+			Positions[v] = XMFLOAT3(Positions[v].x * 0.5f - 2.f, Positions[v].y * 0.5f - 2.f, 10.f);
+		OcclusionCuller::BuildOccluder(&Indices[0], Indices.size(), &Positions[0], Positions.size(), OccluderPositions, OccluderIndices);
+
+		OcclusionCuller Culler;
+		Culler.BeginFrame(ViewProjection);
+		Culler.AddOccluder(&OccluderPositions[0], OccluderPositions.size(), &OccluderIndices[0], OccluderIndices.size());
+		Culler.Rasterize();
+
+		TEST_CHECK(!Culler.IsBoxVisible(XMFLOAT3(-0.5f, -0.5f, 20.f), XMFLOAT3(0.5f, 0.5f, 22.f)));
+		TEST_CHECK(Culler.IsBoxVisible(XMFLOAT3(-0.5f, -0.5f, 2.f), XMFLOAT3(0.5f, 0.5f, 3.f)));
+		TEST_CHECK(Culler.IsBoxVisible(XMFLOAT3(7.5f, -0.5f, 20.f), XMFLOAT3(8.5f, 0.5f, 22.f)));
+		TEST_CHECK(Culler.IsBoxVisible(XMFLOAT3(-0.5f, -0.5f, 0.f), XMFLOAT3(0.5f, 0.5f, 30.f)));
+
+		int OccludedCount = 0;
+		for(int i=0;i<20000;i++)
+		{
+			const XMFLOAT3 Center(RandomFloat(-10.f, 10.f), RandomFloat(-6.f, 6.f), RandomFloat(2.f, 40.f));
+			const XMFLOAT3 Extent(RandomFloat(0.f, 2.f), RandomFloat(0.f, 2.f), RandomFloat(0.f, 2.f));
+			const XMFLOAT3 Min(Center.x - Extent.x, Center.y - Extent.y, Center.z - Extent.z);
+			const XMFLOAT3 Max(Center.x + Extent.x, Center.y + Extent.y, Center.z + Extent.z);
+			if(Culler.IsBoxVisible(Min, Max))
+				continue;
+			OccludedCount++;
+			TEST_CHECK(Min.z > 10.f);
+			for(int c=0;c<8;c++)
+			{
+				const XMFLOAT3 Corner(c & 1 ? Max.x : Min.x, c & 2 ? Max.y : Min.y, c & 4 ? Max.z : Min.z);
+				TEST_CHECK(fabsf(Corner.x * 10.f / Corner.z) <= 2.f && fabsf(Corner.y * 10.f / Corner.z) <= 2.f);
+			}
+		}
+		TEST_CHECK(OccludedCount > 0);
+	}
+
+	return TEST_RESULT("OcclusionCullerTest");
+}
@@ -0,0 +1,235 @@
+// SceneBVH : frustum, sphere, box and ray queries return exactly what a brute force pass over the live
+// boxes returns, after the sah build, after objects move and after proxies are destroyed and reused.
+// the tree itself stays consistent: parent links, inner boxes around their children, one leaf per proxy.
+
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "TestUtil.h"
+#include "SceneBVH.h"
+
+#define OBJECT_COUNT	20000
+#define QUERY_COUNT		40
+
+struct TestObject
+{
+	XMFLOAT3 Min;
+	XMFLOAT3 Max;
+	int Proxy;
+	bool bLive;
+};
+
+static void RandomBox(XMFLOAT3& OutMin, XMFLOAT3& OutMax)
+{
+	const XMFLOAT3 Center(RandomFloat(-2000.f, 2000.f), RandomFloat(0.f, 100.f), RandomFloat(-2000.f, 2000.f));
+	const float Size = RandomFloat(0.5f, 10.f);
+	OutMin = XMFLOAT3(Center.x - Size, Center.y - Size, Center.z - Size);
+	OutMax = XMFLOAT3(Center.x + Size, Center.y + Size, Center.z + Size);
+}
+
+static bool Contains(const XMFLOAT3& OuterMin, const XMFLOAT3& OuterMax, const XMFLOAT3& Min, const XMFLOAT3& Max)
+{
+	return OuterMin.x <= Min.x && OuterMin.y <= Min.y && OuterMin.z <= Min.z && OuterMax.x >= Max.x && OuterMax.y >= Max.y && OuterMax.z >= Max.z;
+}
+
+static int ValidateNode(const SceneBVH& Tree, int Node, int Parent)
+{
+	const SceneBVHNode& N = Tree._NodeArray[Node];
+	TEST_CHECK(N.Parent == Parent);
+	if(N.Child[0] < 0)
+	{
+		TEST_CHECK(N.Object >= 0 && Tree._ObjectArray[N.Object].Leaf == Node);
+		const SceneBVHObject& Object = Tree._ObjectArray[N.Object];
+		TEST_CHECK(Contains(N.Min, N.Max, Object.Min, Object.Max));
+		return 1;
+	}
+
+	TEST_CHECK(N.Object < 0);
+	for(int c=0;c<2;c++)
+		TEST_CHECK(Contains(N.Min, N.Max, Tree._NodeArray[N.Child[c]].Min, Tree._NodeArray[N.Child[c]].Max));
+	return ValidateNode(Tree, N.Child[0], Node) + ValidateNode(Tree, N.Child[1], Node);
+}
+
+static void ValidateTree(const SceneBVH& Tree)
+{
+	const int LeafCount = Tree._Root < 0 ? 0 : ValidateNode(Tree, Tree._Root, -1);
+	TEST_CHECK(LeafCount == Tree.GetProxyCount());
+}
+
+static bool IsBoxInPlanes(const TestObject& Object, const XMFLOAT4* Planes)
+{
+	for(int p=0;p<6;p++)
+	{
+		const XMFLOAT4& P = Planes[p];
+		const float Distance = P.x * (P.x > 0.f ? Object.Max.x : Object.Min.x) + P.y * (P.y > 0.f ? Object.Max.y : Object.Min.y)
+			+ P.z * (P.z > 0.f ? Object.Max.z : Object.Min.z) + P.w;
+		if(Distance < 0.f)
+			return false;
+	}
+	return true;
+}
+
+static bool IsBoxInSphere(const TestObject& Object, const XMFLOAT3& Center, float Radius)
+{
+	const float x = Center.x - std::max(Object.Min.x, std::min(Center.x, Object.Max.x));
+	const float y = Center.y - std::max(Object.Min.y, std::min(Center.y, Object.Max.y));
+	const float z = Center.z - std::max(Object.Min.z, std::min(Center.z, Object.Max.z));
+	return x*x + y*y + z*z <= Radius * Radius;
+}
+
+static bool IsBoxOverlapping(const TestObject& Object, const XMFLOAT3& Min, const XMFLOAT3& Max)
+{
+	return Object.Min.x <= Max.x && Object.Max.x >= Min.x && Object.Min.y <= Max.y && Object.Max.y >= Min.y && Object.Min.z <= Max.z && Object.Max.z >= Min.z;
+}
+
+static bool IsBoxOnRay(const TestObject& Object, const XMFLOAT3& Origin, const XMFLOAT3& Dir, float MaxT)
+{
+	float Enter = 0.f, Exit = MaxT;
+	for(int k=0;k<3;k++)
+	{
+		float Near = ((&Object.Min.x)[k] - (&Origin.x)[k]) / (&Dir.x)[k];
+		float Far = ((&Object.Max.x)[k] - (&Origin.x)[k]) / (&Dir.x)[k];
+		if(Near > Far)
+			std::swap(Near, Far);
+		Enter = std::max(Enter, Near);
+		Exit = std::min(Exit, Far);
+		if(Enter > Exit)
+			return false;
+	}
+	return true;
+}
+
+static void CheckResult(std::vector<int>& Result, std::vector<int>& Expected)
+{
+	std::sort(Result.begin(), Result.end());
+	std::sort(Expected.begin(), Expected.end());
+	TEST_CHECK(Result == Expected);
+}
+
+static void CheckQueries(SceneBVH& Tree, const std::vector<TestObject>& ObjectArray)
+{
+	std::vector<int> Result, Expected;
+	for(int q=0;q<QUERY_COUNT;q++)
+	{
+		const XMFLOAT3 Center(RandomFloat(-2000.f, 2000.f), RandomFloat(0.f, 100.f), RandomFloat(-2000.f, 2000.f));
+		const float Radius = RandomFloat(5.f, 150.f);
+		const XMFLOAT3 Min(Center.x - Radius, Center.y - Radius, Center.z - Radius);
+		const XMFLOAT3 Max(Center.x + Radius, Center.y + Radius, Center.z + Radius);
+
+		Result.clear(); Expected.clear();
+		Tree.QuerySphere(Center, Radius, Result);
+		for(unsigned int i=0;i<ObjectArray.size();i++)
+			if(ObjectArray[i].bLive && IsBoxInSphere(ObjectArray[i], Center, Radius))
+				Expected.push_back(i);
+		CheckResult(Result, Expected);
+
+		Result.clear(); Expected.clear();
+		Tree.QueryAABB(Min, Max, Result);
+		for(unsigned int i=0;i<ObjectArray.size();i++)
+			if(ObjectArray[i].bLive && IsBoxOverlapping(ObjectArray[i], Min, Max))
+				Expected.push_back(i);
+		CheckResult(Result, Expected);
+
+		XMFLOAT3 Dir(RandomFloat(-1.f, 1.f), RandomFloat(-0.1f, 0.1f), RandomFloat(-1.f, 1.f));
+		const float Length = sqrtf(Dir.x*Dir.x + Dir.y*Dir.y + Dir.z*Dir.z);
+		Dir = XMFLOAT3(Dir.x / Length, Dir.y / Length, Dir.z / Length);
+		Result.clear(); Expected.clear();
+		Tree.QueryRay(Center, Dir, 1000.f, Result);
+		for(unsigned int i=0;i<ObjectArray.size();i++)
+			if(ObjectArray[i].bLive && IsBoxOnRay(ObjectArray[i], Center, Dir, 1000.f))
+				Expected.push_back(i);
+		CheckResult(Result, Expected);
+
+		// a box shaped frustum with one slanted plane, so the corner tests matter
+		const XMFLOAT4 Planes[6] =
+		{
+			XMFLOAT4(1.f, 0.f, 0.f, -Min.x), XMFLOAT4(-1.f, 0.f, 0.f, Max.x),
+			XMFLOAT4(0.f, 1.f, 0.f, -Min.y), XMFLOAT4(0.f, -1.f, 0.f, Max.y),
+			XMFLOAT4(0.7071f, 0.f, 0.7071f, -(Min.x + Min.z) * 0.7071f), XMFLOAT4(0.f, 0.f, -1.f, Max.z),
+		};
+		Result.clear(); Expected.clear();
+		Tree.QueryFrustum(Planes, Result);
+		for(unsigned int i=0;i<ObjectArray.size();i++)
+			if(ObjectArray[i].bLive && IsBoxInPlanes(ObjectArray[i], Planes))
+				Expected.push_back(i);
+		CheckResult(Result, Expected);
+	}
+}
+
+static void MoveObjects(SceneBVH& Tree, std::vector<TestObject>& ObjectArray, float Step)
+{
+	for(unsigned int i=1;i<ObjectArray.size();i+=2)
+	{
+		TestObject& Object = ObjectArray[i];
+		if(!Object.bLive)
+			continue;
+		float dx = RandomFloat(-Step, Step), dz = RandomFloat(-Step, Step);
+		// now and then a teleport, clear of the fattened leaf
+		if(rand() % 200 == 0)
+		{
+			dx = RandomFloat(-500.f, 500.f);
+			dz = RandomFloat(-500.f, 500.f);
+		}
+		Object.Min.x += dx; Object.Max.x += dx;
+		Object.Min.z += dz; Object.Max.z += dz;
+		Tree.MoveProxy(Object.Proxy, Object.Min, Object.Max);
+	}
+	Tree.Refit();
+}
+
+int main()
+{
+	srand(23);
+
+	SceneBVH Tree;
+	std::vector<TestObject> ObjectArray(OBJECT_COUNT);
+	for(int i=0;i<OBJECT_COUNT;i++)
+	{
+		TestObject& Object = ObjectArray[i];
+		RandomBox(Object.Min, Object.Max);
+		Object.Proxy = Tree.CreateProxy(Object.Min, Object.Max, i, i % 2 == 0);
+		Object.bLive = true;
+	}
+
+	// incremental inserts, then the bulk build over the same proxies
+	ValidateTree(Tree);
+	CheckQueries(Tree, ObjectArray);
+	const float IncrementalCost = Tree.GetSAHCost();
+	Tree.Build();
+	ValidateTree(Tree);
+	CheckQueries(Tree, ObjectArray);
+	TEST_CHECK(Tree.GetSAHCost() <= IncrementalCost * 1.05f);
+
+	// the odd objects move every frame
+	for(int Frame=0;Frame<20;Frame++)
+		MoveObjects(Tree, ObjectArray, 2.f);
+	ValidateTree(Tree);
+	CheckQueries(Tree, ObjectArray);
+
+	// a third destroyed, the rest keep moving
+	for(int i=0;i<OBJECT_COUNT;i+=3)
+	{
+		Tree.DestroyProxy(ObjectArray[i].Proxy);
+		ObjectArray[i].bLive = false;
+	}
+	MoveObjects(Tree, ObjectArray, 3.f);
+	TEST_CHECK(Tree.GetProxyCount() == OBJECT_COUNT - (OBJECT_COUNT + 2) / 3);
+	ValidateTree(Tree);
+	CheckQueries(Tree, ObjectArray);
+
+	// freed proxies are handed out again, the user data follows the new object
+	for(int i=0;i<OBJECT_COUNT;i+=6)
+	{
+		TestObject& Object = ObjectArray[i];
+		RandomBox(Object.Min, Object.Max);
+		Object.Proxy = Tree.CreateProxy(Object.Min, Object.Max, i, false);
+		Object.bLive = true;
+		TEST_CHECK(Tree.GetUserData(Object.Proxy) == i);
+	}
+	MoveObjects(Tree, ObjectArray, 2.f);
+	ValidateTree(Tree);
+	CheckQueries(Tree, ObjectArray);
+
+	return TEST_RESULT("SceneBVHTest");
+}
@@ -0,0 +1,54 @@
+#pragma once
+// minimal checks for the headless tests, every test is its own executable and returns non zero on failure
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "MathTypes.h"
+
+static int GTestFailures = 0;
+
+#define TEST_CHECK(Cond) \
+	do { if(!(Cond)) { GTestFailures++; printf("%s:%d : check failed : %s\n", __FILE__, __LINE__, #Cond); } } while(0)
+
+#define TEST_RESULT(Name) \
+	(printf("%s : %s\n", Name, GTestFailures == 0 ? "passed" : "FAILED"), GTestFailures == 0 ? 0 : 1)
+
+// uniform in [Min, Max], seeded by the test's srand
+inline float RandomFloat(float Min, float Max)
+{
+	return Min + (Max - Min) * (rand() / (float)RAND_MAX);
+}
+
+// wall clock for the timings the tests print
+inline double GetMilliseconds()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// a uv sphere appended to the arrays, normals spread over every direction, wound outward
+inline void BuildSphere(int Rings, int Segments, float Radius, std::vector<XMFLOAT3>& OutPositions, std::vector<unsigned int>& OutIndices)
+{
+	const float Pi = 3.14159265f;
+	const unsigned int Base = OutPositions.size();
+	for(int r=0;r<=Rings;r++)
+	{
+		const float Theta = Pi * r / Rings;
+		for(int s=0;s<=Segments;s++)
+		{
+			const float Phi = 2.f * Pi * s / Segments;
+			OutPositions.push_back(XMFLOAT3(sinf(Theta) * cosf(Phi) * Radius, cosf(Theta) * Radius, sinf(Theta) * sinf(Phi) * Radius));
+		}
+	}
+
+	for(int r=0;r<Rings;r++)
+	{
+		for(int s=0;s<Segments;s++)
+		{
+			const unsigned int A = Base + r * (Segments + 1) + s, B = A + 1, C = A + Segments + 1, D = C + 1;
+			OutIndices.push_back(A); OutIndices.push_back(C); OutIndices.push_back(B);
+			OutIndices.push_back(B); OutIndices.push_back(C); OutIndices.push_back(D);
+		}
+	}
+}
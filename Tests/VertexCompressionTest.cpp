@@ -0,0 +1,147 @@
+// VertexCompression : positions, octahedral normals and half texcoords round trip within the error bounds the
+// cooker validates against, over random values and the awkward ones (bounds corners, flat axes, poles, the
+// octahedron's folds), and ValidateVertexCompression turns down what the formats can not hold.
+
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "TestUtil.h"
+#include "VertexCompression.h"
+#include "MathUtil.h"
+
+static float GetAngle(const XMFLOAT3& A, const XMFLOAT3& B)
+{
+	const float Dot = A.x * B.x + A.y * B.y + A.z * B.z;
+	const float CrossX = A.y * B.z - A.z * B.y;
+	const float CrossY = A.z * B.x - A.x * B.z;
+	const float CrossZ = A.x * B.y - A.y * B.x;
+	return atan2f(sqrtf(CrossX * CrossX + CrossY * CrossY + CrossZ * CrossZ), Dot);
+}
+
+static XMFLOAT3 Normalize(const XMFLOAT3& V)
+{
+	const float Length = sqrtf(V.x * V.x + V.y * V.y + V.z * V.z);
+	return XMFLOAT3(V.x / Length, V.y / Length, V.z / Length);
+}
+
+int main()
+{
+	srand(6);
+
+	// positions, relative to the half extent of each axis
+	{
+		const XMFLOAT3 Mins[] = { XMFLOAT3(-1.f, -1.f, -1.f), XMFLOAT3(-350.f, 2.f, 1000.f), XMFLOAT3(-5.f, 3.f, -0.01f) };
+		const XMFLOAT3 Maxs[] = { XMFLOAT3(1.f, 1.f, 1.f), XMFLOAT3(120.f, 2.f, 1000.5f), XMFLOAT3(5.f, 3.f, 0.01f) };
+		for(int b=0;b<3;b++)
+		{
+			XMFLOAT4 Scale, Bias;
+			GetPositionScaleBias(Mins[b], Maxs[b], Scale, Bias);
+			TEST_CHECK(Scale.x > 0.f && Scale.y > 0.f && Scale.z > 0.f);
+
+			std::vector<XMFLOAT3> Positions;
+			for(int c=0;c<8;c++)
+				Positions.push_back(XMFLOAT3(c & 1 ? Maxs[b].x : Mins[b].x, c & 2 ? Maxs[b].y : Mins[b].y, c & 4 ? Maxs[b].z : Mins[b].z));
+			for(int i=0;i<100000;i++)
+				Positions.push_back(XMFLOAT3(RandomFloat(Mins[b].x, Maxs[b].x), RandomFloat(Mins[b].y, Maxs[b].y), RandomFloat(Mins[b].z, Maxs[b].z)));
+
+			float MaxError = 0.f;
+			for(unsigned int i=0;i<Positions.size();i++)
+			{
+				const CompressedPosition Encoded = EncodePosition(Positions[i], Scale, Bias);
+				TEST_CHECK(Encoded.Value[3] == 32767);
+				const XMFLOAT3 Decoded = DecodePosition(Encoded, Scale, Bias);
+				MaxError = Math::Max<float>(MaxError, fabsf(Decoded.x - Positions[i].x) / Scale.x);
+				MaxError = Math::Max<float>(MaxError, fabsf(Decoded.y - Positions[i].y) / Scale.y);
+				MaxError = Math::Max<float>(MaxError, fabsf(Decoded.z - Positions[i].z) / Scale.z);
+			}
+			printf("VertexCompression : position error %.3g of the half extent (bound %.3g)\n", MaxError, COMPRESSED_POSITION_MAX_ERROR);
+			TEST_CHECK(MaxError <= COMPRESSED_POSITION_MAX_ERROR);
+		}
+	}
+
+	// normals, random directions plus the axes, the octant diagonals and the fold lines
+	{
+		std::vector<XMFLOAT3> Normals;
+		for(int x=-1;x<=1;x++)
+			for(int y=-1;y<=1;y++)
+				for(int z=-1;z<=1;z++)
+					if(x != 0 || y != 0 || z != 0)
+						Normals.push_back(Normalize(XMFLOAT3((float)x, (float)y, (float)z)));
+		for(int i=0;i<1000;i++)
+		{
+			// just either side of the equator, where the lower half folds over
+			const float Phi = RandomFloat(0.f, 6.2831853f);
+			Normals.push_back(Normalize(XMFLOAT3(cosf(Phi), sinf(Phi), RandomFloat(-1e-4f, 1e-4f))));
+			// around the -z pole, where the fold meets the corners
+			Normals.push_back(Normalize(XMFLOAT3(RandomFloat(-1e-3f, 1e-3f), RandomFloat(-1e-3f, 1e-3f), -1.f)));
+		}
+		for(int i=0;i<200000;i++)
+		{
+			XMFLOAT3 Normal(RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f), RandomFloat(-1.f, 1.f));
+			const float LengthSq = Normal.x * Normal.x + Normal.y * Normal.y + Normal.z * Normal.z;
+			if(LengthSq > 1e-4f && LengthSq <= 1.f)
+				Normals.push_back(Normalize(Normal));
+		}
+
+		float MaxAngle = 0.f, MaxLengthError = 0.f;
+		for(unsigned int i=0;i<Normals.size();i++)
+		{
+			const XMFLOAT3 Decoded = DecodeNormal(EncodeNormal(Normals[i]));
+			MaxAngle = Math::Max<float>(MaxAngle, GetAngle(Decoded, Normals[i]));
+			MaxLengthError = Math::Max<float>(MaxLengthError, fabsf(sqrtf(Decoded.x * Decoded.x + Decoded.y * Decoded.y + Decoded.z * Decoded.z) - 1.f));
+		}
+		printf("VertexCompression : normal error %.3g radians over %d normals (bound %.3g)\n", MaxAngle, (int)Normals.size(), COMPRESSED_NORMAL_MAX_ERROR);
+		TEST_CHECK(MaxAngle <= COMPRESSED_NORMAL_MAX_ERROR);
+		TEST_CHECK(MaxLengthError < 1e-5f);
+
+		// the snorm16 minimum decodes to -1 like the hardware does
+		CompressedNormal Corner;
+		Corner.Value[0] = -32768;
+		Corner.Value[1] = 0;
+		const XMFLOAT3 Decoded = DecodeNormal(Corner);
+		TEST_CHECK(fabsf(Decoded.x + 1.f) < 1e-6f && fabsf(Decoded.y) < 1e-6f && fabsf(Decoded.z) < 1e-6f);
+	}
+
+	// texcoords, half floats hold [-2, 2] within half a texel at 1024
+	{
+		TEST_CHECK(XMConvertFloatToHalf(1.f) == 0x3C00);
+		TEST_CHECK(XMConvertFloatToHalf(-2.f) == 0xC000);
+		TEST_CHECK(XMConvertFloatToHalf(65504.f) == 0x7BFF);
+		TEST_CHECK(XMConvertHalfToFloat(0x3555) == 0.333251953125f);
+		TEST_CHECK(XMConvertHalfToFloat(XMConvertFloatToHalf(1e-6f)) > 0.f);
+
+		float MaxError = 0.f;
+		for(int i=0;i<100000;i++)
+		{
+			const XMFLOAT2 TexCoord(RandomFloat(-2.f, 2.f), RandomFloat(0.f, 1.f));
+			const XMFLOAT2 Decoded = DecodeTexCoord(EncodeTexCoord(TexCoord));
+			MaxError = Math::Max<float>(MaxError, Math::Max<float>(fabsf(Decoded.x - TexCoord.x), fabsf(Decoded.y - TexCoord.y)));
+		}
+		printf("VertexCompression : texcoord error %.3g (bound %.3g)\n", MaxError, COMPRESSED_TEXCOORD_MAX_ERROR);
+		TEST_CHECK(MaxError <= COMPRESSED_TEXCOORD_MAX_ERROR);
+	}
+
+	// a whole mesh validates, and falls back once a texcoord wraps far enough to lose precision
+	{
+		std::vector<XMFLOAT3> Positions, Normals;
+		std::vector<unsigned int> Indices;
+		BuildSphere(64, 128, 37.f, Positions, Indices);
+		std::vector<XMFLOAT2> TexCoords;
+		for(unsigned int i=0;i<Positions.size();i++)
+		{
+			Normals.push_back(Normalize(Positions[i]));
+			TexCoords.push_back(XMFLOAT2(RandomFloat(0.f, 1.f), RandomFloat(0.f, 1.f)));
+		}
+		const XMFLOAT3 AABBMin(-37.f, -37.f, -37.f), AABBMax(37.f, 37.f, 37.f);
+
+		VertexCompressionError Error;
+		TEST_CHECK(ValidateVertexCompression(Positions, Normals, TexCoords, AABBMin, AABBMax, Error));
+		TEST_CHECK(Error.Position <= COMPRESSED_POSITION_MAX_ERROR && Error.Normal <= COMPRESSED_NORMAL_MAX_ERROR && Error.TexCoord <= COMPRESSED_TEXCOORD_MAX_ERROR);
+
+		TexCoords[TexCoords.size() / 2] = XMFLOAT2(8.3f, 0.5f);
+		TEST_CHECK(!ValidateVertexCompression(Positions, Normals, TexCoords, AABBMin, AABBMax, Error));
+		TEST_CHECK(Error.TexCoord > COMPRESSED_TEXCOORD_MAX_ERROR);
+	}
+
+	return TEST_RESULT("VertexCompressionTest");
+}